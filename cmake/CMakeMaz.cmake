@@ -45,6 +45,13 @@ macro(maz_default_settings)
     option(STATIC_ANALYSIS "Static analysis" OFF)
     option(UBSAN_ANALYSIS "UBSAN_ANALYSIS analysis" OFF)
     option(LINKER_OPTIM "Remove unused functions if possible etc." OFF)
+    option(MULTITHREADED "Thread-safe GlobalParams and Unicode/CMap caches" ON)
+
+    if (MULTITHREADED)
+        set(THREADS_PREFER_PTHREAD_FLAG ON)
+        find_package(Threads REQUIRED)
+        message(STATUS "Multithreading support: ${CMAKE_THREAD_LIBS_INIT}")
+    endif()
 
     if ("${CMAKE_GENERATOR_PLATFORM}" STREQUAL "x64")
         set(MAZPLATFORM "x64")
@@ -0,0 +1,586 @@
+/**
+ * by Mazoea s.r.o.
+ */
+
+#include "io-document/cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "io-document/flat.h"
+#include "maz-utils/fs.h"
+
+namespace maz {
+    namespace doc {
+
+        namespace {
+
+            const char* const INDEX_FILE = "index";
+
+            std::string hex(page_cache::key_type key)
+            {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(key));
+                return buf;
+            }
+
+            //
+            // Pages are stored in a binary form - json is several times slower
+            // than extracting a simple page again. Numbers are in the native
+            // byte order, the marker makes pages from another architecture miss.
+            //
+
+            const char PAGE_MAGIC[] = "MAZPCP1";
+            const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+            struct page_writer
+            {
+                std::string& out;
+
+                template <typename T> void pod(const T& val)
+                {
+                    out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+                }
+
+                void size(size_t n) { pod(static_cast<uint32_t>(n)); }
+
+                void str(const std::string& s)
+                {
+                    size(s.size());
+                    out.append(s);
+                }
+
+                void bbox(const bbox_type& b)
+                {
+                    pod(b.xlt_);
+                    pod(b.ylt_);
+                    pod(b.xrb_);
+                    pod(b.yrb_);
+                }
+
+                template <typename T> void bboxes(const T& arr)
+                {
+                    size(arr.size());
+                    for (const bbox_type& b : arr)
+                        bbox(b);
+                }
+
+                // small and rarely used values only
+                void dict(const maz::json_dict& d)
+                {
+                    std::vector<uint8_t> data = json::to_cbor(d);
+                    size(data.size());
+                    out.append(data.begin(), data.end());
+                }
+
+                void strings(const strings_type& arr)
+                {
+                    size(arr.size());
+                    for (const std::string& s : arr)
+                        str(s);
+                }
+
+                void letter(const letter_type& l)
+                {
+                    str(l.text);
+                    pod(l.confidence);
+                    bbox(l.bbox);
+                    pod(static_cast<uint8_t>((l.super_script ? 1 : 0) | (l.sub_script ? 2 : 0)));
+                    size(l.choices.size());
+                    for (const letter_type::choice_type& c : l.choices)
+                    {
+                        str(c.first);
+                        pod(c.second);
+                    }
+                }
+
+                void word(const word_type& w)
+                {
+                    pod(w.id);
+                    bbox(w.bbox);
+                    pod(w.confidence);
+                    pod(w.orientation);
+                    str(w.utf8_text());
+                    pod(w.flags());
+                    pod(static_cast<int32_t>(w.expected()));
+                    pod(static_cast<int32_t>(w.type()));
+
+                    const word_detail_type& d = w.detail;
+                    pod(d.font_size);
+                    uint16_t bits = (d.bold ? 1 : 0) | (d.italics ? 2 : 0) |
+                                    (d.monospace ? 4 : 0) | (d.serif ? 8 : 0) |
+                                    (d.underline ? 16 : 0) | (d.numeric ? 32 : 0) |
+                                    (d.from_dict ? 64 : 0) | (d.small_caps ? 128 : 0);
+                    pod(bits);
+                    str(d.font);
+                    bbox(d.baseline);
+                    size(d.letters.size());
+                    for (const letter_type& l : d.letters)
+                        letter(l);
+                    strings(d.info);
+                    strings(d.updates);
+                    strings(d.warnings);
+                    bboxes(d.ccs);
+
+                    size(w.ainfo.size());
+                    for (const auto& kv : w.ainfo)
+                    {
+                        str(kv.first);
+                        str(kv.second);
+                    }
+                    words_type alts = w.alts();
+                    size(alts.size());
+                    for (const ptr_word& palt : alts)
+                        word(*palt);
+                }
+
+                // a word of a compact page, the same as `word` above
+                void word(const flat_page& fp, size_t idx)
+                {
+                    const flat_page::word& w = fp.words()[idx];
+                    if (0 < w.letter_count || 0 <= w.extra)
+                    {
+                        word(*fp.make_word(idx));
+                        return;
+                    }
+                    pod(w.id);
+                    bbox(w.bbox);
+                    pod(w.confidence);
+                    pod(w.orientation);
+                    str(fp.text(w));
+                    pod(w.flags);
+                    pod(static_cast<int32_t>(w.expected));
+                    pod(static_cast<int32_t>(w.type));
+
+                    pod(w.font_size);
+                    pod(w.bits);
+                    str(fp.font(w));
+                    bbox(w.baseline);
+                    // letters, info, updates, warnings, ccs, ainfo and alts
+                    for (int i = 0; i < 7; ++i)
+                        size(0);
+                }
+
+                void page(const page_type& p)
+                {
+                    bbox(p.bbox);
+                    bbox(p.image_clip_bbox);
+                    str(p.text);
+                    dict(p.info);
+                    dict(p.images);
+                    dict(p.layout);
+                    pod(p.confidence);
+                    pod(p.scale);
+                    pod(p.deskew);
+                    pod(p.rotation);
+
+                    size(std::distance(p.ia.begin(), p.ia.end()));
+                    for (const visual_elements::ptr_value& pv : p.ia)
+                    {
+                        str(pv->key);
+                        bboxes(pv->bboxes());
+                    }
+
+                    if (p.flat)
+                    {
+                        const flat_page& fp = *p.flat;
+                        size(fp.line_count());
+                        for (const flat_page::line& l : fp.lines())
+                        {
+                            bbox(l.bbox);
+                            size(l.size());
+                            for (size_t i = l.first; i < l.first + l.count; ++i)
+                                word(fp, i);
+                        }
+                        return;
+                    }
+
+                    size(p.lines.size());
+                    for (const ptr_line& pline : p.lines)
+                    {
+                        bbox(pline->bbox);
+                        size(pline->size());
+                        for (const ptr_word& pword : *pline)
+                            word(*pword);
+                    }
+                }
+            };
+
+            struct page_reader
+            {
+                const char* pos;
+                const char* end;
+
+                void need(size_t n)
+                {
+                    if (static_cast<size_t>(end - pos) < n)
+                    {
+                        throw std::runtime_error("Truncated cached page.");
+                    }
+                }
+
+                template <typename T> T pod()
+                {
+                    T val;
+                    need(sizeof(val));
+                    memcpy(&val, pos, sizeof(val));
+                    pos += sizeof(val);
+                    return val;
+                }
+
+                size_t size() { return pod<uint32_t>(); }
+
+                std::string str()
+                {
+                    size_t n = size();
+                    need(n);
+                    std::string s(pos, n);
+                    pos += n;
+                    return s;
+                }
+
+                bbox_type bbox()
+                {
+                    double xlt = pod<double>();
+                    double ylt = pod<double>();
+                    double xrb = pod<double>();
+                    double yrb = pod<double>();
+                    return bbox_type(xlt, ylt, xrb, yrb);
+                }
+
+                template <typename T> void bboxes(T& arr)
+                {
+                    for (size_t n = size(); 0 < n; --n)
+                        arr.push_back(bbox());
+                }
+
+                maz::json_dict dict()
+                {
+                    size_t n = size();
+                    need(n);
+                    std::vector<uint8_t> data(pos, pos + n);
+                    pos += n;
+                    return json::from_cbor(data);
+                }
+
+                void strings(strings_type& arr)
+                {
+                    for (size_t n = size(); 0 < n; --n)
+                        arr.push_back(str());
+                }
+
+                void letter(letter_type& l)
+                {
+                    l.text = str();
+                    l.confidence = pod<confidence_type>();
+                    l.bbox = bbox();
+                    uint8_t bits = pod<uint8_t>();
+                    l.super_script = 0 != (bits & 1);
+                    l.sub_script = 0 != (bits & 2);
+                    for (size_t n = size(); 0 < n; --n)
+                    {
+                        std::string text = str();
+                        l.choices.push_back(letter_type::choice_type(text, pod<double>()));
+                    }
+                }
+
+                ptr_word word()
+                {
+                    ptr_word pw(new word_type());
+                    word_type& w = *pw;
+                    w.id = pod<int>();
+                    w.bbox = bbox();
+                    w.confidence = pod<confidence_type>();
+                    w.orientation = pod<int>();
+                    w.utf8_text() = str();
+                    w.flag(pod<unsigned>(), true);
+                    w.expected(static_cast<word_type::expected_word>(pod<int32_t>()));
+                    w.type(static_cast<word_type::segmented_type>(pod<int32_t>()));
+
+                    word_detail_type& d = w.detail;
+                    d.font_size = pod<int>();
+                    uint16_t bits = pod<uint16_t>();
+                    d.bold = 0 != (bits & 1);
+                    d.italics = 0 != (bits & 2);
+                    d.monospace = 0 != (bits & 4);
+                    d.serif = 0 != (bits & 8);
+                    d.underline = 0 != (bits & 16);
+                    d.numeric = 0 != (bits & 32);
+                    d.from_dict = 0 != (bits & 64);
+                    d.small_caps = 0 != (bits & 128);
+                    d.font = str();
+                    d.baseline = bbox();
+                    for (size_t n = size(); 0 < n; --n)
+                    {
+                        d.letters.push_back(letter_type());
+                        letter(d.letters.back());
+                    }
+                    strings(d.info);
+                    strings(d.updates);
+                    strings(d.warnings);
+                    bboxes(d.ccs);
+
+                    for (size_t n = size(); 0 < n; --n)
+                    {
+                        std::string key = str();
+                        w.ainfo[key] = str();
+                    }
+                    // `alt` adds to the front
+                    words_type alts;
+                    for (size_t n = size(); 0 < n; --n)
+                        alts.push_front(word());
+                    for (const ptr_word& palt : alts)
+                        w.alt(palt);
+                    return pw;
+                }
+
+                void page(page_type& p)
+                {
+                    p.bbox = bbox();
+                    p.image_clip_bbox = bbox();
+                    p.text = str();
+                    p.info = dict();
+                    p.images = dict();
+                    p.layout = dict();
+                    p.confidence = pod<confidence_type>();
+                    p.scale = pod<double_type>();
+                    p.deskew = pod<double_type>();
+                    p.rotation = pod<int>();
+
+                    typedef visual_elements::ptr_value visual;
+                    for (size_t n = size(); 0 < n; --n)
+                    {
+                        std::string key = str();
+                        bboxes_type arr;
+                        bboxes(arr);
+                        p.ia.add(visual(new bbox_element(key, arr)));
+                    }
+
+                    p.lines.reserve(size());
+                    for (size_t n = p.lines.capacity(); 0 < n; --n)
+                    {
+                        ptr_line pline(new line_type);
+                        bbox_type line_bbox = bbox();
+                        for (size_t words = size(); 0 < words; --words)
+                            pline->push_back(word(), true);
+                        pline->bbox = line_bbox;
+                        p.lines.push_back(pline);
+                    }
+                }
+            };
+
+        } // namespace
+
+        //====================================
+        // page_cache
+        //====================================
+
+        const char page_cache::INDEX_MAGIC[] = "MAZPC1";
+
+        page_cache::page_cache(const std::string& dir, size_t max_bytes, size_t max_entries)
+            : dir_(dir), max_bytes_(max_bytes), max_entries_(max_entries)
+        {
+            load_index();
+            // the limits can be lower than the last time
+            evict();
+        }
+
+        page_cache::~page_cache() { flush(); }
+
+        std::string page_cache::file_name(key_type key) const
+        {
+            return fs::path::join(dir_, hex(key) + ".page");
+        }
+
+        void page_cache::load_index()
+        {
+            std::ifstream iff(fs::path::join(dir_, INDEX_FILE).c_str());
+            std::string line;
+            if (!std::getline(iff, line) || INDEX_MAGIC != line) return;
+
+            while (std::getline(iff, line))
+            {
+                std::istringstream iss(line);
+                std::string key_s;
+                size_t size = 0;
+                if (!(iss >> key_s >> size)) break;
+
+                key_type key = 0;
+                try
+                {
+                    key = std::stoull(key_s, nullptr, 16);
+                } catch (std::exception&)
+                {
+                    break;
+                }
+                if (entries_.count(key)) continue;
+                entries_[key] = lru_.insert(lru_.end(), entry_type{key, size});
+                bytes_ += size;
+            }
+        }
+
+        ptr_page page_cache::get(key_type key, maz::json_dict* info)
+        {
+            auto it = entries_.find(key);
+            if (entries_.end() == it)
+            {
+                ++stats_.misses;
+                return ptr_page();
+            }
+
+            ptr_page ppage;
+            std::ifstream iff(file_name(key).c_str(), std::ios::binary);
+            if (iff.good())
+            {
+                std::string data(
+                    (std::istreambuf_iterator<char>(iff)), std::istreambuf_iterator<char>());
+                page_reader r{data.data(), data.data() + data.size()};
+                try
+                {
+                    r.need(sizeof(PAGE_MAGIC));
+                    bool valid = 0 == memcmp(r.pos, PAGE_MAGIC, sizeof(PAGE_MAGIC));
+                    r.pos += sizeof(PAGE_MAGIC);
+                    if (!valid || BYTE_ORDER_MARK != r.pod<uint32_t>())
+                    {
+                        throw std::runtime_error("Not a cached page.");
+                    }
+                    maz::json_dict stored_info = r.dict();
+                    ppage = ptr_page(new page_type);
+                    r.page(*ppage);
+                    if (info) *info = stored_info;
+                } catch (std::exception&)
+                {
+                    ppage.reset();
+                }
+            }
+
+            // removed by someone else or corrupted
+            if (!ppage)
+            {
+                remove(it->second);
+                ++stats_.errors;
+                ++stats_.misses;
+                return ppage;
+            }
+
+            lru_.splice(lru_.end(), lru_, it->second);
+            dirty_ = true;
+            ++stats_.hits;
+            return ppage;
+        }
+
+        void page_cache::put(key_type key, const page_type& page, const maz::json_dict& info)
+        {
+            std::string data(PAGE_MAGIC, sizeof(PAGE_MAGIC));
+            page_writer w{data};
+            w.pod(BYTE_ORDER_MARK);
+            w.dict(info);
+            w.page(page);
+
+            std::string page_file = file_name(key);
+            std::string tmp_file = page_file + ".tmp." + std::to_string(getpid());
+            {
+                std::ofstream off(tmp_file.c_str(), std::ios::binary | std::ios::trunc);
+                off.write(data.data(), data.size());
+                off.close();
+                if (!off.good())
+                {
+                    std::remove(tmp_file.c_str());
+                    ++stats_.errors;
+                    return;
+                }
+            }
+            // rename does not overwrite on all platforms
+            if (0 != std::rename(tmp_file.c_str(), page_file.c_str()))
+            {
+                std::remove(page_file.c_str());
+                if (0 != std::rename(tmp_file.c_str(), page_file.c_str()))
+                {
+                    std::remove(tmp_file.c_str());
+                    ++stats_.errors;
+                    return;
+                }
+            }
+
+            auto it = entries_.find(key);
+            if (entries_.end() != it)
+            {
+                remove(it->second);
+            }
+            entries_[key] = lru_.insert(lru_.end(), entry_type{key, data.size()});
+            bytes_ += data.size();
+            dirty_ = true;
+            ++stats_.stores;
+            evict();
+        }
+
+        void page_cache::remove(lru_type::iterator it)
+        {
+            bytes_ -= it->size;
+            entries_.erase(it->key);
+            lru_.erase(it);
+            dirty_ = true;
+        }
+
+        void page_cache::evict()
+        {
+            while (!lru_.empty() && ((0 < max_bytes_ && max_bytes_ < bytes_) ||
+                                     (0 < max_entries_ && max_entries_ < entries_.size())))
+            {
+                std::remove(file_name(lru_.front().key).c_str());
+                remove(lru_.begin());
+                ++stats_.evictions;
+            }
+        }
+
+        bool page_cache::flush()
+        {
+            if (!dirty_) return true;
+
+            std::string index_file = fs::path::join(dir_, INDEX_FILE);
+            std::string tmp_file = index_file + ".tmp." + std::to_string(getpid());
+            {
+                std::ofstream off(tmp_file.c_str(), std::ios::trunc);
+                off << INDEX_MAGIC << "\n";
+                for (const entry_type& e : lru_)
+                {
+                    off << hex(e.key) << " " << e.size << "\n";
+                }
+                off.close();
+                if (!off.good()) return false;
+            }
+            // rename does not overwrite on all platforms
+            std::remove(index_file.c_str());
+            if (0 != std::rename(tmp_file.c_str(), index_file.c_str())) return false;
+            dirty_ = false;
+            return true;
+        }
+
+        maz::json_dict page_cache::to_json() const
+        {
+            maz::json_dict d = make_json_dict();
+            d["hits"] = stats_.hits;
+            d["misses"] = stats_.misses;
+            d["hit_rate"] = round<2>(stats_.hit_rate());
+            d["stores"] = stats_.stores;
+            d["evictions"] = stats_.evictions;
+            d["errors"] = stats_.errors;
+            d["pages"] = size();
+            d["bytes"] = bytes();
+            return d;
+        }
+
+    } // namespace doc
+} // namespace maz
@@ -0,0 +1,109 @@
+//
+// author: jm (Mazoea s.r.o.)
+// date: 2026
+//
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "io-document/elements.h"
+#include "io-document/types.h"
+
+namespace maz {
+    namespace doc {
+
+        //====================================
+        // page cache
+        //====================================
+
+        /*
+         * On-disk cache of extracted pages keyed by a hash of everything the
+         * extraction depends on (see pdf_to_text for the key).
+         *
+         * The directory must exist. It holds one `<key>.page` file per page
+         * (the page in a binary form and the caller's info) and an `index`
+         * file listing the keys and sizes from the least recently used one.
+         * The index is read when the cache is opened and written back by
+         * `flush()` (or when the cache is destroyed); pages which are not in
+         * the index are ignored. Pages and the index are written to a
+         * temporary file first and renamed, so a crash or another process
+         * sharing the directory never leaves a truncated file behind.
+         *
+         * When a limit is exceeded the least recently used pages are removed.
+         */
+        class page_cache
+        {
+          public:
+            typedef uint64_t key_type;
+
+            static const char INDEX_MAGIC[];
+
+            struct stats_type
+            {
+                size_t hits{0};
+                size_t misses{0};
+                size_t stores{0};
+                size_t evictions{0};
+                size_t errors{0};
+
+                double hit_rate() const
+                {
+                    return (0 == hits + misses) ? 0. : hits / static_cast<double>(hits + misses);
+                }
+            };
+
+          private:
+            struct entry_type
+            {
+                key_type key;
+                size_t size;
+            };
+            typedef std::list<entry_type> lru_type;
+
+            std::string dir_;
+            size_t max_bytes_;
+            size_t max_entries_;
+
+            // least recently used first
+            lru_type lru_;
+            std::unordered_map<key_type, lru_type::iterator> entries_;
+            size_t bytes_{0};
+            bool dirty_{false};
+            stats_type stats_;
+
+          public:
+            /** `0` means no limit. */
+            page_cache(const std::string& dir, size_t max_bytes, size_t max_entries = 0);
+            ~page_cache();
+
+            page_cache(const page_cache&) = delete;
+            page_cache& operator=(const page_cache&) = delete;
+
+            /**
+             * Returns the cached page or an empty pointer. `info` is what was
+             * stored with the page by the caller.
+             */
+            ptr_page get(key_type key, maz::json_dict* info = nullptr);
+            void put(key_type key, const page_type& page, const maz::json_dict& info = {});
+
+            /** Write the index, returns false if it cannot be written. */
+            bool flush();
+
+            size_t size() const { return entries_.size(); }
+            size_t bytes() const { return bytes_; }
+            const stats_type& stats() const { return stats_; }
+
+            maz::json_dict to_json() const;
+
+          private:
+            std::string file_name(key_type key) const;
+            void load_index();
+            void remove(lru_type::iterator it);
+            void evict();
+        };
+
+    } // namespace doc
+} // namespace maz
@@ -1,4 +1,6 @@
 #include "io-document/elements.h"
+#include "io-document/flat.h"
+#include "io-document/words_index.h"
 
 namespace maz {
     namespace doc {
@@ -6,34 +8,6 @@ namespace maz {
         //
         namespace {
 
-            // have sane values in json
-            const char* stringify(word_type::expected_word ew)
-            {
-                switch (ew)
-                {
-                case word_type::NO:
-                    return "NO";
-                case word_type::ORDINARY:
-                    return "ORDINARY";
-                case word_type::LEFTOVER:
-                    return "LEFTOVER";
-                default:
-                    return "INVALID";
-                }
-            }
-
-            // have sane values in json
-            const char* stringify(word_type::segmented_type st)
-            {
-                switch (st)
-                {
-                case word_type::NORMAL:
-                    return "";
-                default:
-                    return "INVALID";
-                }
-            }
-
             template <typename T> void relative_to(T& arr, int x, int y)
             {
                 for (auto& elem : arr)
@@ -48,6 +22,34 @@ namespace maz {
         // document elements
         //===============================
 
+        // have sane values in json
+        const char* stringify(word_type::expected_word ew)
+        {
+            switch (ew)
+            {
+            case word_type::NO:
+                return "NO";
+            case word_type::ORDINARY:
+                return "ORDINARY";
+            case word_type::LEFTOVER:
+                return "LEFTOVER";
+            default:
+                return "INVALID";
+            }
+        }
+
+        // have sane values in json
+        const char* stringify(word_type::segmented_type st)
+        {
+            switch (st)
+            {
+            case word_type::NORMAL:
+                return "";
+            default:
+                return "INVALID";
+            }
+        }
+
         letter_type::letter_type(const maz::json_dict& item)
         {
             // cppcheck-suppress useInitializationList
@@ -829,6 +831,8 @@ namespace maz {
         // line_type
         //
 
+        line_type::~line_type() { link(nullptr); }
+
         line_type::line_type(const maz::json_dict& item)
         {
             bbox = json2bbox(item["bbox"], bbox);
@@ -894,12 +898,14 @@ namespace maz {
 
         void line_type::pop_back()
         {
+            unindexed(words_.back());
             words_.pop_back();
             changed();
         }
 
         void line_type::pop_front()
         {
+            unindexed(words_.front());
             words_.pop_front();
             changed();
         }
@@ -910,12 +916,14 @@ namespace maz {
                 words_.begin(), words_.end(), [pword](auto pw) { return pw == pword; }));
 
             words_.push_back(pword);
+            indexed(pword);
             if (!no_change) changed();
         }
 
         void line_type::push_front(const ptr_word& pword, bool no_change)
         {
             words_.push_front(pword);
+            indexed(pword);
             if (!no_change) changed();
         }
 
@@ -925,6 +933,7 @@ namespace maz {
                 words_.begin(), words_.end(), [pword](auto pw) { return pw == pword; }));
 
             words_.push_back(pword);
+            indexed(pword);
             doc::sort_x(words_, [](const ptr_word& pw) { return pw->bbox; });
             changed();
         }
@@ -935,18 +944,22 @@ namespace maz {
                 words_.begin(), words_.end(), [pword](auto pw) { return pw == pword; }));
 
             auto ret = words_.insert(it, pword);
+            indexed(pword);
             changed();
             return ret;
         }
 
         void line_type::clear()
         {
+            for (const ptr_word& pword : words_)
+                unindexed(pword);
             words_.clear();
             changed();
         }
 
         line_type::iterator line_type::erase(line_type::iterator it_word)
         {
+            unindexed(*it_word);
             auto it = words_.erase(it_word);
             changed();
             return it;
@@ -973,6 +986,8 @@ namespace maz {
         doc::ptr_line line_type::split(const_iterator it)
         {
             doc::ptr_line pl(new line_type);
+            // the moved words go to the same index
+            pl->link_.pindex = link_.pindex;
             while (!words_.empty())
             {
                 doc::ptr_word pw = words_.back();
@@ -1027,6 +1042,29 @@ namespace maz {
             pstats_.reset();
         }
 
+        void line_type::link(const shared_ptr<words_index>& pindex)
+        {
+            if (auto pold = link_.pindex.lock())
+            {
+                for (const ptr_word& pword : words_)
+                    pold->remove(pword.get(), this);
+            }
+            link_.pindex = pindex;
+            if (!pindex) return;
+            for (const ptr_word& pword : words_)
+                pindex->add(pword, this);
+        }
+
+        void line_type::indexed(const ptr_word& pword)
+        {
+            if (auto pindex = link_.pindex.lock()) pindex->add(pword, this);
+        }
+
+        void line_type::unindexed(const ptr_word& pword)
+        {
+            if (auto pindex = link_.pindex.lock()) pindex->remove(pword.get(), this);
+        }
+
         words_type line_type::at(const bbox_type& bbox, double min_overlap) const
         {
             words_type ret;
@@ -1092,7 +1130,10 @@ namespace maz {
             // overwrite information that cannot be parsed from data
             if (recreate)
             {
-                pstats_->init(lines.begin(), lines.end());
+                if (flat)
+                    pstats_->init(*flat);
+                else
+                    pstats_->init(lines.begin(), lines.end());
             }
             return *pstats_;
         }
@@ -1104,13 +1145,61 @@ namespace maz {
 
         size_t page_type::size() const
         {
+            if (flat) return flat->size();
             size_t cnt = 0;
             for_each_word([&cnt](doc::ptr_word pw, doc::line_type&) { ++cnt; });
             return cnt;
         }
 
+        void page_type::compact()
+        {
+            if (flat) return;
+            drop_index();
+            flat = shared_ptr<flat_page>(new flat_page(lines));
+            lines.clear();
+        }
+
+        void page_type::expand()
+        {
+            if (!flat) return;
+            flat->pack();
+            lines = flat->make_lines();
+            flat.reset();
+        }
+
+        words_index& page_type::index()
+        {
+            if (!pindex_)
+            {
+                expand();
+                pindex_ = shared_ptr<words_index>(new words_index);
+                for (ptr_line pline : lines)
+                    pline->link(pindex_);
+            }
+            return *pindex_;
+        }
+
+        void page_type::drop_index()
+        {
+            // the links of the lines expire
+            pindex_.reset();
+        }
+
+        void page_type::index_line(const ptr_line& pline)
+        {
+            if (pindex_) pline->link(pindex_);
+        }
+
+        lines_type page_type::flat_lines() const
+        {
+            assert(flat);
+            return flat->make_lines();
+        }
+
         void page_type::relative_to(int x, int y)
         {
+            drop_index();
+            if (flat) flat->relative_to(x, y);
             for (ptr_line pline : lines)
             {
                 line_type& line = *pline;
@@ -1138,7 +1227,7 @@ namespace maz {
             d["deskew"] = deskew;
             d["rotation"] = rotation;
             d["ia"] = ia.to_json();
-            d["lines"] = maz::make_json_arr();
+            d["lines"] = flat ? flat->to_json(dt) : maz::make_json_arr();
 
             for (auto line : lines)
             {
@@ -1150,6 +1239,7 @@ namespace maz {
 
         utf8_string str(page_type& p)
         {
+            p.expand();
             utf8_string s;
             for (auto pl : p.lines)
             {
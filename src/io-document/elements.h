@@ -373,6 +373,7 @@ namespace maz {
              */
             void flag(unsigned f, bool set = false) { (set) ? flags_ = f : flags_ |= f; }
             bool has_flag(unsigned f) const { return 0 != (flags_ & f); }
+            unsigned flags() const { return flags_; }
 
             /**
              * Remove letters if `pred` returns true.
@@ -397,8 +398,22 @@ namespace maz {
             void relative_to_rest(int x, int y);
         };
 
+        /** Json values of `word_type` enums, empty ones are not stored. */
+        const char* stringify(word_type::expected_word ew);
+        const char* stringify(word_type::segmented_type st);
+
         // =============================================================
 
+        /** Link of a line to the words index of its page, copies of a line are not linked. */
+        struct words_index_link
+        {
+            std::weak_ptr<words_index> pindex;
+
+            words_index_link() = default;
+            words_index_link(const words_index_link&) {}
+            words_index_link& operator=(const words_index_link&) { return *this; }
+        };
+
         // doc["pages"]["lines"]
         struct line_type
         {
@@ -412,9 +427,13 @@ namespace maz {
           private:
             words_type words_;
             shared_ptr<line_statistics> pstats_;
+            words_index_link link_;
 
           public:
             line_type() = default;
+            line_type(const line_type&) = default;
+            line_type& operator=(const line_type&) = default;
+            ~line_type();
 
             explicit line_type(const maz::json_dict& item);
 
@@ -503,9 +522,18 @@ namespace maz {
             /** Find all words intersecting at least `min_overlap` with bbox. */
             words_type at(const bbox_type& bbox, double min_overlap) const;
 
+            /**
+             * Move the words of the line to `pindex` (or out of the current
+             * index if null), words added or removed later follow.
+             */
+            void link(const shared_ptr<words_index>& pindex);
+
           private:
             // call when a change occurred
             void changed();
+            // keep the linked index in sync
+            void indexed(const ptr_word& pword);
+            void unindexed(const ptr_word& pword);
         };
 
         template <typename T> int remove_if(line_type& line, T ftor)
@@ -614,6 +642,8 @@ namespace maz {
             bbox_type bbox;
             bbox_type image_clip_bbox;
             lines_type lines;
+            // compact form of `lines` (see `flat_page`), `lines` are empty when it is set
+            shared_ptr<flat_page> flat;
             visual_elements ia;
 
             utf8_string text;
@@ -631,6 +661,10 @@ namespace maz {
 
           private:
             shared_ptr<page_statistics> pstats_;
+            // see `index`
+            shared_ptr<words_index> pindex_;
+
+            lines_type flat_lines() const;
 
           public:
             // cppcheck-suppress uninitMemberVar
@@ -650,8 +684,32 @@ namespace maz {
 
             size_t size() const;
 
+            /** Replace `lines` by their compact form. */
+            void compact();
+
+            /** Turn the compact form back into `lines` e.g., before words are changed. */
+            void expand();
+
+            /**
+             * Spatial index of the words in `lines`, created on first use.
+             *
+             * Words added to or removed from the lines follow but lines
+             * added to or removed from `lines` must be `link`ed/unlinked (as
+             * `document` does) and words moved in place `update`d - or the
+             * index dropped.
+             */
+            words_index& index();
+            bool indexed() const { return static_cast<bool>(pindex_); }
+            void drop_index();
+
+            /** Link a line added to `lines` to the index if there is one. */
+            void index_line(const ptr_line& pline);
+
             template <typename T> T for_each_word(T ftor)
             {
+                expand();
+                // words can be moved
+                drop_index();
                 for (ptr_line pline : lines)
                     for (ptr_word pword : *pline)
                         ftor(pword, *pline);
@@ -660,7 +718,10 @@ namespace maz {
 
             template <typename T> T for_each_word(T ftor) const
             {
-                for (ptr_line pline : lines)
+                // words of a compact page are copies
+                lines_type copies;
+                if (flat) copies = flat_lines();
+                for (ptr_line pline : (flat ? copies : lines))
                     for (ptr_word pword : *pline)
                         ftor(pword, *pline);
                 return ftor;
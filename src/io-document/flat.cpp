@@ -0,0 +1,470 @@
+/**
+ * by Mazoea s.r.o.
+ */
+
+#include "io-document/flat.h"
+
+#include <algorithm>
+
+namespace maz {
+    namespace doc {
+
+        //====================================
+        // flat_page
+        //====================================
+
+        constexpr uint16_t flat_page::BOLD;
+        constexpr uint16_t flat_page::ITALICS;
+        constexpr uint16_t flat_page::MONOSPACE;
+        constexpr uint16_t flat_page::SERIF;
+        constexpr uint16_t flat_page::UNDERLINE;
+        constexpr uint16_t flat_page::NUMERIC;
+        constexpr uint16_t flat_page::FROM_DICT;
+        constexpr uint16_t flat_page::SMALL_CAPS;
+
+        flat_page::flat_page(const lines_type& lines)
+        {
+            lines_.reserve(lines.size());
+            words_bboxes_.reserve(lines.size());
+            for (const ptr_line& pline : lines)
+            {
+                size_t idx = new_line();
+                for (const ptr_word& pword : *pline)
+                    add(idx, *pword);
+                // the line bbox need not be the union of its words
+                lines_[idx].bbox = pline->bbox;
+            }
+        }
+
+        void flat_page::reserve(size_t words, size_t text_bytes)
+        {
+            words_.reserve(words);
+            arena_.reserve(text_bytes);
+        }
+
+        size_t flat_page::new_line()
+        {
+            lines_.push_back(line());
+            lines_.back().first = static_cast<uint32_t>(words_.size());
+            words_bboxes_.push_back(bbox_type());
+            return lines_.size() - 1;
+        }
+
+        void flat_page::add(size_t idx, word w, const utf8_string& text, const std::string& font)
+        {
+            assert(idx < lines_.size());
+            w.text = store(text);
+            w.font = store_font(font);
+            w.line = static_cast<uint32_t>(idx);
+
+            line& l = lines_[idx];
+            bbox_type& words_bbox = words_bboxes_[idx];
+            if (l.empty())
+            {
+                l.first = static_cast<uint32_t>(words_.size());
+                words_bbox = w.bbox;
+            } else
+            {
+                words_bbox.merge(w.bbox);
+            }
+            l.bbox = words_bbox;
+            ++l.count;
+
+            // words of the lines after this one would be in between
+            if (idx < tail_) packed_ = false;
+            tail_ = std::max(tail_, static_cast<uint32_t>(idx));
+            words_.push_back(w);
+        }
+
+        void flat_page::add(size_t idx, const word_type& w)
+        {
+            word fw;
+            fw.id = w.id;
+            fw.bbox = w.bbox;
+            fw.confidence = w.confidence;
+            fw.orientation = w.orientation;
+            fw.flags = w.flags();
+            fw.expected = w.expected();
+            fw.type = w.type();
+
+            const word_detail_type& d = w.detail;
+            fw.font_size = d.font_size;
+            fw.set(BOLD, d.bold);
+            fw.set(ITALICS, d.italics);
+            fw.set(MONOSPACE, d.monospace);
+            fw.set(SERIF, d.serif);
+            fw.set(UNDERLINE, d.underline);
+            fw.set(NUMERIC, d.numeric);
+            fw.set(FROM_DICT, d.from_dict);
+            fw.set(SMALL_CAPS, d.small_caps);
+            fw.baseline = d.baseline;
+
+            fw.first_letter = static_cast<uint32_t>(letters_.size());
+            fw.letter_count = static_cast<uint32_t>(d.letters.size());
+            for (const letter_type& l : d.letters)
+            {
+                letter fl;
+                fl.text = store(l.text);
+                fl.confidence = l.confidence;
+                fl.bbox = l.bbox;
+                fl.super_script = l.super_script;
+                fl.sub_script = l.sub_script;
+                fl.first_choice = static_cast<uint32_t>(choices_.size());
+                fl.choice_count = static_cast<uint32_t>(l.choices.size());
+                for (const letter_type::choice_type& c : l.choices)
+                    choices_.push_back(choice_type(store(c.first), c.second));
+                letters_.push_back(fl);
+            }
+
+            words_type alts = w.alts();
+            if (!d.info.empty() || !d.updates.empty() || !d.warnings.empty() || !d.ccs.empty() ||
+                !w.ainfo.empty() || !alts.empty())
+            {
+                word_extra& e = extra(fw);
+                e.info = d.info;
+                e.updates = d.updates;
+                e.warnings = d.warnings;
+                e.ccs = d.ccs;
+                e.ainfo = w.ainfo;
+                // copies, the alternatives are changed with the word
+                for (const ptr_word& palt : alts)
+                    e.alts.push_back(ptr_word(new word_type(*palt)));
+            }
+
+            add(idx, fw, w.utf8_text(), d.font);
+        }
+
+        void flat_page::pack()
+        {
+            if (packed_) return;
+
+            uint32_t pos = 0;
+            std::vector<uint32_t> next(lines_.size());
+            for (size_t i = 0; i < lines_.size(); ++i)
+            {
+                lines_[i].first = pos;
+                next[i] = pos;
+                pos += lines_[i].count;
+            }
+
+            // stable - words of a line keep their order
+            std::vector<word> words(words_.size());
+            for (const word& w : words_)
+                words[next[w.line]++] = w;
+            words_.swap(words);
+
+            tail_ = 0;
+            for (size_t i = 0; i < lines_.size(); ++i)
+                if (!lines_[i].empty()) tail_ = static_cast<uint32_t>(i);
+            packed_ = true;
+        }
+
+        void flat_page::remove_empty_lines()
+        {
+            std::vector<uint32_t> moved(lines_.size());
+            size_t n = 0;
+            for (size_t i = 0; i < lines_.size(); ++i)
+            {
+                if (lines_[i].empty()) continue;
+                moved[i] = static_cast<uint32_t>(n);
+                lines_[n] = lines_[i];
+                words_bboxes_[n] = words_bboxes_[i];
+                ++n;
+            }
+            if (n == lines_.size()) return;
+
+            lines_.resize(n);
+            words_bboxes_.resize(n);
+            for (word& w : words_)
+                w.line = moved[w.line];
+            tail_ = (0 < n) ? static_cast<uint32_t>(n - 1) : 0;
+        }
+
+        std::vector<size_t> flat_page::words_at(const bbox_type& bbox, double min_overlap) const
+        {
+            assert(packed_);
+            assert(1. < min_overlap);
+            static constexpr double min_overlap_y = 10.;
+
+            std::vector<size_t> ret;
+            for (const line& l : lines_)
+            {
+                if (min_overlap_y < bbox.intersects_y(l.bbox))
+                {
+                    for (size_t i = l.first; i < l.first + l.count; ++i)
+                    {
+                        if (min_overlap > bbox.intersects(words_[i].bbox)) continue;
+                        ret.push_back(i);
+                    }
+                }
+
+                // break if line too below but give it space if a word is big
+                if (l.bbox.ylt() > (bbox.yrb() + 2 * bbox.height()))
+                {
+                    break;
+                }
+            }
+            return ret;
+        }
+
+        void flat_page::relative_to(int x, int y)
+        {
+            for (line& l : lines_)
+                l.bbox.relative_to(x, y);
+            for (bbox_type& b : words_bboxes_)
+                b.relative_to(x, y);
+            for (word& w : words_)
+            {
+                w.bbox.relative_to(x, y);
+                w.baseline.relative_to(x, y);
+            }
+            for (letter& l : letters_)
+                l.bbox.relative_to(x, y);
+            for (word_extra& e : extras_)
+            {
+                for (const ptr_word& palt : e.alts)
+                    palt->relative_to(x, y);
+            }
+        }
+
+        maz::json_arr flat_page::to_json(output_detail dt) const
+        {
+            assert(packed_);
+            maz::json_arr arr = make_json_arr();
+            for (const line& l : lines_)
+            {
+                maz::json_dict d = make_json_dict();
+                if (!l.empty())
+                {
+                    d["bbox"] = bbox2json(l.bbox);
+                    for (size_t i = l.first; i < l.first + l.count; ++i)
+                    {
+                        d["words"].emplace_back(word_json(words_[i], dt));
+                    }
+                }
+                arr.emplace_back(d);
+            }
+            return arr;
+        }
+
+        // the same as `word_type::to_json`
+        maz::json_dict flat_page::word_json(const word& w, output_detail dt) const
+        {
+            maz::json_dict d = make_json_dict();
+
+            d["id"] = w.id;
+            d["bbox"] = bbox2json(w.bbox);
+            d["text"] = text(w);
+            d["confidence"] = round<2>(w.confidence);
+            d["orientation"] = w.orientation;
+
+            if (basic == dt) return d;
+
+            d["flags"] = w.flags;
+
+            maz::json_dict& detail = d["detail"];
+            detail = make_json_dict();
+            if (dt == full)
+            {
+                detail["font"] = font(w);
+                detail["font_size"] = w.font_size;
+                detail["bold"] = w.has(BOLD);
+                detail["italics"] = w.has(ITALICS);
+                detail["monospace"] = w.has(MONOSPACE);
+                detail["serif"] = w.has(SERIF);
+                detail["numeric"] = w.has(NUMERIC);
+                detail["underline"] = w.has(UNDERLINE);
+                detail["small"] = w.has(SMALL_CAPS);
+            }
+            detail["from_dict"] = w.has(FROM_DICT);
+            detail["baseline"] = bbox2json(w.baseline);
+
+            for (size_t i = w.first_letter; i < w.first_letter + w.letter_count; ++i)
+            {
+                const letter& l = letters_[i];
+                maz::json_dict ld = make_json_dict();
+                utf8_string ltext = text(l.text);
+                ld["text"] = ltext;
+                ld["confidence"] = round<2>(l.confidence);
+                ld["bbox"] = bbox2json(l.bbox);
+                json_arr choices_arr = maz::make_json_arr();
+
+                static const size_t max_choices = 3;
+                for (size_t c = l.first_choice; c < l.first_choice + l.choice_count; ++c)
+                {
+                    utf8_string ctext = text(choices_[c].first);
+                    if (ltext != ctext)
+                    {
+                        json_arr one_choice = maz::make_json_arr();
+                        one_choice[0] = ctext;
+                        one_choice[1] = round<2>(choices_[c].second);
+                        choices_arr.push_back(one_choice);
+                        if (max_choices <= choices_arr.size())
+                        {
+                            break;
+                        }
+                    }
+                }
+                ld["choices"] = choices_arr;
+
+                if (dt == full)
+                {
+                    ld["sup"] = l.super_script;
+                    ld["sub"] = l.sub_script;
+                }
+                detail["letters"].emplace_back(ld);
+            }
+
+            std::string val = stringify(w.expected);
+            if (!val.empty())
+            {
+                detail["expected"] = val;
+            }
+            val = stringify(w.type);
+            if (!val.empty())
+            {
+                detail["type"] = val;
+            }
+
+            if (0 <= w.extra)
+            {
+                const word_extra& e = extras_[w.extra];
+                if (!e.updates.empty())
+                {
+                    add_arr2json(detail["updates"], e.updates);
+                }
+                if (!e.warnings.empty())
+                {
+                    add_arr2json(detail["warnings"], e.warnings);
+                }
+                if (!e.info.empty())
+                {
+                    add_arr2json(detail["info"], e.info);
+                }
+                if (!e.alts.empty())
+                {
+                    d["alts"] = make_json_arr();
+                    for (const ptr_word& palt : e.alts)
+                    {
+                        d["alts"].push_back(palt->to_json(dt));
+                    }
+                }
+                if (!e.ainfo.empty())
+                {
+                    d["arbitrary"] = e.ainfo;
+                }
+            }
+
+            return d;
+        }
+
+        ptr_word flat_page::make_word(size_t idx) const
+        {
+            const word& fw = words_[idx];
+            ptr_word pw(new word_type());
+            word_type& w = *pw;
+            w.id = fw.id;
+            w.bbox = fw.bbox;
+            w.confidence = fw.confidence;
+            w.orientation = fw.orientation;
+            w.utf8_text() = text(fw);
+            w.flag(fw.flags, true);
+            w.expected(fw.expected);
+            w.type(fw.type);
+
+            word_detail_type& d = w.detail;
+            d.font_size = fw.font_size;
+            d.bold = fw.has(BOLD);
+            d.italics = fw.has(ITALICS);
+            d.monospace = fw.has(MONOSPACE);
+            d.serif = fw.has(SERIF);
+            d.underline = fw.has(UNDERLINE);
+            d.numeric = fw.has(NUMERIC);
+            d.from_dict = fw.has(FROM_DICT);
+            d.small_caps = fw.has(SMALL_CAPS);
+            d.font = font(fw);
+            d.baseline = fw.baseline;
+
+            for (size_t i = fw.first_letter; i < fw.first_letter + fw.letter_count; ++i)
+            {
+                const letter& fl = letters_[i];
+                d.letters.push_back(letter_type());
+                letter_type& l = d.letters.back();
+                l.text = text(fl.text);
+                l.confidence = fl.confidence;
+                l.bbox = fl.bbox;
+                l.super_script = fl.super_script;
+                l.sub_script = fl.sub_script;
+                for (size_t c = fl.first_choice; c < fl.first_choice + fl.choice_count; ++c)
+                {
+                    l.choices.push_back(
+                        letter_type::choice_type(text(choices_[c].first), choices_[c].second));
+                }
+            }
+
+            if (0 <= fw.extra)
+            {
+                const word_extra& e = extras_[fw.extra];
+                d.info = e.info;
+                d.updates = e.updates;
+                d.warnings = e.warnings;
+                d.ccs = e.ccs;
+                w.ainfo = e.ainfo;
+                // `alt` adds to the front
+                for (auto it = e.alts.rbegin(); it != e.alts.rend(); ++it)
+                    w.alt(ptr_word(new word_type(**it)));
+            }
+            return pw;
+        }
+
+        ptr_line flat_page::make_line(size_t idx) const
+        {
+            assert(packed_);
+            const line& l = lines_[idx];
+            ptr_line pline(new line_type);
+            for (size_t i = l.first; i < l.first + l.count; ++i)
+                pline->push_back(make_word(i), true);
+            pline->bbox = l.bbox;
+            return pline;
+        }
+
+        lines_type flat_page::make_lines() const
+        {
+            lines_type lines;
+            lines.reserve(lines_.size());
+            for (size_t i = 0; i < lines_.size(); ++i)
+                lines.push_back(make_line(i));
+            return lines;
+        }
+
+        flat_page::text_ref flat_page::store(const std::string& s)
+        {
+            text_ref ref;
+            ref.pos = static_cast<uint32_t>(arena_.size());
+            ref.len = static_cast<uint32_t>(s.size());
+            arena_.append(s);
+            return ref;
+        }
+
+        flat_page::text_ref flat_page::store_font(const std::string& font)
+        {
+            if (font.empty()) return text_ref();
+            auto it = fonts_.find(font);
+            if (it != fonts_.end()) return it->second;
+            text_ref ref = store(font);
+            fonts_[font] = ref;
+            return ref;
+        }
+
+        flat_page::word_extra& flat_page::extra(word& w)
+        {
+            if (0 > w.extra)
+            {
+                w.extra = static_cast<int>(extras_.size());
+                extras_.push_back(word_extra());
+            }
+            return extras_[w.extra];
+        }
+
+    } // namespace doc
+} // namespace maz
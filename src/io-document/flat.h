@@ -0,0 +1,236 @@
+//
+// author: jm (Mazoea s.r.o.)
+// date: 2026
+//
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "io-document/elements.h"
+#include "io-document/types.h"
+
+namespace maz {
+    namespace doc {
+
+        //====================================
+        // flat page
+        //====================================
+
+        /*
+         * Compact form of the lines of a page (see `page_type::compact`).
+         *
+         * Lines, words and letters are stored in three arrays - a line is
+         * a range of words and a word a range of letters. Texts and font
+         * names live in one string arena. Values which are rarely set (tags,
+         * arbitrary info, ccs, alternatives and letter choices) are stored
+         * aside.
+         *
+         * Words can be added to any line. If they are not added in the line
+         * order, `pack()` must be called before the page is read (`document`
+         * does that in `end_page`).
+         *
+         * Callers which change words use `page_type::expand()` which turns the
+         * page back into `line_type`/`word_type` objects.
+         */
+        class flat_page
+        {
+          public:
+            // position in the string arena
+            struct text_ref
+            {
+                uint32_t pos{0};
+                uint32_t len{0};
+            };
+
+            // `word_detail_type` booleans (the same bits as in the page cache)
+            static constexpr uint16_t BOLD = 1 << 0;
+            static constexpr uint16_t ITALICS = 1 << 1;
+            static constexpr uint16_t MONOSPACE = 1 << 2;
+            static constexpr uint16_t SERIF = 1 << 3;
+            static constexpr uint16_t UNDERLINE = 1 << 4;
+            static constexpr uint16_t NUMERIC = 1 << 5;
+            static constexpr uint16_t FROM_DICT = 1 << 6;
+            static constexpr uint16_t SMALL_CAPS = 1 << 7;
+
+            struct letter
+            {
+                text_ref text;
+                confidence_type confidence{};
+                bbox_type bbox;
+                bool super_script{};
+                bool sub_script{};
+                // range in `choices_`
+                uint32_t first_choice{0};
+                uint32_t choice_count{0};
+            };
+
+            struct word
+            {
+                int id{-1};
+                bbox_type bbox;
+                confidence_type confidence{-1.};
+                int orientation{0};
+                unsigned flags{0};
+                word_type::expected_word expected{word_type::NO};
+                word_type::segmented_type type{word_type::NORMAL};
+                text_ref text;
+                // word_detail_type
+                text_ref font;
+                int font_size{-1};
+                uint16_t bits{0};
+                bbox_type baseline;
+                // range in `letters_`
+                uint32_t first_letter{0};
+                uint32_t letter_count{0};
+                // index of the line and of the rarely used values (-1 if none)
+                uint32_t line{0};
+                int extra{-1};
+
+                bool has(uint16_t bit) const { return 0 != (bits & bit); }
+                void set(uint16_t bit, bool val) { bits = val ? (bits | bit) : (bits & ~bit); }
+
+                // the same as `word_type`
+                int height() const
+                {
+                    return to_int(
+                        (0 == orientation || 2 == orientation) ? bbox.height() : bbox.width());
+                }
+
+                int width() const
+                {
+                    return to_int(
+                        (0 == orientation || 2 == orientation) ? bbox.width() : bbox.height());
+                }
+            };
+
+            struct line
+            {
+                bbox_type bbox;
+                // range in `words_`
+                uint32_t first{0};
+                uint32_t count{0};
+
+                size_t size() const { return count; }
+                bool empty() const { return 0 == count; }
+            };
+
+          private:
+            struct word_extra
+            {
+                strings_type info;
+                strings_type updates;
+                strings_type warnings;
+                bboxes_type ccs;
+                word_type::arbitrary_info ainfo;
+                words_type alts;
+            };
+
+            typedef std::pair<text_ref, double> choice_type;
+
+            std::vector<line> lines_;
+            std::vector<word> words_;
+            std::vector<letter> letters_;
+            std::vector<choice_type> choices_;
+            std::vector<word_extra> extras_;
+            std::string arena_;
+
+            // union of the word bboxes of each line, a line gets it when a word
+            // is added (see `line_type::update_bbox`)
+            std::vector<bbox_type> words_bboxes_;
+            // font names are shared by many words
+            std::unordered_map<std::string, text_ref> fonts_;
+            // the last line with words, adding to a line before it unpacks the page
+            uint32_t tail_{0};
+            bool packed_{true};
+
+          public:
+            flat_page() = default;
+
+            /** Compact copy of `lines`. */
+            explicit flat_page(const lines_type& lines);
+
+            //
+            // building
+            //
+
+            void reserve(size_t words, size_t text_bytes);
+
+            /** Add an empty line, returns its index. */
+            size_t new_line();
+
+            /**
+             * Add a word with `text` and `font` to line `idx`, the text and
+             * font references and the line index of `w` are set here.
+             */
+            void add(size_t idx, word w, const utf8_string& text, const std::string& font = {});
+
+            /** Add a copy of a word object to line `idx`. */
+            void add(size_t idx, const word_type& w);
+
+            /** Make the words of each line contiguous again. */
+            void pack();
+            bool packed() const { return packed_; }
+
+            /** Remove lines without words. */
+            void remove_empty_lines();
+
+            //
+            // reading
+            //
+
+            size_t size() const { return words_.size(); }
+            bool empty() const { return words_.empty(); }
+            size_t line_count() const { return lines_.size(); }
+
+            const std::vector<line>& lines() const { return lines_; }
+            std::vector<line>& lines() { return lines_; }
+            const std::vector<word>& words() const { return words_; }
+            // do not change the references and ranges
+            std::vector<word>& words() { return words_; }
+            const std::vector<letter>& letters() const { return letters_; }
+
+            utf8_string text(const text_ref& ref) const { return arena_.substr(ref.pos, ref.len); }
+            utf8_string text(const word& w) const { return text(w.text); }
+            std::string font(const word& w) const { return text(w.font); }
+
+            template <typename T> T for_each_word(T ftor) const
+            {
+                assert(packed_);
+                for (const line& l : lines_)
+                    for (size_t i = l.first; i < l.first + l.count; ++i)
+                        ftor(words_[i], l);
+                return ftor;
+            }
+
+            /**
+             * Returns indices of words overlapping at least `min_overlap` with
+             * `bbox`, the same words as `maz::words_at` does.
+             */
+            std::vector<size_t> words_at(const bbox_type& bbox, double min_overlap) const;
+
+            void relative_to(int x, int y);
+
+            /** The `lines` array of the page json. */
+            maz::json_arr to_json(output_detail dt = normal) const;
+
+            //
+            // adapters to the object model
+            //
+
+            ptr_word make_word(size_t idx) const;
+            ptr_line make_line(size_t idx) const;
+            lines_type make_lines() const;
+
+          private:
+            text_ref store(const std::string& s);
+            text_ref store_font(const std::string& font);
+            word_extra& extra(word& w);
+            maz::json_dict word_json(const word& w, output_detail dt) const;
+        };
+
+    } // namespace doc
+} // namespace maz
@@ -0,0 +1,467 @@
+/**
+ * by Mazoea s.r.o.
+ */
+
+#include "io-document/fulltext.h"
+#include "io-document/flat.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "unilib/text.h"
+
+namespace maz {
+    namespace doc {
+
+        namespace {
+
+            //
+            // varints
+            //
+
+            void put_varint(std::string& out, uint64_t v)
+            {
+                while (0x80 <= v)
+                {
+                    out.push_back(static_cast<char>(v | 0x80));
+                    v >>= 7;
+                }
+                out.push_back(static_cast<char>(v));
+            }
+
+            void put_signed(std::string& out, int64_t v)
+            {
+                put_varint(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+            }
+
+            struct varint_reader
+            {
+                const unsigned char* pos;
+                const unsigned char* end;
+                bool ok{true};
+
+                varint_reader(const char* start, size_t len)
+                    : pos(reinterpret_cast<const unsigned char*>(start)), end(pos + len)
+                {
+                }
+
+                uint64_t get()
+                {
+                    uint64_t v = 0;
+                    for (int shift = 0; shift < 64; shift += 7)
+                    {
+                        if (pos == end)
+                        {
+                            break;
+                        }
+                        unsigned char b = *pos++;
+                        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+                        if (0 == (b & 0x80)) return v;
+                    }
+                    ok = false;
+                    return 0;
+                }
+
+                int64_t get_signed()
+                {
+                    uint64_t v = get();
+                    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+                }
+
+                bool bytes(size_t len, std::string& out)
+                {
+                    if (static_cast<size_t>(end - pos) < len)
+                    {
+                        ok = false;
+                        return false;
+                    }
+                    out.append(reinterpret_cast<const char*>(pos), len);
+                    pos += len;
+                    return true;
+                }
+
+                size_t left() const { return static_cast<size_t>(end - pos); }
+            };
+
+            bool posting_less(const fulltext_posting& l, const fulltext_posting& r)
+            {
+                return l.page < r.page || (l.page == r.page && l.pos < r.pos);
+            }
+
+            void encode(const fulltext_postings& postings, std::string& out)
+            {
+                int last_page = 0;
+                int last_pos = 0;
+                for (const fulltext_posting& p : postings)
+                {
+                    put_varint(out, static_cast<uint64_t>(p.page - last_page));
+                    put_varint(
+                        out, static_cast<uint64_t>(p.page == last_page ? p.pos - last_pos : p.pos));
+                    put_signed(out, p.word_id);
+                    // the same values as in the json (see bbox2json)
+                    put_signed(out, to_int(p.bbox.xlt_));
+                    put_signed(out, to_int(p.bbox.ylt_));
+                    put_varint(out, static_cast<uint64_t>(maz_max(0, to_int(p.bbox.width()))));
+                    put_varint(out, static_cast<uint64_t>(maz_max(0, to_int(p.bbox.height()))));
+                    last_page = p.page;
+                    last_pos = p.pos;
+                }
+            }
+
+            bool is_separator(char32_t c)
+            {
+                return c <= ' ' || 0 != (unilib::unicode::category(c) & unilib::unicode::Z);
+            }
+
+            bool is_punctuation(char32_t c)
+            {
+                return 0 != (unilib::unicode::category(c) & unilib::unicode::P);
+            }
+
+            // query word, `*` at the end means prefix
+            struct query_term
+            {
+                utf8_string term;
+                bool prefix{false};
+            };
+
+        } // namespace
+
+        //====================================
+        // helpers
+        //====================================
+
+        std::vector<utf8_string> fulltext_terms(const utf8_string& text)
+        {
+            std::vector<utf8_string> ret;
+            std::u32string u32s;
+            unilib::utf8::decode(text.c_str(), u32s);
+
+            auto it = u32s.begin();
+            while (it != u32s.end())
+            {
+                it = std::find_if_not(it, u32s.end(), is_separator);
+                if (it == u32s.end()) break;
+                auto it_end = std::find_if(it, u32s.end(), is_separator);
+
+                // strip punctuation around the term e.g., "(invoice),"
+                auto first = std::find_if_not(it, it_end, is_punctuation);
+                auto last = it_end;
+                while (last != first && is_punctuation(*(last - 1)))
+                {
+                    --last;
+                }
+                utf8_string term;
+                unilib::utf8::encode(std::u32string(first, last), term);
+                ret.push_back(unilib::fold_utf8(term));
+                it = it_end;
+            }
+            return ret;
+        }
+
+        maz::json_dict fulltext_match::to_json() const
+        {
+            maz::json_dict d = make_json_dict();
+            d["page"] = page;
+            d["pos"] = pos;
+            d["word_ids"] = word_ids;
+            d["bbox"] = bbox2json(bbox);
+            return d;
+        }
+
+        //====================================
+        // fulltext_builder
+        //====================================
+
+        const char fulltext_builder::MAGIC[] = "MAZFTI1\n";
+
+        void fulltext_builder::add_page(int page_num, const page_type& page)
+        {
+            int pos = 0;
+            auto add_word = [&](const utf8_string& text, int word_id, const bbox_type& bbox) {
+                for (const utf8_string& term : fulltext_terms(text))
+                {
+                    if (!term.empty())
+                    {
+                        fulltext_posting p;
+                        p.page = page_num;
+                        p.pos = pos;
+                        p.word_id = word_id;
+                        p.bbox = bbox;
+                        terms_[term].push_back(p);
+                        ++postings_;
+                    }
+                    // empty terms keep their position so phrases do not
+                    // match over them
+                    ++pos;
+                }
+            };
+
+            if (page.flat)
+            {
+                const flat_page& fp = *page.flat;
+                fp.for_each_word([&](const flat_page::word& w, const flat_page::line&) {
+                    add_word(fp.text(w), w.id, w.bbox);
+                });
+            } else
+            {
+                page.for_each_word([&](const ptr_word& pword, const line_type&) {
+                    add_word(pword->utf8_text(), pword->id, pword->bbox);
+                });
+            }
+            ++pages_;
+        }
+
+        std::string fulltext_builder::serialize() const
+        {
+            typedef std::unordered_map<utf8_string, fulltext_postings>::const_iterator term_it;
+            std::vector<term_it> sorted;
+            sorted.reserve(terms_.size());
+            for (term_it it = terms_.begin(); it != terms_.end(); ++it)
+            {
+                sorted.push_back(it);
+            }
+            std::sort(sorted.begin(), sorted.end(), [](const term_it& l, const term_it& r) {
+                return l->first < r->first;
+            });
+
+            std::string ret(MAGIC);
+            put_varint(ret, static_cast<uint64_t>(pages_));
+            put_varint(ret, sorted.size());
+
+            std::string blob;
+            std::string encoded;
+            fulltext_postings postings;
+            const utf8_string* prev = nullptr;
+            for (const term_it& it : sorted)
+            {
+                const utf8_string& term = it->first;
+                size_t shared = 0;
+                if (prev)
+                {
+                    size_t len = maz_min(prev->size(), term.size());
+                    while (shared < len && (*prev)[shared] == term[shared])
+                    {
+                        ++shared;
+                    }
+                }
+                put_varint(ret, shared);
+                put_varint(ret, term.size() - shared);
+                ret.append(term, shared, std::string::npos);
+
+                // pages can be added in any order (e.g., --page=3,1)
+                postings = it->second;
+                std::stable_sort(postings.begin(), postings.end(), posting_less);
+                encoded.clear();
+                encode(postings, encoded);
+                put_varint(ret, postings.size());
+                put_varint(ret, encoded.size());
+                blob += encoded;
+                prev = &term;
+            }
+
+            return ret + blob;
+        }
+
+        bool fulltext_builder::write(const std::string& file_name) const
+        {
+            std::ofstream off(file_name.c_str(), std::ios::binary | std::ios::trunc);
+            if (!off.good()) return false;
+            std::string data = serialize();
+            off.write(data.data(), static_cast<std::streamsize>(data.size()));
+            return off.good();
+        }
+
+        //====================================
+        // fulltext_index
+        //====================================
+
+        bool fulltext_index::load(const std::string& file_name)
+        {
+            std::ifstream iff(file_name.c_str(), std::ios::binary);
+            if (!iff.good()) return false;
+            return deserialize(
+                std::string(std::istreambuf_iterator<char>(iff), std::istreambuf_iterator<char>()));
+        }
+
+        bool fulltext_index::deserialize(std::string data)
+        {
+            terms_.clear();
+            postings_.clear();
+            pages_ = 0;
+
+            const size_t magic_len = sizeof(fulltext_builder::MAGIC) - 1;
+            if (0 != data.compare(0, magic_len, fulltext_builder::MAGIC)) return false;
+
+            varint_reader r(data.data() + magic_len, data.size() - magic_len);
+            int pages = static_cast<int>(r.get());
+            uint64_t cnt = r.get();
+            if (!r.ok || r.left() < cnt) return false;
+
+            std::vector<term_entry> terms;
+            terms.reserve(static_cast<size_t>(cnt));
+            size_t offset = 0;
+            for (uint64_t i = 0; i < cnt && r.ok; ++i)
+            {
+                size_t shared = static_cast<size_t>(r.get());
+                size_t len = static_cast<size_t>(r.get());
+                term_entry entry;
+                if (shared > (terms.empty() ? 0 : terms.back().term.size())) return false;
+                if (shared) entry.term.assign(terms.back().term, 0, shared);
+                if (!r.bytes(len, entry.term)) return false;
+                entry.count = static_cast<uint32_t>(r.get());
+                entry.offset = offset;
+                entry.size = static_cast<size_t>(r.get());
+                offset += entry.size;
+                terms.push_back(std::move(entry));
+            }
+            if (!r.ok || r.left() != offset) return false;
+
+            postings_ = data.substr(data.size() - offset);
+            terms_.swap(terms);
+            pages_ = pages;
+            return true;
+        }
+
+        void fulltext_index::decode(const term_entry& entry, fulltext_postings& out) const
+        {
+            varint_reader r(postings_.data() + entry.offset, entry.size);
+            int page = 0;
+            int pos = 0;
+            for (uint32_t i = 0; i < entry.count && r.ok; ++i)
+            {
+                int page_delta = static_cast<int>(r.get());
+                int pos_value = static_cast<int>(r.get());
+                pos = (0 == page_delta) ? pos + pos_value : pos_value;
+                page += page_delta;
+
+                fulltext_posting p;
+                p.page = page;
+                p.pos = pos;
+                p.word_id = static_cast<int>(r.get_signed());
+                double x1 = static_cast<double>(r.get_signed());
+                double y1 = static_cast<double>(r.get_signed());
+                double w = static_cast<double>(r.get());
+                double h = static_cast<double>(r.get());
+                p.bbox = bbox_type(x1, y1, x1 + w, y1 + h);
+                out.push_back(p);
+            }
+        }
+
+        fulltext_postings fulltext_index::postings(const utf8_string& term, bool prefix) const
+        {
+            fulltext_postings ret;
+            if (term.empty()) return ret;
+
+            auto it = std::lower_bound(
+                terms_.begin(), terms_.end(), term, [](const term_entry& e, const utf8_string& t) {
+                    return e.term < t;
+                });
+            if (!prefix)
+            {
+                if (it != terms_.end() && it->term == term) decode(*it, ret);
+                return ret;
+            }
+
+            size_t cnt = 0;
+            for (; it != terms_.end() && 0 == it->term.compare(0, term.size(), term); ++it)
+            {
+                decode(*it, ret);
+                ++cnt;
+            }
+            if (1 < cnt)
+            {
+                std::sort(ret.begin(), ret.end(), posting_less);
+            }
+            return ret;
+        }
+
+        fulltext_matches fulltext_index::find(const utf8_string& query) const
+        {
+            fulltext_matches ret;
+
+            // split the query the same way the pages were split, remember
+            // which words are prefixes
+            std::vector<query_term> qterms;
+            std::u32string u32s;
+            unilib::utf8::decode(query.c_str(), u32s);
+            auto it = u32s.begin();
+            while (it != u32s.end())
+            {
+                it = std::find_if_not(it, u32s.end(), is_separator);
+                if (it == u32s.end()) break;
+                auto it_end = std::find_if(it, u32s.end(), is_separator);
+                auto last = it_end;
+                query_term qt;
+                while (last != it && U'*' == *(last - 1))
+                {
+                    --last;
+                    qt.prefix = true;
+                }
+                utf8_string word;
+                unilib::utf8::encode(std::u32string(it, last), word);
+                std::vector<utf8_string> terms = fulltext_terms(word);
+                qt.term = terms.empty() ? utf8_string() : terms.front();
+                qterms.push_back(qt);
+                it = it_end;
+            }
+
+            // empty terms (e.g., a dash) match any word at their position
+            std::vector<fulltext_postings> postings(qterms.size());
+            size_t anchor = qterms.size();
+            for (size_t i = 0; i < qterms.size(); ++i)
+            {
+                if (qterms[i].term.empty()) continue;
+                postings[i] = this->postings(qterms[i].term, qterms[i].prefix);
+                if (postings[i].empty()) return ret;
+                if (anchor == qterms.size() || postings[i].size() < postings[anchor].size())
+                {
+                    anchor = i;
+                }
+            }
+            if (anchor == qterms.size()) return ret;
+
+            // walk the rarest term and look up the others at their offsets,
+            // matches come out sorted by page and position
+            for (const fulltext_posting& a : postings[anchor])
+            {
+                fulltext_match m;
+                m.page = a.page;
+                m.pos = a.pos - static_cast<int>(anchor);
+                if (m.pos < 0) continue;
+
+                bool found = true;
+                bool first = true;
+                for (size_t i = 0; i < qterms.size() && found; ++i)
+                {
+                    if (postings[i].empty()) continue;
+                    fulltext_posting key;
+                    key.page = m.page;
+                    key.pos = m.pos + static_cast<int>(i);
+                    auto pit =
+                        std::lower_bound(postings[i].begin(), postings[i].end(), key, posting_less);
+                    found = pit != postings[i].end() && !posting_less(key, *pit);
+                    if (!found) break;
+
+                    // a word can hold more terms
+                    if (m.word_ids.empty() || m.word_ids.back() != pit->word_id)
+                    {
+                        m.word_ids.push_back(pit->word_id);
+                    }
+                    if (first)
+                    {
+                        m.bbox = pit->bbox;
+                        first = false;
+                    } else
+                    {
+                        m.bbox.merge(pit->bbox);
+                    }
+                }
+                if (found) ret.push_back(m);
+            }
+            return ret;
+        }
+
+    } // namespace doc
+} // namespace maz
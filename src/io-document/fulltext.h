@@ -0,0 +1,135 @@
+//
+// author: jm (Mazoea s.r.o.)
+// date: 2026
+//
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "io-document/elements.h"
+#include "io-document/types.h"
+
+namespace maz {
+    namespace doc {
+
+        //====================================
+        // full-text index
+        //====================================
+
+        /*
+         * The index maps folded terms (see `unilib::fold_utf8`) to postings
+         * - page number, position of the term on the page (in document order),
+         * word id and word bbox.
+         *
+         * On-disk layout (all integers are varints, signed ones zigzag encoded):
+         *
+         *   "MAZFTI1\n"
+         *   page count, term count
+         *   terms sorted by bytes, each one front coded against the previous one
+         *     shared prefix length, suffix length, suffix,
+         *     posting count, postings size in bytes
+         *   postings of all terms in the same order, sorted by page and position
+         *     page delta, position (delta within the same page), word id,
+         *     x1, y1, width, height (rounded as in the json)
+         *
+         * Only the dictionary is decoded when loading, postings are decoded
+         * lazily per term.
+         */
+
+        struct fulltext_posting
+        {
+            int page{0};
+            int pos{0};
+            int word_id{-1};
+            bbox_type bbox;
+        };
+
+        typedef std::vector<fulltext_posting> fulltext_postings;
+
+        /** One hit - consecutive words of a page matching the query. */
+        struct fulltext_match
+        {
+            int page{0};
+            int pos{0};
+            std::vector<int> word_ids;
+            bbox_type bbox;
+
+            maz::json_dict to_json() const;
+        };
+
+        typedef std::vector<fulltext_match> fulltext_matches;
+
+        /**
+         * Split the text to folded terms, leading and trailing punctuation is
+         * removed. Terms that are left empty are returned as empty strings so
+         * positions are kept.
+         */
+        std::vector<utf8_string> fulltext_terms(const utf8_string& text);
+
+        // =============================================================
+
+        class fulltext_builder
+        {
+          public:
+            static const char MAGIC[];
+
+          private:
+            std::unordered_map<utf8_string, fulltext_postings> terms_;
+            int pages_{0};
+            size_t postings_{0};
+
+          public:
+            /** Add all words of the page (`page_num` is the pdf page number). */
+            void add_page(int page_num, const page_type& page);
+
+            size_t term_count() const { return terms_.size(); }
+            size_t posting_count() const { return postings_; }
+
+            /** Serialize the index, returns false if the file cannot be written. */
+            bool write(const std::string& file_name) const;
+            std::string serialize() const;
+        };
+
+        // =============================================================
+
+        class fulltext_index
+        {
+            struct term_entry
+            {
+                utf8_string term;
+                uint32_t count;
+                size_t offset;
+                size_t size;
+            };
+
+          private:
+            std::vector<term_entry> terms_;
+            std::string postings_;
+            int pages_{0};
+
+          public:
+            /** Returns false if the file is missing or is not a valid index. */
+            bool load(const std::string& file_name);
+            bool deserialize(std::string data);
+
+            int page_count() const { return pages_; }
+            size_t term_count() const { return terms_.size(); }
+
+            /** Postings of `term` (folded), or of all terms starting with it. */
+            fulltext_postings postings(const utf8_string& term, bool prefix = false) const;
+
+            /**
+             * Words separated by whitespace form a phrase, a word ending with
+             * `*` matches as a prefix e.g., "invoice num*".
+             */
+            fulltext_matches find(const utf8_string& query) const;
+
+          private:
+            void decode(const term_entry& entry, fulltext_postings& out) const;
+        };
+
+    } // namespace doc
+} // namespace maz
@@ -3,12 +3,14 @@
  */
 
 #include "io-document/io-document.h"
+#include "io-document/words_index.h"
 
 #include <algorithm>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <unordered_map>
 
 #include "maz-utils/coords.h"
 #include "maz-utils/utils.h"
@@ -37,6 +39,31 @@ namespace maz {
                 return nullptr;
             }
 
+            /** The line is close enough to `bbox` to look for its words (see `words_at`). */
+            bool line_overlaps(const bbox_type& bbox, const bbox_type& lbbox)
+            {
+                static constexpr double min_overlap_y = 10.;
+                return min_overlap_y < bbox.intersects_y(lbbox);
+            }
+
+            // below this many words scanning the lines is faster than the index
+            // (see tools/bench/bench_words_index.cc)
+            constexpr size_t MIN_INDEXED_WORDS = 2500;
+
+            /** The index of the page if it has one or has enough words to need it. */
+            words_index* page_index(page_type& p)
+            {
+                if (!p.indexed())
+                {
+                    p.expand();
+                    size_t words = 0;
+                    for (const ptr_line& pline : p.lines)
+                        words += pline->size();
+                    if (words < MIN_INDEXED_WORDS) return nullptr;
+                }
+                return &p.index();
+            }
+
             maz::json_arr to_json(const perf_timer& t)
             {
                 maz::json_arr arr = make_json_arr();
@@ -47,6 +74,12 @@ namespace maz {
                 {
                     arr[2].push_back(to_json(pt));
                 }
+                if (!t.counters.empty())
+                {
+                    arr[3] = maz::make_json_dict();
+                    for (auto& c : t.counters)
+                        arr[3][c.first] = c.second;
+                }
                 return arr;
             }
 
@@ -255,37 +288,86 @@ namespace maz {
         document::words_remove(int page_idx, const bbox_type& bbox, double min_overlap)
         {
             doc::words_type removed;
-            for_each_line(
-                [bbox, &removed, min_overlap](doc::line_type& line) {
-                    if (min_overlap > line.bbox.intersects_y(bbox)) return;
-                    if (min_overlap > line.bbox.intersects_x(bbox)) return;
+            words_index* pindex = page_index(page(page_idx));
+            if (!pindex)
+            {
+                for_each_line(
+                    [bbox, &removed, min_overlap](doc::line_type& line) {
+                        if (min_overlap > line.bbox.intersects_y(bbox)) return;
+                        if (min_overlap > line.bbox.intersects_x(bbox)) return;
 
-                    for (auto it = line.begin(); it != line.end();)
-                    {
-                        auto& w = **it;
-                        if (2 * min_overlap < bbox.intersects(w.bbox))
-                        {
-                            removed.push_back(*it);
-                            it = line.erase(it);
-                        } else
+                        for (auto it = line.begin(); it != line.end();)
                         {
-                            ++it;
+                            auto& w = **it;
+                            if (2 * min_overlap < bbox.intersects(w.bbox))
+                            {
+                                removed.push_back(*it);
+                                it = line.erase(it);
+                            } else
+                            {
+                                ++it;
+                            }
                         }
-                    }
-                },
-                page_idx);
+                    },
+                    page_idx);
+                return removed;
+            }
+
+            words_index::hits_type hits = pindex->at(bbox);
+            // decide with the line bboxes before any word is removed
+            auto it_end = std::remove_if(hits.begin(), hits.end(), [&](const words_index::hit& h) {
+                const line_type& line = *h.pline;
+                if (min_overlap > line.bbox.intersects_y(bbox)) return true;
+                if (min_overlap > line.bbox.intersects_x(bbox)) return true;
+                return !(2 * min_overlap < bbox.intersects(h.pword->bbox));
+            });
+            for (auto it = hits.begin(); it != it_end; ++it)
+            {
+                removed.push_back(it->pword);
+                it->pline->erase(it->pword);
+            }
             return removed;
         }
 
         words_type document::words_at(
             int page_idx, const bbox_type& bbox, double min_overlap, lines_type* plines)
         {
-            const page_type& p = page(page_idx);
-            return maz::words_at(p.lines, bbox, min_overlap, plines);
+            assert(1. < min_overlap);
+            page_type& p = page(page_idx);
+            words_index* pindex = page_index(p);
+            if (!pindex) return maz::words_at(p.lines, bbox, min_overlap, plines);
+
+            words_index::hits_type hits = pindex->at(bbox);
+
+            std::unordered_map<const line_type*, ptr_line> line_ptrs;
+            if (plines)
+            {
+                for (const ptr_line& pline : p.lines)
+                    line_ptrs[pline.get()] = pline;
+            }
+
+            words_type ret;
+            for (const words_index::hit& h : hits)
+            {
+                if (!line_overlaps(bbox, h.pline->bbox)) continue;
+                if (min_overlap > bbox.intersects(h.pword->bbox)) continue;
+                ret.push_back(h.pword);
+                if (plines) plines->push_back(line_ptrs[h.pline]);
+            }
+            return ret;
         }
 
         bool document::erase(ptr_word pword, double min_overlap)
         {
+            // the index is only used when words were looked up with it
+            if (current_page().indexed())
+            {
+                line_type* pline = current_page().index().line(pword.get());
+                if (!pline || min_overlap > pline->bbox.intersects(pword->bbox)) return false;
+                return pline->erase(pword);
+            }
+
+            current_page().expand();
             lines_type::iterator it_line = current_page().lines.begin();
             for (; it_line != current_page().lines.end(); ++it_line)
             {
@@ -302,12 +384,19 @@ namespace maz {
         {
             auto& ls = current_page().lines;
             for (auto it = ls.begin(); it != ls.end(); ++it)
-                if (*it == val) return ls.erase(it);
+            {
+                if (*it != val) continue;
+                val->link(nullptr);
+                return ls.erase(it);
+            }
             return ls.end();
         }
 
         lines_type::iterator document::erase(lines_type::iterator first, lines_type::iterator last)
         {
+            // moved from by `std::remove_if` e.g., in `remove_empty`
+            for (auto it = first; it != last; ++it)
+                if (*it) (*it)->link(nullptr);
             return current_page().lines.erase(first, last);
         }
 
@@ -315,6 +404,8 @@ namespace maz {
         {
             if (pword->empty(true)) return false;
 
+            current_page().expand();
+
             // more sophisticated
             if (words_structure_) return words_structure_->add(pword);
 
@@ -327,6 +418,9 @@ namespace maz {
         void document::add(lines_type::iterator start, lines_type::iterator end)
         {
             auto start_y = (*start)->bbox.ylt();
+            current_page().expand();
+            for (auto it = start; it != end; ++it)
+                current_page().index_line(*it);
             auto& ls = current_page().lines;
             for (auto it = ls.begin(); it != ls.end(); ++it)
             {
@@ -345,7 +439,14 @@ namespace maz {
         void document::new_line()
         {
             if (doc_.pages.empty()) return start_page();
-            current_page().lines.push_back(ptr_line(new line_type));
+            page_type& p = current_page();
+            if (p.flat)
+                p.flat->new_line();
+            else
+            {
+                p.lines.push_back(ptr_line(new line_type));
+                p.index_line(p.lines.back());
+            }
         }
 
         void document::start_page()
@@ -361,13 +462,24 @@ namespace maz {
             start_page();
         }
 
-        void document::end_page(confidence_type confidence) { page_confidence(confidence); }
+        void document::end_page(confidence_type confidence)
+        {
+            // words of a compact page could have been added to lines above
+            if (current_page().flat) current_page().flat->pack();
+            page_confidence(confidence);
+        }
 
-        void document::clear_lines(size_t idx) { page(idx).lines.clear(); }
+        void document::clear_lines(size_t idx)
+        {
+            page(idx).drop_index();
+            page(idx).flat.reset();
+            page(idx).lines.clear();
+        }
 
         void document::remove_empty(size_t idx)
         {
             // delete all empty lines
+            page(idx).expand();
             lines_type& lines = page(idx).lines;
 
             // erase words to ignore
@@ -388,7 +500,12 @@ namespace maz {
                 lines.end());
         }
 
-        void document::lines(size_t idx, const lines_type& lines) { page(idx).lines = lines; }
+        void document::lines(size_t idx, const lines_type& lines)
+        {
+            page(idx).drop_index();
+            page(idx).flat.reset();
+            page(idx).lines = lines;
+        }
 
         //
         //
@@ -508,6 +625,7 @@ namespace maz {
             for (maz::json_arr::const_iterator it = lines.begin(); it != lines.end(); ++it)
             {
                 current_page().lines.push_back(ptr_line(new line_type(*it)));
+                current_page().index_line(current_page().lines.back());
             }
 
             // confidence
@@ -550,6 +668,7 @@ namespace maz {
         {
             for (auto& page : doc_.pages)
             {
+                if (page->flat) page->flat->remove_empty_lines();
                 // store only non null words/lines
                 lines_type& lines = page->lines;
                 auto line_it = lines.begin();
@@ -591,6 +710,8 @@ namespace maz {
             words_structure_.reset(ws);
             for (size_t i = 0; i < page_count(); ++i)
             {
+                page(i).expand();
+                page(i).drop_index();
                 words_structure_->reformat(i, page(i));
             }
         }
@@ -640,11 +761,6 @@ namespace maz {
     {
         assert(1. < min_overlap);
 
-        static const auto overlaps = [](const bbox_type& bb, const bbox_type& lb) {
-            static constexpr double min_overlap_y = 10.;
-            return min_overlap_y < bb.intersects_y(lb);
-        };
-
         doc::words_type ret;
 
         // not smarties about start - see description of `words_at`
@@ -653,7 +769,7 @@ namespace maz {
         for (auto it = sel; it != lines.end(); ++it)
         {
             doc::line_type& l = **it;
-            if (overlaps(bbox, l.bbox))
+            if (doc::line_overlaps(bbox, l.bbox))
             {
                 auto words = l.at(bbox, min_overlap);
                 if (plines) plines->insert(plines->end(), words.size(), *it);
@@ -11,6 +11,7 @@
 
 // include the underlying implementation
 #include "io-document/elements.h"
+#include "io-document/flat.h"
 #include "io-document/statistics.h"
 #include "io-document/types.h"
 #include "maz-utils/params.h"
@@ -248,6 +249,11 @@ namespace maz {
             doc::words_type
             words_remove(int page_idx, const bbox_type& bbox, double min_overlap = 20.);
 
+            /**
+             * The same words as `maz::words_at`. Pages with many words are
+             * searched with their index (`page_type::index`) and the words
+             * are ordered by the top and left of their lines.
+             */
             words_type words_at(
                 int page_idx,
                 const bbox_type& bbox,
@@ -280,6 +286,9 @@ namespace maz {
             template <typename T> T for_each_line(T ftor, size_t idx = 0)
             {
                 page_type& p = page(idx);
+                p.expand();
+                // words can be moved
+                p.drop_index();
 
                 lines_type::iterator it_line = p.lines.begin();
                 for (; it_line != p.lines.end(); ++it_line)
@@ -363,7 +372,8 @@ namespace maz {
      * Optionally returns pointer to lines where each word resides.
      *
      * NOTE: we cannot use binary search because of sorting based on `ylt`
-     * but we require `yrb`.
+     * but we require `yrb` - `document::words_at` uses the page index
+     * (`page_type::index`) instead.
      */
     doc::words_type words_at(
         const doc::lines_type& lines,
@@ -4,6 +4,7 @@
 
 #include "io-document/statistics.h"
 #include "io-document/elements.h"
+#include "io-document/flat.h"
 #include "unilib/text.h"
 #include <limits>
 
@@ -700,6 +701,31 @@ namespace maz {
             if (0 < counts.chars) means.w_letter /= counts.chars;
         }
 
+        void page_statistics::init(const flat_page& page)
+        {
+            counts = {};
+            means = {};
+            std::list<double> heights;
+
+            for (const flat_page::line& line : page.lines())
+            {
+                ++counts.lines;
+                heights.push_back(line.bbox.height());
+            }
+            for (const flat_page::word& w : page.words())
+            {
+                ++counts.words;
+                means.h_word += w.height();
+                means.w_letter += w.width();
+                counts.chars += static_cast<int>(w.letter_count);
+                if (w.has(flat_page::FROM_DICT)) ++(counts.from_dict);
+            }
+
+            if (0 < counts.lines) means.h_line = rank(heights, 0.15);
+            if (0 < counts.words) means.h_word /= counts.words;
+            if (0 < counts.chars) means.w_letter /= counts.chars;
+        }
+
         word_statistics::counts_type::counts_type(int uppers_similar)
             : uppers_similar(uppers_similar)
         {
@@ -224,6 +224,7 @@ namespace maz {
             }
 
             void init(line_iterator s, line_iterator e);
+            void init(const flat_page& page);
         };
 
     } // namespace doc
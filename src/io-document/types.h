@@ -34,6 +34,10 @@ namespace maz {
 
         class letter_type;
 
+        class flat_page;
+
+        class words_index;
+
         // holds value information
         using maz::bbox_type;
 
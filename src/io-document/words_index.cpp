@@ -0,0 +1,163 @@
+/**
+ * by Mazoea s.r.o.
+ */
+
+#include "io-document/words_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "io-document/elements.h"
+
+namespace maz {
+    namespace doc {
+
+        //====================================
+        // words_index
+        //====================================
+
+        constexpr int words_index::BASE_CELL;
+        constexpr int words_index::LEVELS;
+
+        int words_index::level(const bbox_type& bbox)
+        {
+            const double size = maz_max(bbox.width(), bbox.height());
+            int l = 0;
+            while (l < LEVELS - 1 && static_cast<double>(BASE_CELL << l) < size)
+                ++l;
+            return l;
+        }
+
+        words_index::cell_key words_index::key(int64_t cx, int64_t cy)
+        {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+                   static_cast<uint32_t>(cy);
+        }
+
+        int64_t words_index::cell(double v, int level)
+        {
+            return static_cast<int64_t>(std::floor(v / (BASE_CELL << level)));
+        }
+
+        void words_index::insert(entry& e)
+        {
+            const bbox_type& b = e.pword->bbox;
+            e.level = level(b);
+            e.cell = key(cell(b.xlt(), e.level), cell(b.ylt(), e.level));
+            levels_[e.level][e.cell].push_back(&e);
+        }
+
+        void words_index::erase(const entry& e)
+        {
+            cells_type& cells = levels_[e.level];
+            auto it = cells.find(e.cell);
+            assert(it != cells.end());
+            cell_type& c = it->second;
+            auto it_w = std::find(c.begin(), c.end(), &e);
+            assert(it_w != c.end());
+            *it_w = c.back();
+            c.pop_back();
+            if (c.empty()) cells.erase(it);
+        }
+
+        void words_index::add(const ptr_word& pword, line_type* pline)
+        {
+            auto it = entries_.find(pword.get());
+            if (it != entries_.end())
+            {
+                it->second.pline = pline;
+                return;
+            }
+            entry& e = entries_[pword.get()];
+            e.pword = pword;
+            e.pline = pline;
+            e.seq = seq_++;
+            insert(e);
+        }
+
+        void words_index::remove(const word_type* pw, const line_type* pline)
+        {
+            auto it = entries_.find(pw);
+            if (it == entries_.end() || it->second.pline != pline) return;
+            erase(it->second);
+            entries_.erase(it);
+        }
+
+        void words_index::update(const ptr_word& pword)
+        {
+            auto it = entries_.find(pword.get());
+            if (it == entries_.end()) return;
+            erase(it->second);
+            insert(it->second);
+        }
+
+        line_type* words_index::line(const word_type* pw) const
+        {
+            auto it = entries_.find(pw);
+            return (it == entries_.end()) ? nullptr : it->second.pline;
+        }
+
+        words_index::hits_type words_index::at(const bbox_type& bbox) const
+        {
+            std::vector<const entry*> found;
+            const auto check = [&](const cell_type& c) {
+                for (const entry* e : c)
+                {
+                    const bbox_type& b = e->pword->bbox;
+                    if (b.xrb() < bbox.xlt() || bbox.xrb() < b.xlt()) continue;
+                    if (b.yrb() < bbox.ylt() || bbox.yrb() < b.ylt()) continue;
+                    found.push_back(e);
+                }
+            };
+
+            for (int l = 0; l < LEVELS; ++l)
+            {
+                const cells_type& cells = levels_[l];
+                if (cells.empty()) continue;
+
+                // a word starts at most one cell before the query
+                const double size = BASE_CELL << l;
+                const int64_t x1 = cell(bbox.xlt() - size, l), x2 = cell(bbox.xrb(), l);
+                const int64_t y1 = cell(bbox.ylt() - size, l), y2 = cell(bbox.yrb(), l);
+                const double query_cells =
+                    static_cast<double>(x2 - x1 + 1) * static_cast<double>(y2 - y1 + 1);
+
+                // words of the last level can be bigger than its cells
+                if (l == LEVELS - 1 || static_cast<double>(cells.size()) < query_cells)
+                {
+                    for (const auto& c : cells)
+                        check(c.second);
+                    continue;
+                }
+
+                for (int64_t cy = y1; cy <= y2; ++cy)
+                {
+                    for (int64_t cx = x1; cx <= x2; ++cx)
+                    {
+                        auto it = cells.find(key(cx, cy));
+                        if (it != cells.end()) check(it->second);
+                    }
+                }
+            }
+
+            // reading order of a sorted page
+            std::sort(found.begin(), found.end(), [](const entry* l, const entry* r) {
+                const bbox_type& lb = l->pline->bbox;
+                const bbox_type& rb = r->pline->bbox;
+                if (lb.ylt() != rb.ylt()) return lb.ylt() < rb.ylt();
+                if (lb.xlt() != rb.xlt()) return lb.xlt() < rb.xlt();
+                if (l->pword->bbox.xlt() != r->pword->bbox.xlt())
+                    return l->pword->bbox.xlt() < r->pword->bbox.xlt();
+                return l->seq < r->seq;
+            });
+
+            hits_type ret;
+            ret.reserve(found.size());
+            for (const entry* e : found)
+                ret.push_back(hit{e->pword, e->pline});
+            return ret;
+        }
+
+    } // namespace doc
+} // namespace maz
@@ -0,0 +1,99 @@
+//
+// author: jm (Mazoea s.r.o.)
+// date: 2026
+//
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "io-document/types.h"
+
+namespace maz {
+    namespace doc {
+
+        //====================================
+        // spatial index of words
+        //====================================
+
+        /*
+         * Multi-level grid of the words of a page (see `page_type::index`).
+         *
+         * Level `k` has square cells of `BASE_CELL << k` pixels and a word is
+         * stored in the first level whose cells are at least as big as the
+         * word, in the cell of its top left corner. A word overlapping a query
+         * is then in one of the cells overlapping the query extended by one
+         * cell to the top and left, so a query looks at a few cells per level
+         * - the number of levels is logarithmic in the size of the biggest word.
+         *
+         * Lines linked to the index (`line_type::link`) keep it in sync when
+         * words are added or removed through them (`push_back`, `erase`,
+         * `split`, `merge`...). Words changed in place e.g., with a new bbox,
+         * must be `update`d.
+         */
+        class words_index
+        {
+          public:
+            static constexpr int BASE_CELL = 16;
+            static constexpr int LEVELS = 16;
+
+            struct hit
+            {
+                ptr_word pword;
+                line_type* pline;
+            };
+            typedef std::vector<hit> hits_type;
+
+          private:
+            typedef uint64_t cell_key;
+
+            struct entry
+            {
+                ptr_word pword;
+                line_type* pline;
+                int level;
+                cell_key cell;
+                // insertion order, keeps the order of hits stable
+                uint64_t seq;
+            };
+
+            // entries are not moved by `entries_`
+            typedef std::vector<const entry*> cell_type;
+            typedef std::unordered_map<cell_key, cell_type> cells_type;
+
+            std::unordered_map<const word_type*, entry> entries_;
+            cells_type levels_[LEVELS];
+            uint64_t seq_{0};
+
+          public:
+            /** Add the word or move it to `pline`. */
+            void add(const ptr_word& pword, line_type* pline);
+
+            /** Remove the word if it is in `pline`. */
+            void remove(const word_type* pw, const line_type* pline);
+
+            /** Re-add a word whose bbox has changed. */
+            void update(const ptr_word& pword);
+
+            /** Returns the line of the word or nullptr. */
+            line_type* line(const word_type* pw) const;
+
+            size_t size() const { return entries_.size(); }
+
+            /**
+             * Words whose bbox overlaps `bbox` ordered by the top and left of
+             * their line and then by their left (the order of a sorted page).
+             */
+            hits_type at(const bbox_type& bbox) const;
+
+          private:
+            static int level(const bbox_type& bbox);
+            static cell_key key(int64_t cx, int64_t cy);
+            static int64_t cell(double v, int level);
+            void insert(entry& e);
+            void erase(const entry& e);
+        };
+
+    } // namespace doc
+} // namespace maz
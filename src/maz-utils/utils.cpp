@@ -429,4 +429,16 @@ namespace maz {
         return _hash_fnv<fnv_prime32, fnv_offset_basis32>(buf, len);
     }
 
+    uint64_t hash_fnv64(const unsigned char* buf, std::size_t len, uint64_t seed)
+    {
+        static constexpr uint64_t fnv_prime64 = 1099511628211u;
+        uint64_t hash = seed;
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            hash ^= buf[i];
+            hash *= fnv_prime64;
+        }
+        return hash;
+    }
+
 } // namespace maz
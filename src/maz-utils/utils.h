@@ -582,6 +582,8 @@ namespace maz {
         std::string name;
         double elapsed{-1.};
         std::list<perf_timer> blocks;
+        // e.g., allocation counts of the block
+        std::vector<std::pair<std::string, long>> counters;
 
         clock_t s_{};
 
@@ -614,6 +616,14 @@ namespace maz {
      */
     std::size_t hash_fnv(const unsigned char* buf, std::size_t len);
 
+    static constexpr uint64_t hash_fnv64_seed = 14695981039346656037u;
+
+    /**
+     * 64 bit FNV-1a over a buffer, pass the previous result as `seed` to hash
+     * more buffers (e.g., cache keys).
+     */
+    uint64_t hash_fnv64(const unsigned char* buf, std::size_t len, uint64_t seed = hash_fnv64_seed);
+
 } // namespace maz
 
 //========================================
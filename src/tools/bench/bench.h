@@ -0,0 +1,47 @@
+//
+// author: jm (Mazoea s.r.o.)
+//
+// helpers shared by the benchmarks
+//
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+    // wall clock time in seconds
+    inline double seconds()
+    {
+        return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // an in-memory PDF file of the objects `objs` (object `i + 1` is `objs[i]`,
+    // the first one is the catalog)
+    inline std::string write_pdf(const std::vector<std::string>& objs)
+    {
+        std::string pdf = "%PDF-1.4\n";
+        std::vector<size_t> offsets;
+        for (size_t i = 0; i < objs.size(); ++i)
+        {
+            offsets.push_back(pdf.size());
+            pdf += std::to_string(i + 1) + " 0 obj\n" + objs[i] + "\nendobj\n";
+        }
+        const size_t xref = pdf.size();
+        pdf += "xref\n0 " + std::to_string(objs.size() + 1) + "\n0000000000 65535 f \n";
+        for (size_t offset : offsets)
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%010zu 00000 n \n", offset);
+            pdf += buf;
+        }
+        pdf += "trailer\n<< /Size " + std::to_string(objs.size() + 1) +
+               " /Root 1 0 R >>\nstartxref\n" + std::to_string(xref) + "\n%%EOF\n";
+        return pdf;
+    }
+
+} // namespace bench
@@ -0,0 +1,324 @@
+/*
+ *  Mazoea s.r.o.
+ *  @author jm
+ */
+
+//
+// Czech and Slovak text with the accents drawn as separate glyphs - the
+// accent merging of `accented::word` and the `UnicodeMapAccent` tables.
+//  - lookups: letter/accent pairs of Czech text through `accented_pair`
+//    and `translate`, and the letters of both alphabets which must be
+//    composed from their accents
+//  - pages: synthetic pages where each accent is moved over its letter
+//    (before or after it in the content stream) are extracted in reading
+//    order and the words are compared with the generated ones
+// Extraction on several threads at once is checked by `pdf_to_text --stress`.
+//
+// bench_accents [--pages=20] [--words=1000] [--lookups=5000000]
+//
+
+#include <aconf.h>
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "maz-utils/params.h"
+#include "goo/GString.h"
+#include "xpdf/GlobalParams.h"
+#include "xpdf/Object.h"
+#include "xpdf/PDFDoc.h"
+#include "xpdf/Stream.h"
+#include "xpdf/TextOutputDev.h"
+#include "xpdf/UnicodeMapAccent.h"
+
+using namespace bench;
+using namespace maz;
+
+namespace {
+
+    typedef std::vector<std::string> words_type;
+
+    std::string utf8(Unicode u)
+    {
+        std::string s;
+        if (u < 0x80)
+        {
+            s += static_cast<char>(u);
+        } else
+        {
+            s += static_cast<char>(0xC0 | (u >> 6));
+            s += static_cast<char>(0x80 | (u & 0x3F));
+        }
+        return s;
+    }
+
+    //==============================
+    // accents
+    //==============================
+
+    struct accent_type
+    {
+        const char* name;
+        // StandardEncoding code and Unicode of the glyph, Helvetica width
+        int code;
+        Unicode u;
+        int width;
+    };
+
+    const accent_type CARON = {"caron", 0317, 0x2C7, 333};
+    const accent_type ACUTE = {"acute", 0302, 0xB4, 333};
+    const accent_type RING = {"ring", 0312, 0x2DA, 333};
+    const accent_type DIAERESIS = {"dieresis", 0310, 0xA8, 333};
+    const accent_type CIRCUMFLEX = {"circumflex", 0303, 0x2C6, 333};
+
+    struct accented_type
+    {
+        char letter;
+        const accent_type* accent;
+        Unicode composed;
+    };
+
+    // the accented letters of Czech and Slovak
+    const std::vector<accented_type> accented = {
+        {'a', &ACUTE, 0xE1},
+        {'a', &DIAERESIS, 0xE4},
+        {'c', &CARON, 0x10D},
+        {'d', &CARON, 0x10F},
+        {'e', &ACUTE, 0xE9},
+        {'e', &CARON, 0x11B},
+        {'i', &ACUTE, 0xED},
+        {'l', &ACUTE, 0x13A},
+        {'n', &CARON, 0x148},
+        {'o', &ACUTE, 0xF3},
+        {'o', &CIRCUMFLEX, 0xF4},
+        {'r', &CARON, 0x159},
+        {'s', &CARON, 0x161},
+        {'t', &CARON, 0x165},
+        {'u', &ACUTE, 0xFA},
+        {'u', &RING, 0x16F},
+        {'y', &ACUTE, 0xFD},
+        {'z', &CARON, 0x17E},
+    };
+
+    // Helvetica widths of the letters used
+    int letter_width(char c)
+    {
+        switch (c)
+        {
+        case 'i':
+        case 'l':
+            return 222;
+        case 'm':
+            return 833;
+        case 'r':
+            return 333;
+        case 't':
+            return 278;
+        case 'c':
+        case 's':
+        case 'v':
+        case 'y':
+        case 'z':
+            return 500;
+        default:
+            return 556;
+        }
+    }
+
+    //==============================
+    // synthetic pages
+    //==============================
+
+    struct document_type
+    {
+        std::string pdf;
+        words_type words;
+    };
+
+    // `pages` pages of 9pt Helvetica, 10 words per line, about a third of
+    // the letters with an accent
+    document_type generate(int pages, int words)
+    {
+        static const std::string letters = "abcdeilmnoprstuvyz";
+
+        std::mt19937 rng(pages * 7 + words);
+        std::uniform_int_distribution<int> length(2, 9), letter(0, static_cast<int>(letters.size()) - 1);
+        std::uniform_real_distribution<double> chance(0, 1);
+
+        document_type doc;
+        std::vector<std::string> contents;
+        for (int p = 0; p < pages; ++p)
+        {
+            std::ostringstream content;
+            content << "BT /F1 9 Tf 12 TL 40 " << 40 + 12 * (words / 10) << " Td\n";
+            for (int k = 0; k < words; ++k)
+            {
+                std::string word;
+                content << "[";
+                for (int n = length(rng); 0 < n; --n)
+                {
+                    const char c = letters[letter(rng)];
+                    std::vector<const accented_type*> candidates;
+                    for (const accented_type& a : accented)
+                    {
+                        if (a.letter == c) candidates.push_back(&a);
+                    }
+                    if (candidates.empty() || 0.35 <= chance(rng))
+                    {
+                        content << "(" << c << ")";
+                        word += c;
+                        continue;
+                    }
+                    const accented_type& a = *candidates[rng() % candidates.size()];
+                    const int lw = letter_width(c), aw = a.accent->width;
+                    char code[8];
+                    snprintf(code, sizeof(code), "(\\%03o)", a.accent->code);
+                    // the letter and the accent moved back over it, or
+                    // the accent and the letter moved back under it
+                    if (chance(rng) < 0.7)
+                        content << "(" << c << ") " << (lw + aw) / 2 << " " << code << " "
+                                << -((lw - aw) / 2) << " ";
+                    else
+                        content << -((lw - aw) / 2) << " " << code << " " << (lw + aw) / 2 << " ("
+                                << c << ") ";
+                    word += utf8(a.composed);
+                }
+                content << "] TJ ( ) Tj" << ((9 == k % 10) ? " T*\n" : " ");
+                doc.words.push_back(word);
+            }
+            content << "ET";
+            contents.push_back(content.str());
+        }
+
+        const int height = 80 + 12 * (words / 10);
+        std::vector<std::string> objs = {"<< /Type /Catalog /Pages 2 0 R >>", "",
+            "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"};
+        std::string kids;
+        for (int p = 0; p < pages; ++p)
+        {
+            kids += std::to_string(4 + 2 * p) + " 0 R ";
+            objs.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 800 " +
+                           std::to_string(height) + "] /Contents " + std::to_string(5 + 2 * p) +
+                           " 0 R /Resources << /Font << /F1 3 0 R >> >> >>");
+            objs.push_back("<< /Length " + std::to_string(contents[p].size()) + " >>\nstream\n" +
+                           contents[p] + "\nendstream");
+        }
+        objs[1] = "<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(pages) + " >>";
+
+        doc.pdf = write_pdf(objs);
+        return doc;
+    }
+
+    //==============================
+    // benchmarks
+    //==============================
+
+    void bench_lookups(int lookups)
+    {
+        // letters and accents of Czech text, as seen by addChar
+        const Unicode text[] = {'c', 711, 'e', 180, 'r', 0x2019, 'a', 730, 'u', 'z', 780, 's', 'x',
+            'n', 769, 'o', 'y', 'i', 'l', 't'};
+        const int n = sizeof(text) / sizeof(text[0]);
+
+        unsigned long sum = 0;
+        double t0 = seconds();
+        for (int i = 0; i < lookups; ++i)
+        {
+            for (int j = 0; j + 1 < n; ++j)
+            {
+                Unicode a = text[j], l = text[j + 1];
+                if (UnicodeMapAccent::accented_pair(a, l))
+                {
+                    int found;
+                    sum += UnicodeMapAccent::translate(a, l, found) + found;
+                }
+            }
+        }
+        double t1 = seconds();
+
+        std::string wrong;
+        for (const accented_type& a : accented)
+        {
+            int found;
+            Unicode u = UnicodeMapAccent::translate(a.accent->u, a.letter, found);
+            if (UnicodeMapAccent::FOUND != found || u != a.composed)
+                wrong += std::string(" ") + a.letter + "+" + a.accent->name;
+        }
+
+        std::cout << "lookups: " << (t1 - t0) * 1e9 / (static_cast<double>(lookups) * (n - 1))
+                  << " ns/pair (" << sum << "), letters not composed "
+                  << (wrong.empty() ? std::string(" none") : wrong) << std::endl;
+    }
+
+    void append(void* stream, const char* text, int len)
+    {
+        static_cast<std::string*>(stream)->append(text, len);
+    }
+
+    void bench_pages(int pages, int words)
+    {
+        document_type doc = generate(pages, words);
+
+        Object obj;
+        obj.initNull();
+        PDFDoc pdf_doc(new MemStream(&doc.pdf[0], 0, static_cast<Guint>(doc.pdf.size()), &obj));
+        if (!pdf_doc.isOk())
+        {
+            std::cout << "pages: cannot open the document" << std::endl;
+            return;
+        }
+        std::string text;
+        TextOutputDev dev(&append, &text, gFalse, 0, gFalse);
+        double t0 = seconds();
+        pdf_doc.displayPages(&dev, 1, pages, 72, 72, 0, gFalse, gTrue, gFalse);
+        double t1 = seconds();
+
+        std::istringstream in(text);
+        words_type extracted;
+        for (std::string word; in >> word;)
+            extracted.push_back(word);
+        size_t different = 0;
+        for (size_t i = 0; i < doc.words.size(); ++i)
+        {
+            if (i >= extracted.size() || extracted[i] != doc.words[i]) ++different;
+        }
+
+        std::cout << "pages: " << pages << " x " << words << " words in " << t1 - t0 << " s ("
+                  << (t1 - t0) * 1e6 / (static_cast<double>(pages) * words) << " us/word), words "
+                  << extracted.size() << "/" << doc.words.size() << ", different " << different
+                  << std::endl;
+    }
+
+    env_type get_options(char** argv, int argc)
+    {
+        env_type args;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (parse_option(args, argv[i], "pages")) continue;
+            if (parse_option(args, argv[i], "words")) continue;
+            if (parse_option(args, argv[i], "lookups")) continue;
+        }
+        return args;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    env_type env = get_options(argv, argc);
+
+    globalParams = new GlobalParams(NULL);
+    globalParams->setTextEncoding(const_cast<char*>("UTF-8"));
+    globalParams->setErrQuiet(gTrue);
+
+    bench_lookups(get_env_val<int>(env, "lookups", 5000000));
+    bench_pages(get_env_val<int>(env, "pages", 20), get_env_val<int>(env, "words", 1000));
+
+    delete globalParams;
+    return 0;
+}
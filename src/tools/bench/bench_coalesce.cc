@@ -0,0 +1,246 @@
+/*
+ *  Mazoea s.r.o.
+ *  @author jm
+ */
+
+//
+// Text extraction of dense synthetic pages - `TextPage::coalesce` builds
+// the blocks, columns and flows of pages with 1k - 100k words:
+//  - sheet   rows of cells close to each other (columns merge into tall blocks)
+//  - scatter isolated cells (a block per word)
+//  - mixed   alternating font sizes and ragged columns
+// Each page is extracted in physical layout and in reading order. The word
+// order is compared with the order the page was generated in (row by row
+// in physical layout, column by column in reading order of sheets - mixed
+// pages have a few breaks where the font size changes) and the digest of
+// the text allows comparing the output of two builds.
+//
+// bench_coalesce [--words=10000] [--layout=sheet|scatter|mixed] [--rotate=0|1|2|3|r]
+//
+
+#include <aconf.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "maz-utils/params.h"
+#include "goo/GString.h"
+#include "xpdf/GlobalParams.h"
+#include "xpdf/Object.h"
+#include "xpdf/PDFDoc.h"
+#include "xpdf/Stream.h"
+#include "xpdf/TextOutputDev.h"
+
+using namespace bench;
+using namespace maz;
+
+namespace {
+
+    typedef std::vector<std::string> words_type;
+
+    //==============================
+    // synthetic pages
+    //==============================
+
+    struct page_type
+    {
+        std::string pdf;
+        // words row by row and column by column
+        words_type rows, columns;
+    };
+
+    // one page with `words` Helvetica words in a grid, `rotate` is 0 - 3
+    // (multiples of 90 degrees) or 'r' (random for each word)
+    page_type generate(const std::string& layout, int words, char rotate)
+    {
+        static const char* matrices[4] = {"1 0 0 1", "0 1 -1 0", "-1 0 0 -1", "0 -1 1 0"};
+        static const char* suffixes[4] = {"", ".5", "x", "ab"};
+
+        std::mt19937 rng(words);
+        std::uniform_int_distribution<int> number(0, 99999), suffix(0, 3), jitter(0, 25);
+
+        const bool sheet = ("sheet" == layout);
+        const int cols = std::max(1, static_cast<int>(std::sqrt(words / (sheet ? 30. : 3.))));
+        const int rows = (words + cols - 1) / cols;
+        const int dx = 60, dy = sheet ? 8 : ("scatter" == layout) ? 20 : 9;
+        const int width = cols * dx + 40, height = rows * dy + 40;
+        const double font_size = 6;
+
+        page_type page;
+        std::vector<words_type> columns(cols);
+        std::set<std::string> used;
+        std::ostringstream content;
+        content << "BT\n";
+        for (int r = 0, k = 0; r < rows; ++r)
+        {
+            for (int c = 0; c < cols && k < words; ++c, ++k)
+            {
+                double size = font_size;
+                double x = 20 + c * dx;
+                if ("mixed" == layout)
+                {
+                    size = ((r / 3 + c) % 2) ? font_size * 1.6 : font_size;
+                    x += jitter(rng);
+                }
+                const double y = height - 20 - r * dy;
+                std::string word;
+                do
+                {
+                    word = std::to_string(number(rng)) + suffixes[suffix(rng)];
+                } while (!used.insert(word).second);
+                const char* m = matrices[('r' == rotate) ? suffix(rng) : rotate - '0'];
+                content << "/F1 " << size << " Tf " << m << " " << x << " " << y << " Tm (" << word
+                        << ") Tj\n";
+                page.rows.push_back(word);
+                columns[c].push_back(word);
+            }
+        }
+        content << "ET";
+        for (const words_type& column : columns)
+            page.columns.insert(page.columns.end(), column.begin(), column.end());
+
+        const std::string stream = content.str();
+        std::vector<std::string> objs = {
+            "<< /Type /Catalog /Pages 2 0 R >>",
+            "<< /Type /Pages /Kids [3 0 R] /Count 1 >>",
+            "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + std::to_string(width) + " " +
+                std::to_string(height) +
+                "] /Contents 4 0 R /Resources << /Font << /F1 5 0 R >> >> >>",
+            "<< /Length " + std::to_string(stream.size()) + " >>\nstream\n" + stream + "\nendstream",
+            "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"};
+
+        page.pdf = write_pdf(objs);
+        return page;
+    }
+
+    //==============================
+    // extraction
+    //==============================
+
+    void append(void* stream, const char* text, int len)
+    {
+        static_cast<std::string*>(stream)->append(text, len);
+    }
+
+    unsigned long long digest(const std::string& s)
+    {
+        unsigned long long h = 1469598103934665603ULL;
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // number of consecutive extracted words which do not follow each other
+    // in `expected` (words missing from the output count too)
+    size_t order_breaks(const std::string& text, const words_type& expected)
+    {
+        std::unordered_map<std::string, size_t> position;
+        for (size_t i = 0; i < expected.size(); ++i)
+            position[expected[i]] = i;
+
+        std::istringstream in(text);
+        std::string word;
+        size_t breaks = 0, found = 0, last = 0;
+        for (bool first = true; in >> word; first = false)
+        {
+            auto it = position.find(word);
+            if (it == position.end())
+            {
+                ++breaks;
+                continue;
+            }
+            ++found;
+            if (!first && it->second != last + 1) ++breaks;
+            last = it->second;
+        }
+        return breaks + (expected.size() - found);
+    }
+
+    void bench_page(const std::string& layout, int words, char rotate)
+    {
+        page_type page = generate(layout, words, rotate);
+        std::cout << layout << " " << words << " words, rotate " << rotate << ":";
+
+        for (int phys = 1; phys >= 0; --phys)
+        {
+            Object obj;
+            obj.initNull();
+            PDFDoc doc(new MemStream(&page.pdf[0], 0, static_cast<Guint>(page.pdf.size()), &obj));
+            if (!doc.isOk())
+            {
+                std::cout << " cannot open the page" << std::endl;
+                return;
+            }
+            std::string text;
+            TextOutputDev dev(&append, &text, phys ? gTrue : gFalse, 0, gFalse);
+            double t0 = seconds();
+            doc.displayPages(&dev, 1, 1, 72, 72, 0, gFalse, gTrue, gFalse);
+            double t1 = seconds();
+
+            std::cout << (phys ? " phys " : ", reading order ") << t1 - t0 << " s";
+            // the generated order is known only for upright pages
+            if ('0' == rotate && (phys || "sheet" == layout))
+            {
+                std::cout << " (order breaks "
+                          << order_breaks(text, phys ? page.rows : page.columns) << ")";
+            }
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%016llx", digest(text));
+            std::cout << " digest " << buf;
+        }
+        std::cout << std::endl;
+    }
+
+    env_type get_options(char** argv, int argc)
+    {
+        env_type args;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (parse_option(args, argv[i], "words")) continue;
+            if (parse_option(args, argv[i], "layout")) continue;
+            if (parse_option(args, argv[i], "rotate")) continue;
+        }
+        return args;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    env_type env = get_options(argv, argc);
+
+    std::vector<int> sizes = {1000, 10000, 30000, 100000};
+    if (env.end() != env.find("words")) sizes = {get_env_val<int>(env, "words", 10000)};
+    std::vector<std::string> layouts = {"sheet", "scatter", "mixed"};
+    if (env.end() != env.find("layout")) layouts = {get_env_val<std::string>(env, "layout", "")};
+    std::string rotations = "0";
+    if (env.end() != env.find("rotate")) rotations = get_env_val<std::string>(env, "rotate", "0");
+
+    globalParams = new GlobalParams(NULL);
+    globalParams->setTextEncoding(const_cast<char*>("UTF-8"));
+    globalParams->setErrQuiet(gTrue);
+
+    for (const std::string& layout : layouts)
+    {
+        for (int words : sizes)
+        {
+            for (char rotate : rotations)
+                bench_page(layout, words, rotate);
+        }
+    }
+
+    delete globalParams;
+    return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ *  Mazoea s.r.o.
+ *  @author jm
+ */
+
+//
+// Scan conversion of many small paths - `SplashXPathScanner::getSpan`
+// (coverage cells) against `getSpanExact` (exact trapezoid areas, the
+// reference). The accuracy part compares the shape values of every row of
+// random paths of several classes, the throughput part converts every row
+// of glyph-like paths and rectangles, as on text-heavy vector pages.
+//
+// bench_scanner [--paths=3000] [--passes=3]
+//
+
+#include <aconf.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "maz-utils/params.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashXPath.h"
+#include "splash/SplashXPathScanner.h"
+
+using namespace bench;
+using namespace maz;
+
+namespace {
+
+    const double PI = 3.14159265358979323846;
+
+    enum path_kind
+    {
+        CONVEX,
+        GLYPH,
+        STAR,
+        STAR_EO,
+        RECT,
+        RECTS,
+        RANDOM_EO,
+        KINDS
+    };
+
+    const char* kind_names[KINDS] = {"convex polygon", "glyph-like (curves + hole)",
+        "star, nonzero", "star, even-odd", "rectangle", "overlapping rects, nonzero",
+        "random polygon, even-odd"};
+
+    typedef std::unique_ptr<SplashXPath> ptr_xpath;
+
+    //==============================
+    // paths
+    //==============================
+
+    class path_generator
+    {
+        std::mt19937 rng_;
+
+      public:
+        explicit path_generator(unsigned seed) : rng_(seed) {}
+
+        double rnd(double a, double b) { return std::uniform_real_distribution<double>(a, b)(rng_); }
+
+        int rnd_int(int n) { return std::uniform_int_distribution<int>(0, n - 1)(rng_); }
+
+        // a path of `kind` around (cx, cy) of size about `s` pixels
+        ptr_xpath make(path_kind kind, double cx, double cy, double s)
+        {
+            SplashPath path;
+            switch (kind)
+            {
+            case CONVEX:
+                polygon(path, cx, cy, s, 3 + rnd_int(8), 1);
+                break;
+            case GLYPH:
+                glyph(path, cx, cy, s);
+                break;
+            case STAR:
+            case STAR_EO:
+                polygon(path, cx, cy, s, 5 + 2 * rnd_int(3), 2);
+                break;
+            case RECT:
+                rect(path, cx, cy, rnd(0.2, 2 * s), rnd(0.2, 2 * s));
+                break;
+            case RECTS:
+            {
+                const double w = rnd(1, 2 * s), h = rnd(1, 2 * s);
+                rect(path, cx, cy, w, h);
+                rect(path, cx + rnd(0, w), cy + rnd(0, h), w, h);
+                break;
+            }
+            default:
+            {
+                const int n = 4 + rnd_int(10);
+                for (int i = 0; i < n; ++i)
+                {
+                    const double x = cx + rnd(-s, s), y = cy + rnd(-s, s);
+                    if (0 == i)
+                        path.moveTo(x, y);
+                    else
+                        path.lineTo(x, y);
+                }
+                path.close();
+            }
+            }
+            SplashCoord matrix[6] = {1, 0, 0, 1, 0, 0};
+            return ptr_xpath(new SplashXPath(&path, matrix, 0.1, gTrue));
+        }
+
+      private:
+        // `n` vertices on a circle, `step` > 1 gives a star
+        void polygon(SplashPath& path, double cx, double cy, double s, int n, int step)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                const double a = 2 * PI * i * step / n;
+                const double r = (1 == step) ? s * rnd(0.8, 1) : s;
+                if (0 == i)
+                    path.moveTo(cx + r * cos(a), cy + r * sin(a));
+                else
+                    path.lineTo(cx + r * cos(a), cy + r * sin(a));
+            }
+            path.close();
+        }
+
+        void rect(SplashPath& path, double x, double y, double w, double h)
+        {
+            path.moveTo(x, y);
+            path.lineTo(x + w, y);
+            path.lineTo(x + w, y + h);
+            path.lineTo(x, y + h);
+            path.close();
+        }
+
+        // a curved outer contour and a reversed inner counter
+        void glyph(SplashPath& path, double cx, double cy, double s)
+        {
+            const int n = 6;
+            double px[n], py[n];
+            for (int i = 0; i < n; ++i)
+            {
+                const double a = 2 * PI * i / n, r = s * rnd(0.85, 1);
+                px[i] = cx + r * cos(a);
+                py[i] = cy + r * sin(a);
+            }
+            path.moveTo(px[0], py[0]);
+            for (int i = 0; i < n; ++i)
+            {
+                const int j = (i + 1) % n;
+                const double ox = ((px[i] + px[j]) / 2 - cx) * 0.15;
+                const double oy = ((py[i] + py[j]) / 2 - cy) * 0.15;
+                path.curveTo(px[i] + (px[j] - px[i]) / 3 + ox, py[i] + (py[j] - py[i]) / 3 + oy,
+                    px[i] + 2 * (px[j] - px[i]) / 3 + ox, py[i] + 2 * (py[j] - py[i]) / 3 + oy,
+                    px[j], py[j]);
+            }
+            path.close();
+            const double r = s * 0.3;
+            path.moveTo(cx - r, cy - r);
+            path.lineTo(cx - r, cy + r);
+            path.lineTo(cx + r, cy + r);
+            path.lineTo(cx + r, cy - r);
+            path.close();
+        }
+    };
+
+    //==============================
+    // benchmarks
+    //==============================
+
+    void bench_accuracy(path_kind kind, int paths)
+    {
+        std::vector<Guchar> exact(4096), span(4096);
+        path_generator gen(kind + 1);
+        const GBool eo = (STAR_EO == kind || RANDOM_EO == kind) ? gTrue : gFalse;
+
+        long pixels = 0, different = 0, big = 0, sum = 0;
+        int max_diff = 0;
+        for (int i = 0; i < paths; ++i)
+        {
+            const double s = (i % 2) ? gen.rnd(1.5, 6) : gen.rnd(6, 60);
+            ptr_xpath xpath = gen.make(kind, gen.rnd(100, 200), gen.rnd(100, 200), s);
+            // the scanners keep their state in the segments
+            ptr_xpath xpath_exact(xpath->copy());
+            SplashXPathScanner scanner(xpath.get(), eo, xpath->getYMin(), xpath->getYMax());
+            SplashXPathScanner reference(
+                xpath_exact.get(), eo, xpath->getYMin(), xpath->getYMax());
+
+            // a narrower span, like a clip would
+            const int x_min = xpath->getXMin(), x_max = xpath->getXMax();
+            int x0 = x_min, x1 = x_max;
+            if (0 == i % 5 && 4 < x_max - x_min)
+            {
+                x0 = x_min + (x_max - x_min) / 3;
+                x1 = x_max - (x_max - x_min) / 4;
+            }
+            for (int y = xpath->getYMin(); y <= xpath->getYMax(); ++y)
+            {
+                reference.getSpanExact(exact.data(), y, x0, x1);
+                scanner.getSpan(span.data(), y, x0, x1);
+                for (int x = x0; x <= x1; ++x)
+                {
+                    const int d = std::abs(exact[x] - span[x]);
+                    ++pixels;
+                    sum += d;
+                    if (0 < d) ++different;
+                    if (2 < d) ++big;
+                    if (max_diff < d) max_diff = d;
+                }
+            }
+        }
+
+        std::cout << "accuracy " << kind_names[kind] << ": pixels " << pixels << ", differ "
+                  << 100. * different / pixels << "%, >2 " << 100. * big / pixels << "%, mean "
+                  << static_cast<double>(sum) / pixels << ", max " << max_diff << std::endl;
+    }
+
+    void bench_throughput(
+        const std::string& name, path_kind kind, int paths, double s0, double s1, int passes)
+    {
+        std::vector<Guchar> line(4096);
+        path_generator gen(99);
+        std::vector<ptr_xpath> xpaths;
+        for (int i = 0; i < paths; ++i)
+            xpaths.push_back(gen.make(kind, gen.rnd(100, 200), gen.rnd(100, 200), gen.rnd(s0, s1)));
+
+        double t[2];
+        for (int exact = 1; exact >= 0; --exact)
+        {
+            double t0 = seconds();
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                for (const ptr_xpath& xpath : xpaths)
+                {
+                    SplashXPathScanner scanner(
+                        xpath.get(), gFalse, xpath->getYMin(), xpath->getYMax());
+                    for (int y = xpath->getYMin(); y <= xpath->getYMax(); ++y)
+                    {
+                        if (exact)
+                            scanner.getSpanExact(line.data(), y, xpath->getXMin(), xpath->getXMax());
+                        else
+                            scanner.getSpan(line.data(), y, xpath->getXMin(), xpath->getXMax());
+                    }
+                }
+            }
+            t[exact] = seconds() - t0;
+        }
+
+        std::cout << "throughput " << paths << " " << name << " (x" << passes << "): exact "
+                  << t[1] * 1e3 << " ms, getSpan " << t[0] * 1e3 << " ms" << std::endl;
+    }
+
+    env_type get_options(char** argv, int argc)
+    {
+        env_type args;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (parse_option(args, argv[i], "paths")) continue;
+            if (parse_option(args, argv[i], "passes")) continue;
+        }
+        return args;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    env_type env = get_options(argv, argc);
+    const int paths = get_env_val<int>(env, "paths", 3000);
+    const int passes = get_env_val<int>(env, "passes", 3);
+
+    for (int kind = 0; kind < KINDS; ++kind)
+        bench_accuracy(static_cast<path_kind>(kind), paths);
+
+    bench_throughput("small glyph-like paths (2-5 px)", GLYPH, 20000, 2, 5, passes);
+    bench_throughput("large glyph-like paths (40-100 px)", GLYPH, 2000, 40, 100, passes);
+    bench_throughput("rectangles (2-20 px)", RECT, 20000, 2, 20, passes);
+    return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ *  Mazoea s.r.o.
+ *  @author jm
+ */
+
+//
+// Solid color spans drawn by Splash - filled rectangles (fully covered
+// spans) and anti-aliased glyphs (spans with partial coverage) blended
+// over opaque, clear and semi-transparent destinations. Each case reports
+// ns per pixel and the number of pixels which differ from the scalar
+// compositing formula of `Splash::pipeRunAA*`.
+//
+// bench_span_fill [--width=256] [--rows=64] [--iters=200]
+//
+
+#include <aconf.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "maz-utils/params.h"
+#include "splash/Splash.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashGlyphBitmap.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashPattern.h"
+
+using namespace bench;
+using namespace maz;
+
+namespace {
+
+    // the widest span
+    const int MAX_WIDTH = 2048;
+
+    inline Guchar div255(int x) { return (Guchar)((x + (x >> 8) + 0x80) >> 8); }
+
+    struct mode_type
+    {
+        const char* name;
+        SplashColorMode mode;
+        int comps;
+    };
+
+    //==============================
+    // the reference
+    //==============================
+
+    // one pixel of `pipeRunAA*` with an identity transfer function
+    void blend_pixel(Guchar* color, Guchar* alpha, Guchar shape, Guchar a_input,
+        const Guchar* src, int comps)
+    {
+        if (!shape) return;
+        const Guchar a_src = div255(a_input * shape);
+        const Guchar a_result = a_src + *alpha - div255(a_src * *alpha);
+        for (int i = 0; i < comps; ++i)
+        {
+            color[i] = a_result ? (Guchar)(((a_result - a_src) * color[i] + a_src * src[i]) / a_result)
+                                : 0;
+        }
+        *alpha = a_result;
+    }
+
+    //==============================
+    // helpers
+    //==============================
+
+    // destination alpha - "opaque", "clear" or "mixed"
+    void init_bitmap(SplashBitmap& bitmap, int comps, const std::string& dest, std::mt19937& rng)
+    {
+        std::uniform_int_distribution<int> u(0, 255);
+        for (int y = 0; y < bitmap.getHeight(); ++y)
+        {
+            Guchar* color = bitmap.getRowPtr(y);
+            Guchar* alpha = bitmap.getAlphaRowPtr(y);
+            for (int x = 0; x < bitmap.getWidth(); ++x)
+            {
+                for (int i = 0; i < comps; ++i)
+                    color[comps * x + i] = (Guchar)u(rng);
+                alpha[x] = (dest == "opaque") ? 255 : (dest == "clear") ? 0 : (Guchar)u(rng);
+            }
+        }
+    }
+
+    void copy_bitmap(SplashBitmap& from, SplashBitmap& to, int comps)
+    {
+        for (int y = 0; y < from.getHeight(); ++y)
+        {
+            memcpy(to.getRowPtr(y), from.getRowPtr(y), comps * from.getWidth());
+            memcpy(to.getAlphaRowPtr(y), from.getAlphaRowPtr(y), from.getWidth());
+        }
+    }
+
+    // pixels which differ in color or alpha
+    int mismatches(SplashBitmap& b1, SplashBitmap& b2, int comps)
+    {
+        int cnt = 0;
+        for (int y = 0; y < b1.getHeight(); ++y)
+        {
+            const Guchar* c1 = b1.getRowPtr(y);
+            const Guchar* c2 = b2.getRowPtr(y);
+            const Guchar* a1 = b1.getAlphaRowPtr(y);
+            const Guchar* a2 = b2.getAlphaRowPtr(y);
+            for (int x = 0; x < b1.getWidth(); ++x)
+            {
+                if (a1[x] != a2[x] || memcmp(c1 + comps * x, c2 + comps * x, comps)) ++cnt;
+            }
+        }
+        return cnt;
+    }
+
+    //==============================
+    // benchmarks
+    //==============================
+
+    // Draws with `draw` (after `setup`) on a copy of `dest` and prints ns per pixel and
+    // mismatches with `expected`. An overprint mask makes `Splash::pipeInit`
+    // choose the scalar `pipeRunAA*` functions which ignore it in these modes
+    // - the same results without the solid color spans.
+    template <typename setup_type, typename draw_type>
+    void run(const std::string& name, const mode_type& m, SplashBitmap& dest,
+        SplashBitmap& expected, int pixels, int iters, setup_type setup, draw_type draw)
+    {
+        std::cout << name;
+        for (int scalar = 1; scalar >= 0; --scalar)
+        {
+#if SPLASH_CMYK
+            if (scalar && m.mode == splashModeCMYK8) continue;
+#endif
+            SplashBitmap bitmap(dest.getWidth(), dest.getHeight(), 1, m.mode, gTrue);
+            copy_bitmap(dest, bitmap, m.comps);
+            Splash splash(&bitmap, gFalse);
+            setup(splash);
+            if (scalar) splash.setOverprintMask(0xfffffffe);
+
+            draw(splash);
+            const int different = mismatches(bitmap, expected, m.comps);
+            double t0 = seconds();
+            for (int i = 0; i < iters; ++i)
+                draw(splash);
+            double t1 = seconds();
+            std::cout << (scalar ? " scalar " : " solid ")
+                      << (t1 - t0) * 1e9 / ((double)iters * pixels) << " ns/px (mismatches "
+                      << different << ")";
+        }
+        std::cout << std::endl;
+    }
+
+    // rectangles with integer coordinates - every span is fully covered
+    void bench_fill(const mode_type& m, int width, int rows, int iters, std::mt19937& rng)
+    {
+        SplashBitmap dest(MAX_WIDTH, rows, 1, m.mode, gTrue);
+        SplashBitmap expected(MAX_WIDTH, rows, 1, m.mode, gTrue);
+        init_bitmap(dest, m.comps, "mixed", rng);
+        copy_bitmap(dest, expected, m.comps);
+
+        SplashColor color = {40, 120, 200};
+        SplashPath path;
+        path.moveTo(0, 0);
+        path.lineTo(width, 0);
+        path.lineTo(width, rows);
+        path.lineTo(0, rows);
+        path.close();
+
+        for (int y = 0; y < rows; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                blend_pixel(expected.getRowPtr(y) + m.comps * x, expected.getAlphaRowPtr(y) + x,
+                    255, 255, color, m.comps);
+            }
+        }
+
+        run(std::string("fill  ") + m.name + " width " + std::to_string(width) + ":", m, dest,
+            expected, width * rows, iters,
+            [&](Splash& splash) { splash.setFillPattern(new SplashSolidColor(color)); },
+            [&](Splash& splash) { splash.fill(&path, gFalse); });
+    }
+
+    // anti-aliased glyphs with random coverage
+    void bench_blend(const mode_type& m, int width, int rows, int iters, const std::string& alpha,
+        double fill_alpha, std::mt19937& rng)
+    {
+        SplashBitmap dest(MAX_WIDTH, rows, 1, m.mode, gTrue);
+        SplashBitmap expected(MAX_WIDTH, rows, 1, m.mode, gTrue);
+        init_bitmap(dest, m.comps, alpha, rng);
+        copy_bitmap(dest, expected, m.comps);
+
+        SplashColor color = {40, 120, 200};
+
+        // a quarter of the pixels is not covered, a quarter fully
+        std::vector<Guchar> shape(width * rows);
+        std::uniform_int_distribution<int> u(0, 511);
+        for (Guchar& s : shape)
+        {
+            const int v = u(rng);
+            s = (v < 128) ? 0 : (v < 256) ? 255 : (Guchar)(v - 256);
+        }
+        SplashGlyphBitmap glyph;
+        glyph.x = glyph.y = 0;
+        glyph.w = width;
+        glyph.h = rows;
+        glyph.aa = gTrue;
+        glyph.data = shape.data();
+        glyph.freeData = gFalse;
+        glyph.cacheEntry = NULL;
+
+        const Guchar a_input = (Guchar)(fill_alpha * 255 + 0.5);
+        for (int y = 0; y < rows; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                blend_pixel(expected.getRowPtr(y) + m.comps * x, expected.getAlphaRowPtr(y) + x,
+                    shape[y * width + x], a_input, color, m.comps);
+            }
+        }
+
+        std::string name = std::string("blend ") + m.name + " width " + std::to_string(width) +
+                           " " + alpha + " alpha " + std::to_string(fill_alpha).substr(0, 3) + ":";
+        run(name, m, dest, expected, width * rows, iters,
+            [&](Splash& splash) {
+                splash.setFillPattern(new SplashSolidColor(color));
+                splash.setFillAlpha(fill_alpha);
+            },
+            [&](Splash& splash) { splash.fillGlyph(0, 0, &glyph); });
+    }
+
+    env_type get_options(char** argv, int argc)
+    {
+        env_type args;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (parse_option(args, argv[i], "width")) continue;
+            if (parse_option(args, argv[i], "rows")) continue;
+            if (parse_option(args, argv[i], "iters")) continue;
+        }
+        return args;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    env_type env = get_options(argv, argc);
+    const int rows = get_env_val<int>(env, "rows", 64);
+    const int iters = get_env_val<int>(env, "iters", 200);
+
+    std::vector<int> widths = {8, 32, 256, 2048};
+    if (env.end() != env.find("width"))
+    {
+        widths = {std::min(get_env_val<int>(env, "width", 256), MAX_WIDTH)};
+    }
+
+    const std::vector<mode_type> modes = {
+        {"Mono8", splashModeMono8, 1},
+        {"RGB8 ", splashModeRGB8, 3},
+#if SPLASH_CMYK
+        {"CMYK8", splashModeCMYK8, 4},
+#endif
+    };
+
+    std::mt19937 rng(7);
+    for (const mode_type& m : modes)
+    {
+        for (int width : widths)
+        {
+            bench_fill(m, width, rows, iters, rng);
+            for (const char* dest : {"opaque", "clear", "mixed"})
+            {
+                bench_blend(m, width, rows, iters, dest, 1., rng);
+                bench_blend(m, width, rows, iters, dest, 0.5, rng);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+/*
+ *  Mazoea s.r.o.
+ *  @author jm
+ */
+
+//
+// Many small bbox queries on dense pages - `document::words_at`,
+// `words_remove` and `erase` against the scans of all lines they replaced.
+// The results are compared with `maz::words_at` also after words were
+// moved between lines (split, merge, erase, push_back).
+//
+// bench_words_index [--lines=200 --words=40] [--queries=100000]
+//
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "io-document/io-document.h"
+#include "io-document/words_index.h"
+#include "maz-utils/params.h"
+
+using namespace bench;
+using namespace maz;
+
+namespace {
+
+    typedef std::vector<doc::ptr_word> all_words_type;
+    typedef std::set<std::pair<const doc::word_type*, const doc::line_type*>> result_type;
+
+    //==============================
+    // the scans of all lines
+    //==============================
+
+    doc::words_type
+    scan_remove(doc::page_type& p, const doc::bbox_type& bbox, double min_overlap)
+    {
+        doc::words_type removed;
+        for (doc::ptr_line pline : p.lines)
+        {
+            doc::line_type& line = *pline;
+            if (min_overlap > line.bbox.intersects_y(bbox)) continue;
+            if (min_overlap > line.bbox.intersects_x(bbox)) continue;
+            for (auto it = line.begin(); it != line.end();)
+            {
+                if (2 * min_overlap < bbox.intersects((*it)->bbox))
+                {
+                    removed.push_back(*it);
+                    it = line.erase(it);
+                } else
+                {
+                    ++it;
+                }
+            }
+        }
+        return removed;
+    }
+
+    bool scan_erase(doc::page_type& p, doc::ptr_word pword, double min_overlap)
+    {
+        for (doc::ptr_line pline : p.lines)
+        {
+            if (min_overlap <= pline->bbox.intersects(pword->bbox))
+            {
+                if (pline->erase(pword)) return true;
+            }
+        }
+        return false;
+    }
+
+    //==============================
+    // helpers
+    //==============================
+
+    // a grid of words 20x10 pixels - lines of a dense page
+    void build(doc::document& d, int lines, int words, all_words_type& all)
+    {
+        d.start_page();
+        for (int l = 0; l < lines; ++l)
+        {
+            for (int w = 0; w < words; ++w)
+            {
+                doc::bbox_type b(w * 25, l * 14, w * 25 + 20, l * 14 + 10);
+                doc::ptr_word pword(new doc::word_type("w" + std::to_string(w), b, 100.));
+                d.add(pword);
+                all.push_back(pword);
+            }
+            d.new_line();
+        }
+        d.populate();
+    }
+
+    result_type result(const doc::words_type& words, const doc::lines_type& lines)
+    {
+        result_type ret;
+        auto it_line = lines.begin();
+        for (const doc::ptr_word& pword : words)
+            ret.insert(std::make_pair(pword.get(), (it_line++)->get()));
+        return ret;
+    }
+
+    // queries which differ from `maz::words_at`
+    int mismatches(doc::document& d, const std::vector<doc::bbox_type>& queries)
+    {
+        int cnt = 0;
+        for (const doc::bbox_type& b : queries)
+        {
+            doc::lines_type l1, l2;
+            doc::words_type w1 = maz::words_at(d.page(0).lines, b, 10., &l1);
+            doc::words_type w2 = d.words_at(0, b, 10., &l2);
+            if (result(w1, l1) != result(w2, l2)) ++cnt;
+        }
+        return cnt;
+    }
+
+    //==============================
+    // benchmarks
+    //==============================
+
+    void bench_queries(int lines, int words, const std::vector<doc::bbox_type>& queries)
+    {
+        env_type env;
+        all_words_type all;
+        doc::document d(env);
+        build(d, lines, words, all);
+        doc::page_type& p = d.page(0);
+
+        size_t scan_hits = 0, hits = 0;
+        double t0 = seconds();
+        for (const doc::bbox_type& b : queries)
+            scan_hits += maz::words_at(p.lines, b, 10.).size();
+        double t1 = seconds();
+        // builds the index of big pages
+        d.words_at(0, queries.front(), 10.);
+        double t2 = seconds();
+        for (const doc::bbox_type& b : queries)
+            hits += d.words_at(0, b, 10.).size();
+        double t3 = seconds();
+
+        const double n = static_cast<double>(queries.size());
+        std::cout << "words_at     " << lines * words << " words: scan " << (t1 - t0) * 1e6 / n
+                  << " us, document " << (t3 - t2) * 1e6 / n << " us ("
+                  << (p.indexed() ? "index" : "scan") << ", built in " << (t2 - t1) * 1e3
+                  << " ms), hits " << scan_hits << "/" << hits << ", mismatches "
+                  << mismatches(d, queries) << std::endl;
+    }
+
+    void bench_updates(
+        int lines, int words, const std::vector<doc::bbox_type>& queries, std::mt19937& rng)
+    {
+        env_type env;
+        all_words_type all;
+        doc::document d(env);
+        build(d, lines, words, all);
+        doc::page_type& p = d.page(0);
+        // use the index even on small pages
+        p.index();
+
+        std::uniform_int_distribution<size_t> rnd(0, all.size() - 1);
+        int erased = 0;
+        for (int i = 0; i < 2000; ++i)
+        {
+            doc::ptr_line pline = p.lines[rnd(rng) % p.lines.size()];
+            switch (i % 4)
+            {
+            case 0:
+                erased += d.erase(all[rnd(rng)], 30.) ? 1 : 0;
+                break;
+            case 1:
+                if (2 < pline->size())
+                {
+                    auto it = pline->begin();
+                    std::advance(it, pline->size() / 2);
+                    doc::lines_type added{pline->split(it)};
+                    d.add(added.begin(), added.end());
+                }
+                break;
+            case 2:
+            {
+                auto it = std::find(p.lines.begin(), p.lines.end(), pline);
+                if (it + 1 != p.lines.end() && (*it)->bbox.ylt() == (*(it + 1))->bbox.ylt())
+                {
+                    doc::ptr_line pnext = *(it + 1);
+                    pline->merge(*pnext);
+                    d.remove(pnext);
+                }
+                break;
+            }
+            default:
+                if (!pline->empty())
+                {
+                    doc::bbox_type b = pline->back()->bbox;
+                    doc::bbox_type nb(b.xrb() + 2, b.ylt(), b.xrb() + 12, b.yrb());
+                    doc::ptr_word pword(new doc::word_type("n", nb, 100.));
+                    pline->push_back(pword);
+                    all.push_back(pword);
+                }
+            }
+        }
+        d.remove_empty(0);
+
+        size_t cnt = 0;
+        for (const doc::ptr_line& pline : p.lines)
+            cnt += pline->size();
+        std::cout << "updates      " << lines * words << " words: 2000 changes (" << erased
+                  << " erased), " << cnt << " words in lines, " << p.index().size()
+                  << " in index, mismatches " << mismatches(d, queries) << std::endl;
+    }
+
+    void bench_removal(
+        int lines, int words, const std::vector<doc::bbox_type>& queries, std::mt19937& rng)
+    {
+        env_type env;
+        all_words_type all1, all2;
+        doc::document d1(env), d2(env);
+        build(d1, lines, words, all1);
+        build(d2, lines, words, all2);
+        d2.words_at(0, queries.front(), 10.);
+
+        std::vector<size_t> order(all1.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+        const size_t n = std::min<size_t>(order.size() / 2, 20000);
+
+        int e1 = 0, e2 = 0;
+        double t0 = seconds();
+        for (size_t i = 0; i < n; ++i)
+            e1 += scan_erase(d1.page(0), all1[order[i]], 30.) ? 1 : 0;
+        double t1 = seconds();
+        for (size_t i = 0; i < n; ++i)
+            e2 += d2.erase(all2[order[i]], 30.) ? 1 : 0;
+        double t2 = seconds();
+        std::cout << "erase        " << lines * words << " words: scan " << (t1 - t0) * 1e6 / n
+                  << " us, document " << (t2 - t1) * 1e6 / n << " us ("
+                  << (d2.page(0).indexed() ? "index" : "scan") << "), erased " << e1 << "/"
+                  << e2 << std::endl;
+
+        size_t r1 = 0, r2 = 0;
+        double t3 = seconds();
+        for (const doc::bbox_type& b : queries)
+            r1 += scan_remove(d1.page(0), b, 20.).size();
+        double t4 = seconds();
+        for (const doc::bbox_type& b : queries)
+            r2 += d2.words_remove(0, b, 20.).size();
+        double t5 = seconds();
+
+        int different = 0;
+        for (size_t l = 0; l < d1.page(0).lines.size(); ++l)
+        {
+            if (d1.page(0).lines[l]->size() != d2.page(0).lines[l]->size()) ++different;
+        }
+        const double q = static_cast<double>(queries.size());
+        std::cout << "words_remove " << lines * words << " words: scan " << (t4 - t3) * 1e6 / q
+                  << " us, document " << (t5 - t4) * 1e6 / q << " us, removed " << r1 << "/"
+                  << r2 << ", different lines " << different << std::endl;
+    }
+
+    env_type get_options(char** argv, int argc)
+    {
+        env_type args;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (parse_option(args, argv[i], "lines")) continue;
+            if (parse_option(args, argv[i], "words")) continue;
+            if (parse_option(args, argv[i], "queries")) continue;
+        }
+        return args;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    env_type env = get_options(argv, argc);
+    const int queries_cnt = get_env_val<int>(env, "queries", 100000);
+
+    // lines x words per line
+    std::vector<std::pair<int, int>> sizes = {{60, 12}, {100, 20}, {200, 40}, {1000, 40}};
+    if (env.end() != env.find("lines") || env.end() != env.find("words"))
+    {
+        sizes = {{get_env_val<int>(env, "lines", 200), get_env_val<int>(env, "words", 40)}};
+    }
+
+    std::mt19937 rng(7);
+    for (const auto& size : sizes)
+    {
+        // word sized queries anywhere on the page
+        std::uniform_real_distribution<double> ux(0, size.second * 25), uy(0, size.first * 14);
+        std::vector<doc::bbox_type> queries;
+        for (int i = 0; i < queries_cnt; ++i)
+        {
+            double x = ux(rng), y = uy(rng);
+            queries.push_back(doc::bbox_type(x, y, x + 30, y + 12));
+        }
+
+        bench_queries(size.first, size.second, queries);
+        bench_updates(size.first, size.second, queries, rng);
+        bench_removal(size.first, size.second, queries, rng);
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ *  Mazoea s.r.o.
+ *  @author jm
+ */
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "io-document/fulltext.h"
+#include "maz-utils/params.h"
+#include "maz-utils/utils.h"
+#include "os/version.h"
+
+using namespace std;
+using namespace maz;
+
+//==============================
+namespace {
+    //==============================
+
+    // not MT friendly
+    static slogger logger_;
+
+    //==============================
+    // helpers
+    //==============================
+
+    string help()
+    {
+        return string("Pdf text search utility v" _PROG_VERSION_ PR_INFO
+                      " utility queries an index written by pdf_to_text --index.\n"
+                      "Arguments:\n"
+                      "  --help        produces this help message\n"
+                      "  --index       index file\n"
+                      "  --query       words to find - all of them form a phrase, a word\n"
+                      "                ending with * matches as a prefix (e.g., =\"inv* no\");\n"
+                      "                case and diacritics are ignored\n"
+                      "  --limit       return at most this many matches (default is all)\n"
+                      "\n"
+                      "Examples:\n"
+                      "  pdf_to_text --file=input.pdf --index=input.idx --out=\n"
+                      "  pdf_text_search --index=input.idx --query=\"total amount\"\n"
+                      "\n"
+                      "Note: matches are written as json with the pdf page number, position\n"
+                      "of the first word on the page, word ids and bbox (same as in the json\n"
+                      "of pdf_to_text).\n");
+    }
+
+    env_type get_options(char** argv, size_t argc)
+    {
+        // remove the first exe path
+        ++argv;
+        --argc;
+
+        env_type args;
+
+        typedef std::vector<std::string> args_type;
+        args_type args_arr(argv, argv + argc);
+
+        try
+        {
+            for (args_type::iterator it = args_arr.begin(); it != args_arr.end(); ++it)
+            {
+                if (*it == "--help")
+                {
+                    args["help"] = "";
+                    break;
+                } else if (parse_option(args, *it, "index"))
+                    continue;
+                else if (parse_option(args, *it, "query"))
+                    continue;
+                else if (parse_option(args, *it, "limit"))
+                    continue;
+            }
+
+        } catch (exception&)
+        {
+            // invalid param
+        }
+
+        return args;
+
+    } // get_options
+
+    //==============================
+} // namespace
+//==============================
+
+//==============================
+// main
+//==============================
+
+int main(int argc, char** argv)
+{
+    env_type env = get_options(argv, argc);
+
+    // help
+    if (1 == argc || env.end() != env.find("help"))
+    {
+        std::cout << help();
+        return maz::OK;
+    }
+
+    // check sanity
+    if (env.end() == env.find("index") || env.end() == env.find("query"))
+    {
+        std::cout << help();
+        logger_.error("Missing --index or --query option.");
+        return maz::INVALID_PARAM;
+    }
+
+    size_t limit = 0;
+    if (env.end() != env.find("limit"))
+    {
+        limit = static_cast<size_t>(atoi(env["limit"].c_str()));
+    }
+
+    try
+    {
+        doc::fulltext_index index;
+        if (!index.load(env["index"]))
+        {
+            logger_.error("Invalid index file - ", env["index"]);
+            return maz::INVALID_PARAM;
+        }
+
+        doc::fulltext_matches matches = index.find(env["query"]);
+        if (0 < limit && limit < matches.size())
+        {
+            matches.resize(limit);
+        }
+
+        maz::json_arr arr = make_json_arr();
+        for (const doc::fulltext_match& m : matches)
+        {
+            arr.push_back(m.to_json());
+        }
+        std::cout << arr << std::endl;
+
+    } catch (std::exception& e)
+    {
+        logger_.error("exception - ", e.what());
+        return maz::EXCEPTION;
+    }
+
+    return maz::OK;
+}
@@ -10,15 +10,32 @@
 #include <aconf.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#  include <sys/resource.h>
+#endif
 #include "goo/parseargs.h"
 #include "goo/gmem.h"
 #include "goo/GString.h"
+#if MULTITHREADED
+#include "goo/GMutex.h"
+#endif
+#include "goo/GThreadPool.h"
 #include "xpdf/GlobalParams.h"
 #include "xpdf/Object.h"
 #include "xpdf/PDFDoc.h"
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
+#include "splash/SplashGlyphCache.h"
+#include "splash/SplashBitmapPool.h"
 #include "xpdf/SplashOutputDev.h"
+#include "xpdf/SplashBandRenderer.h"
+#include "xpdf/SplashRegionOutputDev.h"
 #include "xpdf/config.h"
 
 static int firstPage = 1;
@@ -26,6 +43,16 @@ static int lastPage = 0;
 static int resolution = 150;
 static GBool mono = gFalse;
 static GBool gray = gFalse;
+static int nThreads = 1;
+static int glyphCacheSize = 0;
+static int nEncThreads = 0;
+static int encMemSize = 256;
+static int tileMemSize = 0;
+static int zlibLevel = -1;
+static char pngFilterStr[16] = "";
+static GBool printStats = gFalse;
+static char regionsFileName[256] = "";
+static int regionDPI = 300;
 static char enableFreeTypeStr[16] = "";
 static char antialiasStr[16] = "";
 static char vectorAntialiasStr[16] = "";
@@ -48,6 +75,31 @@ static ArgDesc argDesc[] = {
    "generate a monochrome PBM file"},
   {"-gray",   argFlag,     &gray,          0,
    "generate a grayscale PGM file"},
+  {"-threads", argInt,     &nThreads,      0,
+   "number of threads, each rendering a band of the page, at most one per CPU (default is 1)"},
+  {"-glyphcache", argInt,  &glyphCacheSize, 0,
+   "size of the rasterized glyph cache, in KB (default is 8192)"},
+#if MULTITHREADED
+  {"-encthreads", argInt,  &nEncThreads,   0,
+   "number of background PNG encoder threads (default is 0)"},
+  {"-encmem", argInt,      &encMemSize,    0,
+   "max size of the pages waiting to be encoded, in MB (default is 256)"},
+#endif
+  {"-tilemem", argInt,     &tileMemSize,   0,
+   "render each page in tiles of at most this many MB per thread,"
+   " streamed to the PNG file (default is 0: whole pages)"},
+  {"-z",      argInt,      &zlibLevel,     0,
+   "zlib compression level, 0-9 (default is 6)"},
+  {"-filter", argString,   pngFilterStr,   sizeof(pngFilterStr),
+   "PNG row filter: none, sub, up, avg, paeth, all (default is all,"
+   " or none with -mono)"},
+  {"-stats",  argFlag,     &printStats,    0,
+   "print glyph cache, bitmap pool, throughput, and memory statistics"},
+  {"-regions", argString,  regionsFileName, sizeof(regionsFileName),
+   "render only the regions listed in this file, one per line:"
+   " page x0 y0 x1 y1"},
+  {"-regiondpi", argInt,   &regionDPI,     0,
+   "resolution of the -regions coordinates, in DPI (default is 300)"},
 #if HAVE_FREETYPE_FREETYPE_H | HAVE_FREETYPE_H
   {"-freetype",   argString,      enableFreeTypeStr, sizeof(enableFreeTypeStr),
    "enable FreeType font rasterizer: yes, no"},
@@ -79,26 +131,128 @@ static ArgDesc argDesc[] = {
   {NULL}
 };
 
-static void setupPNG(png_structp *png, png_infop *pngInfo, FILE *f,
-		     int bitDepth, int colorType,
-		     SplashBitmap *bitmap);
-static void writePNGData(png_structp png, SplashBitmap *bitmap);
-static void finishPNG(png_structp *png, png_infop *pngInfo);
+//------------------------------------------------------------------------
+// PNGPage
+//------------------------------------------------------------------------
+
+// A rendered page, copied out of the renderer's bitmaps so that it
+// can be encoded while the next page is rendered.
+struct PNGPage {
+  int pg;			// page number
+  int width, height;
+  int rowSize;			// bytes per row
+  Guchar *data;			// height * rowSize bytes
+  PNGPage *next;		// next page in the queue
+};
+
+//------------------------------------------------------------------------
+// PNGWriter
+//------------------------------------------------------------------------
+
+// A PNG file being written a few rows at a time.
+struct PNGWriter {
+  png_structp png;		// NULL after an error
+  png_infop pngInfo;
+};
+
+// State for writeTileRows.
+struct PNGTileWriter {
+  SplashBandRenderer *renderer;
+  PNGWriter png;
+};
+
+//------------------------------------------------------------------------
+// PNGRegion
+//------------------------------------------------------------------------
+
+// A region listed in the -regions file.  Coordinates are in the
+// (top-down) device space of the page's MediaBox at regionDPI -- the
+// same space that pdf_to_text uses for its bounding boxes.
+struct PNGRegion {
+  int pg;			// page number
+  int idx;			// line number of the region in the file
+				//   (counting only regions, from 1)
+  double x0, y0, x1, y1;
+};
+
+#if MULTITHREADED
+
+//------------------------------------------------------------------------
+// PNGEncoderQueue
+//------------------------------------------------------------------------
+
+// FIFO queue from the rendering (main) thread to the encoder threads.
+// The pages that are queued or being encoded may use at most maxBytes
+// of memory -- except that a single page is always allowed, so a page
+// larger than the limit still goes through, just without overlap.
+struct PNGEncoderQueue {
+  GMutex mutex;
+  GCond pageCond;		// signaled when a page is queued, or on close
+  GCond spaceCond;		// signaled when a page has been encoded
+  PNGPage *head, *tail;
+  long long nBytes;		// size of the queued and in-progress pages
+  long long maxBytes;
+  long long peakBytes;
+  double encodeTime;		// total time spent encoding, in seconds
+  GBool closed;			// set when there are no more pages
+  GBool error;			// set if any page couldn't be written
+};
+
+#endif
+
+static char *pngRoot;
+static int pngBitDepth, pngColorType;
+static int pngFilters;		// PNG_FILTER_* flags, 0 for libpng default
+
+static GBool parsePNGFilter(char *s, int *filters);
+static PNGPage *copyPage(SplashBandRenderer *renderer, int pg, int rowSize);
+static void freePage(PNGPage *page);
+static GBool writePage(PNGPage *page);
+static GBool writeRendererPage(SplashBandRenderer *renderer, int pg);
+static PNGRegion *readRegions(char *fileName, int *nRegions);
+static int cmpRegions(const void *p1, const void *p2);
+static int renderRegions(PDFDoc *doc, SplashColorMode colorMode,
+			 SplashColorPtr paperColor);
+static GBool writeRegion(SplashBitmap *bitmap, int pg, int idx);
+static FILE *openPNGFile(int pg);
+static void closePNGFile(FILE *f);
+static GBool writePNG(FILE *f, int width, int height, Guchar **rows);
+static GBool startPNG(PNGWriter *w, FILE *f, int width, int height);
+static GBool writePNGRows(PNGWriter *w, Guchar **rows, int nRows);
+static GBool finishPNG(PNGWriter *w);
+static GBool writeTiledPage(SplashBandRenderer *renderer, int pg);
+static GBool writeTileRows(void *data, int yA, int yB);
+#if MULTITHREADED
+static void initEncoderQueue(PNGEncoderQueue *q, long long maxBytes);
+static void destroyEncoderQueue(PNGEncoderQueue *q);
+static GBool reserveEncoderQueue(PNGEncoderQueue *q, long long size);
+static void pushEncoderQueue(PNGEncoderQueue *q, PNGPage *page);
+static void closeEncoderQueue(PNGEncoderQueue *q);
+static void encoderThread(void *data, int task);
+#endif
+static double getTime();
+static long getPeakRSS();
+static void printGlyphCacheStats(SplashGlyphCache *glyphCache);
+static void printBitmapPoolStats(SplashBitmapPool *bitmapPool);
 
 int main(int argc, char *argv[]) {
   PDFDoc *doc;
   GString *fileName;
-  char *pngRoot;
-  GString *pngFile;
   GString *ownerPW, *userPW;
   SplashColor paperColor;
-  SplashOutputDev *splashOut;
+  SplashColorMode colorMode;
+  SplashBandRenderer *renderer;
+  PNGPage *page;
+#if MULTITHREADED
+  PNGEncoderQueue encQueue;
+#endif
+  GThreadPool *encPool;
+  double t0, t1, renderTime, encodeTime, waitTime;
+  long long peakQueueBytes;
+  long peakRSS;
   GBool ok;
   int exitCode;
-  int pg;
-  png_structp png;
-  png_infop pngInfo;
-  FILE *f;
+  int pg, rowSize;
 
   exitCode = 99;
 
@@ -107,6 +261,25 @@ int main(int argc, char *argv[]) {
   if (mono && gray) {
     ok = gFalse;
   }
+  if (nEncThreads < 0 || encMemSize < 0 || zlibLevel < -1 || zlibLevel > 9) {
+    ok = gFalse;
+  }
+  if (tileMemSize < 0) {
+    ok = gFalse;
+  }
+  if (regionDPI <= 0) {
+    ok = gFalse;
+  }
+  if (mono) {
+    // filtering never helps with 1-bit data
+    pngFilters = PNG_FILTER_NONE;
+  } else {
+    pngFilters = 0;
+  }
+  if (pngFilterStr[0] && !parsePNGFilter(pngFilterStr, &pngFilters)) {
+    fprintf(stderr, "Bad '-filter' value on command line\n");
+    ok = gFalse;
+  }
   if (!ok || argc != 3 || printVersion || printHelp) {
     fprintf(stderr, "pdftopng version %s\n", xpdfVersion);
     fprintf(stderr, "%s\n", xpdfCopyright);
@@ -139,6 +312,12 @@ int main(int argc, char *argv[]) {
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }
+  if (glyphCacheSize > 0) {
+    if (glyphCacheSize > INT_MAX / 1024) {
+      glyphCacheSize = INT_MAX / 1024;
+    }
+    globalParams->setGlyphCacheSize(glyphCacheSize * 1024);
+  }
 
   // open PDF file
   if (ownerPassword[0]) {
@@ -152,12 +331,6 @@ int main(int argc, char *argv[]) {
     userPW = NULL;
   }
   doc = new PDFDoc(fileName, ownerPW, userPW);
-  if (userPW) {
-    delete userPW;
-  }
-  if (ownerPW) {
-    delete ownerPW;
-  }
   if (!doc->isOk()) {
     exitCode = 1;
     goto err1;
@@ -170,74 +343,139 @@ int main(int argc, char *argv[]) {
     lastPage = doc->getNumPages();
 
 
-  // write PNG files
+  // set up the renderer
   if (mono) {
     paperColor[0] = 0xff;
-    splashOut = new SplashOutputDev(splashModeMono1, 1, gFalse, paperColor);
+    colorMode = splashModeMono1;
+    pngBitDepth = 1;
+    pngColorType = PNG_COLOR_TYPE_GRAY;
   } else if (gray) {
     paperColor[0] = 0xff;
-    splashOut = new SplashOutputDev(splashModeMono8, 1, gFalse, paperColor);
+    colorMode = splashModeMono8;
+    pngBitDepth = 8;
+    pngColorType = PNG_COLOR_TYPE_GRAY;
   } else {
     paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
-    splashOut = new SplashOutputDev(splashModeRGB8, 1, gFalse, paperColor);
+    colorMode = splashModeRGB8;
+    pngBitDepth = 8;
+    pngColorType = PNG_COLOR_TYPE_RGB;
+  }
+
+  // render only the listed regions
+  if (regionsFileName[0]) {
+    exitCode = renderRegions(doc, colorMode, paperColor);
+    goto err1;
+  }
+
+  renderer = new SplashBandRenderer(doc, ownerPW, userPW, nThreads,
+				    colorMode, 1, gFalse, paperColor);
+
+  // start the encoder threads -- pages written to stdout must stay in
+  // order, so they get a single encoder (tiled pages are encoded as
+  // they are rendered, so they don't use the encoder threads)
+  encPool = NULL;
+#if MULTITHREADED
+  if (nEncThreads > 0 && tileMemSize == 0) {
+    if (!strcmp(pngRoot, "-")) {
+      nEncThreads = 1;
+    }
+    encPool = new GThreadPool(nEncThreads + 1);
+    if (encPool->getNumThreads() > 1) {
+      initEncoderQueue(&encQueue, (long long)encMemSize << 20);
+      encPool->start(&encoderThread, &encQueue, encPool->getNumThreads() - 1);
+    } else {
+      delete encPool;
+      encPool = NULL;
+    }
   }
-  splashOut->startDoc(doc->getXRef());
+#endif
+
+  // write PNG files
+  exitCode = 0;
+  renderTime = encodeTime = waitTime = 0;
+  t0 = getTime();
   for (pg = firstPage; pg <= lastPage; ++pg) {
-    doc->displayPage(splashOut, pg, resolution, resolution, 0,
-		     gFalse, gTrue, gFalse);
-    if (mono) {
-      if (!strcmp(pngRoot, "-")) {
-	f = stdout;
-      } else {
-	pngFile = GString::format("{0:s}-{1:06d}.png", pngRoot, pg);
-	if (!(f = fopen(pngFile->getCString(), "wb"))) {
-	  exit(2);
-	}
-	delete pngFile;
+    t1 = getTime();
+    if (tileMemSize > 0) {
+      if (!writeTiledPage(renderer, pg)) {
+	exitCode = 2;
+	break;
       }
-      setupPNG(&png, &pngInfo, f,
-	       1, PNG_COLOR_TYPE_GRAY, splashOut->getBitmap());
-      writePNGData(png, splashOut->getBitmap());
-      finishPNG(&png, &pngInfo);
-      fclose(f);
-    } else if (gray) {
-      if (!strcmp(pngRoot, "-")) {
-	f = stdout;
+      renderTime += getTime() - t1;
+      continue;
+    }
+    renderer->displayPage(pg, resolution, resolution, 0,
+			  gFalse, gTrue, gFalse);
+    renderTime += getTime() - t1;
+    t1 = getTime();
+#if MULTITHREADED
+    if (encPool) {
+      if (mono) {
+	rowSize = (renderer->getWidth() + 7) >> 3;
+      } else if (gray) {
+	rowSize = renderer->getWidth();
       } else {
-	pngFile = GString::format("{0:s}-{1:06d}.png", pngRoot, pg);
-	if (!(f = fopen(pngFile->getCString(), "wb"))) {
-	  exit(2);
-	}
-	delete pngFile;
+	rowSize = 3 * renderer->getWidth();
       }
-      setupPNG(&png, &pngInfo, f,
-	       8, PNG_COLOR_TYPE_GRAY, splashOut->getBitmap());
-      writePNGData(png, splashOut->getBitmap());
-      finishPNG(&png, &pngInfo);
-      fclose(f);
-    } else { // RGB
-      if (!strcmp(pngRoot, "-")) {
-	f = stdout;
-      } else {
-	pngFile = GString::format("{0:s}-{1:06d}.png", pngRoot, pg);
-	if (!(f = fopen(pngFile->getCString(), "wb"))) {
-	  exit(2);
-	}
-	delete pngFile;
+      if (!reserveEncoderQueue(&encQueue,
+			       (long long)rowSize * renderer->getHeight())) {
+	exitCode = 2;
+	break;
       }
-      setupPNG(&png, &pngInfo, f,
-	       8, PNG_COLOR_TYPE_RGB, splashOut->getBitmap());
-      writePNGData(png, splashOut->getBitmap());
-      finishPNG(&png, &pngInfo);
-      fclose(f);
+      waitTime += getTime() - t1;
+      page = copyPage(renderer, pg, rowSize);
+      pushEncoderQueue(&encQueue, page);
+      continue;
+    }
+#endif
+    if (!writeRendererPage(renderer, pg)) {
+      exitCode = 2;
+      break;
+    }
+    encodeTime += getTime() - t1;
+  }
+  peakQueueBytes = 0;
+#if MULTITHREADED
+  if (encPool) {
+    t1 = getTime();
+    closeEncoderQueue(&encQueue);
+    encPool->wait();
+    waitTime += getTime() - t1;
+    if (encQueue.error) {
+      exitCode = 2;
     }
+    encodeTime = encQueue.encodeTime;
+    peakQueueBytes = encQueue.peakBytes;
+    destroyEncoderQueue(&encQueue);
+    delete encPool;
   }
-  delete splashOut;
+#endif
+  t1 = getTime() - t0;
 
-  exitCode = 0;
+  if (printStats) {
+    printGlyphCacheStats(renderer->getOutputDev(0)->getGlyphCache());
+    printBitmapPoolStats(renderer->getOutputDev(0)->getBitmapPool());
+    fprintf(stderr, "pages: %d in %.3f s (%.2f pages/s)\n",
+	    pg - firstPage, t1, t1 > 0 ? (pg - firstPage) / t1 : 0.0);
+    fprintf(stderr, "time: %.3f s rendering, %.3f s encoding%s,"
+	    " %.3f s waiting for encoders\n",
+	    renderTime, encodeTime,
+	    encPool ? " (all threads)" : "", waitTime);
+    if ((peakRSS = getPeakRSS()) >= 0) {
+      fprintf(stderr, "memory: %.1f MB peak RSS, %.1f MB peak queued pages\n",
+	      peakRSS / 1024.0, peakQueueBytes / 1048576.0);
+    }
+  }
+  delete renderer;
 
   // clean up
  err1:
+  if (userPW) {
+    delete userPW;
+  }
+  if (ownerPW) {
+    delete ownerPW;
+  }
   delete doc;
   delete globalParams;
  err0:
@@ -249,44 +487,502 @@ int main(int argc, char *argv[]) {
   return exitCode;
 }
 
-static void setupPNG(png_structp *png, png_infop *pngInfo, FILE *f,
-		     int bitDepth, int colorType,
-		     SplashBitmap *bitmap) {
-  if (!(*png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
-				       NULL, NULL, NULL)) ||
-      !(*pngInfo = png_create_info_struct(*png))) {
-    exit(2);
+static GBool parsePNGFilter(char *s, int *filters) {
+  if (!strcmp(s, "none")) {
+    *filters = PNG_FILTER_NONE;
+  } else if (!strcmp(s, "sub")) {
+    *filters = PNG_FILTER_SUB;
+  } else if (!strcmp(s, "up")) {
+    *filters = PNG_FILTER_UP;
+  } else if (!strcmp(s, "avg")) {
+    *filters = PNG_FILTER_AVG;
+  } else if (!strcmp(s, "paeth")) {
+    *filters = PNG_FILTER_PAETH;
+  } else if (!strcmp(s, "all")) {
+    *filters = PNG_ALL_FILTERS;
+  } else {
+    return gFalse;
+  }
+  return gTrue;
+}
+
+// Copy the last rendered page out of the renderer's (band) bitmaps.
+static PNGPage *copyPage(SplashBandRenderer *renderer, int pg, int rowSize) {
+  PNGPage *page;
+  int y;
+
+  page = (PNGPage *)gmalloc(sizeof(PNGPage));
+  page->pg = pg;
+  page->width = renderer->getWidth();
+  page->height = renderer->getHeight();
+  page->rowSize = rowSize;
+  page->data = (Guchar *)gmallocn(page->height, rowSize);
+  for (y = 0; y < page->height; ++y) {
+    memcpy(page->data + y * rowSize, renderer->getRow(y), rowSize);
+  }
+  page->next = NULL;
+  return page;
+}
+
+static void freePage(PNGPage *page) {
+  gfree(page->data);
+  gfree(page);
+}
+
+static GBool writePage(PNGPage *page) {
+  Guchar **rows;
+  FILE *f;
+  GBool ok;
+  int y;
+
+  if (!(f = openPNGFile(page->pg))) {
+    return gFalse;
   }
-  if (setjmp(png_jmpbuf(*png))) {
-    exit(2);
+  rows = (Guchar **)gmallocn(page->height, sizeof(Guchar *));
+  for (y = 0; y < page->height; ++y) {
+    rows[y] = page->data + y * page->rowSize;
   }
-  png_init_io(*png, f);
-  png_set_IHDR(*png, *pngInfo, bitmap->getWidth(), bitmap->getHeight(),
-	       bitDepth, colorType, PNG_INTERLACE_NONE,
-	       PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-  png_write_info(*png, *pngInfo);
+  ok = writePNG(f, page->width, page->height, rows);
+  gfree(rows);
+  closePNGFile(f);
+  return ok;
 }
 
-static void writePNGData(png_structp png, SplashBitmap *bitmap) {
-  Guchar *p;
+// Write the last rendered page directly from the renderer's bitmaps.
+static GBool writeRendererPage(SplashBandRenderer *renderer, int pg) {
+  Guchar **rows;
+  FILE *f;
+  GBool ok;
   int y;
 
-  if (setjmp(png_jmpbuf(png))) {
-    exit(2);
+  if (!(f = openPNGFile(pg))) {
+    return gFalse;
+  }
+  rows = (Guchar **)gmallocn(renderer->getHeight(), sizeof(Guchar *));
+  for (y = 0; y < renderer->getHeight(); ++y) {
+    rows[y] = renderer->getRow(y);
+  }
+  ok = writePNG(f, renderer->getWidth(), renderer->getHeight(), rows);
+  gfree(rows);
+  closePNGFile(f);
+  return ok;
+}
+
+// Read the -regions file.  Returns NULL on error.
+static PNGRegion *readRegions(char *fileName, int *nRegions) {
+  PNGRegion *regions;
+  FILE *f;
+  char buf[256];
+  char *p;
+  int n, size, lineNum;
+
+  if (!(f = fopen(fileName, "r"))) {
+    fprintf(stderr, "Couldn't open regions file '%s'\n", fileName);
+    return NULL;
   }
-  p = bitmap->getDataPtr();
+  regions = NULL;
+  n = size = 0;
+  lineNum = 0;
+  while (fgets(buf, sizeof(buf), f)) {
+    ++lineNum;
+    for (p = buf; *p == ' ' || *p == '\t'; ++p) ;
+    if (!*p || *p == '\n' || *p == '\r' || *p == '#') {
+      continue;
+    }
+    if (n == size) {
+      size = size ? 2 * size : 64;
+      regions = (PNGRegion *)greallocn(regions, size, sizeof(PNGRegion));
+    }
+    if (sscanf(p, "%d %lf %lf %lf %lf", &regions[n].pg,
+	       &regions[n].x0, &regions[n].y0,
+	       &regions[n].x1, &regions[n].y1) != 5 ||
+	regions[n].x1 < regions[n].x0 || regions[n].y1 < regions[n].y0) {
+      fprintf(stderr, "Bad region on line %d of regions file '%s'\n",
+	      lineNum, fileName);
+      gfree(regions);
+      fclose(f);
+      return NULL;
+    }
+    regions[n].idx = n + 1;
+    ++n;
+  }
+  fclose(f);
+  qsort(regions, n, sizeof(PNGRegion), &cmpRegions);
+  *nRegions = n;
+  return regions;
+}
+
+static int cmpRegions(const void *p1, const void *p2) {
+  const PNGRegion *r1 = (const PNGRegion *)p1;
+  const PNGRegion *r2 = (const PNGRegion *)p2;
+
+  if (r1->pg != r2->pg) {
+    return r1->pg - r2->pg;
+  }
+  return r1->idx - r2->idx;
+}
+
+// Render the regions listed in the -regions file, each into its own
+// PNG file.  All regions on a page are rendered from a single pass
+// over the page's content stream.  Returns the exit code.
+static int renderRegions(PDFDoc *doc, SplashColorMode colorMode,
+			 SplashColorPtr paperColor) {
+  SplashRegionOutputDev *out;
+  PNGRegion *regions;
+  double scale;
+  int nRegions, exitCode, pg, x, y, w, h, i, j, k;
+
+  if (!strcmp(pngRoot, "-")) {
+    fprintf(stderr, "Regions can't be written to stdout\n");
+    return 99;
+  }
+  if (!(regions = readRegions(regionsFileName, &nRegions))) {
+    return 99;
+  }
+  out = new SplashRegionOutputDev(colorMode, 1, gFalse, paperColor);
+  out->startDoc(doc->getXRef());
+  scale = (double)resolution / regionDPI;
+  exitCode = 0;
+  for (i = 0; i < nRegions; i = j) {
+    pg = regions[i].pg;
+    for (j = i; j < nRegions && regions[j].pg == pg; ++j) ;
+    if (pg < firstPage || pg > lastPage) {
+      continue;
+    }
+    out->clearRegions();
+    for (k = i; k < j; ++k) {
+      x = (int)floor(regions[k].x0 * scale);
+      y = (int)floor(regions[k].y0 * scale);
+      w = (int)ceil(regions[k].x1 * scale) - x;
+      h = (int)ceil(regions[k].y1 * scale) - y;
+      out->addRegion(x, y, w, h);
+    }
+    // pdf_to_text coordinates are relative to the MediaBox
+    doc->displayPage(out, pg, resolution, resolution, 0,
+		     gTrue, gTrue, gFalse);
+    for (k = i; k < j; ++k) {
+      if (!writeRegion(out->getBitmap(k - i), pg, regions[k].idx)) {
+	exitCode = 2;
+      }
+    }
+  }
+  delete out;
+  gfree(regions);
+  return exitCode;
+}
+
+static GBool writeRegion(SplashBitmap *bitmap, int pg, int idx) {
+  GString *pngFile;
+  Guchar **rows;
+  FILE *f;
+  GBool ok;
+  int y;
+
+  pngFile = GString::format("{0:s}-{1:06d}-{2:06d}.png", pngRoot, pg, idx);
+  f = fopen(pngFile->getCString(), "wb");
+  delete pngFile;
+  if (!f) {
+    return gFalse;
+  }
+  rows = (Guchar **)gmallocn(bitmap->getHeight(), sizeof(Guchar *));
   for (y = 0; y < bitmap->getHeight(); ++y) {
-    png_write_row(png, (png_bytep)p);
-    p += bitmap->getRowSize();
+    rows[y] = bitmap->getDataPtr() + y * bitmap->getRowSize();
+  }
+  ok = writePNG(f, bitmap->getWidth(), bitmap->getHeight(), rows);
+  gfree(rows);
+  fclose(f);
+  return ok;
+}
+
+// Render a page in tiles, writing the rows of each group of tiles
+// to the PNG file as soon as they are done.
+static GBool writeTiledPage(SplashBandRenderer *renderer, int pg) {
+  PNGTileWriter tw;
+  FILE *f;
+  GBool ok;
+  int w, h;
+
+  if (!(f = openPNGFile(pg))) {
+    return gFalse;
+  }
+  renderer->getPageSize(pg, resolution, resolution, 0, gFalse, &w, &h);
+  tw.renderer = renderer;
+  ok = startPNG(&tw.png, f, w, h);
+  if (ok) {
+    ok = renderer->displayPageTiled(pg, resolution, resolution, 0,
+				    gFalse, gTrue, gFalse,
+				    (long long)tileMemSize << 20,
+				    &writeTileRows, &tw);
+    // finishPNG also frees the writer after an error
+    ok = finishPNG(&tw.png) && ok;
+  }
+  closePNGFile(f);
+  return ok;
+}
+
+static GBool writeTileRows(void *data, int yA, int yB) {
+  PNGTileWriter *tw;
+  Guchar **rows;
+  GBool ok;
+  int y;
+
+  tw = (PNGTileWriter *)data;
+  rows = (Guchar **)gmallocn(yB - yA, sizeof(Guchar *));
+  for (y = yA; y < yB; ++y) {
+    rows[y - yA] = tw->renderer->getRow(y);
+  }
+  ok = writePNGRows(&tw->png, rows, yB - yA);
+  gfree(rows);
+  return ok;
+}
+
+static FILE *openPNGFile(int pg) {
+  GString *pngFile;
+  FILE *f;
+
+  if (!strcmp(pngRoot, "-")) {
+    return stdout;
+  }
+  pngFile = GString::format("{0:s}-{1:06d}.png", pngRoot, pg);
+  f = fopen(pngFile->getCString(), "wb");
+  delete pngFile;
+  return f;
+}
+
+static void closePNGFile(FILE *f) {
+  if (f == stdout) {
+    fflush(f);
+  } else {
+    fclose(f);
+  }
+}
+
+static GBool writePNG(FILE *f, int width, int height, Guchar **rows) {
+  PNGWriter w;
+
+  return startPNG(&w, f, width, height) &&
+	 writePNGRows(&w, rows, height) &&
+	 finishPNG(&w);
+}
+
+static GBool startPNG(PNGWriter *w, FILE *f, int width, int height) {
+  if (!(w->png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+					 NULL, NULL, NULL))) {
+    return gFalse;
+  }
+  if (!(w->pngInfo = png_create_info_struct(w->png))) {
+    png_destroy_write_struct(&w->png, NULL);
+    w->png = NULL;
+    return gFalse;
+  }
+  if (setjmp(png_jmpbuf(w->png))) {
+    png_destroy_write_struct(&w->png, &w->pngInfo);
+    w->png = NULL;
+    return gFalse;
   }
+  png_init_io(w->png, f);
+  if (zlibLevel >= 0) {
+    png_set_compression_level(w->png, zlibLevel);
+  }
+  if (pngFilters) {
+    png_set_filter(w->png, PNG_FILTER_TYPE_BASE, pngFilters);
+  }
+  png_set_IHDR(w->png, w->pngInfo, width, height,
+	       pngBitDepth, pngColorType, PNG_INTERLACE_NONE,
+	       PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(w->png, w->pngInfo);
+  return gTrue;
+}
+
+// Each call sets its own error handler, so rows can be written from
+// a callback (see writeTileRows).
+static GBool writePNGRows(PNGWriter *w, Guchar **rows, int nRows) {
+  int y;
+
+  if (!w->png) {
+    return gFalse;
+  }
+  if (setjmp(png_jmpbuf(w->png))) {
+    png_destroy_write_struct(&w->png, &w->pngInfo);
+    w->png = NULL;
+    return gFalse;
+  }
+  for (y = 0; y < nRows; ++y) {
+    png_write_row(w->png, (png_bytep)rows[y]);
+  }
+  return gTrue;
+}
+
+// Finish the file and free the writer (also after an error).
+static GBool finishPNG(PNGWriter *w) {
+  if (!w->png) {
+    return gFalse;
+  }
+  if (setjmp(png_jmpbuf(w->png))) {
+    png_destroy_write_struct(&w->png, &w->pngInfo);
+    w->png = NULL;
+    return gFalse;
+  }
+  png_write_end(w->png, w->pngInfo);
+  png_destroy_write_struct(&w->png, &w->pngInfo);
+  w->png = NULL;
+  return gTrue;
+}
+
+#if MULTITHREADED
+
+static void initEncoderQueue(PNGEncoderQueue *q, long long maxBytes) {
+  gInitMutex(&q->mutex);
+  gInitCond(&q->pageCond);
+  gInitCond(&q->spaceCond);
+  q->head = q->tail = NULL;
+  q->nBytes = 0;
+  q->maxBytes = maxBytes;
+  q->peakBytes = 0;
+  q->encodeTime = 0;
+  q->closed = gFalse;
+  q->error = gFalse;
+}
+
+static void destroyEncoderQueue(PNGEncoderQueue *q) {
+  gDestroyCond(&q->spaceCond);
+  gDestroyCond(&q->pageCond);
+  gDestroyMutex(&q->mutex);
+}
+
+// Wait until there is room for a <size>-byte page, and reserve it.
+// Returns false if an encoder has failed.
+static GBool reserveEncoderQueue(PNGEncoderQueue *q, long long size) {
+  GBool ok;
+
+  gLockMutex(&q->mutex);
+  while (!q->error && q->nBytes > 0 && q->nBytes + size > q->maxBytes) {
+    gCondWait(&q->spaceCond, &q->mutex);
+  }
+  if ((ok = !q->error)) {
+    q->nBytes += size;
+    if (q->nBytes > q->peakBytes) {
+      q->peakBytes = q->nBytes;
+    }
+  }
+  gUnlockMutex(&q->mutex);
+  return ok;
+}
+
+static void pushEncoderQueue(PNGEncoderQueue *q, PNGPage *page) {
+  gLockMutex(&q->mutex);
+  if (q->tail) {
+    q->tail->next = page;
+  } else {
+    q->head = page;
+  }
+  q->tail = page;
+  gCondSignal(&q->pageCond);
+  gUnlockMutex(&q->mutex);
 }
 
+static void closeEncoderQueue(PNGEncoderQueue *q) {
+  gLockMutex(&q->mutex);
+  q->closed = gTrue;
+  gCondBroadcast(&q->pageCond);
+  gUnlockMutex(&q->mutex);
+}
+
+// Main loop of an encoder thread: encode pages until the queue is
+// closed and empty.
+static void encoderThread(void *data, int task) {
+  PNGEncoderQueue *q;
+  PNGPage *page;
+  double t;
+  GBool ok;
+
+  q = (PNGEncoderQueue *)data;
+  while (1) {
+    gLockMutex(&q->mutex);
+    while (!q->head && !q->closed) {
+      gCondWait(&q->pageCond, &q->mutex);
+    }
+    if (!(page = q->head)) {
+      gUnlockMutex(&q->mutex);
+      break;
+    }
+    if (!(q->head = page->next)) {
+      q->tail = NULL;
+    }
+    gUnlockMutex(&q->mutex);
 
+    t = getTime();
+    ok = writePage(page);
+    t = getTime() - t;
 
-static void finishPNG(png_structp *png, png_infop *pngInfo) {
-  if (setjmp(png_jmpbuf(*png))) {
-    exit(2);
+    gLockMutex(&q->mutex);
+    if (!ok) {
+      q->error = gTrue;
+    }
+    q->nBytes -= (long long)page->height * page->rowSize;
+    q->encodeTime += t;
+    gCondSignal(&q->spaceCond);
+    gUnlockMutex(&q->mutex);
+    freePage(page);
   }
-  png_write_end(*png, *pngInfo);
-  png_destroy_write_struct(png, pngInfo);
+}
+
+#endif // MULTITHREADED
+
+// Wall-clock time, in seconds.
+static double getTime() {
+#ifdef _WIN32
+  return (double)GetTickCount64() / 1000.0;
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + 1e-6 * (double)tv.tv_usec;
+#endif
+}
+
+// Peak resident set size of the process, in KB, or -1 if it isn't
+// available.
+static long getPeakRSS() {
+#ifdef _WIN32
+  return -1;
+#else
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage)) {
+    return -1;
+  }
+#ifdef __APPLE__
+  return (long)(usage.ru_maxrss / 1024);
+#else
+  return (long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void printGlyphCacheStats(SplashGlyphCache *glyphCache) {
+  unsigned long long hits, misses;
+
+  hits = glyphCache->getHits();
+  misses = glyphCache->getMisses();
+  fprintf(stderr, "glyph cache: %llu hits, %llu misses (%.1f%% hit rate),"
+	  " %llu evictions\n",
+	  hits, misses,
+	  hits + misses ? 100.0 * (double)hits / (double)(hits + misses) : 0.0,
+	  glyphCache->getEvictions());
+  fprintf(stderr, "glyph cache: %d glyphs, %d of %d bytes used\n",
+	  glyphCache->getNumGlyphs(), glyphCache->getNumBytes(),
+	  glyphCache->getMaxBytes());
+}
+
+static void printBitmapPoolStats(SplashBitmapPool *bitmapPool) {
+  fprintf(stderr, "bitmap pool: %llu allocations (%.1f MB),"
+	  " %llu reuses (%.1f MB)\n",
+	  bitmapPool->getNumAllocs(),
+	  (double)bitmapPool->getAllocBytes() / 1048576.0,
+	  bitmapPool->getNumReuses(),
+	  (double)bitmapPool->getReuseBytes() / 1048576.0);
+  fprintf(stderr, "bitmap pool: %.1f of %.1f MB free buffers kept\n",
+	  (double)bitmapPool->getFreeBytes() / 1048576.0,
+	  (double)bitmapPool->getMaxFreeBytes() / 1048576.0);
 }
@@ -17,6 +17,7 @@
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
 #include "xpdf/SplashOutputDev.h"
+#include "xpdf/SplashBandRenderer.h"
 #include "xpdf/config.h"
 
 static int firstPage = 1;
@@ -25,7 +26,7 @@ static int resolution = 150;
 static GBool mono = gFalse;
 static GBool gray = gFalse;
 static GBool nocrop = gFalse;
-static char enableT1libStr[16] = "";
+static int nThreads = 1;
 static char enableFreeTypeStr[16] = "";
 static char antialiasStr[16] = "";
 static char vectorAntialiasStr[16] = "";
@@ -49,10 +50,8 @@ static ArgDesc argDesc[] = {
    "generate a grayscale PGM file"},
   {"-nocrop",  argFlag,    &nocrop,        0,
    "crop using cropbox"},
-#if HAVE_T1LIB_H
-  {"-t1lib",      argString,      enableT1libStr, sizeof(enableT1libStr),
-   "enable t1lib font rasterizer: yes, no"},
-#endif
+  {"-threads", argInt,     &nThreads,      0,
+   "number of threads, each rendering a band of the page, at most one per CPU (default is 1)"},
 #if HAVE_FREETYPE_FREETYPE_H | HAVE_FREETYPE_H
   {"-freetype",   argString,      enableFreeTypeStr, sizeof(enableFreeTypeStr),
    "enable FreeType font rasterizer: yes, no"},
@@ -89,7 +88,7 @@ int main(int argc, char *argv[]) {
   char ppmFile[512];
   GString *ownerPW, *userPW;
   SplashColor paperColor;
-  SplashOutputDev *splashOut;
+  SplashBandRenderer *renderer;
   GBool ok;
   int exitCode;
   int pg;
@@ -116,11 +115,6 @@ int main(int argc, char *argv[]) {
   globalParams = new GlobalParams(cfgFileName);
   globalParams->setErrQuiet( gTrue );
   globalParams->setupBaseFonts(".");
-  if (enableT1libStr[0]) {
-    if (!globalParams->setEnableT1lib(enableT1libStr)) {
-      fprintf(stderr, "Bad '-t1lib' value on command line\n");
-    }
-  }
   if (enableFreeTypeStr[0]) {
     if (!globalParams->setEnableFreeType(enableFreeTypeStr)) {
       fprintf(stderr, "Bad '-freetype' value on command line\n");
@@ -152,12 +146,6 @@ int main(int argc, char *argv[]) {
     userPW = NULL;
   }
   doc = new PDFDoc(fileName, ownerPW, userPW);
-  if (userPW) {
-    delete userPW;
-  }
-  if (ownerPW) {
-    delete ownerPW;
-  }
   if (!doc->isOk()) {
     exitCode = 1;
     goto err1;
@@ -172,29 +160,37 @@ int main(int argc, char *argv[]) {
   // write PPM files
   if (mono) {
     paperColor[0] = 0xff;
-    splashOut = new SplashOutputDev(splashModeMono1, 1, gFalse, paperColor);
+    renderer = new SplashBandRenderer(doc, ownerPW, userPW, nThreads,
+				      splashModeMono1, 1, gFalse, paperColor);
   } else if (gray) {
     paperColor[0] = 0xff;
-    splashOut = new SplashOutputDev(splashModeMono8, 1, gFalse, paperColor);
+    renderer = new SplashBandRenderer(doc, ownerPW, userPW, nThreads,
+				      splashModeMono8, 1, gFalse, paperColor);
   } else {
     paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
-    splashOut = new SplashOutputDev(splashModeRGB8, 1, gFalse, paperColor);
+    renderer = new SplashBandRenderer(doc, ownerPW, userPW, nThreads,
+				      splashModeRGB8, 1, gFalse, paperColor);
   }
-  splashOut->startDoc(doc->getXRef());
   for (pg = firstPage; pg <= lastPage; ++pg) {
-    doc->displayPage(splashOut, pg, resolution, resolution, 0,
-		     gFalse, nocrop ? gFalse : gTrue, gFalse);
+    renderer->displayPage(pg, resolution, resolution, 0,
+			  gFalse, nocrop ? gFalse : gTrue, gFalse);
     sprintf(ppmFile, "%.*s-%06d.%s",
 	    (int)sizeof(ppmFile) - 32, ppmRoot, pg,
 	    mono ? "pbm" : gray ? "pgm" : "ppm");
-    splashOut->getBitmap()->writePNMFile(ppmFile);
+    renderer->writePNMFile(ppmFile);
   }
-  delete splashOut;
+  delete renderer;
 
   exitCode = 0;
 
   // clean up
  err1:
+  if (userPW) {
+    delete userPW;
+  }
+  if (ownerPW) {
+    delete ownerPW;
+  }
   delete doc;
   delete globalParams;
  err0:
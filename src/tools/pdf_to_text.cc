@@ -11,6 +11,8 @@
 #endif
 #endif
 
+#include <png.h>
+#include <ctype.h>
 #include <stdlib.h>
 
 #include <algorithm>
@@ -18,8 +20,11 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include <stdio.h>
@@ -33,8 +38,13 @@
 #include "xpdf/GlobalParams.h"
 #include "xpdf/Object.h"
 #include "xpdf/PDFDoc.h"
+#include "xpdf/Page.h"
+#include "xpdf/Stream.h"
+#include "xpdf/SplashOutputDev.h"
+#include "xpdf/TeeOutputDev.h"
 #include "xpdf/TextOutputDev.h"
 #include "xpdf/UnicodeMap.h"
+#include "splash/SplashBitmap.h"
 
 #ifdef max
 #undef max
@@ -43,6 +53,8 @@
 #undef min
 #endif
 
+#include "io-document/cache.h"
+#include "io-document/fulltext.h"
 #include "io-document/io-document.h"
 #include "maz-utils/coords.h"
 #include "maz-utils/fs.h"
@@ -118,12 +130,7 @@ namespace {
         return bbox;
     }
 
-    doc::bbox_type get_bbox(TextLineFrag* tlf)
-    {
-        return doc::bbox_type(tlf->xMin, tlf->yMin, tlf->xMax, tlf->yMax);
-    }
-
-    bool is_on_line(const doc::line_type& line, const doc::bbox_type& bbox)
+    bool is_on_line(const doc::flat_page::line& line, const doc::bbox_type& bbox)
     {
         static const int ACCEPTABLE_DIFF = 1;
         if (0 < line.size() && ACCEPTABLE_DIFF > fabs(line.bbox.ylt() - bbox.ylt()) &&
@@ -134,43 +141,45 @@ namespace {
         return false;
     }
 
-    doc::line_type& find_best_line(
+    // returns the index of the line in `page`
+    size_t find_best_line(
         doc::document& doc,
-        doc::lines_type& lines,
+        doc::flat_page& page,
         const doc::bbox_type& line_bbox,
         const doc::bbox_type& words_bbox)
     {
+        std::vector<doc::flat_page::line>& lines = page.lines();
+
         // empty lines
-        if (0 == lines.back()->size())
+        if (0 == lines.back().size())
         {
-            lines.back()->bbox = line_bbox;
-            return *(lines.back());
+            lines.back().bbox = line_bbox;
+            return lines.size() - 1;
 
         } else
         {
             // if the frag is not like the last line, find the best one
-            if (!is_on_line(*(lines.back()), words_bbox))
+            if (!is_on_line(lines.back(), words_bbox))
             {
-                for (doc::lines_type::iterator it = lines.begin(); it != lines.end(); ++it)
+                for (size_t i = 0; i < lines.size(); ++i)
                 {
-                    doc::line_type& line = **it;
-                    if (is_on_line(line, words_bbox))
+                    if (is_on_line(lines[i], words_bbox))
                     {
-                        line.bbox.merge(line_bbox);
-                        return line;
+                        lines[i].bbox.merge(line_bbox);
+                        return i;
                     }
                 }
                 // we have not found the line (even if xpdf thinks the frag
                 // is on the same line as another one) and so return a new
                 // empty line
                 doc.end_line();
-                lines.back()->bbox = line_bbox;
-                return *(lines.back());
+                lines.back().bbox = line_bbox;
+                return lines.size() - 1;
             }
 
             // it is on the last line so merge the bboxes
-            lines.back()->bbox.merge(line_bbox);
-            return *(lines.back());
+            lines.back().bbox.merge(line_bbox);
+            return lines.size() - 1;
         }
     }
 
@@ -182,6 +191,8 @@ namespace {
     {
 
         static vector<string> errors_;
+        // pdfs can be extracted on several threads (see `--stress`)
+        static std::mutex errors_lock_;
         bool ok_;
 
         pdf_library_wrapper(const string& encoding, const string& font_dir) : ok_(false)
@@ -216,12 +227,14 @@ namespace {
             }
             ostringstream oss;
             oss << "[" << pos << "] " << msg;
+            std::lock_guard<std::mutex> lock(errors_lock_);
             errors_.push_back(oss.str());
         }
 
     }; // class pdf_lib
 
     vector<string> pdf_library_wrapper::errors_;
+    std::mutex pdf_library_wrapper::errors_lock_;
 
     class pager_type
     {
@@ -305,6 +318,298 @@ namespace {
 
     }; // class
 
+    //==============================
+    // page cache key
+    //==============================
+
+    //
+    // Hash of everything the words of a page depend on - the decoded content
+    // streams and the resources (fonts, forms, ...) reachable from the page,
+    // the page boxes and the extraction options. Indirect objects are hashed
+    // once per document so shared fonts and forms are decoded only once.
+    //
+    // Stream dictionaries are hashed without /Length, /Filter and
+    // /DecodeParms, and image data is not hashed at all, so the same page
+    // compressed differently gets the same key.
+    //
+    // Annotations are not drawn but form fields are (see Page::displaySlice)
+    // - the widgets of the page with their fields (/V, /AS, /AP streams, ...)
+    // and the form defaults (/DA, /DR, /NeedAppearances) are hashed too.
+    //
+    class page_key_type
+    {
+      public:
+        typedef doc::page_cache::key_type key_type;
+
+      private:
+        // bump when the extraction output changes
+        static constexpr const char* VERSION = "pdf_to_text page v3";
+        static constexpr int MAX_DEPTH = 64;
+
+        typedef std::pair<int, int> ref_type;
+
+        XRef* xref_;
+        // the AcroForm dictionary when the document has form fields
+        Object* form_;
+        key_type options_;
+        std::map<ref_type, key_type> refs_;
+        std::set<ref_type> in_progress_;
+        bool cycle_{false};
+        bool too_deep_{false};
+        int depth_{0};
+
+      public:
+        page_key_type(PDFDoc& pdf, env_type& env)
+            : xref_(pdf.getXRef()),
+              form_(pdf.getCatalog()->getForm() ? pdf.getCatalog()->getAcroForm() : nullptr)
+        {
+            string options = string(VERSION) + "|" + env["dpi"] + "|" + env["rotate"] + "|" +
+                             env["type"] + "|" + env["layout"] + "|" + env["encoding"] + "|" +
+                             env["font-dir"];
+            options_ = hash_str(options, hash_fnv64_seed);
+        }
+
+        /**
+         * Returns false if the page cannot be keyed (e.g., too deeply nested
+         * objects). `state` is whatever else the page output depends on.
+         */
+        bool operator()(Page* page, int state, key_type& key)
+        {
+            too_deep_ = false;
+            key_type h = options_;
+            h = hash_pod(state, h);
+            h = hash_pod(page->getRotate(), h);
+            for (PDFRectangle* rec : {page->getMediaBox(),
+                                      page->getCropBox(),
+                                      page->getTrimBox(),
+                                      page->getBleedBox()})
+            {
+                double coords[] = {rec->x1, rec->y1, rec->x2, rec->y2};
+                h = hash_fnv64(reinterpret_cast<const unsigned char*>(coords), sizeof(coords), h);
+            }
+
+            Object obj;
+            page->getContents(&obj);
+            h = hash(&obj, h);
+            obj.free();
+
+            Dict* resources = page->getResourceDict();
+            if (resources)
+            {
+                h = hash(resources, false, h);
+            }
+
+            if (form_)
+            {
+                for (const char* name : {"DA", "DR", "NeedAppearances", "Q"})
+                {
+                    form_->dictLookupNF(name, &obj);
+                    h = hash_str(name, h);
+                    h = hash(&obj, h);
+                    obj.free();
+                }
+                page->getAnnots(&obj);
+                h = hash_widgets(&obj, h);
+                obj.free();
+            }
+
+            key = h;
+            return !too_deep_;
+        }
+
+      private:
+        template <typename T> static key_type hash_pod(const T& val, key_type h)
+        {
+            return hash_fnv64(reinterpret_cast<const unsigned char*>(&val), sizeof(val), h);
+        }
+
+        static key_type hash_str(const string& s, key_type h)
+        {
+            h = hash_pod(s.size(), h);
+            return hash_fnv64(reinterpret_cast<const unsigned char*>(s.data()), s.size(), h);
+        }
+
+        static bool skip_key(const char* key, bool stream)
+        {
+            // back references (e.g., to the page tree)
+            if (0 == strcmp(key, "Parent") || 0 == strcmp(key, "P")) return true;
+            return stream && (0 == strcmp(key, "Length") || 0 == strcmp(key, "Filter") ||
+                              0 == strcmp(key, "DecodeParms"));
+        }
+
+        key_type hash(Dict* dict, bool stream, key_type h)
+        {
+            h = hash_pod(static_cast<int>(objDict), h);
+            for (int i = 0; i < dict->getLength(); ++i)
+            {
+                const char* key = dict->getKey(i);
+                if (skip_key(key, stream)) continue;
+                h = hash_str(key, h);
+                Object val;
+                dict->getValNF(i, &val);
+                h = hash(&val, h);
+                val.free();
+            }
+            return h;
+        }
+
+        key_type hash_widgets(Object* annots, key_type h)
+        {
+            if (!annots->isArray()) return h;
+            for (int i = 0; i < annots->arrayGetLength(); ++i)
+            {
+                Object annot, subtype;
+                if (annots->arrayGet(i, &annot)->isDict() &&
+                    annot.dictLookup("Subtype", &subtype)->isName("Widget"))
+                {
+                    h = hash_field(annot.getDict(), h);
+                }
+                subtype.free();
+                annot.free();
+            }
+            return h;
+        }
+
+        // the widget and the fields above it (values are inherited) without
+        // their /Kids - the widgets of other pages
+        key_type hash_field(Dict* dict, key_type h)
+        {
+            if (MAX_DEPTH < depth_)
+            {
+                too_deep_ = true;
+                return h;
+            }
+
+            h = hash_pod(static_cast<int>(objDict), h);
+            for (int i = 0; i < dict->getLength(); ++i)
+            {
+                const char* key = dict->getKey(i);
+                if (skip_key(key, false) || 0 == strcmp(key, "Kids")) continue;
+                h = hash_str(key, h);
+                Object val;
+                dict->getValNF(i, &val);
+                h = hash(&val, h);
+                val.free();
+            }
+
+            Object parent;
+            if (dict->lookup("Parent", &parent)->isDict())
+            {
+                ++depth_;
+                h = hash_field(parent.getDict(), h);
+                --depth_;
+            }
+            parent.free();
+            return h;
+        }
+
+        key_type hash(Object* obj, key_type h)
+        {
+            if (MAX_DEPTH < depth_)
+            {
+                too_deep_ = true;
+                return h;
+            }
+
+            h = hash_pod(static_cast<int>(obj->getType()), h);
+            switch (obj->getType())
+            {
+            case objBool:
+                return hash_pod(obj->getBool(), h);
+            case objInt:
+                return hash_pod(obj->getInt(), h);
+            case objReal:
+                return hash_pod(obj->getReal(), h);
+            case objString:
+            {
+                GString* str = obj->getString();
+                return hash_str(string(str->getCString(), str->getLength()), h);
+            }
+            case objName:
+                return hash_str(obj->getName(), h);
+            case objArray:
+            {
+                ++depth_;
+                for (int i = 0; i < obj->arrayGetLength(); ++i)
+                {
+                    Object item;
+                    obj->arrayGetNF(i, &item);
+                    h = hash(&item, h);
+                    item.free();
+                }
+                --depth_;
+                return h;
+            }
+            case objDict:
+            {
+                ++depth_;
+                h = hash(obj->getDict(), false, h);
+                --depth_;
+                return h;
+            }
+            case objStream:
+            {
+                ++depth_;
+                Dict* dict = obj->streamGetDict();
+                h = hash(dict, true, h);
+                --depth_;
+                Object subtype;
+                bool image = dict->lookup("Subtype", &subtype)->isName("Image");
+                subtype.free();
+                if (!image)
+                {
+                    Stream* str = obj->getStream();
+                    char buf[4096];
+                    int n = 0;
+                    str->reset();
+                    while (0 < (n = str->getBlock(buf, sizeof(buf))))
+                    {
+                        h = hash_fnv64(reinterpret_cast<const unsigned char*>(buf), n, h);
+                    }
+                    str->close();
+                }
+                return h;
+            }
+            case objRef:
+                return hash_pod(hash_ref(obj), h);
+            default:
+                return h;
+            }
+        }
+
+        // the hash of an indirect object does not depend on where it is used
+        // unless it is a part of a cycle
+        key_type hash_ref(Object* obj)
+        {
+            ref_type ref(obj->getRefNum(), obj->getRefGen());
+            auto it = refs_.find(ref);
+            if (refs_.end() != it) return it->second;
+            if (in_progress_.count(ref))
+            {
+                cycle_ = true;
+                return 0;
+            }
+
+            bool outer_cycle = cycle_;
+            cycle_ = false;
+            in_progress_.insert(ref);
+            Object val;
+            obj->fetch(xref_, &val);
+            ++depth_;
+            key_type h = hash(&val, hash_fnv64_seed);
+            --depth_;
+            val.free();
+            in_progress_.erase(ref);
+
+            if (!cycle_ && !too_deep_)
+            {
+                refs_[ref] = h;
+            }
+            cycle_ = cycle_ || outer_cycle;
+            return h;
+        }
+    };
+
     //==============================
     // output
     //==============================
@@ -329,13 +634,33 @@ namespace {
         doc::bboxes_type img_bboxes_;
         bool true_types_{true};
 
+        // words in content stream order (--layout=raw)
+        bool raw_order_{false};
+
+        // pages are built compact, keep them so (--page-model=flat)
+        bool flat_{true};
+
+        // text device (for per page allocation stats)
+        TextOutputDev* textout_{nullptr};
+        // the performance block of the page being extracted
+        std::unique_ptr<doc::document::timer_type> page_timer_;
+
+        // full-text index (--index)
+        doc::fulltext_builder* index_{nullptr};
+        int page_num_{0};
+
+        // word ids (see new_word) and the first one of the current page
+        int word_cnt_{0};
+        int page_first_id_{0};
+
       public:
         //
         // ctor
         //
 
         output_listener(env_type& env, PDFDoc& pdfdoc, doc::document& doc)
-            : doc_(doc), pdf_raw(pdfdoc)
+            : doc_(doc), pdf_raw(pdfdoc), raw_order_("raw" == env["layout"]),
+              flat_("objects" != env["page-model"])
         {
             // atoi - dirty but correct
             dpi_ratio = atof(env["dpi"].c_str()) / PDF_SPEC_DPI;
@@ -358,8 +683,13 @@ namespace {
         virtual void start_page(size_t spos, GfxState* state)
         {
             doc_.start_page();
+            doc_.current_page().compact();
             img_bboxes_.clear();
             int pos = static_cast<int>(spos);
+            page_num_ = pos;
+            page_first_id_ = word_cnt_;
+            page_timer_.reset(new doc::document::timer_type(
+                doc_.start_page_timer(("page " + std::to_string(pos)).c_str())));
 
             // rotation
             int pdf_rotation = pdf_raw.getPageRotate(pos);
@@ -385,12 +715,73 @@ namespace {
             doc_.page_info("bleedbox", get_bbox(rec, dpi_ratio));
         }
 
+        void text_dev(TextOutputDev* textout) { textout_ = textout; }
+
+        void index(doc::fulltext_builder* idx) { index_ = idx; }
+
+        //
+        // page cache (--cache)
+        //
+
+        // page output depends on the previous pages through this
+        bool vectored_so_far() const { return true_types_; }
+
+        // store the last extracted page, word ids are stored relative to the page
+        // - a cached page has no performance block (nothing was allocated)
+        void store_page(doc::page_cache& cache, doc::page_cache::key_type key, int page_num)
+        {
+            if (page_num != page_num_) return;
+            doc::page_type& page = doc_.current_page();
+            renumber(page, -page_first_id_);
+            maz::json_dict info = make_json_dict();
+            info["ids"] = word_cnt_ - page_first_id_;
+            cache.put(key, page, info);
+            renumber(page, page_first_id_);
+        }
+
+        // use a cached page instead of extracting it
+        void cached_page(doc::ptr_page ppage, const maz::json_dict& info, int page_num)
+        {
+            doc_.start_page();
+            if (flat_) ppage->compact();
+            doc_.current_page(ppage);
+            page_num_ = page_num;
+            page_first_id_ = word_cnt_;
+            renumber(*ppage, page_first_id_);
+            word_cnt_ += info.value("ids", 0);
+            // the same as end_page would leave it (the key includes the previous value)
+            true_types_ = 0 < ppage->info.count("vectored");
+            if (index_)
+            {
+                index_->add_page(page_num_, *ppage);
+            }
+        }
+
         virtual void end_page(size_t cnt)
         {
             typedef doc::visual_elements::ptr_value visual;
             doc_.page_ia().add(visual(new images_element("images", img_bboxes_)));
             img_bboxes_.clear();
+            if (textout_ && page_timer_.get())
+            {
+                // words, lines, blocks and flows of this page - they depend
+                // on the pages extracted before so they are not in the page
+                TextArena* arena = textout_->getTextArena();
+                page_timer_->param->counters = {{"text_allocs", arena->getNumAllocs()},
+                    {"text_bytes", arena->getUsedBytes()},
+                    {"text_chunks", arena->getNumChunkAllocs()},
+                    {"text_chunk_bytes", arena->getChunkBytes()}};
+            }
+            page_timer_.reset();
             doc_.end_page(100);
+            if (index_)
+            {
+                index_->add_page(page_num_, doc_.current_page());
+            }
+            if (!flat_)
+            {
+                doc_.current_page().expand();
+            }
             if (true_types_)
             {
                 doc_.page_info("vectored", true);
@@ -405,72 +796,133 @@ namespace {
         // which one is called is decided upon definition of rawOrder etc.
         //
 
-        virtual void line(TextLineFrag* frag, const char* str, size_t str_len)
+        // take the whole page at once (see TextPageWords)
+        virtual bool use_page_words() { return true; }
+
+        virtual void page_words(TextPageWords* words)
         {
-            assert(frag);
-            assert(str);
-            if (1 > str_len) return;
+            // font names are shared by the words of a page
+            vector<string> font_names(words->nFonts);
+            for (int i = 0; i < words->nFonts; ++i)
+            {
+                if (words->fontName[i])
+                {
+                    font_names[i] = words->fontName[i]->getCString();
+                }
+            }
+
+            static const string no_font;
+            doc::flat_page& page = *(doc_.current_page().flat);
+            page.reserve(words->nWords, words->textStart[words->nWords]);
 
-            // if we just created new line, put the bboxes there
-            doc::line_type& line = find_best_line(
-                doc_, doc_.current_page().lines, get_bbox(frag->line), get_bbox(frag));
-
-            typedef TextWord* buggered_iterator_type;
-            buggered_iterator_type it = frag->line->getWords();
-            buggered_iterator_type end = frag->line->getLastWord();
-
-            while (it)
-            {
-                static int word_cnt = 0;
-
-                GString* gtext = it->getText();
-                const char* ctext = gtext->getCString();
-                doc::ptr_word pword(new doc::word_type(
-                    ctext,
-                    // the coordinate system should be in target device
-                    // meaning the `pdf_to_png` will match these coordinates
-                    get_bbox(it),
-                    100));
-                delete gtext;
-
-                bool is_vectored = false;
-                // fill out details
-                pword->id = word_cnt++;
-                bbox_type baseline_bb = {pword->bbox.xlt(),
-                                         it->getBaseline(),
-                                         pword->bbox.xrb(),
-                                         it->getBaseline() + 1.};
-                pword->detail.baseline = baseline_bb;
-                pword->detail.underline = (0 != it->isUnderlined());
-                pword->detail.font_size = to_int(it->getFontSize());
-                pword->detail.from_dict = false;
-                pword->detail.numeric = false;
-                if (it->getFontInfo())
+            for (int l = 0; l < words->nLines; ++l)
+            {
+                const TextPageLine& frag = words->lines[l];
+                if (0 < frag.textLen)
                 {
-                    TextFontInfo* tfi = it->getFontInfo();
-                    if (it->getFontName())
+                    // if we just created new line, put the bboxes there
+                    size_t line = find_best_line(
+                        doc_,
+                        page,
+                        doc::bbox_type(frag.xMin, frag.yMin, frag.xMax, frag.yMax),
+                        doc::bbox_type(
+                            frag.fragXMin, frag.fragYMin, frag.fragXMax, frag.fragYMax));
+
+                    for (int i = frag.firstWord; i < frag.firstWord + frag.nWords; ++i)
                     {
-                        pword->detail.font = it->getFontName()->getCString();
+                        doc::flat_page::word w = new_word(
+                            doc::bbox_type(
+                                words->xMin[i], words->yMin[i], words->xMax[i], words->yMax[i]),
+                            words->base[i],
+                            words->fontSize[i],
+                            0 != (words->flags[i] & textWordUnderlined));
+
+                        bool is_vectored = false;
+                        const string* font_name = &no_font;
+                        int font = words->font[i];
+                        if (0 <= font)
+                        {
+                            if (words->fontName[font])
+                            {
+                                font_name = &font_names[font];
+                            }
+                            w.set(doc::flat_page::BOLD, 0 != (words->flags[i] & textWordBold));
+                            w.set(
+                                doc::flat_page::ITALICS, 0 != (words->flags[i] & textWordItalic));
+                            w.set(
+                                doc::flat_page::MONOSPACE,
+                                0 != (words->flags[i] & textWordFixedWidth));
+                            w.set(doc::flat_page::SERIF, 0 != (words->flags[i] & textWordSerif));
+                            // todo letters
+                            is_vectored =
+                                (words->fontType[font] == GfxFontType::fontTrueType ||
+                                 words->fontType[font] == GfxFontType::fontTrueTypeOT);
+                        }
+                        if (!is_vectored) true_types_ = false;
+
+                        append_word(
+                            page,
+                            line,
+                            w,
+                            string(
+                                words->text + words->textStart[i],
+                                words->textStart[i + 1] - words->textStart[i] - 1),
+                            *font_name);
                     }
-                    pword->detail.bold = (0 != tfi->isBold());
-                    pword->detail.italics = (0 != tfi->isItalic());
-                    pword->detail.monospace = (0 != tfi->isFixedWidth());
-                    pword->detail.serif = (0 != tfi->isSerif());
-                    // todo letters
-                    is_vectored =
-                        (tfi->type() == GfxFontType::fontTrueType ||
-                         tfi->type() == GfxFontType::fontTrueTypeOT);
                 }
-                if (!is_vectored) true_types_ = false;
 
-                doc_.append_word(line, pword);
-                if (it == end) break;
+                for (int e = 0; e < frag.nEols; ++e)
+                {
+                    end_line(0);
+                }
+            }
+        }
+
+        // raw order words are delivered one by one, while the page is
+        // drawn; a line is what xpdf puts between two end of lines
+        virtual bool stream_raw_words() { return raw_order_; }
+
+        virtual void line(TextWord* word, const char* str, size_t str_len)
+        {
+            assert(word);
+            assert(str);
+            if (1 > str_len) return;
 
-                it = it->getNext();
+            doc::flat_page::word w = new_word(
+                get_bbox(word), word->getBaseline(), word->getFontSize(), 0 != word->isUnderlined());
+
+            bool is_vectored = false;
+            string font_name;
+            TextFontInfo* tfi = word->getFontInfo();
+            if (tfi)
+            {
+                if (word->getFontName())
+                {
+                    font_name = word->getFontName()->getCString();
+                }
+                w.set(doc::flat_page::BOLD, 0 != tfi->isBold());
+                w.set(doc::flat_page::ITALICS, 0 != tfi->isItalic());
+                w.set(doc::flat_page::MONOSPACE, 0 != tfi->isFixedWidth());
+                w.set(doc::flat_page::SERIF, 0 != tfi->isSerif());
+                // todo letters
+                is_vectored =
+                    (tfi->type() == GfxFontType::fontTrueType ||
+                     tfi->type() == GfxFontType::fontTrueTypeOT);
+            }
+            if (!is_vectored) true_types_ = false;
+
+            doc::flat_page& page = *(doc_.current_page().flat);
+            doc::flat_page::line& line = page.lines().back();
+            if (line.empty())
+            {
+                line.bbox = w.bbox;
+            } else
+            {
+                line.bbox.merge(w.bbox);
             }
+            append_word(page, page.line_count() - 1, w, string(str, str_len), font_name);
         }
 
-        virtual void line(TextWord*, const char*, size_t) { assert(!"not implemented"); }
         virtual void line(TextLine*, const char*, size_t) { assert(!"not implemented"); }
 
         virtual void image(int x, int y, int w, int h, bool inlineImg)
@@ -478,8 +930,205 @@ namespace {
             img_bboxes_.push_back(doc::bbox_type(x, y, x + w, y + h));
         };
 
+      private:
+        static void renumber(doc::page_type& page, int offset)
+        {
+            if (page.flat)
+            {
+                for (doc::flat_page::word& w : page.flat->words())
+                    w.id += offset;
+                return;
+            }
+            page.for_each_word([offset](doc::ptr_word& pword, doc::line_type&) {
+                pword->id += offset;
+            });
+        }
+
+        // new word with the details which do not depend on its font
+        doc::flat_page::word
+        new_word(const doc::bbox_type& bbox, double base, double font_size, bool underline)
+        {
+            doc::flat_page::word w;
+            // the coordinate system should be in target device
+            // meaning the `pdf_to_png` will match these coordinates
+            w.bbox = bbox;
+            w.confidence = 100;
+            w.id = word_cnt_++;
+            w.baseline = {bbox.xlt(), base, bbox.xrb(), base + 1.};
+            w.set(doc::flat_page::UNDERLINE, underline);
+            w.font_size = to_int(font_size);
+            return w;
+        }
+
+        // words with whitespace only are skipped (their ids too)
+        static void append_word(
+            doc::flat_page& page,
+            size_t line,
+            const doc::flat_page::word& w,
+            const string& text,
+            const string& font)
+        {
+            string s(text);
+            maz::remove_whitespace(s);
+            if (s.empty()) return;
+            page.add(line, w, text, font);
+        }
+
     }; // struct outputter
 
+    //==============================
+    // raster output
+    //==============================
+
+    //
+    // Renders the page with a SplashOutputDev in the same Gfx pass as
+    // the text extraction (see TeeOutputDev) and writes it as png.
+    // Words in the json and pixels in the png share one GfxState so
+    // their coordinates match.
+    //
+    struct raster_output
+    {
+        enum pages_type
+        {
+            ALL_PAGES,   // png for every page
+            TEXT_PAGES,  // png only for pages with text
+            NOTEXT_PAGES // png only for pages without text (ocr fallback)
+        };
+
+        std::auto_ptr<SplashOutputDev> splash_ptr_;
+        std::auto_ptr<TeeOutputDev> tee_ptr_;
+        TextOutputDev* textout_;
+        string root_;
+        pages_type pages_;
+        int bit_depth_;
+        int color_type_;
+
+        raster_output(env_type& env, PDFDoc& pdfdoc, TextOutputDev* textout)
+            : textout_(textout), root_(env["png"]), pages_(ALL_PAGES)
+        {
+            if ("text" == env["png-pages"])
+            {
+                pages_ = TEXT_PAGES;
+            } else if ("notext" == env["png-pages"])
+            {
+                pages_ = NOTEXT_PAGES;
+            } else if (!env["png-pages"].empty() && "all" != env["png-pages"])
+            {
+                throw std::runtime_error("Invalid --png-pages option.");
+            }
+
+            SplashColor paper;
+            SplashColorMode mode;
+            if ("mono" == env["png-mode"])
+            {
+                paper[0] = 0xff;
+                mode = splashModeMono1;
+                bit_depth_ = 1;
+                color_type_ = PNG_COLOR_TYPE_GRAY;
+            } else if ("gray" == env["png-mode"])
+            {
+                paper[0] = 0xff;
+                mode = splashModeMono8;
+                bit_depth_ = 8;
+                color_type_ = PNG_COLOR_TYPE_GRAY;
+            } else if (env["png-mode"].empty() || "rgb" == env["png-mode"])
+            {
+                paper[0] = paper[1] = paper[2] = 0xff;
+                mode = splashModeRGB8;
+                bit_depth_ = 8;
+                color_type_ = PNG_COLOR_TYPE_RGB;
+            } else
+            {
+                throw std::runtime_error("Invalid --png-mode option.");
+            }
+
+            splash_ptr_.reset(new SplashOutputDev(mode, 1, gFalse, paper));
+            splash_ptr_->startDoc(pdfdoc.getXRef());
+            tee_ptr_.reset(new TeeOutputDev(splash_ptr_.get(), textout_));
+        }
+
+        OutputDev* dev() { return tee_ptr_.get(); }
+
+        // valid after the page was displayed (until the next one starts)
+        bool has_text()
+        {
+            // getText returns nothing for raw order pages, the word
+            // list works for both
+            TextWordList* words = textout_->makeWordList();
+            bool ret = false;
+            for (int w = 0; w < words->getLength() && !ret; ++w)
+            {
+                GString* text = words->get(w)->getText();
+                for (int i = 0; i < text->getLength() && !ret; ++i)
+                {
+                    ret = !isspace(static_cast<unsigned char>(text->getChar(i)));
+                }
+                delete text;
+            }
+            delete words;
+            return ret;
+        }
+
+        // returns the png file name or an empty string if the page was
+        // skipped
+        string end_page(int page)
+        {
+            if (ALL_PAGES != pages_ && (TEXT_PAGES == pages_) != has_text())
+            {
+                return "";
+            }
+            char suffix[16];
+            snprintf(suffix, sizeof(suffix), "-%06d.png", page);
+            string file_name = root_ + suffix;
+            if (!write_png(file_name, splash_ptr_->getBitmap()))
+            {
+                throw std::runtime_error("Could not write " + file_name);
+            }
+            return file_name;
+        }
+
+        bool write_png(const string& file_name, SplashBitmap* bitmap)
+        {
+            FILE* f = fopen(file_name.c_str(), "wb");
+            if (!f) return false;
+
+            png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+            png_infop png_info = png ? png_create_info_struct(png) : NULL;
+            if (!png_info || setjmp(png_jmpbuf(png)))
+            {
+                png_destroy_write_struct(&png, png_info ? &png_info : NULL);
+                fclose(f);
+                return false;
+            }
+            png_init_io(png, f);
+            if (1 == bit_depth_)
+            {
+                // filtering never helps with 1-bit data
+                png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+            }
+            png_set_IHDR(
+                png,
+                png_info,
+                bitmap->getWidth(),
+                bitmap->getHeight(),
+                bit_depth_,
+                color_type_,
+                PNG_INTERLACE_NONE,
+                PNG_COMPRESSION_TYPE_DEFAULT,
+                PNG_FILTER_TYPE_DEFAULT);
+            png_write_info(png, png_info);
+            SplashColorPtr row = bitmap->getDataPtr();
+            for (int y = 0; y < bitmap->getHeight(); ++y)
+            {
+                png_write_row(png, (png_bytep)row);
+                row += bitmap->getRowSize();
+            }
+            png_write_end(png, png_info);
+            png_destroy_write_struct(&png, &png_info);
+            return 0 == fclose(f);
+        }
+    };
+
     //==============================
     // what to do with a page
     //==============================
@@ -490,11 +1139,16 @@ namespace {
         std::auto_ptr<output_listener> outputter_ptr;
 
         std::auto_ptr<TextOutputDev> textout_ptr_;
+        std::auto_ptr<raster_output> raster_ptr_;
+        std::auto_ptr<doc::fulltext_builder> index_ptr_;
+        std::auto_ptr<doc::page_cache> cache_ptr_;
+        std::auto_ptr<page_key_type> page_key_ptr_;
         env_type& env_;
         doc::document& document_;
 
         pdf_extractor(env_type& env, PDFDoc& pdfdoc, doc::document& document)
-            : textout_ptr_(new TextOutputDev(&append_text_empty, &(std::cout), gTrue, 0, gFalse)),
+            : textout_ptr_(new TextOutputDev(
+                  &append_text_empty, &(std::cout), gTrue, 0, raw_layout(env) ? gTrue : gFalse)),
               env_(env), document_(document)
         {
             if (!(textout_ptr_->isOk()))
@@ -502,13 +1156,34 @@ namespace {
                 logger_.error("PDF text is not valid, trying anyway.");
             }
 
+            // replay the text of forms drawn on many pages (e.g., headers)
+            // - not used when rendering (the text device is behind a tee)
+            //
+            if (!env_["form-cache"].empty() && "on" != env_["form-cache"] &&
+                "off" != env_["form-cache"])
+            {
+                throw std::runtime_error("Invalid --form-cache option.");
+            }
+            textout_ptr_->enableFormCache("off" != env_["form-cache"] ? gTrue : gFalse);
+            textout_ptr_->startDoc(pdfdoc.getXRef());
+
+            // pages are kept compact unless asked for the object model
+            //
+            if (!env_["page-model"].empty() && "flat" != env_["page-model"] &&
+                "objects" != env_["page-model"])
+            {
+                throw std::runtime_error("Invalid --page-model option.");
+            }
+
             // type to use
+            // - the index is built from the words so text output needs them too
             //
-            if ("json" == env_["type"])
+            if ("json" == env_["type"] || ("text" == env_["type"] && !env_["index"].empty()))
             {
                 outputter_ptr.reset(new output_listener(env_, pdfdoc, document));
                 // inform the output device we want more info than usual
                 textout_ptr_->set_listener(outputter_ptr.get());
+                outputter_ptr->text_dev(textout_ptr_.get());
 
             } else if ("metadata" == env_["type"])
             {
@@ -530,9 +1205,123 @@ namespace {
                         fstream::out | fstream::binary | fstream::trunc);
                 }
             }
+
+            // index the words of the pages
+            //
+            if (!env_["index"].empty() && outputter_ptr.get() && "metadata" != env_["type"])
+            {
+                index_ptr_.reset(new doc::fulltext_builder());
+                outputter_ptr->index(index_ptr_.get());
+            }
+
+            // render the pages in the same pass
+            //
+            if (!env_["png"].empty())
+            {
+                raster_ptr_.reset(new raster_output(env_, pdfdoc, textout_ptr_.get()));
+            }
+
+            // reuse pages extracted before - only the json is cached
+            //
+            if (!env_["cache"].empty())
+            {
+                if ("json" != env_["type"] || !env_["output-file"].empty() || raster_ptr_.get())
+                {
+                    logger_.warn("--cache works only with json output, ignoring.");
+                } else
+                {
+                    size_t max_mb = get_env_val<size_t>(env_, "cache-size", 512);
+                    size_t max_pages = get_env_val<size_t>(env_, "cache-pages", 0);
+                    cache_ptr_.reset(
+                        new doc::page_cache(env_["cache"], max_mb * 1024 * 1024, max_pages));
+                    page_key_ptr_.reset(new page_key_type(pdfdoc, env_));
+                }
+            }
+        }
+
+        ~pdf_extractor()
+        {
+            if (g_off.is_open()) g_off.close();
+        }
+
+        // raw - words in content stream order, no layout analysis
+        // phys - words in physical layout order
+        static bool raw_layout(env_type& env)
+        {
+            if ("raw" == env["layout"]) return true;
+            if (!env["layout"].empty() && "phys" != env["layout"])
+            {
+                throw std::runtime_error("Invalid --layout option.");
+            }
+            return false;
         }
 
-        ~pdf_extractor() { g_off.close(); }
+        void end_document()
+        {
+            if ("off" != env_["form-cache"] && !raster_ptr_.get())
+            {
+                int records = 0, replays = 0;
+                textout_ptr_->getFormCacheStats(&records, &replays);
+                maz::json_dict d = make_json_dict();
+                d["records"] = records;
+                d["replays"] = replays;
+                document_.info("form_cache", d);
+            }
+
+            if (cache_ptr_.get())
+            {
+                if (!cache_ptr_->flush())
+                {
+                    logger_.warn("Cannot write --cache index.");
+                }
+                document_.info("page_cache", cache_ptr_->to_json());
+            }
+
+            if (!index_ptr_.get()) return;
+            if (!index_ptr_->write(env_["index"]))
+            {
+                throw std::runtime_error("Cannot write --index file.");
+            }
+            document_.info("index_terms", index_ptr_->term_count());
+            document_.info("index_postings", index_ptr_->posting_count());
+        }
+
+        // take the page from the cache or extract it and store it there
+        void display_cached(PDFDoc& pdf, int page, double dpi, int rotate)
+        {
+            page_key_type::key_type key = 0;
+            bool keyed = (*page_key_ptr_)(
+                pdf.getCatalog()->getPage(page), outputter_ptr->vectored_so_far(), key);
+            if (keyed)
+            {
+                maz::json_dict info;
+                doc::ptr_page ppage = cache_ptr_->get(key, &info);
+                if (ppage)
+                {
+                    outputter_ptr->cached_page(ppage, info, page);
+                    return;
+                }
+            }
+
+            // untranslatable chars get private use unicodes numbered in the
+            // order they are seen in the document - pages with them depend on
+            // the previous pages and are not stored (nor do the stored pages
+            // add to the numbering)
+            size_t invalid_unicodes = textout_ptr_->getNumInvalidUnicodes();
+            pdf.displayPage(
+                textout_ptr_.get(),
+                page,
+                dpi,
+                dpi,
+                rotate,
+                gTrue,   // useMediaBox
+                gTrue,   // crop
+                gFalse); // printing
+            if (keyed && invalid_unicodes == textout_ptr_->getNumInvalidUnicodes())
+            {
+                outputter_ptr->store_page(*cache_ptr_, key, page);
+            }
+        }
 
         void operator()(PDFDoc& pdf, int first_page, int last_page = -1)
         {
@@ -541,7 +1330,36 @@ namespace {
             int rotate = 0;
             value(env_["rotate"], rotate);
 
-            if (-1 == last_page)
+            if (raster_ptr_.get())
+            {
+                if (-1 == last_page) last_page = first_page;
+                for (int page = first_page; page <= last_page; ++page)
+                {
+                    pdf.displayPage(
+                        raster_ptr_->dev(),
+                        page,
+                        dpi,
+                        dpi,
+                        rotate,
+                        gTrue,   // useMediaBox
+                        gTrue,   // crop
+                        gFalse); // printing
+                    string png_file = raster_ptr_->end_page(page);
+                    if (outputter_ptr.get() && "json" == env_["type"])
+                    {
+                        document_.page_info("png", png_file);
+                    }
+                }
+
+            } else if (cache_ptr_.get())
+            {
+                if (-1 == last_page) last_page = first_page;
+                for (int page = first_page; page <= last_page; ++page)
+                {
+                    display_cached(pdf, page, dpi, rotate);
+                }
+
+            } else if (-1 == last_page)
             {
                 pdf.displayPage(
                     textout_ptr_.get(),
@@ -587,6 +1405,29 @@ namespace {
                       "  --dpi         dpi used for output device (default is 300)\n"
                       "  --type        output type - json/text/metadata (default is json)\n"
                       "  --output-file path to output file\n"
+                      "  --layout      word order - phys/raw (default is phys); raw keeps\n"
+                      "                the content stream order and skips layout analysis\n"
+                      "  --index       write a full-text index of the words to this file\n"
+                      "                (query it with pdf_text_search)\n"
+                      "  --cache       directory with pages extracted before (must exist);\n"
+                      "                pages with the same content, fonts and options are\n"
+                      "                taken from there (json output only); pages with\n"
+                      "                untranslatable characters are not cached\n"
+                      "  --cache-size  cache size limit in MB (default is 512)\n"
+                      "  --cache-pages cache page count limit (default is no limit)\n"
+                      "  --png         render the pages in the same pass and write them to\n"
+                      "                <png>-NNNNNN.png (same coordinates as the json)\n"
+                      "  --png-pages   pages to write - all/text/notext (default is all)\n"
+                      "  --png-mode    png colors - rgb/gray/mono (default is rgb)\n"
+                      "  --form-cache  replay the text of forms (e.g., page headers) drawn\n"
+                      "                again instead of interpreting them - on/off (default\n"
+                      "                is on)\n"
+                      "  --page-model  how pages are kept in memory - flat/objects (default\n"
+                      "                is flat); flat stores the words in contiguous arrays,\n"
+                      "                objects as word/line objects\n"
+                      "  --stress      extract the comma separated --file(s) on this many\n"
+                      "                threads at once and compare the pages with a single\n"
+                      "                threaded run (json output only)\n"
                       "\n"
                       "Examples:\n"
                       "  pdf_to_text --help\n"
@@ -646,6 +1487,28 @@ namespace {
                     continue;
                 else if (parse_option(args, *it, "out"))
                     continue;
+                else if (parse_option(args, *it, "layout"))
+                    continue;
+                else if (parse_option(args, *it, "index"))
+                    continue;
+                else if (parse_option(args, *it, "cache-size"))
+                    continue;
+                else if (parse_option(args, *it, "cache-pages"))
+                    continue;
+                else if (parse_option(args, *it, "cache"))
+                    continue;
+                else if (parse_option(args, *it, "png-pages"))
+                    continue;
+                else if (parse_option(args, *it, "png-mode"))
+                    continue;
+                else if (parse_option(args, *it, "form-cache"))
+                    continue;
+                else if (parse_option(args, *it, "page-model"))
+                    continue;
+                else if (parse_option(args, *it, "png"))
+                    continue;
+                else if (parse_option(args, *it, "stress"))
+                    continue;
             }
 
         } catch (exception&)
@@ -674,6 +1537,8 @@ namespace {
     const string NO_ROTATE("0");
     const string TYPE("json");
 
+    typedef vector<int> pages_type;
+
     bool valid_page_num(int page_num) { return page_num <= 0; }
 
     void output_json(env_type& env, doc::document& doc)
@@ -687,6 +1552,106 @@ namespace {
         }
     }
 
+    /** Extract `pages` of the pdf, all if empty. */
+    void extract_pages(PDFDoc& pdf, pdf_extractor& extract, const pages_type& pages)
+    {
+        if (pages.empty())
+        {
+            int first_page = 1;
+            int last_page = pdf.getNumPages();
+            extract(pdf, first_page, last_page);
+            return;
+        }
+
+        // do it for selected pages
+        for (pages_type::const_iterator it = pages.begin(); it != pages.end(); ++it)
+        {
+            if (*it > pdf.getNumPages())
+            {
+                logger_.error("Invalid page number! ");
+                continue;
+            }
+
+            extract(pdf, *it);
+        }
+    }
+
+    //==============================
+    // stress test
+    //==============================
+
+    /**
+     * Returns the json pages of `file` - the values which differ between
+     * runs are outside of them. `env` is a copy - the extraction adds keys
+     * to it.
+     */
+    string stress_pages(env_type env, const string& file, const pages_type& pages)
+    {
+        doc::document doc(env, file);
+        std::unique_ptr<PDFDoc> pdf(new PDFDoc(new GString(file.c_str())));
+        if (!pdf->isOk())
+        {
+            throw std::runtime_error(std::string("PDF is not valid, stopping."));
+        }
+        {
+            pdf_extractor extract(env, *pdf, doc);
+            extract_pages(*pdf, extract, pages);
+            extract.end_document();
+        }
+        doc.populate();
+
+        return doc.to_json()["pages"].dump();
+    }
+
+    /**
+     * Extract `files` on `threads` threads at once and compare each result
+     * with a single threaded run - every thread goes through all files,
+     * each from a different one, so different documents are extracted at
+     * the same time. Returns the number of differences and failures.
+     */
+    int stress(env_type& env, const vector<string>& files, const pages_type& pages, int threads)
+    {
+        vector<string> expected;
+        for (const string& file : files)
+        {
+            expected.push_back(stress_pages(env, file, pages));
+        }
+
+        std::mutex lock;
+        int failed = 0;
+        vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]() {
+                for (size_t i = 0; i < files.size(); ++i)
+                {
+                    size_t idx = (t + i) % files.size();
+                    string error;
+                    try
+                    {
+                        if (expected[idx] != stress_pages(env, files[idx], pages))
+                        {
+                            error = "different pages";
+                        }
+                    } catch (std::exception& e)
+                    {
+                        error = e.what();
+                    }
+                    if (error.empty()) continue;
+                    std::lock_guard<std::mutex> guard(lock);
+                    ++failed;
+                    logger_.error("stress - ", files[idx] + ": " + error);
+                }
+            });
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+
+        std::cout << "stress: " << files.size() << " file(s) on " << threads
+                  << " thread(s), " << failed << " difference(s)" << std::endl;
+        return failed;
+    }
+
 } // namespace
 
 //==============================
@@ -734,7 +1699,6 @@ int main(int argc, char** argv)
     string encoding = env["encoding"];
     string font_dir = env["font-dir"];
 
-    typedef vector<int> pages_type;
     pages_type pages;
     if (env.end() != env.find("page"))
     {
@@ -753,6 +1717,36 @@ int main(int argc, char** argv)
 
     try
     {
+        // run many extractions at once
+        if (env.end() != env.find("stress"))
+        {
+            int threads = 0;
+            value(env["stress"], threads);
+            if (threads < 1)
+            {
+                throw std::runtime_error("Invalid --stress option.");
+            }
+            if ("json" != env["type"] || !env["output-file"].empty() || !env["cache"].empty() ||
+                !env["png"].empty() || !env["index"].empty())
+            {
+                throw std::runtime_error("--stress works only with json output.");
+            }
+
+            vector<string> files;
+            std::istringstream iss(file);
+            for (string f; std::getline(iss, f, ',');)
+            {
+                if (!f.empty()) files.push_back(f);
+            }
+
+            pdf_library_wrapper pdf_lib(encoding, font_dir);
+            if (!pdf_lib.ok_)
+            {
+                return maz::INVALID_PARAM;
+            }
+            return (0 == stress(env, files, pages, threads)) ? ret_code : maz::EXCEPTION;
+        }
+
         //
         doc::document doc(env, file);
         doc.info_command_line(argc, argv);
@@ -779,28 +1773,9 @@ int main(int argc, char** argv)
         {
             {
                 TIMER_PROBE_THIS_FNC(doc);
-                if (pages.empty())
-                {
-                    int first_page = 1;
-                    int last_page = pdf->getNumPages();
-                    extract(*pdf, first_page, last_page);
-
-                } else
-                {
-
-                    // do it for selected pages
-                    for (pages_type::const_iterator it = pages.begin(); it != pages.end(); ++it)
-                    {
-                        if (*it > pdf->getNumPages())
-                        {
-                            logger_.error("Invalid page number! ");
-                            continue;
-                        }
-
-                        extract(*pdf, *it);
-                    }
-                }
+                extract_pages(*pdf, extract, pages);
             }
+            extract.end_document();
 
             // if only text should be written do not output json
             if (should_output_json)
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# Two one-page pdfs which differ only in the value (and the appearance) of
+# a text field. Form fields are drawn even though annotations are not, so
+# the second page must not be served from the --cache filled by the first.
+#
+# tests/cache_form_fields.sh [pdf_to_text]
+#
+
+PDF_TO_TEXT=${1:-./pdf_to_text}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# pdf value file
+make_pdf() {
+    f=$2
+    printf '%%PDF-1.4\n' > "$f"
+    ap="/Tx BMC BT /F1 12 Tf 2 10 Td ($1) Tj ET EMC"
+    content="BT /F1 12 Tf 50 150 Td (Invoice) Tj ET"
+    offsets=""
+    i=0
+    for obj in \
+        "<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [4 0 R] >> >>" \
+        "<< /Type /Pages /Kids [3 0 R] /Count 1 >>" \
+        "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 300 200] /Contents 6 0 R /Resources << /Font << /F1 5 0 R >> >> /Annots [4 0 R] >>" \
+        "<< /Type /Annot /Subtype /Widget /FT /Tx /T (amount) /V ($1) /Rect [50 100 250 130] /P 3 0 R /AP << /N 7 0 R >> >>" \
+        "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>" \
+        "<< /Length ${#content} >>
+stream
+$content
+endstream" \
+        "<< /Type /XObject /Subtype /Form /BBox [0 0 200 30] /Resources << /Font << /F1 5 0 R >> >> /Length ${#ap} >>
+stream
+$ap
+endstream"
+    do
+        i=$((i + 1))
+        offsets="$offsets $(wc -c < "$f")"
+        printf '%d 0 obj\n%s\nendobj\n' $i "$obj" >> "$f"
+    done
+    xref=$(wc -c < "$f")
+    printf 'xref\n0 %d\n0000000000 65535 f \n' $((i + 1)) >> "$f"
+    for o in $offsets; do
+        printf '%010d 00000 n \n' $o >> "$f"
+    done
+    printf 'trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%d\n%%%%EOF\n' $((i + 1)) $xref >> "$f"
+}
+
+make_pdf AAA-1111 "$DIR/a.pdf"
+make_pdf BBB-2222 "$DIR/b.pdf"
+mkdir "$DIR/cache"
+
+"$PDF_TO_TEXT" --file="$DIR/a.pdf" --cache="$DIR/cache" > "$DIR/a.json"
+"$PDF_TO_TEXT" --file="$DIR/b.pdf" --cache="$DIR/cache" > "$DIR/b.json"
+
+if ! grep -q "AAA-1111" "$DIR/a.json"; then
+    echo "FAIL: the field value is not extracted"
+    exit 1
+fi
+if grep -q "AAA-1111" "$DIR/b.json" || ! grep -q "BBB-2222" "$DIR/b.json"; then
+    echo "FAIL: the page with another field value is served from the cache"
+    exit 1
+fi
+echo "OK"
@@ -226,6 +226,29 @@ namespace unilib {
         return ret;
     }
 
+    utf8_string fold_utf8(const utf8_string& s)
+    {
+        utf8_string ret;
+        std::u32string u32s;
+        utf8::decode(s.c_str(), u32s);
+        uninorms::nfkd(u32s);
+
+        // drop the combining marks and lower case the rest
+        u32s.erase(
+            std::remove_if(
+                u32s.begin(),
+                u32s.end(),
+                [](char32_t c) { return 0 != (unicode::category(c) & unicode::M); }),
+            u32s.end());
+        for (char32_t& c32 : u32s)
+        {
+            c32 = unicode::lowercase(c32);
+        }
+        utf8::encode(u32s, ret);
+
+        return ret;
+    }
+
     //
     //
 
@@ -285,4 +285,10 @@ namespace unilib {
     /** Return ascii representation of the string. */
     utf8_string ascii_from_utf8(const utf8_string& s);
 
+    /**
+     * Return case and diacritic folded string used as a search key
+     * e.g., "Žluťoučký" -> "zlutoucky" (ligatures are decomposed too).
+     */
+    utf8_string fold_utf8(const utf8_string& s);
+
 } // namespace unilib
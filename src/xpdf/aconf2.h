@@ -21,4 +21,12 @@
 #  define WIN32
 #endif
 
+/*
+ * strtok() keeps its position in a static variable, so the parsers
+ * use the reentrant strtok_r() which is called strtok_s() on Windows.
+ */
+#ifdef WIN32
+#  define strtok_r strtok_s
+#endif
+
 #endif
@@ -190,7 +190,7 @@ char *FoFiType1::getNextLine(char *line) {
 }
 
 void FoFiType1::parse() {
-  char *line, *line1, *p, *p2;
+  char *line, *line1, *p, *p2, *tokPtr;
   char buf[256];
   char c;
   int n, code, base, i, j;
@@ -206,7 +206,7 @@ void FoFiType1::parse() {
       strncpy(buf, line, 255);
       buf[255] = '\0';
       if ((p = strchr(buf+9, '/')) &&
-	  (p = strtok(p+1, " \t\n\r"))) {
+	  (p = strtok_r(p+1, " \t\n\r", &tokPtr))) {
 	name = copyString(p);
       }
       line = getNextLine(line);
@@ -268,8 +268,8 @@ void FoFiType1::parse() {
 	    }
 	  }
 	} else {
-	  if (strtok(buf, " \t") &&
-	      (p = strtok(NULL, " \t\n\r")) && !strcmp(p, "def")) {
+	  if (strtok_r(buf, " \t", &tokPtr) &&
+	      (p = strtok_r(NULL, " \t\n\r", &tokPtr)) && !strcmp(p, "def")) {
 	    break;
 	  }
 	}
@@ -284,7 +284,8 @@ void FoFiType1::parse() {
 	if ((p2 = strchr(p, ']'))) {
 	  *p2 = '\0';
 	  for (j = 0; j < 6; ++j) {
-	    if ((p = strtok(j == 0 ? p : (char *)NULL, " \t\n\r"))) {
+	    if ((p = strtok_r(j == 0 ? p : (char *)NULL, " \t\n\r",
+			      &tokPtr))) {
 	      fontMatrix[j] = atof(p);
 	    } else {
 	      break;
@@ -21,6 +21,34 @@
 // gUnlockMutex(&m);
 // ...
 // gDestroyMutex(&m);
+//
+// GRWLock l;
+// gInitRWLock(&l);
+// ...
+// gLockRead(&l);            (many readers at once)
+//   ... read-only section ...
+// gUnlockRead(&l);
+// ...
+// gLockWrite(&l);           (one writer, no readers)
+//   ... critical section ...
+// gUnlockWrite(&l);
+// ...
+// gDestroyRWLock(&l);
+//
+// GCond c;
+// gInitCond(&c);
+// ...
+// gLockMutex(&m);
+// while (!ready) gCondWait(&c, &m);
+// gUnlockMutex(&m);
+// ...
+// gCondBroadcast(&c);       (or gCondSignal to wake a single waiter)
+// ...
+// gDestroyCond(&c);
+//
+// GAtomicCounter c = 1;
+// gAtomicIncrement(&c);     (returns the incremented value)
+// if (gAtomicDecrement(&c) == 0) ...
 
 #ifdef _WIN32
 
@@ -33,6 +61,28 @@ typedef CRITICAL_SECTION GMutex;
 #define gLockMutex(m) EnterCriticalSection(m)
 #define gUnlockMutex(m) LeaveCriticalSection(m)
 
+typedef SRWLOCK GRWLock;
+
+#define gInitRWLock(l) InitializeSRWLock(l)
+#define gDestroyRWLock(l)
+#define gLockRead(l) AcquireSRWLockShared(l)
+#define gUnlockRead(l) ReleaseSRWLockShared(l)
+#define gLockWrite(l) AcquireSRWLockExclusive(l)
+#define gUnlockWrite(l) ReleaseSRWLockExclusive(l)
+
+typedef CONDITION_VARIABLE GCond;
+
+#define gInitCond(c) InitializeConditionVariable(c)
+#define gDestroyCond(c)
+#define gCondWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define gCondSignal(c) WakeConditionVariable(c)
+#define gCondBroadcast(c) WakeAllConditionVariable(c)
+
+typedef volatile long GAtomicCounter;
+
+#define gAtomicIncrement(c) InterlockedIncrement(c)
+#define gAtomicDecrement(c) InterlockedDecrement(c)
+
 #else // assume pthreads
 
 #include <pthread.h>
@@ -44,6 +94,28 @@ typedef pthread_mutex_t GMutex;
 #define gLockMutex(m) pthread_mutex_lock(m)
 #define gUnlockMutex(m) pthread_mutex_unlock(m)
 
+typedef pthread_rwlock_t GRWLock;
+
+#define gInitRWLock(l) pthread_rwlock_init(l, NULL)
+#define gDestroyRWLock(l) pthread_rwlock_destroy(l)
+#define gLockRead(l) pthread_rwlock_rdlock(l)
+#define gUnlockRead(l) pthread_rwlock_unlock(l)
+#define gLockWrite(l) pthread_rwlock_wrlock(l)
+#define gUnlockWrite(l) pthread_rwlock_unlock(l)
+
+typedef pthread_cond_t GCond;
+
+#define gInitCond(c) pthread_cond_init(c, NULL)
+#define gDestroyCond(c) pthread_cond_destroy(c)
+#define gCondWait(c, m) pthread_cond_wait(c, m)
+#define gCondSignal(c) pthread_cond_signal(c)
+#define gCondBroadcast(c) pthread_cond_broadcast(c)
+
+typedef volatile long GAtomicCounter;
+
+#define gAtomicIncrement(c) __sync_add_and_fetch(c, 1)
+#define gAtomicDecrement(c) __sync_sub_and_fetch(c, 1)
+
 #endif
 
 #endif
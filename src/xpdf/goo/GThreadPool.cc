@@ -0,0 +1,232 @@
+//========================================================================
+//
+// GThreadPool.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <unistd.h>
+#  if MULTITHREADED
+#    include <pthread.h>
+#  endif
+#endif
+#include "gmem.h"
+#include "GThreadPool.h"
+
+//------------------------------------------------------------------------
+
+#if MULTITHREADED
+
+struct GThreadPoolWorker {
+  GThreadPool *pool;
+#ifdef _WIN32
+  HANDLE thread;
+#else
+  pthread_t thread;
+#endif
+};
+
+#ifdef _WIN32
+static DWORD WINAPI gThreadPoolWorkerMain(LPVOID arg) {
+  ((GThreadPoolWorker *)arg)->pool->workerLoop();
+  return 0;
+}
+#else
+static void *gThreadPoolWorkerMain(void *arg) {
+  ((GThreadPoolWorker *)arg)->pool->workerLoop();
+  return NULL;
+}
+#endif
+
+#endif // MULTITHREADED
+
+//------------------------------------------------------------------------
+// GThreadPool
+//------------------------------------------------------------------------
+
+GThreadPool::GThreadPool(int nThreadsA) {
+#if MULTITHREADED
+  int i;
+#endif
+
+  nThreads = nThreadsA;
+  if (nThreads <= 0) {
+    nThreads = getNumCPUs();
+  }
+#if MULTITHREADED
+  gInitMutex(&mutex);
+  gInitCond(&workCond);
+  gInitCond(&doneCond);
+  func = NULL;
+  data = NULL;
+  nTasks = 0;
+  nextTask = 0;
+  generation = 0;
+  nBusy = 0;
+  quit = gFalse;
+  workers = (GThreadPoolWorker *)gmallocn(nThreads,
+					   sizeof(GThreadPoolWorker));
+  // worker 0 is the calling thread
+  for (i = 1; i < nThreads; ++i) {
+    workers[i].pool = this;
+#ifdef _WIN32
+    workers[i].thread = CreateThread(NULL, 0, &gThreadPoolWorkerMain,
+				     &workers[i], 0, NULL);
+    if (!workers[i].thread) {
+      break;
+    }
+#else
+    if (pthread_create(&workers[i].thread, NULL, &gThreadPoolWorkerMain,
+		       &workers[i])) {
+      break;
+    }
+#endif
+  }
+  // if thread creation failed, just run with the threads we have
+  nThreads = i;
+#else
+  nThreads = 1;
+#endif
+}
+
+GThreadPool::~GThreadPool() {
+#if MULTITHREADED
+  int i;
+
+  gLockMutex(&mutex);
+  quit = gTrue;
+  gCondBroadcast(&workCond);
+  gUnlockMutex(&mutex);
+  for (i = 1; i < nThreads; ++i) {
+#ifdef _WIN32
+    WaitForSingleObject(workers[i].thread, INFINITE);
+    CloseHandle(workers[i].thread);
+#else
+    pthread_join(workers[i].thread, NULL);
+#endif
+  }
+  gfree(workers);
+  gDestroyCond(&doneCond);
+  gDestroyCond(&workCond);
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void GThreadPool::run(GThreadPoolFunc funcA, void *dataA, int nTasksA) {
+#if MULTITHREADED
+  int i;
+
+  if (nThreads == 1 || nTasksA <= 1) {
+    for (i = 0; i < nTasksA; ++i) {
+      (*funcA)(dataA, i);
+    }
+    return;
+  }
+  post(funcA, dataA, nTasksA);
+  runTasks();
+  wait();
+#else
+  int i;
+
+  for (i = 0; i < nTasksA; ++i) {
+    (*funcA)(dataA, i);
+  }
+#endif
+}
+
+void GThreadPool::start(GThreadPoolFunc funcA, void *dataA, int nTasksA) {
+  int i;
+
+#if MULTITHREADED
+  if (nThreads > 1) {
+    post(funcA, dataA, nTasksA);
+    return;
+  }
+#endif
+  for (i = 0; i < nTasksA; ++i) {
+    (*funcA)(dataA, i);
+  }
+}
+
+void GThreadPool::wait() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+  while (nBusy > 0) {
+    gCondWait(&doneCond, &mutex);
+  }
+  gUnlockMutex(&mutex);
+#endif
+}
+
+#if MULTITHREADED
+
+// Hand a job to the worker threads.
+void GThreadPool::post(GThreadPoolFunc funcA, void *dataA, int nTasksA) {
+  gLockMutex(&mutex);
+  func = funcA;
+  data = dataA;
+  nTasks = nTasksA;
+  nextTask = 0;
+  nBusy = nThreads - 1;
+  ++generation;
+  gCondBroadcast(&workCond);
+  gUnlockMutex(&mutex);
+}
+
+void GThreadPool::workerLoop() {
+  int gen;
+
+  gen = 0;
+  while (1) {
+    gLockMutex(&mutex);
+    while (!quit && generation == gen) {
+      gCondWait(&workCond, &mutex);
+    }
+    if (quit) {
+      gUnlockMutex(&mutex);
+      break;
+    }
+    gen = generation;
+    gUnlockMutex(&mutex);
+
+    runTasks();
+
+    gLockMutex(&mutex);
+    if (--nBusy == 0) {
+      gCondSignal(&doneCond);
+    }
+    gUnlockMutex(&mutex);
+  }
+}
+
+void GThreadPool::runTasks() {
+  int task;
+
+  while ((task = (int)gAtomicIncrement(&nextTask) - 1) < nTasks) {
+    (*func)(data, task);
+  }
+}
+
+#endif // MULTITHREADED
+
+int GThreadPool::getNumCPUs() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+  long n;
+
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
@@ -0,0 +1,104 @@
+//========================================================================
+//
+// GThreadPool.h
+//
+// Simple fork/join thread pool.
+//
+//========================================================================
+
+#ifndef GTHREADPOOL_H
+#define GTHREADPOOL_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
+
+// Usage:
+//
+// static void doBand(void *data, int task) { ... }
+//
+// GThreadPool *pool = new GThreadPool(4);
+// pool->run(&doBand, data, nBands);   (returns when all bands are done)
+// ...
+// delete pool;
+//
+// The calling thread runs tasks too, so a pool with nThreads == 1
+// starts no threads at all.  Tasks are handed out in an unspecified
+// order; callers that need deterministic output should make each task
+// write to its own part of the result.
+
+typedef void (*GThreadPoolFunc)(void *data, int task);
+
+#if MULTITHREADED
+struct GThreadPoolWorker;
+#endif
+
+//------------------------------------------------------------------------
+// GThreadPool
+//------------------------------------------------------------------------
+
+class GThreadPool {
+public:
+
+  // Create a pool of <nThreadsA> threads, including the caller.  If
+  // <nThreadsA> is zero or negative, use the number of CPUs.
+  GThreadPool(int nThreadsA);
+
+  ~GThreadPool();
+
+  int getNumThreads() { return nThreads; }
+
+  // Run <func>(<data>, i) for i = 0 .. <nTasks>-1, and wait for all
+  // of the tasks to finish.  Only one thread may call run() at a
+  // time.
+  void run(GThreadPoolFunc func, void *data, int nTasks);
+
+  // Start <func>(<data>, i) for i = 0 .. <nTasks>-1 on the worker
+  // threads, and return without waiting -- unlike run(), the calling
+  // thread doesn't run any of the tasks, so it can keep working (e.g.,
+  // feeding a queue that the tasks consume).  Call wait() before
+  // starting another job.  If the pool has no worker threads
+  // (getNumThreads() == 1), the tasks are run before start() returns.
+  void start(GThreadPoolFunc func, void *data, int nTasks);
+
+  // Wait for the job posted by start() to finish.
+  void wait();
+
+  // Return the number of CPUs available to this process.
+  static int getNumCPUs();
+
+#if MULTITHREADED
+  // Main loop of the worker threads -- for internal use only.
+  void workerLoop();
+#endif
+
+private:
+
+  int nThreads;
+
+#if MULTITHREADED
+  void post(GThreadPoolFunc funcA, void *dataA, int nTasksA);
+  void runTasks();
+
+  GThreadPoolWorker *workers;
+  GMutex mutex;
+  GCond workCond;		// signaled when a new job is posted
+  GCond doneCond;		// signaled when the last worker is done
+  GThreadPoolFunc func;
+  void *data;
+  int nTasks;
+  GAtomicCounter nextTask;
+  int generation;		// incremented for each job
+  int nBusy;			// workers still running the current job
+  GBool quit;
+#endif
+};
+
+#endif
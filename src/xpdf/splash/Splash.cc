@@ -16,6 +16,7 @@
 #include <string.h>
 #include <limits.h>
 #include "gmem.h"
+#include "GThreadPool.h"
 #include "SplashErrorCodes.h"
 #include "SplashMath.h"
 #include "SplashBitmap.h"
@@ -48,6 +49,24 @@ static inline Guchar clip255(int x) {
   return x < 0 ? 0 : x > 255 ? 255 : x;
 }
 
+// The solid color span blending code (blendSolidSpan) and the image
+// scaling kernels use GCC vector extensions, compiled for both AVX2
+// and baseline x86 and picked at runtime.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 9 && \
+    (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_VEC_PIPE 1
+typedef Guchar SplashVecU8 __attribute__((vector_size(16)));
+typedef Gushort SplashVecU16 __attribute__((vector_size(32)));
+typedef int SplashVecI32 __attribute__((vector_size(64)));
+typedef Guint SplashVecU32 __attribute__((vector_size(64)));
+typedef float SplashVecF32 __attribute__((vector_size(64)));
+typedef Guchar SplashVecU8x8 __attribute__((vector_size(8)));
+typedef int SplashVecI32x8 __attribute__((vector_size(32)));
+typedef double SplashVecF64 __attribute__((vector_size(64)));
+#else
+#  define HAVE_VEC_PIPE 0
+#endif
+
 // Used by drawImage and fillImageMask to divide the target
 // quadrilateral into sections.
 struct ImageSection {
@@ -87,6 +106,13 @@ struct SplashPipe {
   // the "run" function
   void (Splash::*run)(SplashPipe *pipe, int x0, int x1, int y,
 		      Guchar *shapePtr, SplashColorPtr cSrcPtr);
+
+  // solid color special cases: 16 pixels' worth of the source color
+  // (after the transfer function), in destination byte order, and the
+  // 'run' function to use for spans with a per-pixel source color
+  Guchar cSolid[16 * splashMaxColorComps];
+  void (Splash::*runScalar)(SplashPipe *pipe, int x0, int x1, int y,
+			    Guchar *shapePtr, SplashColorPtr cSrcPtr);
 };
 
 SplashPipeResultColorCtrl Splash::pipeResultColorNoAlphaBlend[] = {
@@ -260,6 +286,59 @@ inline void Splash::pipeInit(SplashPipe *pipe, SplashPattern *pattern,
 #endif
     }
   }
+
+  // solid color: replace the special cases above with span fills and
+  // (if possible) vectorized blending -- these still call the scalar
+  // functions for spans with a per-pixel source color (images)
+  if (pattern && pipe->run != &Splash::pipeRun &&
+      bitmap->mode != splashModeMono1) {
+    if (pipe->noTransparency) {
+      pipeInitSolid(pipe);
+      pipe->runScalar = pipe->run;
+      pipe->run = &Splash::pipeRunSolidFill;
+#if HAVE_VEC_PIPE
+    } else if (state->identityTransfer &&
+	       state->overprintMask == 0xffffffff) {
+      pipeInitSolid(pipe);
+      pipe->runScalar = pipe->run;
+      pipe->run = &Splash::pipeRunSolidAA;
+#endif
+    }
+  }
+}
+
+// Set up pipe->cSolid from the (static) source color.
+void Splash::pipeInitSolid(SplashPipe *pipe) {
+  Guchar c[splashMaxColorComps];
+  int i;
+
+  switch (bitmap->mode) {
+  case splashModeMono1:
+  case splashModeMono8:
+    c[0] = state->grayTransfer[pipe->cSrcVal[0]];
+    break;
+  case splashModeRGB8:
+    c[0] = state->rgbTransferR[pipe->cSrcVal[0]];
+    c[1] = state->rgbTransferG[pipe->cSrcVal[1]];
+    c[2] = state->rgbTransferB[pipe->cSrcVal[2]];
+    break;
+  case splashModeBGR8:
+    c[0] = state->rgbTransferB[pipe->cSrcVal[2]];
+    c[1] = state->rgbTransferG[pipe->cSrcVal[1]];
+    c[2] = state->rgbTransferR[pipe->cSrcVal[0]];
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    c[0] = state->cmykTransferC[pipe->cSrcVal[0]];
+    c[1] = state->cmykTransferM[pipe->cSrcVal[1]];
+    c[2] = state->cmykTransferY[pipe->cSrcVal[2]];
+    c[3] = state->cmykTransferK[pipe->cSrcVal[3]];
+    break;
+#endif
+  }
+  for (i = 0; i < 16 * bitmapComps; ++i) {
+    pipe->cSolid[i] = c[i % bitmapComps];
+  }
 }
 
 // general case
@@ -311,32 +390,30 @@ void Splash::pipeRun(SplashPipe *pipe, int x0, int x1, int y,
   lastX = x0;
 
   if (bitmap->mode == splashModeMono1) {
-    destColorPtr = &bitmap->data[y * bitmap->rowSize + (x0 >> 3)];
+    destColorPtr = bitmap->getRowPtr(y) + (x0 >> 3);
     destColorMask = 0x80 >> (x0 & 7);
   } else {
-    destColorPtr = &bitmap->data[y * bitmap->rowSize + x0 * bitmapComps];
+    destColorPtr = bitmap->getRowPtr(y) + x0 * bitmapComps;
     destColorMask = 0; // make gcc happy
   }
   if (bitmap->alpha) {
-    destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+    destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
   } else {
     destAlphaPtr = NULL;
   }
   if (state->softMask) {
-    softMaskPtr = &state->softMask->data[y * state->softMask->rowSize + x0];
+    softMaskPtr = state->softMask->getRowPtr(y) + x0;
   } else {
     softMaskPtr = NULL;
   }
   if (state->inKnockoutGroup) {
     if (bitmap->mode == splashModeMono1) {
-      color0Ptr =
-          &groupBackBitmap->data[(groupBackY + y) * groupBackBitmap->rowSize +
-				 ((groupBackX + x0) >> 3)];
+      color0Ptr = groupBackBitmap->getRowPtr(groupBackY + y) +
+		  ((groupBackX + x0) >> 3);
       color0Mask = 0x80 >> ((groupBackX + x0) & 7);
     } else {
-      color0Ptr =
-          &groupBackBitmap->data[(groupBackY + y) * groupBackBitmap->rowSize +
-				 (groupBackX + x0) * bitmapComps];
+      color0Ptr = groupBackBitmap->getRowPtr(groupBackY + y) +
+		  (groupBackX + x0) * bitmapComps;
       color0Mask = 0; // make gcc happy
     }
   } else {
@@ -344,9 +421,8 @@ void Splash::pipeRun(SplashPipe *pipe, int x0, int x1, int y,
     color0Mask = 0; // make gcc happy
   }
   if (state->inNonIsolatedGroup && groupBackBitmap->alpha) {
-    alpha0Ptr =
-        &groupBackBitmap->alpha[(groupBackY + y) * groupBackBitmap->width +
-				(groupBackX + x0)];
+    alpha0Ptr = groupBackBitmap->getAlphaRowPtr(groupBackY + y) +
+		(groupBackX + x0);
   } else {
     alpha0Ptr = NULL;
   }
@@ -836,7 +912,7 @@ void Splash::pipeRunSimpleMono1(SplashPipe *pipe, int x0, int x1, int y,
   updateModX(x1);
   updateModY(y);
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + (x0 >> 3)];
+  destColorPtr = bitmap->getRowPtr(y) + (x0 >> 3);
   destColorMask = 0x80 >> (x0 & 7);
 
   for (x = x0; x <= x1; ++x) {
@@ -877,8 +953,8 @@ void Splash::pipeRunSimpleMono8(SplashPipe *pipe, int x0, int x1, int y,
   updateModX(x1);
   updateModY(y);
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -912,8 +988,8 @@ void Splash::pipeRunSimpleRGB8(SplashPipe *pipe, int x0, int x1, int y,
   updateModX(x1);
   updateModY(y);
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 3 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -950,8 +1026,8 @@ void Splash::pipeRunSimpleBGR8(SplashPipe *pipe, int x0, int x1, int y,
   updateModX(x1);
   updateModY(y);
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 3 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -989,8 +1065,8 @@ void Splash::pipeRunSimpleCMYK8(SplashPipe *pipe, int x0, int x1, int y,
   updateModX(x1);
   updateModY(y);
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 4 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 4 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1038,7 +1114,7 @@ void Splash::pipeRunShapeMono1(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + (x0 >> 3)];
+  destColorPtr = bitmap->getRowPtr(y) + (x0 >> 3);
   destColorMask = 0x80 >> (x0 & 7);
 
   for (x = x0; x <= x1; ++x) {
@@ -1111,8 +1187,8 @@ void Splash::pipeRunShapeMono8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1189,8 +1265,8 @@ void Splash::pipeRunShapeRGB8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 3 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1278,8 +1354,8 @@ void Splash::pipeRunShapeBGR8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 3 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1369,8 +1445,8 @@ void Splash::pipeRunShapeCMYK8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 4 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 4 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1487,7 +1563,7 @@ void Splash::pipeRunAAMono1(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + (x0 >> 3)];
+  destColorPtr = bitmap->getRowPtr(y) + (x0 >> 3);
   destColorMask = 0x80 >> (x0 & 7);
 
   for (x = x0; x <= x1; ++x) {
@@ -1562,8 +1638,8 @@ void Splash::pipeRunAAMono8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1642,8 +1718,8 @@ void Splash::pipeRunAARGB8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 3 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1733,8 +1809,8 @@ void Splash::pipeRunAABGR8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 3 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1826,8 +1902,8 @@ void Splash::pipeRunAACMYK8(SplashPipe *pipe, int x0, int x1, int y,
   updateModY(y);
   lastX = x0;
 
-  destColorPtr = &bitmap->data[y * bitmap->rowSize + 4 * x0];
-  destAlphaPtr = &bitmap->alpha[y * bitmap->width + x0];
+  destColorPtr = bitmap->getRowPtr(y) + 4 * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
 
   for (x = x0; x <= x1; ++x) {
 
@@ -1911,6 +1987,262 @@ void Splash::pipeRunAACMYK8(SplashPipe *pipe, int x0, int x1, int y,
 }
 #endif
 
+// Fill <n> bytes at <dest> with copies of the <patternLen>-byte
+// <pattern>.
+static inline void fillSolidSpan(Guchar *dest, Guchar *pattern,
+				 int patternLen, int n) {
+  while (n >= patternLen) {
+    memcpy(dest, pattern, patternLen);
+    dest += patternLen;
+    n -= patternLen;
+  }
+  memcpy(dest, pattern, n);
+}
+
+// special case:
+// static pattern && pipe->noTransparency && !state->blendFunc &&
+// bitmap->mode != splashModeMono1 && bitmap->alpha
+void Splash::pipeRunSolidFill(SplashPipe *pipe, int x0, int x1, int y,
+			      Guchar *shapePtr, SplashColorPtr cSrcPtr) {
+  if (cSrcPtr) {
+    (this->*pipe->runScalar)(pipe, x0, x1, y, shapePtr, cSrcPtr);
+    return;
+  }
+  if (x0 > x1) {
+    return;
+  }
+  updateModX(x0);
+  updateModX(x1);
+  updateModY(y);
+
+  if (bitmapComps == 1) {
+    memset(bitmap->getRowPtr(y) + x0, pipe->cSolid[0],
+	   x1 - x0 + 1);
+  } else {
+    fillSolidSpan(bitmap->getRowPtr(y) + bitmapComps * x0,
+		  pipe->cSolid, 16 * bitmapComps, bitmapComps * (x1 - x0 + 1));
+  }
+  memset(bitmap->getAlphaRowPtr(y) + x0, 255, x1 - x0 + 1);
+}
+
+#if HAVE_VEC_PIPE
+
+// Expand the per-pixel values in <a> to per-byte values for bytes
+// 16*<k> .. 16*<k>+15 of a span with <nComps> bytes per pixel.
+__attribute__((always_inline))
+static inline SplashVecU8 expandSolidAlpha(SplashVecU8 a, int nComps, int k) {
+  if (nComps == 3) {
+    if (k == 0) {
+      return __builtin_shuffle(a, (SplashVecU8){0, 0, 0, 1, 1, 1, 2, 2,
+						2, 3, 3, 3, 4, 4, 4, 5});
+    } else if (k == 1) {
+      return __builtin_shuffle(a, (SplashVecU8){5, 5, 6, 6, 6, 7, 7, 7,
+						8, 8, 8, 9, 9, 9, 10, 10});
+    } else {
+      return __builtin_shuffle(a, (SplashVecU8){10, 11, 11, 11, 12, 12, 12,
+						13, 13, 13, 14, 14, 14,
+						15, 15, 15});
+    }
+  } else if (nComps == 4) {
+    if (k == 0) {
+      return __builtin_shuffle(a, (SplashVecU8){0, 0, 0, 0, 1, 1, 1, 1,
+						2, 2, 2, 2, 3, 3, 3, 3});
+    } else if (k == 1) {
+      return __builtin_shuffle(a, (SplashVecU8){4, 4, 4, 4, 5, 5, 5, 5,
+						6, 6, 6, 6, 7, 7, 7, 7});
+    } else if (k == 2) {
+      return __builtin_shuffle(a, (SplashVecU8){8, 8, 8, 8, 9, 9, 9, 9,
+						10, 10, 10, 10,
+						11, 11, 11, 11});
+    } else {
+      return __builtin_shuffle(a, (SplashVecU8){12, 12, 12, 12,
+						13, 13, 13, 13,
+						14, 14, 14, 14,
+						15, 15, 15, 15});
+    }
+  }
+  return a;
+}
+
+// Blend the solid color <color> (16 pixels' worth, see
+// SplashPipe.cSolid) into 16 pixels, with source alpha
+// div255(<aInput> * <shapePtr>[i]).  This is the same computation as
+// pipeRunAA*, with an identity transfer function.  The division by
+// the result alpha is done in single precision, which is exact for
+// these operands (<= 255*255 / 1..255).  If the destination is
+// opaque, the result alpha is 255, and the division is skipped.
+__attribute__((always_inline))
+static inline void blendSolid16(Guchar *destColorPtr, Guchar *destAlphaPtr,
+				Guchar *shapePtr, Guchar aInput,
+				Guchar *color, int nComps) {
+  SplashVecU8 shape, aSrc, aDest, aResult, d, c;
+  SplashVecU16 aSrc16, aDest16, a16, r16, v, q;
+  unsigned long long opaque[2];
+  int k;
+
+  memcpy(&shape, shapePtr, 16);
+  memcpy(&aDest, destAlphaPtr, 16);
+  aSrc16 = __builtin_convertvector(shape, SplashVecU16) * aInput;
+  aSrc16 = (aSrc16 + (aSrc16 >> 8) + 0x80) >> 8;
+  aSrc = __builtin_convertvector(aSrc16, SplashVecU8);
+  memcpy(opaque, &aDest, 16);
+
+  if ((opaque[0] & opaque[1]) == ~0ULL) {
+    for (k = 0; k < nComps; ++k) {
+      memcpy(&d, destColorPtr + 16 * k, 16);
+      memcpy(&c, color + 16 * k, 16);
+      a16 = __builtin_convertvector(expandSolidAlpha(aSrc, nComps, k),
+				    SplashVecU16);
+      v = (255 - a16) * __builtin_convertvector(d, SplashVecU16) +
+	  a16 * __builtin_convertvector(c, SplashVecU16);
+      // v / 255, exact for v in [0, 255*255]
+      v = (v + 1 + (v >> 8)) >> 8;
+      d = __builtin_convertvector(v, SplashVecU8);
+      memcpy(destColorPtr + 16 * k, &d, 16);
+    }
+    return;
+  }
+
+  aDest16 = __builtin_convertvector(aDest, SplashVecU16);
+  v = aSrc16 * aDest16;
+  r16 = aSrc16 + aDest16 - ((v + (v >> 8) + 0x80) >> 8);
+  aResult = __builtin_convertvector(r16, SplashVecU8);
+  for (k = 0; k < nComps; ++k) {
+    memcpy(&d, destColorPtr + 16 * k, 16);
+    memcpy(&c, color + 16 * k, 16);
+    a16 = __builtin_convertvector(expandSolidAlpha(aSrc, nComps, k),
+				  SplashVecU16);
+    r16 = __builtin_convertvector(expandSolidAlpha(aResult, nComps, k),
+				  SplashVecU16);
+    v = (r16 - a16) * __builtin_convertvector(d, SplashVecU16) +
+	a16 * __builtin_convertvector(c, SplashVecU16);
+    // v / r16, with 0 where r16 is 0
+    q = __builtin_convertvector(
+	    __builtin_convertvector(
+		__builtin_convertvector(v, SplashVecF32) /
+		__builtin_convertvector(r16 - (SplashVecU16)(r16 == 0),
+					SplashVecF32),
+		SplashVecI32),
+	    SplashVecU16);
+    q = r16 == 0 ? (SplashVecU16){} : q;
+    // pixels with zero shape are left unchanged
+    q = __builtin_convertvector(expandSolidAlpha(shape, nComps, k),
+				SplashVecU16) == 0 ?
+	  __builtin_convertvector(d, SplashVecU16) : q;
+    d = __builtin_convertvector(q, SplashVecU8);
+    memcpy(destColorPtr + 16 * k, &d, 16);
+  }
+  // aResult == aDest where the shape is zero
+  memcpy(destAlphaPtr, &aResult, 16);
+}
+
+// Blend the solid color <color> into <n> pixels, 16 at a time -- see
+// blendSolid16.  The last partial group is copied to a temporary
+// buffer, padded with zero shape values.  This is always inlined, so
+// that it picks up the instruction set of the caller.
+__attribute__((always_inline))
+static inline void blendSolidSpan(Guchar *destColorPtr, Guchar *destAlphaPtr,
+				  Guchar *shapePtr, int n, Guchar aInput,
+				  Guchar *color, int nComps) {
+  Guchar tmpColor[16 * splashMaxColorComps], tmpAlpha[16], tmpShape[16];
+  int x;
+
+  for (x = 0; x + 16 <= n; x += 16) {
+    blendSolid16(destColorPtr + nComps * x, destAlphaPtr + x, shapePtr + x,
+		 aInput, color, nComps);
+  }
+  if (x < n) {
+    memset(tmpColor, 0, sizeof(tmpColor));
+    memset(tmpAlpha, 255, sizeof(tmpAlpha));
+    memset(tmpShape, 0, sizeof(tmpShape));
+    memcpy(tmpColor, destColorPtr + nComps * x, nComps * (n - x));
+    memcpy(tmpAlpha, destAlphaPtr + x, n - x);
+    memcpy(tmpShape, shapePtr + x, n - x);
+    blendSolid16(tmpColor, tmpAlpha, tmpShape, aInput, color, nComps);
+    memcpy(destColorPtr + nComps * x, tmpColor, nComps * (n - x));
+    memcpy(destAlphaPtr + x, tmpAlpha, n - x);
+  }
+}
+
+__attribute__((target_clones("avx2", "default")))
+static void blendSolidSpanMono8(Guchar *destColorPtr, Guchar *destAlphaPtr,
+				Guchar *shapePtr, int n, Guchar aInput,
+				Guchar *color) {
+  blendSolidSpan(destColorPtr, destAlphaPtr, shapePtr, n, aInput, color, 1);
+}
+
+__attribute__((target_clones("avx2", "default")))
+static void blendSolidSpanRGB8(Guchar *destColorPtr, Guchar *destAlphaPtr,
+			       Guchar *shapePtr, int n, Guchar aInput,
+			       Guchar *color) {
+  blendSolidSpan(destColorPtr, destAlphaPtr, shapePtr, n, aInput, color, 3);
+}
+
+#if SPLASH_CMYK
+__attribute__((target_clones("avx2", "default")))
+static void blendSolidSpanCMYK8(Guchar *destColorPtr, Guchar *destAlphaPtr,
+				Guchar *shapePtr, int n, Guchar aInput,
+				Guchar *color) {
+  blendSolidSpan(destColorPtr, destAlphaPtr, shapePtr, n, aInput, color, 4);
+}
+#endif
+
+// special case:
+// static pattern && state->identityTransfer &&
+// state->overprintMask == 0xffffffff &&
+// (pipeRunShape* or pipeRunAA* conditions) &&
+// bitmap->mode != splashModeMono1 && bitmap->alpha
+void Splash::pipeRunSolidAA(SplashPipe *pipe, int x0, int x1, int y,
+			    Guchar *shapePtr, SplashColorPtr cSrcPtr) {
+  SplashColorPtr destColorPtr;
+  Guchar *destAlphaPtr;
+
+  if (cSrcPtr) {
+    (this->*pipe->runScalar)(pipe, x0, x1, y, shapePtr, cSrcPtr);
+    return;
+  }
+  for (; x0 <= x1; ++x0) {
+    if (*shapePtr) {
+      break;
+    }
+    ++shapePtr;
+  }
+  if (x0 > x1) {
+    return;
+  }
+  // shapePtr[0] is non-zero, so this stops at x0
+  while (!shapePtr[x1 - x0]) {
+    --x1;
+  }
+  updateModX(x0);
+  updateModX(x1);
+  updateModY(y);
+
+  destColorPtr = bitmap->getRowPtr(y) + bitmapComps * x0;
+  destAlphaPtr = bitmap->getAlphaRowPtr(y) + x0;
+  switch (bitmap->mode) {
+  case splashModeMono8:
+    blendSolidSpanMono8(destColorPtr, destAlphaPtr, shapePtr, x1 - x0 + 1,
+			pipe->aInput, pipe->cSolid);
+    break;
+  case splashModeRGB8:
+  case splashModeBGR8:
+    blendSolidSpanRGB8(destColorPtr, destAlphaPtr, shapePtr, x1 - x0 + 1,
+		       pipe->aInput, pipe->cSolid);
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    blendSolidSpanCMYK8(destColorPtr, destAlphaPtr, shapePtr, x1 - x0 + 1,
+			pipe->aInput, pipe->cSolid);
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+#endif // HAVE_VEC_PIPE
+
 
 //------------------------------------------------------------------------
 
@@ -1939,6 +2271,12 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   inShading = gFalse;
   state = new SplashState(bitmap->width, bitmap->height, vectorAntialias,
 			  screenParams);
+  if (bitmap->bandH < bitmap->height) {
+    // only the rows in the band are allocated
+    delete state->clip;
+    state->clip = new SplashClip(0, bitmap->bandY, bitmap->width,
+				 bitmap->bandY + bitmap->bandH);
+  }
   scanBuf = (Guchar *)gmalloc(bitmap->width);
   if (vectorAntialias) {
     for (i = 0; i <= 255; ++i) {
@@ -1949,6 +2287,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   }
   minLineWidth = 0;
   clearModRegion();
+  threadPool = NULL;
   debugMode = gFalse;
 }
 
@@ -1962,6 +2301,12 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   inShading = gFalse;
   state = new SplashState(bitmap->width, bitmap->height, vectorAntialias,
 			  screenA);
+  if (bitmap->bandH < bitmap->height) {
+    // only the rows in the band are allocated
+    delete state->clip;
+    state->clip = new SplashClip(0, bitmap->bandY, bitmap->width,
+				 bitmap->bandY + bitmap->bandH);
+  }
   scanBuf = (Guchar *)gmalloc(bitmap->width);
   if (vectorAntialias) {
     for (i = 0; i <= 255; ++i) {
@@ -1972,6 +2317,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   }
   minLineWidth = 0;
   clearModRegion();
+  threadPool = NULL;
   debugMode = gFalse;
 }
 
@@ -2198,104 +2544,87 @@ SplashError Splash::restoreState() {
 //------------------------------------------------------------------------
 
 void Splash::clear(SplashColorPtr color, Guchar alpha) {
-  SplashColorPtr row, p;
+  SplashColorPtr row, mem;
+  Guchar pixel[splashMaxColorComps];
   Guchar mono;
-  int x, y;
+  int memSize, nComps, rowBytes, n, y;
+
+  // the band's rows, in memory order
+  if (bitmap->rowSize < 0) {
+    mem = bitmap->data + bitmap->rowSize * (bitmap->bandH - 1);
+    memSize = -bitmap->rowSize * bitmap->bandH;
+  } else {
+    mem = bitmap->data;
+    memSize = bitmap->rowSize * bitmap->bandH;
+  }
 
+  nComps = 0;
   switch (bitmap->mode) {
   case splashModeMono1:
     mono = (color[0] & 0x80) ? 0xff : 0x00;
-    if (bitmap->rowSize < 0) {
-      memset(bitmap->data + bitmap->rowSize * (bitmap->height - 1),
-	     mono, -bitmap->rowSize * bitmap->height);
-    } else {
-      memset(bitmap->data, mono, bitmap->rowSize * bitmap->height);
-    }
+    memset(mem, mono, memSize);
     break;
   case splashModeMono8:
-    if (bitmap->rowSize < 0) {
-      memset(bitmap->data + bitmap->rowSize * (bitmap->height - 1),
-	     color[0], -bitmap->rowSize * bitmap->height);
-    } else {
-      memset(bitmap->data, color[0], bitmap->rowSize * bitmap->height);
-    }
+    memset(mem, color[0], memSize);
     break;
   case splashModeRGB8:
     if (color[0] == color[1] && color[1] == color[2]) {
-      if (bitmap->rowSize < 0) {
-	memset(bitmap->data + bitmap->rowSize * (bitmap->height - 1),
-	       color[0], -bitmap->rowSize * bitmap->height);
-      } else {
-	memset(bitmap->data, color[0], bitmap->rowSize * bitmap->height);
-      }
+      memset(mem, color[0], memSize);
     } else {
-      row = bitmap->data;
-      for (y = 0; y < bitmap->height; ++y) {
-	p = row;
-	for (x = 0; x < bitmap->width; ++x) {
-	  *p++ = color[0];
-	  *p++ = color[1];
-	  *p++ = color[2];
-	}
-	row += bitmap->rowSize;
-      }
+      pixel[0] = color[0];
+      pixel[1] = color[1];
+      pixel[2] = color[2];
+      nComps = 3;
     }
     break;
   case splashModeBGR8:
     if (color[0] == color[1] && color[1] == color[2]) {
-      if (bitmap->rowSize < 0) {
-	memset(bitmap->data + bitmap->rowSize * (bitmap->height - 1),
-	       color[0], -bitmap->rowSize * bitmap->height);
-      } else {
-	memset(bitmap->data, color[0], bitmap->rowSize * bitmap->height);
-      }
+      memset(mem, color[0], memSize);
     } else {
-      row = bitmap->data;
-      for (y = 0; y < bitmap->height; ++y) {
-	p = row;
-	for (x = 0; x < bitmap->width; ++x) {
-	  *p++ = color[2];
-	  *p++ = color[1];
-	  *p++ = color[0];
-	}
-	row += bitmap->rowSize;
-      }
+      pixel[0] = color[2];
+      pixel[1] = color[1];
+      pixel[2] = color[0];
+      nComps = 3;
     }
     break;
 #if SPLASH_CMYK
   case splashModeCMYK8:
     if (color[0] == color[1] && color[1] == color[2] && color[2] == color[3]) {
-      if (bitmap->rowSize < 0) {
-	memset(bitmap->data + bitmap->rowSize * (bitmap->height - 1),
-	       color[0], -bitmap->rowSize * bitmap->height);
-      } else {
-	memset(bitmap->data, color[0], bitmap->rowSize * bitmap->height);
-      }
+      memset(mem, color[0], memSize);
     } else {
-      row = bitmap->data;
-      for (y = 0; y < bitmap->height; ++y) {
-	p = row;
-	for (x = 0; x < bitmap->width; ++x) {
-	  *p++ = color[0];
-	  *p++ = color[1];
-	  *p++ = color[2];
-	  *p++ = color[3];
-	}
-	row += bitmap->rowSize;
-      }
+      pixel[0] = color[0];
+      pixel[1] = color[1];
+      pixel[2] = color[2];
+      pixel[3] = color[3];
+      nComps = 4;
     }
     break;
 #endif
   }
 
+  // multi-byte pixels: build the first row by repeatedly doubling the
+  // filled part with memcpy, then copy it to the other rows -- this
+  // runs at memcpy speed instead of one byte store at a time
+  if (nComps > 0 && bitmap->width > 0) {
+    row = bitmap->data;
+    rowBytes = bitmap->width * nComps;
+    memcpy(row, pixel, nComps);
+    for (n = nComps; n < rowBytes; n *= 2) {
+      memcpy(row + n, row, n < rowBytes - n ? n : rowBytes - n);
+    }
+    for (y = 1; y < bitmap->bandH; ++y) {
+      memcpy(row + y * bitmap->rowSize, row, rowBytes);
+    }
+  }
+
   if (bitmap->alpha) {
-    memset(bitmap->alpha, alpha, bitmap->width * bitmap->height);
+    memset(bitmap->alpha, alpha, bitmap->width * bitmap->bandH);
   }
 
   updateModX(0);
-  updateModY(0);
+  updateModY(bitmap->bandY);
   updateModX(bitmap->width - 1);
-  updateModY(bitmap->height - 1);
+  updateModY(bitmap->bandY + bitmap->bandH - 1);
 }
 
 SplashError Splash::stroke(SplashPath *path) {
@@ -2372,7 +2701,7 @@ void Splash::strokeNarrow(SplashPath *path) {
   SplashPipe pipe;
   SplashXPath *xPath;
   SplashXPathSeg *seg;
-  int x0, x1, y0, y1, xa, xb, y;
+  int x0, x1, y0, y1, yEnd, xa, xb, y;
   SplashCoord dxdy;
   SplashClipResult clipRes;
   int nClipRes[3];
@@ -2415,15 +2744,22 @@ void Splash::strokeNarrow(SplashPath *path) {
 	  y0 = y;
 	  x0 = splashFloor(seg->x0 + ((SplashCoord)y0 - seg->y0) * dxdy);
 	}
+	// rows before yEnd end where the segment leaves them -- if the
+	// segment is clipped at the bottom, this includes the last row,
+	// so the row doesn't depend on the clip (e.g., a band boundary);
+	// x1 is then only used for the direction, so it is taken at the
+	// bottom of the row, which is still on the segment
+	yEnd = y1;
 	y = state->clip->getYMaxI(state->strokeAdjust);
 	if (y1 > y) {
 	  y1 = y;
-	  x1 = splashFloor(seg->x0 + ((SplashCoord)y1 - seg->y0) * dxdy);
+	  x1 = splashFloor(seg->x0 + ((SplashCoord)y1 + 1 - seg->y0) * dxdy);
+	  yEnd = y1 + 1;
 	}
 	if (x0 <= x1) {
 	  xa = x0;
 	  for (y = y0; y <= y1; ++y) {
-	    if (y < y1) {
+	    if (y < yEnd) {
 	      xb = splashFloor(seg->x0 +
 			       ((SplashCoord)y + 1 - seg->y0) * dxdy);
 	    } else {
@@ -2440,7 +2776,7 @@ void Splash::strokeNarrow(SplashPath *path) {
 	} else {
 	  xa = x0;
 	  for (y = y0; y <= y1; ++y) {
-	    if (y < y1) {
+	    if (y < yEnd) {
 	      xb = splashFloor(seg->x0 +
 			       ((SplashCoord)y + 1 - seg->y0) * dxdy);
 	    } else {
@@ -3096,9 +3432,7 @@ SplashError Splash::fillChar(SplashCoord x, SplashCoord y,
     return splashErrNoGlyph;
   }
   err = fillGlyph2(x0, y0, &glyph);
-  if (glyph.freeData) {
-    gfree(glyph.data);
-  }
+  font->releaseGlyph(&glyph);
   return err;
 }
 
@@ -3219,118 +3553,841 @@ void Splash::getImageBounds(SplashCoord xyMin, SplashCoord xyMax,
   }
 }
 
-// The glyphMode flag is not currently used, but may be useful if the
-// stroke adjustment behavior is changed.
-SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
-				  int w, int h, SplashCoord *mat,
-				  GBool glyphMode, GBool interpolate) {
-  SplashBitmap *scaledMask;
-  SplashClipResult clipRes;
-  GBool minorAxisZero;
-  SplashCoord wSize, hSize, t0, t1;
-  int x0, y0, x1, y1, scaledWidth, scaledHeight;
+//------------------------------------------------------------------------
+// image scaling kernels
+//------------------------------------------------------------------------
 
-  if (debugMode) {
-    printf("fillImageMask: w=%d h=%d mat=[%.2f %.2f %.2f %.2f %.2f %.2f]\n",
-	   w, h, (double)mat[0], (double)mat[1], (double)mat[2],
-	   (double)mat[3], (double)mat[4], (double)mat[5]);
-  }
+// These are used by the image and image mask scaling functions.  The
+// vectorized versions produce exactly the same output as the scalar
+// versions: the box filters are integer-only, and the interpolation
+// kernels do the same floating point operations, in the same order.
 
-  // check for singular matrix
-  if (!splashCheckDet(mat[0], mat[1], mat[2], mat[3], 0.000001)) {
-    return splashErrSingularMatrix;
+#if HAVE_VEC_PIPE
+
+// acc[i] += line[i], for i = 0 .. n-1.
+__attribute__((target_clones("avx2", "default")))
+static void boxFilterAccum(Guint *acc, Guchar *line, int n) {
+  SplashVecU8 v;
+  SplashVecU32 a;
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    memcpy(&v, line + i, 16);
+    memcpy(&a, acc + i, 64);
+    a += __builtin_convertvector(v, SplashVecU32);
+    memcpy(acc + i, &a, 64);
+  }
+  for (; i < n; ++i) {
+    acc[i] += line[i];
   }
+}
 
-  minorAxisZero = splashAbs(mat[1]) <= 0.0001 && splashAbs(mat[2]) <= 0.0001;
+// out[i] = (acc[i] * d) >> 23, for i = 0 .. n-1.
+__attribute__((target_clones("avx2", "default")))
+static void boxFilterDiv(Guint *acc, Guint d, Guchar *out, int n) {
+  SplashVecU32 a;
+  SplashVecU8 v;
+  int i;
 
-  // rough estimate of size of scaled mask
-  t0 = splashAbs(mat[0]);
-  t1 = splashAbs(mat[1]);
-  wSize = t0 > t1 ? t0 : t1;
-  t0 = splashAbs(mat[2]);
-  t1 = splashAbs(mat[3]);
-  hSize = t0 > t1 ? t0 : t1;
+  for (i = 0; i + 16 <= n; i += 16) {
+    memcpy(&a, acc + i, 64);
+    v = __builtin_convertvector((a * d) >> 23, SplashVecU8);
+    memcpy(out + i, &v, 16);
+  }
+  for (; i < n; ++i) {
+    out[i] = (Guchar)((acc[i] * d) >> 23);
+  }
+}
 
-  // stream-mode upscaling -- this is slower, so we only use it if the
-  // upscaled mask is large (in which case clipping should remove many
-  // pixels)
-  if (wSize > 2 * w && hSize > 2 * h && wSize * hSize > 1000000) {
-    upscaleMask(src, srcData, w, h, mat, glyphMode, interpolate);
+#else // HAVE_VEC_PIPE
 
-  // scaling only
-  } else if (mat[0] > 0 && minorAxisZero && mat[3] > 0) {
-    getImageBounds(mat[4], mat[0] + mat[4], &x0, &x1);
-    getImageBounds(mat[5], mat[3] + mat[5], &y0, &y1);
-    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
-				    state->strokeAdjust);
-    opClipRes = clipRes;
-    if (clipRes != splashClipAllOutside) {
-      scaledWidth = x1 - x0;
-      scaledHeight = y1 - y0;
-      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
-			     interpolate);
-      blitMask(scaledMask, x0, y0, clipRes);
-      delete scaledMask;
-    }
-    
-  // scaling plus vertical flip
-  } else if (mat[0] > 0 && minorAxisZero && mat[3] < 0) {
-    getImageBounds(mat[4], mat[0] + mat[4], &x0, &x1);
-    getImageBounds(mat[3] + mat[5], mat[5], &y0, &y1);
-    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
-				    state->strokeAdjust);
-    opClipRes = clipRes;
-    if (clipRes != splashClipAllOutside) {
-      scaledWidth = x1 - x0;
-      scaledHeight = y1 - y0;
-      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
-			     interpolate);
-      vertFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
-      blitMask(scaledMask, x0, y0, clipRes);
-      delete scaledMask;
-    }
+static void boxFilterAccum(Guint *acc, Guchar *line, int n) {
+  int i;
 
-  // scaling plus horizontal flip
-  } else if (mat[0] < 0 && minorAxisZero && mat[3] > 0) {
-    getImageBounds(mat[0] + mat[4], mat[4], &x0, &x1);
-    getImageBounds(mat[5], mat[3] + mat[5], &y0, &y1);
-    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
-				    state->strokeAdjust);
-    opClipRes = clipRes;
-    if (clipRes != splashClipAllOutside) {
-      scaledWidth = x1 - x0;
-      scaledHeight = y1 - y0;
-      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
-			     interpolate);
-      horizFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
-      blitMask(scaledMask, x0, y0, clipRes);
-      delete scaledMask;
-    }
+  for (i = 0; i < n; ++i) {
+    acc[i] += line[i];
+  }
+}
 
-  // scaling plus horizontal and vertical flips
-  } else if (mat[0] < 0 && minorAxisZero && mat[3] < 0) {
-    getImageBounds(mat[0] + mat[4], mat[4], &x0, &x1);
-    getImageBounds(mat[3] + mat[5], mat[5], &y0, &y1);
-    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
-				    state->strokeAdjust);
-    opClipRes = clipRes;
-    if (clipRes != splashClipAllOutside) {
-      scaledWidth = x1 - x0;
-      scaledHeight = y1 - y0;
-      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
-			     interpolate);
-      vertFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
-      horizFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
-      blitMask(scaledMask, x0, y0, clipRes);
-      delete scaledMask;
-    }
+static void boxFilterDiv(Guint *acc, Guint d, Guchar *out, int n) {
+  int i;
 
-  // all other cases
-  } else {
-    arbitraryTransformMask(src, srcData, w, h, mat, glyphMode, interpolate);
+  for (i = 0; i < n; ++i) {
+    out[i] = (Guchar)((acc[i] * d) >> 23);
   }
+}
 
-  return splashOk;
+#endif // HAVE_VEC_PIPE
+
+#if HAVE_VEC_PIPE && !USE_FIXEDPOINT
+
+// out[i] = (int)(s * a[i] + (1 - s) * b[i]), for i = 0 .. n-1.
+__attribute__((target_clones("avx2", "default")))
+static void interpRows(Guchar *a, Guchar *b, SplashCoord s, Guchar *out,
+		       int n) {
+  SplashVecU8x8 a8, b8, r8;
+  SplashVecF64 v;
+  SplashCoord s1;
+  int i;
+
+  s1 = (SplashCoord)1 - s;
+  for (i = 0; i + 8 <= n; i += 8) {
+    memcpy(&a8, a + i, 8);
+    memcpy(&b8, b + i, 8);
+    v = s * __builtin_convertvector(a8, SplashVecF64) +
+        s1 * __builtin_convertvector(b8, SplashVecF64);
+    r8 = __builtin_convertvector(__builtin_convertvector(v, SplashVecI32x8),
+				 SplashVecU8x8);
+    memcpy(out + i, &r8, 8);
+  }
+  for (; i < n; ++i) {
+    out[i] = (Guchar)(int)(s * a[i] + s1 * b[i]);
+  }
+}
+
+// out[i] = splashRound((1 - s) * h0[i] + s * h1[i]), for i = 0 .. n-1.
+// The h0/h1 values must be non-negative (so the rounding can
+// truncate).
+__attribute__((target_clones("avx2", "default")))
+static void blendRows(SplashCoord *h0, SplashCoord *h1, SplashCoord s,
+		      Guchar *out, int n) {
+  SplashVecF64 v0, v1, v;
+  SplashVecU8x8 r8;
+  SplashCoord s1;
+  int i;
+
+  s1 = (SplashCoord)1 - s;
+  for (i = 0; i + 8 <= n; i += 8) {
+    memcpy(&v0, h0 + i, 64);
+    memcpy(&v1, h1 + i, 64);
+    v = s1 * v0 + s * v1;
+    r8 = __builtin_convertvector(__builtin_convertvector(v + 0.5,
+							 SplashVecI32x8),
+				 SplashVecU8x8);
+    memcpy(out + i, &r8, 8);
+  }
+  for (; i < n; ++i) {
+    out[i] = (Guchar)splashRound(s1 * h0[i] + s * h1[i]);
+  }
+}
+
+#else // HAVE_VEC_PIPE && !USE_FIXEDPOINT
+
+static void interpRows(Guchar *a, Guchar *b, SplashCoord s, Guchar *out,
+		       int n) {
+  SplashCoord s1;
+  int i;
+
+  s1 = (SplashCoord)1 - s;
+  for (i = 0; i < n; ++i) {
+    out[i] = (Guchar)(int)(s * a[i] + s1 * b[i]);
+  }
+}
+
+static void blendRows(SplashCoord *h0, SplashCoord *h1, SplashCoord s,
+		      Guchar *out, int n) {
+  SplashCoord s1;
+  int i;
+
+  s1 = (SplashCoord)1 - s;
+  for (i = 0; i < n; ++i) {
+    out[i] = (Guchar)splashRound(s1 * h0[i] + s * h1[i]);
+  }
+}
+
+#endif // HAVE_VEC_PIPE && !USE_FIXEDPOINT
+
+// Horizontal interpolation parameters for scaleImageYuXuI and
+// scaleMaskYuXuI, which are the same for every row: scaled pixel x is
+// interpolated from source pixels x0[x] and x1[x], with weights
+// xs[x] and 1 - xs[x].
+static void interpColumns(int srcWidth, int scaledWidth,
+			  int *x0, int *x1, SplashCoord *xs) {
+  SplashCoord xr, xSrc;
+  int x;
+
+  xr = (SplashCoord)srcWidth / (SplashCoord)scaledWidth;
+  for (x = 0; x < scaledWidth; ++x) {
+    xSrc = xr * x;
+    x0[x] = splashFloor(xSrc + xr * 0.5 - 0.5);
+    x1[x] = x0[x] + 1;
+    xs[x] = ((SplashCoord)x1[x] + 0.5) - (xSrc + xr * 0.5);
+    if (x0[x] < 0) {
+      x0[x] = 0;
+    }
+    if (x1[x] >= srcWidth) {
+      x1[x] = srcWidth - 1;
+    }
+  }
+}
+
+// Horizontally interpolate one row of <nComps>-component pixels, using
+// the parameters from interpColumns.
+static void interpRowXu(Guchar *line, int nComps, int scaledWidth,
+			int *x0, int *x1, SplashCoord *xs, Guchar *out) {
+  Guchar *p0, *p1;
+  int x, i;
+
+  for (x = 0; x < scaledWidth; ++x) {
+    p0 = line + x0[x] * nComps;
+    p1 = line + x1[x] * nComps;
+    for (i = 0; i < nComps; ++i) {
+      *out++ = (Guchar)(int)(xs[x] * p0[i] +
+			     ((SplashCoord)1 - xs[x]) * p1[i]);
+    }
+  }
+}
+
+// Horizontal pass of the box filter: scaled pixel x is the sum of
+// xStep pixels from <acc>, times d / 2^23, where xStep and d are
+// either xp and d0, or xp + 1 and d1 (x scale Bresenham).
+static void boxFilterRowXd(Guint *acc, int nComps, int scaledWidth,
+			   int xp, int xq, Guint d0, Guint d1, Guchar *out) {
+  Guint pix0, pix1, pix2, pix3, d;
+  int xt, x, xStep, i, j;
+
+  xt = 0;
+  switch (nComps) {
+  case 1:
+    for (x = 0; x < scaledWidth; ++x) {
+      if ((xt += xq) >= scaledWidth) {
+	xt -= scaledWidth;
+	xStep = xp + 1;
+	d = d1;
+      } else {
+	xStep = xp;
+	d = d0;
+      }
+      pix0 = 0;
+      for (i = 0; i < xStep; ++i) {
+	pix0 += *acc++;
+      }
+      *out++ = (Guchar)((pix0 * d) >> 23);
+    }
+    break;
+  case 3:
+    for (x = 0; x < scaledWidth; ++x) {
+      if ((xt += xq) >= scaledWidth) {
+	xt -= scaledWidth;
+	xStep = xp + 1;
+	d = d1;
+      } else {
+	xStep = xp;
+	d = d0;
+      }
+      pix0 = pix1 = pix2 = 0;
+      for (i = 0; i < xStep; ++i) {
+	pix0 += acc[0];
+	pix1 += acc[1];
+	pix2 += acc[2];
+	acc += 3;
+      }
+      out[0] = (Guchar)((pix0 * d) >> 23);
+      out[1] = (Guchar)((pix1 * d) >> 23);
+      out[2] = (Guchar)((pix2 * d) >> 23);
+      out += 3;
+    }
+    break;
+  case 4:
+    for (x = 0; x < scaledWidth; ++x) {
+      if ((xt += xq) >= scaledWidth) {
+	xt -= scaledWidth;
+	xStep = xp + 1;
+	d = d1;
+      } else {
+	xStep = xp;
+	d = d0;
+      }
+      pix0 = pix1 = pix2 = pix3 = 0;
+      for (i = 0; i < xStep; ++i) {
+	pix0 += acc[0];
+	pix1 += acc[1];
+	pix2 += acc[2];
+	pix3 += acc[3];
+	acc += 4;
+      }
+      out[0] = (Guchar)((pix0 * d) >> 23);
+      out[1] = (Guchar)((pix1 * d) >> 23);
+      out[2] = (Guchar)((pix2 * d) >> 23);
+      out[3] = (Guchar)((pix3 * d) >> 23);
+      out += 4;
+    }
+    break;
+  default:
+    for (x = 0; x < scaledWidth; ++x) {
+      if ((xt += xq) >= scaledWidth) {
+	xt -= scaledWidth;
+	xStep = xp + 1;
+	d = d1;
+      } else {
+	xStep = xp;
+	d = d0;
+      }
+      for (j = 0; j < nComps; ++j) {
+	pix0 = 0;
+	for (i = 0; i < xStep; ++i) {
+	  pix0 += acc[i * nComps + j];
+	}
+	out[j] = (Guchar)((pix0 * d) >> 23);
+      }
+      acc += xStep * nComps;
+      out += nComps;
+    }
+    break;
+  }
+}
+
+// Horizontal expansion: pixel x of <line> is repeated xStep times,
+// where xStep is xp or xp + 1 (x scale Bresenham).
+static void replicateRowXu(Guchar *line, int nComps, int srcWidth,
+			   int xp, int xq, Guchar *out) {
+  int xt, x, xStep, i, j;
+
+  xt = 0;
+  for (x = 0; x < srcWidth; ++x) {
+    if ((xt += xq) >= srcWidth) {
+      xt -= srcWidth;
+      xStep = xp + 1;
+    } else {
+      xStep = xp;
+    }
+    if (nComps == 1) {
+      memset(out, line[x], xStep);
+      out += xStep;
+    } else {
+      for (i = 0; i < xStep; ++i) {
+	for (j = 0; j < nComps; ++j) {
+	  *out++ = line[x * nComps + j];
+	}
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// SplashUpscale
+//------------------------------------------------------------------------
+
+// Stream-mode upscaling (upscaleImage and upscaleMask) buffers the
+// whole source image, so the output rows are independent of each
+// other.  The rows are resampled one block at a time into
+// colorBuf/shapeBuf -- split across the thread pool, if there is one
+// -- and then run through the pipe in order.  Without rotation, the
+// resampling is separable: the per-column parameters are computed
+// once, and each interpolated row is a blend of two cached,
+// horizontally interpolated source rows.
+
+#define splashUpscaleBlockRows 64
+
+// Per-task cache of horizontally interpolated source rows.
+struct SplashUpscaleCache {
+  int ySrc[2];			// cached source rows (-1 = unused)
+  SplashCoord *color[2];	// w * nComps interpolated color values
+  SplashCoord *alpha[2];	// w interpolated alpha values
+};
+
+struct SplashUpscale {
+  Guchar *img;			// source image
+  Guchar *alpha;		// source alpha (NULL if none)
+  int srcWidth, srcHeight, nComps;
+  GBool interpolate;
+  GBool needShape;		// compute shape values (false for masks)
+  SplashCoord mi0, mi1, mi2,	// device-to-source transform
+              mi3, mi4, mi5;
+  int xMin, w;			// device columns (xMin .. xMin + w - 1)
+  GBool separable;		// true if mi1 == mi2 == 0
+
+  // per-column parameters (separable only)
+  int *colX0, *colX1;		// source columns
+  SplashCoord *colS;		// interpolation weights
+  Guchar *colShape;		// 0xff if the column is inside the image
+
+  // current block of rows
+  int yA, yB;			// rows yA .. yB - 1
+  int rowsPerTask;
+  Guchar *colorBuf;		// splashUpscaleBlockRows * w * nComps
+  Guchar *shapeBuf;		// splashUpscaleBlockRows * w (if needShape)
+
+  int nTasks;			// max number of parallel tasks
+  SplashUpscaleCache *caches;	// [nTasks]
+};
+
+// Allocate the buffers and compute the per-column parameters.  The
+// caller fills in the rest of the struct first.
+static void upscaleInit(SplashUpscale *us) {
+  SplashCoord ix;
+  int x, x0, i, k;
+
+  us->separable = us->mi1 == 0 && us->mi2 == 0;
+  us->colX0 = us->colX1 = NULL;
+  us->colS = NULL;
+  us->colShape = NULL;
+  if (us->separable) {
+    us->colX0 = (int *)gmallocn(us->w, sizeof(int));
+    us->colX1 = (int *)gmallocn(us->w, sizeof(int));
+    us->colS = (SplashCoord *)gmallocn(us->w, sizeof(SplashCoord));
+    us->colShape = (Guchar *)gmalloc(us->w);
+    for (x = 0; x < us->w; ++x) {
+      // mi2 == 0, so this is the same for every row
+      ix = ((SplashCoord)(us->xMin + x) + 0.5) * us->mi0
+	   + (SplashCoord)0.5 * us->mi2 + us->mi4;
+      if (us->interpolate) {
+	us->colShape[x] = (ix >= 0 && ix < us->srcWidth) ? 0xff : 0;
+	x0 = splashFloor(ix - 0.5);
+	us->colS[x] = (ix - 0.5) - x0;
+	us->colX0[x] = x0 < 0 ? 0 : x0;
+	us->colX1[x] = x0 + 1 >= us->srcWidth ? us->srcWidth - 1 : x0 + 1;
+      } else {
+	x0 = splashFloor(ix);
+	us->colShape[x] = (x0 >= 0 && x0 < us->srcWidth) ? 0xff : 0;
+	us->colX0[x] = us->colX1[x] = x0;
+	us->colS[x] = 0;
+      }
+    }
+  }
+  us->colorBuf = (Guchar *)gmallocn(splashUpscaleBlockRows,
+				    us->w * us->nComps);
+  us->shapeBuf = us->needShape
+                   ? (Guchar *)gmallocn(splashUpscaleBlockRows, us->w)
+                   : (Guchar *)NULL;
+  us->caches = (SplashUpscaleCache *)gmallocn(us->nTasks,
+					      sizeof(SplashUpscaleCache));
+  for (i = 0; i < us->nTasks; ++i) {
+    for (k = 0; k < 2; ++k) {
+      us->caches[i].ySrc[k] = -1;
+      us->caches[i].color[k] = NULL;
+      us->caches[i].alpha[k] = NULL;
+    }
+  }
+}
+
+static void upscaleFree(SplashUpscale *us) {
+  int i, k;
+
+  for (i = 0; i < us->nTasks; ++i) {
+    for (k = 0; k < 2; ++k) {
+      gfree(us->caches[i].color[k]);
+      gfree(us->caches[i].alpha[k]);
+    }
+  }
+  gfree(us->caches);
+  gfree(us->shapeBuf);
+  gfree(us->colorBuf);
+  gfree(us->colShape);
+  gfree(us->colS);
+  gfree(us->colX1);
+  gfree(us->colX0);
+}
+
+// Resample device row <y> with an arbitrary transform.
+static void upscaleRowGeneric(SplashUpscale *us, int y,
+			      Guchar *color, Guchar *shape) {
+  Guchar *img, *alpha, *p, *q00, *q01, *q10, *q11;
+  SplashCoord ix, iy, sx, sy, pix0, pix1;
+  int srcWidth, srcHeight, nComps, x, x0, x1, y0, y1, i;
+
+  img = us->img;
+  alpha = us->alpha;
+  srcWidth = us->srcWidth;
+  srcHeight = us->srcHeight;
+  nComps = us->nComps;
+  p = color;
+  for (x = us->xMin; x < us->xMin + us->w; ++x) {
+    ix = ((SplashCoord)x + 0.5) * us->mi0 + ((SplashCoord)y + 0.5) * us->mi2
+         + us->mi4;
+    iy = ((SplashCoord)x + 0.5) * us->mi1 + ((SplashCoord)y + 0.5) * us->mi3
+         + us->mi5;
+    if (us->interpolate) {
+      if (ix >= 0 && ix < srcWidth && iy >= 0 && iy < srcHeight) {
+	x0 = splashFloor(ix - 0.5);
+	x1 = x0 + 1;
+	sx = (ix - 0.5) - x0;
+	y0 = splashFloor(iy - 0.5);
+	y1 = y0 + 1;
+	sy = (iy - 0.5) - y0;
+	if (x0 < 0) {
+	  x0 = 0;
+	}
+	if (x1 >= srcWidth) {
+	  x1 = srcWidth - 1;
+	}
+	if (y0 < 0) {
+	  y0 = 0;
+	}
+	if (y1 >= srcHeight) {
+	  y1 = srcHeight - 1;
+	}
+	q00 = &img[(y0 * srcWidth + x0) * nComps];
+	q01 = &img[(y0 * srcWidth + x1) * nComps];
+	q10 = &img[(y1 * srcWidth + x0) * nComps];
+	q11 = &img[(y1 * srcWidth + x1) * nComps];
+	for (i = 0; i < nComps; ++i) {
+	  pix0 = ((SplashCoord)1 - sx) * *q00++ + sx * *q01++;
+	  pix1 = ((SplashCoord)1 - sx) * *q10++ + sx * *q11++;
+	  *p++ = (Guchar)splashRound(((SplashCoord)1 - sy) * pix0
+				     + sy * pix1);
+	}
+	if (shape) {
+	  if (alpha) {
+	    pix0 = ((SplashCoord)1 - sx) * alpha[y0 * srcWidth + x0]
+	           + sx * alpha[y0 * srcWidth + x1];
+	    pix1 = ((SplashCoord)1 - sx) * alpha[y1 * srcWidth + x0]
+	           + sx * alpha[y1 * srcWidth + x1];
+	    *shape++ = (Guchar)splashRound(((SplashCoord)1 - sy) * pix0
+					   + sy * pix1);
+	  } else {
+	    *shape++ = 0xff;
+	  }
+	}
+      } else {
+	for (i = 0; i < nComps; ++i) {
+	  *p++ = 0;
+	}
+	if (shape) {
+	  *shape++ = 0;
+	}
+      }
+    } else {
+      x0 = splashFloor(ix);
+      y0 = splashFloor(iy);
+      if (x0 >= 0 && x0 < srcWidth && y0 >= 0 && y0 < srcHeight) {
+	q00 = &img[(y0 * srcWidth + x0) * nComps];
+	for (i = 0; i < nComps; ++i) {
+	  *p++ = *q00++;
+	}
+	if (shape) {
+	  *shape++ = alpha ? alpha[y0 * srcWidth + x0] : 0xff;
+	}
+      } else {
+	for (i = 0; i < nComps; ++i) {
+	  *p++ = 0;
+	}
+	if (shape) {
+	  *shape++ = 0;
+	}
+      }
+    }
+  }
+}
+
+// Return the y coordinate in the source image for device row <y>
+// (separable case only).
+static SplashCoord upscaleSrcY(SplashUpscale *us, int y) {
+  // mi1 == 0, so this is the same for every column
+  return ((SplashCoord)us->xMin + 0.5) * us->mi1
+         + ((SplashCoord)y + 0.5) * us->mi3 + us->mi5;
+}
+
+// Make sure source row <ySrc> is in <cache>, without evicting slot
+// <keep>, and return its slot.
+static int upscaleCacheRow(SplashUpscale *us, SplashUpscaleCache *cache,
+			   int ySrc, int keep) {
+  SplashCoord *h;
+  Guchar *q;
+  SplashCoord sx;
+  int nComps, x, x0, x1, k, i;
+
+  if (cache->ySrc[0] == ySrc) {
+    return 0;
+  }
+  if (cache->ySrc[1] == ySrc) {
+    return 1;
+  }
+  k = keep == 0 ? 1 : 0;
+  nComps = us->nComps;
+  if (!cache->color[k]) {
+    cache->color[k] = (SplashCoord *)gmallocn(us->w * nComps,
+					      sizeof(SplashCoord));
+    if (us->alpha) {
+      cache->alpha[k] = (SplashCoord *)gmallocn(us->w, sizeof(SplashCoord));
+    }
+  }
+  h = cache->color[k];
+  q = us->img + ySrc * us->srcWidth * nComps;
+  for (x = 0; x < us->w; ++x) {
+    if (us->colShape[x]) {
+      x0 = us->colX0[x] * nComps;
+      x1 = us->colX1[x] * nComps;
+      sx = us->colS[x];
+      for (i = 0; i < nComps; ++i) {
+	h[i] = ((SplashCoord)1 - sx) * q[x0 + i] + sx * q[x1 + i];
+      }
+    } else {
+      for (i = 0; i < nComps; ++i) {
+	h[i] = 0;
+      }
+    }
+    h += nComps;
+  }
+  if (us->alpha) {
+    h = cache->alpha[k];
+    q = us->alpha + ySrc * us->srcWidth;
+    for (x = 0; x < us->w; ++x) {
+      if (us->colShape[x]) {
+	sx = us->colS[x];
+	h[x] = ((SplashCoord)1 - sx) * q[us->colX0[x]]
+	       + sx * q[us->colX1[x]];
+      } else {
+	h[x] = 0;
+      }
+    }
+  }
+  cache->ySrc[k] = ySrc;
+  return k;
+}
+
+// Resample device row <y> with interpolation (separable case only).
+static void upscaleRowInterp(SplashUpscale *us, SplashUpscaleCache *cache,
+			     int y, Guchar *color, Guchar *shape) {
+  SplashCoord iy, sy;
+  int y0, y1, k0, k1;
+
+  iy = upscaleSrcY(us, y);
+  if (!(iy >= 0 && iy < us->srcHeight)) {
+    memset(color, 0, us->w * us->nComps);
+    if (shape) {
+      memset(shape, 0, us->w);
+    }
+    return;
+  }
+  y0 = splashFloor(iy - 0.5);
+  y1 = y0 + 1;
+  sy = (iy - 0.5) - y0;
+  if (y0 < 0) {
+    y0 = 0;
+  }
+  if (y1 >= us->srcHeight) {
+    y1 = us->srcHeight - 1;
+  }
+  k0 = upscaleCacheRow(us, cache, y0, -1);
+  k1 = upscaleCacheRow(us, cache, y1, k0);
+  blendRows(cache->color[k0], cache->color[k1], sy, color,
+	    us->w * us->nComps);
+  if (shape) {
+    if (us->alpha) {
+      blendRows(cache->alpha[k0], cache->alpha[k1], sy, shape, us->w);
+    } else {
+      memcpy(shape, us->colShape, us->w);
+    }
+  }
+}
+
+// Resample device row <y> from source row <ySrc> without
+// interpolation (separable case only).  If <ySrc> is -1, the row is
+// outside the image.
+static void upscaleRowNearest(SplashUpscale *us, int ySrc,
+			      Guchar *color, Guchar *shape) {
+  Guchar *q, *a, *p;
+  int nComps, x, i;
+
+  nComps = us->nComps;
+  if (ySrc < 0) {
+    memset(color, 0, us->w * nComps);
+    if (shape) {
+      memset(shape, 0, us->w);
+    }
+    return;
+  }
+  q = us->img + ySrc * us->srcWidth * nComps;
+  p = color;
+  for (x = 0; x < us->w; ++x) {
+    if (us->colShape[x]) {
+      for (i = 0; i < nComps; ++i) {
+	p[i] = q[us->colX0[x] * nComps + i];
+      }
+    } else {
+      for (i = 0; i < nComps; ++i) {
+	p[i] = 0;
+      }
+    }
+    p += nComps;
+  }
+  if (shape) {
+    if (us->alpha) {
+      a = us->alpha + ySrc * us->srcWidth;
+      for (x = 0; x < us->w; ++x) {
+	shape[x] = us->colShape[x] ? a[us->colX0[x]] : 0;
+      }
+    } else {
+      memcpy(shape, us->colShape, us->w);
+    }
+  }
+}
+
+// Resample one task's share of the current block.
+static void upscaleTask(void *data, int task) {
+  SplashUpscale *us;
+  Guchar *color, *shape;
+  SplashCoord iy;
+  int y0, y1, y, ySrc, prevYSrc, colorSize;
+
+  us = (SplashUpscale *)data;
+  y0 = us->yA + task * us->rowsPerTask;
+  y1 = y0 + us->rowsPerTask;
+  if (y1 > us->yB) {
+    y1 = us->yB;
+  }
+  colorSize = us->w * us->nComps;
+  prevYSrc = 0;
+  for (y = y0; y < y1; ++y) {
+    color = us->colorBuf + (y - us->yA) * colorSize;
+    shape = us->shapeBuf ? us->shapeBuf + (y - us->yA) * us->w : NULL;
+    if (!us->separable) {
+      upscaleRowGeneric(us, y, color, shape);
+    } else if (us->interpolate) {
+      upscaleRowInterp(us, &us->caches[task], y, color, shape);
+    } else {
+      iy = upscaleSrcY(us, y);
+      ySrc = splashFloor(iy);
+      if (ySrc < 0 || ySrc >= us->srcHeight) {
+	ySrc = -1;
+      }
+      // consecutive rows usually come from the same source row
+      if (y > y0 && ySrc == prevYSrc) {
+	memcpy(color, color - colorSize, colorSize);
+	if (shape) {
+	  memcpy(shape, shape - us->w, us->w);
+	}
+      } else {
+	upscaleRowNearest(us, ySrc, color, shape);
+      }
+      prevYSrc = ySrc;
+    }
+  }
+}
+
+// Resample device rows <yA> .. <yB> - 1 into colorBuf/shapeBuf.
+static void upscaleBlock(SplashUpscale *us, GThreadPool *pool,
+			 int yA, int yB) {
+  int nTasks;
+
+  us->yA = yA;
+  us->yB = yB;
+  nTasks = us->nTasks;
+  if (nTasks > yB - yA) {
+    nTasks = yB - yA;
+  }
+  us->rowsPerTask = (yB - yA + nTasks - 1) / nTasks;
+  nTasks = (yB - yA + us->rowsPerTask - 1) / us->rowsPerTask;
+  if (nTasks > 1) {
+    pool->run(&upscaleTask, us, nTasks);
+  } else {
+    upscaleTask(us, 0);
+  }
+}
+
+// The glyphMode flag is not currently used, but may be useful if the
+// stroke adjustment behavior is changed.
+SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
+				  int w, int h, SplashCoord *mat,
+				  GBool glyphMode, GBool interpolate) {
+  SplashBitmap *scaledMask;
+  SplashClipResult clipRes;
+  GBool minorAxisZero;
+  SplashCoord wSize, hSize, t0, t1;
+  int x0, y0, x1, y1, scaledWidth, scaledHeight;
+
+  if (debugMode) {
+    printf("fillImageMask: w=%d h=%d mat=[%.2f %.2f %.2f %.2f %.2f %.2f]\n",
+	   w, h, (double)mat[0], (double)mat[1], (double)mat[2],
+	   (double)mat[3], (double)mat[4], (double)mat[5]);
+  }
+
+  // check for singular matrix
+  if (!splashCheckDet(mat[0], mat[1], mat[2], mat[3], 0.000001)) {
+    return splashErrSingularMatrix;
+  }
+
+  minorAxisZero = splashAbs(mat[1]) <= 0.0001 && splashAbs(mat[2]) <= 0.0001;
+
+  // rough estimate of size of scaled mask
+  t0 = splashAbs(mat[0]);
+  t1 = splashAbs(mat[1]);
+  wSize = t0 > t1 ? t0 : t1;
+  t0 = splashAbs(mat[2]);
+  t1 = splashAbs(mat[3]);
+  hSize = t0 > t1 ? t0 : t1;
+
+  // stream-mode upscaling -- this is slower, so we only use it if the
+  // upscaled mask is large (in which case clipping should remove many
+  // pixels)
+  if (wSize > 2 * w && hSize > 2 * h && wSize * hSize > 1000000) {
+    upscaleMask(src, srcData, w, h, mat, glyphMode, interpolate);
+
+  // scaling only
+  } else if (mat[0] > 0 && minorAxisZero && mat[3] > 0) {
+    getImageBounds(mat[4], mat[0] + mat[4], &x0, &x1);
+    getImageBounds(mat[5], mat[3] + mat[5], &y0, &y1);
+    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
+				    state->strokeAdjust);
+    opClipRes = clipRes;
+    if (clipRes != splashClipAllOutside) {
+      scaledWidth = x1 - x0;
+      scaledHeight = y1 - y0;
+      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
+			     interpolate);
+      blitMask(scaledMask, x0, y0, clipRes);
+      delete scaledMask;
+    }
+    
+  // scaling plus vertical flip
+  } else if (mat[0] > 0 && minorAxisZero && mat[3] < 0) {
+    getImageBounds(mat[4], mat[0] + mat[4], &x0, &x1);
+    getImageBounds(mat[3] + mat[5], mat[5], &y0, &y1);
+    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
+				    state->strokeAdjust);
+    opClipRes = clipRes;
+    if (clipRes != splashClipAllOutside) {
+      scaledWidth = x1 - x0;
+      scaledHeight = y1 - y0;
+      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
+			     interpolate);
+      vertFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
+      blitMask(scaledMask, x0, y0, clipRes);
+      delete scaledMask;
+    }
+
+  // scaling plus horizontal flip
+  } else if (mat[0] < 0 && minorAxisZero && mat[3] > 0) {
+    getImageBounds(mat[0] + mat[4], mat[4], &x0, &x1);
+    getImageBounds(mat[5], mat[3] + mat[5], &y0, &y1);
+    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
+				    state->strokeAdjust);
+    opClipRes = clipRes;
+    if (clipRes != splashClipAllOutside) {
+      scaledWidth = x1 - x0;
+      scaledHeight = y1 - y0;
+      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
+			     interpolate);
+      horizFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
+      blitMask(scaledMask, x0, y0, clipRes);
+      delete scaledMask;
+    }
+
+  // scaling plus horizontal and vertical flips
+  } else if (mat[0] < 0 && minorAxisZero && mat[3] < 0) {
+    getImageBounds(mat[0] + mat[4], mat[4], &x0, &x1);
+    getImageBounds(mat[3] + mat[5], mat[5], &y0, &y1);
+    clipRes = state->clip->testRect(x0, y0, x1 - 1, y1 - 1,
+				    state->strokeAdjust);
+    opClipRes = clipRes;
+    if (clipRes != splashClipAllOutside) {
+      scaledWidth = x1 - x0;
+      scaledHeight = y1 - y0;
+      scaledMask = scaleMask(src, srcData, w, h, scaledWidth, scaledHeight,
+			     interpolate);
+      vertFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
+      horizFlipImage(scaledMask, scaledWidth, scaledHeight, 1);
+      blitMask(scaledMask, x0, y0, clipRes);
+      delete scaledMask;
+    }
+
+  // all other cases
+  } else {
+    arbitraryTransformMask(src, srcData, w, h, mat, glyphMode, interpolate);
+  }
+
+  return splashOk;
 }
 
 // The glyphMode flag is not currently used, but may be useful if the
@@ -3341,11 +4398,11 @@ void Splash::upscaleMask(SplashImageMaskSource src, void *srcData,
 			 GBool interpolate) {
   SplashClipResult clipRes;
   SplashPipe pipe;
+  SplashUpscale us;
   Guchar *unscaledImage, *p;
   SplashCoord xMin, yMin, xMax, yMax, t;
   SplashCoord mi0, mi1, mi2, mi3, mi4, mi5, det;
-  SplashCoord ix, iy, sx, sy, pix0, pix1;
-  int xMinI, yMinI, xMaxI, yMaxI, x, y, x0, y0, x1, y1, tt;
+  int xMinI, yMinI, xMaxI, yMaxI, x, y, yA, yB, tt;
 
   // compute the bbox of the target quadrilateral
   xMin = xMax = mat[4];
@@ -3410,6 +4467,9 @@ void Splash::upscaleMask(SplashImageMaskSource src, void *srcData,
       yMaxI = tt;
     }
   }
+  if (xMinI >= xMaxI || yMinI >= yMaxI) {
+    return;
+  }
 
   // invert the matrix
   det = mat[0] * mat[3] - mat[1] * mat[2];
@@ -3438,60 +4498,38 @@ void Splash::upscaleMask(SplashImageMaskSource src, void *srcData,
   pipeInit(&pipe, state->fillPattern,
 	   (Guchar)splashRound(state->fillAlpha * 255),
 	   gTrue, gFalse);
-  for (y = yMinI; y < yMaxI; ++y) {
-    for (x = xMinI; x < xMaxI; ++x) {
-      ix = ((SplashCoord)x + 0.5) * mi0 + ((SplashCoord)y + 0.5) * mi2 + mi4;
-      iy = ((SplashCoord)x + 0.5) * mi1 + ((SplashCoord)y + 0.5) * mi3 + mi5;
-      if (interpolate) {
-	if (ix >= 0 && ix < srcWidth && iy >= 0 && iy < srcHeight) {
-	  x0 = splashFloor(ix - 0.5);
-	  x1 = x0 + 1;
-	  sx = (ix - 0.5) - x0;
-	  y0 = splashFloor(iy - 0.5);
-	  y1 = y0 + 1;
-	  sy = (iy - 0.5) - y0;
-	  if (x0 < 0) {
-	    x0 = 0;
-	  }
-	  if (x1 >= srcWidth) {
-	    x1 = srcWidth - 1;
-	  }
-	  if (y0 < 0) {
-	    y0 = 0;
-	  }
-	  if (y1 >= srcHeight) {
-	    y1 = srcHeight - 1;
-	  }
-	  pix0 = ((SplashCoord)1 - sx) * unscaledImage[y0 * srcWidth + x0]
-	         + sx * unscaledImage[y0 * srcWidth + x1];
-	  pix1 = ((SplashCoord)1 - sx) * unscaledImage[y1 * srcWidth + x0]
-	         + sx * unscaledImage[y1 * srcWidth + x1];
-	  scanBuf[x] = (Guchar)splashRound(((SplashCoord)1 - sy) * pix0
-					   + sy * pix1);
-	} else {
-	  scanBuf[x] = 0;
-	}
-      } else {
-	x0 = splashFloor(ix);
-	y0 = splashFloor(iy);
-	if (x0 >= 0 && x0 < srcWidth && y0 >= 0 && y0 < srcHeight) {
-	  scanBuf[x] = unscaledImage[y0 * srcWidth + x0];
+  us.img = unscaledImage;
+  us.alpha = NULL;
+  us.srcWidth = srcWidth;
+  us.srcHeight = srcHeight;
+  us.nComps = 1;
+  us.interpolate = interpolate;
+  us.needShape = gFalse;
+  us.mi0 = mi0;  us.mi1 = mi1;  us.mi2 = mi2;
+  us.mi3 = mi3;  us.mi4 = mi4;  us.mi5 = mi5;
+  us.xMin = xMinI;
+  us.w = xMaxI - xMinI;
+  us.nTasks = threadPool ? threadPool->getNumThreads() : 1;
+  upscaleInit(&us);
+  for (yA = yMinI; yA < yMaxI; yA += splashUpscaleBlockRows) {
+    yB = yA + splashUpscaleBlockRows < yMaxI ? yA + splashUpscaleBlockRows
+                                             : yMaxI;
+    upscaleBlock(&us, threadPool, yA, yB);
+    for (y = yA; y < yB; ++y) {
+      memcpy(scanBuf + xMinI, us.colorBuf + (y - yA) * us.w, us.w);
+      if (clipRes != splashClipAllInside) {
+	if (vectorAntialias) {
+	  state->clip->clipSpan(scanBuf, y, xMinI, xMaxI - 1,
+				state->strokeAdjust);
 	} else {
-	  scanBuf[x] = 0;
+	  state->clip->clipSpanBinary(scanBuf, y, xMinI, xMaxI - 1,
+				      state->strokeAdjust);
 	}
       }
+      (this->*pipe.run)(&pipe, xMinI, xMaxI - 1, y, scanBuf + xMinI, NULL);
     }
-    if (clipRes != splashClipAllInside) {
-      if (vectorAntialias) {
-	state->clip->clipSpan(scanBuf, y, xMinI, xMaxI - 1,
-			      state->strokeAdjust);
-      } else {
-	state->clip->clipSpanBinary(scanBuf, y, xMinI, xMaxI - 1,
-				    state->strokeAdjust);
-      }
-    }
-    (this->*pipe.run)(&pipe, xMinI, xMaxI - 1, y, scanBuf + xMinI, NULL);
   }
+  upscaleFree(&us);
 
   gfree(unscaledImage);
 }
@@ -3808,10 +4846,9 @@ void Splash::scaleMaskYdXd(SplashImageMaskSource src, void *srcData,
 			   SplashBitmap *dest) {
   Guchar *lineBuf;
   Guint *pixBuf;
-  Guint pix;
   Guchar *destPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, xx, d, d0, d1;
-  int i, j;
+  int yp, yq, xp, xq, yt, y, yStep, d0, d1;
+  int i;
 
   // Bresenham parameters for y scale
   yp = srcHeight / scaledHeight;
@@ -3843,40 +4880,14 @@ void Splash::scaleMaskYdXd(SplashImageMaskSource src, void *srcData,
     memset(pixBuf, 0, srcWidth * sizeof(int));
     for (i = 0; i < yStep; ++i) {
       (*src)(srcData, lineBuf);
-      for (j = 0; j < srcWidth; ++j) {
-	pixBuf[j] += lineBuf[j];
-      }
+      boxFilterAccum(pixBuf, lineBuf, srcWidth);
     }
 
-    // init x scale Bresenham
-    xt = 0;
+    // compute the final pixels: (255 * pix) / xStep * yStep
     d0 = (255 << 23) / (yStep * xp);
     d1 = (255 << 23) / (yStep * (xp + 1));
-
-    xx = 0;
-    for (x = 0; x < scaledWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= scaledWidth) {
-	xt -= scaledWidth;
-	xStep = xp + 1;
-	d = d1;
-      } else {
-	xStep = xp;
-	d = d0;
-      }
-
-      // compute the final pixel
-      pix = 0;
-      for (i = 0; i < xStep; ++i) {
-	pix += pixBuf[xx++];
-      }
-      // (255 * pix) / xStep * yStep
-      pix = (pix * d) >> 23;
-
-      // store the pixel
-      *destPtr++ = (Guchar)pix;
-    }
+    boxFilterRowXd(pixBuf, 1, scaledWidth, xp, xq, d0, d1, destPtr);
+    destPtr += scaledWidth;
   }
 
   gfree(pixBuf);
@@ -3889,10 +4900,9 @@ void Splash::scaleMaskYdXu(SplashImageMaskSource src, void *srcData,
 			   SplashBitmap *dest) {
   Guchar *lineBuf;
   Guint *pixBuf;
-  Guint pix;
   Guchar *destPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, d;
-  int i, j;
+  int yp, yq, xp, xq, yt, y, yStep, d;
+  int i;
 
   // Bresenham parameters for y scale
   yp = srcHeight / scaledHeight;
@@ -3924,35 +4934,16 @@ void Splash::scaleMaskYdXu(SplashImageMaskSource src, void *srcData,
     memset(pixBuf, 0, srcWidth * sizeof(int));
     for (i = 0; i < yStep; ++i) {
       (*src)(srcData, lineBuf);
-      for (j = 0; j < srcWidth; ++j) {
-	pixBuf[j] += lineBuf[j];
-      }
+      boxFilterAccum(pixBuf, lineBuf, srcWidth);
     }
 
-    // init x scale Bresenham
-    xt = 0;
+    // compute the final pixels: (255 * pix) / yStep
     d = (255 << 23) / yStep;
+    boxFilterDiv(pixBuf, d, lineBuf, srcWidth);
 
-    for (x = 0; x < srcWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= srcWidth) {
-	xt -= srcWidth;
-	xStep = xp + 1;
-      } else {
-	xStep = xp;
-      }
-
-      // compute the final pixel
-      pix = pixBuf[x];
-      // (255 * pix) / yStep
-      pix = (pix * d) >> 23;
-
-      // store the pixel
-      for (i = 0; i < xStep; ++i) {
-	*destPtr++ = (Guchar)pix;
-      }
-    }
+    // store the pixels
+    replicateRowXu(lineBuf, 1, srcWidth, xp, xq, destPtr);
+    destPtr += scaledWidth;
   }
 
   gfree(pixBuf);
@@ -3964,9 +4955,9 @@ void Splash::scaleMaskYuXd(SplashImageMaskSource src, void *srcData,
 			   int scaledWidth, int scaledHeight,
 			   SplashBitmap *dest) {
   Guchar *lineBuf;
-  Guint pix;
-  Guchar *destPtr0, *destPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, xx, d, d0, d1;
+  Guint *pixBuf;
+  Guchar *destPtr;
+  int yp, yq, xp, xq, yt, y, yStep, d0, d1;
   int i;
 
   // Bresenham parameters for y scale
@@ -3979,11 +4970,16 @@ void Splash::scaleMaskYuXd(SplashImageMaskSource src, void *srcData,
 
   // allocate buffers
   lineBuf = (Guchar *)gmalloc(srcWidth);
+  pixBuf = (Guint *)gmallocn(srcWidth, sizeof(int));
 
   // init y scale Bresenham
   yt = 0;
 
-  destPtr0 = dest->data;
+  // x scale divisors: (255 * pix) / xStep
+  d0 = (255 << 23) / xp;
+  d1 = (255 << 23) / (xp + 1);
+
+  destPtr = dest->data;
   for (y = 0; y < srcHeight; ++y) {
 
     // y scale Bresenham
@@ -3996,43 +4992,18 @@ void Splash::scaleMaskYuXd(SplashImageMaskSource src, void *srcData,
 
     // read row from image
     (*src)(srcData, lineBuf);
+    memset(pixBuf, 0, srcWidth * sizeof(int));
+    boxFilterAccum(pixBuf, lineBuf, srcWidth);
 
-    // init x scale Bresenham
-    xt = 0;
-    d0 = (255 << 23) / xp;
-    d1 = (255 << 23) / (xp + 1);
-
-    xx = 0;
-    for (x = 0; x < scaledWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= scaledWidth) {
-	xt -= scaledWidth;
-	xStep = xp + 1;
-	d = d1;
-      } else {
-	xStep = xp;
-	d = d0;
-      }
-
-      // compute the final pixel
-      pix = 0;
-      for (i = 0; i < xStep; ++i) {
-	pix += lineBuf[xx++];
-      }
-      // (255 * pix) / xStep
-      pix = (pix * d) >> 23;
-
-      // store the pixel
-      for (i = 0; i < yStep; ++i) {
-	destPtr = destPtr0 + i * scaledWidth + x;
-	*destPtr = (Guchar)pix;
-      }
+    // compute the final pixels, and store them in yStep rows
+    boxFilterRowXd(pixBuf, 1, scaledWidth, xp, xq, d0, d1, destPtr);
+    for (i = 1; i < yStep; ++i) {
+      memcpy(destPtr + i * scaledWidth, destPtr, scaledWidth);
     }
-
-    destPtr0 += yStep * scaledWidth;
+    destPtr += yStep * scaledWidth;
   }
 
+  gfree(pixBuf);
   gfree(lineBuf);
 }
 
@@ -4041,10 +5012,9 @@ void Splash::scaleMaskYuXu(SplashImageMaskSource src, void *srcData,
 			   int scaledWidth, int scaledHeight,
 			   SplashBitmap *dest) {
   Guchar *lineBuf;
-  Guint pix;
-  Guchar *destPtr0, *destPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, xx;
-  int i, j;
+  Guchar *destPtr;
+  int yp, yq, xp, xq, yt, y, yStep, x;
+  int i;
 
   // Bresenham parameters for y scale
   yp = scaledHeight / srcHeight;
@@ -4060,7 +5030,7 @@ void Splash::scaleMaskYuXu(SplashImageMaskSource src, void *srcData,
   // init y scale Bresenham
   yt = 0;
 
-  destPtr0 = dest->data;
+  destPtr = dest->data;
   for (y = 0; y < srcHeight; ++y) {
 
     // y scale Bresenham
@@ -4073,36 +5043,16 @@ void Splash::scaleMaskYuXu(SplashImageMaskSource src, void *srcData,
 
     // read row from image
     (*src)(srcData, lineBuf);
-
-    // init x scale Bresenham
-    xt = 0;
-
-    xx = 0;
     for (x = 0; x < srcWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= srcWidth) {
-	xt -= srcWidth;
-	xStep = xp + 1;
-      } else {
-	xStep = xp;
-      }
-
-      // compute the final pixel
-      pix = lineBuf[x] ? 255 : 0;
-
-      // store the pixel
-      for (i = 0; i < yStep; ++i) {
-	for (j = 0; j < xStep; ++j) {
-	  destPtr = destPtr0 + i * scaledWidth + xx + j;
-	  *destPtr++ = (Guchar)pix;
-	}
-      }
-
-      xx += xStep;
+      lineBuf[x] = lineBuf[x] ? 255 : 0;
     }
 
-    destPtr0 += yStep * scaledWidth;
+    // store the pixels in yStep rows
+    replicateRowXu(lineBuf, 1, srcWidth, xp, xq, destPtr);
+    for (i = 1; i < yStep; ++i) {
+      memcpy(destPtr + i * scaledWidth, destPtr, scaledWidth);
+    }
+    destPtr += yStep * scaledWidth;
   }
 
   gfree(lineBuf);
@@ -4112,50 +5062,47 @@ void Splash::scaleMaskYuXuI(SplashImageMaskSource src, void *srcData,
 			    int srcWidth, int srcHeight,
 			    int scaledWidth, int scaledHeight,
 			    SplashBitmap *dest) {
-  Guchar *lineBuf0, *lineBuf1, *tBuf;
-  Guchar pix;
-  SplashCoord yr, xr, ys, xs, ySrc, xSrc;
-  int ySrc0, ySrc1, yBuf, xSrc0, xSrc1, y, x;
+  Guchar *srcBuf, *lineBuf0, *lineBuf1, *tBuf;
+  int *xSrc0, *xSrc1;
+  SplashCoord *xs;
+  SplashCoord yr, ys, ySrc;
+  int ySrc0, ySrc1, yBuf, y, x;
   Guchar *destPtr;
 
   // ratios
   yr = (SplashCoord)srcHeight / (SplashCoord)scaledHeight;
-  xr = (SplashCoord)srcWidth / (SplashCoord)scaledWidth;
 
   // allocate buffers
+  srcBuf = (Guchar *)gmalloc(srcWidth);
   lineBuf0 = (Guchar *)gmalloc(scaledWidth);
   lineBuf1 = (Guchar *)gmalloc(scaledWidth);
+  xSrc0 = (int *)gmallocn(scaledWidth, sizeof(int));
+  xSrc1 = (int *)gmallocn(scaledWidth, sizeof(int));
+  xs = (SplashCoord *)gmallocn(scaledWidth, sizeof(SplashCoord));
 
-  // read first two rows
-  (*src)(srcData, lineBuf0);
+  // compute the horizontal interpolation parameters
+  interpColumns(srcWidth, scaledWidth, xSrc0, xSrc1, xs);
+
+  // read and interpolate first two rows
+  (*src)(srcData, srcBuf);
+  for (x = 0; x < scaledWidth; ++x) {
+    lineBuf0[x] = (Guchar)(int)
+                  ((xs[x] * srcBuf[xSrc0[x]] +
+		    ((SplashCoord)1 - xs[x]) * srcBuf[xSrc1[x]]) * 255);
+  }
   if (srcHeight > 1) {
-    (*src)(srcData, lineBuf1);
+    (*src)(srcData, srcBuf);
+    for (x = 0; x < scaledWidth; ++x) {
+      lineBuf1[x] = (Guchar)(int)
+	            ((xs[x] * srcBuf[xSrc0[x]] +
+		      ((SplashCoord)1 - xs[x]) * srcBuf[xSrc1[x]]) * 255);
+    }
     yBuf = 1;
   } else {
-    memcpy(lineBuf1, lineBuf0, srcWidth);
+    memcpy(lineBuf1, lineBuf0, scaledWidth);
     yBuf = 0;
   }
 
-  // interpolate first two rows
-  for (x = scaledWidth - 1; x >= 0; --x) {
-    xSrc = xr * x;
-    xSrc0 = splashFloor(xSrc + xr * 0.5 - 0.5);
-    xSrc1 = xSrc0 + 1;
-    xs = ((SplashCoord)xSrc1 + 0.5) - (xSrc + xr * 0.5);
-    if (xSrc0 < 0) {
-      xSrc0 = 0;
-    }
-    if (xSrc1 >= srcWidth) {
-      xSrc1 = srcWidth - 1;
-    }
-    lineBuf0[x] = (Guchar)(int)
-                  ((xs * lineBuf0[xSrc0] +
-		    ((SplashCoord)1 - xs) * lineBuf0[xSrc1]) * 255);
-    lineBuf1[x] = (Guchar)(int)
-                  ((xs * lineBuf1[xSrc0] +
-		    ((SplashCoord)1 - xs) * lineBuf1[xSrc1]) * 255);
-  }
-
   destPtr = dest->data;
   for (y = 0; y < scaledHeight; ++y) {
 
@@ -4173,46 +5120,31 @@ void Splash::scaleMaskYuXuI(SplashImageMaskSource src, void *srcData,
       ys = 0;
     }
 
-    // read another row (if necessary)
+    // read and interpolate another row (if necessary)
     if (ySrc1 > yBuf) {
       tBuf = lineBuf0;
       lineBuf0 = lineBuf1;
       lineBuf1 = tBuf;
-      (*src)(srcData, lineBuf1);
-
-      // interpolate the row
-      for (x = scaledWidth - 1; x >= 0; --x) {
-	xSrc = xr * x;
-	xSrc0 = splashFloor(xSrc + xr * 0.5 - 0.5);
-	xSrc1 = xSrc0 + 1;
-	xs = ((SplashCoord)xSrc1 + 0.5) - (xSrc + xr * 0.5);
-	if (xSrc0 < 0) {
-	  xSrc0 = 0;
-	}
-	if (xSrc1 >= srcWidth) {
-	  xSrc1 = srcWidth - 1;
-	}
+      (*src)(srcData, srcBuf);
+      for (x = 0; x < scaledWidth; ++x) {
 	lineBuf1[x] = (Guchar)(int)
-	              ((xs * lineBuf1[xSrc0] +
-			((SplashCoord)1 - xs) * lineBuf1[xSrc1]) * 255);
+	              ((xs[x] * srcBuf[xSrc0[x]] +
+			((SplashCoord)1 - xs[x]) * srcBuf[xSrc1[x]]) * 255);
       }
-
       ++yBuf;
     }
 
     // do the vertical interpolation
-    for (x = 0; x < scaledWidth; ++x) {
-
-      pix = (Guchar)(int)(ys * lineBuf0[x] +
-			  ((SplashCoord)1 - ys) * lineBuf1[x]);
-
-      // store the pixel
-      *destPtr++ = pix;
-    }
+    interpRows(lineBuf0, lineBuf1, ys, destPtr, scaledWidth);
+    destPtr += scaledWidth;
   }
 
+  gfree(xs);
+  gfree(xSrc1);
+  gfree(xSrc0);
   gfree(lineBuf1);
   gfree(lineBuf0);
+  gfree(srcBuf);
 }
 
 void Splash::blitMask(SplashBitmap *src, int xDest, int yDest,
@@ -4416,12 +5348,12 @@ void Splash::upscaleImage(SplashImageSource src, void *srcData,
 			  SplashCoord *mat, GBool interpolate) {
   SplashClipResult clipRes;
   SplashPipe pipe;
-  SplashColorPtr unscaledImage, pixelBuf, p, q, q00, q01, q10, q11;
+  SplashUpscale us;
+  SplashColorPtr unscaledImage, p;
   Guchar *unscaledAlpha, *alphaPtr;
   SplashCoord xMin, yMin, xMax, yMax, t;
   SplashCoord mi0, mi1, mi2, mi3, mi4, mi5, det;
-  SplashCoord ix, iy, sx, sy, pix0, pix1;
-  int rowSize, xMinI, yMinI, xMaxI, yMaxI, x, y, x0, y0, x1, y1, tt, i;
+  int rowSize, xMinI, yMinI, xMaxI, yMaxI, y, yA, yB, tt;
 
   // compute the bbox of the target quadrilateral
   xMin = xMax = mat[4];
@@ -4486,6 +5418,9 @@ void Splash::upscaleImage(SplashImageSource src, void *srcData,
       yMaxI = tt;
     }
   }
+  if (xMinI >= xMaxI || yMinI >= yMaxI) {
+    return;
+  }
 
   // invert the matrix
   det = mat[0] * mat[3] - mat[1] * mat[2];
@@ -4523,95 +5458,43 @@ void Splash::upscaleImage(SplashImageSource src, void *srcData,
   }
 
   // draw it
-  pixelBuf = (SplashColorPtr)gmallocn(xMaxI - xMinI, nComps);
-  pipeInit(&pipe, NULL,
-	   (Guchar)splashRound(state->fillAlpha * 255),
-	   gTrue, gFalse);
-  for (y = yMinI; y < yMaxI; ++y) {
-    p = pixelBuf;
-    for (x = xMinI; x < xMaxI; ++x) {
-      ix = ((SplashCoord)x + 0.5) * mi0 + ((SplashCoord)y + 0.5) * mi2 + mi4;
-      iy = ((SplashCoord)x + 0.5) * mi1 + ((SplashCoord)y + 0.5) * mi3 + mi5;
-      if (interpolate) {
-	if (ix >= 0 && ix < srcWidth && iy >= 0 && iy < srcHeight) {
-	  x0 = splashFloor(ix - 0.5);
-	  x1 = x0 + 1;
-	  sx = (ix - 0.5) - x0;
-	  y0 = splashFloor(iy - 0.5);
-	  y1 = y0 + 1;
-	  sy = (iy - 0.5) - y0;
-	  if (x0 < 0) {
-	    x0 = 0;
-	  }
-	  if (x1 >= srcWidth) {
-	    x1 = srcWidth - 1;
-	  }
-	  if (y0 < 0) {
-	    y0 = 0;
-	  }
-	  if (y1 >= srcHeight) {
-	    y1 = srcHeight - 1;
-	  }
-	  q00 = &unscaledImage[(y0 * srcWidth + x0) * nComps];
-	  q01 = &unscaledImage[(y0 * srcWidth + x1) * nComps];
-	  q10 = &unscaledImage[(y1 * srcWidth + x0) * nComps];
-	  q11 = &unscaledImage[(y1 * srcWidth + x1) * nComps];
-	  for (i = 0; i < nComps; ++i) {
-	    pix0 = ((SplashCoord)1 - sx) * *q00++ + sx * *q01++;
-	    pix1 = ((SplashCoord)1 - sx) * *q10++ + sx * *q11++;
-	    *p++ = (Guchar)splashRound(((SplashCoord)1 - sy) * pix0
-				       + sy * pix1);
-	  }
-	  if (srcAlpha) {
-	    pix0 = ((SplashCoord)1 - sx) * unscaledAlpha[y0 * srcWidth + x0]
-	           + sx * unscaledAlpha[y0 * srcWidth + x1];
-	    pix1 = ((SplashCoord)1 - sx) * unscaledAlpha[y1 * srcWidth + x0]
-	           + sx * unscaledAlpha[y1 * srcWidth + x1];
-	    scanBuf[x] = (Guchar)splashRound(((SplashCoord)1 - sy) * pix0
-					     + sy * pix1);
-	  } else {
-	    scanBuf[x] = 0xff;
-	  }
-	} else {
-	  for (i = 0; i < nComps; ++i) {
-	    *p++ = 0;
-	  }
-	  scanBuf[x] = 0;
-	}
-      } else {
-	x0 = splashFloor(ix);
-	y0 = splashFloor(iy);
-	if (x0 >= 0 && x0 < srcWidth && y0 >= 0 && y0 < srcHeight) {
-	  q = &unscaledImage[(y0 * srcWidth + x0) * nComps];
-	  for (i = 0; i < nComps; ++i) {
-	    *p++ = *q++;
-	  }
-	  if (srcAlpha) {
-	    scanBuf[x] = unscaledAlpha[y0 * srcWidth + x0];
-	  } else {
-	    scanBuf[x] = 0xff;
-	  }
+  pipeInit(&pipe, NULL,
+	   (Guchar)splashRound(state->fillAlpha * 255),
+	   gTrue, gFalse);
+  us.img = unscaledImage;
+  us.alpha = unscaledAlpha;
+  us.srcWidth = srcWidth;
+  us.srcHeight = srcHeight;
+  us.nComps = nComps;
+  us.interpolate = interpolate;
+  us.needShape = gTrue;
+  us.mi0 = mi0;  us.mi1 = mi1;  us.mi2 = mi2;
+  us.mi3 = mi3;  us.mi4 = mi4;  us.mi5 = mi5;
+  us.xMin = xMinI;
+  us.w = xMaxI - xMinI;
+  us.nTasks = threadPool ? threadPool->getNumThreads() : 1;
+  upscaleInit(&us);
+  for (yA = yMinI; yA < yMaxI; yA += splashUpscaleBlockRows) {
+    yB = yA + splashUpscaleBlockRows < yMaxI ? yA + splashUpscaleBlockRows
+                                             : yMaxI;
+    upscaleBlock(&us, threadPool, yA, yB);
+    for (y = yA; y < yB; ++y) {
+      memcpy(scanBuf + xMinI, us.shapeBuf + (y - yA) * us.w, us.w);
+      if (clipRes != splashClipAllInside) {
+	if (vectorAntialias) {
+	  state->clip->clipSpan(scanBuf, y, xMinI, xMaxI - 1,
+				state->strokeAdjust);
 	} else {
-	  for (i = 0; i < nComps; ++i) {
-	    *p++ = 0;
-	  }
-	  scanBuf[x] = 0;
+	  state->clip->clipSpanBinary(scanBuf, y, xMinI, xMaxI - 1,
+				      state->strokeAdjust);
 	}
       }
+      (this->*pipe.run)(&pipe, xMinI, xMaxI - 1, y, scanBuf + xMinI,
+			us.colorBuf + (y - yA) * us.w * nComps);
     }
-    if (clipRes != splashClipAllInside) {
-      if (vectorAntialias) {
-	state->clip->clipSpan(scanBuf, y, xMinI, xMaxI - 1,
-			      state->strokeAdjust);
-      } else {
-	state->clip->clipSpanBinary(scanBuf, y, xMinI, xMaxI - 1,
-				    state->strokeAdjust);
-      }
-    }
-    (this->*pipe.run)(&pipe, xMinI, xMaxI - 1, y, scanBuf + xMinI, pixelBuf);
   }
+  upscaleFree(&us);
 
-  gfree(pixelBuf);
   gfree(unscaledImage);
   gfree(unscaledAlpha);
 }
@@ -4940,14 +5823,9 @@ void Splash::scaleImageYdXd(SplashImageSource src, void *srcData,
 			    SplashBitmap *dest) {
   Guchar *lineBuf, *alphaLineBuf;
   Guint *pixBuf, *alphaPixBuf;
-  Guint pix0, pix1, pix2;
-#if SPLASH_CMYK
-  Guint pix3;
-#endif
-  Guint alpha;
   Guchar *destPtr, *destAlphaPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, xx, xxa, d, d0, d1;
-  int i, j;
+  int yp, yq, xp, xq, yt, y, yStep, d0, d1;
+  int i;
 
   // Bresenham parameters for y scale
   yp = srcHeight / scaledHeight;
@@ -4990,114 +5868,23 @@ void Splash::scaleImageYdXd(SplashImageSource src, void *srcData,
     }
     for (i = 0; i < yStep; ++i) {
       (*src)(srcData, lineBuf, alphaLineBuf);
-      for (j = 0; j < srcWidth * nComps; ++j) {
-	pixBuf[j] += lineBuf[j];
-      }
+      boxFilterAccum(pixBuf, lineBuf, srcWidth * nComps);
       if (srcAlpha) {
-	for (j = 0; j < srcWidth; ++j) {
-	  alphaPixBuf[j] += alphaLineBuf[j];
-	}
+	boxFilterAccum(alphaPixBuf, alphaLineBuf, srcWidth);
       }
     }
 
-    // init x scale Bresenham
-    xt = 0;
+    // compute the final pixels: pix / xStep * yStep
     d0 = (1 << 23) / (yStep * xp);
     d1 = (1 << 23) / (yStep * (xp + 1));
+    boxFilterRowXd(pixBuf, nComps, scaledWidth, xp, xq, d0, d1, destPtr);
+    destPtr += scaledWidth * nComps;
 
-    xx = xxa = 0;
-    for (x = 0; x < scaledWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= scaledWidth) {
-	xt -= scaledWidth;
-	xStep = xp + 1;
-	d = d1;
-      } else {
-	xStep = xp;
-	d = d0;
-      }
-
-      switch (srcMode) {
-
-      case splashModeMono8:
-
-	// compute the final pixel
-	pix0 = 0;
-	for (i = 0; i < xStep; ++i) {
-	  pix0 += pixBuf[xx++];
-	}
-	// pix / xStep * yStep
-	pix0 = (pix0 * d) >> 23;
-
-	// store the pixel
-	*destPtr++ = (Guchar)pix0;
-	break;
-
-      case splashModeRGB8:
-
-	// compute the final pixel
-	pix0 = pix1 = pix2 = 0;
-	for (i = 0; i < xStep; ++i) {
-	  pix0 += pixBuf[xx];
-	  pix1 += pixBuf[xx+1];
-	  pix2 += pixBuf[xx+2];
-	  xx += 3;
-	}
-	// pix / xStep * yStep
-	pix0 = (pix0 * d) >> 23;
-	pix1 = (pix1 * d) >> 23;
-	pix2 = (pix2 * d) >> 23;
-
-	// store the pixel
-	*destPtr++ = (Guchar)pix0;
-	*destPtr++ = (Guchar)pix1;
-	*destPtr++ = (Guchar)pix2;
-	break;
-
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-
-	// compute the final pixel
-	pix0 = pix1 = pix2 = pix3 = 0;
-	for (i = 0; i < xStep; ++i) {
-	  pix0 += pixBuf[xx];
-	  pix1 += pixBuf[xx+1];
-	  pix2 += pixBuf[xx+2];
-	  pix3 += pixBuf[xx+3];
-	  xx += 4;
-	}
-	// pix / xStep * yStep
-	pix0 = (pix0 * d) >> 23;
-	pix1 = (pix1 * d) >> 23;
-	pix2 = (pix2 * d) >> 23;
-	pix3 = (pix3 * d) >> 23;
-
-	// store the pixel
-	*destPtr++ = (Guchar)pix0;
-	*destPtr++ = (Guchar)pix1;
-	*destPtr++ = (Guchar)pix2;
-	*destPtr++ = (Guchar)pix3;
-	break;
-#endif
-
-
-      case splashModeMono1: // mono1 is not allowed
-      case splashModeBGR8: // bgr8 is not allowed
-      default:
-	break;
-      }
-
-      // process alpha
-      if (srcAlpha) {
-	alpha = 0;
-	for (i = 0; i < xStep; ++i, ++xxa) {
-	  alpha += alphaPixBuf[xxa];
-	}
-	// alpha / xStep * yStep
-	alpha = (alpha * d) >> 23;
-	*destAlphaPtr++ = (Guchar)alpha;
-      }
+    // process alpha
+    if (srcAlpha) {
+      boxFilterRowXd(alphaPixBuf, 1, scaledWidth, xp, xq, d0, d1,
+		     destAlphaPtr);
+      destAlphaPtr += scaledWidth;
     }
   }
 
@@ -5114,11 +5901,9 @@ void Splash::scaleImageYdXu(SplashImageSource src, void *srcData,
 			    SplashBitmap *dest) {
   Guchar *lineBuf, *alphaLineBuf;
   Guint *pixBuf, *alphaPixBuf;
-  Guint pix[splashMaxColorComps];
-  Guint alpha;
   Guchar *destPtr, *destAlphaPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, d;
-  int i, j;
+  int yp, yq, xp, xq, yt, y, yStep, d;
+  int i;
 
   // Bresenham parameters for y scale
   yp = srcHeight / scaledHeight;
@@ -5161,74 +5946,25 @@ void Splash::scaleImageYdXu(SplashImageSource src, void *srcData,
     }
     for (i = 0; i < yStep; ++i) {
       (*src)(srcData, lineBuf, alphaLineBuf);
-      for (j = 0; j < srcWidth * nComps; ++j) {
-	pixBuf[j] += lineBuf[j];
-      }
+      boxFilterAccum(pixBuf, lineBuf, srcWidth * nComps);
       if (srcAlpha) {
-	for (j = 0; j < srcWidth; ++j) {
-	  alphaPixBuf[j] += alphaLineBuf[j];
-	}
+	boxFilterAccum(alphaPixBuf, alphaLineBuf, srcWidth);
       }
     }
 
-    // init x scale Bresenham
-    xt = 0;
+    // compute the final pixels: pixBuf[] / yStep
     d = (1 << 23) / yStep;
+    boxFilterDiv(pixBuf, d, lineBuf, srcWidth * nComps);
 
-    for (x = 0; x < srcWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= srcWidth) {
-	xt -= srcWidth;
-	xStep = xp + 1;
-      } else {
-	xStep = xp;
-      }
-
-      // compute the final pixel
-      for (i = 0; i < nComps; ++i) {
-	// pixBuf[] / yStep
-	pix[i] = (pixBuf[x * nComps + i] * d) >> 23;
-      }
-
-      // store the pixel
-      switch (srcMode) {
-      case splashModeMono8:
-	for (i = 0; i < xStep; ++i) {
-	  *destPtr++ = (Guchar)pix[0];
-	}
-	break;
-      case splashModeRGB8:
-	for (i = 0; i < xStep; ++i) {
-	  *destPtr++ = (Guchar)pix[0];
-	  *destPtr++ = (Guchar)pix[1];
-	  *destPtr++ = (Guchar)pix[2];
-	}
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	for (i = 0; i < xStep; ++i) {
-	  *destPtr++ = (Guchar)pix[0];
-	  *destPtr++ = (Guchar)pix[1];
-	  *destPtr++ = (Guchar)pix[2];
-	  *destPtr++ = (Guchar)pix[3];
-	}
-	break;
-#endif
-      case splashModeMono1: // mono1 is not allowed
-      case splashModeBGR8: // BGR8 is not allowed
-      default:
-	break;
-      }
+    // store the pixels
+    replicateRowXu(lineBuf, nComps, srcWidth, xp, xq, destPtr);
+    destPtr += scaledWidth * nComps;
 
-      // process alpha
-      if (srcAlpha) {
-	// alphaPixBuf[] / yStep
-	alpha = (alphaPixBuf[x] * d) >> 23;
-	for (i = 0; i < xStep; ++i) {
-	  *destAlphaPtr++ = (Guchar)alpha;
-	}
-      }
+    // process alpha
+    if (srcAlpha) {
+      boxFilterDiv(alphaPixBuf, d, alphaLineBuf, srcWidth);
+      replicateRowXu(alphaLineBuf, 1, srcWidth, xp, xq, destAlphaPtr);
+      destAlphaPtr += scaledWidth;
     }
   }
 
@@ -5244,11 +5980,10 @@ void Splash::scaleImageYuXd(SplashImageSource src, void *srcData,
 			    int scaledWidth, int scaledHeight,
 			    SplashBitmap *dest) {
   Guchar *lineBuf, *alphaLineBuf;
-  Guint pix[splashMaxColorComps];
-  Guint alpha;
-  Guchar *destPtr0, *destPtr, *destAlphaPtr0, *destAlphaPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, xx, xxa, d, d0, d1;
-  int i, j;
+  Guint *pixBuf, *alphaPixBuf;
+  Guchar *destPtr, *destAlphaPtr;
+  int yp, yq, xp, xq, yt, y, yStep, d0, d1;
+  int i;
 
   // Bresenham parameters for y scale
   yp = scaledHeight / srcHeight;
@@ -5260,17 +5995,24 @@ void Splash::scaleImageYuXd(SplashImageSource src, void *srcData,
 
   // allocate buffers
   lineBuf = (Guchar *)gmallocn(srcWidth, nComps);
+  pixBuf = (Guint *)gmallocn(srcWidth, nComps * sizeof(int));
   if (srcAlpha) {
     alphaLineBuf = (Guchar *)gmalloc(srcWidth);
+    alphaPixBuf = (Guint *)gmallocn(srcWidth, sizeof(int));
   } else {
     alphaLineBuf = NULL;
+    alphaPixBuf = NULL;
   }
 
   // init y scale Bresenham
   yt = 0;
 
-  destPtr0 = dest->data;
-  destAlphaPtr0 = dest->alpha;
+  // x scale divisors: pix / xStep
+  d0 = (1 << 23) / xp;
+  d1 = (1 << 23) / (xp + 1);
+
+  destPtr = dest->data;
+  destAlphaPtr = dest->alpha;
   for (y = 0; y < srcHeight; ++y) {
 
     // y scale Bresenham
@@ -5283,94 +6025,33 @@ void Splash::scaleImageYuXd(SplashImageSource src, void *srcData,
 
     // read row from image
     (*src)(srcData, lineBuf, alphaLineBuf);
+    memset(pixBuf, 0, srcWidth * nComps * sizeof(int));
+    boxFilterAccum(pixBuf, lineBuf, srcWidth * nComps);
 
-    // init x scale Bresenham
-    xt = 0;
-    d0 = (1 << 23) / xp;
-    d1 = (1 << 23) / (xp + 1);
-
-    xx = xxa = 0;
-    for (x = 0; x < scaledWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= scaledWidth) {
-	xt -= scaledWidth;
-	xStep = xp + 1;
-	d = d1;
-      } else {
-	xStep = xp;
-	d = d0;
-      }
-
-      // compute the final pixel
-      for (i = 0; i < nComps; ++i) {
-	pix[i] = 0;
-      }
-      for (i = 0; i < xStep; ++i) {
-	for (j = 0; j < nComps; ++j, ++xx) {
-	  pix[j] += lineBuf[xx];
-	}
-      }
-      for (i = 0; i < nComps; ++i) {
-	// pix[] / xStep
-	pix[i] = (pix[i] * d) >> 23;
-      }
-
-      // store the pixel
-      switch (srcMode) {
-      case splashModeMono8:
-	for (i = 0; i < yStep; ++i) {
-	  destPtr = destPtr0 + (i * scaledWidth + x) * nComps;
-	  *destPtr++ = (Guchar)pix[0];
-	}
-	break;
-      case splashModeRGB8:
-	for (i = 0; i < yStep; ++i) {
-	  destPtr = destPtr0 + (i * scaledWidth + x) * nComps;
-	  *destPtr++ = (Guchar)pix[0];
-	  *destPtr++ = (Guchar)pix[1];
-	  *destPtr++ = (Guchar)pix[2];
-	}
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	for (i = 0; i < yStep; ++i) {
-	  destPtr = destPtr0 + (i * scaledWidth + x) * nComps;
-	  *destPtr++ = (Guchar)pix[0];
-	  *destPtr++ = (Guchar)pix[1];
-	  *destPtr++ = (Guchar)pix[2];
-	  *destPtr++ = (Guchar)pix[3];
-	}
-	break;
-#endif
-      case splashModeMono1: // mono1 is not allowed
-      case splashModeBGR8: // BGR8 is not allowed
-      default:
-	break;
-      }
-
-      // process alpha
-      if (srcAlpha) {
-	alpha = 0;
-	for (i = 0; i < xStep; ++i, ++xxa) {
-	  alpha += alphaLineBuf[xxa];
-	}
-	// alpha / xStep
-	alpha = (alpha * d) >> 23;
-	for (i = 0; i < yStep; ++i) {
-	  destAlphaPtr = destAlphaPtr0 + i * scaledWidth + x;
-	  *destAlphaPtr = (Guchar)alpha;
-	}
-      }
+    // compute the final pixels, and store them in yStep rows
+    boxFilterRowXd(pixBuf, nComps, scaledWidth, xp, xq, d0, d1, destPtr);
+    for (i = 1; i < yStep; ++i) {
+      memcpy(destPtr + i * scaledWidth * nComps, destPtr,
+	     scaledWidth * nComps);
     }
+    destPtr += yStep * scaledWidth * nComps;
 
-    destPtr0 += yStep * scaledWidth * nComps;
+    // process alpha
     if (srcAlpha) {
-      destAlphaPtr0 += yStep * scaledWidth;
+      memset(alphaPixBuf, 0, srcWidth * sizeof(int));
+      boxFilterAccum(alphaPixBuf, alphaLineBuf, srcWidth);
+      boxFilterRowXd(alphaPixBuf, 1, scaledWidth, xp, xq, d0, d1,
+		     destAlphaPtr);
+      for (i = 1; i < yStep; ++i) {
+	memcpy(destAlphaPtr + i * scaledWidth, destAlphaPtr, scaledWidth);
+      }
+      destAlphaPtr += yStep * scaledWidth;
     }
   }
 
+  gfree(alphaPixBuf);
   gfree(alphaLineBuf);
+  gfree(pixBuf);
   gfree(lineBuf);
 }
 
@@ -5380,11 +6061,9 @@ void Splash::scaleImageYuXu(SplashImageSource src, void *srcData,
 			    int scaledWidth, int scaledHeight,
 			    SplashBitmap *dest) {
   Guchar *lineBuf, *alphaLineBuf;
-  Guint pix[splashMaxColorComps];
-  Guint alpha;
-  Guchar *destPtr0, *destPtr, *destAlphaPtr0, *destAlphaPtr;
-  int yp, yq, xp, xq, yt, y, yStep, xt, x, xStep, xx;
-  int i, j;
+  Guchar *destPtr, *destAlphaPtr;
+  int yp, yq, xp, xq, yt, y, yStep;
+  int i;
 
   // Bresenham parameters for y scale
   yp = scaledHeight / srcHeight;
@@ -5405,8 +6084,8 @@ void Splash::scaleImageYuXu(SplashImageSource src, void *srcData,
   // init y scale Bresenham
   yt = 0;
 
-  destPtr0 = dest->data;
-  destAlphaPtr0 = dest->alpha;
+  destPtr = dest->data;
+  destAlphaPtr = dest->alpha;
   for (y = 0; y < srcHeight; ++y) {
 
     // y scale Bresenham
@@ -5420,81 +6099,21 @@ void Splash::scaleImageYuXu(SplashImageSource src, void *srcData,
     // read row from image
     (*src)(srcData, lineBuf, alphaLineBuf);
 
-    // init x scale Bresenham
-    xt = 0;
-
-    xx = 0;
-    for (x = 0; x < srcWidth; ++x) {
-
-      // x scale Bresenham
-      if ((xt += xq) >= srcWidth) {
-	xt -= srcWidth;
-	xStep = xp + 1;
-      } else {
-	xStep = xp;
-      }
-
-      // compute the final pixel
-      for (i = 0; i < nComps; ++i) {
-	pix[i] = lineBuf[x * nComps + i];
-      }
-
-      // store the pixel
-      switch (srcMode) {
-      case splashModeMono8:
-	for (i = 0; i < yStep; ++i) {
-	  for (j = 0; j < xStep; ++j) {
-	    destPtr = destPtr0 + (i * scaledWidth + xx + j) * nComps;
-	    *destPtr++ = (Guchar)pix[0];
-	  }
-	}
-	break;
-      case splashModeRGB8:
-	for (i = 0; i < yStep; ++i) {
-	  for (j = 0; j < xStep; ++j) {
-	    destPtr = destPtr0 + (i * scaledWidth + xx + j) * nComps;
-	    *destPtr++ = (Guchar)pix[0];
-	    *destPtr++ = (Guchar)pix[1];
-	    *destPtr++ = (Guchar)pix[2];
-	  }
-	}
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	for (i = 0; i < yStep; ++i) {
-	  for (j = 0; j < xStep; ++j) {
-	    destPtr = destPtr0 + (i * scaledWidth + xx + j) * nComps;
-	    *destPtr++ = (Guchar)pix[0];
-	    *destPtr++ = (Guchar)pix[1];
-	    *destPtr++ = (Guchar)pix[2];
-	    *destPtr++ = (Guchar)pix[3];
-	  }
-	}
-	break;
-#endif
-      case splashModeMono1: // mono1 is not allowed
-      case splashModeBGR8: // BGR8 is not allowed
-      default:
-	break;
-      }
-
-      // process alpha
-      if (srcAlpha) {
-	alpha = alphaLineBuf[x];
-	for (i = 0; i < yStep; ++i) {
-	  for (j = 0; j < xStep; ++j) {
-	    destAlphaPtr = destAlphaPtr0 + i * scaledWidth + xx + j;
-	    *destAlphaPtr = (Guchar)alpha;
-	  }
-	}
-      }
-
-      xx += xStep;
+    // store the pixels in yStep rows
+    replicateRowXu(lineBuf, nComps, srcWidth, xp, xq, destPtr);
+    for (i = 1; i < yStep; ++i) {
+      memcpy(destPtr + i * scaledWidth * nComps, destPtr,
+	     scaledWidth * nComps);
     }
+    destPtr += yStep * scaledWidth * nComps;
 
-    destPtr0 += yStep * scaledWidth * nComps;
+    // process alpha
     if (srcAlpha) {
-      destAlphaPtr0 += yStep * scaledWidth;
+      replicateRowXu(alphaLineBuf, 1, srcWidth, xp, xq, destAlphaPtr);
+      for (i = 1; i < yStep; ++i) {
+	memcpy(destAlphaPtr + i * scaledWidth, destAlphaPtr, scaledWidth);
+      }
+      destAlphaPtr += yStep * scaledWidth;
     }
   }
 
@@ -5507,70 +6126,60 @@ void Splash::scaleImageYuXuI(SplashImageSource src, void *srcData,
 			     GBool srcAlpha, int srcWidth, int srcHeight,
 			     int scaledWidth, int scaledHeight,
 			     SplashBitmap *dest) {
+  Guchar *srcBuf, *srcAlphaBuf;
   Guchar *lineBuf0, *lineBuf1, *alphaLineBuf0, *alphaLineBuf1, *tBuf;
-  Guchar pix[splashMaxColorComps];
-  SplashCoord yr, xr, ys, xs, ySrc, xSrc;
-  int ySrc0, ySrc1, yBuf, xSrc0, xSrc1, y, x, i;
+  int *xSrc0, *xSrc1;
+  SplashCoord *xs;
+  SplashCoord yr, ys, ySrc;
+  int ySrc0, ySrc1, yBuf, y;
   Guchar *destPtr, *destAlphaPtr;
 
   // ratios
   yr = (SplashCoord)srcHeight / (SplashCoord)scaledHeight;
-  xr = (SplashCoord)srcWidth / (SplashCoord)scaledWidth;
 
   // allocate buffers
+  srcBuf = (Guchar *)gmallocn(srcWidth, nComps);
   lineBuf0 = (Guchar *)gmallocn(scaledWidth, nComps);
   lineBuf1 = (Guchar *)gmallocn(scaledWidth, nComps);
   if (srcAlpha) {
+    srcAlphaBuf = (Guchar *)gmalloc(srcWidth);
     alphaLineBuf0 = (Guchar *)gmalloc(scaledWidth);
     alphaLineBuf1 = (Guchar *)gmalloc(scaledWidth);
   } else {
+    srcAlphaBuf = NULL;
     alphaLineBuf0 = NULL;
     alphaLineBuf1 = NULL;
   }
+  xSrc0 = (int *)gmallocn(scaledWidth, sizeof(int));
+  xSrc1 = (int *)gmallocn(scaledWidth, sizeof(int));
+  xs = (SplashCoord *)gmallocn(scaledWidth, sizeof(SplashCoord));
+
+  // compute the horizontal interpolation parameters
+  interpColumns(srcWidth, scaledWidth, xSrc0, xSrc1, xs);
 
-  // read first two rows
-  (*src)(srcData, lineBuf0, alphaLineBuf0);
+  // read and interpolate first two rows
+  (*src)(srcData, srcBuf, srcAlphaBuf);
+  interpRowXu(srcBuf, nComps, scaledWidth, xSrc0, xSrc1, xs, lineBuf0);
+  if (srcAlpha) {
+    interpRowXu(srcAlphaBuf, 1, scaledWidth, xSrc0, xSrc1, xs,
+		alphaLineBuf0);
+  }
   if (srcHeight > 1) {
-    (*src)(srcData, lineBuf1, alphaLineBuf1);
+    (*src)(srcData, srcBuf, srcAlphaBuf);
+    interpRowXu(srcBuf, nComps, scaledWidth, xSrc0, xSrc1, xs, lineBuf1);
+    if (srcAlpha) {
+      interpRowXu(srcAlphaBuf, 1, scaledWidth, xSrc0, xSrc1, xs,
+		  alphaLineBuf1);
+    }
     yBuf = 1;
   } else {
-    memcpy(lineBuf1, lineBuf0, srcWidth * nComps);
+    memcpy(lineBuf1, lineBuf0, scaledWidth * nComps);
     if (srcAlpha) {
-      memcpy(alphaLineBuf1, alphaLineBuf0, srcWidth);
+      memcpy(alphaLineBuf1, alphaLineBuf0, scaledWidth);
     }
     yBuf = 0;
   }
 
-  // interpolate first two rows
-  for (x = scaledWidth - 1; x >= 0; --x) {
-    xSrc = xr * x;
-    xSrc0 = splashFloor(xSrc + xr * 0.5 - 0.5);
-    xSrc1 = xSrc0 + 1;
-    xs = ((SplashCoord)xSrc1 + 0.5) - (xSrc + xr * 0.5);
-    if (xSrc0 < 0) {
-      xSrc0 = 0;
-    }
-    if (xSrc1 >= srcWidth) {
-      xSrc1 = srcWidth - 1;
-    }
-    for (i = 0; i < nComps; ++i) {
-      lineBuf0[x*nComps+i] = (Guchar)(int)
-	                     (xs * lineBuf0[xSrc0*nComps+i] +
-			      ((SplashCoord)1 - xs) * lineBuf0[xSrc1*nComps+i]);
-      lineBuf1[x*nComps+i] = (Guchar)(int)
-	                     (xs * lineBuf1[xSrc0*nComps+i] +
-			      ((SplashCoord)1 - xs) * lineBuf1[xSrc1*nComps+i]);
-    }
-    if (srcAlpha) {
-      alphaLineBuf0[x] = (Guchar)(int)
-	                 (xs * alphaLineBuf0[xSrc0] +
-			  ((SplashCoord)1 - xs) * alphaLineBuf0[xSrc1]);
-      alphaLineBuf1[x] = (Guchar)(int)
-	                 (xs * alphaLineBuf1[xSrc0] +
-			  ((SplashCoord)1 - xs) * alphaLineBuf1[xSrc1]);
-    }
-  }
-
   destPtr = dest->data;
   destAlphaPtr = dest->alpha;
   for (y = 0; y < scaledHeight; ++y) {
@@ -5589,7 +6198,7 @@ void Splash::scaleImageYuXuI(SplashImageSource src, void *srcData,
       ys = 0;
     }
 
-    // read another row (if necessary)
+    // read and interpolate another row (if necessary)
     if (ySrc1 > yBuf) {
       tBuf = lineBuf0;
       lineBuf0 = lineBuf1;
@@ -5597,80 +6206,36 @@ void Splash::scaleImageYuXuI(SplashImageSource src, void *srcData,
       tBuf = alphaLineBuf0;
       alphaLineBuf0 = alphaLineBuf1;
       alphaLineBuf1 = tBuf;
-      (*src)(srcData, lineBuf1, alphaLineBuf1);
-
-      // interpolate the row
-      for (x = scaledWidth - 1; x >= 0; --x) {
-	xSrc = xr * x;
-	xSrc0 = splashFloor(xSrc + xr * 0.5 - 0.5);
-	xSrc1 = xSrc0 + 1;
-	xs = ((SplashCoord)xSrc1 + 0.5) - (xSrc + xr * 0.5);
-	if (xSrc0 < 0) {
-	  xSrc0 = 0;
-	}
-	if (xSrc1 >= srcWidth) {
-	  xSrc1 = srcWidth - 1;
-	}
-	for (i = 0; i < nComps; ++i) {
-	  lineBuf1[x*nComps+i] =
-	        (Guchar)(int)(xs * lineBuf1[xSrc0*nComps+i] +
-			      ((SplashCoord)1 - xs) * lineBuf1[xSrc1*nComps+i]);
-	}
-	if (srcAlpha) {
-	  alphaLineBuf1[x] =
-	        (Guchar)(int)(xs * alphaLineBuf1[xSrc0] +
-			      ((SplashCoord)1 - xs) * alphaLineBuf1[xSrc1]);
-	}
+      (*src)(srcData, srcBuf, srcAlphaBuf);
+      interpRowXu(srcBuf, nComps, scaledWidth, xSrc0, xSrc1, xs, lineBuf1);
+      if (srcAlpha) {
+	interpRowXu(srcAlphaBuf, 1, scaledWidth, xSrc0, xSrc1, xs,
+		    alphaLineBuf1);
       }
-
       ++yBuf;
     }
 
     // do the vertical interpolation
-    for (x = 0; x < scaledWidth; ++x) {
-
-      for (i = 0; i < nComps; ++i) {
-	pix[i] = (Guchar)(int)(ys * lineBuf0[x*nComps+i] +
-			       ((SplashCoord)1 - ys) * lineBuf1[x*nComps+i]);
-      }
-
-      // store the pixel
-      switch (srcMode) {
-      case splashModeMono8:
-	*destPtr++ = pix[0];
-	break;
-      case splashModeRGB8:
-	*destPtr++ = pix[0];
-	*destPtr++ = pix[1];
-	*destPtr++ = pix[2];
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	*destPtr++ = pix[0];
-	*destPtr++ = pix[1];
-	*destPtr++ = pix[2];
-	*destPtr++ = pix[3];
-	break;
-#endif
-      case splashModeMono1: // mono1 is not allowed
-      case splashModeBGR8: // BGR8 is not allowed
-      default:
-	break;
-      }
+    interpRows(lineBuf0, lineBuf1, ys, destPtr, scaledWidth * nComps);
+    destPtr += scaledWidth * nComps;
 
-      // process alpha
-      if (srcAlpha) {
-	*destAlphaPtr++ = (Guchar)(int)
-	                  (ys * alphaLineBuf0[x] +
-			   ((SplashCoord)1 - ys) * alphaLineBuf1[x]);
-      }
+    // process alpha
+    if (srcAlpha) {
+      interpRows(alphaLineBuf0, alphaLineBuf1, ys, destAlphaPtr,
+		 scaledWidth);
+      destAlphaPtr += scaledWidth;
     }
   }
 
+  gfree(xs);
+  gfree(xSrc1);
+  gfree(xSrc0);
   gfree(alphaLineBuf1);
   gfree(alphaLineBuf0);
+  gfree(srcAlphaBuf);
   gfree(lineBuf1);
   gfree(lineBuf0);
+  gfree(srcBuf);
 }
 
 void Splash::vertFlipImage(SplashBitmap *img, int width, int height,
@@ -5824,13 +6389,13 @@ void Splash::blitImageClipped(SplashBitmap *src, GBool srcAlpha,
   if (xDest + w > bitmap->width) {
     w = bitmap->width - xDest;
   }
-  if (yDest < 0) {
-    ySrc -= yDest;
-    h += yDest;
-    yDest = 0;
+  if (yDest < bitmap->bandY) {
+    ySrc += bitmap->bandY - yDest;
+    h -= bitmap->bandY - yDest;
+    yDest = bitmap->bandY;
   }
-  if (yDest + h > bitmap->height) {
-    h = bitmap->height - yDest;
+  if (yDest + h > bitmap->bandY + bitmap->bandH) {
+    h = bitmap->bandY + bitmap->bandH - yDest;
   }
   if (w <= 0 || h <= 0) {
     return;
@@ -5874,36 +6439,75 @@ void Splash::blitImageClipped(SplashBitmap *src, GBool srcAlpha,
   }
 }
 
+// Return a pointer to the <n> pixels of <src> starting at (<x>, <y>),
+// in the form the pipe expects -- Mono1 pixels are unpacked into
+// <buf> (one byte per pixel).
+static SplashColorPtr getCompositeSrc(SplashBitmap *src, int x, int y, int n,
+				      int nComps, SplashColorPtr buf) {
+  SplashColorPtr p;
+  int mask, i;
+
+  p = src->getRowPtr(y);
+  if (src->getMode() != splashModeMono1) {
+    return p + x * nComps;
+  }
+  p += x >> 3;
+  mask = 0x80 >> (x & 7);
+  for (i = 0; i < n; ++i) {
+    buf[i] = (*p & mask) ? 0xff : 0x00;
+    if (!(mask >>= 1)) {
+      mask = 0x80;
+      ++p;
+    }
+  }
+  return buf;
+}
+
 SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
 			      int xDest, int yDest, int w, int h,
 			      GBool noClip, GBool nonIsolated) {
   SplashPipe pipe;
+  SplashColorPtr lineBuf;
   int x0, x1, y0, y1, y, t;
 
   if (src->mode != bitmap->mode) {
     return splashErrModeMismatch;
   }
+  if (w <= 0) {
+    return splashOk;
+  }
+  lineBuf = NULL;
+  if (src->mode == splashModeMono1) {
+    lineBuf = (SplashColorPtr)gmalloc(w);
+  }
 
   pipeInit(&pipe, NULL,
 	   (Guchar)splashRound(state->fillAlpha * 255),
 	   !noClip || src->alpha != NULL, nonIsolated);
   if (noClip) {
+    y0 = 0;
+    if (yDest < bitmap->bandY) {
+      y0 = bitmap->bandY - yDest;
+    }
+    y1 = h;
+    if (yDest + h > bitmap->bandY + bitmap->bandH) {
+      y1 = bitmap->bandY + bitmap->bandH - yDest;
+    }
     if (src->alpha) {
-      for (y = 0; y < h; ++y) {
+      for (y = y0; y < y1; ++y) {
 	// this uses shape instead of alpha, which isn't technically
 	// correct, but works out the same
 	(this->*pipe.run)(&pipe, xDest, xDest + w - 1, yDest + y,
-			  src->getAlphaPtr() +
-			    (ySrc + y) * src->getWidth() + xSrc,
-			  src->getDataPtr() + (ySrc + y) * src->getRowSize() +
-			    xSrc * bitmapComps);
+			  src->getAlphaRowPtr(ySrc + y) + xSrc,
+			  getCompositeSrc(src, xSrc, ySrc + y, w,
+					  bitmapComps, lineBuf));
       }
     } else {
-      for (y = 0; y < h; ++y) {
+      for (y = y0; y < y1; ++y) {
 	(this->*pipe.run)(&pipe, xDest, xDest + w - 1, yDest + y,
 			  NULL,
-			  src->getDataPtr() + (ySrc + y) * src->getRowSize() +
-			    xSrc * bitmapComps);
+			  getCompositeSrc(src, xSrc, ySrc + y, w,
+					  bitmapComps, lineBuf));
       }
     }
   } else {
@@ -5927,8 +6531,7 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
       if (src->alpha) {
 	for (y = y0; y < y1; ++y) {
 	  memcpy(scanBuf + x0,
-		 src->getAlphaPtr() + (ySrc + y - yDest) * src->getWidth() + 
-		   (xSrc + x0 - xDest),
+		 src->getAlphaRowPtr(ySrc + y - yDest) + (xSrc + x0 - xDest),
 		 x1 - x0);
 	  if (!state->clip->clipSpanBinary(scanBuf, y, x0, x1 - 1,
 					   state->strokeAdjust)) {
@@ -5938,9 +6541,9 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
 	  // correct, but works out the same
 	  (this->*pipe.run)(&pipe, x0, x1 - 1, y,
 			    scanBuf + x0,
-			    src->getDataPtr() +
-			      (ySrc + y - yDest) * src->getRowSize() +
-			      (xSrc + x0 - xDest) * bitmapComps);
+			    getCompositeSrc(src, xSrc + x0 - xDest,
+					    ySrc + y - yDest, x1 - x0,
+					    bitmapComps, lineBuf));
 	}
       } else {
 	for (y = y0; y < y1; ++y) {
@@ -5949,16 +6552,17 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
 					   state->strokeAdjust)) {
 	    continue;
 	  }
-	  (this->*pipe.run)(&pipe, xDest, xDest + w - 1, yDest + y,
+	  (this->*pipe.run)(&pipe, x0, x1 - 1, y,
 			    scanBuf + x0,
-			    src->getDataPtr() +
-			      (ySrc + y - yDest) * src->getRowSize() +
-			      (xSrc - xDest) * bitmapComps);
+			    getCompositeSrc(src, xSrc + x0 - xDest,
+					    ySrc + y - yDest, x1 - x0,
+					    bitmapComps, lineBuf));
 	}
       }
     }
   }
 
+  gfree(lineBuf);
   return splashOk;
 }
 
@@ -5974,9 +6578,9 @@ void Splash::compositeBackground(SplashColorPtr color) {
   switch (bitmap->mode) {
   case splashModeMono1:
     color0 = color[0];
-    for (y = 0; y < bitmap->height; ++y) {
-      p = &bitmap->data[y * bitmap->rowSize];
-      q = &bitmap->alpha[y * bitmap->width];
+    for (y = bitmap->bandY; y < bitmap->bandY + bitmap->bandH; ++y) {
+      p = bitmap->getRowPtr(y);
+      q = bitmap->getAlphaRowPtr(y);
       mask = 0x80;
       for (x = 0; x < bitmap->width; ++x) {
 	alpha = *q++;
@@ -5997,9 +6601,9 @@ void Splash::compositeBackground(SplashColorPtr color) {
     break;
   case splashModeMono8:
     color0 = color[0];
-    for (y = 0; y < bitmap->height; ++y) {
-      p = &bitmap->data[y * bitmap->rowSize];
-      q = &bitmap->alpha[y * bitmap->width];
+    for (y = bitmap->bandY; y < bitmap->bandY + bitmap->bandH; ++y) {
+      p = bitmap->getRowPtr(y);
+      q = bitmap->getAlphaRowPtr(y);
       for (x = 0; x < bitmap->width; ++x) {
 	alpha = *q++;
 	alpha1 = 255 - alpha;
@@ -6013,9 +6617,9 @@ void Splash::compositeBackground(SplashColorPtr color) {
     color0 = color[0];
     color1 = color[1];
     color2 = color[2];
-    for (y = 0; y < bitmap->height; ++y) {
-      p = &bitmap->data[y * bitmap->rowSize];
-      q = &bitmap->alpha[y * bitmap->width];
+    for (y = bitmap->bandY; y < bitmap->bandY + bitmap->bandH; ++y) {
+      p = bitmap->getRowPtr(y);
+      q = bitmap->getAlphaRowPtr(y);
       for (x = 0; x < bitmap->width; ++x) {
 	alpha = *q++;
 	alpha1 = 255 - alpha;
@@ -6032,9 +6636,9 @@ void Splash::compositeBackground(SplashColorPtr color) {
     color1 = color[1];
     color2 = color[2];
     color3 = color[3];
-    for (y = 0; y < bitmap->height; ++y) {
-      p = &bitmap->data[y * bitmap->rowSize];
-      q = &bitmap->alpha[y * bitmap->width];
+    for (y = bitmap->bandY; y < bitmap->bandY + bitmap->bandH; ++y) {
+      p = bitmap->getRowPtr(y);
+      q = bitmap->getAlphaRowPtr(y);
       for (x = 0; x < bitmap->width; ++x) {
 	alpha = *q++;
 	alpha1 = 255 - alpha;
@@ -6051,11 +6655,10 @@ void Splash::compositeBackground(SplashColorPtr color) {
   }
   
   {
-      size_t cnt = bitmap->width * bitmap->height;
+      size_t cnt = bitmap->width * bitmap->bandH;
       if (0 < cnt)
       {
-          unsigned char* ptr = (unsigned char*)(bitmap->alpha);
-          memset(ptr, 255, cnt);
+          memset(bitmap->alpha, 255, cnt);
       }
   }
   return;
@@ -6064,18 +6667,34 @@ void Splash::compositeBackground(SplashColorPtr color) {
 SplashError Splash::blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
 				    int xDest, int yDest, int w, int h) {
   SplashColorPtr p, q;
-  int x, y, mask, srcMask;
+  int x, y, y0, y1, mask, srcMask;
 
   if (src->mode != bitmap->mode) {
     return splashErrModeMismatch;
   }
 
+  // only copy the rows which are allocated in both bitmaps
+  y0 = 0;
+  if (y0 < bitmap->bandY - yDest) {
+    y0 = bitmap->bandY - yDest;
+  }
+  if (y0 < src->bandY - ySrc) {
+    y0 = src->bandY - ySrc;
+  }
+  y1 = h;
+  if (y1 > bitmap->bandY + bitmap->bandH - yDest) {
+    y1 = bitmap->bandY + bitmap->bandH - yDest;
+  }
+  if (y1 > src->bandY + src->bandH - ySrc) {
+    y1 = src->bandY + src->bandH - ySrc;
+  }
+
   switch (bitmap->mode) {
   case splashModeMono1:
-    for (y = 0; y < h; ++y) {
-      p = &bitmap->data[(yDest + y) * bitmap->rowSize + (xDest >> 3)];
+    for (y = y0; y < y1; ++y) {
+      p = bitmap->getRowPtr(yDest + y) + (xDest >> 3);
       mask = 0x80 >> (xDest & 7);
-      q = &src->data[(ySrc + y) * src->rowSize + (xSrc >> 3)];
+      q = src->getRowPtr(ySrc + y) + (xSrc >> 3);
       srcMask = 0x80 >> (xSrc & 7);
       for (x = 0; x < w; ++x) {
 	if (*q & srcMask) {
@@ -6095,25 +6714,25 @@ SplashError Splash::blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
     }
     break;
   case splashModeMono8:
-    for (y = 0; y < h; ++y) {
-      p = &bitmap->data[(yDest + y) * bitmap->rowSize + xDest];
-      q = &src->data[(ySrc + y) * src->rowSize + xSrc];
+    for (y = y0; y < y1; ++y) {
+      p = bitmap->getRowPtr(yDest + y) + xDest;
+      q = src->getRowPtr(ySrc + y) + xSrc;
       memcpy(p, q, w);
     }
     break;
   case splashModeRGB8:
   case splashModeBGR8:
-    for (y = 0; y < h; ++y) {
-      p = &bitmap->data[(yDest + y) * bitmap->rowSize + 3 * xDest];
-      q = &src->data[(ySrc + y) * src->rowSize + 3 * xSrc];
+    for (y = y0; y < y1; ++y) {
+      p = bitmap->getRowPtr(yDest + y) + 3 * xDest;
+      q = src->getRowPtr(ySrc + y) + 3 * xSrc;
       memcpy(p, q, 3 * w);
     }
     break;
 #if SPLASH_CMYK
   case splashModeCMYK8:
-    for (y = 0; y < h; ++y) {
-      p = &bitmap->data[(yDest + y) * bitmap->rowSize + 4 * xDest];
-      q = &src->data[(ySrc + y) * src->rowSize + 4 * xSrc];
+    for (y = y0; y < y1; ++y) {
+      p = bitmap->getRowPtr(yDest + y) + 4 * xDest;
+      q = src->getRowPtr(ySrc + y) + 4 * xSrc;
       memcpy(p, q, 4 * w);
     }
     break;
@@ -6121,8 +6740,8 @@ SplashError Splash::blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
   }
 
   if (bitmap->alpha) {
-    for (y = 0; y < h; ++y) {
-      q = &bitmap->alpha[(yDest + y) * bitmap->width + xDest];
+    for (y = y0; y < y1; ++y) {
+      q = bitmap->getAlphaRowPtr(yDest + y) + xDest;
       memset(q, 0, w);
     }
   }
@@ -18,6 +18,7 @@
 #include "SplashTypes.h"
 #include "SplashClip.h"
 
+class GThreadPool;
 class Splash;
 class SplashBitmap;
 struct SplashGlyphBitmap;
@@ -240,6 +241,11 @@ public:
   // clipping.
   SplashClipResult getClipRes() { return opClipRes; }
 
+  // Use <threadPoolA> to resample large upscaled images in parallel.
+  // The pool is owned by the caller, and must only be used by one
+  // Splash object at a time.  NULL (the default) means single-threaded.
+  void setThreadPool(GThreadPool *threadPoolA) { threadPool = threadPoolA; }
+
   // Toggle debug mode on or off.
   void setDebugMode(GBool debugModeA) { debugMode = debugModeA; }
 
@@ -252,6 +258,7 @@ private:
   void pipeInit(SplashPipe *pipe, SplashPattern *pattern,
 		Guchar aInput, GBool usesShape,
 		GBool nonIsolatedGroup);
+  void pipeInitSolid(SplashPipe *pipe);
   void pipeRun(SplashPipe *pipe, int x0, int x1, int y,
 	       Guchar *shapePtr, SplashColorPtr cSrcPtr);
   void pipeRunSimpleMono1(SplashPipe *pipe, int x0, int x1, int y,
@@ -290,6 +297,10 @@ private:
   void pipeRunAACMYK8(SplashPipe *pipe, int x0, int x1, int y,
 		      Guchar *shapePtr, SplashColorPtr cSrcPtr);
 #endif
+  void pipeRunSolidFill(SplashPipe *pipe, int x0, int x1, int y,
+			Guchar *shapePtr, SplashColorPtr cSrcPtr);
+  void pipeRunSolidAA(SplashPipe *pipe, int x0, int x1, int y,
+		      Guchar *shapePtr, SplashColorPtr cSrcPtr);
   void transform(SplashCoord *matrix, SplashCoord xi, SplashCoord yi,
 		 SplashCoord *xo, SplashCoord *yo);
   void updateModX(int x);
@@ -416,6 +427,7 @@ private:
   SplashClipResult opClipRes;
   GBool vectorAntialias;
   GBool inShading;
+  GThreadPool *threadPool;	// for upscaleImage/upscaleMask (not owned)
   GBool debugMode;
 };
 
@@ -17,6 +17,7 @@
 #include "gmem.h"
 #include "SplashErrorCodes.h"
 #include "SplashBitmap.h"
+#include "SplashBitmapPool.h"
 
 //------------------------------------------------------------------------
 // SplashBitmap
@@ -24,9 +25,17 @@
 
 SplashBitmap::SplashBitmap(int widthA, int heightA, int rowPad,
 			   SplashColorMode modeA, GBool alphaA,
-			   GBool topDown) {
+			   GBool topDown, int bandYA, int bandHA,
+			   SplashBitmapPool *poolA) {
   width = widthA;
   height = heightA;
+  if (bandHA > 0) {
+    bandY = bandYA;
+    bandH = bandHA;
+  } else {
+    bandY = 0;
+    bandH = height;
+  }
   mode = modeA;
   switch (mode) {
   case splashModeMono1:
@@ -65,27 +74,52 @@ SplashBitmap::SplashBitmap(int widthA, int heightA, int rowPad,
     rowSize += rowPad - 1;
     rowSize -= rowSize % rowPad;
   }
-  data = (SplashColorPtr)gmallocn(height, rowSize);
+  if ((pool = poolA)) {
+    pool->incRefCnt();
+    data = (SplashColorPtr)pool->allocn(bandH, rowSize);
+  } else {
+    data = (SplashColorPtr)gmallocn(bandH, rowSize);
+  }
   if (!topDown) {
-    data += (height - 1) * rowSize;
+    data += (bandH - 1) * rowSize;
     rowSize = -rowSize;
   }
   if (alphaA) {
-    alpha = (Guchar *)gmallocn(width, height);
+    if (pool) {
+      alpha = (Guchar *)pool->allocn(width, bandH);
+    } else {
+      alpha = (Guchar *)gmallocn(width, bandH);
+    }
   } else {
     alpha = NULL;
   }
 }
 
 SplashBitmap::~SplashBitmap() {
+  SplashColorPtr p;
+
   if (data) {
-  if (rowSize < 0) {
-    gfree(data + (height - 1) * rowSize);
-  } else {
-    gfree(data);
+    if (rowSize < 0) {
+      p = data + (bandH - 1) * rowSize;
+    } else {
+      p = data;
+    }
+    if (pool) {
+      pool->release(p, bandH, rowSize < 0 ? -rowSize : rowSize);
+    } else {
+      gfree(p);
+    }
   }
+  if (alpha) {
+    if (pool) {
+      pool->release(alpha, width, bandH);
+    } else {
+      gfree(alpha);
+    }
+  }
+  if (pool) {
+    pool->decRefCnt();
   }
-  gfree(alpha);
 }
 
 SplashError SplashBitmap::writePNMFile(char *fileName) {
@@ -101,15 +135,43 @@ SplashError SplashBitmap::writePNMFile(char *fileName) {
 }
 
 SplashError SplashBitmap::writePNMFile(FILE *f) {
+  writePNMHeader(f, bandH);
+  return writePNMRows(f, bandY, bandY + bandH);
+}
+
+void SplashBitmap::writePNMHeader(FILE *f, int h) {
+  switch (mode) {
+  case splashModeMono1:
+    fprintf(f, "P4\n%d %d\n", width, h);
+    break;
+  case splashModeMono8:
+    fprintf(f, "P5\n%d %d\n255\n", width, h);
+    break;
+  case splashModeRGB8:
+  case splashModeBGR8:
+    fprintf(f, "P6\n%d %d\n255\n", width, h);
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    // PNM doesn't support CMYK
+    break;
+#endif
+  }
+}
+
+SplashError SplashBitmap::writePNMRows(FILE *f, int yMin, int yMax) {
   SplashColorPtr row, p;
   int x, y;
 
+  if (yMin < bandY || yMax > bandY + bandH) {
+    return splashErrBadArg;
+  }
+
   switch (mode) {
 
   case splashModeMono1:
-    fprintf(f, "P4\n%d %d\n", width, height);
-    row = data;
-    for (y = 0; y < height; ++y) {
+    row = getRowPtr(yMin);
+    for (y = yMin; y < yMax; ++y) {
       p = row;
       for (x = 0; x < width; x += 8) {
 	fputc(*p ^ 0xff, f);
@@ -120,27 +182,24 @@ SplashError SplashBitmap::writePNMFile(FILE *f) {
     break;
 
   case splashModeMono8:
-    fprintf(f, "P5\n%d %d\n255\n", width, height);
-    row = data;
-    for (y = 0; y < height; ++y) {
+    row = getRowPtr(yMin);
+    for (y = yMin; y < yMax; ++y) {
       fwrite(row, 1, width, f);
       row += rowSize;
     }
     break;
 
   case splashModeRGB8:
-    fprintf(f, "P6\n%d %d\n255\n", width, height);
-    row = data;
-    for (y = 0; y < height; ++y) {
+    row = getRowPtr(yMin);
+    for (y = yMin; y < yMax; ++y) {
       fwrite(row, 1, 3 * width, f);
       row += rowSize;
     }
     break;
 
   case splashModeBGR8:
-    fprintf(f, "P6\n%d %d\n255\n", width, height);
-    row = data;
-    for (y = 0; y < height; ++y) {
+    row = getRowPtr(yMin);
+    for (y = yMin; y < yMax; ++y) {
       p = row;
       for (x = 0; x < width; ++x) {
 	fputc(splashBGR8R(p), f);
@@ -161,7 +220,7 @@ SplashError SplashBitmap::writePNMFile(FILE *f) {
   }
 
   return splashOk;
-  }
+}
 
 SplashError SplashBitmap::writeAlphaPGMFile(char *fileName) {
   FILE *f;
@@ -172,8 +231,8 @@ SplashError SplashBitmap::writeAlphaPGMFile(char *fileName) {
   if (!(f = fopen(fileName, "wb"))) {
     return splashErrOpenFile;
   }
-  fprintf(f, "P5\n%d %d\n255\n", width, height);
-  fwrite(alpha, 1, width * height, f);
+  fprintf(f, "P5\n%d %d\n255\n", width, bandH);
+  fwrite(alpha, 1, width * bandH, f);
   fclose(f);
   return splashOk;
 }
@@ -182,33 +241,33 @@ SplashError SplashBitmap::writeAlphaPGMFile(char *fileName) {
 void SplashBitmap::getPixel(int x, int y, SplashColorPtr pixel) {
   SplashColorPtr p;
 
-  if (y < 0 || y >= height || x < 0 || x >= width) {
+  if (y < bandY || y >= bandY + bandH || x < 0 || x >= width) {
     return;
   }
   switch (mode) {
   case splashModeMono1:
-    p = &data[y * rowSize + (x >> 3)];
+    p = &data[(y - bandY) * rowSize + (x >> 3)];
     pixel[0] = (p[0] & (0x80 >> (x & 7))) ? 0xff : 0x00;
     break;
   case splashModeMono8:
-    p = &data[y * rowSize + x];
+    p = &data[(y - bandY) * rowSize + x];
     pixel[0] = p[0];
     break;
   case splashModeRGB8:
-    p = &data[y * rowSize + 3 * x];
+    p = &data[(y - bandY) * rowSize + 3 * x];
     pixel[0] = p[0];
     pixel[1] = p[1];
     pixel[2] = p[2];
     break;
   case splashModeBGR8:
-    p = &data[y * rowSize + 3 * x];
+    p = &data[(y - bandY) * rowSize + 3 * x];
     pixel[0] = p[2];
     pixel[1] = p[1];
     pixel[2] = p[0];
     break;
 #if SPLASH_CMYK
   case splashModeCMYK8:
-    p = &data[y * rowSize + 4 * x];
+    p = &data[(y - bandY) * rowSize + 4 * x];
     pixel[0] = p[0];
     pixel[1] = p[1];
     pixel[2] = p[2];
@@ -219,7 +278,7 @@ void SplashBitmap::getPixel(int x, int y, SplashColorPtr pixel) {
 }
 
 Guchar SplashBitmap::getAlpha(int x, int y) {
-  return alpha[y * width + x];
+  return alpha[(y - bandY) * width + x];
 }
 
 SplashColorPtr SplashBitmap::takeData() {
@@ -18,6 +18,8 @@
 #include <stdio.h>
 #include "SplashTypes.h"
 
+class SplashBitmapPool;
+
 //------------------------------------------------------------------------
 // SplashBitmap
 //------------------------------------------------------------------------
@@ -28,25 +30,46 @@ public:
   // Create a new bitmap.  It will have <widthA> x <heightA> pixels in
   // color mode <modeA>.  Rows will be padded out to a multiple of
   // <rowPad> bytes.  If <topDown> is false, the bitmap will be stored
-  // upside-down, i.e., with the last row first in memory.
+  // upside-down, i.e., with the last row first in memory.  If
+  // <bandHA> is positive, only rows <bandYA> .. <bandYA>+<bandHA>-1
+  // are allocated: the coordinate system (and getRowPtr() /
+  // getAlphaRowPtr() addressing) is that of the full bitmap, but
+  // rows outside the band must not be accessed.  Splash clips all
+  // drawing to the band.  If <poolA> is non-NULL, the data and alpha
+  // buffers are taken from, and returned to, that pool.
   SplashBitmap(int widthA, int heightA, int rowPad,
 	       SplashColorMode modeA, GBool alphaA,
-	       GBool topDown = gTrue);
+	       GBool topDown = gTrue, int bandYA = 0, int bandHA = 0,
+	       SplashBitmapPool *poolA = NULL);
 
   ~SplashBitmap();
 
   int getWidth() { return width; }
   int getHeight() { return height; }
+  int getBandY() { return bandY; }
+  int getBandHeight() { return bandH; }
   int getRowSize() { return rowSize; }
   int getAlphaRowSize() { return width; }
   SplashColorMode getMode() { return mode; }
   SplashColorPtr getDataPtr() { return data; }
   Guchar *getAlphaPtr() { return alpha; }
 
+  // Pointers to row <y> (in the band) of the color and alpha data.
+  SplashColorPtr getRowPtr(int y) { return data + (y - bandY) * rowSize; }
+  Guchar *getAlphaRowPtr(int y) { return alpha + (y - bandY) * width; }
+
+  // Write the rows in the band (i.e., the whole bitmap, unless it was
+  // created with a band).
   SplashError writePNMFile(char *fileName);
   SplashError writePNMFile(FILE *f);
   SplashError writeAlphaPGMFile(char *fileName);
 
+  // Write the PNM header for a bitmap with <h> rows, and the raster
+  // data for rows <yMin> .. <yMax>-1 (which must be in the band) --
+  // for assembling a PNM file from several bands.
+  void writePNMHeader(FILE *f, int h);
+  SplashError writePNMRows(FILE *f, int yMin, int yMax);
+
   void getPixel(int x, int y, SplashColorPtr pixel);
   Guchar getAlpha(int x, int y);
 
@@ -58,12 +81,14 @@ public:
 private:
 
   int width, height;		// size of bitmap
+  int bandY, bandH;		// rows which are actually allocated
   int rowSize;			// size of one row of data, in bytes
 				//   - negative for bottom-up bitmaps
   SplashColorMode mode;		// color mode
-  SplashColorPtr data;		// pointer to row zero of the color data
-  Guchar *alpha;		// pointer to row zero of the alpha data
+  SplashColorPtr data;		// pointer to row <bandY> of the color data
+  Guchar *alpha;		// pointer to row <bandY> of the alpha data
 				//   (always top-down)
+  SplashBitmapPool *pool;	// buffer pool, or NULL
 
   friend class Splash;
 };
@@ -0,0 +1,176 @@
+//========================================================================
+//
+// SplashBitmapPool.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <limits.h>
+#include "gmem.h"
+#include "SplashBitmapPool.h"
+
+//------------------------------------------------------------------------
+
+#if MULTITHREADED
+#  define lockBitmapPool   gLockMutex(&mutex)
+#  define unlockBitmapPool gUnlockMutex(&mutex)
+#else
+#  define lockBitmapPool
+#  define unlockBitmapPool
+#endif
+
+//------------------------------------------------------------------------
+// SplashBitmapPoolEntry
+//------------------------------------------------------------------------
+
+struct SplashBitmapPoolEntry {
+  void *buf;
+  int size;
+  SplashBitmapPoolEntry *lruPrev, // neighbors in LRU list
+                        *lruNext;
+};
+
+//------------------------------------------------------------------------
+// SplashBitmapPool
+//------------------------------------------------------------------------
+
+SplashBitmapPool::SplashBitmapPool(long long maxFreeBytesA) {
+  maxFreeBytes = maxFreeBytesA;
+  freeBytes = 0;
+  lruHead = lruTail = NULL;
+  nAllocs = allocBytes = 0;
+  nReuses = reuseBytes = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+  refCnt = 1;
+}
+
+SplashBitmapPool::~SplashBitmapPool() {
+  SplashBitmapPoolEntry *entry, *next;
+
+  for (entry = lruHead; entry; entry = next) {
+    next = entry->lruNext;
+    gfree(entry->buf);
+    delete entry;
+  }
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void SplashBitmapPool::incRefCnt() {
+#if MULTITHREADED
+  gAtomicIncrement(&refCnt);
+#else
+  ++refCnt;
+#endif
+}
+
+void SplashBitmapPool::decRefCnt() {
+  GBool done;
+
+#if MULTITHREADED
+  done = gAtomicDecrement(&refCnt) == 0;
+#else
+  done = --refCnt == 0;
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+void *SplashBitmapPool::allocn(int nObjs, int objSize) {
+  SplashBitmapPoolEntry *entry;
+  void *buf;
+  int size;
+
+  // let gmallocn deal with empty and overflowing sizes
+  if (nObjs <= 0 || objSize <= 0 || nObjs > INT_MAX / objSize) {
+    return gmallocn(nObjs, objSize);
+  }
+  size = nObjs * objSize;
+  lockBitmapPool;
+  // most recently released first
+  for (entry = lruHead; entry; entry = entry->lruNext) {
+    if (entry->size == size) {
+      break;
+    }
+  }
+  if (entry) {
+    if (entry->lruPrev) {
+      entry->lruPrev->lruNext = entry->lruNext;
+    } else {
+      lruHead = entry->lruNext;
+    }
+    if (entry->lruNext) {
+      entry->lruNext->lruPrev = entry->lruPrev;
+    } else {
+      lruTail = entry->lruPrev;
+    }
+    freeBytes -= size;
+    ++nReuses;
+    reuseBytes += size;
+    unlockBitmapPool;
+    buf = entry->buf;
+    delete entry;
+    return buf;
+  }
+  ++nAllocs;
+  allocBytes += size;
+  unlockBitmapPool;
+  return gmalloc(size);
+}
+
+void SplashBitmapPool::release(void *buf, int nObjs, int objSize) {
+  SplashBitmapPoolEntry *entry;
+  int size;
+
+  if (!buf) {
+    return;
+  }
+  size = nObjs * objSize;
+  if (size <= 0 || size > maxFreeBytes) {
+    gfree(buf);
+    return;
+  }
+  entry = new SplashBitmapPoolEntry;
+  entry->buf = buf;
+  entry->size = size;
+  lockBitmapPool;
+  entry->lruPrev = NULL;
+  entry->lruNext = lruHead;
+  if (lruHead) {
+    lruHead->lruPrev = entry;
+  } else {
+    lruTail = entry;
+  }
+  lruHead = entry;
+  freeBytes += size;
+  trim();
+  unlockBitmapPool;
+}
+
+// Free the least recently released buffers until the free buffers fit
+// in the budget.  The mutex must be locked.
+void SplashBitmapPool::trim() {
+  SplashBitmapPoolEntry *entry;
+
+  while (freeBytes > maxFreeBytes && lruTail) {
+    entry = lruTail;
+    lruTail = entry->lruPrev;
+    if (lruTail) {
+      lruTail->lruNext = NULL;
+    } else {
+      lruHead = NULL;
+    }
+    freeBytes -= entry->size;
+    gfree(entry->buf);
+    delete entry;
+  }
+}
@@ -0,0 +1,87 @@
+//========================================================================
+//
+// SplashBitmapPool.h
+//
+//========================================================================
+
+#ifndef SPLASHBITMAPPOOL_H
+#define SPLASHBITMAPPOOL_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
+
+struct SplashBitmapPoolEntry;
+
+//------------------------------------------------------------------------
+// SplashBitmapPool
+//------------------------------------------------------------------------
+
+// Recycles the data and alpha buffers of SplashBitmaps.  A bitmap
+// created with a pool gets its buffers from the pool, and returns
+// them when it is deleted, so page, mask, and transparency group
+// bitmaps of the same size don't go back to the system allocator
+// (and get page-faulted in again) on every page.  Buffers are
+// matched by size in bytes, which is determined by the bitmap's
+// width, band height, color mode, and row padding.  Free buffers are
+// released in LRU order once their total size exceeds the budget.
+// A pool may be shared by any number of SplashOutputDevs, in
+// different threads.
+class SplashBitmapPool {
+public:
+
+  SplashBitmapPool(long long maxFreeBytesA);
+
+  // Increment the reference count.
+  void incRefCnt();
+
+  // Decrement the reference count.  If the new value is zero, delete
+  // the SplashBitmapPool object.
+  void decRefCnt();
+
+  // Return a buffer of <nObjs> * <objSize> bytes, like gmallocn.
+  // Its contents are undefined.
+  void *allocn(int nObjs, int objSize);
+
+  // Return a buffer obtained from allocn() to the pool.
+  void release(void *buf, int nObjs, int objSize);
+
+  // Statistics.
+  long long getMaxFreeBytes() { return maxFreeBytes; }
+  long long getFreeBytes() { return freeBytes; }
+  unsigned long long getNumAllocs() { return nAllocs; }
+  unsigned long long getAllocBytes() { return allocBytes; }
+  unsigned long long getNumReuses() { return nReuses; }
+  unsigned long long getReuseBytes() { return reuseBytes; }
+
+private:
+
+  ~SplashBitmapPool();
+
+  void trim();
+
+  long long maxFreeBytes;	// budget for free buffers
+  long long freeBytes;		// total size of free buffers
+  SplashBitmapPoolEntry *lruHead, // most/least recently released
+                        *lruTail; //   free buffers
+  unsigned long long nAllocs;	// buffers allocated from the system
+  unsigned long long allocBytes;
+  unsigned long long nReuses;	// buffers reused from the pool
+  unsigned long long reuseBytes;
+
+#if MULTITHREADED
+  GMutex mutex;
+  GAtomicCounter refCnt;
+#else
+  int refCnt;
+#endif
+};
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "gmem.h"
 #include "GString.h"
+#include "SplashGlyphCache.h"
 #include "SplashFTFontEngine.h"
 #include "SplashFTFont.h"
 #include "SplashFTFontFile.h"
@@ -150,6 +151,19 @@ SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA,
   codeToGIDLen = codeToGIDLenA;
   trueType = trueTypeA;
   useLightHinting = useLightHintingA;
+
+  // add everything that affects rasterization to the digest
+  digest = SplashGlyphCache::hash(digest, &face->face_index,
+				  sizeof(face->face_index));
+  if (codeToGID) {
+    digest = SplashGlyphCache::hash(digest, codeToGID,
+				    codeToGIDLen * (int)sizeof(int));
+  }
+  digest = SplashGlyphCache::hash(digest, &trueType, sizeof(trueType));
+  digest = SplashGlyphCache::hash(digest, &useLightHinting,
+				  sizeof(useLightHinting));
+  digest = SplashGlyphCache::hash(digest, &engine->flags,
+				  sizeof(engine->flags));
 }
 
 SplashFTFontFile::~SplashFTFontFile() {
@@ -16,25 +16,10 @@
 #include "gmem.h"
 #include "SplashMath.h"
 #include "SplashGlyphBitmap.h"
+#include "SplashGlyphCache.h"
 #include "SplashFontFile.h"
 #include "SplashFont.h"
 
-//------------------------------------------------------------------------
-
-// font cache size parameters
-#define splashFontCacheAssoc   8
-#define splashFontCacheMaxSets 8
-#define splashFontCacheSize    (128*1024)
-
-//------------------------------------------------------------------------
-
-struct SplashFontCacheTag {
-  int c;
-  short xFrac, yFrac;		// x and y fractions
-  int mru;			// valid bit (0x80000000) and MRU index
-  int x, y, w, h;		// offset and size of glyph
-};
-
 //------------------------------------------------------------------------
 // SplashFont
 //------------------------------------------------------------------------
@@ -53,55 +38,38 @@ SplashFont::SplashFont(SplashFontFile *fontFileA, SplashCoord *matA,
   textMat[3] = textMatA[3];
   aa = aaA;
 
-  cache = NULL;
-  cacheTags = NULL;
+  glyphCache = NULL;
 
   xMin = yMin = xMax = yMax = 0;
 }
 
 void SplashFont::initCache() {
-  int i;
-
   // this should be (max - min + 1), but we add some padding to
   // deal with rounding errors
   glyphW = xMax - xMin + 3;
   glyphH = yMax - yMin + 3;
-  if (aa) {
-    glyphSize = glyphW * glyphH;
-  } else {
-    glyphSize = ((glyphW + 7) >> 3) * glyphH;
-  }
+}
 
-  // set up the glyph pixmap cache
-  cacheAssoc = splashFontCacheAssoc;
-  for (cacheSets = splashFontCacheMaxSets;
-       cacheSets > 1 &&
-	 cacheSets * cacheAssoc * glyphSize > splashFontCacheSize;
-       cacheSets >>= 1) ;
-  cache = (Guchar *)gmallocn(cacheSets * cacheAssoc, glyphSize);
-  cacheTags = (SplashFontCacheTag *)gmallocn(cacheSets * cacheAssoc,
-					     sizeof(SplashFontCacheTag));
-  for (i = 0; i < cacheSets * cacheAssoc; ++i) {
-    cacheTags[i].mru = i & (cacheAssoc - 1);
+void SplashFont::setGlyphCache(SplashGlyphCache *glyphCacheA) {
+  if (glyphCacheA) {
+    glyphCacheA->incRefCnt();
   }
+  if (glyphCache) {
+    glyphCache->decRefCnt();
+  }
+  glyphCache = glyphCacheA;
 }
 
 SplashFont::~SplashFont() {
   fontFile->decRefCnt();
-  if (cache) {
-    gfree(cache);
-  }
-  if (cacheTags) {
-    gfree(cacheTags);
+  if (glyphCache) {
+    glyphCache->decRefCnt();
   }
 }
 
 GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
 			   SplashGlyphBitmap *bitmap) {
-  SplashGlyphBitmap bitmap2;
-  int size;
-  Guchar *p;
-  int i, j, k;
+  SplashGlyphCacheKey key;
 
   // no fractional coordinates for large glyphs or non-anti-aliased
   // glyphs
@@ -110,71 +78,54 @@ GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
   }
 
   // check the cache
-  i = (c & (cacheSets - 1)) * cacheAssoc;
-  for (j = 0; j < cacheAssoc; ++j) {
-    if ((cacheTags[i+j].mru & 0x80000000) &&
-	cacheTags[i+j].c == c &&
-	(int)cacheTags[i+j].xFrac == xFrac &&
-	(int)cacheTags[i+j].yFrac == yFrac) {
-      bitmap->x = cacheTags[i+j].x;
-      bitmap->y = cacheTags[i+j].y;
-      bitmap->w = cacheTags[i+j].w;
-      bitmap->h = cacheTags[i+j].h;
-      for (k = 0; k < cacheAssoc; ++k) {
-	if (k != j &&
-	    (cacheTags[i+k].mru & 0x7fffffff) <
-	      (cacheTags[i+j].mru & 0x7fffffff)) {
-	  ++cacheTags[i+k].mru;
-	}
+  if (glyphCache) {
+    key.font = fontFile->getDigest();
+    key.mat[0] = mat[0];
+    key.mat[1] = mat[1];
+    key.mat[2] = mat[2];
+    key.mat[3] = mat[3];
+    key.c = c;
+    key.xFrac = (short)xFrac;
+    key.yFrac = (short)yFrac;
+    key.aa = aa;
+    if (glyphCache->lookup(&key, bitmap)) {
+      if (!bitmap->data) {
+	glyphCache->release(bitmap);
+	return gFalse;
       }
-      cacheTags[i+j].mru = 0x80000000;
-      bitmap->aa = aa;
-      bitmap->data = cache + (i+j) * glyphSize;
-      bitmap->freeData = gFalse;
       return gTrue;
     }
   }
 
-  // generate the glyph bitmap
-  if (!makeGlyph(c, xFrac, yFrac, &bitmap2)) {
+  // generate the glyph bitmap -- if that fails, cache an empty glyph,
+  // so the rasterizer doesn't have to fail again (this is common,
+  // e.g., for spaces)
+  if (!makeGlyph(c, xFrac, yFrac, bitmap)) {
+    if (glyphCache) {
+      bitmap->x = bitmap->y = bitmap->w = bitmap->h = 0;
+      bitmap->aa = aa;
+      bitmap->data = NULL;
+      bitmap->freeData = gFalse;
+      bitmap->cacheEntry = NULL;
+      glyphCache->insert(&key, bitmap);
+      glyphCache->release(bitmap);
+    }
     return gFalse;
   }
+  bitmap->cacheEntry = NULL;
 
-  // if the glyph doesn't fit in the bounding box, return a temporary
-  // uncached bitmap
-  if (bitmap2.w > glyphW || bitmap2.h > glyphH) {
-    *bitmap = bitmap2;
-    return gTrue;
+  // insert it in the cache
+  if (glyphCache) {
+    glyphCache->insert(&key, bitmap);
   }
+  return gTrue;
+}
 
-  // insert glyph pixmap in cache
-  if (aa) {
-    size = bitmap2.w * bitmap2.h;
-  } else {
-    size = ((bitmap2.w + 7) >> 3) * bitmap2.h;
+void SplashFont::releaseGlyph(SplashGlyphBitmap *bitmap) {
+  if (bitmap->freeData) {
+    gfree(bitmap->data);
   }
-  p = NULL; // make gcc happy
-  for (j = 0; j < cacheAssoc; ++j) {
-    if ((cacheTags[i+j].mru & 0x7fffffff) == cacheAssoc - 1) {
-      cacheTags[i+j].mru = 0x80000000;
-      cacheTags[i+j].c = c;
-      cacheTags[i+j].xFrac = (short)xFrac;
-      cacheTags[i+j].yFrac = (short)yFrac;
-      cacheTags[i+j].x = bitmap2.x;
-      cacheTags[i+j].y = bitmap2.y;
-      cacheTags[i+j].w = bitmap2.w;
-      cacheTags[i+j].h = bitmap2.h;
-      p = cache + (i+j) * glyphSize;
-      memcpy(p, bitmap2.data, size);
-    } else {
-      ++cacheTags[i+j].mru;
-    }
+  if (bitmap->cacheEntry) {
+    glyphCache->release(bitmap);
   }
-  *bitmap = bitmap2;
-  bitmap->data = p;
-  bitmap->freeData = gFalse;
-  if (bitmap2.freeData) {
-    gfree(bitmap2.data);
-  }
-  return gTrue;
 }
@@ -19,7 +19,7 @@
 #include "SplashTypes.h"
 
 struct SplashGlyphBitmap;
-struct SplashFontCacheTag;
+class SplashGlyphCache;
 class SplashFontFile;
 class SplashPath;
 
@@ -46,6 +46,10 @@ public:
   // constructor has a chance to compute the bbox.
   void initCache();
 
+  // Set the cache used by getGlyph.  If this is never called (or
+  // <glyphCacheA> is NULL), glyphs are rasterized on every use.
+  void setGlyphCache(SplashGlyphCache *glyphCacheA);
+
   virtual ~SplashFont();
 
   SplashFontFile *getFontFile() { return fontFile; }
@@ -70,6 +74,9 @@ public:
   virtual GBool getGlyph(int c, int xFrac, int yFrac,
 			 SplashGlyphBitmap *bitmap);
 
+  // Release a glyph returned by getGlyph.
+  void releaseGlyph(SplashGlyphBitmap *bitmap);
+
   // Rasterize a glyph.  The <xFrac> and <yFrac> values are the same
   // as described for getGlyph.
   virtual GBool makeGlyph(int c, int xFrac, int yFrac,
@@ -94,13 +101,8 @@ protected:
 				//   (text space -> user space)
   GBool aa;			// anti-aliasing
   int xMin, yMin, xMax, yMax;	// glyph bounding box
-  Guchar *cache;		// glyph bitmap cache
-  SplashFontCacheTag *		// cache tags
-    cacheTags;
   int glyphW, glyphH;		// size of glyph bitmaps
-  int glyphSize;		// size of glyph bitmaps, in bytes
-  int cacheSets;		// number of sets in cache
-  int cacheAssoc;		// cache associativity (glyphs per set)
+  SplashGlyphCache *glyphCache;	// glyph bitmap cache (shared)
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "SplashFontFile.h"
 #include "SplashFontFileID.h"
 #include "SplashFont.h"
+#include "SplashGlyphCache.h"
 #include "SplashFontEngine.h"
 
 #ifdef VMS
@@ -41,12 +42,16 @@ SplashFontEngine::SplashFontEngine(
 				   GBool enableFreeType,
 				   Guint freeTypeFlags,
 #endif
-				   GBool aa) {
+				   GBool aa, SplashGlyphCache *glyphCacheA) {
   int i;
 
   for (i = 0; i < splashFontCacheSize; ++i) {
     fontCache[i] = NULL;
   }
+  glyphCache = glyphCacheA;
+  if (glyphCache) {
+    glyphCache->incRefCnt();
+  }
 
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (enableFreeType) {
@@ -65,6 +70,9 @@ SplashFontEngine::~SplashFontEngine() {
       delete fontCache[i];
     }
   }
+  if (glyphCache) {
+    glyphCache->decRefCnt();
+  }
 
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   if (ftEngine) {
@@ -344,6 +352,7 @@ SplashFont *SplashFontEngine::getFont(SplashFontFile *fontFile,
     }
   }
   font = fontFile->makeFont(mat, textMat);
+  font->setGlyphCache(glyphCache);
   if (fontCache[splashFontCacheSize - 1]) {
     delete fontCache[splashFontCacheSize - 1];
   }
@@ -24,10 +24,11 @@ class SplashDT4FontEngine;
 class SplashFontFile;
 class SplashFontFileID;
 class SplashFont;
+class SplashGlyphCache;
 
 //------------------------------------------------------------------------
 
-#define splashFontCacheSize 16
+#define splashFontCacheSize 64
 
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
 #define splashFTNoHinting (1 << 0)
@@ -40,13 +41,14 @@ class SplashFont;
 class SplashFontEngine {
 public:
 
-  // Create a font engine.
+  // Create a font engine.  Rasterized glyphs are stored in
+  // <glyphCacheA>, which may be shared with other font engines.
   SplashFontEngine(
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
 		   GBool enableFreeType,
 		   Guint freeTypeFlags,
 #endif
-		   GBool aa);
+		   GBool aa, SplashGlyphCache *glyphCacheA);
 
   ~SplashFontEngine();
 
@@ -114,6 +116,7 @@ public:
 private:
 
   SplashFont *fontCache[splashFontCacheSize];
+  SplashGlyphCache *glyphCache;
 
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
   SplashFTFontEngine *ftEngine;
@@ -17,6 +17,10 @@
 #  include <unistd.h>
 #endif
 #include "GString.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
+#include "SplashGlyphCache.h"
 #include "SplashFontFile.h"
 #include "SplashFontFileID.h"
 
@@ -26,6 +30,15 @@ extern "C" int unlink(char *filename);
 #endif
 #endif
 
+//------------------------------------------------------------------------
+
+// Used to give a unique digest to font files that can't be read.
+#if MULTITHREADED
+static GAtomicCounter unreadableFontCounter = 0;
+#else
+static long unreadableFontCounter = 0;
+#endif
+
 //------------------------------------------------------------------------
 // SplashFontFile
 //------------------------------------------------------------------------
@@ -37,12 +50,36 @@ SplashFontFile::SplashFontFile(SplashFontFileID *idA,
 			       char *fileNameA, GBool deleteFileA
 #endif
 			       ) {
+#if !LOAD_FONTS_FROM_MEM
+  FILE *f;
+  char buf[4096];
+  int n;
+  long serial;
+#endif
+
   id = idA;
 #if LOAD_FONTS_FROM_MEM
   fontBuf = fontBufA;
+  digest = SplashGlyphCache::hash(SplashGlyphCache::hashInit,
+				  fontBuf->getCString(), fontBuf->getLength());
 #else
   fileName = new GString(fileNameA);
   deleteFile = deleteFileA;
+  digest = SplashGlyphCache::hashInit;
+  if ((f = fopen(fileNameA, "rb"))) {
+    while ((n = (int)fread(buf, 1, sizeof(buf), f)) > 0) {
+      digest = SplashGlyphCache::hash(digest, buf, n);
+    }
+    fclose(f);
+  } else {
+#if MULTITHREADED
+    serial = gAtomicIncrement(&unreadableFontCounter);
+#else
+    serial = ++unreadableFontCounter;
+#endif
+    digest = SplashGlyphCache::hash(digest, "unreadable", 10);
+    digest = SplashGlyphCache::hash(digest, &serial, sizeof(serial));
+  }
 #endif
   refCnt = 0;
 }
@@ -39,6 +39,12 @@ public:
   // Get the font file ID.
   SplashFontFileID *getID() { return id; }
 
+  // Get the content digest, which identifies the rasterized glyphs
+  // in the SplashGlyphCache.  Font files with identical data and
+  // rasterization parameters have the same digest, even if they
+  // belong to different documents.
+  unsigned long long getDigest() { return digest; }
+
   // Increment the reference count.
   void incRefCnt();
 
@@ -63,6 +69,8 @@ protected:
   GString *fileName;
   GBool deleteFile;
 #endif
+  unsigned long long digest;	// content digest -- subclasses should
+				//   add their rasterization parameters
   int refCnt;
 
   friend class SplashFontEngine;
@@ -13,6 +13,8 @@
 
 #include "gtypes.h"
 
+struct SplashGlyphCacheEntry;
+
 //------------------------------------------------------------------------
 // SplashGlyphBitmap
 //------------------------------------------------------------------------
@@ -23,6 +25,8 @@ struct SplashGlyphBitmap {
 				//   bitmap; false means 1-bit
   Guchar *data;			// bitmap data
   GBool freeData;		// true if data memory should be freed
+  SplashGlyphCacheEntry *	// pinned glyph cache entry which owns
+    cacheEntry;			//   data (or NULL)
 };
 
 #endif
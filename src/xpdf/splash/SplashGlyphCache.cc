@@ -0,0 +1,322 @@
+//========================================================================
+//
+// SplashGlyphCache.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "gmem.h"
+#include "SplashGlyphBitmap.h"
+#include "SplashGlyphCache.h"
+
+//------------------------------------------------------------------------
+
+#if MULTITHREADED
+#  define lockGlyphCache   gLockMutex(&mutex)
+#  define unlockGlyphCache gUnlockMutex(&mutex)
+#else
+#  define lockGlyphCache
+#  define unlockGlyphCache
+#endif
+
+// initial number of hash table buckets (must be a power of 2)
+#define splashGlyphCacheInitTabSize 1024
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+SplashGlyphCache::SplashGlyphCache(int maxBytesA) {
+  int i;
+
+  maxBytes = maxBytesA;
+  nBytes = 0;
+  tabSize = splashGlyphCacheInitTabSize;
+  tab = (SplashGlyphCacheEntry **)gmallocn(tabSize,
+					   sizeof(SplashGlyphCacheEntry *));
+  for (i = 0; i < tabSize; ++i) {
+    tab[i] = NULL;
+  }
+  nEntries = 0;
+  lruHead = lruTail = NULL;
+  hits = misses = evictions = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+  refCnt = 1;
+}
+
+SplashGlyphCache::~SplashGlyphCache() {
+  SplashGlyphCacheEntry *entry, *next;
+
+  for (entry = lruHead; entry; entry = next) {
+    next = entry->lruNext;
+    gfree(entry->data);
+    delete entry;
+  }
+  gfree(tab);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void SplashGlyphCache::incRefCnt() {
+#if MULTITHREADED
+  gAtomicIncrement(&refCnt);
+#else
+  ++refCnt;
+#endif
+}
+
+void SplashGlyphCache::decRefCnt() {
+  GBool done;
+
+#if MULTITHREADED
+  done = gAtomicDecrement(&refCnt) == 0;
+#else
+  done = --refCnt == 0;
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+GBool SplashGlyphCache::lookup(SplashGlyphCacheKey *key,
+			       SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *entry;
+  Guint h;
+
+  h = hashKey(key);
+  lockGlyphCache;
+  for (entry = tab[h & (tabSize - 1)]; entry; entry = entry->next) {
+    if (entry->hash == h && keyMatches(&entry->key, key)) {
+      break;
+    }
+  }
+  if (!entry) {
+    ++misses;
+    unlockGlyphCache;
+    return gFalse;
+  }
+  ++hits;
+  ++entry->pinCnt;
+  if (entry != lruHead) {
+    unlinkLRU(entry);
+    linkLRU(entry);
+  }
+  unlockGlyphCache;
+
+  bitmap->x = entry->x;
+  bitmap->y = entry->y;
+  bitmap->w = entry->w;
+  bitmap->h = entry->h;
+  bitmap->aa = key->aa;
+  bitmap->data = entry->data;
+  bitmap->freeData = gFalse;
+  bitmap->cacheEntry = entry;
+  return gTrue;
+}
+
+void SplashGlyphCache::insert(SplashGlyphCacheKey *key,
+			      SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *entry, *entry2;
+  int size;
+
+  if (!bitmap->data) {
+    size = 0;
+  } else if (bitmap->aa) {
+    size = bitmap->w * bitmap->h;
+  } else {
+    size = ((bitmap->w + 7) >> 3) * bitmap->h;
+  }
+  // don't let a single huge glyph flush the whole cache
+  if (size > maxBytes / 8) {
+    return;
+  }
+
+  entry = new SplashGlyphCacheEntry;
+  entry->key = *key;
+  entry->hash = hashKey(key);
+  entry->x = bitmap->x;
+  entry->y = bitmap->y;
+  entry->w = bitmap->w;
+  entry->h = bitmap->h;
+  entry->data = (Guchar *)gmalloc(size);
+  if (size > 0) {
+    memcpy(entry->data, bitmap->data, size);
+  }
+  entry->size = size + (int)sizeof(SplashGlyphCacheEntry);
+  entry->pinCnt = 1;
+
+  lockGlyphCache;
+  // another thread may have rasterized the same glyph in the
+  // meantime -- if so, use its copy
+  for (entry2 = tab[entry->hash & (tabSize - 1)];
+       entry2;
+       entry2 = entry2->next) {
+    if (entry2->hash == entry->hash && keyMatches(&entry2->key, key)) {
+      break;
+    }
+  }
+  if (entry2) {
+    ++entry2->pinCnt;
+    unlockGlyphCache;
+    gfree(entry->data);
+    delete entry;
+    entry = entry2;
+  } else {
+    if (nEntries >= tabSize) {
+      expandTable();
+    }
+    entry->next = tab[entry->hash & (tabSize - 1)];
+    tab[entry->hash & (tabSize - 1)] = entry;
+    linkLRU(entry);
+    ++nEntries;
+    nBytes += entry->size;
+    evict();
+    unlockGlyphCache;
+  }
+
+  if (bitmap->freeData) {
+    gfree(bitmap->data);
+  }
+  bitmap->data = entry->data;
+  bitmap->freeData = gFalse;
+  bitmap->cacheEntry = entry;
+}
+
+void SplashGlyphCache::release(SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *entry;
+
+  if (!(entry = bitmap->cacheEntry)) {
+    return;
+  }
+  lockGlyphCache;
+  if (--entry->pinCnt == 0 && nBytes > maxBytes) {
+    evict();
+  }
+  unlockGlyphCache;
+  bitmap->cacheEntry = NULL;
+}
+
+void SplashGlyphCache::setMaxBytes(int maxBytesA) {
+  lockGlyphCache;
+  maxBytes = maxBytesA;
+  evict();
+  unlockGlyphCache;
+}
+
+unsigned long long SplashGlyphCache::hash(unsigned long long h,
+					  const void *buf, int len) {
+  const Guchar *p;
+  int i;
+
+  p = (const Guchar *)buf;
+  for (i = 0; i < len; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+Guint SplashGlyphCache::hashKey(SplashGlyphCacheKey *key) {
+  unsigned long long h;
+
+  h = hash(hashInit, &key->font, sizeof(key->font));
+  h = hash(h, key->mat, sizeof(key->mat));
+  h = hash(h, &key->c, sizeof(key->c));
+  h = hash(h, &key->xFrac, sizeof(key->xFrac));
+  h = hash(h, &key->yFrac, sizeof(key->yFrac));
+  h = hash(h, &key->aa, sizeof(key->aa));
+  return (Guint)(h ^ (h >> 32));
+}
+
+GBool SplashGlyphCache::keyMatches(SplashGlyphCacheKey *key1,
+				   SplashGlyphCacheKey *key2) {
+  return key1->font == key2->font &&
+         key1->c == key2->c &&
+         key1->xFrac == key2->xFrac && key1->yFrac == key2->yFrac &&
+         key1->aa == key2->aa &&
+         key1->mat[0] == key2->mat[0] && key1->mat[1] == key2->mat[1] &&
+         key1->mat[2] == key2->mat[2] && key1->mat[3] == key2->mat[3];
+}
+
+void SplashGlyphCache::unlinkLRU(SplashGlyphCacheEntry *entry) {
+  if (entry->lruPrev) {
+    entry->lruPrev->lruNext = entry->lruNext;
+  } else {
+    lruHead = entry->lruNext;
+  }
+  if (entry->lruNext) {
+    entry->lruNext->lruPrev = entry->lruPrev;
+  } else {
+    lruTail = entry->lruPrev;
+  }
+}
+
+// Insert <entry> at the head of the LRU list.
+void SplashGlyphCache::linkLRU(SplashGlyphCacheEntry *entry) {
+  entry->lruPrev = NULL;
+  entry->lruNext = lruHead;
+  if (lruHead) {
+    lruHead->lruPrev = entry;
+  } else {
+    lruTail = entry;
+  }
+  lruHead = entry;
+}
+
+// Evict least recently used glyphs until the cache fits in its
+// budget.  Pinned glyphs are skipped -- they will be evicted later,
+// when they are released.  The caller must hold the lock.
+void SplashGlyphCache::evict() {
+  SplashGlyphCacheEntry *entry, *prev, **p;
+
+  for (entry = lruTail; entry && nBytes > maxBytes; entry = prev) {
+    prev = entry->lruPrev;
+    if (entry->pinCnt > 0) {
+      continue;
+    }
+    for (p = &tab[entry->hash & (tabSize - 1)];
+	 *p != entry;
+	 p = &(*p)->next) ;
+    *p = entry->next;
+    unlinkLRU(entry);
+    --nEntries;
+    nBytes -= entry->size;
+    ++evictions;
+    gfree(entry->data);
+    delete entry;
+  }
+}
+
+// Double the number of hash table buckets.  The caller must hold the
+// lock.
+void SplashGlyphCache::expandTable() {
+  SplashGlyphCacheEntry **newTab, *entry, *next;
+  int newTabSize, i, j;
+
+  newTabSize = 2 * tabSize;
+  newTab = (SplashGlyphCacheEntry **)gmallocn(newTabSize,
+					      sizeof(SplashGlyphCacheEntry *));
+  for (i = 0; i < newTabSize; ++i) {
+    newTab[i] = NULL;
+  }
+  for (i = 0; i < tabSize; ++i) {
+    for (entry = tab[i]; entry; entry = next) {
+      next = entry->next;
+      j = entry->hash & (newTabSize - 1);
+      entry->next = newTab[j];
+      newTab[j] = entry;
+    }
+  }
+  gfree(tab);
+  tab = newTab;
+  tabSize = newTabSize;
+}
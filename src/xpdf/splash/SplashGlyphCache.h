@@ -0,0 +1,136 @@
+//========================================================================
+//
+// SplashGlyphCache.h
+//
+//========================================================================
+
+#ifndef SPLASHGLYPHCACHE_H
+#define SPLASHGLYPHCACHE_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#include "SplashTypes.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
+
+struct SplashGlyphBitmap;
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheKey
+//------------------------------------------------------------------------
+
+struct SplashGlyphCacheKey {
+  unsigned long long font;	// font digest (see SplashGlyphCache::hash)
+  SplashCoord mat[4];		// font transform matrix
+  int c;			// char code or glyph ID
+  short xFrac, yFrac;		// subpixel offset
+  GBool aa;			// anti-aliased
+};
+
+//------------------------------------------------------------------------
+// SplashGlyphCacheEntry
+//------------------------------------------------------------------------
+
+struct SplashGlyphCacheEntry {
+  SplashGlyphCacheKey key;
+  Guint hash;			// hash of key
+  int x, y, w, h;		// offset and size of glyph
+  Guchar *data;			// bitmap data (NULL for a glyph that
+				//   couldn't be rasterized)
+  int size;			// size of data and entry, in bytes
+  int pinCnt;			// number of outstanding users of data
+  SplashGlyphCacheEntry *next;	// next entry in hash bucket
+  SplashGlyphCacheEntry *lruPrev, // neighbors in LRU list
+                        *lruNext;
+};
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+// A byte-budgeted cache of rasterized glyphs.  A single cache holds
+// the glyphs of all fonts, and may be shared by any number of
+// SplashFontEngines (e.g., one per band or per document), which can
+// be used from different threads.  Glyphs are evicted in LRU order
+// once the total size of the glyph data (plus per-glyph overhead)
+// exceeds the budget.
+class SplashGlyphCache {
+public:
+
+  SplashGlyphCache(int maxBytesA);
+
+  // Increment the reference count.
+  void incRefCnt();
+
+  // Decrement the reference count.  If the new value is zero, delete
+  // the SplashGlyphCache object.
+  void decRefCnt();
+
+  // Look up a glyph.  On a hit, fills in <bitmap> (pointing into the
+  // cache, with bitmap->cacheEntry set) and returns true.  The glyph
+  // stays valid until it is passed to release().
+  GBool lookup(SplashGlyphCacheKey *key, SplashGlyphBitmap *bitmap);
+
+  // Add a copy of <bitmap> to the cache.  On return, <bitmap> points
+  // into the cache as with lookup(), unless the glyph is too large
+  // to be cached, in which case <bitmap> is left unchanged.  A NULL
+  // bitmap->data records a glyph that couldn't be rasterized.
+  void insert(SplashGlyphCacheKey *key, SplashGlyphBitmap *bitmap);
+
+  // Release a glyph returned by lookup() or insert().
+  void release(SplashGlyphBitmap *bitmap);
+
+  // Change the byte budget, evicting glyphs as needed.
+  void setMaxBytes(int maxBytesA);
+
+  // Statistics.
+  int getMaxBytes() { return maxBytes; }
+  int getNumBytes() { return nBytes; }
+  int getNumGlyphs() { return nEntries; }
+  unsigned long long getHits() { return hits; }
+  unsigned long long getMisses() { return misses; }
+  unsigned long long getEvictions() { return evictions; }
+
+  // Incrementally compute a 64-bit FNV-1a hash.  Start with
+  // <h> = SplashGlyphCache::hashInit.  This is used to identify font
+  // files by their content, so that identical fonts share glyphs
+  // across documents.
+  static const unsigned long long hashInit = 0xcbf29ce484222325ULL;
+  static unsigned long long hash(unsigned long long h,
+				 const void *buf, int len);
+
+private:
+
+  ~SplashGlyphCache();
+
+  Guint hashKey(SplashGlyphCacheKey *key);
+  GBool keyMatches(SplashGlyphCacheKey *key1, SplashGlyphCacheKey *key2);
+  void unlinkLRU(SplashGlyphCacheEntry *entry);
+  void linkLRU(SplashGlyphCacheEntry *entry);
+  void evict();
+  void expandTable();
+
+  int maxBytes;			// byte budget
+  int nBytes;			// total size of glyph data
+  SplashGlyphCacheEntry **tab;	// hash table
+  int tabSize;			// number of buckets (power of 2)
+  int nEntries;			// number of glyphs
+  SplashGlyphCacheEntry *lruHead, // most/least recently used glyphs
+                        *lruTail;
+  unsigned long long hits, misses, evictions;
+
+#if MULTITHREADED
+  GMutex mutex;
+  GAtomicCounter refCnt;
+#else
+  int refCnt;
+#endif
+};
+
+#endif
@@ -72,6 +72,7 @@ SplashState::SplashState(int width, int height, GBool vectorAntialias,
     cmykTransferY[i] = (Guchar)i;
     cmykTransferK[i] = (Guchar)i;
   }
+  identityTransfer = gTrue;
   overprintMask = 0xffffffff;
   next = NULL;
 }
@@ -116,6 +117,7 @@ SplashState::SplashState(int width, int height, GBool vectorAntialias,
     cmykTransferY[i] = (Guchar)i;
     cmykTransferK[i] = (Guchar)i;
   }
+  identityTransfer = gTrue;
   overprintMask = 0xffffffff;
   next = NULL;
 }
@@ -157,6 +159,7 @@ SplashState::SplashState(SplashState *state) {
   memcpy(cmykTransferM, state->cmykTransferM, 256);
   memcpy(cmykTransferY, state->cmykTransferY, 256);
   memcpy(cmykTransferK, state->cmykTransferK, 256);
+  identityTransfer = state->identityTransfer;
   overprintMask = state->overprintMask;
   next = NULL;
 }
@@ -244,10 +247,15 @@ void SplashState::setTransfer(Guchar *red, Guchar *green, Guchar *blue,
   memcpy(rgbTransferG, green, 256);
   memcpy(rgbTransferB, blue, 256);
   memcpy(grayTransfer, gray, 256);
+  identityTransfer = gTrue;
   for (i = 0; i < 256; ++i) {
     cmykTransferC[i] = 255 - rgbTransferR[255 - i];
     cmykTransferM[i] = 255 - rgbTransferG[255 - i];
     cmykTransferY[i] = 255 - rgbTransferB[255 - i];
     cmykTransferK[i] = 255 - grayTransfer[255 - i];
+    if (rgbTransferR[i] != i || rgbTransferG[i] != i ||
+	rgbTransferB[i] != i || grayTransfer[i] != i) {
+      identityTransfer = gFalse;
+    }
   }
 }
@@ -116,6 +116,8 @@ private:
          cmykTransferM[256],
          cmykTransferY[256],
          cmykTransferK[256];
+  GBool identityTransfer;	// all of the transfer functions are
+				//   the identity function
   Guint overprintMask;
 
   SplashState *next;		// used by Splash class
@@ -25,27 +25,555 @@
 
 //------------------------------------------------------------------------
 
+// Scan conversion for getSpan() works one scan line at a time.  Each
+// non-horizontal segment (edge) of the path is clipped to the scan
+// line, and the resulting pieces are accumulated, in 1/256 pixel fixed
+// point, into per-pixel cells (cover and area, see
+// SplashXPathScanCell).  Sweeping the touched cells from left to right
+// gives the signed coverage of each pixel, which is mapped through the
+// fill rule.  Pixels between touched cells have the coverage of the
+// cell to their left, so they are filled in runs.  Edges are kept in
+// an edge table, bucketed by their first scan line, so the active edge
+// list doesn't need to be kept sorted.
+//
+// Accumulating the cells is only exact if the shape value is a linear
+// function of the winding number, i.e., if the winding number is 0 or
+// s (for a single s = +1 or -1) everywhere in the scan line.  That's
+// the normal case for fills, but not for overlapping subpaths (e.g.,
+// the pieces of a wide stroke) or self-intersecting paths, where
+// summing the edges would overestimate the coverage of pixels which
+// contain both winding numbers 1 and 2 (say).  isSimpleScanLine()
+// checks for this, and the other scan lines are handled by
+// getSpanExact(), which applies the fill rule to each x interval
+// between the sorted edges, and adds up trapezoid areas.
+
+#if !HAVE_STD_SORT
+static int cmpInt(const void *p0, const void *p1) {
+  return *(int *)p0 - *(int *)p1;
+}
+#endif
+
+//------------------------------------------------------------------------
+
 #define minVertStep 0.05
 
 //------------------------------------------------------------------------
 
 SplashXPathScanner::SplashXPathScanner(SplashXPath *xPathA, GBool eoA,
 				       int yMinA, int yMaxA) {
+  SplashXPathSeg *seg, *seg0;
+  int n, i;
+
   xPath = xPathA;
   eo = eoA;
   yMin = yMinA;
   yMax = yMaxA;
 
+  // check for a single axis-aligned rectangle
+  isRect = gFalse;
+  rectX0 = rectY0 = rectX1 = rectY1 = 0;
+  seg0 = NULL;
+  n = 0;
+  for (i = 0; i < xPath->length; ++i) {
+    seg = &xPath->segs[i];
+    if (seg->y0 == seg->y1) {
+      continue;
+    }
+    if (seg->x0 != seg->x1 || ++n > 2) {
+      isRect = gFalse;
+      break;
+    }
+    if (n == 1) {
+      seg0 = seg;
+    } else if (seg->y0 == seg0->y0 && seg->y1 == seg0->y1 &&
+	       seg->count == -seg0->count) {
+      isRect = gTrue;
+      if (seg0->x0 < seg->x0) {
+	rectX0 = seg0->x0;
+	rectX1 = seg->x0;
+      } else {
+	rectX0 = seg->x0;
+	rectX1 = seg0->x0;
+      }
+      rectY0 = seg->y0;
+      rectY1 = seg->y1;
+    }
+  }
+
+  // the edge table is built by the first getSpan call
+  edgesInit = gFalse;
+  edges = NULL;
+  nEdges = 0;
+  edgeTable = NULL;
+  edgeTableYMin = 0;
+  edgeTableLength = 0;
+  activeEdges = NULL;
+  nActiveEdges = 0;
+  yNextEdge = xPath->yMin;
+  pieces = NULL;
+  nPieces = 0;
+  cells = NULL;
+  cellsSize = 0;
+  touchedCells = NULL;
+  nTouchedCells = 0;
+  spanX0 = spanX1 = 0;
+
   activeSegs = new GList();
   nextSeg = 0;
   yNext = xPath->yMin;
-  }
+}
 
 SplashXPathScanner::~SplashXPathScanner() {
+  gfree(edges);
+  gfree(edgeTable);
+  gfree(activeEdges);
+  gfree(pieces);
+  gfree(cells);
+  gfree(touchedCells);
   delete activeSegs;
 }
 
+void SplashXPathScanner::initEdges() {
+  SplashXPathSeg *seg;
+  SplashXPathScanEdge *edge;
+  int yMinE, yMaxE, i, j;
+
+  edges = (SplashXPathScanEdge *)gmallocn(xPath->length,
+					  sizeof(SplashXPathScanEdge));
+  nEdges = 0;
+  yMinE = yMaxE = 0;
+  for (i = 0; i < xPath->length; ++i) {
+    seg = &xPath->segs[i];
+    if (seg->y0 == seg->y1) {
+      continue;
+    }
+    edge = &edges[nEdges++];
+    edge->x0 = seg->x0;
+    edge->y0 = seg->y0;
+    edge->x1 = seg->x1;
+    edge->y1 = seg->y1;
+    edge->dxdy = seg->dxdy;
+    edge->count = seg->count;
+    j = splashFloor(seg->y0);
+    if (nEdges == 1 || j < yMinE) {
+      yMinE = j;
+    }
+    if (nEdges == 1 || j > yMaxE) {
+      yMaxE = j;
+    }
+  }
+
+  // the segs are sorted by y0, so inserting the edges in reverse order
+  // leaves each bucket sorted as well
+  edgeTableYMin = yMinE;
+  edgeTableLength = nEdges ? yMaxE - yMinE + 1 : 0;
+  edgeTable = (int *)gmallocn(edgeTableLength > 0 ? edgeTableLength : 1,
+			      sizeof(int));
+  for (i = 0; i < edgeTableLength; ++i) {
+    edgeTable[i] = -1;
+  }
+  for (i = nEdges - 1; i >= 0; --i) {
+    j = splashFloor(edges[i].y0) - edgeTableYMin;
+    edges[i].next = edgeTable[j];
+    edgeTable[j] = i;
+  }
+
+  activeEdges = (int *)gmallocn(nEdges > 0 ? nEdges : 1, sizeof(int));
+  nActiveEdges = 0;
+  pieces = (SplashXPathScanPiece *)gmallocn(nEdges > 0 ? nEdges : 1,
+					    sizeof(SplashXPathScanPiece));
+  nPieces = 0;
+  edgesInit = gTrue;
+}
+
+// Set up the active edge list for scan line <y>, i.e., all edges with
+// y0 < y + 1 and y1 > y.
+void SplashXPathScanner::resetActiveEdges(int y) {
+  int yy, i;
+
+  nActiveEdges = 0;
+  for (yy = edgeTableYMin; yy <= y && yy < edgeTableYMin + edgeTableLength;
+       ++yy) {
+    for (i = edgeTable[yy - edgeTableYMin]; i >= 0; i = edges[i].next) {
+      if (edges[i].y1 > y) {
+	activeEdges[nActiveEdges++] = i;
+      }
+    }
+  }
+}
+
 void SplashXPathScanner::getSpan(Guchar *line, int y, int x0, int x1) {
+  SplashXPathScanEdge *edge;
+  SplashXPathScanPiece *piece;
+  SplashCoord yy0, yy1;
+  int i, j;
+
+  if (isRect) {
+    getRectSpan(line, y, x0, x1);
+    return;
+  }
+
+  if (!edgesInit) {
+    initEdges();
+  }
+
+  //--- update the active edge list
+  if (yNextEdge != y) {
+    resetActiveEdges(y);
+  } else if (y >= edgeTableYMin && y < edgeTableYMin + edgeTableLength) {
+    for (i = edgeTable[y - edgeTableYMin]; i >= 0; i = edges[i].next) {
+      activeEdges[nActiveEdges++] = i;
+    }
+  }
+  yNextEdge = y + 1;
+
+  //--- clip the active edges to this scan line, and remove the edges
+  //--- which end in it
+  yy0 = y;
+  yy1 = y + 1;
+  nPieces = 0;
+  j = 0;
+  for (i = 0; i < nActiveEdges; ++i) {
+    edge = &edges[activeEdges[i]];
+    piece = &pieces[nPieces];
+    if (edge->y0 > yy0) {
+      piece->ya = edge->y0 - yy0;
+      piece->xa = edge->x0;
+    } else {
+      piece->ya = 0;
+      piece->xa = edge->x0 + (yy0 - edge->y0) * edge->dxdy;
+    }
+    if (edge->y1 < yy1) {
+      piece->yb = edge->y1 - yy0;
+      piece->xb = edge->x1;
+    } else {
+      piece->yb = 1;
+      piece->xb = edge->x0 + (yy1 - edge->y0) * edge->dxdy;
+    }
+    if (piece->ya < piece->yb) {
+      if (piece->xa < piece->xb) {
+	piece->xMin = piece->xa;
+	piece->xMax = piece->xb;
+      } else {
+	piece->xMin = piece->xb;
+	piece->xMax = piece->xa;
+      }
+      piece->count = edge->count;
+      ++nPieces;
+    }
+    if (edge->y1 > yy1) {
+      activeEdges[j++] = activeEdges[i];
+    }
+  }
+  nActiveEdges = j;
+
+  if (!isSimpleScanLine()) {
+    getSpanExact(line, y, x0, x1);
+    return;
+  }
+
+  //--- set up the cells
+  spanX0 = x0;
+  spanX1 = x1;
+  if (x1 - x0 + 2 > cellsSize) {
+    gfree(cells);
+    gfree(touchedCells);
+    cellsSize = x1 - x0 + 2;
+    cells = (SplashXPathScanCell *)gmallocn(cellsSize,
+					    sizeof(SplashXPathScanCell));
+    memset(cells, 0, cellsSize * sizeof(SplashXPathScanCell));
+    touchedCells = (int *)gmallocn(cellsSize, sizeof(int));
+  }
+  nTouchedCells = 0;
+
+  //--- accumulate the pieces
+  for (i = 0; i < nPieces; ++i) {
+    piece = &pieces[i];
+    addEdgePiece(piece->xa, piece->ya, piece->xb, piece->yb, piece->count);
+  }
+
+  emitCells(line, x0, x1);
+}
+
+// Returns true if the winding number is 0 or s (for a single s = +1
+// or -1) everywhere in the current scan line -- up to regions smaller
+// than 1/32 of the scan line height, which is about the accuracy of
+// getSpanExact, too.  This sorts the pieces by xMin.
+GBool SplashXPathScanner::isSimpleScanLine() {
+  SplashXPathScanPiece *piece0, *piece1;
+  SplashXPathScanPiece t;
+  SplashCoord xMaxPrev;
+  Guint wMask, yMask;
+  int s, k0, k1, i, j;
+
+  if (nPieces < 2) {
+    return gTrue;
+  }
+
+  if (nPieces <= 16) {
+    for (i = 1; i < nPieces; ++i) {
+      t = pieces[i];
+      for (j = i; j > 0 && pieces[j - 1].xMin > t.xMin; --j) {
+	pieces[j] = pieces[j - 1];
+      }
+      pieces[j] = t;
+    }
+  } else {
+#if HAVE_STD_SORT
+    std::sort(pieces, pieces + nPieces, SplashXPathScanPiece::cmpXMin);
+#else
+    qsort(pieces, nPieces, sizeof(SplashXPathScanPiece),
+	  &SplashXPathScanPiece::cmpXMin);
+#endif
+  }
+
+  // if no two pieces which overlap in y also overlap in x, the order of
+  // the pieces at any y is the xMin order
+  xMaxPrev = pieces[0].xMax;
+  for (i = 1; i < nPieces; ++i) {
+    piece1 = &pieces[i];
+    if (piece1->xMin < xMaxPrev) {
+      for (j = 0; j < i; ++j) {
+	piece0 = &pieces[j];
+	if (piece0->xMax > piece1->xMin &&
+	    piece0->ya < piece1->yb && piece1->ya < piece0->yb) {
+	  return gFalse;
+	}
+      }
+    }
+    if (piece1->xMax > xMaxPrev) {
+      xMaxPrev = piece1->xMax;
+    }
+  }
+
+  // check the winding numbers at 32 sample y values, in x order: bit k
+  // of <wMask> is set if the winding number at y = (k + 0.5) / 32 is s
+  // (and clear if it is 0)
+  s = 0;
+  wMask = 0;
+  for (i = 0; i < nPieces; ++i) {
+    piece0 = &pieces[i];
+    k0 = (int)(piece0->ya * 32 + 0.5);
+    k1 = (int)(piece0->yb * 32 + 0.5);
+    if (k0 >= k1) {
+      continue;
+    }
+    yMask = (k1 >= 32 ? 0xffffffff : (1U << k1) - 1) & ~((1U << k0) - 1);
+    if (!s) {
+      s = piece0->count;
+    }
+    if (piece0->count == s) {
+      if (wMask & yMask) {
+	return gFalse;
+      }
+      wMask |= yMask;
+    } else {
+      if ((wMask & yMask) != yMask) {
+	return gFalse;
+      }
+      wMask &= ~yMask;
+    }
+  }
+  return gTrue;
+}
+
+// Add the piece of an edge from (<xa>, <ya>) to (<xb>, <yb>), with y
+// relative to the top of the current scan line.  The part to the left
+// of the span is replaced by a vertical line at its left side (which
+// covers the span in the same way), and the part to the right of the
+// span is dropped.
+void SplashXPathScanner::addEdgePiece(SplashCoord xa, SplashCoord ya,
+				      SplashCoord xb, SplashCoord yb,
+				      int count) {
+  SplashCoord xLeft, xRight, yc;
+
+  xLeft = spanX0;
+  xRight = spanX1 + 1;
+  if (xa >= xRight && xb >= xRight) {
+    return;
+  }
+  if (xa <= xLeft && xb <= xLeft) {
+    addPiece(0, splashRound(ya * 256), 0, splashRound(yb * 256), count);
+    return;
+  }
+  if ((xa < xLeft) != (xb < xLeft)) {
+    yc = ya + (xLeft - xa) * (yb - ya) / (xb - xa);
+    addEdgePiece(xa, ya, xLeft, yc, count);
+    addEdgePiece(xLeft, yc, xb, yb, count);
+    return;
+  }
+  if ((xa > xRight) != (xb > xRight)) {
+    yc = ya + (xRight - xa) * (yb - ya) / (xb - xa);
+    addEdgePiece(xa, ya, xRight, yc, count);
+    addEdgePiece(xRight, yc, xb, yb, count);
+    return;
+  }
+  addPiece(splashRound((xa - xLeft) * 256), splashRound(ya * 256),
+	   splashRound((xb - xLeft) * 256), splashRound(yb * 256), count);
+}
+
+// Add a piece of an edge, from (<xa>, <ya>) to (<xb>, <yb>), in 1/256
+// pixel units, with x relative to the left side of the span and y
+// relative to the top of the current scan line.  The piece is split
+// at each vertical pixel boundary it crosses.
+void SplashXPathScanner::addPiece(int xa, int ya, int xb, int yb,
+				  int count) {
+  int cx, cxb, dx, dy, xPrev, yPrev, xBound, yBound, d;
+
+  if (ya == yb) {
+    return;
+  }
+  cx = xa >> 8;
+  cxb = xb >> 8;
+  if (cx == cxb) {
+    d = count * (yb - ya);
+    addCell(cx, d, d * ((xa & 255) + (xb & 255)));
+    return;
+  }
+  dx = xb - xa;
+  dy = yb - ya;
+  xPrev = xa;
+  yPrev = ya;
+  while (cx != cxb) {
+    xBound = dx > 0 ? (cx + 1) << 8 : cx << 8;
+    yBound = ya + (int)(((long long)(xBound - xa) * dy) / dx);
+    d = count * (yBound - yPrev);
+    addCell(cx, d, d * ((xPrev - (cx << 8)) + (xBound - (cx << 8))));
+    xPrev = xBound;
+    yPrev = yBound;
+    cx += dx > 0 ? 1 : -1;
+  }
+  d = count * (yb - yPrev);
+  addCell(cx, d, d * ((xPrev - (cx << 8)) + (xb & 255)));
+}
+
+inline void SplashXPathScanner::addCell(int x, int cover, int area) {
+  SplashXPathScanCell *cell;
+
+  cell = &cells[x];
+  if (!cell->touched) {
+    cell->touched = gTrue;
+    touchedCells[nTouchedCells++] = x;
+  }
+  cell->cover += cover;
+  cell->area += area;
+}
+
+// Map a signed coverage value (full coverage is 1 << 17) to a shape
+// value, using the fill rule.
+inline Guchar SplashXPathScanner::coverageToShape(int a) {
+  if (a < 0) {
+    a = -a;
+  }
+  if (eo) {
+    a &= (1 << 18) - 1;
+    if (a > (1 << 17)) {
+      a = (1 << 18) - a;
+    }
+  } else if (a > (1 << 17)) {
+    a = 1 << 17;
+  }
+  return (Guchar)((a * 255 + (1 << 16)) >> 17);
+}
+
+// Convert the accumulated cells to shape values in line[x0 .. x1], and
+// clear the cells.
+void SplashXPathScanner::emitCells(Guchar *line, int x0, int x1) {
+  SplashXPathScanCell *cell;
+  int cover, a, x, xx, t, i, j;
+
+  // sort the touched cells (there are usually only a few of them)
+  if (nTouchedCells <= 16) {
+    for (i = 1; i < nTouchedCells; ++i) {
+      t = touchedCells[i];
+      for (j = i; j > 0 && touchedCells[j - 1] > t; --j) {
+	touchedCells[j] = touchedCells[j - 1];
+      }
+      touchedCells[j] = t;
+    }
+  } else {
+#if HAVE_STD_SORT
+    std::sort(touchedCells, touchedCells + nTouchedCells);
+#else
+    qsort(touchedCells, nTouchedCells, sizeof(int), &cmpInt);
+#endif
+  }
+
+  // the coverage of a pixel is 512 * (sum of the covers up to and
+  // including this pixel) - area, in 1/(512*256) units
+  cover = 0;
+  x = 0;
+  for (i = 0; i < nTouchedCells; ++i) {
+    xx = touchedCells[i];
+    cell = &cells[xx];
+    if (xx > x1 - x0) {
+      // the cell to the right of the span only gets the part of the
+      // edges exactly on the right side of the span
+      cell->cover = cell->area = 0;
+      cell->touched = gFalse;
+      continue;
+    }
+    if (xx > x) {
+      memset(line + x0 + x, cover ? coverageToShape(cover << 9) : 0, xx - x);
+    }
+    cover += cell->cover;
+    a = (cover << 9) - cell->area;
+    line[x0 + xx] = a ? coverageToShape(a) : 0;
+    cell->cover = cell->area = 0;
+    cell->touched = gFalse;
+    x = xx + 1;
+  }
+  if (x <= x1 - x0) {
+    memset(line + x0 + x, cover ? coverageToShape(cover << 9) : 0,
+	   x1 - x0 + 1 - x);
+  }
+  nTouchedCells = 0;
+}
+
+// Special case for a single axis-aligned rectangle -- this computes
+// the same values as the general case, without the edge and cell
+// overhead.
+void SplashXPathScanner::getRectSpan(Guchar *line, int y, int x0, int x1) {
+  SplashCoord ya, yb, dy, xa, xb, a;
+  int xx0, xx1, x, t;
+
+  memset(line + x0, 0, x1 - x0 + 1);
+  ya = rectY0 > y ? rectY0 : (SplashCoord)y;
+  yb = rectY1 < y + 1 ? rectY1 : (SplashCoord)(y + 1);
+  if (ya >= yb) {
+    return;
+  }
+  dy = yb - ya;
+  xa = rectX0;
+  xb = rectX1;
+  xx0 = splashFloor(xa);
+  xx1 = splashFloor(xb);
+  if (xx0 == xx1) {
+    if (xx0 >= x0 && xx0 <= x1) {
+      t = splashRound((xb - xa) * dy * 255);
+      line[xx0] = t < 0 ? 0 : t > 255 ? 255 : t;
+    }
+    return;
+  }
+  if (xx0 >= x0 && xx0 <= x1) {
+    t = splashRound(((SplashCoord)1 - (xa - xx0)) * dy * 255);
+    line[xx0] = t < 0 ? 0 : t > 255 ? 255 : t;
+  }
+  t = splashRound(dy * 255);
+  t = t < 0 ? 0 : t > 255 ? 255 : t;
+  for (x = xx0 + 1 < x0 ? x0 : xx0 + 1; x <= xx1 - 1 && x <= x1; ++x) {
+    line[x] = (Guchar)t;
+  }
+  if (xx1 >= x0 && xx1 <= x1) {
+    a = (xb - xx1) * dy;
+    t = splashRound(a * 255);
+    line[xx1] = t < 0 ? 0 : t > 255 ? 255 : t;
+  }
+}
+
+// Compute the shape values for a scan line which isn't simple (see
+// isSimpleScanLine).
+void SplashXPathScanner::getSpanExact(Guchar *line, int y, int x0, int x1) {
   SplashXPathSeg *seg, *seg0;
   SplashCoord y0, y1, y1p;
   GBool intersect, last;
@@ -19,6 +19,63 @@
 
 class GList;
 class SplashXPath;
+struct SplashXPathSeg;
+
+//------------------------------------------------------------------------
+// SplashXPathScanEdge
+//------------------------------------------------------------------------
+
+// Non-horizontal segment of the path, used by getSpan().
+struct SplashXPathScanEdge {
+  SplashCoord x0, y0;		// first endpoint (y0 < y1)
+  SplashCoord x1, y1;		// second endpoint
+  SplashCoord dxdy;		// slope: delta-x / delta-y
+  int count;			// EO/NZWN counter increment
+  int next;			// next edge in the same edge table
+				//   bucket, or -1
+};
+
+//------------------------------------------------------------------------
+// SplashXPathScanPiece
+//------------------------------------------------------------------------
+
+// The part of an edge inside the current scan line, with y relative to
+// the top of the scan line.
+struct SplashXPathScanPiece {
+  SplashCoord xa, ya;		// top endpoint (ya < yb)
+  SplashCoord xb, yb;		// bottom endpoint
+  SplashCoord xMin, xMax;	// x range
+  int count;			// EO/NZWN counter increment
+
+#if HAVE_STD_SORT
+  static bool cmpXMin(const SplashXPathScanPiece &piece0,
+		      const SplashXPathScanPiece &piece1) {
+    return piece0.xMin < piece1.xMin;
+  }
+#else
+  static int cmpXMin(const void *piece0, const void *piece1) {
+    SplashCoord cmp;
+
+    cmp = ((SplashXPathScanPiece *)piece0)->xMin
+          - ((SplashXPathScanPiece *)piece1)->xMin;
+    return (cmp > 0) ? 1 : (cmp < 0) ? -1 : 0;
+  }
+#endif
+};
+
+//------------------------------------------------------------------------
+// SplashXPathScanCell
+//------------------------------------------------------------------------
+
+// Coverage accumulated in one pixel of the current scan line: <cover>
+// is the signed height (in 1/256 pixel units) of the edges crossing
+// the pixel, and <area> is the signed sum of height * (x at entry + x
+// at exit), with x relative to the left side of the pixel.
+struct SplashXPathScanCell {
+  int cover;
+  int area;
+  GBool touched;
+};
 
 //------------------------------------------------------------------------
 // SplashXPathScanner
@@ -42,8 +99,25 @@ public:
   // for all pixels which include non-zero area inside the path.
   void getSpanBinary(Guchar *line, int y, int x0, int x1);
 
+  // Like getSpan(), but always computes the exact trapezoid areas of
+  // the path in the scan line.  getSpan() uses this for scan lines
+  // which can't be handled with coverage cells (see
+  // isSimpleScanLine).  This is slower, and is public only as a
+  // reference for checks.
+  void getSpanExact(Guchar *line, int y, int x0, int x1);
+
 private:
 
+  void initEdges();
+  void resetActiveEdges(int y);
+  GBool isSimpleScanLine();
+  void addEdgePiece(SplashCoord xa, SplashCoord ya,
+		    SplashCoord xb, SplashCoord yb, int count);
+  void addPiece(int xa, int ya, int xb, int yb, int count);
+  inline void addCell(int x, int cover, int area);
+  inline Guchar coverageToShape(int a);
+  void emitCells(Guchar *line, int x0, int x1);
+  void getRectSpan(Guchar *line, int y, int x0, int x1);
   inline void addArea(Guchar *line, int x, SplashCoord a);
   void drawTrapezoid(Guchar *line, int xMin, int xMax,
 		     SplashCoord y0, SplashCoord y1,
@@ -67,6 +141,34 @@ private:
   GBool eo;
   int yMin, yMax;
 
+  //--- getSpan
+
+  GBool isRect;			// the path is a single axis-aligned
+				//   rectangle (rectX0, rectY0) -
+				//   (rectX1, rectY1)
+  SplashCoord rectX0, rectY0, rectX1, rectY1;
+
+  GBool edgesInit;		// set when the edge table is built
+  SplashXPathScanEdge *edges;	// non-horizontal segments
+  int nEdges;
+  int *edgeTable;		// edgeTable[y - edgeTableYMin] = first
+				//   edge with splashFloor(y0) == y
+  int edgeTableYMin, edgeTableLength;
+  int *activeEdges;		// indexes of edges which intersect the
+  int nActiveEdges;		//   current scan line
+  int yNextEdge;		// next y value for getSpan
+  SplashXPathScanPiece *pieces;	// pieces of the active edges in the
+  int nPieces;			//   current scan line
+
+  SplashXPathScanCell *cells;	// sparse coverage accumulation buffer,
+				//   indexed by x - spanX0
+  int cellsSize;
+  int *touchedCells;		// indexes of the non-empty cells
+  int nTouchedCells;
+  int spanX0, spanX1;		// x range of the current getSpan call
+
+  //--- getSpanExact, getSpanBinary
+
   GList *activeSegs;		// [SplashXPathSeg]
   int nextSeg;
   int yNext;
@@ -84,9 +84,10 @@ private:
   int wMode;			// writing mode (0=horizontal, 1=vertical)
   CMapVectorEntry *vector;	// vector for first byte (NULL for
 				//   identity CMap)
-  int refCnt;
 #if MULTITHREADED
-  GMutex mutex;
+  GAtomicCounter refCnt;
+#else
+  int refCnt;
 #endif
 };
 
@@ -106,6 +107,12 @@ public:
   // on failure.
   CMap *getCMap(GString *collection, GString *cMapName);
 
+  // Look up an already cached CMap without parsing or reordering the
+  // cache, so it is safe to call with only a read lock held.
+  // Increments the reference count of the returned CMap.  Returns
+  // NULL if it is not in the cache.
+  CMap *findCMap(GString *collection, GString *cMapName);
+
 private:
 
   CMap *cache[cMapCacheSize];
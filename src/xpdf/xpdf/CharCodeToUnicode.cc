@@ -145,7 +145,7 @@ CharCodeToUnicode *CharCodeToUnicode::parseUnicodeToUnicode(
   CharCodeToUnicodeString *sMapA;
   CharCode size, oldSize, len, sMapSizeA, sMapLenA;
   char buf[256];
-  char *tok;
+  char *tok, *tokPtr;
   Unicode u0;
   Unicode uBuf[maxUnicodeString];
   CharCodeToUnicode *ctu;
@@ -167,7 +167,7 @@ CharCodeToUnicode *CharCodeToUnicode::parseUnicodeToUnicode(
   line = 0;
   while (getLine(buf, sizeof(buf), f)) {
     ++line;
-    if (!(tok = strtok(buf, " \t\r\n")) ||
+    if (!(tok = strtok_r(buf, " \t\r\n", &tokPtr)) ||
 	!parseHex(tok, (int)strlen(tok), &u0)) {
       error(errSyntaxWarning, -1,
 	    "Bad line ({0:d}) in unicodeToUnicode file '{1:t}'",
@@ -176,7 +176,7 @@ CharCodeToUnicode *CharCodeToUnicode::parseUnicodeToUnicode(
     }
     n = 0;
     while (n < maxUnicodeString) {
-      if (!(tok = strtok(NULL, " \t\r\n"))) {
+      if (!(tok = strtok_r(NULL, " \t\r\n", &tokPtr))) {
 	break;
       }
       if (!parseHex(tok, (int)strlen(tok), &uBuf[n])) {
@@ -434,9 +434,6 @@ CharCodeToUnicode::CharCodeToUnicode() {
   sMap = NULL;
   sMapLen = sMapSize = 0;
   refCnt = 1;
-#if MULTITHREADED
-  gInitMutex(&mutex);
-#endif
 }
 
 CharCodeToUnicode::CharCodeToUnicode(GString *tagA) {
@@ -451,9 +448,6 @@ CharCodeToUnicode::CharCodeToUnicode(GString *tagA) {
   sMap = NULL;
   sMapLen = sMapSize = 0;
   refCnt = 1;
-#if MULTITHREADED
-  gInitMutex(&mutex);
-#endif
 }
 
 CharCodeToUnicode::CharCodeToUnicode(GString *tagA, Unicode *mapA,
@@ -472,9 +466,6 @@ CharCodeToUnicode::CharCodeToUnicode(GString *tagA, Unicode *mapA,
   sMapLen = sMapLenA;
   sMapSize = sMapSizeA;
   refCnt = 1;
-#if MULTITHREADED
-  gInitMutex(&mutex);
-#endif
 }
 
 CharCodeToUnicode::~CharCodeToUnicode() {
@@ -483,18 +474,13 @@ CharCodeToUnicode::~CharCodeToUnicode() {
   }
   gfree(map);
     gfree(sMap);
-#if MULTITHREADED
-  gDestroyMutex(&mutex);
-#endif
 }
 
 void CharCodeToUnicode::incRefCnt() {
 #if MULTITHREADED
-  gLockMutex(&mutex);
-#endif
+  gAtomicIncrement(&refCnt);
+#else
   ++refCnt;
-#if MULTITHREADED
-  gUnlockMutex(&mutex);
 #endif
 }
 
@@ -502,11 +488,9 @@ void CharCodeToUnicode::decRefCnt() {
   GBool done;
 
 #if MULTITHREADED
-  gLockMutex(&mutex);
-#endif
+  done = gAtomicDecrement(&refCnt) == 0;
+#else
   done = --refCnt == 0;
-#if MULTITHREADED
-  gUnlockMutex(&mutex);
 #endif
   if (done) {
     delete this;
@@ -16,9 +16,21 @@
 #include "gmem.h"
 #include "Decrypt.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_AESNI 1
+#  include <wmmintrin.h>
+#else
+#  define HAVE_AESNI 0
+#endif
+
 static void aes256KeyExpansion(DecryptAES256State *s,
 			       Guchar *objKey, int objKeyLen);
 static void aes256DecryptBlock(DecryptAES256State *s, Guchar *in, GBool last);
+static void aesDecryptCBC(Guint *w, int nRounds, Guchar *cbc,
+			  Guchar *in, Guchar *out, int nBlocks);
+static void aesRemovePadding(Guchar *buf, int *bufIdx, GBool last);
+static inline void rc4DecryptBlock(Guchar *state, Guchar *x, Guchar *y,
+				   Guchar *blk, int len);
 static void sha256(Guchar *msg, int msgLen, Guchar *hash);
 static void sha384(Guchar *msg, int msgLen, Guchar *hash);
 static void sha512(Guchar *msg, int msgLen, Guchar *hash);
@@ -492,6 +504,86 @@ int DecryptStream::lookChar() {
   return c;
 }
 
+int DecryptStream::getBlock(char *blk, int size) {
+  int n;
+
+  n = 0;
+  switch (algo) {
+  case cryptRC4:
+    if (size > 0 && state.rc4.buf != EOF) {
+      blk[n++] = (char)state.rc4.buf;
+      state.rc4.buf = EOF;
+    }
+    if (n < size) {
+      int m = str->getBlock(blk + n, size - n);
+      rc4DecryptBlock(state.rc4.state, &state.rc4.x, &state.rc4.y,
+		      (Guchar *)blk + n, m);
+      n += m;
+    }
+    break;
+  case cryptAES:
+    n = getAESBlock(state.aes.w, 10, state.aes.cbc,
+		    state.aes.buf, &state.aes.bufIdx, blk, size);
+    break;
+  case cryptAES256:
+    n = getAESBlock(state.aes256.w, 14, state.aes256.cbc,
+		    state.aes256.buf, &state.aes256.bufIdx, blk, size);
+    break;
+  }
+  return n;
+}
+
+// Whole blocks are read and decrypted in place in the caller's
+// buffer.  The last block of the stream carries the padding, so it
+// always goes through <buf> the same way as in getChar().
+int DecryptStream::getAESBlock(Guint *w, int nRounds, Guchar *cbc,
+			       Guchar *buf, int *bufIdx, char *blk, int size) {
+  Guchar in[16];
+  int n, m, nBlocks, nFull;
+  GBool last;
+
+  n = 0;
+  while (n < size) {
+    if (*bufIdx < 16) {
+      m = 16 - *bufIdx;
+      if (m > size - n) {
+	m = size - n;
+      }
+      memcpy(blk + n, buf + *bufIdx, m);
+      *bufIdx += m;
+      n += m;
+      continue;
+    }
+    nBlocks = (size - n) / 16;
+    if (nBlocks == 0) {
+      if (str->getBlock((char *)in, 16) != 16) {
+	break;
+      }
+      aesDecryptCBC(w, nRounds, cbc, in, buf, 1);
+      aesRemovePadding(buf, bufIdx, str->lookChar() == EOF);
+      continue;
+    }
+    m = str->getBlock(blk + n, 16 * nBlocks);
+    nFull = m / 16;
+    last = (m & 15) == 0 && str->lookChar() == EOF;
+    if (nFull > 0 && last) {
+      aesDecryptCBC(w, nRounds, cbc, (Guchar *)blk + n, (Guchar *)blk + n,
+		    nFull - 1);
+      n += 16 * (nFull - 1);
+      aesDecryptCBC(w, nRounds, cbc, (Guchar *)blk + n, buf, 1);
+      aesRemovePadding(buf, bufIdx, gTrue);
+    } else {
+      aesDecryptCBC(w, nRounds, cbc, (Guchar *)blk + n, (Guchar *)blk + n,
+		    nFull);
+      n += 16 * nFull;
+      if (nFull < nBlocks) {
+	break;
+      }
+    }
+  }
+  return n;
+}
+
 GBool DecryptStream::isBinary(GBool last) {
   return str->isBinary(last);
 }
@@ -529,6 +621,26 @@ Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c) {
   return c ^ state[(tx + ty) % 256];
 }
 
+static inline void rc4DecryptBlock(Guchar *state, Guchar *x, Guchar *y,
+				   Guchar *blk, int len) {
+  Guchar x1, y1, tx, ty;
+  int i;
+
+  x1 = *x;
+  y1 = *y;
+  for (i = 0; i < len; ++i) {
+    x1 = (Guchar)(x1 + 1);
+    tx = state[x1];
+    y1 = (Guchar)(y1 + tx);
+    ty = state[y1];
+    state[x1] = ty;
+    state[y1] = tx;
+    blk[i] ^= state[(Guchar)(tx + ty)];
+  }
+  *x = x1;
+  *y = y1;
+}
+
 //------------------------------------------------------------------------
 // AES decryption
 //------------------------------------------------------------------------
@@ -604,14 +716,6 @@ static inline void subBytes(Guchar *state) {
   }
 }
 
-static inline void invSubBytes(Guchar *state) {
-  int i;
-
-  for (i = 0; i < 16; ++i) {
-    state[i] = invSbox[state[i]];
-  }
-}
-
 static inline void shiftRows(Guchar *state) {
   Guchar t;
 
@@ -635,29 +739,6 @@ static inline void shiftRows(Guchar *state) {
   state[12] = t;
 }
 
-static inline void invShiftRows(Guchar *state) {
-  Guchar t;
-
-  t = state[7];
-  state[7] = state[6];
-  state[6] = state[5];
-  state[5] = state[4];
-  state[4] = t;
-
-  t = state[8];
-  state[8] = state[10];
-  state[10] = t;
-  t = state[9];
-  state[9] = state[11];
-  state[11] = t;
-
-  t = state[12];
-  state[12] = state[13];
-  state[13] = state[14];
-  state[14] = state[15];
-  state[15] = t;
-}
-
 // {02} \cdot s
 static inline Guchar mul02(Guchar s) {
   Guchar s2;
@@ -730,22 +811,6 @@ static inline void mixColumns(Guchar *state) {
   }
 }
 
-static inline void invMixColumns(Guchar *state) {
-  int c;
-  Guchar s0, s1, s2, s3;
-
-  for (c = 0; c < 4; ++c) {
-    s0 = state[c];
-    s1 = state[4+c];
-    s2 = state[8+c];
-    s3 = state[12+c];
-    state[c] =    mul0e(s0) ^ mul0b(s1) ^ mul0d(s2) ^ mul09(s3);
-    state[4+c] =  mul09(s0) ^ mul0e(s1) ^ mul0b(s2) ^ mul0d(s3);
-    state[8+c] =  mul0d(s0) ^ mul09(s1) ^ mul0e(s2) ^ mul0b(s3);
-    state[12+c] = mul0b(s0) ^ mul0d(s1) ^ mul09(s2) ^ mul0e(s3);
-  }
-}
-
 static inline void invMixColumnsW(Guint *w) {
   int c;
   Guchar s0, s1, s2, s3;
@@ -773,6 +838,212 @@ static inline void addRoundKey(Guchar *state, Guint *w) {
   }
 }
 
+//------------------------------------------------------------------------
+// AES CBC decryption core
+//
+// The key expansion stores the decryption round keys for the
+// equivalent inverse cipher (rounds 1 .. nRounds-1 already went
+// through invMixColumnsW), which is the layout needed both by the
+// T-table code and by the AES-NI aesdec instruction.
+//------------------------------------------------------------------------
+
+struct AESDecryptTables {
+  AESDecryptTables();
+
+  // td0[x] is the invMixColumns column for invSbox[x] in row 0,
+  // td1..td3 are the same column rotated for rows 1..3
+  Guint td0[256], td1[256], td2[256], td3[256];
+};
+
+AESDecryptTables::AESDecryptTables() {
+  Guint t;
+  Guchar s;
+  int i;
+
+  for (i = 0; i < 256; ++i) {
+    s = invSbox[i];
+    t = ((Guint)mul0e(s) << 24) | ((Guint)mul09(s) << 16)
+        | ((Guint)mul0d(s) << 8) | (Guint)mul0b(s);
+    td0[i] = t;
+    td1[i] = (t >> 8) | (t << 24);
+    td2[i] = (t >> 16) | (t << 16);
+    td3[i] = (t >> 24) | (t << 8);
+  }
+}
+
+static const AESDecryptTables aesTables;
+
+static void aesDecryptCBCTables(Guint *w, int nRounds, Guchar *cbc,
+				Guchar *in, Guchar *out, int nBlocks) {
+  const Guint *td0 = aesTables.td0, *td1 = aesTables.td1;
+  const Guint *td2 = aesTables.td2, *td3 = aesTables.td3;
+  Guint iv0, iv1, iv2, iv3, c0, c1, c2, c3;
+  Guint s0, s1, s2, s3, t0, t1, t2, t3;
+  Guint *rk;
+  int i, round;
+
+  iv0 = (cbc[0] << 24) | (cbc[1] << 16) | (cbc[2] << 8) | cbc[3];
+  iv1 = (cbc[4] << 24) | (cbc[5] << 16) | (cbc[6] << 8) | cbc[7];
+  iv2 = (cbc[8] << 24) | (cbc[9] << 16) | (cbc[10] << 8) | cbc[11];
+  iv3 = (cbc[12] << 24) | (cbc[13] << 16) | (cbc[14] << 8) | cbc[15];
+
+  for (i = 0; i < nBlocks; ++i, in += 16, out += 16) {
+    c0 = (in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3];
+    c1 = (in[4] << 24) | (in[5] << 16) | (in[6] << 8) | in[7];
+    c2 = (in[8] << 24) | (in[9] << 16) | (in[10] << 8) | in[11];
+    c3 = (in[12] << 24) | (in[13] << 16) | (in[14] << 8) | in[15];
+
+    // round 0
+    rk = &w[nRounds * 4];
+    s0 = c0 ^ rk[0];
+    s1 = c1 ^ rk[1];
+    s2 = c2 ^ rk[2];
+    s3 = c3 ^ rk[3];
+
+    // rounds nRounds-1 .. 1: invShiftRows + invSubBytes + invMixColumns
+    for (round = nRounds - 1; round >= 1; --round) {
+      rk = &w[round * 4];
+      t0 = td0[s0 >> 24] ^ td1[(s3 >> 16) & 0xff]
+	   ^ td2[(s2 >> 8) & 0xff] ^ td3[s1 & 0xff] ^ rk[0];
+      t1 = td0[s1 >> 24] ^ td1[(s0 >> 16) & 0xff]
+	   ^ td2[(s3 >> 8) & 0xff] ^ td3[s2 & 0xff] ^ rk[1];
+      t2 = td0[s2 >> 24] ^ td1[(s1 >> 16) & 0xff]
+	   ^ td2[(s0 >> 8) & 0xff] ^ td3[s3 & 0xff] ^ rk[2];
+      t3 = td0[s3 >> 24] ^ td1[(s2 >> 16) & 0xff]
+	   ^ td2[(s1 >> 8) & 0xff] ^ td3[s0 & 0xff] ^ rk[3];
+      s0 = t0;
+      s1 = t1;
+      s2 = t2;
+      s3 = t3;
+    }
+
+    // last round: no invMixColumns
+    t0 = ((Guint)invSbox[s0 >> 24] << 24)
+         | ((Guint)invSbox[(s3 >> 16) & 0xff] << 16)
+         | ((Guint)invSbox[(s2 >> 8) & 0xff] << 8)
+         | (Guint)invSbox[s1 & 0xff];
+    t1 = ((Guint)invSbox[s1 >> 24] << 24)
+         | ((Guint)invSbox[(s0 >> 16) & 0xff] << 16)
+         | ((Guint)invSbox[(s3 >> 8) & 0xff] << 8)
+         | (Guint)invSbox[s2 & 0xff];
+    t2 = ((Guint)invSbox[s2 >> 24] << 24)
+         | ((Guint)invSbox[(s1 >> 16) & 0xff] << 16)
+         | ((Guint)invSbox[(s0 >> 8) & 0xff] << 8)
+         | (Guint)invSbox[s3 & 0xff];
+    t3 = ((Guint)invSbox[s3 >> 24] << 24)
+         | ((Guint)invSbox[(s2 >> 16) & 0xff] << 16)
+         | ((Guint)invSbox[(s1 >> 8) & 0xff] << 8)
+         | (Guint)invSbox[s0 & 0xff];
+
+    // CBC
+    t0 ^= w[0] ^ iv0;
+    t1 ^= w[1] ^ iv1;
+    t2 ^= w[2] ^ iv2;
+    t3 ^= w[3] ^ iv3;
+    iv0 = c0;
+    iv1 = c1;
+    iv2 = c2;
+    iv3 = c3;
+
+    out[0] = (Guchar)(t0 >> 24);
+    out[1] = (Guchar)(t0 >> 16);
+    out[2] = (Guchar)(t0 >> 8);
+    out[3] = (Guchar)t0;
+    out[4] = (Guchar)(t1 >> 24);
+    out[5] = (Guchar)(t1 >> 16);
+    out[6] = (Guchar)(t1 >> 8);
+    out[7] = (Guchar)t1;
+    out[8] = (Guchar)(t2 >> 24);
+    out[9] = (Guchar)(t2 >> 16);
+    out[10] = (Guchar)(t2 >> 8);
+    out[11] = (Guchar)t2;
+    out[12] = (Guchar)(t3 >> 24);
+    out[13] = (Guchar)(t3 >> 16);
+    out[14] = (Guchar)(t3 >> 8);
+    out[15] = (Guchar)t3;
+  }
+
+  // save the last input block for the next CBC
+  for (i = 0; i < 4; ++i) {
+    cbc[i] = (Guchar)(iv0 >> (24 - 8 * i));
+    cbc[4 + i] = (Guchar)(iv1 >> (24 - 8 * i));
+    cbc[8 + i] = (Guchar)(iv2 >> (24 - 8 * i));
+    cbc[12 + i] = (Guchar)(iv3 >> (24 - 8 * i));
+  }
+}
+
+#if HAVE_AESNI
+
+__attribute__((target("aes,sse2")))
+static void aesDecryptCBCNI(Guint *w, int nRounds, Guchar *cbc,
+			    Guchar *in, Guchar *out, int nBlocks) {
+  __m128i rk[15];
+  __m128i iv, c, x;
+  Guchar key[16];
+  int i, round;
+
+  for (round = 0; round <= nRounds; ++round) {
+    for (i = 0; i < 4; ++i) {
+      key[4*i] = (Guchar)(w[round * 4 + i] >> 24);
+      key[4*i+1] = (Guchar)(w[round * 4 + i] >> 16);
+      key[4*i+2] = (Guchar)(w[round * 4 + i] >> 8);
+      key[4*i+3] = (Guchar)w[round * 4 + i];
+    }
+    rk[round] = _mm_loadu_si128((__m128i *)key);
+  }
+
+  iv = _mm_loadu_si128((__m128i *)cbc);
+  for (i = 0; i < nBlocks; ++i, in += 16, out += 16) {
+    c = _mm_loadu_si128((__m128i *)in);
+    x = _mm_xor_si128(c, rk[nRounds]);
+    for (round = nRounds - 1; round >= 1; --round) {
+      x = _mm_aesdec_si128(x, rk[round]);
+    }
+    x = _mm_aesdeclast_si128(x, rk[0]);
+    _mm_storeu_si128((__m128i *)out, _mm_xor_si128(x, iv));
+    iv = c;
+  }
+  _mm_storeu_si128((__m128i *)cbc, iv);
+}
+
+static GBool aesDetectNI() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("aes") && __builtin_cpu_supports("sse2");
+}
+
+static const GBool aesHaveNI = aesDetectNI();
+
+#endif // HAVE_AESNI
+
+// Decrypt <nBlocks> 16-byte blocks from <in> to <out> in CBC mode,
+// updating <cbc>.  <in> and <out> may be the same buffer.
+static void aesDecryptCBC(Guint *w, int nRounds, Guchar *cbc,
+			  Guchar *in, Guchar *out, int nBlocks) {
+#if HAVE_AESNI
+  if (aesHaveNI) {
+    aesDecryptCBCNI(w, nRounds, cbc, in, out, nBlocks);
+    return;
+  }
+#endif
+  aesDecryptCBCTables(w, nRounds, cbc, in, out, nBlocks);
+}
+
+static void aesRemovePadding(Guchar *buf, int *bufIdx, GBool last) {
+  int n, i;
+
+  *bufIdx = 0;
+  if (last) {
+    n = buf[15];
+    if (n < 1 || n > 16) { // this should never happen
+      n = 16;
+    }
+    for (i = 15; i >= n; --i) {
+      buf[i] = buf[i-n];
+    }
+    *bufIdx = n;
+  }
+}
+
 void aesKeyExpansion(DecryptAESState *s,
 		     Guchar *objKey, int objKeyLen,
 		     GBool decrypt) {
@@ -836,57 +1107,8 @@ void aesEncryptBlock(DecryptAESState *s, Guchar *in) {
 }
 
 void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last) {
-  int c, round, n, i;
-
-  // initial state
-  for (c = 0; c < 4; ++c) {
-    s->state[c] = in[4*c];
-    s->state[4+c] = in[4*c+1];
-    s->state[8+c] = in[4*c+2];
-    s->state[12+c] = in[4*c+3];
-  }
-
-  // round 0
-  addRoundKey(s->state, &s->w[10 * 4]);
-
-  // rounds 1-9
-  for (round = 9; round >= 1; --round) {
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    invMixColumns(s->state);
-    addRoundKey(s->state, &s->w[round * 4]);
-  }
-
-  // round 10
-  invSubBytes(s->state);
-  invShiftRows(s->state);
-  addRoundKey(s->state, &s->w[0]);
-
-  // CBC
-  for (c = 0; c < 4; ++c) {
-    s->buf[4*c] = s->state[c] ^ s->cbc[4*c];
-    s->buf[4*c+1] = s->state[4+c] ^ s->cbc[4*c+1];
-    s->buf[4*c+2] = s->state[8+c] ^ s->cbc[4*c+2];
-    s->buf[4*c+3] = s->state[12+c] ^ s->cbc[4*c+3];
-  }
-
-  // save the input block for the next CBC
-  for (i = 0; i < 16; ++i) {
-    s->cbc[i] = in[i];
-  }
-
-  // remove padding
-  s->bufIdx = 0;
-  if (last) {
-    n = s->buf[15];
-    if (n < 1 || n > 16) { // this should never happen
-      n = 16;
-    }
-    for (i = 15; i >= n; --i) {
-      s->buf[i] = s->buf[i-n];
-    }
-    s->bufIdx = n;
-  }
+  aesDecryptCBC(s->w, 10, s->cbc, in, s->buf, 1);
+  aesRemovePadding(s->buf, &s->bufIdx, last);
 }
 
 //------------------------------------------------------------------------
@@ -919,57 +1141,8 @@ static void aes256KeyExpansion(DecryptAES256State *s,
 }
 
 static void aes256DecryptBlock(DecryptAES256State *s, Guchar *in, GBool last) {
-  int c, round, n, i;
-
-  // initial state
-  for (c = 0; c < 4; ++c) {
-    s->state[c] = in[4*c];
-    s->state[4+c] = in[4*c+1];
-    s->state[8+c] = in[4*c+2];
-    s->state[12+c] = in[4*c+3];
-  }
-
-  // round 0
-  addRoundKey(s->state, &s->w[14 * 4]);
-
-  // rounds 13-1
-  for (round = 13; round >= 1; --round) {
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    invMixColumns(s->state);
-    addRoundKey(s->state, &s->w[round * 4]);
-  }
-
-  // round 14
-  invSubBytes(s->state);
-  invShiftRows(s->state);
-  addRoundKey(s->state, &s->w[0]);
-
-  // CBC
-  for (c = 0; c < 4; ++c) {
-    s->buf[4*c] = s->state[c] ^ s->cbc[4*c];
-    s->buf[4*c+1] = s->state[4+c] ^ s->cbc[4*c+1];
-    s->buf[4*c+2] = s->state[8+c] ^ s->cbc[4*c+2];
-    s->buf[4*c+3] = s->state[12+c] ^ s->cbc[4*c+3];
-  }
-
-  // save the input block for the next CBC
-  for (i = 0; i < 16; ++i) {
-    s->cbc[i] = in[i];
-  }
-
-  // remove padding
-  s->bufIdx = 0;
-  if (last) {
-    n = s->buf[15];
-    if (n < 1 || n > 16) { // this should never happen
-      n = 16;
-    }
-    for (i = 15; i >= n; --i) {
-      s->buf[i] = s->buf[i-n];
-    }
-    s->bufIdx = n;
-  }
+  aesDecryptCBC(s->w, 14, s->cbc, in, s->buf, 1);
+  aesRemovePadding(s->buf, &s->bufIdx, last);
 }
 
 //------------------------------------------------------------------------
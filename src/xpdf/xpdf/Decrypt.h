@@ -88,11 +88,15 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GBool isBinary(GBool last);
   virtual Stream *getUndecodedStream() { return this; }
 
 private:
 
+  int getAESBlock(Guint *w, int nRounds, Guchar *cbc,
+		  Guchar *buf, int *bufIdx, char *blk, int size);
+
   CryptAlgorithm algo;
   int objKeyLength;
   Guchar objKey[32];
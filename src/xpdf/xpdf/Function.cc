@@ -459,6 +459,26 @@ void SampledFunction::transform(double *in, double *out){
   }
   idx0 = (idx0 + e[0]) * n;
 
+  // 1-input functions (the common case for shadings and tint
+  // transforms): plain linear interpolation between two samples
+  if (m == 1) {
+    for (i = 0; i < n; ++i) {
+      x = efrac0[0] * samples[idx0 + i] +
+	  efrac1[0] * samples[idx0 + idxOffset[1] + i];
+      out[i] = x * (decode[i][1] - decode[i][0]) + decode[i][0];
+      if (out[i] < range[i][0]) {
+	out[i] = range[i][0];
+      } else if (out[i] > range[i][1]) {
+	out[i] = range[i][1];
+      }
+    }
+    cacheIn[0] = in[0];
+    for (i = 0; i < n; ++i) {
+      cacheOut[i] = out[i];
+    }
+    return;
+  }
+
   // for each output, do m-linear interpolation
   for (i = 0; i < n; ++i) {
 
@@ -663,6 +683,9 @@ StitchingFunction::StitchingFunction(Object *funcObj, Dict *dict,
     obj2.free();
   }
   obj1.free();
+  if (!hasRange) {
+    n = funcs[0]->getOutputSize();
+  }
 
   //----- Bounds
   if (!dict->lookup("Bounds", &obj1)->isArray() ||
@@ -757,7 +780,7 @@ StitchingFunction::~StitchingFunction() {
 
 void StitchingFunction::transform(double *in, double *out){
   double x;
-  int i;
+  int a, b, mid, i;
 
   if (in[0] < domain[0][0]) {
     x = domain[0][0];
@@ -766,11 +789,19 @@ void StitchingFunction::transform(double *in, double *out){
   } else {
     x = in[0];
   }
-  for (i = 0; i < k - 1; ++i) {
-    if (x < bounds[i+1]) {
-      break;
+  // binary search for the subfunction:
+  // invariant: bounds[a] <= x, and x < bounds[b+1] (or b = k-1)
+  a = 0;
+  b = k - 1;
+  while (a < b) {
+    mid = (a + b) / 2;
+    if (x < bounds[mid+1]) {
+      b = mid;
+    } else {
+      a = mid + 1;
     }
   }
+  i = a;
   x = encode[2*i] + (x - bounds[i]) * scale[i];
   funcs[i]->transform(&x, out);
 }
@@ -827,6 +858,13 @@ void StitchingFunction::transform(double *in, double *out){
 
 #define nPSOps 43
 
+// These only appear in compiled code: a push followed by a binary
+// operator is fused into a single op with an immediate operand.
+#define psOpAddC     43
+#define psOpSubC     44
+#define psOpMulC     45
+#define psOpDivC     46
+
 // Note: 'if' and 'ifelse' are parsed separately.
 // The rest are listed here in alphabetical order.
 // The index in this table is equivalent to the psOpXXX defines.
@@ -888,11 +926,19 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   GList *tokens;
   GString *tok;
   double in[funcMaxInputs];
+  double out[funcMaxOutputs];
   int tokPtr, codePtr, i;
 
   codeString = NULL;
   code = NULL;
   codeSize = 0;
+  sCode = NULL;
+  sCodeLen = 0;
+  cacheIn = NULL;
+  cacheOut = NULL;
+  for (i = 0; i < psFuncCacheSize; ++i) {
+    cacheOk[i] = gFalse;
+  }
   ok = gFalse;
 
   //----- initialize the generic stuff
@@ -933,12 +979,16 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   }
   codeLen = codePtr;
 
+  //----- try to compile the function
+  compile();
+
   //----- set up the cache
+  cacheIn = (double *)gmallocn(psFuncCacheSize * m, sizeof(double));
+  cacheOut = (double *)gmallocn(psFuncCacheSize * n, sizeof(double));
   for (i = 0; i < m; ++i) {
     in[i] = domain[i][0];
-    cacheIn[i] = in[i] - 1;
   }
-  transform(in, cacheOut);
+  transform(in, out);
 
   ok = gTrue;
 
@@ -953,37 +1003,71 @@ PostScriptFunction::PostScriptFunction(PostScriptFunction *func) {
   codeString = func->codeString->copy();
   code = (PSCode *)gmallocn(codeSize, sizeof(PSCode));
   memcpy(code, func->code, codeSize * sizeof(PSCode));
+  if (func->sCode) {
+    sCode = (PSCode *)gmallocn(sCodeLen, sizeof(PSCode));
+    memcpy(sCode, func->sCode, sCodeLen * sizeof(PSCode));
+  }
+  cacheIn = (double *)gmallocn(psFuncCacheSize * m, sizeof(double));
+  memcpy(cacheIn, func->cacheIn, psFuncCacheSize * m * sizeof(double));
+  cacheOut = (double *)gmallocn(psFuncCacheSize * n, sizeof(double));
+  memcpy(cacheOut, func->cacheOut, psFuncCacheSize * n * sizeof(double));
 }
 
 PostScriptFunction::~PostScriptFunction() {
   gfree(code);
+  gfree(sCode);
+  gfree(cacheIn);
+  gfree(cacheOut);
   if (codeString) {
   delete codeString;
 }
 }
 
+static inline Guint psHashDouble(double x) {
+  Guint u[2];
+
+  memcpy(u, &x, sizeof(double));
+  return u[0] ^ u[1];
+}
+
 void PostScriptFunction::transform(double *in, double *out){
   double stack[psStackSize];
+  double *p;
   double x;
-  int sp, i;
+  Guint h;
+  int sp, i, slot;
 
-  // check the cache
+  // check the cache -- this is direct-mapped, keyed by a hash of the
+  // input bits
+  h = 0;
   for (i = 0; i < m; ++i) {
-    if (in[i] != cacheIn[i]) {
-      break;
-  }
+    h = h * 31 + psHashDouble(in[i]);
   }
-  if (i == m) {
-    for (i = 0; i < n; ++i) {
-      out[i] = cacheOut[i];
+  slot = (int)(((h * 0x9e3779b1U) >> 24) % psFuncCacheSize);
+  if (cacheOk[slot]) {
+    p = cacheIn + slot * m;
+    for (i = 0; i < m; ++i) {
+      if (in[i] != p[i]) {
+	break;
+      }
+    }
+    if (i == m) {
+      p = cacheOut + slot * n;
+      for (i = 0; i < n; ++i) {
+	out[i] = p[i];
+      }
+      return;
     }
-    return;
   }
 
   for (i = 0; i < m; ++i) {
     stack[psStackSize - 1 - i] = in[i];
   }
-  sp = exec(stack, psStackSize - m);
+  if (sCode) {
+    sp = execCompiled(stack, psStackSize - m);
+  } else {
+    sp = exec(stack, psStackSize - m);
+  }
   // if (sp < psStackSize - n) {
   //   error(errSyntaxWarning, -1,
   // 	  "Extra values on stack at end of PostScript function");
@@ -1004,12 +1088,15 @@ void PostScriptFunction::transform(double *in, double *out){
   }
 
   // save current result in the cache
+  p = cacheIn + slot * m;
   for (i = 0; i < m; ++i) {
-    cacheIn[i] = in[i];
+    p[i] = in[i];
   }
+  p = cacheOut + slot * n;
   for (i = 0; i < n; ++i) {
-    cacheOut[i] = out[i];
+    p[i] = out[i];
   }
+  cacheOk[slot] = gTrue;
 }
 
 GBool PostScriptFunction::parseCode(GList *tokens, int *tokPtr, int *codePtr) {
@@ -1554,3 +1641,414 @@ int PostScriptFunction::exec(double *stack, int sp0) {
   error(errSyntaxError, -1, "Invalid arg in PostScript function");
   return sp;
 }
+
+// Try to compile the function into straight-line code.  This only
+// handles functions with no conditionals, where the stack depth
+// before each op can be computed statically -- which means the
+// operands of copy, index, and roll have to be literal pushes.  The
+// resulting code can be run by execCompiled() without any of the
+// per-op stack checks.  If anything doesn't fit, sCode is left NULL
+// and the interpreter is used.
+void PostScriptFunction::compile() {
+  PSCode *c;
+  int depth, nn, k, ip, op;
+
+  //----- check the code and simulate the stack depth
+  depth = m;
+  for (ip = 0; ip < codeLen; ++ip) {
+    c = &code[ip];
+    switch (c->op) {
+    case psOpAbs:
+    case psOpCeiling:
+    case psOpCos:
+    case psOpCvi:
+    case psOpCvr:
+    case psOpFloor:
+    case psOpLn:
+    case psOpLog:
+    case psOpNeg:
+    case psOpNot:
+    case psOpRound:
+    case psOpSin:
+    case psOpSqrt:
+    case psOpTruncate:
+      if (depth < 1) {
+	return;
+      }
+      break;
+    case psOpAdd:
+    case psOpAnd:
+    case psOpAtan:
+    case psOpBitshift:
+    case psOpDiv:
+    case psOpEq:
+    case psOpExp:
+    case psOpGe:
+    case psOpGt:
+    case psOpIdiv:
+    case psOpLe:
+    case psOpLt:
+    case psOpMod:
+    case psOpMul:
+    case psOpNe:
+    case psOpOr:
+    case psOpSub:
+    case psOpXor:
+      if (depth < 2) {
+	return;
+      }
+      --depth;
+      break;
+    case psOpExch:
+      if (depth < 2) {
+	return;
+      }
+      break;
+    case psOpDup:
+      if (depth < 1 || depth >= psStackSize) {
+	return;
+      }
+      ++depth;
+      break;
+    case psOpFalse:
+    case psOpTrue:
+    case psOpPush:
+      if (depth >= psStackSize) {
+	return;
+      }
+      ++depth;
+      break;
+    case psOpPop:
+      if (depth < 1) {
+	return;
+      }
+      --depth;
+      break;
+    case psOpCopy:
+      if (ip < 1 || code[ip-1].op != psOpPush) {
+	return;
+      }
+      nn = (int)code[ip-1].val.d;
+      --depth;
+      if (nn < 0 || nn > depth || depth + nn > psStackSize) {
+	return;
+      }
+      depth += nn;
+      break;
+    case psOpIndex:
+      if (ip < 1 || code[ip-1].op != psOpPush) {
+	return;
+      }
+      k = (int)code[ip-1].val.d;
+      if (k < 0 || k + 2 > depth) {
+	return;
+      }
+      break;
+    case psOpRoll:
+      if (ip < 2 || code[ip-2].op != psOpPush || code[ip-1].op != psOpPush) {
+	return;
+      }
+      nn = (int)code[ip-2].val.d;
+      depth -= 2;
+      if (nn <= 0 || nn > depth) {
+	return;
+      }
+      break;
+    default: // psOpJ, psOpJz
+      return;
+    }
+  }
+  if (depth < n) {
+    return;
+  }
+
+  //----- generate the code, fusing push + {add,sub,mul,div}
+  sCode = (PSCode *)gmallocn(codeLen, sizeof(PSCode));
+  sCodeLen = 0;
+  for (ip = 0; ip < codeLen; ++ip) {
+    c = &code[ip];
+    if (c->op == psOpPush && ip + 1 < codeLen) {
+      switch (code[ip+1].op) {
+      case psOpAdd: op = psOpAddC; break;
+      case psOpSub: op = psOpSubC; break;
+      case psOpMul: op = psOpMulC; break;
+      case psOpDiv: op = psOpDivC; break;
+      default:      op = -1;       break;
+      }
+      if (op >= 0) {
+	sCode[sCodeLen].op = op;
+	sCode[sCodeLen].val.d = c->val.d;
+	++sCodeLen;
+	++ip;
+	continue;
+      }
+    }
+    sCode[sCodeLen++] = *c;
+  }
+}
+
+// Run the compiled code.  The stack depth was checked by compile(),
+// so there are no underflow/overflow checks here.
+int PostScriptFunction::execCompiled(double *stack, int sp0) {
+  PSCode *c, *end;
+  double tmp[psStackSize];
+  double t;
+  int sp, nn, k, i;
+
+  sp = sp0;
+  end = sCode + sCodeLen;
+  for (c = sCode; c < end; ++c) {
+    switch (c->op) {
+    case psOpAbs:
+      stack[sp] = fabs(stack[sp]);
+      break;
+    case psOpAdd:
+      stack[sp + 1] = stack[sp + 1] + stack[sp];
+      ++sp;
+      break;
+    case psOpAnd:
+      stack[sp + 1] = (int)stack[sp + 1] & (int)stack[sp];
+      ++sp;
+      break;
+    case psOpAtan:
+      stack[sp + 1] = atan2(stack[sp + 1], stack[sp]);
+      ++sp;
+      break;
+    case psOpBitshift:
+      k = (int)stack[sp + 1];
+      nn = (int)stack[sp];
+      if (nn > 0) {
+	stack[sp + 1] = k << nn;
+      } else if (nn < 0) {
+	stack[sp + 1] = k >> -nn;
+      } else {
+	stack[sp + 1] = k;
+      }
+      ++sp;
+      break;
+    case psOpCeiling:
+      stack[sp] = ceil(stack[sp]);
+      break;
+    case psOpCopy:
+      nn = (int)stack[sp++];
+      for (i = 0; i < nn; ++i) {
+	stack[sp - nn + i] = stack[sp + i];
+      }
+      sp -= nn;
+      break;
+    case psOpCos:
+      stack[sp] = cos(stack[sp]);
+      break;
+    case psOpCvi:
+      stack[sp] = (int)stack[sp];
+      break;
+    case psOpCvr:
+      break;
+    case psOpDiv:
+      stack[sp + 1] = stack[sp + 1] / stack[sp];
+      ++sp;
+      break;
+    case psOpDup:
+      stack[sp - 1] = stack[sp];
+      --sp;
+      break;
+    case psOpEq:
+      stack[sp + 1] = stack[sp + 1] == stack[sp] ? 1 : 0;
+      ++sp;
+      break;
+    case psOpExch:
+      t = stack[sp];
+      stack[sp] = stack[sp + 1];
+      stack[sp + 1] = t;
+      break;
+    case psOpExp:
+      stack[sp + 1] = pow(stack[sp + 1], stack[sp]);
+      ++sp;
+      break;
+    case psOpFalse:
+      stack[--sp] = 0;
+      break;
+    case psOpFloor:
+      stack[sp] = floor(stack[sp]);
+      break;
+    case psOpGe:
+      stack[sp + 1] = stack[sp + 1] >= stack[sp] ? 1 : 0;
+      ++sp;
+      break;
+    case psOpGt:
+      stack[sp + 1] = stack[sp + 1] > stack[sp] ? 1 : 0;
+      ++sp;
+      break;
+    case psOpIdiv:
+      stack[sp + 1] = (int)stack[sp + 1] / (int)stack[sp];
+      ++sp;
+      break;
+    case psOpIndex:
+      k = (int)stack[sp];
+      stack[sp] = stack[sp + 1 + k];
+      break;
+    case psOpLe:
+      stack[sp + 1] = stack[sp + 1] <= stack[sp] ? 1 : 0;
+      ++sp;
+      break;
+    case psOpLn:
+      stack[sp] = log(stack[sp]);
+      break;
+    case psOpLog:
+      stack[sp] = log10(stack[sp]);
+      break;
+    case psOpLt:
+      stack[sp + 1] = stack[sp + 1] < stack[sp] ? 1 : 0;
+      ++sp;
+      break;
+    case psOpMod:
+      stack[sp + 1] = (int)stack[sp + 1] % (int)stack[sp];
+      ++sp;
+      break;
+    case psOpMul:
+      stack[sp + 1] = stack[sp + 1] * stack[sp];
+      ++sp;
+      break;
+    case psOpNe:
+      stack[sp + 1] = stack[sp + 1] != stack[sp] ? 1 : 0;
+      ++sp;
+      break;
+    case psOpNeg:
+      stack[sp] = -stack[sp];
+      break;
+    case psOpNot:
+      stack[sp] = stack[sp] == 0 ? 1 : 0;
+      break;
+    case psOpOr:
+      stack[sp + 1] = (int)stack[sp + 1] | (int)stack[sp];
+      ++sp;
+      break;
+    case psOpPop:
+      ++sp;
+      break;
+    case psOpRoll:
+      k = (int)stack[sp++];
+      nn = (int)stack[sp++];
+      if (k >= 0) {
+	k %= nn;
+      } else {
+	k = -k % nn;
+	if (k) {
+	  k = nn - k;
+	}
+      }
+      for (i = 0; i < nn; ++i) {
+	tmp[i] = stack[sp + i];
+      }
+      for (i = 0; i < nn; ++i) {
+	stack[sp + i] = tmp[(i + k) % nn];
+      }
+      break;
+    case psOpRound:
+      t = stack[sp];
+      stack[sp] = (t >= 0) ? floor(t + 0.5) : ceil(t - 0.5);
+      break;
+    case psOpSin:
+      stack[sp] = sin(stack[sp]);
+      break;
+    case psOpSqrt:
+      stack[sp] = sqrt(stack[sp]);
+      break;
+    case psOpSub:
+      stack[sp + 1] = stack[sp + 1] - stack[sp];
+      ++sp;
+      break;
+    case psOpTrue:
+      stack[--sp] = 1;
+      break;
+    case psOpTruncate:
+      t = stack[sp];
+      stack[sp] = (t >= 0) ? floor(t) : ceil(t);
+      break;
+    case psOpXor:
+      stack[sp + 1] = (int)stack[sp + 1] ^ (int)stack[sp];
+      ++sp;
+      break;
+    case psOpPush:
+      stack[--sp] = c->val.d;
+      break;
+    case psOpAddC:
+      stack[sp] = stack[sp] + c->val.d;
+      break;
+    case psOpSubC:
+      stack[sp] = stack[sp] - c->val.d;
+      break;
+    case psOpMulC:
+      stack[sp] = stack[sp] * c->val.d;
+      break;
+    case psOpDivC:
+      stack[sp] = stack[sp] / c->val.d;
+      break;
+    }
+  }
+  return sp;
+}
+
+//------------------------------------------------------------------------
+// FunctionLUT
+//------------------------------------------------------------------------
+
+FunctionLUT::FunctionLUT(Function **funcs, int nFuncs,
+			 double t0A, double t1A, int nSamplesA) {
+  double t;
+  double *p;
+  int i, j;
+
+  t0 = t0A;
+  t1 = t1A;
+  nSamples = nSamplesA;
+  if (nSamples < 2) {
+    nSamples = 2;
+  } else if (nSamples > funcLUTMaxSamples) {
+    nSamples = funcLUTMaxSamples;
+  }
+  if (t1 != t0) {
+    scale = (nSamples - 1) / (t1 - t0);
+  } else {
+    scale = 0;
+  }
+  nOut = 0;
+  for (j = 0; j < nFuncs; ++j) {
+    nOut += funcs[j]->getOutputSize();
+  }
+  samples = (double *)gmallocn(nSamples * nOut, sizeof(double));
+  for (i = 0; i < nSamples; ++i) {
+    t = t0 + (t1 - t0) * i / (nSamples - 1);
+    p = samples + i * nOut;
+    for (j = 0; j < nFuncs; ++j) {
+      funcs[j]->transform(&t, p);
+      p += funcs[j]->getOutputSize();
+    }
+  }
+}
+
+FunctionLUT::~FunctionLUT() {
+  gfree(samples);
+}
+
+void FunctionLUT::lookup(double t, double *out) {
+  double x, frac;
+  double *p;
+  int i, j;
+
+  x = (t - t0) * scale;
+  if (!(x > 0)) {  // also catches NaN
+    x = 0;
+  } else if (x > nSamples - 1) {
+    x = nSamples - 1;
+  }
+  i = (int)x;
+  if (i == nSamples - 1) {
+    --i;
+  }
+  frac = x - i;
+  p = samples + i * nOut;
+  for (j = 0; j < nOut; ++j) {
+    out[j] = p[j] + frac * (p[nOut + j] - p[j]);
+  }
+}
@@ -30,6 +30,8 @@ struct PSCode;
 #define funcMaxInputs        32
 #define funcMaxOutputs       32
 #define sampledFuncMaxInputs 16
+#define psFuncCacheSize       8
+#define funcLUTMaxSamples  4096
 
 class Function {
 public:
@@ -214,6 +216,10 @@ public:
 
   GString *getCodeString() { return codeString; }
 
+  // Returns true if the function was compiled into straight-line
+  // code (no conditionals, statically checked stack depth).
+  GBool isCompiled() { return sCode != NULL; }
+
 private:
 
   PostScriptFunction(PostScriptFunction *func);
@@ -223,14 +229,52 @@ private:
   void addCodeD(int *codePtr, int op, double x);
   GString *getToken(Stream *str);
   int exec(double *stack, int sp0);
+  void compile();
+  int execCompiled(double *stack, int sp0);
 
   GString *codeString;
   PSCode *code;
   int codeLen;
   int codeSize;
-  double cacheIn[funcMaxInputs];
-  double cacheOut[funcMaxOutputs];
+  PSCode *sCode;		// compiled straight-line code (or NULL)
+  int sCodeLen;
+  double *cacheIn;		// [psFuncCacheSize][m] memoized inputs
+  double *cacheOut;		// [psFuncCacheSize][n] memoized outputs
+  GBool cacheOk[psFuncCacheSize];
   GBool ok;
 };
 
+//------------------------------------------------------------------------
+// FunctionLUT
+//------------------------------------------------------------------------
+
+// Pre-sampled lookup table for a set of 1-input functions (e.g., the
+// functions of an axial or radial shading).  The functions are
+// sampled at <nSamples> evenly spaced points across [t0, t1] -- the
+// caller picks nSamples to match the output resolution -- and
+// lookups linearly interpolate between adjacent samples.
+class FunctionLUT {
+public:
+
+  // There can be one function with n outputs, or n functions with
+  // one output each.
+  FunctionLUT(Function **funcs, int nFuncs, double t0A, double t1A,
+	      int nSamplesA);
+  ~FunctionLUT();
+
+  // Return the number of outputs per sample.
+  int getOutputSize() { return nOut; }
+
+  // Look up <t>, which is clipped to [t0, t1].
+  void lookup(double t, double *out);
+
+private:
+
+  double t0, t1;
+  double scale;			// (nSamples - 1) / (t1 - t0)
+  int nSamples;
+  int nOut;
+  double *samples;		// [nSamples][nOut]
+};
+
 #endif
@@ -365,6 +365,19 @@ GfxFont *GfxResources::lookupFontByRef(Ref ref) {
   return NULL;
 }
 
+GBool GfxResources::hasFont(GfxFont *font) {
+  int i;
+
+  if (fonts) {
+    for (i = 0; i < fonts->getNumFonts(); ++i) {
+      if (fonts->getFont(i) == font) {
+	return gTrue;
+      }
+    }
+  }
+  return gFalse;
+}
+
 GBool GfxResources::lookupXObject(const char *name, Object *obj) {
   GfxResources *resPtr;
 
@@ -520,6 +533,7 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, int pageNum, Dict *resDict,
     baseMatrix[i] = state->getCTM()[i];
   }
   formDepth = 0;
+  formRecord = NULL;
   textClipBBoxEmpty = gTrue;
   markedContentStack = new GList();
   ocState = gTrue;
@@ -565,6 +579,7 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, Dict *resDict,
     baseMatrix[i] = state->getCTM()[i];
   }
   formDepth = 0;
+  formRecord = NULL;
   textClipBBoxEmpty = gTrue;
   markedContentStack = new GList();
   ocState = gTrue;
@@ -1797,6 +1812,7 @@ void Gfx::doPatternFill(GBool eoFill) {
   if (!(pattern = state->getFillPattern())) {
     return;
   }
+  out->beginNonText();
   switch (pattern->getType()) {
   case 1:
     doTilingPatternFill((GfxTilingPattern *)pattern, gFalse, eoFill, gFalse);
@@ -1809,6 +1825,7 @@ void Gfx::doPatternFill(GBool eoFill) {
 	  pattern->getType());
     break;
   }
+  out->endNonText();
 }
 
 void Gfx::doPatternStroke() {
@@ -1824,6 +1841,7 @@ void Gfx::doPatternStroke() {
   if (!(pattern = state->getStrokePattern())) {
     return;
   }
+  out->beginNonText();
   switch (pattern->getType()) {
   case 1:
     doTilingPatternFill((GfxTilingPattern *)pattern, gTrue, gFalse, gFalse);
@@ -1836,6 +1854,7 @@ void Gfx::doPatternStroke() {
 	  pattern->getType());
     break;
   }
+  out->endNonText();
 }
 
 void Gfx::doPatternText() {
@@ -1851,6 +1870,7 @@ void Gfx::doPatternText() {
   if (!(pattern = state->getFillPattern())) {
     return;
   }
+  out->beginNonText();
   switch (pattern->getType()) {
   case 1:
     doTilingPatternFill((GfxTilingPattern *)pattern, gFalse, gFalse, gTrue);
@@ -1863,6 +1883,7 @@ void Gfx::doPatternText() {
 	  pattern->getType());
     break;
   }
+  out->endNonText();
 }
 
 void Gfx::doPatternImageMask(Object *ref, Stream *str, int width, int height,
@@ -2227,6 +2248,8 @@ void Gfx::opShFill(Object args[], int numArgs) {
     return;
   }
 
+  out->beginNonText();
+
   // save current graphics state
   savedState = saveStateStack();
 
@@ -2279,6 +2302,8 @@ void Gfx::opShFill(Object args[], int numArgs) {
   // restore graphics state
   restoreStateStack(savedState);
 
+  out->endNonText();
+
   delete shading;
 }
 
@@ -3300,6 +3325,9 @@ void Gfx::doSetFont(GfxFont *font, double size) {
   }
   state->setFont(font, size);
   fontChanged = gTrue;
+  if (formRecord) {
+    useFormFont(font);
+  }
 }
 
 void Gfx::opSetTextLeading(Object args[], int numArgs) {
@@ -3364,6 +3392,9 @@ void Gfx::opSetTextMatrix(Object args[], int numArgs) {
 void Gfx::opTextNextLine(Object args[], int numArgs) {
   double tx, ty;
 
+  if (formRecord) {
+    useFormTextParams(gfxTextLeading);
+  }
   tx = state->getLineX();
   ty = state->getLineY() - state->getLeading();
   state->textMoveTo(tx, ty);
@@ -3403,6 +3434,9 @@ void Gfx::opMoveShowText(Object args[], int numArgs) {
     out->updateFont(state);
     fontChanged = gFalse;
   }
+  if (formRecord) {
+    useFormTextParams(gfxTextLeading);
+  }
   tx = state->getLineX();
   ty = state->getLineY() - state->getLeading();
   state->textMoveTo(tx, ty);
@@ -3427,6 +3461,9 @@ void Gfx::opMoveSetShowText(Object args[], int numArgs) {
     out->updateFont(state);
     fontChanged = gFalse;
   }
+  if (formRecord) {
+    useFormTextParams(gfxTextLeading);
+  }
   state->setWordSpace(args[0].getNum());
   state->setCharSpace(args[1].getNum());
   tx = state->getLineX();
@@ -3518,6 +3555,14 @@ void Gfx::doShowText(GString *s) {
   font = state->getFont();
   wMode = font->getWMode();
 
+  if (formRecord) {
+    useFormTextParams(gfxTextFont | gfxTextMatrix | gfxTextCharSpace |
+		      gfxTextWordSpace | gfxTextHorizScaling | gfxTextRise |
+		      gfxTextRender |
+		      ((state->getRender() & 3) == 1 ? gfxTextStrokeColor
+		                                     : gfxTextFillColor));
+  }
+
   if (out->useDrawChar()) {
     out->beginString(state, s);
   }
@@ -3582,6 +3627,13 @@ void Gfx::doShowText(GString *s) {
       dx *= state->getHorizScaling();
       dy *= state->getFontSize();
       state->textTransformDelta(dx, dy, &tdx, &tdy);
+      if (out->needType3DrawChar()) {
+	originX *= state->getFontSize();
+	originY *= state->getFontSize();
+	state->textTransformDelta(originX, originY, &tOriginX, &tOriginY);
+	out->drawChar(state, curX + riseX, curY + riseY, tdx, tdy,
+		      tOriginX, tOriginY, code, n, u, uLen);
+      }
       state->transform(curX + riseX, curY + riseY, &x, &y);
       savedState = saveStateStack();
       state->setCTM(newCTM[0], newCTM[1], newCTM[2], newCTM[3], x, y);
@@ -4210,6 +4262,9 @@ void Gfx::doForm(Object *strRef, Object *str) {
   Object resObj;
   Dict *resDict;
   GBool oc, ocSaved;
+  GfxFormRecord record;
+  GBool recording;
+  int inheritedParams;
   Object obj1, obj2, obj3;
   int i;
 
@@ -4299,11 +4354,48 @@ void Gfx::doForm(Object *strRef, Object *str) {
   }
   obj1.free();
 
-  // draw it
+  // draw it -- or let the output device replay what the form produced
+  // the last time it was drawn
+  recording = gFalse;
+  if (ocState && strRef->isRef() && out->useFormCache()) {
+    if (out->replayForm(state, xref, strRef->getRef(), &inheritedParams)) {
+      // an enclosing form being recorded depends on what the replayed
+      // form took from the state
+      if (formRecord) {
+	useFormTextParams(inheritedParams);
+      }
+      if (blendingColorSpace) {
+	delete blendingColorSpace;
+      }
+      resObj.free();
+      ocState = ocSaved;
+      return;
+    }
+    recording = out->beginFormRecord(state, xref, strRef->getRef());
+  }
+  if (recording) {
+    record.parentParamsSet = state->getTextParamsSet();
+    record.inheritedParams = 0;
+    record.res = res;
+    record.markedContentDepth = markedContentStack->getLength();
+    record.next = formRecord;
+    formRecord = &record;
+    state->setTextParamsSet(0);
+  }
   ++formDepth;
   drawForm(strRef, resDict, m, bbox,
 	  transpGroup, gFalse, blendingColorSpace, isolated, knockout);
   --formDepth;
+  if (recording) {
+    formRecord = record.next;
+    state->setTextParamsSet(record.parentParamsSet);
+    // unbalanced marked content changes what follows the form, which
+    // a replay would not do
+    out->endFormRecord(state,
+		       markedContentStack->getLength() ==
+		         record.markedContentDepth,
+		       record.inheritedParams);
+  }
 
   if (blendingColorSpace) {
     delete blendingColorSpace;
@@ -4313,6 +4405,37 @@ void Gfx::doForm(Object *strRef, Object *str) {
   ocState = ocSaved;
 }
 
+// The current form(s) being recorded use text parameters <params>
+// [GfxTextParam].  Mark the ones that were not set since the start of
+// each recorded form as inherited.
+void Gfx::useFormTextParams(int params) {
+  GfxFormRecord *r;
+  int missing;
+
+  missing = params & ~state->getTextParamsSet();
+  for (r = formRecord; r && missing; r = r->next) {
+    r->inheritedParams |= missing;
+    missing &= ~r->parentParamsSet;
+  }
+}
+
+// A font found in the resources of the enclosing content is shared
+// with it, which a replayed form cannot reproduce -- treat it as an
+// inherited font.
+void Gfx::useFormFont(GfxFont *font) {
+  GfxFormRecord *r;
+  GfxResources *resPtr;
+
+  for (r = formRecord; r; r = r->next) {
+    for (resPtr = r->res; resPtr; resPtr = resPtr->getNext()) {
+      if (resPtr->hasFont(font)) {
+	r->inheritedParams |= gfxTextFont;
+	break;
+      }
+    }
+  }
+}
+
 void Gfx::drawForm(Object *strRef, Dict *resDict,
 		   double *matrix, double *bbox,
 		  GBool transpGroup, GBool softMask,
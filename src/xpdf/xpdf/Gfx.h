@@ -86,6 +86,7 @@ public:
 
   GfxFont *lookupFont(char *name);
   GfxFont *lookupFontByRef(Ref ref);
+  GBool hasFont(GfxFont *font);
   GBool lookupXObject(const char *name, Object *obj);
   GBool lookupXObjectNF(const char *name, Object *obj);
   void lookupColorSpace(const char *name, Object *obj);
@@ -134,6 +135,23 @@ public:
 				//   disabled
 };
 
+//------------------------------------------------------------------------
+// GfxFormRecord
+//------------------------------------------------------------------------
+
+// A form XObject whose output is being recorded by the output device
+// (see OutputDev::beginFormRecord).  Tracks which text parameters the
+// form takes from the state it is drawn in.
+struct GfxFormRecord {
+  int parentParamsSet;		// text params set in the enclosing form
+				//   before this one [GfxTextParam]
+  int inheritedParams;		// text params used but not set by this
+				//   form [GfxTextParam]
+  GfxResources *res;		// resources of the enclosing content
+  int markedContentDepth;	// marked content nesting at the start
+  GfxFormRecord *next;		// enclosing recorded form
+};
+
 //------------------------------------------------------------------------
 // Gfx
 //------------------------------------------------------------------------
@@ -206,6 +224,8 @@ private:
   double baseMatrix[6];		// default matrix for most recent
 				//   page/form/pattern
   int formDepth;
+  GfxFormRecord *formRecord;	// innermost form recorded by the output
+				//   device, or NULL
   double textClipBBox[4];	// text clipping bounding box
   GBool textClipBBoxEmpty;	// true if textClipBBox has not been
 				//   initialized yet
@@ -342,6 +362,8 @@ private:
   void opXObject(Object args[], int numArgs);
   void doImage(Object *ref, Stream *str, GBool inlineImg);
   void doForm(Object *strRef, Object *str);
+  void useFormTextParams(int params);
+  void useFormFont(GfxFont *font);
 
   // in-line image operators
   void opBeginImage(Object args[], int numArgs);
@@ -29,6 +29,11 @@
 // loops in the color space object structure.
 #define colorSpaceRecursionLimit 8
 
+// Number of samples of a one-input tint transform (Separation and
+// DeviceN color spaces).  Colors are interpolated between the
+// samples, which include all 8-bit values.
+#define gfxTintLUTSamples (4 * 255 + 1)
+
 //------------------------------------------------------------------------
 
 static inline GfxColorComp clip01(GfxColorComp x) {
@@ -39,6 +44,17 @@ static inline double clip01(double x) {
   return (x < 0) ? 0 : (x > 1) ? 1 : x;
 }
 
+// The CMYK->RGB line conversion uses GCC vector extensions, compiled
+// for both AVX and baseline x86 and picked at runtime.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 9 && \
+    (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_VEC_CMYK 1
+typedef double GfxDblVec4 __attribute__((vector_size(32)));
+typedef int GfxIntVec4 __attribute__((vector_size(16)));
+#else
+#  define HAVE_VEC_CMYK 0
+#endif
+
 //------------------------------------------------------------------------
 
 struct GfxBlendModeInfo {
@@ -96,9 +112,21 @@ static const char *gfxColorSpaceModeNames[] = {
 
 GfxColorSpace::GfxColorSpace() {
   overprintMask = 0x0f;
+  lineBuf = NULL;
+  lineBufSize = 0;
 }
 
 GfxColorSpace::~GfxColorSpace() {
+  gfree(lineBuf);
+}
+
+GfxColorComp *GfxColorSpace::getLineBuf(int size) {
+  if (size > lineBufSize) {
+    gfree(lineBuf);
+    lineBuf = (GfxColorComp *)gmallocn(size, sizeof(GfxColorComp));
+    lineBufSize = size;
+  }
+  return lineBuf;
 }
 
 GfxColorSpace *GfxColorSpace::parse(Object *csObj,
@@ -186,6 +214,73 @@ void GfxColorSpace::getDefaultRanges(double *decodeLow, double *decodeRange,
   }
 }
 
+void GfxColorSpace::getGrayLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColor color;
+  GfxGray gray;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (j = 0; j < n; ++j, in += nComps) {
+    if (j > 0 && !memcmp(in, in - nComps, nComps * sizeof(GfxColorComp))) {
+      out[j] = out[j - 1];
+      continue;
+    }
+    for (i = 0; i < nComps; ++i) {
+      color.c[i] = in[i];
+    }
+    getGray(&color, &gray);
+    out[j] = colToByte(gray);
+  }
+}
+
+void GfxColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColor color;
+  GfxRGB rgb;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (j = 0; j < n; ++j, in += nComps, out += 3) {
+    if (j > 0 && !memcmp(in, in - nComps, nComps * sizeof(GfxColorComp))) {
+      out[0] = out[-3];
+      out[1] = out[-2];
+      out[2] = out[-1];
+      continue;
+    }
+    for (i = 0; i < nComps; ++i) {
+      color.c[i] = in[i];
+    }
+    getRGB(&color, &rgb);
+    out[0] = colToByte(rgb.r);
+    out[1] = colToByte(rgb.g);
+    out[2] = colToByte(rgb.b);
+  }
+}
+
+void GfxColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColor color;
+  GfxCMYK cmyk;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (j = 0; j < n; ++j, in += nComps, out += 4) {
+    if (j > 0 && !memcmp(in, in - nComps, nComps * sizeof(GfxColorComp))) {
+      out[0] = out[-4];
+      out[1] = out[-3];
+      out[2] = out[-2];
+      out[3] = out[-1];
+      continue;
+    }
+    for (i = 0; i < nComps; ++i) {
+      color.c[i] = in[i];
+    }
+    getCMYK(&color, &cmyk);
+    out[0] = colToByte(cmyk.c);
+    out[1] = colToByte(cmyk.m);
+    out[2] = colToByte(cmyk.y);
+    out[3] = colToByte(cmyk.k);
+  }
+}
+
 int GfxColorSpace::getNumColorSpaceModes() {
   return nGfxColorSpaceModes;
 }
@@ -225,6 +320,33 @@ void GfxDeviceGrayColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(gfxColorComp1 - color->c[0]);
 }
 
+void GfxDeviceGrayColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					  int n) {
+  int j;
+
+  for (j = 0; j < n; ++j) {
+    out[j] = colToByte(clip01(in[j]));
+  }
+}
+
+void GfxDeviceGrayColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, out += 3) {
+    out[0] = out[1] = out[2] = colToByte(clip01(in[j]));
+  }
+}
+
+void GfxDeviceGrayColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out,
+					  int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, out += 4) {
+    out[0] = out[1] = out[2] = 0;
+    out[3] = colToByte(clip01(gfxColorComp1 - in[j]));
+  }
+}
+
 
 void GfxDeviceGrayColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
@@ -320,6 +442,31 @@ void GfxCalGrayColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(gfxColorComp1 - color->c[0]);
 }
 
+void GfxCalGrayColorSpace::getGrayLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j) {
+    out[j] = colToByte(clip01(in[j]));
+  }
+}
+
+void GfxCalGrayColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, out += 3) {
+    out[0] = out[1] = out[2] = colToByte(clip01(in[j]));
+  }
+}
+
+void GfxCalGrayColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, out += 4) {
+    out[0] = out[1] = out[2] = 0;
+    out[3] = colToByte(clip01(gfxColorComp1 - in[j]));
+  }
+}
+
 
 void GfxCalGrayColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
@@ -374,6 +521,46 @@ void GfxDeviceRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+void GfxDeviceRGBColorSpace::getGrayLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, in += 3) {
+    out[j] = colToByte(clip01((GfxColorComp)(0.3  * in[0] +
+					     0.59 * in[1] +
+					     0.11 * in[2] + 0.5)));
+  }
+}
+
+void GfxDeviceRGBColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < 3 * n; ++j) {
+    out[j] = colToByte(clip01(in[j]));
+  }
+}
+
+void GfxDeviceRGBColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp c, m, y, k;
+  int j;
+
+  for (j = 0; j < n; ++j, in += 3, out += 4) {
+    c = clip01(gfxColorComp1 - in[0]);
+    m = clip01(gfxColorComp1 - in[1]);
+    y = clip01(gfxColorComp1 - in[2]);
+    k = c;
+    if (m < k) {
+      k = m;
+    }
+    if (y < k) {
+      k = y;
+    }
+    out[0] = colToByte(c - k);
+    out[1] = colToByte(m - k);
+    out[2] = colToByte(y - k);
+    out[3] = colToByte(k);
+  }
+}
+
 
 void GfxDeviceRGBColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
@@ -517,6 +704,46 @@ void GfxCalRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+void GfxCalRGBColorSpace::getGrayLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, in += 3) {
+    out[j] = colToByte(clip01((GfxColorComp)(0.299 * in[0] +
+					     0.587 * in[1] +
+					     0.114 * in[2] + 0.5)));
+  }
+}
+
+void GfxCalRGBColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < 3 * n; ++j) {
+    out[j] = colToByte(clip01(in[j]));
+  }
+}
+
+void GfxCalRGBColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp c, m, y, k;
+  int j;
+
+  for (j = 0; j < n; ++j, in += 3, out += 4) {
+    c = clip01(gfxColorComp1 - in[0]);
+    m = clip01(gfxColorComp1 - in[1]);
+    y = clip01(gfxColorComp1 - in[2]);
+    k = c;
+    if (m < k) {
+      k = m;
+    }
+    if (y < k) {
+      k = y;
+    }
+    out[0] = colToByte(c - k);
+    out[1] = colToByte(m - k);
+    out[2] = colToByte(y - k);
+    out[3] = colToByte(k);
+  }
+}
+
 
 void GfxCalRGBColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
@@ -549,18 +776,16 @@ void GfxDeviceCMYKColorSpace::getGray(GfxColor *color, GfxGray *gray) {
 				- 0.11 * color->c[2] + 0.5));
 }
 
-void GfxDeviceCMYKColorSpace::getRGB(GfxColor *color, GfxRGB *rgb) {
-  double c, m, y, k, c1, m1, y1, k1, r, g, b, x;
+// Convert CMYK to RGB.  This is a matrix multiplication over the 16
+// corners of the CMYK cube, unrolled for performance.
+static inline void cmykToRGB(double c, double m, double y, double k,
+			     double *rA, double *gA, double *bA) {
+  double c1, m1, y1, k1, r, g, b, x;
 
-  c = colToDbl(color->c[0]);
-  m = colToDbl(color->c[1]);
-  y = colToDbl(color->c[2]);
-  k = colToDbl(color->c[3]);
   c1 = 1 - c;
   m1 = 1 - m;
   y1 = 1 - y;
   k1 = 1 - k;
-  // this is a matrix multiplication, unrolled for performance
   //                        C M Y K
   x = c1 * m1 * y1 * k1; // 0 0 0 0
   r = g = b = x;
@@ -606,6 +831,111 @@ void GfxDeviceCMYKColorSpace::getRGB(GfxColor *color, GfxRGB *rgb) {
   r += 0.2118 * x;
   g += 0.2119 * x;
   b += 0.2235 * x;
+  *rA = r;
+  *gA = g;
+  *bA = b;
+}
+
+#if HAVE_VEC_CMYK
+// Same as cmykToRGB, but for four pixels at a time.  The operations
+// are done in the same order, so the results are bit-identical to
+// the scalar code.  This is always inlined, so that it picks up the
+// instruction set of the caller.
+__attribute__((always_inline))
+static inline void cmykToRGB4(GfxDblVec4 *cmyk, GfxDblVec4 *rgb) {
+  GfxDblVec4 c, m, y, k, c1, m1, y1, k1, r, g, b, x;
+
+  c = cmyk[0];
+  m = cmyk[1];
+  y = cmyk[2];
+  k = cmyk[3];
+  c1 = 1 - c;
+  m1 = 1 - m;
+  y1 = 1 - y;
+  k1 = 1 - k;
+  //                        C M Y K
+  x = c1 * m1 * y1 * k1; // 0 0 0 0
+  r = g = b = x;
+  x = c1 * m1 * y1 * k;  // 0 0 0 1
+  r += 0.1373 * x;
+  g += 0.1216 * x;
+  b += 0.1255 * x;
+  x = c1 * m1 * y  * k1; // 0 0 1 0
+  r += x;
+  g += 0.9490 * x;
+  x = c1 * m1 * y  * k;  // 0 0 1 1
+  r += 0.1098 * x;
+  g += 0.1020 * x;
+  x = c1 * m  * y1 * k1; // 0 1 0 0
+  r += 0.9255 * x;
+  b += 0.5490 * x;
+  x = c1 * m  * y1 * k;  // 0 1 0 1
+  r += 0.1412 * x;
+  x = c1 * m  * y  * k1; // 0 1 1 0
+  r += 0.9294 * x;
+  g += 0.1098 * x;
+  b += 0.1412 * x;
+  x = c1 * m  * y  * k;  // 0 1 1 1
+  r += 0.1333 * x;
+  x = c  * m1 * y1 * k1; // 1 0 0 0
+  g += 0.6784 * x;
+  b += 0.9373 * x;
+  x = c  * m1 * y1 * k;  // 1 0 0 1
+  g += 0.0588 * x;
+  b += 0.1412 * x;
+  x = c  * m1 * y  * k1; // 1 0 1 0
+  g += 0.6510 * x;
+  b += 0.3137 * x;
+  x = c  * m1 * y  * k;  // 1 0 1 1
+  g += 0.0745 * x;
+  x = c  * m  * y1 * k1; // 1 1 0 0
+  r += 0.1804 * x;
+  g += 0.1922 * x;
+  b += 0.5725 * x;
+  x = c  * m  * y1 * k;  // 1 1 0 1
+  b += 0.0078 * x;
+  x = c  * m  * y  * k1; // 1 1 1 0
+  r += 0.2118 * x;
+  g += 0.2119 * x;
+  b += 0.2235 * x;
+  rgb[0] = r;
+  rgb[1] = g;
+  rgb[2] = b;
+}
+
+// Convert as many groups of four pixels as possible; returns the
+// number of pixels converted.
+__attribute__((target_clones("avx", "default")))
+static int cmykToRGBLine4(GfxColorComp *in, Guchar *out, int n) {
+  GfxDblVec4 cmyk[4], rgb[3];
+  GfxIntVec4 ri, gi, bi;
+  int i, j;
+
+  for (j = 0; j + 3 < n; j += 4, in += 16, out += 12) {
+    for (i = 0; i < 4; ++i) {
+      cmyk[i] = __builtin_convertvector(
+		    ((GfxIntVec4){in[i], in[4 + i], in[8 + i], in[12 + i]}),
+		    GfxDblVec4) / gfxColorComp1;
+    }
+    cmykToRGB4(cmyk, rgb);
+    ri = __builtin_convertvector(rgb[0] * gfxColorComp1, GfxIntVec4);
+    gi = __builtin_convertvector(rgb[1] * gfxColorComp1, GfxIntVec4);
+    bi = __builtin_convertvector(rgb[2] * gfxColorComp1, GfxIntVec4);
+    for (i = 0; i < 4; ++i) {
+      out[3*i]     = colToByte(clip01(ri[i]));
+      out[3*i + 1] = colToByte(clip01(gi[i]));
+      out[3*i + 2] = colToByte(clip01(bi[i]));
+    }
+  }
+  return j;
+}
+#endif
+
+void GfxDeviceCMYKColorSpace::getRGB(GfxColor *color, GfxRGB *rgb) {
+  double r, g, b;
+
+  cmykToRGB(colToDbl(color->c[0]), colToDbl(color->c[1]),
+	    colToDbl(color->c[2]), colToDbl(color->c[3]), &r, &g, &b);
   rgb->r = clip01(dblToCol(r));
   rgb->g = clip01(dblToCol(g));
   rgb->b = clip01(dblToCol(b));
@@ -618,6 +948,48 @@ void GfxDeviceCMYKColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(color->c[3]);
 }
 
+void GfxDeviceCMYKColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					  int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, in += 4) {
+    out[j] = colToByte(clip01((GfxColorComp)(gfxColorComp1 - in[3]
+					     - 0.3  * in[0]
+					     - 0.59 * in[1]
+					     - 0.11 * in[2] + 0.5)));
+  }
+}
+
+void GfxDeviceCMYKColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+					 int n) {
+  double r, g, b;
+  int j;
+
+#if HAVE_VEC_CMYK
+  j = cmykToRGBLine4(in, out, n);
+  in += 4 * j;
+  out += 3 * j;
+#else
+  j = 0;
+#endif
+  for (; j < n; ++j, in += 4, out += 3) {
+    cmykToRGB(colToDbl(in[0]), colToDbl(in[1]), colToDbl(in[2]),
+	      colToDbl(in[3]), &r, &g, &b);
+    out[0] = colToByte(clip01(dblToCol(r)));
+    out[1] = colToByte(clip01(dblToCol(g)));
+    out[2] = colToByte(clip01(dblToCol(b)));
+  }
+}
+
+void GfxDeviceCMYKColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out,
+					  int n) {
+  int j;
+
+  for (j = 0; j < 4 * n; ++j) {
+    out[j] = colToByte(clip01(in[j]));
+  }
+}
+
 
 void GfxDeviceCMYKColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
@@ -811,6 +1183,92 @@ void GfxLabColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
 }
 
 
+// The rest of getRGB() for one pixel, from t1 = (L* + 16) / 116,
+// ta = a* / 500 and tb = b* / 200 to 8-bit RGB.  sqrt() is the
+// correctly rounded square root, as is pow(x, 0.5) in glibc, and it
+// is much cheaper.
+inline void GfxLabColorSpace::labToRGBByte(double t1, double ta, double tb,
+					   Guchar *out) {
+  double X, Y, Z;
+  double t2;
+  double r, g, b;
+
+  t2 = t1 + ta;
+  if (t2 >= (6.0 / 29.0)) {
+    X = t2 * t2 * t2;
+  } else {
+    X = (108.0 / 841.0) * (t2 - (4.0 / 29.0));
+  }
+  X *= whiteX;
+  if (t1 >= (6.0 / 29.0)) {
+    Y = t1 * t1 * t1;
+  } else {
+    Y = (108.0 / 841.0) * (t1 - (4.0 / 29.0));
+  }
+  Y *= whiteY;
+  t2 = t1 - tb;
+  if (t2 >= (6.0 / 29.0)) {
+    Z = t2 * t2 * t2;
+  } else {
+    Z = (108.0 / 841.0) * (t2 - (4.0 / 29.0));
+  }
+  Z *= whiteZ;
+
+  r = xyzrgb[0][0] * X + xyzrgb[0][1] * Y + xyzrgb[0][2] * Z;
+  g = xyzrgb[1][0] * X + xyzrgb[1][1] * Y + xyzrgb[1][2] * Z;
+  b = xyzrgb[2][0] * X + xyzrgb[2][1] * Y + xyzrgb[2][2] * Z;
+  out[0] = colToByte(dblToCol(sqrt(clip01(r * kr))));
+  out[1] = colToByte(dblToCol(sqrt(clip01(g * kg))));
+  out[2] = colToByte(dblToCol(sqrt(clip01(b * kb))));
+}
+
+void GfxLabColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, in += 3, out += 3) {
+    if (j > 0 && in[0] == in[-3] && in[1] == in[-2] && in[2] == in[-1]) {
+      out[0] = out[-3];
+      out[1] = out[-2];
+      out[2] = out[-1];
+      continue;
+    }
+    labToRGBByte((colToDbl(in[0]) + 16) / 116, colToDbl(in[1]) / 500,
+		 colToDbl(in[2]) / 200, out);
+  }
+}
+
+void GfxLabColorSpace::getRGBByteLine(Guchar *in, double **lookup,
+				      Guchar *out, int n) {
+  int j;
+
+  for (j = 0; j < n; ++j, in += 3, out += 3) {
+    if (j > 0 && in[0] == in[-3] && in[1] == in[-2] && in[2] == in[-1]) {
+      out[0] = out[-3];
+      out[1] = out[-2];
+      out[2] = out[-1];
+      continue;
+    }
+    labToRGBByte(lookup[0][in[0]], lookup[1][in[1]], lookup[2][in[2]], out);
+  }
+}
+
+double *GfxLabColorSpace::makeLookup(int comp, GfxColorComp *values, int n) {
+  double *tab;
+  int i;
+
+  tab = (double *)gmallocn(n, sizeof(double));
+  for (i = 0; i < n; ++i) {
+    if (comp == 0) {
+      tab[i] = (colToDbl(values[i]) + 16) / 116;
+    } else if (comp == 1) {
+      tab[i] = colToDbl(values[i]) / 500;
+    } else {
+      tab[i] = colToDbl(values[i]) / 200;
+    }
+  }
+  return tab;
+}
+
 void GfxLabColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
   if (aMin > 0) {
@@ -962,6 +1420,21 @@ void GfxICCBasedColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   alt->getCMYK(color, cmyk);
 }
 
+void GfxICCBasedColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					int n) {
+  alt->getGrayLine(in, out, n);
+}
+
+void GfxICCBasedColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+				       int n) {
+  alt->getRGBLine(in, out, n);
+}
+
+void GfxICCBasedColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out,
+					int n) {
+  alt->getCMYKLine(in, out, n);
+}
+
 
 void GfxICCBasedColorSpace::getDefaultColor(GfxColor *color) {
   int i;
@@ -1136,6 +1609,61 @@ void GfxIndexedColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   base->getCMYK(mapColorToBase(color, &color2), cmyk);
 }
 
+// Map a line of <n> indexes to base color space components.  The
+// returned buffer is reused by the next call (see getLineBuf).
+GfxColorComp *GfxIndexedColorSpace::mapLineToBase(GfxColorComp *in, int n) {
+  GfxColorComp *buf, *q;
+  GfxColorComp entry[gfxColorMaxComps];
+  double low[gfxColorMaxComps], range[gfxColorMaxComps];
+  Guchar *p;
+  int nBase, idx, lastIdx, i, j;
+
+  nBase = base->getNComps();
+  base->getDefaultRanges(low, range, indexHigh);
+  buf = getLineBuf(n * nBase);
+  lastIdx = -1;
+  for (j = 0, q = buf; j < n; ++j, q += nBase) {
+    idx = (int)(colToDbl(in[j]) + 0.5);
+    if (idx < 0) {
+      idx = 0;
+    } else if (idx > indexHigh) {
+      idx = indexHigh;
+    }
+    if (idx != lastIdx) {
+      p = &lookup[idx * nBase];
+      for (i = 0; i < nBase; ++i) {
+	entry[i] = dblToCol(low[i] + (p[i] / 255.0) * range[i]);
+      }
+      lastIdx = idx;
+    }
+    for (i = 0; i < nBase; ++i) {
+      q[i] = entry[i];
+    }
+  }
+  return buf;
+}
+
+void GfxIndexedColorSpace::getGrayLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToBase(in, n);
+  base->getGrayLine(buf, out, n);
+}
+
+void GfxIndexedColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToBase(in, n);
+  base->getRGBLine(buf, out, n);
+}
+
+void GfxIndexedColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToBase(in, n);
+  base->getCMYKLine(buf, out, n);
+}
+
 
 void GfxIndexedColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
@@ -1158,6 +1686,7 @@ GfxSeparationColorSpace::GfxSeparationColorSpace(GString *nameA,
   name = nameA;
   alt = altA;
   func = funcA;
+  lut = NULL;
   nonMarking = !name->cmp("None");
   if (!name->cmp("Cyan")) {
     overprintMask = 0x01;
@@ -1178,6 +1707,7 @@ GfxSeparationColorSpace::GfxSeparationColorSpace(GString *nameA,
   name = nameA;
   alt = altA;
   func = funcA;
+  lut = NULL;
   nonMarking = nonMarkingA;
   overprintMask = overprintMaskA;
 }
@@ -1186,6 +1716,9 @@ GfxSeparationColorSpace::~GfxSeparationColorSpace() {
   delete name;
   delete alt;
   delete func;
+  if (lut) {
+    delete lut;
+  }
 }
 
 GfxColorSpace *GfxSeparationColorSpace::copy() {
@@ -1243,45 +1776,89 @@ GfxColorSpace *GfxSeparationColorSpace::parse(Array *arr,
 
 
 void GfxSeparationColorSpace::getGray(GfxColor *color, GfxGray *gray) {
-  double x;
-  double c[gfxColorMaxComps];
   GfxColor color2;
-  int i;
 
-  x = colToDbl(color->c[0]);
-  func->transform(&x, c);
-  for (i = 0; i < alt->getNComps(); ++i) {
-    color2.c[i] = dblToCol(c[i]);
-  }
+  mapToAlt(color, &color2);
   alt->getGray(&color2, gray);
 }
 
 void GfxSeparationColorSpace::getRGB(GfxColor *color, GfxRGB *rgb) {
-  double x;
-  double c[gfxColorMaxComps];
   GfxColor color2;
-  int i;
 
-  x = colToDbl(color->c[0]);
-  func->transform(&x, c);
-  for (i = 0; i < alt->getNComps(); ++i) {
-    color2.c[i] = dblToCol(c[i]);
-  }
+  mapToAlt(color, &color2);
   alt->getRGB(&color2, rgb);
 }
 
 void GfxSeparationColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
-  double x;
-  double c[gfxColorMaxComps];
   GfxColor color2;
+
+  mapToAlt(color, &color2);
+  alt->getCMYK(&color2, cmyk);
+}
+
+// Run the tint transform on <color>, producing the alternate color
+// space color <color2>.  The transform is sampled into a lookup table
+// the first time, so shadings and images don't run it per pixel.
+void GfxSeparationColorSpace::mapToAlt(GfxColor *color, GfxColor *color2) {
+  double c[gfxColorMaxComps];
   int i;
 
-  x = colToDbl(color->c[0]);
-  func->transform(&x, c);
+  if (!lut) {
+    lut = new FunctionLUT(&func, 1, 0, 1, gfxTintLUTSamples);
+  }
+  lut->lookup(colToDbl(color->c[0]), c);
   for (i = 0; i < alt->getNComps(); ++i) {
-    color2.c[i] = dblToCol(c[i]);
+    color2->c[i] = dblToCol(c[i]);
   }
-  alt->getCMYK(&color2, cmyk);
+}
+
+// Run the tint transform on a line of <n> pixels, producing
+// alternate color space components.  The returned buffer is reused by
+// the next call (see getLineBuf).
+GfxColorComp *GfxSeparationColorSpace::mapLineToAlt(GfxColorComp *in, int n) {
+  GfxColorComp *buf, *q;
+  GfxColor color, color2;
+  int nAlt, i, j;
+
+  nAlt = alt->getNComps();
+  buf = getLineBuf(n * nAlt);
+  for (j = 0, q = buf; j < n; ++j, q += nAlt) {
+    if (j > 0 && in[j] == in[j - 1]) {
+      for (i = 0; i < nAlt; ++i) {
+	q[i] = q[i - nAlt];
+      }
+      continue;
+    }
+    color.c[0] = in[j];
+    mapToAlt(&color, &color2);
+    for (i = 0; i < nAlt; ++i) {
+      q[i] = color2.c[i];
+    }
+  }
+  return buf;
+}
+
+void GfxSeparationColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					  int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToAlt(in, n);
+  alt->getGrayLine(buf, out, n);
+}
+
+void GfxSeparationColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToAlt(in, n);
+  alt->getRGBLine(buf, out, n);
+}
+
+void GfxSeparationColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out,
+					  int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToAlt(in, n);
+  alt->getCMYKLine(buf, out, n);
 }
 
 
@@ -1302,6 +1879,7 @@ GfxDeviceNColorSpace::GfxDeviceNColorSpace(int nCompsA,
   nComps = nCompsA;
   alt = altA;
   func = funcA;
+  lut = NULL;
   nonMarking = gTrue;
   overprintMask = 0;
   for (i = 0; i < nComps; ++i) {
@@ -1334,6 +1912,7 @@ GfxDeviceNColorSpace::GfxDeviceNColorSpace(int nCompsA,
   nComps = nCompsA;
   alt = altA;
   func = funcA;
+  lut = NULL;
   nonMarking = nonMarkingA;
   overprintMask = overprintMaskA;
   for (i = 0; i < nComps; ++i) {
@@ -1349,6 +1928,9 @@ GfxDeviceNColorSpace::~GfxDeviceNColorSpace() {
   }
   delete alt;
   delete func;
+  if (lut) {
+    delete lut;
+  }
 }
 
 GfxColorSpace *GfxDeviceNColorSpace::copy() {
@@ -1425,48 +2007,96 @@ GfxColorSpace *GfxDeviceNColorSpace::parse(Array *arr,
 
 
 void GfxDeviceNColorSpace::getGray(GfxColor *color, GfxGray *gray) {
-  double x[gfxColorMaxComps], c[gfxColorMaxComps];
   GfxColor color2;
-  int i;
 
-  for (i = 0; i < nComps; ++i) {
-    x[i] = colToDbl(color->c[i]);
-  }
-  func->transform(x, c);
-  for (i = 0; i < alt->getNComps(); ++i) {
-    color2.c[i] = dblToCol(c[i]);
-  }
+  mapToAlt(color, &color2);
   alt->getGray(&color2, gray);
 }
 
 void GfxDeviceNColorSpace::getRGB(GfxColor *color, GfxRGB *rgb) {
-  double x[gfxColorMaxComps], c[gfxColorMaxComps];
   GfxColor color2;
-  int i;
 
-  for (i = 0; i < nComps; ++i) {
-    x[i] = colToDbl(color->c[i]);
-  }
-  func->transform(x, c);
-  for (i = 0; i < alt->getNComps(); ++i) {
-    color2.c[i] = dblToCol(c[i]);
-  }
+  mapToAlt(color, &color2);
   alt->getRGB(&color2, rgb);
 }
 
 void GfxDeviceNColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
-  double x[gfxColorMaxComps], c[gfxColorMaxComps];
   GfxColor color2;
+
+  mapToAlt(color, &color2);
+  alt->getCMYK(&color2, cmyk);
+}
+
+// Run the tint transform on <color>, producing the alternate color
+// space color <color2>.  A transform of one component is sampled into
+// a lookup table (see GfxSeparationColorSpace::mapToAlt).
+void GfxDeviceNColorSpace::mapToAlt(GfxColor *color, GfxColor *color2) {
+  double x[gfxColorMaxComps], c[gfxColorMaxComps];
   int i;
 
-  for (i = 0; i < nComps; ++i) {
-    x[i] = colToDbl(color->c[i]);
+  if (nComps == 1) {
+    if (!lut) {
+      lut = new FunctionLUT(&func, 1, 0, 1, gfxTintLUTSamples);
+    }
+    lut->lookup(colToDbl(color->c[0]), c);
+  } else {
+    for (i = 0; i < nComps; ++i) {
+      x[i] = colToDbl(color->c[i]);
+    }
+    func->transform(x, c);
   }
-  func->transform(x, c);
   for (i = 0; i < alt->getNComps(); ++i) {
-    color2.c[i] = dblToCol(c[i]);
+    color2->c[i] = dblToCol(c[i]);
   }
-  alt->getCMYK(&color2, cmyk);
+}
+
+// Run the tint transform on a line of <n> pixels, producing
+// alternate color space components.  The returned buffer is reused by
+// the next call (see getLineBuf).
+GfxColorComp *GfxDeviceNColorSpace::mapLineToAlt(GfxColorComp *in, int n) {
+  GfxColorComp *buf, *q;
+  GfxColor color, color2;
+  int nAlt, i, j;
+
+  nAlt = alt->getNComps();
+  buf = getLineBuf(n * nAlt);
+  for (j = 0, q = buf; j < n; ++j, in += nComps, q += nAlt) {
+    if (j > 0 && !memcmp(in, in - nComps, nComps * sizeof(GfxColorComp))) {
+      for (i = 0; i < nAlt; ++i) {
+	q[i] = q[i - nAlt];
+      }
+      continue;
+    }
+    for (i = 0; i < nComps; ++i) {
+      color.c[i] = in[i];
+    }
+    mapToAlt(&color, &color2);
+    for (i = 0; i < nAlt; ++i) {
+      q[i] = color2.c[i];
+    }
+  }
+  return buf;
+}
+
+void GfxDeviceNColorSpace::getGrayLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToAlt(in, n);
+  alt->getGrayLine(buf, out, n);
+}
+
+void GfxDeviceNColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToAlt(in, n);
+  alt->getRGBLine(buf, out, n);
+}
+
+void GfxDeviceNColorSpace::getCMYKLine(GfxColorComp *in, Guchar *out, int n) {
+  GfxColorComp *buf;
+
+  buf = mapLineToAlt(in, n);
+  alt->getCMYKLine(buf, out, n);
 }
 
 
@@ -2108,6 +2738,7 @@ GfxAxialShading::GfxAxialShading(double x0A, double y0A,
   }
   extend0 = extend0A;
   extend1 = extend1A;
+  lut = NULL;
 }
 
 GfxAxialShading::GfxAxialShading(GfxAxialShading *shading):
@@ -2127,6 +2758,7 @@ GfxAxialShading::GfxAxialShading(GfxAxialShading *shading):
   }
   extend0 = shading->extend0;
   extend1 = shading->extend1;
+  lut = NULL;
 }
 
 GfxAxialShading::~GfxAxialShading() {
@@ -2135,6 +2767,9 @@ GfxAxialShading::~GfxAxialShading() {
   for (i = 0; i < nFuncs; ++i) {
     delete funcs[i];
   }
+  if (lut) {
+    delete lut;
+  }
 }
 
 GfxAxialShading *GfxAxialShading::parse(Dict *dict
@@ -2239,14 +2874,25 @@ void GfxAxialShading::getColor(double t, GfxColor *color) {
   for (i = 0; i < gfxColorMaxComps; ++i) {
     out[i] = 0;
   }
-  for (i = 0; i < nFuncs; ++i) {
-    funcs[i]->transform(&t, &out[i]);
+  if (lut) {
+    lut->lookup(t, out);
+  } else {
+    for (i = 0; i < nFuncs; ++i) {
+      funcs[i]->transform(&t, &out[i]);
+    }
   }
   for (i = 0; i < gfxColorMaxComps; ++i) {
     color->c[i] = dblToCol(out[i]);
   }
 }
 
+void GfxAxialShading::setupLUT(int nSamples) {
+  if (lut) {
+    delete lut;
+  }
+  lut = new FunctionLUT(funcs, nFuncs, t0, t1, nSamples);
+}
+
 //------------------------------------------------------------------------
 // GfxRadialShading
 //------------------------------------------------------------------------
@@ -2274,6 +2920,7 @@ GfxRadialShading::GfxRadialShading(double x0A, double y0A, double r0A,
   }
   extend0 = extend0A;
   extend1 = extend1A;
+  lut = NULL;
 }
 
 GfxRadialShading::GfxRadialShading(GfxRadialShading *shading):
@@ -2295,6 +2942,7 @@ GfxRadialShading::GfxRadialShading(GfxRadialShading *shading):
   }
   extend0 = shading->extend0;
   extend1 = shading->extend1;
+  lut = NULL;
 }
 
 GfxRadialShading::~GfxRadialShading() {
@@ -2303,6 +2951,9 @@ GfxRadialShading::~GfxRadialShading() {
   for (i = 0; i < nFuncs; ++i) {
     delete funcs[i];
   }
+  if (lut) {
+    delete lut;
+  }
 }
 
 GfxRadialShading *GfxRadialShading::parse(Dict *dict
@@ -2411,14 +3062,25 @@ void GfxRadialShading::getColor(double t, GfxColor *color) {
   for (i = 0; i < gfxColorMaxComps; ++i) {
     out[i] = 0;
   }
-  for (i = 0; i < nFuncs; ++i) {
-    funcs[i]->transform(&t, &out[i]);
+  if (lut) {
+    lut->lookup(t, out);
+  } else {
+    for (i = 0; i < nFuncs; ++i) {
+      funcs[i]->transform(&t, &out[i]);
+    }
   }
   for (i = 0; i < gfxColorMaxComps; ++i) {
     color->c[i] = dblToCol(out[i]);
   }
 }
 
+void GfxRadialShading::setupLUT(int nSamples) {
+  if (lut) {
+    delete lut;
+  }
+  lut = new FunctionLUT(funcs, nFuncs, t0, t1, nSamples);
+}
+
 //------------------------------------------------------------------------
 // GfxShadingBitBuf
 //------------------------------------------------------------------------
@@ -3419,7 +4081,11 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
   for (k = 0; k < gfxColorMaxComps; ++k) {
     lookup[k] = NULL;
     lookup2[k] = NULL;
+    byteLookup[k] = NULL;
   }
+  labLookup[0] = labLookup[1] = labLookup[2] = NULL;
+  lineBuf = NULL;
+  lineBufSize = 0;
 
   // get decode map
   if (decode->isNull()) {
@@ -3513,6 +4179,8 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
     }
   }
 
+  initByteLookup();
+
   return;
 
  err2:
@@ -3532,7 +4200,11 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
   for (k = 0; k < gfxColorMaxComps; ++k) {
     lookup[k] = NULL;
     lookup2[k] = NULL;
+    byteLookup[k] = NULL;
   }
+  labLookup[0] = labLookup[1] = labLookup[2] = NULL;
+  lineBuf = NULL;
+  lineBufSize = 0;
   if (bits <= 8) {
   n = 1 << bits;
   } else {
@@ -3559,6 +4231,7 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
     decodeLow[i] = colorMap->decodeLow[i];
     decodeRange[i] = colorMap->decodeRange[i];
   }
+  initByteLookup();
   ok = gTrue;
 }
 
@@ -3569,7 +4242,61 @@ GfxImageColorMap::~GfxImageColorMap() {
   for (i = 0; i < gfxColorMaxComps; ++i) {
     gfree(lookup[i]);
     gfree(lookup2[i]);
+    gfree(byteLookup[i]);
+  }
+  for (i = 0; i < 3; ++i) {
+    gfree(labLookup[i]);
   }
+  gfree(lineBuf);
+}
+
+// Optimization: for the device and calibrated gray/RGB/CMYK color
+// spaces (possibly as the alternate of an ICCBased space),
+// converting to the matching output mode is just a clip, so the
+// decode lookup can be folded into a table mapping image pixel
+// components directly to output bytes.  For Lab, the first step of
+// the conversion to RGB is folded into a table instead.
+void GfxImageColorMap::initByteLookup() {
+  GfxColorSpace *cs;
+  int maxPixel, i, k;
+
+  if (bits <= 8) {
+    maxPixel = (1 << bits) - 1;
+  } else {
+    maxPixel = 0xff;
+  }
+  if (colorSpace->getMode() == csLab) {
+    for (k = 0; k < 3; ++k) {
+      labLookup[k] = ((GfxLabColorSpace *)colorSpace)->makeLookup(k,
+				       lookup[k], maxPixel + 1);
+    }
+  }
+
+  cs = colorSpace;
+  if (cs->getMode() == csICCBased) {
+    cs = ((GfxICCBasedColorSpace *)cs)->getAlt();
+  }
+  byteLookupMode = cs->getMode();
+  if (byteLookupMode != csDeviceGray && byteLookupMode != csCalGray &&
+      byteLookupMode != csDeviceRGB && byteLookupMode != csCalRGB &&
+      byteLookupMode != csDeviceCMYK) {
+    return;
+  }
+  for (k = 0; k < nComps; ++k) {
+    byteLookup[k] = (Guchar *)gmalloc(maxPixel + 1);
+    for (i = 0; i <= maxPixel; ++i) {
+      byteLookup[k][i] = colToByte(clip01(lookup[k][i]));
+    }
+  }
+}
+
+GfxColorComp *GfxImageColorMap::getLineBuf(int size) {
+  if (size > lineBufSize) {
+    gfree(lineBuf);
+    lineBuf = (GfxColorComp *)gmallocn(size, sizeof(GfxColorComp));
+    lineBufSize = size;
+  }
+  return lineBuf;
 }
 
 void GfxImageColorMap::getGray(Guchar *x, GfxGray *gray) {
@@ -3638,84 +4365,97 @@ void GfxImageColorMap::getColor(Guchar *x, GfxColor *color) {
 }
 
 void GfxImageColorMap::getGrayByteLine(Guchar *in, Guchar *out, int n) {
-  GfxColor color;
-  GfxGray gray;
+  GfxColorComp *buf;
   int i, j;
 
-  if (colorSpace2) {
+  if (byteLookup[0] &&
+      (byteLookupMode == csDeviceGray || byteLookupMode == csCalGray)) {
+    for (j = 0; j < n; ++j) {
+      out[j] = byteLookup[0][in[j]];
+    }
+  } else if (colorSpace2) {
+    buf = getLineBuf(n * nComps2);
     for (j = 0; j < n; ++j) {
       for (i = 0; i < nComps2; ++i) {
-	color.c[i] = lookup2[i][in[j]];
+	buf[j * nComps2 + i] = lookup2[i][in[j]];
       }
-      colorSpace2->getGray(&color, &gray);
-      out[j] = colToByte(gray);
     }
+    colorSpace2->getGrayLine(buf, out, n);
   } else {
-    for (j = 0; j < n; ++j) {
+    buf = getLineBuf(n * nComps);
+    for (j = 0; j < n * nComps; j += nComps) {
       for (i = 0; i < nComps; ++i) {
-	color.c[i] = lookup[i][in[j * nComps + i]];
+	buf[j + i] = lookup[i][in[j + i]];
       }
-      colorSpace->getGray(&color, &gray);
-      out[j] = colToByte(gray);
     }
+    colorSpace->getGrayLine(buf, out, n);
   }
 }
 
 void GfxImageColorMap::getRGBByteLine(Guchar *in, Guchar *out, int n) {
-  GfxColor color;
-  GfxRGB rgb;
+  GfxColorComp *buf;
   int i, j;
 
-  if (colorSpace2) {
+  if (byteLookup[0] &&
+      (byteLookupMode == csDeviceGray || byteLookupMode == csCalGray)) {
+    for (j = 0; j < n; ++j, out += 3) {
+      out[0] = out[1] = out[2] = byteLookup[0][in[j]];
+    }
+  } else if (byteLookup[0] &&
+	     (byteLookupMode == csDeviceRGB || byteLookupMode == csCalRGB)) {
+    for (j = 0; j < n; ++j, in += 3, out += 3) {
+      out[0] = byteLookup[0][in[0]];
+      out[1] = byteLookup[1][in[1]];
+      out[2] = byteLookup[2][in[2]];
+    }
+  } else if (labLookup[0]) {
+    ((GfxLabColorSpace *)colorSpace)->getRGBByteLine(in, labLookup, out, n);
+  } else if (colorSpace2) {
+    buf = getLineBuf(n * nComps2);
     for (j = 0; j < n; ++j) {
       for (i = 0; i < nComps2; ++i) {
-	color.c[i] = lookup2[i][in[j]];
+	buf[j * nComps2 + i] = lookup2[i][in[j]];
       }
-      colorSpace2->getRGB(&color, &rgb);
-      out[j*3] = colToByte(rgb.r);
-      out[j*3 + 1] = colToByte(rgb.g);
-      out[j*3 + 2] = colToByte(rgb.b);
     }
+    colorSpace2->getRGBLine(buf, out, n);
   } else {
-    for (j = 0; j < n; ++j) {
+    buf = getLineBuf(n * nComps);
+    for (j = 0; j < n * nComps; j += nComps) {
       for (i = 0; i < nComps; ++i) {
-	color.c[i] = lookup[i][in[j * nComps + i]];
+	buf[j + i] = lookup[i][in[j + i]];
       }
-      colorSpace->getRGB(&color, &rgb);
-      out[j*3] = colToByte(rgb.r);
-      out[j*3 + 1] = colToByte(rgb.g);
-      out[j*3 + 2] = colToByte(rgb.b);
     }
+    colorSpace->getRGBLine(buf, out, n);
   }
 }
 
 void GfxImageColorMap::getCMYKByteLine(Guchar *in, Guchar *out, int n) {
-  GfxColor color;
-  GfxCMYK cmyk;
+  GfxColorComp *buf;
   int i, j;
 
-  if (colorSpace2) {
+  if (byteLookup[0] && byteLookupMode == csDeviceCMYK) {
+    for (j = 0; j < n; ++j, in += 4, out += 4) {
+      out[0] = byteLookup[0][in[0]];
+      out[1] = byteLookup[1][in[1]];
+      out[2] = byteLookup[2][in[2]];
+      out[3] = byteLookup[3][in[3]];
+    }
+  } else if (colorSpace2) {
+    buf = getLineBuf(n * nComps2);
     for (j = 0; j < n; ++j) {
       for (i = 0; i < nComps2; ++i) {
-	color.c[i] = lookup2[i][in[j]];
+	buf[j * nComps2 + i] = lookup2[i][in[j]];
       }
-      colorSpace2->getCMYK(&color, &cmyk);
-      out[j*4] = colToByte(cmyk.c);
-      out[j*4 + 1] = colToByte(cmyk.m);
-      out[j*4 + 2] = colToByte(cmyk.y);
-      out[j*4 + 3] = colToByte(cmyk.k);
     }
+    colorSpace2->getCMYKLine(buf, out, n);
   } else {
-    for (j = 0; j < n; ++j) {
+    buf = getLineBuf(n * nComps);
+    for (j = 0; j < n * nComps; j += nComps) {
       for (i = 0; i < nComps; ++i) {
-	color.c[i] = lookup[i][in[j * nComps + i]];
+	buf[j + i] = lookup[i][in[j + i]];
       }
-      colorSpace->getCMYK(&color, &cmyk);
-      out[j*4] = colToByte(cmyk.c);
-      out[j*4 + 1] = colToByte(cmyk.m);
-      out[j*4 + 2] = colToByte(cmyk.y);
-      out[j*4 + 3] = colToByte(cmyk.k);
     }
+    colorSpace->getCMYKLine(buf, out, n);
   }
 }
 
@@ -4007,6 +4747,7 @@ GfxState::GfxState(double hDPIA, double vDPIA, PDFRectangle *pageBox,
   leading = 0;
   rise = 0;
   render = 0;
+  textParamsSet = 0;
 
   path = new GfxPath();
   curX = curY = 0;
@@ -4231,6 +4972,7 @@ void GfxState::setFillColorSpace(GfxColorSpace *colorSpace) {
     delete fillColorSpace;
   }
   fillColorSpace = colorSpace;
+  textParamsSet |= gfxTextFillColor;
 }
 
 void GfxState::setStrokeColorSpace(GfxColorSpace *colorSpace) {
@@ -4238,6 +4980,7 @@ void GfxState::setStrokeColorSpace(GfxColorSpace *colorSpace) {
     delete strokeColorSpace;
   }
   strokeColorSpace = colorSpace;
+  textParamsSet |= gfxTextStrokeColor;
 }
 
 void GfxState::setFillPattern(GfxPattern *pattern) {
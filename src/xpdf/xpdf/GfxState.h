@@ -47,6 +47,25 @@ enum GfxBlendMode {
   gfxBlendLuminosity
 };
 
+//------------------------------------------------------------------------
+// GfxTextParam
+//------------------------------------------------------------------------
+
+// Graphics state parameters that text drawing depends on (see
+// GfxState::getTextParamsSet).
+enum GfxTextParam {
+  gfxTextFont = 0x001,		// font and font size
+  gfxTextMatrix = 0x002,
+  gfxTextCharSpace = 0x004,
+  gfxTextWordSpace = 0x008,
+  gfxTextHorizScaling = 0x010,
+  gfxTextLeading = 0x020,
+  gfxTextRise = 0x040,
+  gfxTextRender = 0x080,
+  gfxTextFillColor = 0x100,	// fill color and color space
+  gfxTextStrokeColor = 0x200	// stroke color and color space
+};
+
 //------------------------------------------------------------------------
 // GfxColorComp
 //------------------------------------------------------------------------
@@ -153,6 +172,14 @@ public:
   virtual void getRGB(GfxColor *color, GfxRGB *rgb) = 0;
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk) = 0;
 
+  // Convert a line of <n> pixels to 8-bit gray, RGB, or CMYK.  <in>
+  // holds getNComps() components per pixel, <out> gets 1, 3, or 4
+  // bytes per pixel.  The default implementations call getGray(),
+  // getRGB(), or getCMYK() once per run of identical pixels.
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
+
   // Return the number of color components.
   virtual int getNComps() = 0;
 
@@ -179,7 +206,16 @@ public:
 
 protected:
 
+  // Get a buffer of at least <size> components for the line
+  // conversions, owned by the color space and reused by the next call.
+  GfxColorComp *getLineBuf(int size);
+
   Guint overprintMask;
+
+private:
+
+  GfxColorComp *lineBuf;	// buffer for the line conversions
+  int lineBufSize;		// size of lineBuf, in GfxColorComps
 };
 
 //------------------------------------------------------------------------
@@ -197,6 +233,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return 1; }
   virtual void getDefaultColor(GfxColor *color);
@@ -222,6 +261,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return 1; }
   virtual void getDefaultColor(GfxColor *color);
@@ -257,6 +299,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -282,6 +327,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -321,6 +369,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return 4; }
   virtual void getDefaultColor(GfxColor *color);
@@ -346,6 +397,16 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+
+  // Convert a line of <n> 8-bit image pixels to RGB.  <lookup> holds
+  // the per-image tables built by makeLookup() for the three
+  // components.
+  void getRGBByteLine(Guchar *in, double **lookup, Guchar *out, int n);
+
+  // Build the table of component <comp> used by getRGBByteLine() from
+  // the <n> decoded values of an image's pixels.
+  double *makeLookup(int comp, GfxColorComp *values, int n);
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -371,6 +432,8 @@ private:
   double blackX, blackY, blackZ;    // black point
   double aMin, aMax, bMin, bMax;    // range for the a and b components
   double kr, kg, kb;		    // gamut mapping mulitpliers
+
+  void labToRGBByte(double t1, double ta, double tb, Guchar *out);
 };
 
 //------------------------------------------------------------------------
@@ -393,6 +456,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return nComps; }
   virtual void getDefaultColor(GfxColor *color);
@@ -431,6 +497,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return 1; }
   virtual void getDefaultColor(GfxColor *color);
@@ -446,6 +515,8 @@ public:
 
 private:
 
+  GfxColorComp *mapLineToBase(GfxColorComp *in, int n);
+
   GfxColorSpace *base;		// base color space
   int indexHigh;		// max pixel value
   Guchar *lookup;		// lookup table
@@ -471,6 +542,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return 1; }
   virtual void getDefaultColor(GfxColor *color);
@@ -487,10 +561,13 @@ private:
   GfxSeparationColorSpace(GString *nameA, GfxColorSpace *altA,
 			  Function *funcA, GBool nonMarkingA,
 			  Guint overprintMaskA);
+  void mapToAlt(GfxColor *color, GfxColor *color2);
+  GfxColorComp *mapLineToAlt(GfxColorComp *in, int n);
 
   GString *name;		// colorant name
   GfxColorSpace *alt;		// alternate color space
   Function *func;		// tint transform (into alternate color space)
+  FunctionLUT *lut;		// samples of func, made on first use
   GBool nonMarking;
 };
 
@@ -514,6 +591,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int n);
+  virtual void getCMYKLine(GfxColorComp *in, Guchar *out, int n);
 
   virtual int getNComps() { return nComps; }
   virtual void getDefaultColor(GfxColor *color);
@@ -530,12 +610,16 @@ private:
   GfxDeviceNColorSpace(int nCompsA, GString **namesA,
 		       GfxColorSpace *alt, Function *func,
 		       GBool nonMarkingA, Guint overprintMaskA);
+  void mapToAlt(GfxColor *color, GfxColor *color2);
+  GfxColorComp *mapLineToAlt(GfxColorComp *in, int n);
 
   int nComps;			// number of components
   GString			// colorant names
     *names[gfxColorMaxComps];
   GfxColorSpace *alt;		// alternate color space
   Function *func;		// tint transform (into alternate color space)
+  FunctionLUT *lut;		// samples of func if it has one input, made
+				//   on first use
   GBool nonMarking;
 };
 
@@ -756,6 +840,13 @@ public:
   Function *getFunc(int i) { return funcs[i]; }
   void getColor(double t, GfxColor *color);
 
+  // Pre-sample the shading functions into a lookup table with
+  // <nSamples> entries across the domain; getColor() then
+  // interpolates in the table instead of calling the functions.
+  // Callers that evaluate the shading per pixel should pass the
+  // length of the t axis in device pixels.
+  void setupLUT(int nSamples);
+
 private:
 
   double x0, y0, x1, y1;
@@ -763,6 +854,7 @@ private:
   Function *funcs[gfxColorMaxComps];
   int nFuncs;
   GBool extend0, extend1;
+  FunctionLUT *lut;
 };
 
 //------------------------------------------------------------------------
@@ -796,6 +888,13 @@ public:
   Function *getFunc(int i) { return funcs[i]; }
   void getColor(double t, GfxColor *color);
 
+  // Pre-sample the shading functions into a lookup table with
+  // <nSamples> entries across the domain; getColor() then
+  // interpolates in the table instead of calling the functions.
+  // Callers that evaluate the shading per pixel should pass the
+  // length of the t axis in device pixels.
+  void setupLUT(int nSamples);
+
 private:
 
   double x0, y0, r0, x1, y1, r1;
@@ -803,6 +902,7 @@ private:
   Function *funcs[gfxColorMaxComps];
   int nFuncs;
   GBool extend0, extend1;
+  FunctionLUT *lut;
 };
 
 //------------------------------------------------------------------------
@@ -928,6 +1028,8 @@ public:
 private:
 
   GfxImageColorMap(GfxImageColorMap *colorMap);
+  void initByteLookup();
+  GfxColorComp *getLineBuf(int size);
 
   GfxColorSpace *colorSpace;	// the image color space
   int bits;			// bits per component
@@ -938,6 +1040,13 @@ private:
     lookup[gfxColorMaxComps];
   GfxColorComp *		// optimized case lookup table
     lookup2[gfxColorMaxComps];
+  Guchar *			// direct pixel -> 8-bit output lookup
+    byteLookup[gfxColorMaxComps];
+  GfxColorSpaceMode byteLookupMode; // color space mode for byteLookup
+  double *			// pixel -> Lab table (see GfxLabColorSpace)
+    labLookup[3];
+  GfxColorComp *lineBuf;	// buffer for the line conversions
+  int lineBufSize;		// size of lineBuf, in GfxColorComps
   double			// minimum values for each component
     decodeLow[gfxColorMaxComps];
   double			// max - min value for each component
@@ -1139,6 +1248,12 @@ public:
   double getLineX() { return lineX; }
   double getLineY() { return lineY; }
 
+  // Text parameters [GfxTextParam] changed since the last
+  // setTextParamsSet() call.  The flags are saved and restored with
+  // the rest of the state.
+  int getTextParamsSet() { return textParamsSet; }
+  void setTextParamsSet(int params) { textParamsSet = params; }
+
   // Is there a current point/path?
   GBool isCurPt() { return path->isCurPt(); }
   GBool isPath() { return path->isPath(); }
@@ -1168,10 +1283,14 @@ public:
   void concatCTM(double a, double b, double c,
 		 double d, double e, double f);
   void shiftCTM(double tx, double ty);
+  void setClipBBox(double xMin, double yMin, double xMax, double yMax)
+    { clipXMin = xMin; clipYMin = yMin; clipXMax = xMax; clipYMax = yMax; }
   void setFillColorSpace(GfxColorSpace *colorSpace);
   void setStrokeColorSpace(GfxColorSpace *colorSpace);
-  void setFillColor(GfxColor *color) { fillColor = *color; }
-  void setStrokeColor(GfxColor *color) { strokeColor = *color; }
+  void setFillColor(GfxColor *color)
+    { fillColor = *color; textParamsSet |= gfxTextFillColor; }
+  void setStrokeColor(GfxColor *color)
+    { strokeColor = *color; textParamsSet |= gfxTextStrokeColor; }
   void setFillPattern(GfxPattern *pattern);
   void setStrokePattern(GfxPattern *pattern);
   void setBlendMode(GfxBlendMode mode) { blendMode = mode; }
@@ -1189,23 +1308,24 @@ public:
   void setMiterLimit(double limit) { miterLimit = limit; }
   void setStrokeAdjust(GBool sa) { strokeAdjust = sa; }
   void setFont(GfxFont *fontA, double fontSizeA)
-    { font = fontA; fontSize = fontSizeA; }
+    { font = fontA; fontSize = fontSizeA; textParamsSet |= gfxTextFont; }
   void setTextMat(double a, double b, double c,
 		  double d, double e, double f)
     { textMat[0] = a; textMat[1] = b; textMat[2] = c;
-      textMat[3] = d; textMat[4] = e; textMat[5] = f; }
+      textMat[3] = d; textMat[4] = e; textMat[5] = f;
+      textParamsSet |= gfxTextMatrix; }
   void setCharSpace(double space)
-    { charSpace = space; }
+    { charSpace = space; textParamsSet |= gfxTextCharSpace; }
   void setWordSpace(double space)
-    { wordSpace = space; }
+    { wordSpace = space; textParamsSet |= gfxTextWordSpace; }
   void setHorizScaling(double scale)
-    { horizScaling = 0.01 * scale; }
+    { horizScaling = 0.01 * scale; textParamsSet |= gfxTextHorizScaling; }
   void setLeading(double leadingA)
-    { leading = leadingA; }
+    { leading = leadingA; textParamsSet |= gfxTextLeading; }
   void setRise(double riseA)
-    { rise = riseA; }
+    { rise = riseA; textParamsSet |= gfxTextRise; }
   void setRender(int renderA)
-    { render = renderA; }
+    { render = renderA; textParamsSet |= gfxTextRender; }
 
   // Add to path.
   void moveTo(double x, double y)
@@ -1283,6 +1403,7 @@ private:
   double leading;		// text leading
   double rise;			// text rise
   int render;			// text rendering mode
+  int textParamsSet;		// text parameters changed [GfxTextParam]
 
   GfxPath *path;		// array of path elements
   double curX, curY;		// current point (user coords)
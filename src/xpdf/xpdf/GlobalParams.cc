@@ -53,19 +53,31 @@
 #  define strncasecmp strnicmp
 #endif
 
+// The UnicodeMap and CMap caches are hit for every font and every
+// text page, but only change on a miss, so they use reader/writer
+// locks: lookups of already cached entries run concurrently and only
+// parsing a new map takes the exclusive lock.
 #if MULTITHREADED
 #  define lockGlobalParams            gLockMutex(&mutex)
-#  define lockUnicodeMapCache         gLockMutex(&unicodeMapCacheMutex)
-#  define lockCMapCache               gLockMutex(&cMapCacheMutex)
+#  define lockUnicodeMapCacheRead     gLockRead(&unicodeMapCacheLock)
+#  define lockUnicodeMapCache         gLockWrite(&unicodeMapCacheLock)
+#  define lockCMapCacheRead           gLockRead(&cMapCacheLock)
+#  define lockCMapCache               gLockWrite(&cMapCacheLock)
 #  define unlockGlobalParams          gUnlockMutex(&mutex)
-#  define unlockUnicodeMapCache       gUnlockMutex(&unicodeMapCacheMutex)
-#  define unlockCMapCache             gUnlockMutex(&cMapCacheMutex)
+#  define unlockUnicodeMapCacheRead   gUnlockRead(&unicodeMapCacheLock)
+#  define unlockUnicodeMapCache       gUnlockWrite(&unicodeMapCacheLock)
+#  define unlockCMapCacheRead         gUnlockRead(&cMapCacheLock)
+#  define unlockCMapCache             gUnlockWrite(&cMapCacheLock)
 #else
 #  define lockGlobalParams
+#  define lockUnicodeMapCacheRead
 #  define lockUnicodeMapCache
+#  define lockCMapCacheRead
 #  define lockCMapCache
 #  define unlockGlobalParams
+#  define unlockUnicodeMapCacheRead
 #  define unlockUnicodeMapCache
+#  define unlockCMapCacheRead
 #  define unlockCMapCache
 #endif
 
@@ -656,8 +668,8 @@ GlobalParams::GlobalParams(const char *cfgFileName) {
 
 #if MULTITHREADED
   gInitMutex(&mutex);
-  gInitMutex(&unicodeMapCacheMutex);
-  gInitMutex(&cMapCacheMutex);
+  gInitRWLock(&unicodeMapCacheLock);
+  gInitRWLock(&cMapCacheLock);
 #endif
 
   initBuiltinFontTables();
@@ -754,6 +766,8 @@ GlobalParams::GlobalParams(const char *cfgFileName) {
   vectorAntialias = gTrue;
   antialiasPrinting = gFalse;
   strokeAdjust = gTrue;
+  glyphCacheSize = 8 * 1024 * 1024;
+  bitmapPoolSize = 64 * 1024 * 1024;
   screenType = screenUnset;
   screenSize = -1;
   screenDotRadius = -1;
@@ -1161,6 +1175,12 @@ void GlobalParams::parseLine(char *buf, GString *fileName, int line) {
 		 tokens, fileName, line);
     } else if (!cmd->cmp("strokeAdjust")) {
       parseYesNo("strokeAdjust", &strokeAdjust, tokens, fileName, line);
+    } else if (!cmd->cmp("glyphCacheSize")) {
+      parseInteger("glyphCacheSize", &glyphCacheSize,
+		   tokens, fileName, line);
+    } else if (!cmd->cmp("bitmapPoolSize")) {
+      parseInteger("bitmapPoolSize", &bitmapPoolSize,
+		   tokens, fileName, line);
     } else if (!cmd->cmp("screenType")) {
       parseScreenType(tokens, fileName, line);
     } else if (!cmd->cmp("screenSize")) {
@@ -1237,7 +1257,7 @@ void GlobalParams::parseLine(char *buf, GString *fileName, int line) {
 void GlobalParams::parseNameToUnicode(GList *tokens, GString *fileName,
 					 int line) {
   GString *name;
-  char *tok1, *tok2;
+  char *tok1, *tok2, *tokPtr;
   FILE *f;
   char buf[256];
   int line2;
@@ -1256,8 +1276,8 @@ void GlobalParams::parseNameToUnicode(GList *tokens, GString *fileName,
   }
   line2 = 1;
   while (getLine(buf, sizeof(buf), f)) {
-    tok1 = strtok(buf, " \t\r\n");
-    tok2 = strtok(NULL, " \t\r\n");
+    tok1 = strtok_r(buf, " \t\r\n", &tokPtr);
+    tok2 = strtok_r(NULL, " \t\r\n", &tokPtr);
     if (tok1 && tok2) {
       sscanf(tok1, "%x", &u);
       nameToUnicode->add(tok2, u);
@@ -1949,8 +1969,8 @@ GlobalParams::~GlobalParams() {
 
 #if MULTITHREADED
   gDestroyMutex(&mutex);
-  gDestroyMutex(&unicodeMapCacheMutex);
-  gDestroyMutex(&cMapCacheMutex);
+  gDestroyRWLock(&unicodeMapCacheLock);
+  gDestroyRWLock(&cMapCacheLock);
 #endif
 
   delete [] white_spaces;
@@ -2754,6 +2774,24 @@ GBool GlobalParams::getStrokeAdjust() {
   return f;
 }
 
+int GlobalParams::getGlyphCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = glyphCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getBitmapPoolSize() {
+  int size;
+
+  lockGlobalParams;
+  size = bitmapPoolSize;
+  unlockGlobalParams;
+  return size;
+}
+
 ScreenType GlobalParams::getScreenType() {
   ScreenType t;
 
@@ -2983,9 +3021,14 @@ UnicodeMap *GlobalParams::getUnicodeMap2(GString *encodingName) {
   UnicodeMap *map;
 
   if (!(map = getResidentUnicodeMap(encodingName))) {
-    lockUnicodeMapCache;
-    map = unicodeMapCache->getUnicodeMap(encodingName);
-    unlockUnicodeMapCache;
+    lockUnicodeMapCacheRead;
+    map = unicodeMapCache->findUnicodeMap(encodingName);
+    unlockUnicodeMapCacheRead;
+    if (!map) {
+      lockUnicodeMapCache;
+      map = unicodeMapCache->getUnicodeMap(encodingName);
+      unlockUnicodeMapCache;
+    }
   }
   return map;
 }
@@ -2993,9 +3036,14 @@ UnicodeMap *GlobalParams::getUnicodeMap2(GString *encodingName) {
 CMap *GlobalParams::getCMap(GString *collection, GString *cMapName) {
   CMap *cMap;
 
-  lockCMapCache;
-  cMap = cMapCache->getCMap(collection, cMapName);
-  unlockCMapCache;
+  lockCMapCacheRead;
+  cMap = cMapCache->findCMap(collection, cMapName);
+  unlockCMapCacheRead;
+  if (!cMap) {
+    lockCMapCache;
+    cMap = cMapCache->getCMap(collection, cMapName);
+    unlockCMapCache;
+  }
   return cMap;
 }
 
@@ -3240,6 +3288,18 @@ GBool GlobalParams::setVectorAntialias(char *s) {
   return ok;
 }
 
+void GlobalParams::setGlyphCacheSize(int size) {
+  lockGlobalParams;
+  glyphCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setBitmapPoolSize(int size) {
+  lockGlobalParams;
+  bitmapPoolSize = size;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setScreenType(ScreenType t) {
   lockGlobalParams;
   screenType = t;
@@ -245,6 +245,8 @@ public:
   GBool getVectorAntialias();
   GBool getAntialiasPrinting();
   GBool getStrokeAdjust();
+  int getGlyphCacheSize();
+  int getBitmapPoolSize();
   ScreenType getScreenType();
   int getScreenSize();
   int getScreenDotRadius();
@@ -306,6 +308,8 @@ public:
   GBool setEnableFreeType(char *s);
   GBool setAntialias(char *s);
   GBool setVectorAntialias(char *s);
+  void setGlyphCacheSize(int size);
+  void setBitmapPoolSize(int size);
   void setScreenType(ScreenType t);
   void setScreenSize(int size);
   void setScreenDotRadius(int r);
@@ -458,6 +462,10 @@ private:
   GBool vectorAntialias;	// vector anti-aliasing enable flag
   GBool antialiasPrinting;	// allow anti-aliasing when printing
   GBool strokeAdjust;		// stroke adjustment enable flag
+  int glyphCacheSize;		// size (bytes) of the rasterized glyph
+				//   cache
+  int bitmapPoolSize;		// max size (bytes) of the free bitmap
+				//   buffers kept for reuse
   ScreenType screenType;	// halftone screen type
   int screenSize;		// screen matrix size
   int screenDotRadius;		// screen dot radius
@@ -494,8 +502,8 @@ private:
 
 #if MULTITHREADED
   GMutex mutex;
-  GMutex unicodeMapCacheMutex;
-  GMutex cMapCacheMutex;
+  GRWLock unicodeMapCacheLock;
+  GRWLock cMapCacheLock;
 #endif
 };
 
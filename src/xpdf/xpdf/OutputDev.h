@@ -33,6 +33,7 @@ class Link;
 class Catalog;
 class Page;
 class Function;
+class XRef;
 
 //------------------------------------------------------------------------
 // OutputDev
@@ -70,10 +71,19 @@ public:
   // form-type XObjects will be interpreted (i.e., unrolled).
   virtual GBool useDrawForm() { return gFalse; }
 
+  // Does this device keep what a form XObject produced and replay it
+  // when the same form is drawn again (see replayForm())?
+  virtual GBool useFormCache() { return gFalse; }
+
   // Does this device use beginType3Char/endType3Char?  Otherwise,
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   virtual GBool interpretType3Chars() = 0;
 
+  // If interpretType3Chars() is true, should drawChar() also be called
+  // for each Type 3 char (before beginType3Char)?  This is used by
+  // devices that forward text to a second device (see TeeOutputDev).
+  virtual GBool needType3DrawChar() { return gFalse; }
+
   // Does this device need non-text content?
   virtual GBool needNonText() { return gTrue; }
   // Mazoea/2018/08 - upgraded to 3.04
@@ -239,6 +249,26 @@ public:
   //----- form XObjects
   virtual void drawForm(Ref id) {}
 
+  // Form XObject cache, used if useFormCache() is true.  Gfx calls
+  // replayForm() first -- if it returns true, the device has replayed
+  // the output of form <id> and the form is not interpreted.
+  // Otherwise, if beginFormRecord() returns true, the form is
+  // interpreted and endFormRecord() is called after it.  The record
+  // must not be replayed if <replayable> is false.  <inheritedParams>
+  // are the text parameters [GfxTextParam] the form used without
+  // setting them, i.e., the ones it took from <state>; replayForm()
+  // returns the ones of the replayed record.  <state> is the state
+  // the form is drawn in (before the form matrix is applied).  <id> is
+  // an object of <xref>, the same number in another document is
+  // another form.
+  virtual GBool replayForm(GfxState *state, XRef *xref, Ref id,
+			   int *inheritedParams)
+    { return gFalse; }
+  virtual GBool beginFormRecord(GfxState *state, XRef *xref, Ref id)
+    { return gFalse; }
+  virtual void endFormRecord(GfxState *state, GBool replayable,
+			     int inheritedParams) {}
+
   //----- PostScript XObjects
   virtual void psXObject(Stream *psStream, Stream *level1Stream) {}
 
@@ -253,6 +283,12 @@ public:
 			   Function *transferFunc, GfxColor *backdropColor) {}
   virtual void clearSoftMask(GfxState *state) {}
 
+  //----- non-text content
+  // Called around pattern fills and shading operators, i.e., content
+  // that is only drawn because needNonText() returned true.
+  virtual void beginNonText() {}
+  virtual void endNonText() {}
+
   //----- links
   virtual void processLink(Link *link) {}
 
@@ -306,7 +306,7 @@ PDFDoc::~PDFDoc() {
 // if necessary.
 void PDFDoc::checkHeader() {
   char hdrBuf[headerSearchSize+1];
-  char *p;
+  char *p, *tokPtr;
   int i;
 
   pdfVersion = 0;
@@ -322,7 +322,7 @@ void PDFDoc::checkHeader() {
     return;
   }
   str->moveStart(i);
-  if (!(p = strtok(&hdrBuf[i+5], " \t\n\r"))) {
+  if (!(p = strtok_r(&hdrBuf[i+5], " \t\n\r", &tokPtr))) {
     error(errSyntaxWarning, -1, "May not be a PDF file (continuing anyway)");
     return;
   }
@@ -0,0 +1,251 @@
+//========================================================================
+//
+// SplashBandRenderer.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "gmem.h"
+#include "GString.h"
+#include "GThreadPool.h"
+#include "GfxState.h"
+#include "PDFDoc.h"
+#include "SplashBitmap.h"
+#include "SplashOutputDev.h"
+#include "SplashBandRenderer.h"
+
+//------------------------------------------------------------------------
+// SplashBandRenderer
+//------------------------------------------------------------------------
+
+SplashBandRenderer::SplashBandRenderer(PDFDoc *docA, GString *ownerPassword,
+				       GString *userPassword, int nBandsA,
+				       SplashColorMode colorModeA,
+				       int bitmapRowPadA, GBool reverseVideoA,
+				       SplashColorPtr paperColorA) {
+  int i;
+
+  nBands = nBandsA;
+  if (nBands <= 0 || nBands > GThreadPool::getNumCPUs()) {
+    nBands = GThreadPool::getNumCPUs();
+  }
+  if (!docA->getFileName()) {
+    nBands = 1;
+  }
+  docs = (PDFDoc **)gmallocn(nBands, sizeof(PDFDoc *));
+  docs[0] = docA;
+  for (i = 1; i < nBands; ++i) {
+    docs[i] = new PDFDoc(docA->getFileName()->copy(),
+			 ownerPassword, userPassword);
+    if (!docs[i]->isOk()) {
+      delete docs[i];
+      break;
+    }
+  }
+  // if the file couldn't be reopened, just use fewer bands
+  nBands = i;
+
+  outs = (SplashOutputDev **)gmallocn(nBands, sizeof(SplashOutputDev *));
+  for (i = 0; i < nBands; ++i) {
+    outs[i] = new SplashOutputDev(colorModeA, bitmapRowPadA, reverseVideoA,
+				  paperColorA);
+    outs[i]->setBand(i, nBands);
+    if (i > 0) {
+      outs[i]->setGlyphCache(outs[0]->getGlyphCache());
+      outs[i]->setBitmapPool(outs[0]->getBitmapPool());
+    }
+    // the bands are the threads
+    outs[i]->setNumThreads(1);
+    outs[i]->startDoc(docs[i]->getXRef());
+  }
+  pool = new GThreadPool(nBands);
+  nActiveBands = nBands;
+  colorMode = colorModeA;
+
+  page = 0;
+  hDPI = vDPI = 72;
+  rotate = 0;
+  useMediaBox = crop = printing = gFalse;
+}
+
+SplashBandRenderer::~SplashBandRenderer() {
+  int i;
+
+  delete pool;
+  for (i = 0; i < nBands; ++i) {
+    delete outs[i];
+  }
+  gfree(outs);
+  for (i = 1; i < nBands; ++i) {
+    delete docs[i];
+  }
+  gfree(docs);
+}
+
+void SplashBandRenderer::displayPage(int pageA, double hDPIA, double vDPIA,
+				     int rotateA, GBool useMediaBoxA,
+				     GBool cropA, GBool printingA) {
+  page = pageA;
+  hDPI = hDPIA;
+  vDPI = vDPIA;
+  rotate = rotateA;
+  useMediaBox = useMediaBoxA;
+  crop = cropA;
+  printing = printingA;
+  pool->run(&renderBand, this, nBands);
+}
+
+GBool SplashBandRenderer::displayPageTiled(int pageA, double hDPIA,
+					   double vDPIA, int rotateA,
+					   GBool useMediaBoxA, GBool cropA,
+					   GBool printingA,
+					   long long maxTileBytes,
+					   SplashBandRowsFunc rowsFunc,
+					   void *rowsFuncData) {
+  long long rowBytes;
+  GBool ok;
+  int w, h, maxRows, nTiles, tile, yA, yB, i;
+
+  if (pageA < 1 || pageA > docs[0]->getNumPages()) {
+    return gFalse;
+  }
+  page = pageA;
+  hDPI = hDPIA;
+  vDPI = vDPIA;
+  rotate = rotateA;
+  useMediaBox = useMediaBoxA;
+  crop = cropA;
+  printing = printingA;
+
+  // each tile is a band of the page (see SplashOutputDev::setBand)
+  getPageSize(page, hDPI, vDPI, rotate, useMediaBox, &w, &h);
+  if (colorMode == splashModeMono1) {
+    rowBytes = (w + 7) >> 3;
+  } else {
+    rowBytes = (long long)w * (splashColorModeNComps[colorMode] + 1);
+  }
+  if (maxTileBytes / rowBytes >= h) {
+    maxRows = h;
+  } else {
+    maxRows = (int)(maxTileBytes / rowBytes);
+    if (maxRows < 1) {
+      maxRows = 1;
+    }
+  }
+  nTiles = (h + maxRows - 1) / maxRows;
+
+  ok = gTrue;
+  for (tile = 0; tile < nTiles && ok; tile += nActiveBands) {
+    nActiveBands = nTiles - tile < nBands ? nTiles - tile : nBands;
+    for (i = 0; i < nActiveBands; ++i) {
+      outs[i]->setBand(tile + i, nTiles);
+    }
+    pool->run(&renderBand, this, nActiveBands);
+    yA = (int)(((long long)h * tile) / nTiles);
+    yB = (int)(((long long)h * (tile + nActiveBands)) / nTiles);
+    ok = (*rowsFunc)(rowsFuncData, yA, yB);
+  }
+
+  // displayPage and getRow use the regular bands
+  for (i = 0; i < nBands; ++i) {
+    outs[i]->setBand(i, nBands);
+  }
+  nActiveBands = nBands;
+  return ok;
+}
+
+// This matches the bitmap size computed by Page::displaySlice and
+// SplashOutputDev::startPage.
+void SplashBandRenderer::getPageSize(int pageA, double hDPIA, double vDPIA,
+				     int rotateA, GBool useMediaBoxA,
+				     int *w, int *h) {
+  Page *p;
+  PDFRectangle box;
+  GfxState *state;
+  GBool cropA;
+
+  p = docs[0]->getCatalog()->getPage(pageA);
+  rotateA += p->getRotate();
+  if (rotateA >= 360) {
+    rotateA -= 360;
+  } else if (rotateA < 0) {
+    rotateA += 360;
+  }
+  cropA = gFalse;
+  p->makeBox(hDPIA, vDPIA, rotateA, useMediaBoxA, outs[0]->upsideDown(),
+	     -1, -1, -1, -1, &box, &cropA);
+  state = new GfxState(hDPIA, vDPIA, &box, rotateA, outs[0]->upsideDown());
+  *w = (int)(state->getPageWidth() + 0.5);
+  if (*w <= 0) {
+    *w = 1;
+  }
+  *h = (int)(state->getPageHeight() + 0.5);
+  if (*h <= 0) {
+    *h = 1;
+  }
+  delete state;
+}
+
+void SplashBandRenderer::renderBand(void *data, int band) {
+  SplashBandRenderer *r;
+
+  r = (SplashBandRenderer *)data;
+  r->docs[band]->displayPage(r->outs[band], r->page, r->hDPI, r->vDPI,
+			     r->rotate, r->useMediaBox, r->crop,
+			     r->printing);
+}
+
+int SplashBandRenderer::getWidth() {
+  return outs[0]->getBitmap()->getWidth();
+}
+
+int SplashBandRenderer::getHeight() {
+  return outs[0]->getBitmap()->getHeight();
+}
+
+// Return the bitmap of the first band which contains row <y>.
+SplashBitmap *SplashBandRenderer::getBandBitmap(int y) {
+  SplashBitmap *bitmap;
+  int i;
+
+  for (i = 0; i < nActiveBands - 1; ++i) {
+    bitmap = outs[i]->getBitmap();
+    if (y < bitmap->getBandY() + bitmap->getBandHeight()) {
+      return bitmap;
+    }
+  }
+  return outs[nActiveBands - 1]->getBitmap();
+}
+
+SplashColorPtr SplashBandRenderer::getRow(int y) {
+  SplashBitmap *bitmap;
+
+  bitmap = getBandBitmap(y);
+  return bitmap->getRowPtr(y);
+}
+
+SplashError SplashBandRenderer::writePNMFile(char *fileName) {
+  SplashBitmap *bitmap;
+  SplashError err;
+  FILE *f;
+  int y, yMax;
+
+  if (!(f = fopen(fileName, "wb"))) {
+    return splashErrOpenFile;
+  }
+  outs[0]->getBitmap()->writePNMHeader(f, getHeight());
+  err = splashOk;
+  // bands may overlap if there are more bands than rows
+  for (y = 0; y < getHeight() && err == splashOk; y = yMax) {
+    bitmap = getBandBitmap(y);
+    yMax = bitmap->getBandY() + bitmap->getBandHeight();
+    err = bitmap->writePNMRows(f, y, yMax);
+  }
+  fclose(f);
+  return err;
+}
@@ -0,0 +1,129 @@
+//========================================================================
+//
+// SplashBandRenderer.h
+//
+// Render pages with SplashOutputDev, in parallel horizontal bands.
+//
+//========================================================================
+
+#ifndef SPLASHBANDRENDERER_H
+#define SPLASHBANDRENDERER_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include "gtypes.h"
+#include "SplashTypes.h"
+#include "SplashErrorCodes.h"
+
+class GString;
+class GThreadPool;
+class PDFDoc;
+class SplashBitmap;
+class SplashOutputDev;
+
+//------------------------------------------------------------------------
+
+// Called by SplashBandRenderer::displayPageTiled when rows <yA> ..
+// <yB>-1 of the page are done -- the rows can be read with getRow()
+// until the function returns.  Returns false to stop rendering the
+// page.
+typedef GBool (*SplashBandRowsFunc)(void *data, int yA, int yB);
+
+//------------------------------------------------------------------------
+// SplashBandRenderer
+//------------------------------------------------------------------------
+
+// Each band replays the page's content stream with the full-page
+// transform, clipped to its own rows (see SplashOutputDev::setBand),
+// so the result is pixel-identical to a single-threaded render.  The
+// parser, XRef, and streams are not thread-safe, so every band has
+// its own PDFDoc (opened from the same file) and SplashOutputDev.
+// The output devices share band 0's SplashGlyphCache, so a glyph is
+// rasterized once, not once per band.
+
+class SplashBandRenderer {
+public:
+
+  // Render pages of <docA> in <nBandsA> bands, with one thread per
+  // band; <nBandsA> <= 0 means one band per CPU.  There are never
+  // more bands than CPUs: each band replays the whole content stream,
+  // so extra bands only add work.  <docA> is used for band 0 and
+  // still belongs to the caller; the other bands reopen its file with
+  // <ownerPassword> / <userPassword>.  If that isn't possible, it
+  // falls back to a single band.  The remaining args are passed to
+  // the SplashOutputDev constructor.
+  SplashBandRenderer(PDFDoc *docA, GString *ownerPassword,
+		     GString *userPassword, int nBandsA,
+		     SplashColorMode colorModeA, int bitmapRowPadA,
+		     GBool reverseVideoA, SplashColorPtr paperColorA);
+
+  ~SplashBandRenderer();
+
+  int getNumBands() { return nBands; }
+
+  // Render a page -- the args are the same as for
+  // PDFDoc::displayPage.
+  void displayPage(int page, double hDPI, double vDPI, int rotate,
+		   GBool useMediaBox, GBool crop, GBool printing);
+
+  // Render a page in horizontal tiles, for pages too large to hold
+  // in memory.  Each tile's bitmap (color plus alpha) takes at most
+  // <maxTileBytes> bytes; the mask and transparency group bitmaps
+  // are limited to the tile as well.  The tiles are rendered
+  // getNumBands() at a time, and <rowsFunc> is called with their
+  // rows before the next ones are started, so peak memory depends on
+  // the tile size, not the page size.  Each tile replays the page's
+  // content stream.  The other args are the same as for
+  // displayPage.  Returns false if the page number is invalid or if
+  // <rowsFunc> returned false.
+  GBool displayPageTiled(int page, double hDPI, double vDPI, int rotate,
+			 GBool useMediaBox, GBool crop, GBool printing,
+			 long long maxTileBytes,
+			 SplashBandRowsFunc rowsFunc, void *rowsFuncData);
+
+  // Get the size of the bitmap for a page -- the args are the same
+  // as for displayPage.
+  void getPageSize(int page, double hDPI, double vDPI, int rotate,
+		   GBool useMediaBox, int *w, int *h);
+
+  // Size of the last rendered page.
+  int getWidth();
+  int getHeight();
+
+  // Return a pointer to row <y> of the last rendered page.
+  SplashColorPtr getRow(int y);
+
+  // Write the last rendered page as a PNM file.
+  SplashError writePNMFile(char *fileName);
+
+  // Get the output device for band <band>, e.g., to change its
+  // settings.
+  SplashOutputDev *getOutputDev(int band) { return outs[band]; }
+
+private:
+
+  SplashBitmap *getBandBitmap(int y);
+  static void renderBand(void *data, int band);
+
+  int nBands;
+  int nActiveBands;		// number of bands holding the current
+				//   rows (less than nBands for the last
+				//   group of tiles)
+  PDFDoc **docs;		// docs[0] belongs to the caller
+  SplashOutputDev **outs;
+  GThreadPool *pool;
+  SplashColorMode colorMode;
+
+  // current page
+  int page;
+  double hDPI, vDPI;
+  int rotate;
+  GBool useMediaBox, crop, printing;
+};
+
+#endif
@@ -16,6 +16,10 @@
 #include <math.h>
 #include <limits.h>
 #include "gfile.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
+#include "GThreadPool.h"
 #include "GlobalParams.h"
 #include "Error.h"
 #include "Object.h"
@@ -29,7 +33,10 @@
 #include "FoFiTrueType.h"
 #include "JPXStream.h"
 #include "SplashBitmap.h"
+#include "SplashClip.h"
 #include "SplashGlyphBitmap.h"
+#include "SplashGlyphCache.h"
+#include "SplashBitmapPool.h"
 #include "SplashPattern.h"
 #include "SplashScreen.h"
 #include "SplashPath.h"
@@ -50,10 +57,13 @@ extern "C" int unlink(char *filename);
 
 //------------------------------------------------------------------------
 
-// Type 3 font cache size parameters
-#define type3FontCacheAssoc   8
-#define type3FontCacheMaxSets 8
-#define type3FontCacheSize    (128*1024)
+// Used to assign a unique ID to each document, to identify its Type 3
+// glyphs in the SplashGlyphCache.
+#if MULTITHREADED
+static GAtomicCounter docCounter = 0;
+#else
+static long docCounter = 0;
+#endif
 
 //------------------------------------------------------------------------
 
@@ -475,19 +485,13 @@ private:
 // T3FontCache
 //------------------------------------------------------------------------
 
-struct T3FontCacheTag {
-  Gushort code;
-  Gushort mru;			// valid bit (0x8000) and MRU index
-};
-
 class T3FontCache {
 public:
 
   T3FontCache(Ref *fontID, double m11A, double m12A,
 	      double m21A, double m22A,
 	      int glyphXA, int glyphYA, int glyphWA, int glyphHA,
-	      GBool aa, GBool validBBoxA);
-  ~T3FontCache();
+	      GBool validBBoxA, int docID);
   GBool matches(Ref *idA, double m11A, double m12A,
 		double m21A, double m22A)
     { return fontID.num == idA->num && fontID.gen == idA->gen &&
@@ -498,17 +502,14 @@ public:
   int glyphX, glyphY;		// pixel offset of glyph bitmaps
   int glyphW, glyphH;		// size of glyph bitmaps, in pixels
   GBool validBBox;		// false if the bbox was [0 0 0 0]
-  int glyphSize;		// size of glyph bitmaps, in bytes
-  int cacheSets;		// number of sets in cache
-  int cacheAssoc;		// cache associativity (glyphs per set)
-  Guchar *cacheData;		// glyph pixmap cache
-  T3FontCacheTag *cacheTags;	// cache tags, i.e., char codes
+  unsigned long long digest;	// identifies the font's glyphs in the
+				//   SplashGlyphCache
 };
 
 T3FontCache::T3FontCache(Ref *fontIDA, double m11A, double m12A,
 			 double m21A, double m22A,
 			 int glyphXA, int glyphYA, int glyphWA, int glyphHA,
-			 GBool validBBoxA, GBool aa) {
+			 GBool validBBoxA, int docID) {
   int i;
 
   fontID = *fontIDA;
@@ -528,27 +529,13 @@ T3FontCache::T3FontCache(Ref *fontIDA, double m11A, double m12A,
     glyphW = glyphH = 100;
     validBBox = gFalse;
   }
-  if (aa) {
-    glyphSize = glyphW * glyphH;
-  } else {
-    glyphSize = ((glyphW + 7) >> 3) * glyphH;
-  }
-  cacheAssoc = type3FontCacheAssoc;
-  for (cacheSets = type3FontCacheMaxSets;
-       cacheSets > 1 &&
-	 cacheSets * cacheAssoc * glyphSize > type3FontCacheSize;
-       cacheSets >>= 1) ;
-  cacheData = (Guchar *)gmallocn(cacheSets * cacheAssoc, glyphSize);
-  cacheTags = (T3FontCacheTag *)gmallocn(cacheSets * cacheAssoc,
-					 sizeof(T3FontCacheTag));
-  for (i = 0; i < cacheSets * cacheAssoc; ++i) {
-    cacheTags[i].mru = i & (cacheAssoc - 1);
-  }
-}
-
-T3FontCache::~T3FontCache() {
-  gfree(cacheData);
-  gfree(cacheTags);
+  // Type 3 glyphs are defined by content streams, so (unlike font
+  // files) they can only be shared within a document
+  digest = SplashGlyphCache::hash(SplashGlyphCache::hashInit,
+				  "Type3", 5);
+  digest = SplashGlyphCache::hash(digest, &docID, sizeof(docID));
+  digest = SplashGlyphCache::hash(digest, &fontID.num, sizeof(fontID.num));
+  digest = SplashGlyphCache::hash(digest, &fontID.gen, sizeof(fontID.gen));
 }
 
 struct T3GlyphStack {
@@ -560,8 +547,8 @@ struct T3GlyphStack {
 
   //----- cache info
   T3FontCache *cache;		// font cache for the current font
-  T3FontCacheTag *cacheTag;	// pointer to cache tag for the glyph
-  Guchar *cacheData;		// pointer to cache data for the glyph
+  GBool cacheGlyph;		// set if the glyph is being rendered
+				//   into a temporary bitmap, to be cached
 
   //----- saved state
   SplashBitmap *origBitmap;
@@ -623,6 +610,9 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   splash->clear(paperColor, 0);
 
   fontEngine = NULL;
+  glyphCache = new SplashGlyphCache(globalParams->getGlyphCacheSize());
+  bitmapPool = new SplashBitmapPool(globalParams->getBitmapPoolSize());
+  docID = 0;
 
   nT3Fonts = 0;
   t3GlyphStack = NULL;
@@ -634,6 +624,11 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   transpGroupStack = NULL;
 
   nestCount = 0;
+
+  nThreads = 1;
+  threadPool = NULL;
+  band = 0;
+  nBands = 1;
 }
 
 void SplashOutputDev::setupScreenParams(double hDPI, double vDPI) {
@@ -696,12 +691,17 @@ SplashOutputDev::~SplashOutputDev() {
   if (fontEngine) {
     delete fontEngine;
   }
+  glyphCache->decRefCnt();
   if (splash) {
     delete splash;
   }
   if (bitmap) {
     delete bitmap;
   }
+  bitmapPool->decRefCnt();
+  if (threadPool) {
+    delete threadPool;
+  }
 }
 
 void SplashOutputDev::startDoc(XRef *xrefA) {
@@ -719,15 +719,21 @@ void SplashOutputDev::startDoc(XRef *xrefA) {
 #endif
 				    allowAntialias &&
 				      globalParams->getAntialias() &&
-				      colorMode != splashModeMono1);
+				      colorMode != splashModeMono1,
+				    glyphCache);
   for (i = 0; i < nT3Fonts; ++i) {
     delete t3FontCache[i];
   }
   nT3Fonts = 0;
+#if MULTITHREADED
+  docID = (int)gAtomicIncrement(&docCounter);
+#else
+  docID = (int)++docCounter;
+#endif
 }
 
 void SplashOutputDev::startPage(int pageNum, GfxState *state) {
-  int w, h;
+  int w, h, bandY, bandH;
   double *ctm;
   SplashCoord mat[6];
   SplashColor color;
@@ -745,20 +751,34 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
   } else {
     w = h = 1;
   }
+  // (if there are more bands than rows, some bands overlap)
+  bandY = (h * band) / nBands;
+  if (bandY > h - 1) {
+    bandY = h - 1;
+  }
+  bandH = (h * (band + 1)) / nBands - bandY;
+  if (bandH < 1) {
+    bandH = 1;
+  }
   if (splash) {
     delete splash;
     splash = NULL;
   }
-  if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight()) {
+  if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight() ||
+      bandY != bitmap->getBandY() || bandH != bitmap->getBandHeight()) {
     if (bitmap) {
       delete bitmap;
       bitmap = NULL;
     }
     bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode,
-			      colorMode != splashModeMono1, bitmapTopDown);
+			      colorMode != splashModeMono1, bitmapTopDown,
+			      bandY, bandH, bitmapPool);
   }
   splash = new Splash(bitmap, vectorAntialias, &screenParams);
   splash->setMinLineWidth(globalParams->getMinLineWidth());
+  if (nThreads != 1) {
+    splash->setThreadPool(getThreadPool());
+  }
   if (state) {
     ctm = state->getCTM();
     mat[0] = (SplashCoord)ctm[0];
@@ -1688,7 +1708,8 @@ void SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfx,
   origBitmap = bitmap;
   origSplash = splash;
   bitmap = tileBitmap = new SplashBitmap(tileW, tileH, bitmapRowPad,
-					 colorMode, gTrue, bitmapTopDown);
+					 colorMode, gTrue, bitmapTopDown,
+					 0, 0, bitmapPool);
   splash = new Splash(bitmap, vectorAntialias, origSplash->getScreen());
   splash->setMinLineWidth(globalParams->getMinLineWidth());
   splash->setStrokeAdjust(globalParams->getStrokeAdjust());
@@ -1735,6 +1756,602 @@ void SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfx,
   delete tileBitmap;
 }
 
+//------------------------------------------------------------------------
+// shaded fills
+//------------------------------------------------------------------------
+
+// Axial, radial, and function shadings are rasterized directly: each
+// pixel in the clip bbox is mapped back to shading space and given
+// its own color.  The raster is split into bands of rows, which are
+// computed in parallel (each band writes only its own rows, so the
+// result doesn't depend on the number of threads), and then
+// composited through the clip region.
+
+// fills smaller than this (in pixels) aren't split across threads
+#define shadedFillMinParallel 65536
+
+// min/max number of entries in the axial/radial color lookup table
+#define shadedFillMinLUTSize 256
+#define shadedFillMaxLUTSize 4096
+
+// block size and max corner color difference for interpolating
+// function shadings
+#define functionShadedFillBlock 8
+#define functionShadedFillDelta 2
+
+struct SplashShadedFill {
+  SplashBitmap *bitmap;		// the raster (with alpha)
+  int xMin, yMin;		// device coords of the raster's (0,0)
+  int nComps;			// bytes per pixel in the raster
+  int nBands, bandHeight;
+  double mat[6];		// device -> shading space transform
+
+  // axial and radial shadings: device colors for t = 0 .. 1
+  Guchar *lut;
+  int lutSize;
+  double x0, y0, r0, x1, y1, r1;
+  GBool extend0, extend1;
+
+  // function shadings: one copy of the shading per band, because
+  // function evaluation isn't thread-safe
+  GfxFunctionShading **funcShadings;
+  double domain[4];
+  SplashColorMode mode;
+  GBool reverseVideo;
+};
+
+// Convert a shading color to a device color.  The color is in the
+// order used by SplashPattern, i.e., RGB (not BGR) for splashModeBGR8.
+static void getShadingDeviceColor(GfxColorSpace *colorSpace,
+				  GfxColor *color, SplashColorMode mode,
+				  GBool reverseVideo, Guchar *out) {
+  GfxGray gray;
+  GfxRGB rgb;
+#if SPLASH_CMYK
+  GfxCMYK cmyk;
+#endif
+
+  switch (mode) {
+  case splashModeMono1:
+  case splashModeMono8:
+    colorSpace->getGray(color, &gray);
+    if (reverseVideo) {
+      gray = gfxColorComp1 - gray;
+    }
+    out[0] = colToByte(gray);
+    break;
+  case splashModeRGB8:
+  case splashModeBGR8:
+    colorSpace->getRGB(color, &rgb);
+    if (reverseVideo) {
+      rgb.r = gfxColorComp1 - rgb.r;
+      rgb.g = gfxColorComp1 - rgb.g;
+      rgb.b = gfxColorComp1 - rgb.b;
+    }
+    out[0] = colToByte(rgb.r);
+    out[1] = colToByte(rgb.g);
+    out[2] = colToByte(rgb.b);
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    colorSpace->getCMYK(color, &cmyk);
+    out[0] = colToByte(cmyk.c);
+    out[1] = colToByte(cmyk.m);
+    out[2] = colToByte(cmyk.y);
+    out[3] = colToByte(cmyk.k);
+    break;
+#endif
+  }
+}
+
+// Get the number of lookup table entries for an axial or radial
+// shading whose t axis is <len> device pixels long.
+static int getShadingLUTSize(double len) {
+  if (len > shadedFillMaxLUTSize) {
+    return shadedFillMaxLUTSize;
+  } else if (len < shadedFillMinLUTSize) {
+    return shadedFillMinLUTSize;
+  }
+  return (int)len;
+}
+
+// Fill the lookup table for an axial or radial shading with the device
+// colors of the shading's function lookup table (see
+// GfxAxialShading::setupLUT), which has the same <sf->lutSize> samples.
+static void fillShadingLUT(SplashShadedFill *sf, GfxColorSpace *colorSpace,
+			   double t0, double t1,
+			   SplashColorMode mode, GBool reverseVideo,
+			   void (*getColor)(void *shading, double t,
+					    GfxColor *color),
+			   void *shading) {
+  GfxColor color;
+  int i;
+
+  sf->lut = (Guchar *)gmallocn(sf->lutSize, sf->nComps);
+  for (i = 0; i < sf->lutSize; ++i) {
+    (*getColor)(shading, t0 + (t1 - t0) * i / (sf->lutSize - 1), &color);
+    getShadingDeviceColor(colorSpace, &color, mode, reverseVideo,
+			  sf->lut + i * sf->nComps);
+  }
+}
+
+static void getAxialColor(void *shading, double t, GfxColor *color) {
+  ((GfxAxialShading *)shading)->getColor(t, color);
+}
+
+static void getRadialColor(void *shading, double t, GfxColor *color) {
+  ((GfxRadialShading *)shading)->getColor(t, color);
+}
+
+// Copy a LUT entry (or nothing, if <t> is outside the shading) into
+// the raster.
+static inline void putShadingLUTPixel(SplashShadedFill *sf, double t,
+				      Guchar *colorPtr, Guchar *alphaPtr) {
+  Guchar *p;
+  int i;
+
+  if (t < 0) {
+    *alphaPtr = 0;
+    return;
+  }
+  i = (int)(t * (sf->lutSize - 1) + 0.5);
+  p = sf->lut + i * sf->nComps;
+  for (i = 0; i < sf->nComps; ++i) {
+    colorPtr[i] = p[i];
+  }
+  *alphaPtr = 0xff;
+}
+
+static void axialShadedFillBand(void *data, int band) {
+  SplashShadedFill *sf;
+  Guchar *colorPtr, *alphaPtr;
+  double dx, dy, mul, ta, tb, tc, t;
+  int w, y0, y1, x, y;
+
+  sf = (SplashShadedFill *)data;
+  w = sf->bitmap->getWidth();
+  y0 = band * sf->bandHeight;
+  y1 = y0 + sf->bandHeight;
+  if (y1 > sf->bitmap->getHeight()) {
+    y1 = sf->bitmap->getHeight();
+  }
+
+  // t is an affine function of the device coordinates
+  dx = sf->x1 - sf->x0;
+  dy = sf->y1 - sf->y0;
+  mul = 1 / (dx * dx + dy * dy);
+  ta = (sf->mat[0] * dx + sf->mat[1] * dy) * mul;
+  tb = (sf->mat[2] * dx + sf->mat[3] * dy) * mul;
+  tc = ((sf->mat[4] - sf->x0) * dx + (sf->mat[5] - sf->y0) * dy) * mul;
+
+  for (y = y0; y < y1; ++y) {
+    colorPtr = sf->bitmap->getDataPtr() + y * sf->bitmap->getRowSize();
+    alphaPtr = sf->bitmap->getAlphaPtr() + y * w;
+    for (x = 0; x < w; ++x) {
+      t = ta * (sf->xMin + x + 0.5) + tb * (sf->yMin + y + 0.5) + tc;
+      if (t < 0) {
+	t = sf->extend0 ? 0 : -1;
+      } else if (t > 1) {
+	t = sf->extend1 ? 1 : -1;
+      }
+      putShadingLUTPixel(sf, t, colorPtr, alphaPtr);
+      colorPtr += sf->nComps;
+      ++alphaPtr;
+    }
+  }
+}
+
+// Check a solution of the radial shading equation: the radius must be
+// non-negative, and s must be in [0, 1] or in an extended part of the
+// shading.  Returns the (clipped) value of s, or -1.
+static inline double checkRadialS(SplashShadedFill *sf, double s) {
+  if (sf->r0 + s * (sf->r1 - sf->r0) < 0) {
+    return -1;
+  }
+  if (s < 0) {
+    return sf->extend0 ? 0 : -1;
+  }
+  if (s > 1) {
+    return sf->extend1 ? 1 : -1;
+  }
+  return s;
+}
+
+static void radialShadedFillBand(void *data, int band) {
+  SplashShadedFill *sf;
+  Guchar *colorPtr, *alphaPtr;
+  double cdx, cdy, dr, a, b, c, d, q, s, sA, sB, xd, yd, pdx, pdy;
+  int w, y0, y1, x, y;
+
+  sf = (SplashShadedFill *)data;
+  w = sf->bitmap->getWidth();
+  y0 = band * sf->bandHeight;
+  y1 = y0 + sf->bandHeight;
+  if (y1 > sf->bitmap->getHeight()) {
+    y1 = sf->bitmap->getHeight();
+  }
+
+  // Find the largest s such that the point (x,y) is on the circle
+  // with center c(s) = (x0,y0) + s*(x1-x0,y1-y0) and radius
+  // r(s) = r0 + s*(r1-r0), i.e., solve
+  //   a*s^2 - 2*b*s + c = 0
+  cdx = sf->x1 - sf->x0;
+  cdy = sf->y1 - sf->y0;
+  dr = sf->r1 - sf->r0;
+  a = cdx * cdx + cdy * cdy - dr * dr;
+
+  for (y = y0; y < y1; ++y) {
+    colorPtr = sf->bitmap->getDataPtr() + y * sf->bitmap->getRowSize();
+    alphaPtr = sf->bitmap->getAlphaPtr() + y * w;
+    yd = sf->yMin + y + 0.5;
+    for (x = 0; x < w; ++x) {
+      xd = sf->xMin + x + 0.5;
+      pdx = sf->mat[0] * xd + sf->mat[2] * yd + sf->mat[4] - sf->x0;
+      pdy = sf->mat[1] * xd + sf->mat[3] * yd + sf->mat[5] - sf->y0;
+      b = pdx * cdx + pdy * cdy + sf->r0 * dr;
+      c = pdx * pdx + pdy * pdy - sf->r0 * sf->r0;
+      s = -1;
+      if (a == 0) {
+	if (b != 0) {
+	  s = checkRadialS(sf, 0.5 * c / b);
+	}
+      } else if ((d = b * b - a * c) >= 0) {
+	// numerically stable form of the two roots
+	q = b < 0 ? b - sqrt(d) : b + sqrt(d);
+	sA = q / a;
+	sB = q == 0 ? sA : c / q;
+	if (sA < sB) {
+	  s = sA;
+	  sA = sB;
+	  sB = s;
+	}
+	if ((s = checkRadialS(sf, sA)) < 0) {
+	  s = checkRadialS(sf, sB);
+	}
+      }
+      putShadingLUTPixel(sf, s, colorPtr, alphaPtr);
+      colorPtr += sf->nComps;
+      ++alphaPtr;
+    }
+  }
+}
+
+// Compute the color of one pixel of a function shading.  Returns
+// false if the pixel is outside the shading's domain.
+static GBool getFunctionShadingPixel(SplashShadedFill *sf,
+				     GfxFunctionShading *shading,
+				     int x, int y, Guchar *out) {
+  GfxColor color;
+  double xd, yd, u, v;
+
+  xd = sf->xMin + x + 0.5;
+  yd = sf->yMin + y + 0.5;
+  u = sf->mat[0] * xd + sf->mat[2] * yd + sf->mat[4];
+  v = sf->mat[1] * xd + sf->mat[3] * yd + sf->mat[5];
+  if (u < sf->domain[0] || u > sf->domain[2] ||
+      v < sf->domain[1] || v > sf->domain[3]) {
+    return gFalse;
+  }
+  shading->getColor(u, v, &color);
+  getShadingDeviceColor(shading->getColorSpace(), &color, sf->mode,
+			sf->reverseVideo, out);
+  return gTrue;
+}
+
+// Function shadings are evaluated in square blocks: if the colors at
+// the four corners of a block are close enough, the block is filled
+// by bilinear interpolation; otherwise, every pixel in the block is
+// evaluated.  The block grid is anchored at the raster origin (and
+// band heights are a multiple of the block size), so the result
+// doesn't depend on the number of bands.
+static void functionShadedFillBand(void *data, int band) {
+  SplashShadedFill *sf;
+  GfxFunctionShading *shading;
+  SplashColor corner[4];
+  int c[splashMaxColorComps], dc[splashMaxColorComps];
+  Guchar *colorPtr, *alphaPtr;
+  GBool interp;
+  int w, h, y0, y1, bx0, bx1, by0, by1, x, y, i;
+
+  sf = (SplashShadedFill *)data;
+  shading = sf->funcShadings[band];
+  w = sf->bitmap->getWidth();
+  h = sf->bitmap->getHeight();
+  y0 = band * sf->bandHeight;
+  y1 = y0 + sf->bandHeight;
+  if (y1 > h) {
+    y1 = h;
+  }
+
+  for (by0 = y0; by0 < y1; by0 += functionShadedFillBlock) {
+    by1 = by0 + functionShadedFillBlock - 1;
+    if (by1 >= y1) {
+      by1 = y1 - 1;
+    }
+    for (bx0 = 0; bx0 < w; bx0 += functionShadedFillBlock) {
+      bx1 = bx0 + functionShadedFillBlock - 1;
+      if (bx1 >= w) {
+	bx1 = w - 1;
+      }
+
+      // check the corners
+      interp = getFunctionShadingPixel(sf, shading, bx0, by0, corner[0]) &&
+	       getFunctionShadingPixel(sf, shading, bx1, by0, corner[1]) &&
+	       getFunctionShadingPixel(sf, shading, bx0, by1, corner[2]) &&
+	       getFunctionShadingPixel(sf, shading, bx1, by1, corner[3]);
+      for (i = 0; interp && i < sf->nComps; ++i) {
+	if (abs(corner[0][i] - corner[1][i]) > functionShadedFillDelta ||
+	    abs(corner[0][i] - corner[2][i]) > functionShadedFillDelta ||
+	    abs(corner[0][i] - corner[3][i]) > functionShadedFillDelta) {
+	  interp = gFalse;
+	}
+      }
+
+      for (y = by0; y <= by1; ++y) {
+	colorPtr = sf->bitmap->getDataPtr() + y * sf->bitmap->getRowSize()
+	           + bx0 * sf->nComps;
+	alphaPtr = sf->bitmap->getAlphaPtr() + y * w + bx0;
+	if (interp) {
+	  // interpolate down the left and right edges, then across the
+	  // row, in 16.16 fixed point
+	  for (i = 0; i < sf->nComps; ++i) {
+	    if (by1 > by0) {
+	      c[i] = corner[0][i] * 65536 +
+		     (((corner[2][i] - corner[0][i]) * 65536) / (by1 - by0))
+		       * (y - by0);
+	      dc[i] = corner[1][i] * 65536 +
+		      (((corner[3][i] - corner[1][i]) * 65536) / (by1 - by0))
+		        * (y - by0);
+	    } else {
+	      c[i] = corner[0][i] * 65536;
+	      dc[i] = corner[1][i] * 65536;
+	    }
+	    dc[i] = bx1 > bx0 ? (dc[i] - c[i]) / (bx1 - bx0) : 0;
+	    c[i] += 0x8000;
+	  }
+	  for (x = bx0; x <= bx1; ++x) {
+	    for (i = 0; i < sf->nComps; ++i) {
+	      colorPtr[i] = (Guchar)(c[i] >> 16);
+	      c[i] += dc[i];
+	    }
+	    *alphaPtr++ = 0xff;
+	    colorPtr += sf->nComps;
+	  }
+	} else {
+	  for (x = bx0; x <= bx1; ++x) {
+	    if (getFunctionShadingPixel(sf, shading, x, y, colorPtr)) {
+	      *alphaPtr = 0xff;
+	    } else {
+	      *alphaPtr = 0;
+	    }
+	    colorPtr += sf->nComps;
+	    ++alphaPtr;
+	  }
+	}
+      }
+    }
+  }
+}
+
+// Set up a shaded fill: compute the raster bbox (the clip bbox) and
+// the device -> shading space transform.  <shMat> is the shading ->
+// user space matrix, or NULL for the identity.  Returns false if the
+// shaded fill can't be done here.
+GBool SplashOutputDev::startShadedFill(GfxState *state, double *shMat,
+				       SplashShadedFill *sf) {
+  SplashClip *clip;
+  double *ctm;
+  double m[6];
+  double det;
+  int xMax, yMax;
+
+  memset(sf, 0, sizeof(SplashShadedFill));
+  if (splash->getBitmap()->getMode() == splashModeMono1) {
+    return gFalse;
+  }
+
+  // device -> shading space transform
+  ctm = state->getCTM();
+  if (shMat) {
+    m[0] = shMat[0] * ctm[0] + shMat[1] * ctm[2];
+    m[1] = shMat[0] * ctm[1] + shMat[1] * ctm[3];
+    m[2] = shMat[2] * ctm[0] + shMat[3] * ctm[2];
+    m[3] = shMat[2] * ctm[1] + shMat[3] * ctm[3];
+    m[4] = shMat[4] * ctm[0] + shMat[5] * ctm[2] + ctm[4];
+    m[5] = shMat[4] * ctm[1] + shMat[5] * ctm[3] + ctm[5];
+  } else {
+    memcpy(m, ctm, sizeof(m));
+  }
+  det = m[0] * m[3] - m[1] * m[2];
+  if (fabs(det) < 0.000001) {
+    return gFalse;
+  }
+  det = 1 / det;
+  sf->mat[0] = m[3] * det;
+  sf->mat[1] = -m[1] * det;
+  sf->mat[2] = -m[2] * det;
+  sf->mat[3] = m[0] * det;
+  sf->mat[4] = (m[2] * m[5] - m[3] * m[4]) * det;
+  sf->mat[5] = (m[1] * m[4] - m[0] * m[5]) * det;
+
+  // raster bbox
+  clip = splash->getClip();
+  sf->xMin = clip->getXMinI(splash->getStrokeAdjust());
+  sf->yMin = clip->getYMinI(splash->getStrokeAdjust());
+  xMax = clip->getXMaxI(splash->getStrokeAdjust());
+  yMax = clip->getYMaxI(splash->getStrokeAdjust());
+  if (sf->xMin < 0) {
+    sf->xMin = 0;
+  }
+  if (sf->yMin < 0) {
+    sf->yMin = 0;
+  }
+  if (xMax >= splash->getBitmap()->getWidth()) {
+    xMax = splash->getBitmap()->getWidth() - 1;
+  }
+  if (yMax >= splash->getBitmap()->getHeight()) {
+    yMax = splash->getBitmap()->getHeight() - 1;
+  }
+  if (xMax >= sf->xMin && yMax >= sf->yMin) {
+    // align the bbox to the function shading block grid, so the blocks
+    // (and therefore the result) don't depend on the clip region --
+    // this keeps banded rendering pixel-identical
+    sf->xMin &= ~(functionShadedFillBlock - 1);
+    sf->yMin &= ~(functionShadedFillBlock - 1);
+    xMax |= functionShadedFillBlock - 1;
+    yMax |= functionShadedFillBlock - 1;
+    sf->bitmap = new SplashBitmap(xMax - sf->xMin + 1, yMax - sf->yMin + 1,
+				  1, splash->getBitmap()->getMode(),
+				  gTrue, gTrue, 0, 0, bitmapPool);
+  }
+
+  sf->mode = splash->getBitmap()->getMode();
+  sf->nComps = splashColorModeNComps[sf->mode];
+  sf->reverseVideo = reverseVideo;
+  return gTrue;
+}
+
+// Rasterize the shaded fill (calling <bandFunc> for each band), and
+// composite the result through the clip region.
+void SplashOutputDev::finishShadedFill(GfxState *state, GfxShading *shading,
+				       SplashShadedFill *sf,
+				       void (*bandFunc)(void *, int)) {
+  int w, h, i;
+
+  if (sf->bitmap) {
+    w = sf->bitmap->getWidth();
+    h = sf->bitmap->getHeight();
+    sf->nBands = 1;
+    if (nThreads != 1 && w * h >= shadedFillMinParallel) {
+      sf->nBands = getThreadPool()->getNumThreads();
+      if (sf->nBands > h) {
+	sf->nBands = h;
+      }
+    }
+    sf->bandHeight = (h + sf->nBands - 1) / sf->nBands;
+    sf->bandHeight = (sf->bandHeight + functionShadedFillBlock - 1)
+                     & ~(functionShadedFillBlock - 1);
+    sf->nBands = (h + sf->bandHeight - 1) / sf->bandHeight;
+
+    if (shading->getType() == 1) {
+      sf->funcShadings = (GfxFunctionShading **)
+	                     gmallocn(sf->nBands, sizeof(GfxFunctionShading *));
+      sf->funcShadings[0] = (GfxFunctionShading *)shading;
+      for (i = 1; i < sf->nBands; ++i) {
+	sf->funcShadings[i] = (GfxFunctionShading *)shading->copy();
+      }
+    }
+
+    if (sf->nBands > 1) {
+      threadPool->run(bandFunc, sf, sf->nBands);
+    } else {
+      (*bandFunc)(sf, 0);
+    }
+
+    setOverprintMask(shading->getColorSpace(), state->getFillOverprint(),
+		     state->getOverprintMode(), NULL);
+    splash->composite(sf->bitmap, 0, 0, sf->xMin, sf->yMin, w, h,
+		      gFalse, gFalse);
+
+    if (sf->funcShadings) {
+      for (i = 1; i < sf->nBands; ++i) {
+	delete sf->funcShadings[i];
+      }
+      gfree(sf->funcShadings);
+    }
+    delete sf->bitmap;
+  }
+  gfree(sf->lut);
+}
+
+GBool SplashOutputDev::functionShadedFill(GfxState *state,
+					  GfxFunctionShading *shading) {
+  SplashShadedFill sf;
+
+  if (shading->getColorSpace()->isNonMarking()) {
+    return gTrue;
+  }
+  if (!startShadedFill(state, shading->getMatrix(), &sf)) {
+    return gFalse;
+  }
+  shading->getDomain(&sf.domain[0], &sf.domain[1],
+		     &sf.domain[2], &sf.domain[3]);
+  finishShadedFill(state, shading, &sf, &functionShadedFillBand);
+  return gTrue;
+}
+
+GBool SplashOutputDev::axialShadedFill(GfxState *state,
+				       GfxAxialShading *shading) {
+  SplashShadedFill sf;
+  double *ctm;
+  double dx, dy, ddx, ddy;
+
+  if (shading->getColorSpace()->isNonMarking()) {
+    return gTrue;
+  }
+  if (!startShadedFill(state, NULL, &sf)) {
+    return gFalse;
+  }
+  shading->getCoords(&sf.x0, &sf.y0, &sf.x1, &sf.y1);
+  dx = sf.x1 - sf.x0;
+  dy = sf.y1 - sf.y0;
+  if (fabs(dx) < 0.01 && fabs(dy) < 0.01) {
+    // degenerate axis -- let Gfx handle it
+    if (sf.bitmap) {
+      delete sf.bitmap;
+    }
+    return gFalse;
+  }
+  sf.extend0 = shading->getExtend0();
+  sf.extend1 = shading->getExtend1();
+
+  // one LUT entry per device pixel along the axis
+  ctm = state->getCTM();
+  ddx = ctm[0] * dx + ctm[2] * dy;
+  ddy = ctm[1] * dx + ctm[3] * dy;
+  sf.lutSize = getShadingLUTSize(sqrt(ddx * ddx + ddy * ddy) + 1);
+  shading->setupLUT(sf.lutSize);
+  fillShadingLUT(&sf, shading->getColorSpace(),
+		 shading->getDomain0(), shading->getDomain1(),
+		 sf.mode, sf.reverseVideo, &getAxialColor, shading);
+
+  finishShadedFill(state, shading, &sf, &axialShadedFillBand);
+  return gTrue;
+}
+
+GBool SplashOutputDev::radialShadedFill(GfxState *state,
+					GfxRadialShading *shading) {
+  SplashShadedFill sf;
+  double *ctm;
+  double len;
+
+  if (shading->getColorSpace()->isNonMarking()) {
+    return gTrue;
+  }
+  if (!startShadedFill(state, NULL, &sf)) {
+    return gFalse;
+  }
+  shading->getCoords(&sf.x0, &sf.y0, &sf.r0, &sf.x1, &sf.y1, &sf.r1);
+  sf.extend0 = shading->getExtend0();
+  sf.extend1 = shading->getExtend1();
+
+  // one LUT entry per device pixel of the distance covered by the
+  // circles
+  ctm = state->getCTM();
+  len = sqrt((sf.x1 - sf.x0) * (sf.x1 - sf.x0) +
+	     (sf.y1 - sf.y0) * (sf.y1 - sf.y0)) +
+        (sf.r0 > sf.r1 ? sf.r0 : sf.r1);
+  len *= sqrt(fabs(ctm[0] * ctm[3] - ctm[1] * ctm[2]));
+  sf.lutSize = getShadingLUTSize(len + 1);
+  shading->setupLUT(sf.lutSize);
+  fillShadingLUT(&sf, shading->getColorSpace(),
+		 shading->getDomain0(), shading->getDomain1(),
+		 sf.mode, sf.reverseVideo, &getRadialColor, shading);
+
+  finishShadedFill(state, shading, &sf, &radialShadedFillBand);
+  return gTrue;
+}
+
 void SplashOutputDev::clip(GfxState *state) {
   SplashPath *path;
 
@@ -1914,6 +2531,8 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
   double *ctm, *bbox;
   T3FontCache *t3Font;
   T3GlyphStack *t3gs;
+  SplashGlyphCacheKey key;
+  SplashGlyphBitmap glyph;
   GBool validBBox;
   double m[4];
   GBool horiz;
@@ -2014,21 +2633,17 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
 				       (int)floor(yMin - yt) - 2,
 				       (int)ceil(xMax) - (int)floor(xMin) + 4,
 				       (int)ceil(yMax) - (int)floor(yMin) + 4,
-				       validBBox,
-				       colorMode != splashModeMono1);
+				       validBBox, docID);
     }
   }
   t3Font = t3FontCache[0];
 
   // is the glyph in the cache?
-  i = (code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
-  for (j = 0; j < t3Font->cacheAssoc; ++j) {
-    if ((t3Font->cacheTags[i+j].mru & 0x8000) &&
-	t3Font->cacheTags[i+j].code == code) {
-      drawType3Glyph(state, t3Font, &t3Font->cacheTags[i+j],
-		     t3Font->cacheData + (i+j) * t3Font->glyphSize);
-      return gTrue;
-    }
+  getType3GlyphKey(t3Font, code, &key);
+  if (glyphCache->lookup(&key, &glyph)) {
+    drawType3Glyph(state, &glyph);
+    glyphCache->release(&glyph);
+    return gTrue;
   }
 
   // push a new Type 3 glyph record
@@ -2037,8 +2652,7 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
   t3GlyphStack = t3gs;
   t3GlyphStack->code = code;
   t3GlyphStack->cache = t3Font;
-  t3GlyphStack->cacheTag = NULL;
-  t3GlyphStack->cacheData = NULL;
+  t3GlyphStack->cacheGlyph = gFalse;
   t3GlyphStack->haveDx = gFalse;
   t3GlyphStack->doNotCache = gFalse;
 
@@ -2047,13 +2661,28 @@ GBool SplashOutputDev::beginType3Char(GfxState *state, double x, double y,
 
 void SplashOutputDev::endType3Char(GfxState *state) {
   T3GlyphStack *t3gs;
+  T3FontCache *t3Font;
+  SplashGlyphCacheKey key;
+  SplashGlyphBitmap glyph;
+  SplashBitmap *glyphBitmap;
   double *ctm;
 
-  if (t3GlyphStack->cacheTag) {
+  if (t3GlyphStack->cacheGlyph) {
     --nestCount;
-    memcpy(t3GlyphStack->cacheData, bitmap->getDataPtr(),
-	   t3GlyphStack->cache->glyphSize);
-    delete bitmap;
+    t3Font = t3GlyphStack->cache;
+    glyph.x = -t3Font->glyphX;
+    glyph.y = -t3Font->glyphY;
+    glyph.w = t3Font->glyphW;
+    glyph.h = t3Font->glyphH;
+    glyph.aa = colorMode != splashModeMono1;
+    glyph.data = bitmap->getDataPtr();
+    glyph.freeData = gFalse;
+    glyph.cacheEntry = NULL;
+    getType3GlyphKey(t3Font, t3GlyphStack->code, &key);
+    // if the glyph is too large to be cached, this leaves it pointing
+    // to the temporary bitmap
+    glyphCache->insert(&key, &glyph);
+    glyphBitmap = bitmap;
     delete splash;
     bitmap = t3GlyphStack->origBitmap;
     splash = t3GlyphStack->origSplash;
@@ -2061,8 +2690,9 @@ void SplashOutputDev::endType3Char(GfxState *state) {
     state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3],
 		  t3GlyphStack->origCTM4, t3GlyphStack->origCTM5);
     updateCTM(state, 0, 0, 0, 0, 0, 0);
-    drawType3Glyph(state, t3GlyphStack->cache,
-		   t3GlyphStack->cacheTag, t3GlyphStack->cacheData);
+    drawType3Glyph(state, &glyph);
+    glyphCache->release(&glyph);
+    delete glyphBitmap;
   }
   t3gs = t3GlyphStack;
   t3GlyphStack = t3gs->next;
@@ -2079,7 +2709,6 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
   T3FontCache *t3Font;
   SplashColor color;
   double xt, yt, xMin, xMax, yMin, yMax, x1, y1;
-  int i, j;
 
   // ignore multiple d0/d1 operators
   if (t3GlyphStack->haveDx) {
@@ -2141,18 +2770,8 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
     return;
   }
 
-  // allocate a cache entry
-  i = (t3GlyphStack->code & (t3Font->cacheSets - 1)) * t3Font->cacheAssoc;
-  for (j = 0; j < t3Font->cacheAssoc; ++j) {
-    if ((t3Font->cacheTags[i+j].mru & 0x7fff) == t3Font->cacheAssoc - 1) {
-      t3Font->cacheTags[i+j].mru = 0x8000;
-      t3Font->cacheTags[i+j].code = t3GlyphStack->code;
-      t3GlyphStack->cacheTag = &t3Font->cacheTags[i+j];
-      t3GlyphStack->cacheData = t3Font->cacheData + (i+j) * t3Font->glyphSize;
-    } else {
-      ++t3Font->cacheTags[i+j].mru;
-    }
-  }
+  // the glyph will be added to the cache by endType3Char
+  t3GlyphStack->cacheGlyph = gTrue;
 
   // save state
   t3GlyphStack->origBitmap = bitmap;
@@ -2191,20 +2810,23 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
   ++nestCount;
 }
 
-void SplashOutputDev::drawType3Glyph(GfxState *state, T3FontCache *t3Font,
-				     T3FontCacheTag *tag, Guchar *data) {
-  SplashGlyphBitmap glyph;
+void SplashOutputDev::getType3GlyphKey(T3FontCache *t3Font, int code,
+					SplashGlyphCacheKey *key) {
+  key->font = t3Font->digest;
+  key->mat[0] = (SplashCoord)t3Font->m11;
+  key->mat[1] = (SplashCoord)t3Font->m12;
+  key->mat[2] = (SplashCoord)t3Font->m21;
+  key->mat[3] = (SplashCoord)t3Font->m22;
+  key->c = code;
+  key->xFrac = key->yFrac = 0;
+  key->aa = colorMode != splashModeMono1;
+}
 
+void SplashOutputDev::drawType3Glyph(GfxState *state,
+				     SplashGlyphBitmap *glyph) {
   setOverprintMask(state->getFillColorSpace(), state->getFillOverprint(),
 		   state->getOverprintMode(), state->getFillColor());
-  glyph.x = -t3Font->glyphX;
-  glyph.y = -t3Font->glyphY;
-  glyph.w = t3Font->glyphW;
-  glyph.h = t3Font->glyphH;
-  glyph.aa = colorMode != splashModeMono1;
-  glyph.data = data;
-  glyph.freeData = gFalse;
-  splash->fillGlyph(0, 0, &glyph);
+  splash->fillGlyph(0, 0, glyph);
 }
 
 void SplashOutputDev::endTextObject(GfxState *state) {
@@ -2310,7 +2932,9 @@ void SplashOutputDev::setSoftMaskFromImageMask(GfxState *state,
   imgMaskData.height = height;
   imgMaskData.y = 0;
   maskBitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(),
-				1, splashModeMono8, gFalse);
+				1, splashModeMono8, gFalse, gTrue,
+				bitmap->getBandY(), bitmap->getBandHeight(),
+				bitmapPool);
   maskSplash = new Splash(maskBitmap, gTrue);
   maskSplash->setStrokeAdjust(globalParams->getStrokeAdjust());
   clearMaskRegion(state, maskSplash, 0, 0, 1, 1);
@@ -2403,18 +3027,13 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
 GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 				     Guchar *alphaLine) {
   SplashOutImageData *imgData = (SplashOutImageData *)data;
-  Guchar *p, *aq;
+  Guchar *p0, *p, *aq;
   SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
   Guchar alpha;
   int nComps, x, i;
 
   if (imgData->y == imgData->height ||
-      !(p = imgData->imgStr->getLine())) {
+      !(p0 = imgData->imgStr->getLine())) {
     memset(colorLine, 0,
 	   imgData->width * splashColorModeNComps[imgData->colorMode]);
     memset(alphaLine, 0, imgData->width);
@@ -2423,67 +3042,67 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 
   nComps = imgData->colorMap->getNumPixelComps();
 
-  for (x = 0, q = colorLine, aq = alphaLine;
-       x < imgData->width;
-       ++x, p += nComps) {
-    alpha = 0;
-    for (i = 0; i < nComps; ++i) {
-      if (p[i] < imgData->maskColors[2*i] ||
-	  p[i] > imgData->maskColors[2*i+1]) {
-	alpha = 0xff;
-	break;
-      }
-    }
-    if (imgData->lookup) {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
+  // convert the whole line, then compute alpha from the mask colors
+  p = p0;
+  if (imgData->lookup) {
+    switch (imgData->colorMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	*q++ = imgData->lookup[*p];
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
+      }
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+      for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	col = &imgData->lookup[3 * *p];
 	*q++ = col[0];
 	*q++ = col[1];
 	*q++ = col[2];
-	break;
+      }
+      break;
 #if SPLASH_CMYK
-      case splashModeCMYK8:
+    case splashModeCMYK8:
+      for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	col = &imgData->lookup[4 * *p];
 	*q++ = col[0];
 	*q++ = col[1];
 	*q++ = col[2];
 	*q++ = col[3];
-	break;
-#endif
       }
-      *aq++ = alpha;
-    } else {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	break;
+      break;
+#endif
+    }
+  } else {
+    switch (imgData->colorMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      imgData->colorMap->getGrayByteLine(p, colorLine, imgData->width);
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+      imgData->colorMap->getRGBByteLine(p, colorLine, imgData->width);
+      break;
 #if SPLASH_CMYK
-      case splashModeCMYK8:
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-	break;
+    case splashModeCMYK8:
+      imgData->colorMap->getCMYKByteLine(p, colorLine, imgData->width);
+      break;
 #endif
+    }
+  }
+
+  for (x = 0, p = p0, aq = alphaLine;
+       x < imgData->width;
+       ++x, p += nComps) {
+    alpha = 0;
+    for (i = 0; i < nComps; ++i) {
+      if (p[i] < imgData->maskColors[2*i] ||
+	  p[i] > imgData->maskColors[2*i+1]) {
+	alpha = 0xff;
+	break;
       }
-      *aq++ = alpha;
     }
+    *aq++ = alpha;
   }
 
   ++imgData->y;
@@ -2610,13 +3229,7 @@ GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr colorLine,
   SplashOutMaskedImageData *imgData = (SplashOutMaskedImageData *)data;
   Guchar *p, *aq;
   SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
   static Guchar bitToByte[2] = {0x00, 0xff};
-  Guchar alpha;
   Guchar *maskPtr;
   int maskShift;
   int nComps, x;
@@ -2631,67 +3244,63 @@ GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr colorLine,
 
   nComps = imgData->colorMap->getNumPixelComps();
 
-  maskPtr = imgData->mask->getDataPtr() +
-              imgData->y * imgData->mask->getRowSize();
-  maskShift = 7;
-  for (x = 0, q = colorLine, aq = alphaLine;
-       x < imgData->width;
-       ++x, p += nComps) {
-    alpha = bitToByte[(*maskPtr >> maskShift) & 1];
-    maskPtr += (8 - maskShift) >> 3;
-    maskShift = (maskShift - 1) & 7;
-    if (imgData->lookup) {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
+  // convert the whole line, then expand the 1-bit mask into alpha
+  if (imgData->lookup) {
+    switch (imgData->colorMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	*q++ = imgData->lookup[*p];
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
+      }
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+      for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	col = &imgData->lookup[3 * *p];
 	*q++ = col[0];
 	*q++ = col[1];
 	*q++ = col[2];
-	break;
+      }
+      break;
 #if SPLASH_CMYK
-      case splashModeCMYK8:
+    case splashModeCMYK8:
+      for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	col = &imgData->lookup[4 * *p];
 	*q++ = col[0];
 	*q++ = col[1];
 	*q++ = col[2];
 	*q++ = col[3];
-	break;
-#endif
       }
-      *aq++ = alpha;
-    } else {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	break;
+      break;
+#endif
+    }
+  } else {
+    switch (imgData->colorMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      imgData->colorMap->getGrayByteLine(p, colorLine, imgData->width);
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+      imgData->colorMap->getRGBByteLine(p, colorLine, imgData->width);
+      break;
 #if SPLASH_CMYK
-      case splashModeCMYK8:
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-	break;
+    case splashModeCMYK8:
+      imgData->colorMap->getCMYKByteLine(p, colorLine, imgData->width);
+      break;
 #endif
-      }
-      *aq++ = alpha;
     }
   }
 
+  maskPtr = imgData->mask->getDataPtr() +
+              imgData->y * imgData->mask->getRowSize();
+  maskShift = 7;
+  for (x = 0, aq = alphaLine; x < imgData->width; ++x) {
+    *aq++ = bitToByte[(*maskPtr >> maskShift) & 1];
+    maskPtr += (8 - maskShift) >> 3;
+    maskShift = (maskShift - 1) & 7;
+  }
+
   ++imgData->y;
   return gTrue;
 }
@@ -2908,7 +3517,9 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
     imgMaskData.lookup[i] = colToByte(gray);
   }
   maskBitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(),
-				1, splashModeMono8, gFalse);
+				1, splashModeMono8, gFalse, gTrue,
+				bitmap->getBandY(), bitmap->getBandHeight(),
+				bitmapPool);
   maskSplash = new Splash(maskBitmap, vectorAntialias);
   maskSplash->setStrokeAdjust(globalParams->getStrokeAdjust());
   clearMaskRegion(state, maskSplash, 0, 0, 1, 1);
@@ -3060,14 +3671,14 @@ void SplashOutputDev::clearMaskRegion(GfxState *state,
     xxMaxI = maskBitmap->getWidth();
   }
   yyMinI = (int)floor(yyMin);
-  if (yyMinI < 0) {
-    yyMinI = 0;
+  if (yyMinI < maskBitmap->getBandY()) {
+    yyMinI = maskBitmap->getBandY();
   }
   yyMaxI = (int)ceil(yyMax);
-  if (yyMaxI > maskBitmap->getHeight()) {
-    yyMaxI = maskBitmap->getHeight();
+  if (yyMaxI > maskBitmap->getBandY() + maskBitmap->getBandHeight()) {
+    yyMaxI = maskBitmap->getBandY() + maskBitmap->getBandHeight();
   }
-  p = maskBitmap->getDataPtr() + yyMinI * maskBitmap->getRowSize();
+  p = maskBitmap->getRowPtr(yyMinI);
   if (maskBitmap->getMode() == splashModeMono1) {
     n = (xxMaxI + 7) / 8 - xxMinI / 8;
     p += xxMinI / 8;
@@ -3090,7 +3701,7 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
   SplashTransparencyGroup *transpGroup;
   SplashColor color;
   double xMin, yMin, xMax, yMax, x, y;
-  int tx, ty, w, h, i;
+  int tx, ty, w, h, bandY, bandH, i;
 
   // transform the bbox
   state->transform(bbox[0], bbox[1], &x, &y);
@@ -3156,6 +3767,23 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
     h = 1;
   }
 
+  // if only a band of the page is being rendered, the group bitmap
+  // only needs the rows in that band (the group is still drawn
+  // relative to tx,ty, so its rasterization doesn't change)
+  bandY = bitmap->getBandY() - ty;
+  if (bandY < 0) {
+    bandY = 0;
+  } else if (bandY > h - 1) {
+    bandY = h - 1;
+  }
+  bandH = bitmap->getBandY() + bitmap->getBandHeight() - ty - bandY;
+  if (bandH > h - bandY) {
+    bandH = h - bandY;
+  }
+  if (bandH < 1) {
+    bandH = 1;
+  }
+
   // push a new stack entry
   transpGroup = new SplashTransparencyGroup();
   transpGroup->tx = tx;
@@ -3196,11 +3824,20 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
 
   // create the temporary bitmap
   bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, gTrue,
-			    bitmapTopDown); 
+			    bitmapTopDown, bandY, bandH, bitmapPool);
   splash = new Splash(bitmap, vectorAntialias,
 		      transpGroup->origSplash->getScreen());
   splash->setMinLineWidth(globalParams->getMinLineWidth());
   splash->setStrokeAdjust(globalParams->getStrokeAdjust());
+  if (nThreads != 1) {
+    splash->setThreadPool(getThreadPool());
+  }
+  if (ty + bandY + bandH <= transpGroup->origBitmap->getBandY() ||
+      ty + bandY >= transpGroup->origBitmap->getBandY() +
+                    transpGroup->origBitmap->getBandHeight()) {
+    // the group doesn't intersect the band at all
+    splash->clipToRect(0, 0, 0, 0);
+  }
   //~ Acrobat apparently copies at least the fill and stroke colors, and
   //~ maybe other state(?) -- but not the clipping path (and not sure
   //~ what else)
@@ -3277,7 +3914,7 @@ void SplashOutputDev::setSoftMask(GfxState *state, double *bbox,
   GfxCMYK cmyk;
 #endif
   double backdrop, backdrop2, lum, lum2;
-  int tx, ty, x, y;
+  int tx, ty, x, y, yMin, yMax;
 
   tx = transpGroupStack->tx;
   ty = transpGroupStack->ty;
@@ -3341,12 +3978,23 @@ void SplashOutputDev::setSoftMask(GfxState *state, double *bbox,
   }
 
   softMask = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(),
-			      1, splashModeMono8, gFalse);
+			      1, splashModeMono8, gFalse, gTrue,
+			      bitmap->getBandY(), bitmap->getBandHeight(),
+			      bitmapPool);
   memset(softMask->getDataPtr(), (int)(backdrop2 * 255.0 + 0.5),
-	 softMask->getRowSize() * softMask->getHeight());
+	 softMask->getRowSize() * softMask->getBandHeight());
+  // only the group rows which are allocated in both bitmaps
+  yMin = tBitmap->getBandY();
+  if (yMin < softMask->getBandY() - ty) {
+    yMin = softMask->getBandY() - ty;
+  }
+  yMax = tBitmap->getBandY() + tBitmap->getBandHeight();
+  if (yMax > softMask->getBandY() + softMask->getBandHeight() - ty) {
+    yMax = softMask->getBandY() + softMask->getBandHeight() - ty;
+  }
   if (tx < softMask->getWidth() && ty < softMask->getHeight()) {
-  p = softMask->getDataPtr() + ty * softMask->getRowSize() + tx;
-  for (y = 0; y < tBitmap->getHeight(); ++y) {
+  p = softMask->getRowPtr(ty + yMin) + tx;
+  for (y = yMin; y < yMax; ++y) {
     for (x = 0; x < tBitmap->getWidth(); ++x) {
       if (alpha) {
 	  lum = tBitmap->getAlpha(x, y) / 255.0;
@@ -3431,6 +4079,45 @@ void SplashOutputDev::clearModRegion() {
   splash->clearModRegion();
 }
 
+void SplashOutputDev::setNumThreads(int nThreadsA) {
+  if (nThreadsA != nThreads && threadPool) {
+    if (splash) {
+      splash->setThreadPool(NULL);
+    }
+    delete threadPool;
+    threadPool = NULL;
+  }
+  nThreads = nThreadsA;
+}
+
+GThreadPool *SplashOutputDev::getThreadPool() {
+  if (!threadPool) {
+    threadPool = new GThreadPool(nThreads);
+  }
+  return threadPool;
+}
+
+void SplashOutputDev::setBand(int bandA, int nBandsA) {
+  if (nBandsA < 1 || bandA < 0 || bandA >= nBandsA) {
+    bandA = 0;
+    nBandsA = 1;
+  }
+  band = bandA;
+  nBands = nBandsA;
+}
+
+void SplashOutputDev::setGlyphCache(SplashGlyphCache *glyphCacheA) {
+  glyphCacheA->incRefCnt();
+  glyphCache->decRefCnt();
+  glyphCache = glyphCacheA;
+}
+
+void SplashOutputDev::setBitmapPool(SplashBitmapPool *bitmapPoolA) {
+  bitmapPoolA->incRefCnt();
+  bitmapPool->decRefCnt();
+  bitmapPool = bitmapPoolA;
+}
+
 void SplashOutputDev::setFillColor(int r, int g, int b) {
   GfxRGB rgb;
   GfxGray gray;
@@ -28,15 +28,21 @@ class SplashPath;
 class SplashPattern;
 class SplashFontEngine;
 class SplashFont;
+class SplashGlyphCache;
+class SplashBitmapPool;
+struct SplashGlyphBitmap;
+struct SplashGlyphCacheKey;
 class T3FontCache;
-struct T3FontCacheTag;
 struct T3GlyphStack;
 struct SplashTransparencyGroup;
+struct SplashShadedFill;
+class GThreadPool;
 
 //------------------------------------------------------------------------
 
-// number of Type 3 fonts to cache
-#define splashOutT3FontCacheSize 8
+// number of Type 3 fonts to cache (the glyphs themselves are in the
+// SplashGlyphCache)
+#define splashOutT3FontCacheSize 32
 
 //------------------------------------------------------------------------
 // SplashOutputDev
@@ -68,6 +74,11 @@ public:
   // operations.
   virtual GBool useTilingPatternFill() { return gTrue; }
 
+  // Does this device use functionShadedFill(), axialShadedFill(), and
+  // radialShadedFill()?  If this returns false, these shaded fills
+  // will be reduced to a series of other drawing operations.
+  virtual GBool useShadedFills() { return colorMode != splashModeMono1; }
+
   // Does this device use beginType3Char/endType3Char?  Otherwise,
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   virtual GBool interpretType3Chars() { return gTrue; }
@@ -115,6 +126,10 @@ public:
 				 double *mat, double *bbox,
 				 int x0, int y0, int x1, int y1,
 				 double xStep, double yStep);
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading);
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading);
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading);
 
   //----- path clipping
   virtual void clip(GfxState *state);
@@ -223,6 +238,34 @@ public:
 
   int getNestCount() { return nestCount; }
 
+  // Set the number of threads used to rasterize shaded fills and to
+  // upscale images.  One (the default) uses only the calling thread,
+  // zero means one per CPU.
+  void setNumThreads(int nThreadsA);
+
+  // Render only band <bandA> of <nBandsA> horizontal bands of each
+  // page.  The bitmap keeps the full page size and coordinate system
+  // (so the result is identical to the corresponding rows of a
+  // full-page render), but only the band's rows are allocated and
+  // drawn -- see SplashBitmap.  The default is setBand(0, 1).
+  void setBand(int bandA, int nBandsA);
+
+  // Use <glyphCacheA> for rasterized glyphs, instead of this output
+  // device's own cache.  This allows several output devices (e.g.,
+  // one per band or per document) to share glyphs.  This must be
+  // called before startDoc.
+  void setGlyphCache(SplashGlyphCache *glyphCacheA);
+
+  // Return the glyph cache (e.g., for its statistics).
+  SplashGlyphCache *getGlyphCache() { return glyphCache; }
+
+  // Take page, mask, and transparency group bitmap buffers from
+  // <bitmapPoolA>, instead of this output device's own pool.
+  void setBitmapPool(SplashBitmapPool *bitmapPoolA);
+
+  // Return the bitmap pool (e.g., for its statistics).
+  SplashBitmapPool *getBitmapPool() { return bitmapPool; }
+
 
 #if 1 //~tmp: turn off anti-aliasing temporarily
   virtual void setInShading(GBool sh);
@@ -238,11 +281,17 @@ private:
 #endif
   void setOverprintMask(GfxColorSpace *colorSpace, GBool overprintFlag,
 			int overprintMode, GfxColor *singleColor);
+  GBool startShadedFill(GfxState *state, double *shMat,
+			SplashShadedFill *sf);
+  void finishShadedFill(GfxState *state, GfxShading *shading,
+			SplashShadedFill *sf, void (*bandFunc)(void *, int));
+  GThreadPool *getThreadPool();
   SplashPath *convertPath(GfxState *state, GfxPath *path,
 			  GBool dropEmptySubpaths);
   void doUpdateFont(GfxState *state);
-  void drawType3Glyph(GfxState *state, T3FontCache *t3Font,
-		      T3FontCacheTag *tag, Guchar *data);
+  void getType3GlyphKey(T3FontCache *t3Font, int code,
+			SplashGlyphCacheKey *key);
+  void drawType3Glyph(GfxState *state, SplashGlyphBitmap *glyph);
   static GBool imageMaskSrc(void *data, SplashColorPtr line);
   static GBool imageSrc(void *data, SplashColorPtr colorLine,
 			Guchar *alphaLine);
@@ -275,6 +324,9 @@ private:
   SplashBitmap *bitmap;
   Splash *splash;
   SplashFontEngine *fontEngine;
+  SplashGlyphCache *glyphCache;	// rasterized glyphs (possibly shared)
+  SplashBitmapPool *bitmapPool;	// bitmap buffers (possibly shared)
+  int docID;			// unique ID for the current document
 
   T3FontCache *			// Type 3 font cache
     t3FontCache[splashOutT3FontCacheSize];
@@ -289,6 +341,11 @@ private:
     transpGroupStack;
 
   int nestCount;
+
+  int nThreads;			// number of threads for shaded fills
+				//   and image upscaling
+  int band, nBands;		// band to render
+  GThreadPool *threadPool;	// created on first use
 };
 
 #endif
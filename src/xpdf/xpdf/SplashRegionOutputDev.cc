@@ -0,0 +1,1366 @@
+//========================================================================
+//
+// SplashRegionOutputDev.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <limits.h>
+#include "gmem.h"
+#include "Object.h"
+#include "Stream.h"
+#include "GfxState.h"
+#include "Page.h"
+#include "SplashBitmap.h"
+#include "SplashOutputDev.h"
+#include "SplashRegionOutputDev.h"
+
+//------------------------------------------------------------------------
+
+// Image data larger than this is read separately by each region's
+// output device instead of being decoded once into memory.
+#define splashRegionMaxImageBuf (128 << 20)
+
+//------------------------------------------------------------------------
+// SplashRegion
+//------------------------------------------------------------------------
+
+struct SplashRegion {
+  int x, y, w, h;		// region, in full-page device space
+  double ctmDX, ctmDY;		// offset of the output device's CTM and
+  double clipDX, clipDY;	//   clip bbox from the shared GfxState
+  GBool active;			// cleared while skipping a Type 3 char
+				//   proc that this region has cached
+  GBool paint;			// cleared while skipping the decomposed
+				//   fills of a shading this region drew
+};
+
+//------------------------------------------------------------------------
+// SplashRegionMask
+//------------------------------------------------------------------------
+
+struct SplashRegionMask {
+  GBool *active;		// saved SplashRegion::active flags
+  GBool *paint;			// saved SplashRegion::paint flags
+  SplashRegionMask *next;
+};
+
+//------------------------------------------------------------------------
+// SplashRegionOutputDev
+//------------------------------------------------------------------------
+
+SplashRegionOutputDev::SplashRegionOutputDev(SplashColorMode colorModeA,
+					     int bitmapRowPadA,
+					     GBool reverseVideoA,
+					     SplashColorPtr paperColorA) {
+  colorMode = colorModeA;
+  bitmapRowPad = bitmapRowPadA;
+  reverseVideo = reverseVideoA;
+  splashColorCopy(paperColor, paperColorA);
+  xref = NULL;
+  outsSize = 1;
+  outs = (SplashOutputDev **)gmallocn(outsSize, sizeof(SplashOutputDev *));
+  outs[0] = NULL;
+  outs[0] = makeOutputDev();
+  regions = NULL;
+  nRegions = regionsSize = 0;
+  maskStack = NULL;
+  curRegion = -1;
+  nestCount = 0;
+  page = NULL;
+  rotate = 0;
+  useMediaBox = gFalse;
+}
+
+SplashRegionOutputDev::~SplashRegionOutputDev() {
+  int i;
+
+  while (maskStack) {
+    popMask();
+  }
+  for (i = 0; i < outsSize; ++i) {
+    if (outs[i]) {
+      delete outs[i];
+    }
+  }
+  gfree(outs);
+  gfree(regions);
+}
+
+SplashOutputDev *SplashRegionOutputDev::makeOutputDev() {
+  SplashOutputDev *out;
+
+  out = new SplashOutputDev(colorMode, bitmapRowPad, reverseVideo,
+			    paperColor);
+  // regions are small -- don't start a thread pool for each one
+  out->setNumThreads(1);
+  if (outs[0]) {
+    out->setGlyphCache(outs[0]->getGlyphCache());
+    out->setBitmapPool(outs[0]->getBitmapPool());
+  }
+  if (xref) {
+    out->startDoc(xref);
+  }
+  return out;
+}
+
+void SplashRegionOutputDev::startDoc(XRef *xrefA) {
+  int i;
+
+  xref = xrefA;
+  for (i = 0; i < outsSize; ++i) {
+    if (outs[i]) {
+      outs[i]->startDoc(xref);
+    }
+  }
+}
+
+void SplashRegionOutputDev::clearRegions() {
+  nRegions = 0;
+}
+
+void SplashRegionOutputDev::addRegion(int x, int y, int w, int h) {
+  SplashRegion *r;
+  int i;
+
+  if (nRegions == regionsSize) {
+    regionsSize = regionsSize ? 2 * regionsSize : 16;
+    regions = (SplashRegion *)greallocn(regions, regionsSize,
+					sizeof(SplashRegion));
+  }
+  if (nRegions == outsSize) {
+    outs = (SplashOutputDev **)greallocn(outs, 2 * outsSize,
+					 sizeof(SplashOutputDev *));
+    for (i = outsSize; i < 2 * outsSize; ++i) {
+      outs[i] = NULL;
+    }
+    outsSize *= 2;
+  }
+  if (!outs[nRegions]) {
+    outs[nRegions] = makeOutputDev();
+  }
+  r = &regions[nRegions++];
+  r->x = x;
+  r->y = y;
+  r->w = w < 1 ? 1 : w;
+  r->h = h < 1 ? 1 : h;
+  r->ctmDX = r->ctmDY = 0;
+  r->clipDX = r->clipDY = 0;
+  r->active = gTrue;
+  r->paint = gTrue;
+}
+
+SplashBitmap *SplashRegionOutputDev::getBitmap(int idx) {
+  return outs[idx]->getBitmap();
+}
+
+SplashOutputDev *SplashRegionOutputDev::getOutputDev(int idx) {
+  return outs[idx];
+}
+
+GBool SplashRegionOutputDev::upsideDown() {
+  return outs[0]->upsideDown();
+}
+
+GBool SplashRegionOutputDev::useShadedFills() {
+  return outs[0]->useShadedFills();
+}
+
+// Shift the shared GfxState into region <idx>'s device space.
+// Returns false if region <idx> shouldn't see the current call.
+// <painting> is set for calls that draw something (as opposed to
+// updating the state).
+GBool SplashRegionOutputDev::enterRegion(GfxState *state, int idx,
+					 GBool painting) {
+  SplashRegion *r;
+  double *ctm;
+
+  // a call made by curRegion's output device (e.g., from
+  // tilingPatternFill) -- the state is already in its device space
+  if (curRegion >= 0) {
+    if (idx != curRegion) {
+      return gFalse;
+    }
+    ++nestCount;
+    return gTrue;
+  }
+  r = &regions[idx];
+  if (!r->active || (painting && !r->paint)) {
+    return gFalse;
+  }
+  if (state) {
+    ctm = state->getCTM();
+    savedCTM[0] = ctm[4];
+    savedCTM[1] = ctm[5];
+    state->getClipBBox(&savedClip[0], &savedClip[1],
+		       &savedClip[2], &savedClip[3]);
+    state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3],
+		  savedCTM[0] + r->ctmDX, savedCTM[1] + r->ctmDY);
+    state->setClipBBox(savedClip[0] + r->clipDX, savedClip[1] + r->clipDY,
+		       savedClip[2] + r->clipDX, savedClip[3] + r->clipDY);
+  }
+  curRegion = idx;
+  return gTrue;
+}
+
+// Record any change the output device made to the CTM (e.g., for a
+// transparency group or a Type 3 glyph), and restore the shared
+// GfxState.
+void SplashRegionOutputDev::leaveRegion(GfxState *state, int idx) {
+  SplashRegion *r;
+  double *ctm;
+  double xMin, yMin, xMax, yMax;
+
+  if (nestCount > 0) {
+    --nestCount;
+    return;
+  }
+  r = &regions[idx];
+  if (state) {
+    ctm = state->getCTM();
+    r->ctmDX = ctm[4] - savedCTM[0];
+    r->ctmDY = ctm[5] - savedCTM[1];
+    state->getClipBBox(&xMin, &yMin, &xMax, &yMax);
+    r->clipDX = xMin - savedClip[0];
+    r->clipDY = yMin - savedClip[1];
+    state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], savedCTM[0], savedCTM[1]);
+    state->setClipBBox(savedClip[0], savedClip[1],
+		       savedClip[2], savedClip[3]);
+  }
+  curRegion = -1;
+}
+
+// Returns the number of regions that will see the current call.
+int SplashRegionOutputDev::getNumActive(GBool painting) {
+  int n, i;
+
+  if (curRegion >= 0) {
+    return 1;
+  }
+  n = 0;
+  for (i = 0; i < nRegions; ++i) {
+    if (regions[i].active && (regions[i].paint || !painting)) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+void SplashRegionOutputDev::pushMask() {
+  SplashRegionMask *mask;
+  int i;
+
+  mask = new SplashRegionMask;
+  mask->active = (GBool *)gmallocn(nRegions > 0 ? nRegions : 1,
+				   sizeof(GBool));
+  mask->paint = (GBool *)gmallocn(nRegions > 0 ? nRegions : 1,
+				  sizeof(GBool));
+  for (i = 0; i < nRegions; ++i) {
+    mask->active[i] = regions[i].active;
+    mask->paint[i] = regions[i].paint;
+  }
+  mask->next = maskStack;
+  maskStack = mask;
+}
+
+void SplashRegionOutputDev::popMask() {
+  SplashRegionMask *mask;
+  int i;
+
+  mask = maskStack;
+  maskStack = mask->next;
+  for (i = 0; i < nRegions; ++i) {
+    regions[i].active = mask->active[i];
+    regions[i].paint = mask->paint[i];
+  }
+  gfree(mask->active);
+  gfree(mask->paint);
+  delete mask;
+}
+
+void SplashRegionOutputDev::setDefaultCTM(double *ctm) {
+  double ctm2[6];
+  int i, j;
+
+  OutputDev::setDefaultCTM(ctm);
+  for (i = 0; i < nRegions; ++i) {
+    for (j = 0; j < 6; ++j) {
+      ctm2[j] = ctm[j];
+    }
+    ctm2[4] += regions[i].ctmDX;
+    ctm2[5] += regions[i].ctmDY;
+    outs[i]->setDefaultCTM(ctm2);
+  }
+}
+
+GBool SplashRegionOutputDev::checkPageSlice(Page *pageA,
+					    double hDPI, double vDPI,
+					    int rotateA, GBool useMediaBoxA,
+					    GBool crop,
+					    int sliceX, int sliceY,
+					    int sliceW, int sliceH,
+					    GBool printing,
+					    GBool (*abortCheckCbk)(void *data),
+					    void *abortCheckCbkData) {
+  page = pageA;
+  rotate = rotateA + page->getRotate();
+  if (rotate >= 360) {
+    rotate -= 360;
+  } else if (rotate < 0) {
+    rotate += 360;
+  }
+  useMediaBox = useMediaBoxA;
+  return gTrue;
+}
+
+// Each region's output device gets the state it would get from
+// displayPageSlice.  The region's offset from the full page is the
+// difference between the two CTMs.
+void SplashRegionOutputDev::startPage(int pageNum, GfxState *state) {
+  SplashRegion *r;
+  GfxState *regionState;
+  PDFRectangle box;
+  GBool crop;
+  double *ctm, *regionCTM;
+  int i;
+
+  while (maskStack) {
+    popMask();
+  }
+  curRegion = -1;
+  nestCount = 0;
+  ctm = state->getCTM();
+  for (i = 0; i < nRegions; ++i) {
+    r = &regions[i];
+    page->makeBox(state->getHDPI(), state->getVDPI(), rotate, useMediaBox,
+		  upsideDown(), r->x, r->y, r->w, r->h, &box, &crop);
+    regionState = new GfxState(state->getHDPI(), state->getVDPI(), &box,
+			       rotate, upsideDown());
+    regionCTM = regionState->getCTM();
+    r->ctmDX = r->clipDX = regionCTM[4] - ctm[4];
+    r->ctmDY = r->clipDY = regionCTM[5] - ctm[5];
+    r->active = gTrue;
+    r->paint = gTrue;
+    outs[i]->startPage(pageNum, regionState);
+    delete regionState;
+  }
+}
+
+void SplashRegionOutputDev::endPage() {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    outs[i]->endPage();
+  }
+}
+
+void SplashRegionOutputDev::dump() {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(NULL, i, gFalse)) {
+      outs[i]->dump();
+      leaveRegion(NULL, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::saveState(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->saveState(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::restoreState(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->restoreState(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateAll(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateAll(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateCTM(GfxState *state, double m11, double m12,
+				      double m21, double m22,
+				      double m31, double m32) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateCTM(state, m11, m12, m21, m22, m31, m32);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateLineDash(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateLineDash(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateFlatness(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateFlatness(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateLineJoin(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateLineJoin(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateLineCap(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateLineCap(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateMiterLimit(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateMiterLimit(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateLineWidth(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateLineWidth(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateStrokeAdjust(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateStrokeAdjust(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateFillColorSpace(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateFillColorSpace(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateStrokeColorSpace(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateStrokeColorSpace(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateFillColor(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateFillColor(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateStrokeColor(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateStrokeColor(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateBlendMode(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateBlendMode(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateFillOpacity(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateFillOpacity(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateStrokeOpacity(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateStrokeOpacity(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateFillOverprint(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateFillOverprint(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateStrokeOverprint(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateStrokeOverprint(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateOverprintMode(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateOverprintMode(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateTransfer(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateTransfer(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateFont(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateFont(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateTextMat(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateTextMat(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateCharSpace(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateCharSpace(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateRender(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateRender(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateRise(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateRise(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateWordSpace(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateWordSpace(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateHorizScaling(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateHorizScaling(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateTextPos(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateTextPos(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::updateTextShift(GfxState *state, double shift) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->updateTextShift(state, shift);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::saveTextPos(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->saveTextPos(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::restoreTextPos(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->restoreTextPos(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::stroke(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->stroke(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::fill(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->fill(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::eoFill(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->eoFill(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::tilingPatternFill(GfxState *state, Gfx *gfx,
+					      Object *strRef,
+					      int paintType, Dict *resDict,
+					      double *mat, double *bbox,
+					      int x0, int y0, int x1, int y1,
+					      double xStep, double yStep) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->tilingPatternFill(state, gfx, strRef, paintType, resDict,
+				   mat, bbox, x0, y0, x1, y1, xStep, yStep);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+// If only some of the regions can draw the shading, Gfx is told that
+// it wasn't drawn, and the fills it uses instead go only to the
+// regions that couldn't draw it (Gfx calls beginNonText/endNonText
+// around shadings, which restore the flags).
+GBool SplashRegionOutputDev::functionShadedFill(GfxState *state,
+						GfxFunctionShading *shading) {
+  GBool nested, all;
+  int i;
+
+  nested = curRegion >= 0;
+  all = gTrue;
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      if (outs[i]->functionShadedFill(state, shading)) {
+	if (!nested) {
+	  regions[i].paint = gFalse;
+	}
+      } else {
+	all = gFalse;
+      }
+      leaveRegion(state, i);
+    }
+  }
+  return all;
+}
+
+GBool SplashRegionOutputDev::axialShadedFill(GfxState *state,
+					     GfxAxialShading *shading) {
+  GBool nested, all;
+  int i;
+
+  nested = curRegion >= 0;
+  all = gTrue;
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      if (outs[i]->axialShadedFill(state, shading)) {
+	if (!nested) {
+	  regions[i].paint = gFalse;
+	}
+      } else {
+	all = gFalse;
+      }
+      leaveRegion(state, i);
+    }
+  }
+  return all;
+}
+
+GBool SplashRegionOutputDev::radialShadedFill(GfxState *state,
+					      GfxRadialShading *shading) {
+  GBool nested, all;
+  int i;
+
+  nested = curRegion >= 0;
+  all = gTrue;
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      if (outs[i]->radialShadedFill(state, shading)) {
+	if (!nested) {
+	  regions[i].paint = gFalse;
+	}
+      } else {
+	all = gFalse;
+      }
+      leaveRegion(state, i);
+    }
+  }
+  return all;
+}
+
+void SplashRegionOutputDev::clip(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->clip(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::eoClip(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->eoClip(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::clipToStrokePath(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->clipToStrokePath(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::beginStringOp(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->beginStringOp(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::endStringOp(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->endStringOp(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::beginString(GfxState *state, GString *s) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->beginString(state, s);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::endString(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->endString(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::drawChar(GfxState *state, double x, double y,
+				     double dx, double dy,
+				     double originX, double originY,
+				     CharCode code, int nBytes,
+				     Unicode *u, int uLen) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->drawChar(state, x, y, dx, dy, originX, originY,
+			  code, nBytes, u, uLen);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+// Type 3 chars that a region has already cached are drawn by its
+// beginType3Char -- the char proc goes only to the regions that
+// haven't (endType3Char restores the flags).
+GBool SplashRegionOutputDev::beginType3Char(GfxState *state,
+					    double x, double y,
+					    double dx, double dy,
+					    CharCode code,
+					    Unicode *u, int uLen) {
+  GBool nested, any;
+  int i;
+
+  nested = curRegion >= 0;
+  if (!nested) {
+    pushMask();
+  }
+  any = gFalse;
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      if (outs[i]->beginType3Char(state, x, y, dx, dy, code, u, uLen)) {
+	if (!nested) {
+	  regions[i].active = gFalse;
+	}
+      } else {
+	any = gTrue;
+      }
+      leaveRegion(state, i);
+    } else if (!nested) {
+      regions[i].active = gFalse;
+    }
+  }
+  if (!any) {
+    if (!nested) {
+      popMask();
+    }
+    return gTrue;
+  }
+  return gFalse;
+}
+
+void SplashRegionOutputDev::endType3Char(GfxState *state) {
+  GBool nested;
+  int i;
+
+  nested = curRegion >= 0;
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->endType3Char(state);
+      leaveRegion(state, i);
+    }
+  }
+  if (!nested) {
+    popMask();
+  }
+}
+
+void SplashRegionOutputDev::endTextObject(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->endTextObject(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+// Returns the number of bytes of image data, or -1 on overflow.
+static int getImageDataSize(int width, int height, int nComps, int bits) {
+  int rowSize;
+
+  if (width <= 0 || height <= 0 || nComps <= 0 || bits <= 0 ||
+      nComps > INT_MAX / bits ||
+      width > (INT_MAX - 7) / (nComps * bits)) {
+    return -1;
+  }
+  rowSize = (width * nComps * bits + 7) / 8;
+  if (height > INT_MAX / rowSize) {
+    return -1;
+  }
+  return height * rowSize;
+}
+
+// When more than one region draws an image, the image data is
+// decoded once into memory, and each region's output device reads
+// it from a MemStream.  Returns NULL (and each output device reads
+// <str> itself) if the data is too large -- or if it's a large JPX
+// image, which SplashOutputDev decodes at reduced resolution.
+Stream *SplashRegionOutputDev::readImageData(Stream *str, int nBytes,
+					     GBool inlineImg, char **buf) {
+  Object obj;
+  int n;
+
+  *buf = NULL;
+  if (nBytes < 0) {
+    return NULL;
+  }
+  if (!inlineImg &&
+      (nBytes > splashRegionMaxImageBuf ||
+       (str->getKind() == strJPX && nBytes > 10000000))) {
+    return NULL;
+  }
+  *buf = (char *)gmalloc(nBytes > 0 ? nBytes : 1);
+  str->reset();
+  n = str->getBlock(*buf, nBytes);
+  str->close();
+  obj.initNull();
+  return new MemStream(*buf, 0, n, &obj);
+}
+
+void SplashRegionOutputDev::drawImageMask(GfxState *state, Object *ref,
+					  Stream *str,
+					  int width, int height, GBool invert,
+					  GBool inlineImg, GBool interpolate) {
+  Stream *memStr;
+  char *buf;
+  int i;
+
+  if (getNumActive(gTrue) == 0) {
+    OutputDev::drawImageMask(state, ref, str, width, height, invert,
+			     inlineImg, interpolate);
+    return;
+  }
+  memStr = NULL;
+  buf = NULL;
+  if (getNumActive(gTrue) > 1) {
+    memStr = readImageData(str, getImageDataSize(width, height, 1, 1),
+			   inlineImg, &buf);
+  }
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->drawImageMask(state, ref, memStr ? memStr : str,
+			     width, height, invert, inlineImg, interpolate);
+      leaveRegion(state, i);
+    }
+  }
+  if (memStr) {
+    delete memStr;
+  }
+  gfree(buf);
+}
+
+void SplashRegionOutputDev::setSoftMaskFromImageMask(GfxState *state,
+						     Object *ref, Stream *str,
+						     int width, int height,
+						     GBool invert,
+						     GBool inlineImg,
+						     GBool interpolate) {
+  Stream *memStr;
+  char *buf;
+  int i;
+
+  if (getNumActive(gFalse) == 0) {
+    OutputDev::setSoftMaskFromImageMask(state, ref, str, width, height,
+					invert, inlineImg, interpolate);
+    return;
+  }
+  memStr = NULL;
+  buf = NULL;
+  if (getNumActive(gFalse) > 1) {
+    memStr = readImageData(str, getImageDataSize(width, height, 1, 1),
+			   inlineImg, &buf);
+  }
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->setSoftMaskFromImageMask(state, ref, memStr ? memStr : str,
+					width, height, invert, inlineImg,
+					interpolate);
+      leaveRegion(state, i);
+    }
+  }
+  if (memStr) {
+    delete memStr;
+  }
+  gfree(buf);
+}
+
+void SplashRegionOutputDev::drawImage(GfxState *state, Object *ref,
+				      Stream *str,
+				      int width, int height,
+				      GfxImageColorMap *colorMap,
+				      int *maskColors, GBool inlineImg,
+				      GBool interpolate) {
+  Stream *memStr;
+  char *buf;
+  int i;
+
+  if (getNumActive(gTrue) == 0) {
+    OutputDev::drawImage(state, ref, str, width, height, colorMap,
+			 maskColors, inlineImg, interpolate);
+    return;
+  }
+  memStr = NULL;
+  buf = NULL;
+  if (getNumActive(gTrue) > 1) {
+    memStr = readImageData(str,
+			   getImageDataSize(width, height,
+					    colorMap->getNumPixelComps(),
+					    colorMap->getBits()),
+			   inlineImg, &buf);
+  }
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->drawImage(state, ref, memStr ? memStr : str, width, height,
+			 colorMap, maskColors, inlineImg, interpolate);
+      leaveRegion(state, i);
+    }
+  }
+  if (memStr) {
+    delete memStr;
+  }
+  gfree(buf);
+}
+
+void SplashRegionOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+					    Stream *str,
+					    int width, int height,
+					    GfxImageColorMap *colorMap,
+					    Stream *maskStr,
+					    int maskWidth, int maskHeight,
+					    GBool maskInvert,
+					    GBool interpolate) {
+  Stream *memStr, *memMaskStr;
+  char *buf, *maskBuf;
+  int i;
+
+  if (getNumActive(gTrue) == 0) {
+    return;
+  }
+  memStr = memMaskStr = NULL;
+  buf = maskBuf = NULL;
+  if (getNumActive(gTrue) > 1) {
+    memStr = readImageData(str,
+			   getImageDataSize(width, height,
+					    colorMap->getNumPixelComps(),
+					    colorMap->getBits()),
+			   gFalse, &buf);
+    memMaskStr = readImageData(maskStr,
+			       getImageDataSize(maskWidth, maskHeight, 1, 1),
+			       gFalse, &maskBuf);
+  }
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->drawMaskedImage(state, ref, memStr ? memStr : str,
+			       width, height, colorMap,
+			       memMaskStr ? memMaskStr : maskStr,
+			       maskWidth, maskHeight, maskInvert,
+			       interpolate);
+      leaveRegion(state, i);
+    }
+  }
+  if (memStr) {
+    delete memStr;
+  }
+  if (memMaskStr) {
+    delete memMaskStr;
+  }
+  gfree(buf);
+  gfree(maskBuf);
+}
+
+void SplashRegionOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+						Stream *str,
+						int width, int height,
+						GfxImageColorMap *colorMap,
+						Stream *maskStr,
+						int maskWidth, int maskHeight,
+						GfxImageColorMap *maskColorMap,
+						GBool interpolate) {
+  Stream *memStr, *memMaskStr;
+  char *buf, *maskBuf;
+  int i;
+
+  if (getNumActive(gTrue) == 0) {
+    return;
+  }
+  memStr = memMaskStr = NULL;
+  buf = maskBuf = NULL;
+  if (getNumActive(gTrue) > 1) {
+    memStr = readImageData(str,
+			   getImageDataSize(width, height,
+					    colorMap->getNumPixelComps(),
+					    colorMap->getBits()),
+			   gFalse, &buf);
+    memMaskStr = readImageData(maskStr,
+			       getImageDataSize(maskWidth, maskHeight,
+						maskColorMap->getNumPixelComps(),
+						maskColorMap->getBits()),
+			       gFalse, &maskBuf);
+  }
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gTrue)) {
+      outs[i]->drawSoftMaskedImage(state, ref, memStr ? memStr : str,
+				   width, height, colorMap,
+				   memMaskStr ? memMaskStr : maskStr,
+				   maskWidth, maskHeight, maskColorMap,
+				   interpolate);
+      leaveRegion(state, i);
+    }
+  }
+  if (memStr) {
+    delete memStr;
+  }
+  if (memMaskStr) {
+    delete memMaskStr;
+  }
+  gfree(buf);
+  gfree(maskBuf);
+}
+
+void SplashRegionOutputDev::type3D0(GfxState *state, double wx, double wy) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->type3D0(state, wx, wy);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::type3D1(GfxState *state, double wx, double wy,
+				    double llx, double lly,
+				    double urx, double ury) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->type3D1(state, wx, wy, llx, lly, urx, ury);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::beginTransparencyGroup(
+				      GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->beginTransparencyGroup(state, bbox, blendingColorSpace,
+				      isolated, knockout, forSoftMask);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::endTransparencyGroup(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->endTransparencyGroup(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::paintTransparencyGroup(GfxState *state,
+						   double *bbox) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->paintTransparencyGroup(state, bbox);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::setSoftMask(GfxState *state, double *bbox,
+					GBool alpha, Function *transferFunc,
+					GfxColor *backdropColor) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->setSoftMask(state, bbox, alpha, transferFunc, backdropColor);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::clearSoftMask(GfxState *state) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(state, i, gFalse)) {
+      outs[i]->clearSoftMask(state);
+      leaveRegion(state, i);
+    }
+  }
+}
+
+void SplashRegionOutputDev::beginNonText() {
+  pushMask();
+}
+
+void SplashRegionOutputDev::endNonText() {
+  popMask();
+}
+
+#if 1 //~tmp: turn off anti-aliasing temporarily
+void SplashRegionOutputDev::setInShading(GBool sh) {
+  int i;
+
+  for (i = 0; i < nRegions; ++i) {
+    if (enterRegion(NULL, i, gFalse)) {
+      outs[i]->setInShading(sh);
+      leaveRegion(NULL, i);
+    }
+  }
+}
+#endif
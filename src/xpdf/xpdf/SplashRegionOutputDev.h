@@ -0,0 +1,255 @@
+//========================================================================
+//
+// SplashRegionOutputDev.h
+//
+// Render several regions of a page, each into its own bitmap, from a
+// single pass over the page's content stream.
+//
+//========================================================================
+
+#ifndef SPLASHREGIONOUTPUTDEV_H
+#define SPLASHREGIONOUTPUTDEV_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#include "SplashTypes.h"
+#include "OutputDev.h"
+
+class SplashBitmap;
+class SplashOutputDev;
+struct SplashRegion;
+struct SplashRegionMask;
+
+//------------------------------------------------------------------------
+// SplashRegionOutputDev
+//------------------------------------------------------------------------
+
+// Each region is drawn by its own SplashOutputDev, with a bitmap
+// that covers only the region -- the result is the same as rendering
+// the region with PDFDoc::displayPageSlice, but the page is parsed
+// and interpreted once, and image data is decoded once, for all
+// regions.
+//
+// The GfxState is shared: around each call, it is shifted into the
+// region's device space (the same way SplashOutputDev handles
+// tiling patterns and transparency groups), and any change the
+// region's SplashOutputDev makes to the CTM is remembered for the
+// next call.  Calls made by a region's SplashOutputDev back into Gfx
+// (tiling patterns) go to that region only.  Type 3 char procs and
+// decomposed shaded fills go only to the regions that need them.
+class SplashRegionOutputDev: public OutputDev {
+public:
+
+  // Constructor -- the args are passed to the SplashOutputDev
+  // constructor.
+  SplashRegionOutputDev(SplashColorMode colorModeA, int bitmapRowPadA,
+			GBool reverseVideoA, SplashColorPtr paperColorA);
+
+  // Destructor.
+  virtual ~SplashRegionOutputDev();
+
+  // Called when a new document is opened.
+  void startDoc(XRef *xrefA);
+
+  // Set the regions drawn by the next displayPage call.  Regions are
+  // in pixels, in the device space of the full page at the resolution
+  // passed to displayPage (the same as the sliceX/Y/W/H args of
+  // displayPageSlice).  Rotation, useMediaBox, and crop work as for
+  // a full-page render.
+  void clearRegions();
+  void addRegion(int x, int y, int w, int h);
+  int getNumRegions() { return nRegions; }
+
+  // Get the bitmap for region <idx> of the last page.
+  SplashBitmap *getBitmap(int idx);
+
+  // Get the output device for region <idx>.
+  SplashOutputDev *getOutputDev(int idx);
+
+  //----- get info about output device
+
+  virtual GBool upsideDown();
+  virtual GBool useDrawChar() { return gTrue; }
+  virtual GBool useTilingPatternFill() { return gTrue; }
+  virtual GBool useShadedFills();
+  virtual GBool interpretType3Chars() { return gTrue; }
+
+  //----- initialization and control
+
+  virtual void setDefaultCTM(double *ctm);
+  virtual GBool checkPageSlice(Page *page, double hDPI, double vDPI,
+			       int rotate, GBool useMediaBox, GBool crop,
+			       int sliceX, int sliceY, int sliceW, int sliceH,
+			       GBool printing,
+			       GBool (*abortCheckCbk)(void *data) = NULL,
+			       void *abortCheckCbkData = NULL);
+  virtual void startPage(int pageNum, GfxState *state);
+  virtual void endPage();
+  virtual void dump();
+
+  //----- save/restore graphics state
+  virtual void saveState(GfxState *state);
+  virtual void restoreState(GfxState *state);
+
+  //----- update graphics state
+  virtual void updateAll(GfxState *state);
+  virtual void updateCTM(GfxState *state, double m11, double m12,
+			 double m21, double m22, double m31, double m32);
+  virtual void updateLineDash(GfxState *state);
+  virtual void updateFlatness(GfxState *state);
+  virtual void updateLineJoin(GfxState *state);
+  virtual void updateLineCap(GfxState *state);
+  virtual void updateMiterLimit(GfxState *state);
+  virtual void updateLineWidth(GfxState *state);
+  virtual void updateStrokeAdjust(GfxState *state);
+  virtual void updateFillColorSpace(GfxState *state);
+  virtual void updateStrokeColorSpace(GfxState *state);
+  virtual void updateFillColor(GfxState *state);
+  virtual void updateStrokeColor(GfxState *state);
+  virtual void updateBlendMode(GfxState *state);
+  virtual void updateFillOpacity(GfxState *state);
+  virtual void updateStrokeOpacity(GfxState *state);
+  virtual void updateFillOverprint(GfxState *state);
+  virtual void updateStrokeOverprint(GfxState *state);
+  virtual void updateOverprintMode(GfxState *state);
+  virtual void updateTransfer(GfxState *state);
+
+  //----- update text state
+  virtual void updateFont(GfxState *state);
+  virtual void updateTextMat(GfxState *state);
+  virtual void updateCharSpace(GfxState *state);
+  virtual void updateRender(GfxState *state);
+  virtual void updateRise(GfxState *state);
+  virtual void updateWordSpace(GfxState *state);
+  virtual void updateHorizScaling(GfxState *state);
+  virtual void updateTextPos(GfxState *state);
+  virtual void updateTextShift(GfxState *state, double shift);
+  virtual void saveTextPos(GfxState *state);
+  virtual void restoreTextPos(GfxState *state);
+
+  //----- path painting
+  virtual void stroke(GfxState *state);
+  virtual void fill(GfxState *state);
+  virtual void eoFill(GfxState *state);
+  virtual void tilingPatternFill(GfxState *state, Gfx *gfx, Object *strRef,
+				 int paintType, Dict *resDict,
+				 double *mat, double *bbox,
+				 int x0, int y0, int x1, int y1,
+				 double xStep, double yStep);
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading);
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading);
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading);
+
+  //----- path clipping
+  virtual void clip(GfxState *state);
+  virtual void eoClip(GfxState *state);
+  virtual void clipToStrokePath(GfxState *state);
+
+  //----- text drawing
+  virtual void beginStringOp(GfxState *state);
+  virtual void endStringOp(GfxState *state);
+  virtual void beginString(GfxState *state, GString *s);
+  virtual void endString(GfxState *state);
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+  virtual GBool beginType3Char(GfxState *state, double x, double y,
+			       double dx, double dy,
+			       CharCode code, Unicode *u, int uLen);
+  virtual void endType3Char(GfxState *state);
+  virtual void endTextObject(GfxState *state);
+
+  //----- image drawing
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool inlineImg, GBool interpolate);
+  virtual void setSoftMaskFromImageMask(GfxState *state,
+					Object *ref, Stream *str,
+					int width, int height, GBool invert,
+					GBool inlineImg, GBool interpolate);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 int *maskColors, GBool inlineImg, GBool interpolate);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert, GBool interpolate);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap,
+				   GBool interpolate);
+
+  //----- Type 3 font operators
+  virtual void type3D0(GfxState *state, double wx, double wy);
+  virtual void type3D1(GfxState *state, double wx, double wy,
+		       double llx, double lly, double urx, double ury);
+
+  //----- transparency groups and soft masks
+  virtual void beginTransparencyGroup(GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask);
+  virtual void endTransparencyGroup(GfxState *state);
+  virtual void paintTransparencyGroup(GfxState *state, double *bbox);
+  virtual void setSoftMask(GfxState *state, double *bbox, GBool alpha,
+			   Function *transferFunc, GfxColor *backdropColor);
+  virtual void clearSoftMask(GfxState *state);
+
+  //----- non-text content
+  virtual void beginNonText();
+  virtual void endNonText();
+
+#if 1 //~tmp: turn off anti-aliasing temporarily
+  virtual void setInShading(GBool sh);
+#endif
+
+private:
+
+  SplashOutputDev *makeOutputDev();
+  GBool enterRegion(GfxState *state, int idx, GBool painting);
+  void leaveRegion(GfxState *state, int idx);
+  int getNumActive(GBool painting);
+  void pushMask();
+  void popMask();
+  Stream *readImageData(Stream *str, int nBytes, GBool inlineImg,
+			char **buf);
+
+  SplashColorMode colorMode;
+  int bitmapRowPad;
+  GBool reverseVideo;
+  SplashColor paperColor;
+  XRef *xref;
+
+  SplashOutputDev **outs;	// output devices (outs[0] always exists;
+				//   there may be more than nRegions)
+  int outsSize;			// size of outs array
+  SplashRegion *regions;	// regions for the current page
+  int nRegions;			// number of regions
+  int regionsSize;		// size of regions array
+  SplashRegionMask *maskStack;	// saved active flags
+
+  int curRegion;		// region whose output device is currently
+				//   being called, or -1
+  int nestCount;		// nesting level of calls made back into
+				//   this device while curRegion is set
+  double savedCTM[2];		// CTM translation and clip bbox of the
+  double savedClip[4];		//   shared state while curRegion is set
+
+  // page passed to checkPageSlice
+  Page *page;
+  int rotate;
+  GBool useMediaBox;
+};
+
+#endif
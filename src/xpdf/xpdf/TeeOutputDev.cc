@@ -0,0 +1,692 @@
+//========================================================================
+//
+// TeeOutputDev.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stddef.h>
+#include "Object.h"
+#include "Stream.h"
+#include "GfxState.h"
+#include "GfxFont.h"
+#include "TeeOutputDev.h"
+
+//------------------------------------------------------------------------
+// TeeOutputDev
+//------------------------------------------------------------------------
+
+TeeOutputDev::TeeOutputDev(OutputDev *rasterDevA, OutputDev *textDevA) {
+  Object obj;
+
+  rasterDev = rasterDevA;
+  textDev = textDevA;
+  nMuted = 0;
+  obj.initNull();
+  emptyStr = new MemStream((char *)"", 0, 0, &obj);
+}
+
+TeeOutputDev::~TeeOutputDev() {
+  delete emptyStr;
+}
+
+GBool TeeOutputDev::needType3DrawChar() {
+  return rasterDev->interpretType3Chars() &&
+         !textDev->interpretType3Chars() &&
+         textDev->useDrawChar();
+}
+
+void TeeOutputDev::setDefaultCTM(double *ctm) {
+  OutputDev::setDefaultCTM(ctm);
+  rasterDev->setDefaultCTM(ctm);
+  textDev->setDefaultCTM(ctm);
+}
+
+GBool TeeOutputDev::checkPageSlice(Page *page, double hDPI, double vDPI,
+				   int rotate, GBool useMediaBox, GBool crop,
+				   int sliceX, int sliceY,
+				   int sliceW, int sliceH,
+				   GBool printing,
+				   GBool (*abortCheckCbk)(void *data),
+				   void *abortCheckCbkData) {
+  return rasterDev->checkPageSlice(page, hDPI, vDPI, rotate, useMediaBox,
+				   crop, sliceX, sliceY, sliceW, sliceH,
+				   printing, abortCheckCbk,
+				   abortCheckCbkData) &&
+         textDev->checkPageSlice(page, hDPI, vDPI, rotate, useMediaBox,
+				 crop, sliceX, sliceY, sliceW, sliceH,
+				 printing, abortCheckCbk, abortCheckCbkData);
+}
+
+void TeeOutputDev::startPage(int pageNum, GfxState *state) {
+  nMuted = 0;
+  rasterDev->startPage(pageNum, state);
+  textDev->startPage(pageNum, state);
+}
+
+void TeeOutputDev::endPage() {
+  rasterDev->endPage();
+  textDev->endPage();
+}
+
+void TeeOutputDev::dump() {
+  rasterDev->dump();
+  textDev->dump();
+}
+
+void TeeOutputDev::saveState(GfxState *state) {
+  rasterDev->saveState(state);
+  if (textOn()) {
+    textDev->saveState(state);
+  }
+}
+
+void TeeOutputDev::restoreState(GfxState *state) {
+  rasterDev->restoreState(state);
+  if (textOn()) {
+    textDev->restoreState(state);
+  }
+}
+
+void TeeOutputDev::updateAll(GfxState *state) {
+  rasterDev->updateAll(state);
+  if (textOn()) {
+    textDev->updateAll(state);
+  }
+}
+
+void TeeOutputDev::updateCTM(GfxState *state, double m11, double m12,
+			     double m21, double m22,
+			     double m31, double m32) {
+  rasterDev->updateCTM(state, m11, m12, m21, m22, m31, m32);
+  if (textOn()) {
+    textDev->updateCTM(state, m11, m12, m21, m22, m31, m32);
+  }
+}
+
+void TeeOutputDev::updateLineDash(GfxState *state) {
+  rasterDev->updateLineDash(state);
+  if (textOn()) {
+    textDev->updateLineDash(state);
+  }
+}
+
+void TeeOutputDev::updateFlatness(GfxState *state) {
+  rasterDev->updateFlatness(state);
+  if (textOn()) {
+    textDev->updateFlatness(state);
+  }
+}
+
+void TeeOutputDev::updateLineJoin(GfxState *state) {
+  rasterDev->updateLineJoin(state);
+  if (textOn()) {
+    textDev->updateLineJoin(state);
+  }
+}
+
+void TeeOutputDev::updateLineCap(GfxState *state) {
+  rasterDev->updateLineCap(state);
+  if (textOn()) {
+    textDev->updateLineCap(state);
+  }
+}
+
+void TeeOutputDev::updateMiterLimit(GfxState *state) {
+  rasterDev->updateMiterLimit(state);
+  if (textOn()) {
+    textDev->updateMiterLimit(state);
+  }
+}
+
+void TeeOutputDev::updateLineWidth(GfxState *state) {
+  rasterDev->updateLineWidth(state);
+  if (textOn()) {
+    textDev->updateLineWidth(state);
+  }
+}
+
+void TeeOutputDev::updateStrokeAdjust(GfxState *state) {
+  rasterDev->updateStrokeAdjust(state);
+  if (textOn()) {
+    textDev->updateStrokeAdjust(state);
+  }
+}
+
+void TeeOutputDev::updateFillColorSpace(GfxState *state) {
+  rasterDev->updateFillColorSpace(state);
+  if (textOn()) {
+    textDev->updateFillColorSpace(state);
+  }
+}
+
+void TeeOutputDev::updateStrokeColorSpace(GfxState *state) {
+  rasterDev->updateStrokeColorSpace(state);
+  if (textOn()) {
+    textDev->updateStrokeColorSpace(state);
+  }
+}
+
+void TeeOutputDev::updateFillColor(GfxState *state) {
+  rasterDev->updateFillColor(state);
+  if (textOn()) {
+    textDev->updateFillColor(state);
+  }
+}
+
+void TeeOutputDev::updateStrokeColor(GfxState *state) {
+  rasterDev->updateStrokeColor(state);
+  if (textOn()) {
+    textDev->updateStrokeColor(state);
+  }
+}
+
+void TeeOutputDev::updateBlendMode(GfxState *state) {
+  rasterDev->updateBlendMode(state);
+  if (textOn()) {
+    textDev->updateBlendMode(state);
+  }
+}
+
+void TeeOutputDev::updateFillOpacity(GfxState *state) {
+  rasterDev->updateFillOpacity(state);
+  if (textOn()) {
+    textDev->updateFillOpacity(state);
+  }
+}
+
+void TeeOutputDev::updateStrokeOpacity(GfxState *state) {
+  rasterDev->updateStrokeOpacity(state);
+  if (textOn()) {
+    textDev->updateStrokeOpacity(state);
+  }
+}
+
+void TeeOutputDev::updateFillOverprint(GfxState *state) {
+  rasterDev->updateFillOverprint(state);
+  if (textOn()) {
+    textDev->updateFillOverprint(state);
+  }
+}
+
+void TeeOutputDev::updateStrokeOverprint(GfxState *state) {
+  rasterDev->updateStrokeOverprint(state);
+  if (textOn()) {
+    textDev->updateStrokeOverprint(state);
+  }
+}
+
+void TeeOutputDev::updateOverprintMode(GfxState *state) {
+  rasterDev->updateOverprintMode(state);
+  if (textOn()) {
+    textDev->updateOverprintMode(state);
+  }
+}
+
+void TeeOutputDev::updateTransfer(GfxState *state) {
+  rasterDev->updateTransfer(state);
+  if (textOn()) {
+    textDev->updateTransfer(state);
+  }
+}
+
+void TeeOutputDev::updateFont(GfxState *state) {
+  rasterDev->updateFont(state);
+  if (textOn()) {
+    textDev->updateFont(state);
+  }
+}
+
+void TeeOutputDev::updateTextMat(GfxState *state) {
+  rasterDev->updateTextMat(state);
+  if (textOn()) {
+    textDev->updateTextMat(state);
+  }
+}
+
+void TeeOutputDev::updateCharSpace(GfxState *state) {
+  rasterDev->updateCharSpace(state);
+  if (textOn()) {
+    textDev->updateCharSpace(state);
+  }
+}
+
+void TeeOutputDev::updateRender(GfxState *state) {
+  rasterDev->updateRender(state);
+  if (textOn()) {
+    textDev->updateRender(state);
+  }
+}
+
+void TeeOutputDev::updateRise(GfxState *state) {
+  rasterDev->updateRise(state);
+  if (textOn()) {
+    textDev->updateRise(state);
+  }
+}
+
+void TeeOutputDev::updateWordSpace(GfxState *state) {
+  rasterDev->updateWordSpace(state);
+  if (textOn()) {
+    textDev->updateWordSpace(state);
+  }
+}
+
+void TeeOutputDev::updateHorizScaling(GfxState *state) {
+  rasterDev->updateHorizScaling(state);
+  if (textOn()) {
+    textDev->updateHorizScaling(state);
+  }
+}
+
+void TeeOutputDev::updateTextPos(GfxState *state) {
+  rasterDev->updateTextPos(state);
+  if (textOn()) {
+    textDev->updateTextPos(state);
+  }
+}
+
+void TeeOutputDev::updateTextShift(GfxState *state, double shift) {
+  rasterDev->updateTextShift(state, shift);
+  if (textOn()) {
+    textDev->updateTextShift(state, shift);
+  }
+}
+
+void TeeOutputDev::saveTextPos(GfxState *state) {
+  rasterDev->saveTextPos(state);
+  if (textOn()) {
+    textDev->saveTextPos(state);
+  }
+}
+
+void TeeOutputDev::restoreTextPos(GfxState *state) {
+  rasterDev->restoreTextPos(state);
+  if (textOn()) {
+    textDev->restoreTextPos(state);
+  }
+}
+
+void TeeOutputDev::stroke(GfxState *state) {
+  rasterDev->stroke(state);
+  if (textOn()) {
+    textDev->stroke(state);
+  }
+}
+
+void TeeOutputDev::fill(GfxState *state) {
+  rasterDev->fill(state);
+  if (textOn()) {
+    textDev->fill(state);
+  }
+}
+
+void TeeOutputDev::eoFill(GfxState *state) {
+  rasterDev->eoFill(state);
+  if (textOn()) {
+    textDev->eoFill(state);
+  }
+}
+
+// Pattern and shading fills are only reached between beginNonText()
+// and endNonText(), so they go to the raster device only.
+void TeeOutputDev::tilingPatternFill(GfxState *state, Gfx *gfx,
+				     Object *strRef,
+				     int paintType, Dict *resDict,
+				     double *mat, double *bbox,
+				     int x0, int y0, int x1, int y1,
+				     double xStep, double yStep) {
+  rasterDev->tilingPatternFill(state, gfx, strRef, paintType, resDict,
+			       mat, bbox, x0, y0, x1, y1, xStep, yStep);
+}
+
+GBool TeeOutputDev::functionShadedFill(GfxState *state,
+				       GfxFunctionShading *shading) {
+  return rasterDev->functionShadedFill(state, shading);
+}
+
+GBool TeeOutputDev::axialShadedFill(GfxState *state,
+				    GfxAxialShading *shading) {
+  return rasterDev->axialShadedFill(state, shading);
+}
+
+GBool TeeOutputDev::radialShadedFill(GfxState *state,
+				     GfxRadialShading *shading) {
+  return rasterDev->radialShadedFill(state, shading);
+}
+
+void TeeOutputDev::clip(GfxState *state) {
+  rasterDev->clip(state);
+  if (textOn()) {
+    textDev->clip(state);
+  }
+}
+
+void TeeOutputDev::eoClip(GfxState *state) {
+  rasterDev->eoClip(state);
+  if (textOn()) {
+    textDev->eoClip(state);
+  }
+}
+
+void TeeOutputDev::clipToStrokePath(GfxState *state) {
+  rasterDev->clipToStrokePath(state);
+  if (textOn()) {
+    textDev->clipToStrokePath(state);
+  }
+}
+
+void TeeOutputDev::beginStringOp(GfxState *state) {
+  rasterDev->beginStringOp(state);
+  if (textOn()) {
+    textDev->beginStringOp(state);
+  }
+}
+
+void TeeOutputDev::endStringOp(GfxState *state) {
+  rasterDev->endStringOp(state);
+  if (textOn()) {
+    textDev->endStringOp(state);
+  }
+}
+
+void TeeOutputDev::beginString(GfxState *state, GString *s) {
+  rasterDev->beginString(state, s);
+  if (textOn()) {
+    textDev->beginString(state, s);
+  }
+}
+
+void TeeOutputDev::endString(GfxState *state) {
+  rasterDev->endString(state);
+  if (textOn()) {
+    textDev->endString(state);
+  }
+}
+
+// If the raster device interprets Type 3 chars, Gfx calls drawChar()
+// (via needType3DrawChar) right before beginType3Char() -- that call
+// is meant only for the text device.
+void TeeOutputDev::drawChar(GfxState *state, double x, double y,
+			    double dx, double dy,
+			    double originX, double originY,
+			    CharCode code, int nBytes, Unicode *u, int uLen) {
+  if (!(state->getFont() && state->getFont()->getType() == fontType3 &&
+	rasterDev->interpretType3Chars())) {
+    rasterDev->drawChar(state, x, y, dx, dy, originX, originY,
+			code, nBytes, u, uLen);
+  }
+  if (textOn()) {
+    textDev->drawChar(state, x, y, dx, dy, originX, originY,
+		      code, nBytes, u, uLen);
+  }
+}
+
+void TeeOutputDev::drawString(GfxState *state, GString *s) {
+  rasterDev->drawString(state, s);
+  if (textOn()) {
+    textDev->drawString(state, s);
+  }
+}
+
+// The char proc is interpreted for the raster device only.
+GBool TeeOutputDev::beginType3Char(GfxState *state, double x, double y,
+				   double dx, double dy,
+				   CharCode code, Unicode *u, int uLen) {
+  if (rasterDev->beginType3Char(state, x, y, dx, dy, code, u, uLen)) {
+    return gTrue;
+  }
+  ++nMuted;
+  return gFalse;
+}
+
+void TeeOutputDev::endType3Char(GfxState *state) {
+  rasterDev->endType3Char(state);
+  --nMuted;
+}
+
+void TeeOutputDev::endTextObject(GfxState *state) {
+  rasterDev->endTextObject(state);
+  if (textOn()) {
+    textDev->endTextObject(state);
+  }
+}
+
+void TeeOutputDev::incCharCount(int nChars) {
+  rasterDev->incCharCount(nChars);
+  if (textOn()) {
+    textDev->incCharCount(nChars);
+  }
+}
+
+void TeeOutputDev::beginActualText(GfxState *state, Unicode *u, int uLen) {
+  rasterDev->beginActualText(state, u, uLen);
+  if (textOn()) {
+    textDev->beginActualText(state, u, uLen);
+  }
+}
+
+void TeeOutputDev::endActualText(GfxState *state) {
+  rasterDev->endActualText(state);
+  if (textOn()) {
+    textDev->endActualText(state);
+  }
+}
+
+// Image XObjects are only passed to the text device if Gfx would
+// have passed them to it.  The raster device reads the image data
+// first; inline image data can't be read twice, so the text device
+// gets an empty stream instead.
+Stream *TeeOutputDev::getTextImageStream(Stream *str, GBool inlineImg) {
+  if (!textOn()) {
+    return NULL;
+  }
+  if (inlineImg) {
+    return emptyStr;
+  }
+  if (!textDev->needNonText() && !textDev->needImagesEvenIfText()) {
+    return NULL;
+  }
+  return str;
+}
+
+void TeeOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
+				 int width, int height, GBool invert,
+				 GBool inlineImg, GBool interpolate) {
+  Stream *textStr;
+
+  textStr = getTextImageStream(str, inlineImg);
+  rasterDev->drawImageMask(state, ref, str, width, height, invert,
+			   inlineImg, interpolate);
+  if (textStr) {
+    textDev->drawImageMask(state, ref, textStr, width, height, invert,
+			   inlineImg, interpolate);
+  }
+}
+
+void TeeOutputDev::setSoftMaskFromImageMask(GfxState *state,
+					    Object *ref, Stream *str,
+					    int width, int height,
+					    GBool invert,
+					    GBool inlineImg,
+					    GBool interpolate) {
+  Stream *textStr;
+
+  textStr = getTextImageStream(str, inlineImg);
+  rasterDev->setSoftMaskFromImageMask(state, ref, str, width, height,
+				      invert, inlineImg, interpolate);
+  if (textStr) {
+    textDev->setSoftMaskFromImageMask(state, ref, textStr, width, height,
+				      invert, inlineImg, interpolate);
+  }
+}
+
+void TeeOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
+			     int width, int height,
+			     GfxImageColorMap *colorMap,
+			     int *maskColors, GBool inlineImg,
+			     GBool interpolate) {
+  Stream *textStr;
+
+  textStr = getTextImageStream(str, inlineImg);
+  rasterDev->drawImage(state, ref, str, width, height, colorMap,
+		       maskColors, inlineImg, interpolate);
+  if (textStr) {
+    textDev->drawImage(state, ref, textStr, width, height, colorMap,
+		       maskColors, inlineImg, interpolate);
+  }
+}
+
+void TeeOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+				   Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GBool maskInvert, GBool interpolate) {
+  Stream *textStr;
+
+  textStr = getTextImageStream(str, gFalse);
+  rasterDev->drawMaskedImage(state, ref, str, width, height, colorMap,
+			     maskStr, maskWidth, maskHeight, maskInvert,
+			     interpolate);
+  if (textStr) {
+    textDev->drawMaskedImage(state, ref, textStr, width, height, colorMap,
+			     maskStr, maskWidth, maskHeight, maskInvert,
+			     interpolate);
+  }
+}
+
+void TeeOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+				       Stream *str,
+				       int width, int height,
+				       GfxImageColorMap *colorMap,
+				       Stream *maskStr,
+				       int maskWidth, int maskHeight,
+				       GfxImageColorMap *maskColorMap,
+				       GBool interpolate) {
+  Stream *textStr;
+
+  textStr = getTextImageStream(str, gFalse);
+  rasterDev->drawSoftMaskedImage(state, ref, str, width, height, colorMap,
+				 maskStr, maskWidth, maskHeight,
+				 maskColorMap, interpolate);
+  if (textStr) {
+    textDev->drawSoftMaskedImage(state, ref, textStr, width, height,
+				 colorMap, maskStr, maskWidth, maskHeight,
+				 maskColorMap, interpolate);
+  }
+}
+
+#if OPI_SUPPORT
+void TeeOutputDev::opiBegin(GfxState *state, Dict *opiDict) {
+  rasterDev->opiBegin(state, opiDict);
+  if (textOn()) {
+    textDev->opiBegin(state, opiDict);
+  }
+}
+
+void TeeOutputDev::opiEnd(GfxState *state, Dict *opiDict) {
+  rasterDev->opiEnd(state, opiDict);
+  if (textOn()) {
+    textDev->opiEnd(state, opiDict);
+  }
+}
+#endif
+
+void TeeOutputDev::type3D0(GfxState *state, double wx, double wy) {
+  rasterDev->type3D0(state, wx, wy);
+}
+
+void TeeOutputDev::type3D1(GfxState *state, double wx, double wy,
+			   double llx, double lly, double urx, double ury) {
+  rasterDev->type3D1(state, wx, wy, llx, lly, urx, ury);
+}
+
+void TeeOutputDev::psXObject(Stream *psStream, Stream *level1Stream) {
+  rasterDev->psXObject(psStream, level1Stream);
+  if (textOn()) {
+    textDev->psXObject(psStream, level1Stream);
+  }
+}
+
+void TeeOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
+					  GfxColorSpace *blendingColorSpace,
+					  GBool isolated, GBool knockout,
+					  GBool forSoftMask) {
+  rasterDev->beginTransparencyGroup(state, bbox, blendingColorSpace,
+				    isolated, knockout, forSoftMask);
+  if (textOn()) {
+    textDev->beginTransparencyGroup(state, bbox, blendingColorSpace,
+				    isolated, knockout, forSoftMask);
+  }
+}
+
+void TeeOutputDev::endTransparencyGroup(GfxState *state) {
+  rasterDev->endTransparencyGroup(state);
+  if (textOn()) {
+    textDev->endTransparencyGroup(state);
+  }
+}
+
+void TeeOutputDev::paintTransparencyGroup(GfxState *state, double *bbox) {
+  rasterDev->paintTransparencyGroup(state, bbox);
+  if (textOn()) {
+    textDev->paintTransparencyGroup(state, bbox);
+  }
+}
+
+void TeeOutputDev::setSoftMask(GfxState *state, double *bbox, GBool alpha,
+			       Function *transferFunc,
+			       GfxColor *backdropColor) {
+  rasterDev->setSoftMask(state, bbox, alpha, transferFunc, backdropColor);
+  if (textOn()) {
+    textDev->setSoftMask(state, bbox, alpha, transferFunc, backdropColor);
+  }
+}
+
+void TeeOutputDev::clearSoftMask(GfxState *state) {
+  rasterDev->clearSoftMask(state);
+  if (textOn()) {
+    textDev->clearSoftMask(state);
+  }
+}
+
+// Gfx skips pattern fills and shading operators entirely for devices
+// that don't need non-text content.
+void TeeOutputDev::beginNonText() {
+  rasterDev->beginNonText();
+  if (textOn() && textDev->needNonText()) {
+    textDev->beginNonText();
+  } else {
+    ++nMuted;
+  }
+}
+
+void TeeOutputDev::endNonText() {
+  rasterDev->endNonText();
+  if (nMuted > 0) {
+    --nMuted;
+  } else {
+    textDev->endNonText();
+  }
+}
+
+void TeeOutputDev::processLink(Link *link) {
+  rasterDev->processLink(link);
+  textDev->processLink(link);
+}
+
+#if 1 //~tmp: turn off anti-aliasing temporarily
+void TeeOutputDev::setInShading(GBool sh) {
+  rasterDev->setInShading(sh);
+  if (textOn()) {
+    textDev->setInShading(sh);
+  }
+}
+#endif
@@ -0,0 +1,230 @@
+//========================================================================
+//
+// TeeOutputDev.h
+//
+//========================================================================
+
+#ifndef TEEOUTPUTDEV_H
+#define TEEOUTPUTDEV_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#include "OutputDev.h"
+
+//------------------------------------------------------------------------
+// TeeOutputDev
+//------------------------------------------------------------------------
+
+// Drives two output devices from a single content stream pass: a
+// raster device (e.g., SplashOutputDev), which determines how the
+// content is interpreted, and a text device (e.g., TextOutputDev),
+// which sees exactly the calls that Gfx would make if it were
+// running the text device by itself.  Both devices see the same
+// GfxState, so text coordinates match the raster.  The two devices
+// must agree on upsideDown().
+//
+// The text device never sees pattern fills, shading operators, or
+// the contents of Type 3 char procs.  Type 3 chars are passed to it
+// with drawChar() (see OutputDev::needType3DrawChar).  Inline images
+// are consumed by the raster device -- the text device is passed an
+// empty stream.
+class TeeOutputDev: public OutputDev {
+public:
+
+  // Constructor.  The devices are not owned by the TeeOutputDev.
+  TeeOutputDev(OutputDev *rasterDevA, OutputDev *textDevA);
+
+  // Destructor.
+  virtual ~TeeOutputDev();
+
+  OutputDev *getRasterDev() { return rasterDev; }
+  OutputDev *getTextDev() { return textDev; }
+
+  //----- get info about output device
+
+  virtual GBool upsideDown() { return rasterDev->upsideDown(); }
+  virtual GBool useDrawChar() { return rasterDev->useDrawChar(); }
+  virtual GBool useTilingPatternFill()
+    { return rasterDev->useTilingPatternFill(); }
+  virtual GBool useShadedFills() { return rasterDev->useShadedFills(); }
+  virtual GBool useDrawForm() { return gFalse; }
+  virtual GBool interpretType3Chars()
+    { return rasterDev->interpretType3Chars(); }
+  virtual GBool needType3DrawChar();
+  virtual GBool needNonText() { return gTrue; }
+  virtual GBool needImagesEvenIfText() { return gTrue; }
+  virtual GBool needCharCount()
+    { return rasterDev->needCharCount() || textDev->needCharCount(); }
+
+  //----- initialization and control
+
+  virtual void setDefaultCTM(double *ctm);
+  virtual GBool checkPageSlice(Page *page, double hDPI, double vDPI,
+			       int rotate, GBool useMediaBox, GBool crop,
+			       int sliceX, int sliceY, int sliceW, int sliceH,
+			       GBool printing,
+			       GBool (*abortCheckCbk)(void *data) = NULL,
+			       void *abortCheckCbkData = NULL);
+  virtual void startPage(int pageNum, GfxState *state);
+  virtual void endPage();
+  virtual void dump();
+
+  //----- save/restore graphics state
+  virtual void saveState(GfxState *state);
+  virtual void restoreState(GfxState *state);
+
+  //----- update graphics state
+  virtual void updateAll(GfxState *state);
+  virtual void updateCTM(GfxState *state, double m11, double m12,
+			 double m21, double m22, double m31, double m32);
+  virtual void updateLineDash(GfxState *state);
+  virtual void updateFlatness(GfxState *state);
+  virtual void updateLineJoin(GfxState *state);
+  virtual void updateLineCap(GfxState *state);
+  virtual void updateMiterLimit(GfxState *state);
+  virtual void updateLineWidth(GfxState *state);
+  virtual void updateStrokeAdjust(GfxState *state);
+  virtual void updateFillColorSpace(GfxState *state);
+  virtual void updateStrokeColorSpace(GfxState *state);
+  virtual void updateFillColor(GfxState *state);
+  virtual void updateStrokeColor(GfxState *state);
+  virtual void updateBlendMode(GfxState *state);
+  virtual void updateFillOpacity(GfxState *state);
+  virtual void updateStrokeOpacity(GfxState *state);
+  virtual void updateFillOverprint(GfxState *state);
+  virtual void updateStrokeOverprint(GfxState *state);
+  virtual void updateOverprintMode(GfxState *state);
+  virtual void updateTransfer(GfxState *state);
+
+  //----- update text state
+  virtual void updateFont(GfxState *state);
+  virtual void updateTextMat(GfxState *state);
+  virtual void updateCharSpace(GfxState *state);
+  virtual void updateRender(GfxState *state);
+  virtual void updateRise(GfxState *state);
+  virtual void updateWordSpace(GfxState *state);
+  virtual void updateHorizScaling(GfxState *state);
+  virtual void updateTextPos(GfxState *state);
+  virtual void updateTextShift(GfxState *state, double shift);
+  virtual void saveTextPos(GfxState *state);
+  virtual void restoreTextPos(GfxState *state);
+
+  //----- path painting
+  virtual void stroke(GfxState *state);
+  virtual void fill(GfxState *state);
+  virtual void eoFill(GfxState *state);
+  virtual void tilingPatternFill(GfxState *state, Gfx *gfx, Object *strRef,
+				 int paintType, Dict *resDict,
+				 double *mat, double *bbox,
+				 int x0, int y0, int x1, int y1,
+				 double xStep, double yStep);
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading);
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading);
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading);
+
+  //----- path clipping
+  virtual void clip(GfxState *state);
+  virtual void eoClip(GfxState *state);
+  virtual void clipToStrokePath(GfxState *state);
+
+  //----- text drawing
+  virtual void beginStringOp(GfxState *state);
+  virtual void endStringOp(GfxState *state);
+  virtual void beginString(GfxState *state, GString *s);
+  virtual void endString(GfxState *state);
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+  virtual void drawString(GfxState *state, GString *s);
+  virtual GBool beginType3Char(GfxState *state, double x, double y,
+			       double dx, double dy,
+			       CharCode code, Unicode *u, int uLen);
+  virtual void endType3Char(GfxState *state);
+  virtual void endTextObject(GfxState *state);
+  virtual void incCharCount(int nChars);
+  virtual void beginActualText(GfxState *state, Unicode *u, int uLen);
+  virtual void endActualText(GfxState *state);
+
+  //----- image drawing
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool inlineImg, GBool interpolate);
+  virtual void setSoftMaskFromImageMask(GfxState *state,
+					Object *ref, Stream *str,
+					int width, int height, GBool invert,
+					GBool inlineImg, GBool interpolate);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 int *maskColors, GBool inlineImg, GBool interpolate);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert, GBool interpolate);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap,
+				   GBool interpolate);
+
+#if OPI_SUPPORT
+  //----- OPI functions
+  virtual void opiBegin(GfxState *state, Dict *opiDict);
+  virtual void opiEnd(GfxState *state, Dict *opiDict);
+#endif
+
+  //----- Type 3 font operators
+  virtual void type3D0(GfxState *state, double wx, double wy);
+  virtual void type3D1(GfxState *state, double wx, double wy,
+		       double llx, double lly, double urx, double ury);
+
+  //----- PostScript XObjects
+  virtual void psXObject(Stream *psStream, Stream *level1Stream);
+
+  //----- transparency groups and soft masks
+  virtual void beginTransparencyGroup(GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask);
+  virtual void endTransparencyGroup(GfxState *state);
+  virtual void paintTransparencyGroup(GfxState *state, double *bbox);
+  virtual void setSoftMask(GfxState *state, double *bbox, GBool alpha,
+			   Function *transferFunc, GfxColor *backdropColor);
+  virtual void clearSoftMask(GfxState *state);
+
+  //----- non-text content
+  virtual void beginNonText();
+  virtual void endNonText();
+
+  //----- links
+  virtual void processLink(Link *link);
+
+#if 1 //~tmp: turn off anti-aliasing temporarily
+  virtual void setInShading(GBool sh);
+#endif
+
+private:
+
+  // Returns true if calls should be forwarded to the text device.
+  GBool textOn() { return nMuted == 0; }
+
+  Stream *getTextImageStream(Stream *str, GBool inlineImg);
+
+  OutputDev *rasterDev;		// raster device (not owned)
+  OutputDev *textDev;		// text device (not owned)
+  int nMuted;			// nesting level of content hidden from
+				//   the text device
+  Stream *emptyStr;		// passed to the text device in place
+				//   of inline image data
+};
+
+#endif
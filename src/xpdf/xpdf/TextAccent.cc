@@ -1,8 +1,6 @@
 #include "TextAccent.h"
 
 #include <assert.h>
-#include <map>
-#include <sstream>
 #include <stdio.h>
 #include <math.h>
 #include <algorithm>
@@ -45,37 +43,41 @@ namespace accented {
         // difference in baseline for on the same line consideration
         static const double BASELINE_DIFFERENCE = 0.3;
 
+        // untranslatable characters are mapped to private use unicodes
+        // after this one
+        const Unicode FIRST_INVALID_UNICODE = 0xE000;
 
-    } // namespace
+        // initial size (power of 2) of the untranslatable character map
+        const size_t INVALID_MAP_INITIAL_SIZE = 64;
 
+        size_t invalid_hash( int font_num, int font_gen, Unicode code ) {
+            return ((size_t)font_num * 31 + (size_t)font_gen) * 0x9E3779B1u + code;
+        }
 
-    //
-    // static
-    //
 
-    bool word::last_was_translated_ = false;
-    bool word::last_invalid_unicode_ = false;
-    word::measure_type word::last_char_measures_;
+    } // namespace
 
 
     //
     // public
     //
 
-    word::word( TextWord* xpdf_word,
+    word::word( context& ctx,
+                TextWord* xpdf_word,
                 const Unicode u[],
                 double x,
                 double y,
                 double w,
                 double h,
                 double current_font_size
-               ) : xpdf_word_( xpdf_word ), 
+               ) : ctx_( ctx ),
+                   xpdf_word_( xpdf_word ), 
                    new_char_measures_( x,y,w,h,current_font_size )
     {
         // store several info from the last char
-        new_char_measures_.last_invalid_unicode = word::last_invalid_unicode_;
-        new_char_measures_.last_was_translated = word::last_was_translated_;
-        reset_static();
+        new_char_measures_.last_invalid_unicode = ctx_.last_invalid_unicode_;
+        new_char_measures_.last_was_translated = ctx_.last_was_translated_;
+        reset_context();
 
         // if there is a word initialize it properly
         if ( nullptr != xpdf_word_ )
@@ -88,14 +90,26 @@ namespace accented {
     word::~word() 
     {
         // store measures from last char
-        word::last_char_measures_ = new_char_measures_;
+        ctx_.last_char_measures_ = new_char_measures_;
     }
 
     void
-    word::reset_static() 
+    word::reset_context() 
     {
-        word::last_invalid_unicode_ = false;
-        word::last_was_translated_ = false;
+        ctx_.last_invalid_unicode_ = false;
+        ctx_.last_was_translated_ = false;
+    }
+
+    void
+    word::last_was_translated( bool value )
+    {
+        ctx_.last_was_translated_ = value;
+    }
+
+    void
+    word::last_was_invalid_unicode( bool value )
+    {
+        ctx_.last_invalid_unicode_ = value;
     }
 
 
@@ -265,42 +279,18 @@ namespace accented {
     //
 
     Unicode
-    word::translate_invalid_unicode( const Unicode* u, GfxState* state ) 
+    word::translate_invalid_unicode( const Unicode* u, int font_num, int font_gen ) 
     {
             assert( nullptr != u );
 
-        // special private Unicode char so we do not end up with something valid
-        static int _num = 0xE000;
-
-        typedef std::map<Unicode, Unicode> charcode_to_num_type;
-        typedef std::map<std::string, charcode_to_num_type> font_to_num_type;
-        
-        word::last_was_invalid_unicode( true );
-
+        last_was_invalid_unicode( true );
 
-        Ref ref = {0};
-        if ( nullptr != state ) 
-            state->getFont()->getEmbeddedFontID( &ref );
-
-        std::ostringstream oss;
-        oss << ref.num << " " << ref.gen;
-        std::string font_name = oss.str();
-        static font_to_num_type font_mapping;
-        Unicode mapped_char = 0;
-        charcode_to_num_type::iterator not_found = font_mapping[font_name].end();
-        charcode_to_num_type::iterator found = font_mapping[font_name].find(u[2]);
-        // we found mapping
-        //
-        if ( not_found != found ) {
-            mapped_char = found->second;
-        // insert mapping
+        // special private Unicode char so we do not end up with something valid
+        bool inserted = false;
+        Unicode mapped_char = ctx_.map_invalid_unicode( font_num, font_gen, u[2], inserted );
+        // new mapping
         //
-        }else {
-            ++_num;
-            charcode_to_num_type& char_map = font_mapping[font_name];
-            char_map[u[2]] = _num;
-            mapped_char = _num;
-
+        if ( inserted ) {
             // debug
             if (xpdf_word_) 
             {
@@ -533,59 +523,59 @@ namespace accented {
         switch (xpdf_word_->rot) {
             case 0:
                    //assert ( new_char_measures_.x >= 0 ); //#130010360
-                   assert ( word::last_char_measures_.x >= 0 );
-                   //assert ( word::last_char_measures_.w >= 0 );
+                   assert ( ctx_.last_char_measures_.x >= 0 );
+                   //assert ( ctx_.last_char_measures_.w >= 0 );
               // start from 0 - why not? ;)
               first.x_start = 0;
-              first.x_end = first.x_start + word::last_char_measures_.w;
+              first.x_end = first.x_start + ctx_.last_char_measures_.w;
               first.w = first.x_end;
               // 
               second.w = new_char_measures_.w;
-              second.x_start = new_char_measures_.x - word::last_char_measures_.x;
+              second.x_start = new_char_measures_.x - ctx_.last_char_measures_.x;
               second.x_end = second.x_start + second.w;
               break;
             case 1:
                    assert ( new_char_measures_.y >= 0 );
-                   assert ( word::last_char_measures_.y >= 0 );
+                   assert ( ctx_.last_char_measures_.y >= 0 );
                    // can happen? 120064168.orig
                    //assert ( new_char_measures_.h >= 0 );
-                   //assert ( word::last_char_measures_.h >= 0 );
+                   //assert ( ctx_.last_char_measures_.h >= 0 );
               // start from 0 - why not? ;)
               first.x_start = 0;
-              first.x_end = word::last_char_measures_.h;
+              first.x_end = ctx_.last_char_measures_.h;
               first.w = first.x_end;
               //
               second.w = new_char_measures_.h;
-              second.x_start = new_char_measures_.y - word::last_char_measures_.y;
+              second.x_start = new_char_measures_.y - ctx_.last_char_measures_.y;
               second.x_end = second.x_start + second.w;
               break;
             case 2:
                     assert ( new_char_measures_.x >= 0 );
-                    assert ( word::last_char_measures_.x >= 0 );
+                    assert ( ctx_.last_char_measures_.x >= 0 );
                     // can happen? 120047653.orig
-                    //assert ( word::last_char_measures_.w <= 0 );
+                    //assert ( ctx_.last_char_measures_.w <= 0 );
                 first.x_start = 0;
-                first.x_end = fabs(word::last_char_measures_.w);
+                first.x_end = fabs(ctx_.last_char_measures_.w);
                 first.w = first.x_end;
                 // 
                 second.w = fabs(new_char_measures_.w);
-                second.x_start = (word::last_char_measures_.x + first.x_end)
+                second.x_start = (ctx_.last_char_measures_.x + first.x_end)
                                    - (new_char_measures_.x + second.w );
                 second.x_end = second.w;
                 break;
             case 3:
                    assert ( new_char_measures_.y >= 0 );
-                   assert ( word::last_char_measures_.y >= 0 );
+                   assert ( ctx_.last_char_measures_.y >= 0 );
                    // can happen? 120064168.orig
                    //assert ( new_char_measures_.h <= 0 );
-                   //assert ( word::last_char_measures_.h <= 0 );
+                   //assert ( ctx_.last_char_measures_.h <= 0 );
               //
               first.x_start = 0;
-              first.x_end = fabs(word::last_char_measures_.h);
+              first.x_end = fabs(ctx_.last_char_measures_.h);
               first.w = first.x_end;
               //
               second.w = fabs(new_char_measures_.h);
-              second.x_start = word::last_char_measures_.y - new_char_measures_.y;
+              second.x_start = ctx_.last_char_measures_.y - new_char_measures_.y;
               second.x_end = second.x_start + second.w;
               break;
         }
@@ -631,6 +621,70 @@ namespace accented {
         space_indicating_end_word = false;
     }
 
-   
+
+    //
+    // context
+    //
+
+    context::context()
+        : last_char_measures_( 0.0, 0.0, 0.0, 0.0, 0.0 ),
+          last_was_translated_( false ),
+          last_invalid_unicode_( false ),
+          invalid_count_( 0 ),
+          invalid_lookups_( 0 ),
+          last_invalid_mapped_( FIRST_INVALID_UNICODE )
+    {
+        last_char_measures_.on_the_same_line = false;
+    }
+
+    Unicode
+    context::map_invalid_unicode( int font_num, int font_gen,
+                                  Unicode code, bool& inserted )
+    {
+        ++invalid_lookups_;
+        // keep the load below 1/2
+        if ( 2 * (invalid_count_ + 1) > invalid_.size() )
+            grow_invalid();
+
+        size_t mask = invalid_.size() - 1;
+        for ( size_t i = invalid_hash( font_num, font_gen, code ) & mask; ; i = (i + 1) & mask )
+        {
+            invalid_entry& e = invalid_[i];
+            if ( 0 == e.mapped )
+            {
+                e.font_num = font_num;
+                e.font_gen = font_gen;
+                e.code = code;
+                e.mapped = ++last_invalid_mapped_;
+                ++invalid_count_;
+                inserted = true;
+                return e.mapped;
+            }
+            if ( e.code == code && e.font_num == font_num && e.font_gen == font_gen )
+            {
+                inserted = false;
+                return e.mapped;
+            }
+        }
+    }
+
+    void
+    context::grow_invalid()
+    {
+        std::vector<invalid_entry> old;
+        old.swap( invalid_ );
+        invalid_entry empty = {};
+        invalid_.resize( old.empty() ? INVALID_MAP_INITIAL_SIZE : 2 * old.size(), empty );
+        size_t mask = invalid_.size() - 1;
+        for ( size_t j = 0; j < old.size(); ++j )
+        {
+            if ( 0 == old[j].mapped )
+                continue;
+            size_t i = invalid_hash( old[j].font_num, old[j].font_gen, old[j].code ) & mask;
+            while ( 0 != invalid_[i].mapped )
+                i = (i + 1) & mask;
+            invalid_[i] = old[j];
+        }
+    }
 
 } // namespace
@@ -3,16 +3,18 @@
 
 #include "CharTypes.h"
 #include <cstddef>
+#include <vector>
 
 // forward declarationa
 class TextWord;
-class GfxState;
 
 
 namespace accented {
 
 //#define nullptr NULL
 
+class context;
+
 /*
  This class extends the handling of accentes characeters from 
  simple one to more complex one
@@ -22,7 +24,7 @@ class word {
         //
         // types
         //
-    private:
+    public:
 
         struct measure_type {
            // ctor
@@ -93,22 +95,18 @@ class word {
         // variables        
         //
     private:
+        context& ctx_;
         TextWord* xpdf_word_;
         measure_type new_char_measures_;
         accented_pair_info pair_info_;
 		needs_changes changes_todo_;
 
-        static measure_type last_char_measures_;
-
-        static bool last_was_translated_;
-        static bool last_invalid_unicode_;
-
 
         //
         // ctor        
         //
     public:
-        word( TextWord* xpdf_word, const Unicode u[],
+        word( context& ctx, TextWord* xpdf_word, const Unicode u[],
               double x, double y, double w, double h,
               double current_font_size );
 
@@ -150,7 +148,8 @@ class word {
         // a unicode from specific range
         // - different fonts can have the same character-codes point to different
         //   letters so we must change the character code to font dependent number
-        Unicode translate_invalid_unicode( const Unicode* u, GfxState* state );
+        // - font_num/font_gen identify the (embedded) font of the char
+        Unicode translate_invalid_unicode( const Unicode* u, int font_num, int font_gen );
 
         // default overlap of letters
         bool overlap() const;
@@ -181,17 +180,18 @@ class word {
         }   
 
 
-        // static setter of indicator whether in the last step we
+        //
+        // context
+        //
+    public:
+
+        // setter of indicator whether in the last step we
         // mixed the accent+letter into one accented char
-        static void last_was_translated( bool value ) {
-            last_was_translated_ = value;
-        }
+        void last_was_translated( bool value );
 
-        // static setter of indicator whether in the last step there
+        // setter of indicator whether in the last step there
         // was an untranslatable character
-        static void last_was_invalid_unicode( bool value ) {
-            last_invalid_unicode_ = value;
-        }
+        void last_was_invalid_unicode( bool value );
 
 
         //
@@ -199,8 +199,8 @@ class word {
         //
     private:
 
-        // reset static variables
-        void reset_static();
+        // reset context variables
+        void reset_context();
 
         // set is overlapping (check only for accented)
         void accent_overlapping( accented_pair_info& info );
@@ -223,6 +223,50 @@ class word {
 };
 
 
+/*
+ State which word passes from one character to the next, and the
+ mapping of untranslatable characters, which must stay the same for
+ the whole document.  One per TextPage (instead of statics), so that
+ pages can be extracted by several threads at once.
+*/
+class context {
+
+    public:
+        context();
+
+        // return the private use unicode which stands for char code
+        // <code> of font <font_num>/<font_gen>; the first time it is
+        // seen <inserted> is set to true
+        Unicode map_invalid_unicode( int font_num, int font_gen,
+                                     Unicode code, bool& inserted );
+
+        // number of untranslatable characters mapped so far - text
+        // extracted while it did not change does not depend on the mapping
+        size_t invalid_lookups() const { return invalid_lookups_; }
+
+    private:
+        // open addressing hash table entry
+        struct invalid_entry {
+            int font_num, font_gen;
+            Unicode code;
+            Unicode mapped;     // 0 if the entry is empty
+        };
+
+        void grow_invalid();
+
+        word::measure_type last_char_measures_;
+        bool last_was_translated_;
+        bool last_invalid_unicode_;
+
+        std::vector<invalid_entry> invalid_;
+        size_t invalid_count_;
+        size_t invalid_lookups_;
+        Unicode last_invalid_mapped_;
+
+        friend class word;
+};
+
+
 } // namespace
 
 #endif
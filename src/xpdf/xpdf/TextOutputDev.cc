@@ -13,10 +13,13 @@
 #endif
 
 #include <memory>
+#include <unordered_map>
+#include <vector>
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <limits.h>
 #include <math.h>
 #include <float.h>
 #include <ctype.h>
@@ -146,6 +149,29 @@
 // Max distance between edge of text and edge of link border
 #define hyperlinkSlack 2
 
+// Size of the first TextArena chunk, when there is no previous page to
+// go by, and the max size of a chunk (larger pages use more chunks).
+#define textArenaMinChunkSize 65536
+#define textArenaMaxChunkSize (16 << 20)
+
+// TextArena allocations are rounded up to a multiple of this.
+#define textArenaAlign 8
+
+// A form XObject's text is recorded when the form is drawn this many
+// times (forms drawn once are not worth it), and replayed after that.
+#define formCacheMinDraws 2
+
+// Max number of records of one form (drawn with different matrices or
+// text states).
+#define formCacheMaxVariants 4
+
+// Forms whose text could not be recorded this many times are not
+// recorded again.
+#define formCacheMaxFailures 2
+
+// Max memory used by the records of all forms.
+#define formCacheMaxBytes (16 << 20)
+
 namespace {
 
     int dumpFragment(Unicode *text, int len, UnicodeMap *uMap, GString *s, GBool primaryLR)
@@ -281,15 +307,335 @@ public:
   Link *link;
 };
 
+//------------------------------------------------------------------------
+// TextIntervalGrid
+//------------------------------------------------------------------------
+
+// A uniform grid over a set of intervals on one axis: each cell lists
+// the intervals which intersect it, so the intervals which intersect
+// a given interval can be found without looking at all of them.  The
+// cell size is at least the mean interval length, which keeps the
+// number of cells per interval small.
+class TextIntervalGrid {
+public:
+
+  // Build a grid for the intervals [lo[i], hi[i]], i = 0 .. n-1.
+  TextIntervalGrid(double *lo, double *hi, int n);
+  ~TextIntervalGrid();
+
+  // Get the range of cells which may contain intervals intersecting
+  // [lo, hi].
+  void getCells(double lo, double hi, int *cell0, int *cell1)
+    { *cell0 = getCellIdx(lo); *cell1 = getCellIdx(hi); }
+
+  // Get the indexes of the intervals in <cell>.
+  int *getCell(int cell, int *n)
+    { *n = cellStart[cell + 1] - cellStart[cell];
+      return cellItems + cellStart[cell]; }
+
+private:
+
+  int getCellIdx(double x);
+
+  double gridMin;		// start of cell 0
+  double cellScale;		// 1 / cell size
+  int nCells;
+  int *cellStart;		// start of each cell in cellItems
+				//   [nCells + 1]
+  int *cellItems;		// interval indexes, by cell
+};
+
+TextIntervalGrid::TextIntervalGrid(double *lo, double *hi, int n) {
+  double gridMax, sum, cellSize, d;
+  int *fill;
+  int i, cell, cell0, cell1;
+
+  gridMin = gridMax = 0;
+  sum = 0;
+  for (i = 0; i < n; ++i) {
+    if (i == 0 || lo[i] < gridMin) {
+      gridMin = lo[i];
+    }
+    if (i == 0 || hi[i] > gridMax) {
+      gridMax = hi[i];
+    }
+    sum += hi[i] - lo[i];
+  }
+  nCells = 1;
+  cellScale = 0;
+  if (n > 0) {
+    cellSize = sum / n;
+    if (cellSize < (gridMax - gridMin) / (4.0 * n)) {
+      cellSize = (gridMax - gridMin) / (4.0 * n);
+    }
+    // this also rejects empty, infinite, and NaN ranges
+    d = (gridMax - gridMin) / cellSize;
+    if (cellSize > 0 && d < 4.0 * n + 1) {
+      nCells = (int)d + 1;
+      cellScale = 1 / cellSize;
+    }
+  }
+
+  cellStart = (int *)gmallocn(nCells + 1, sizeof(int));
+  memset(cellStart, 0, (nCells + 1) * sizeof(int));
+  for (i = 0; i < n; ++i) {
+    cell0 = getCellIdx(lo[i]);
+    cell1 = getCellIdx(hi[i]);
+    for (cell = cell0; cell <= cell1; ++cell) {
+      ++cellStart[cell + 1];
+    }
+  }
+  for (cell = 0; cell < nCells; ++cell) {
+    cellStart[cell + 1] += cellStart[cell];
+  }
+  cellItems = (int *)gmallocn(cellStart[nCells] > 0 ? cellStart[nCells] : 1,
+			      sizeof(int));
+  fill = (int *)gmallocn(nCells, sizeof(int));
+  memcpy(fill, cellStart, nCells * sizeof(int));
+  for (i = 0; i < n; ++i) {
+    cell0 = getCellIdx(lo[i]);
+    cell1 = getCellIdx(hi[i]);
+    for (cell = cell0; cell <= cell1; ++cell) {
+      cellItems[fill[cell]++] = i;
+    }
+  }
+  gfree(fill);
+}
+
+TextIntervalGrid::~TextIntervalGrid() {
+  gfree(cellStart);
+  gfree(cellItems);
+}
+
+// This is monotonic in <x>, so any two intersecting intervals share
+// at least one cell.
+int TextIntervalGrid::getCellIdx(double x) {
+  double t;
+
+  t = (x - gridMin) * cellScale;
+  if (!(t > 0)) {
+    return 0;
+  }
+  if (t >= nCells - 1) {
+    return nCells - 1;
+  }
+  return (int)t;
+}
+
+//------------------------------------------------------------------------
+// TextLineOrder
+//------------------------------------------------------------------------
+
+// Used to sort a block's lines into yx order: lines which compare
+// equal go in reverse creation order, which is where inserting each
+// new line in front of the first line that is not less than it puts
+// them.
+struct TextLineOrder {
+  TextLine *line;
+  int idx;			// creation order
+};
+
+static int cmpTextLineOrderYX(const void *p1, const void *p2) {
+  TextLineOrder *o1 = (TextLineOrder *)p1;
+  TextLineOrder *o2 = (TextLineOrder *)p2;
+  int cmp;
+
+  if ((cmp = o1->line->cmpYX(o2->line))) {
+    return cmp;
+  }
+  return o2->idx - o1->idx;
+}
+
+//------------------------------------------------------------------------
+// TextRawStream
+//------------------------------------------------------------------------
+
+// Destination of raw order output (see TextPage::startStream and
+// TextPage::dump).
+struct TextRawStream {
+  void *outputStream;
+  TextOutputFunc outputFunc;
+  frag_listener *listener;
+  UnicodeMap *uMap;
+  char space[8], eol[16];
+  int spaceLen, eolLen;
+  GString *s;			// buffer for the text of a word
+};
+
+// Map the end-of-line sequence into <eol>, and return its length.
+static int mapEOL(UnicodeMap *uMap, char *eol, int eolSize) {
+  int eolLen;
+
+  eolLen = 0; // make gcc happy
+  switch (globalParams->getTextEOL()) {
+  case eolUnix:
+    eolLen = uMap->mapUnicode(0x0a, eol, eolSize);
+    break;
+  case eolDOS:
+    eolLen = uMap->mapUnicode(0x0d, eol, eolSize);
+    eolLen += uMap->mapUnicode(0x0a, eol + eolLen, eolSize - eolLen);
+    break;
+  case eolMac:
+    eolLen = uMap->mapUnicode(0x0d, eol, eolSize);
+    break;
+  }
+  return eolLen;
+}
+
+static void initRawStream(TextRawStream *st, void *outputStream,
+			  TextOutputFunc outputFunc, frag_listener *listener,
+			  UnicodeMap *uMap) {
+  st->outputStream = outputStream;
+  st->outputFunc = outputFunc;
+  st->listener = listener;
+  st->uMap = uMap;
+  st->spaceLen = uMap->mapUnicode(0x20, st->space, sizeof(st->space));
+  st->eolLen = mapEOL(uMap, st->eol, sizeof(st->eol));
+  st->s = new GString();
+}
+
+//------------------------------------------------------------------------
+// TextArena
+//------------------------------------------------------------------------
+
+struct TextArenaChunk {
+  TextArenaChunk *next;
+  int size;			// size of the data, which follows the
+				//   header
+};
+
+#define textArenaChunkHdrSize \
+  (((int)sizeof(TextArenaChunk) + textArenaAlign - 1) & ~(textArenaAlign - 1))
+
+TextArena::TextArena() {
+  chunks = NULL;
+  cur = end = NULL;
+  nextChunkSize = textArenaMinChunkSize;
+  nAllocs = 0;
+  usedBytes = 0;
+  nChunkAllocs = 0;
+  chunkBytes = 0;
+}
+
+TextArena::~TextArena() {
+  TextArenaChunk *chunk;
+
+  while (chunks) {
+    chunk = chunks;
+    chunks = chunks->next;
+    gfree(chunk);
+  }
+}
+
+void *TextArena::alloc(int size) {
+  char *p;
+
+  if (size < 0 || size > INT_MAX - textArenaChunkHdrSize - textArenaAlign) {
+    gMemError("Bogus memory allocation size");
+  }
+  size = (size + textArenaAlign - 1) & ~(textArenaAlign - 1);
+  if (size > end - cur) {
+    newChunk(size);
+  }
+  p = cur;
+  cur += size;
+  ++nAllocs;
+  usedBytes += size;
+  return p;
+}
+
+void *TextArena::allocn(int nObjs, int objSize) {
+  if (nObjs == 0) {
+    return NULL;
+  }
+  if (objSize <= 0 || nObjs < 0 || nObjs >= INT_MAX / objSize) {
+    gMemError("Bogus memory allocation size");
+  }
+  return alloc(nObjs * objSize);
+}
+
+void TextArena::newChunk(int minSize) {
+  TextArenaChunk *chunk;
+  int size;
+
+  size = nextChunkSize > minSize ? nextChunkSize : minSize;
+  chunk = (TextArenaChunk *)gmalloc(textArenaChunkHdrSize + size);
+  chunk->next = chunks;
+  chunk->size = size;
+  chunks = chunk;
+  cur = (char *)chunk + textArenaChunkHdrSize;
+  end = cur + size;
+  ++nChunkAllocs;
+  chunkBytes += size;
+  if (nextChunkSize < textArenaMaxChunkSize) {
+    nextChunkSize *= 2;
+  }
+}
+
+void TextArena::reset() {
+  TextArenaChunk *chunk;
+  int size;
+
+  // the next page will probably look like this one, so size the
+  // first chunk to hold everything on this page
+  if (usedBytes > textArenaMaxChunkSize) {
+    size = textArenaMaxChunkSize;
+  } else if (usedBytes > textArenaMinChunkSize) {
+    size = usedBytes + usedBytes / 2;
+  } else {
+    size = textArenaMinChunkSize;
+  }
+
+  // keep the current chunk if it's the only one, and it isn't much
+  // bigger than needed
+  if (chunks && !chunks->next && chunks->size <= 4 * size) {
+    cur = (char *)chunks + textArenaChunkHdrSize;
+    end = cur + chunks->size;
+  } else {
+    while (chunks) {
+      chunk = chunks;
+      chunks = chunks->next;
+      gfree(chunk);
+    }
+    cur = end = NULL;
+    chunkBytes = 0;
+  }
+  nextChunkSize = size;
+
+  nAllocs = 0;
+  usedBytes = 0;
+  nChunkAllocs = 0;
+}
+
 //------------------------------------------------------------------------
 // TextFontInfo
 //------------------------------------------------------------------------
 
 TextFontInfo::TextFontInfo(GfxState *state) {
   gfxFont = state->getFont();
+  detached = gFalse;
   fontName = (gfxFont && gfxFont->getName()) ? gfxFont->getName()->copy()
                  : (GString *)NULL;
   flags = gfxFont ? gfxFont->getFlags() : 0;
+  // if there is no font, the PDF file draws text without a current
+  // font, which should never happen
+  fontType = fontUnknownType;
+  wMode = 0;
+  ascent = 0.95;
+  descent = -0.35;
+  embFontID.num = embFontID.gen = 0;
+}
+
+TextFontInfo::TextFontInfo(TextFontInfo *info) {
+  gfxFont = NULL;
+  detached = gTrue;
+  fontName = info->fontName ? info->fontName->copy() : (GString *)NULL;
+  flags = info->flags;
+  fontType = info->type();
+  wMode = info->getWMode();
+  ascent = info->getAscent();
+  descent = info->getDescent();
+  embFontID = info->getEmbFontID();
 }
 
 TextFontInfo::~TextFontInfo() {
@@ -299,36 +645,35 @@ TextFontInfo::~TextFontInfo() {
 }
 
 GBool TextFontInfo::matches(GfxState *state) {
-  return state->getFont() == gfxFont;
+  return !detached && state->getFont() == gfxFont;
+}
+
+Ref TextFontInfo::getEmbFontID() {
+  Ref id;
+
+  if (!gfxFont) {
+    return embFontID;
+  }
+  gfxFont->getEmbeddedFontID(&id);
+  return id;
 }
 
 //------------------------------------------------------------------------
 // TextWord
 //------------------------------------------------------------------------
 
-TextWord::TextWord(GfxState *state, int rotA, double x0, double y0,
-		   TextFontInfo *fontA, double fontSizeA) : xMax(-1.0), yMax(-1.0), xMin(-1.0), yMin(-1.0)
+TextWord::TextWord(int rotA, double x, double y,
+		   TextFontInfo *fontA, double fontSizeA,
+		   double colorRA, double colorGA, double colorBA) : xMax(-1.0), yMax(-1.0), xMin(-1.0), yMin(-1.0)
 {
-  GfxFont *gfxFont;
-  double x, y, ascent, descent;
-  int wMode;
+  double ascent, descent;
 
   rot = rotA;
   font = fontA;
   fontSize = fontSizeA;
-  state->transform(x0, y0, &x, &y);
-  if ((gfxFont = font->gfxFont)) {
-    ascent = gfxFont->getAscent() * fontSize;
-    descent = gfxFont->getDescent() * fontSize;
-    wMode = gfxFont->getWMode();
-  } else {
-    // this means that the PDF file draws text without a current font,
-    // which should never happen
-    ascent = 0.95 * fontSize;
-    descent = -0.35 * fontSize;
-    wMode = 0;
-  }
-  if (wMode) { // vertical writing mode
+  ascent = font->getAscent() * fontSize;
+  descent = font->getDescent() * fontSize;
+  if (font->getWMode()) { // vertical writing mode
     // NB: the rotation value has been incremented by 1 (in
     // TextPage::beginWord()) for vertical writing mode
     switch (rot) {
@@ -407,44 +752,50 @@ TextWord::TextWord(GfxState *state, int rotA, double x0, double y0,
   len = size = 0;
   spaceAfter = gFalse;
   next = NULL;
-
-  GfxRGB rgb;
-
-  if ((state->getRender() & 3) == 1) {
-    state->getStrokeRGB(&rgb);
-  } else {
-    state->getFillRGB(&rgb);
-  }
-  colorR = colToDbl(rgb.r);
-  colorG = colToDbl(rgb.g);
-  colorB = colToDbl(rgb.b);
-
+  colorR = colorRA;
+  colorG = colorGA;
+  colorB = colorBA;
   underlined = gFalse;
   link = NULL;
 }
 
-TextWord::~TextWord() {
-  gfree(text);
-  gfree(edge);
-  gfree(charPos);
+// The text, edge, and charPos arrays share one arena allocation.  The
+// old arrays are left in the arena.
+void TextWord::setSize(TextArena *arena, int sizeA) {
+  double *edgeA;
+  int *charPosA;
+  Unicode *textA;
+
+  if (sizeA < 0 || sizeA >= INT_MAX / (int)(sizeof(double) + sizeof(int) +
+					    sizeof(Unicode))) {
+    gMemError("Bogus memory allocation size");
+  }
+  edgeA = (double *)arena->alloc((sizeA + 1) * sizeof(double) +
+				 (sizeA + 1) * sizeof(int) +
+				 sizeA * sizeof(Unicode));
+  charPosA = (int *)(edgeA + sizeA + 1);
+  textA = (Unicode *)(charPosA + sizeA + 1);
+  if (len > 0) {
+    memcpy(edgeA, edge, (len + 1) * sizeof(double));
+    memcpy(charPosA, charPos, (len + 1) * sizeof(int));
+    memcpy(textA, text, len * sizeof(Unicode));
+  }
+  edge = edgeA;
+  charPos = charPosA;
+  text = textA;
+  size = sizeA;
 }
 
-void TextWord::addChar(GfxState *state, double x, double y,
+void TextWord::addChar(TextArena *arena, double x, double y,
 		       double dx, double dy, int charPosA, int charLen,
 		       Unicode u) {
-  int wMode;
-
   if (len == size) {
-    size += 16;
-    text = (Unicode *)greallocn(text, size, sizeof(Unicode));
-    edge = (double *)greallocn(edge, size + 1, sizeof(double));
-    charPos = (int *)greallocn(charPos, size + 1, sizeof(int));
+    setSize(arena, size ? 2 * size : 16);
   }
   text[len] = u;
   charPos[len] = charPosA;
   charPos[len + 1] = charPosA + charLen;
-  wMode = font->gfxFont ? font->gfxFont->getWMode() : 0;
-  if (wMode) { // vertical writing mode
+  if (font->getWMode()) { // vertical writing mode
     // NB: the rotation value has been incremented by 1 (in
     // TextPage::beginWord()) for vertical writing mode
     switch (rot) {
@@ -512,7 +863,7 @@ void TextWord::addChar(GfxState *state, double x, double y,
   ++len;
 }
 
-void TextWord::merge(TextWord *word) {
+void TextWord::merge(TextArena *arena, TextWord *word) {
   int i;
 
   if (word->xMin < xMin) {
@@ -528,10 +879,7 @@ void TextWord::merge(TextWord *word) {
     yMax = word->yMax;
   }
   if (len + word->len > size) {
-    size = len + word->len;
-    text = (Unicode *)greallocn(text, size, sizeof(Unicode));
-    edge = (double *)greallocn(edge, size + 1, sizeof(double));
-    charPos = (int *)greallocn(charPos, size + 1, sizeof(int));
+    setSize(arena, len + word->len);
   }
   for (i = 0; i < word->len; ++i) {
     text[len + i] = word->text[i];
@@ -660,16 +1008,8 @@ TextPool::TextPool() {
   cursorBaseIdx = -1;
 }
 
+// The words are owned by the page's arena.
 TextPool::~TextPool() {
-  int baseIdx;
-  TextWord *word, *word2;
-
-  for (baseIdx = minBaseIdx; baseIdx <= maxBaseIdx; ++baseIdx) {
-    for (word = pool[baseIdx - minBaseIdx]; word; word = word2) {
-      word2 = word->next;
-      delete word;
-    }
-  }
   gfree(pool);
 }
 
@@ -763,17 +1103,9 @@ TextLine::TextLine(TextBlock *blkA, int rotA, double baseA) {
   next = NULL;
 }
 
+// The words and the text, edge, and col arrays are owned by the page's
+// arena.
 TextLine::~TextLine() {
-  TextWord *word;
-
-  while (words) {
-    word = words;
-    words = words->next;
-    delete word;
-  }
-  gfree(text);
-  gfree(edge);
-  gfree(col);
 }
 
 void TextLine::addWord(TextWord *word) {
@@ -922,7 +1254,7 @@ void TextLine::coalesce(UnicodeMap *uMap) {
 		 fabs(word0->fontSize - word1->fontSize) <
 		   maxWordFontSizeDelta * words->fontSize &&
 		 word1->charPos[0] == word0->charPos[word0->len]) {
-	word0->merge(word1);
+	word0->merge(blk->page->arena, word1);
 	word0->next = word1->next;
 	delete word1;
 	word1 = word0->next;
@@ -942,8 +1274,8 @@ void TextLine::coalesce(UnicodeMap *uMap) {
       ++len;
     }
   }
-  text = (Unicode *)gmallocn(len, sizeof(Unicode));
-  edge = (double *)gmallocn(len + 1, sizeof(double));
+  text = (Unicode *)blk->page->arena->allocn(len, sizeof(Unicode));
+  edge = (double *)blk->page->arena->allocn(len + 1, sizeof(double));
   i = 0;
   for (word1 = words; word1; word1 = word1->next) {
     for (j = 0; j < word1->len; ++j) {
@@ -959,7 +1291,7 @@ void TextLine::coalesce(UnicodeMap *uMap) {
   }
 
   // compute convertedLen and set up the col array
-  col = (int *)gmallocn(len + 1, sizeof(int));
+  col = (int *)blk->page->arena->allocn(len + 1, sizeof(int));
   convertedLen = 0;
   for (i = 0; i < len; ++i) {
     col[i] = convertedLen;
@@ -1311,6 +1643,20 @@ void TextBlock::addWord(TextWord *word) {
   }
 }
 
+GBool TextBlock::isPast(TextWord *word, double slack) {
+  switch (rot) {
+  case 0:
+  default:
+    return !(word->xMin < xMax + slack);
+  case 1:
+    return !(word->yMin < yMax + slack);
+  case 2:
+    return !(word->xMax > xMin - slack);
+  case 3:
+    return !(word->yMax > yMin - slack);
+  }
+}
+
 void TextBlock::coalesce(UnicodeMap *uMap, double fixedPitch) {
   TextWord *word0, *word1, *word2, *bestWord0, *bestWord1, *lastWord;
   TextLine *line, *line0, *line1;
@@ -1319,8 +1665,10 @@ void TextBlock::coalesce(UnicodeMap *uMap, double fixedPitch) {
   double minBase, maxBase;
   double fontSize, wordSpacing, delta, priDelta, secDelta;
   TextLine **lineArray;
-  GBool found, overlap;
-  int col1, col2;
+  TextLineOrder *lineOrder;
+  int linesSize;
+  GBool found, overlap, sortable;
+  int nActiveLines, leftCol, col1, col2;
   int i, j, k;
 
   // discard duplicated text (fake boldface, drop shadows)
@@ -1387,6 +1735,9 @@ void TextBlock::coalesce(UnicodeMap *uMap, double fixedPitch) {
   poolMinBaseIdx = pool->minBaseIdx;
   charCount = 0;
   nLines = 0;
+  lineOrder = NULL;
+  linesSize = 0;
+  sortable = gTrue;
   while (1) {
 
     // find the first non-empty line in the pool
@@ -1416,7 +1767,7 @@ void TextBlock::coalesce(UnicodeMap *uMap, double fixedPitch) {
     word0 = pool->getPool(startBaseIdx);
     pool->setPool(startBaseIdx, word0->next);
     word0->next = NULL;
-    line = new TextLine(this, word0->rot, word0->base);
+    line = new(page->arena) TextLine(this, word0->rot, word0->base);
     line->addWord(word0);
     lastWord = word0;
 
@@ -1479,28 +1830,59 @@ void TextBlock::coalesce(UnicodeMap *uMap, double fixedPitch) {
     }
 
     // add the line
-    if (curLine && line->cmpYX(curLine) > 0) {
-      line0 = curLine;
-      line1 = curLine->next;
-    } else {
-      line0 = NULL;
-      line1 = lines;
+    if (nLines == linesSize) {
+      linesSize = linesSize ? 2 * linesSize : 16;
+      lineOrder = (TextLineOrder *)greallocn(lineOrder, linesSize,
+					     sizeof(TextLineOrder));
+    }
+    lineOrder[nLines].line = line;
+    lineOrder[nLines].idx = nLines;
+    if (line->base != line->base ||
+	line->xMin != line->xMin || line->xMax != line->xMax ||
+	line->yMin != line->yMin || line->yMax != line->yMax) {
+      sortable = gFalse;
     }
-    for (;
-	 line1 && line->cmpYX(line1) > 0;
-	 line0 = line1, line1 = line1->next) ;
-    if (line0) {
-      line0->next = line;
-    } else {
-      lines = line;
-    }
-    line->next = line1;
     curLine = line;
     line->coalesce(uMap);
     charCount += line->len;
     ++nLines;
   }
 
+  // link the lines in yx order -- this is the same order that
+  // inserting each line into a sorted list would give, without the
+  // quadratic list search (NaN coordinates don't give a consistent
+  // sort order, so fall back to list insertion in that case)
+  if (sortable) {
+    qsort(lineOrder, nLines, sizeof(TextLineOrder), &cmpTextLineOrderYX);
+    for (i = nLines - 1; i >= 0; --i) {
+      lineOrder[i].line->next = lines;
+      lines = lineOrder[i].line;
+    }
+  } else {
+    curLine = NULL;
+    for (i = 0; i < nLines; ++i) {
+      line = lineOrder[i].line;
+      if (curLine && line->cmpYX(curLine) > 0) {
+	line0 = curLine;
+	line1 = curLine->next;
+      } else {
+	line0 = NULL;
+	line1 = lines;
+      }
+      for (;
+	   line1 && line->cmpYX(line1) > 0;
+	   line0 = line1, line1 = line1->next) ;
+      if (line0) {
+	line0->next = line;
+      } else {
+	lines = line;
+      }
+      line->next = line1;
+      curLine = line;
+    }
+  }
+  gfree(lineOrder);
+
   // sort lines into xy order for column assignment
   lineArray = (TextLine **)gmallocn(nLines, sizeof(TextLine *));
   for (line = lines, i = 0; line; line = line->next, ++i) {
@@ -1536,13 +1918,23 @@ void TextBlock::coalesce(UnicodeMap *uMap, double fixedPitch) {
       }
     }
   } else {
+  // lines which are entirely to the left of line0 are also entirely
+  // to the left of every later line, so they are dropped, and only
+  // the max column to their right is kept (the front of lineArray is
+  // reused to hold the remaining, active, lines)
+  nActiveLines = 0;
+  leftCol = 0;
   for (i = 0; i < nLines; ++i) {
     line0 = lineArray[i];
-    col1 = 0;
-    for (j = 0; j < i; ++j) {
+    col1 = leftCol;
+    for (j = 0; j < nActiveLines; ++j) {
       line1 = lineArray[j];
       if (line1->primaryDelta(line0) >= 0) {
 	col2 = line1->col[line1->len] + 1;
+	if (col2 > leftCol) {
+	  leftCol = col2;
+	}
+	lineArray[j--] = lineArray[--nActiveLines];
       } else {
 	k = 0; // make gcc happy
 	switch (rot) {
@@ -1583,6 +1975,7 @@ void TextBlock::coalesce(UnicodeMap *uMap, double fixedPitch) {
     if (line0->col[line0->len] > nColumns) {
       nColumns = line0->col[line0->len];
     }
+    lineArray[nActiveLines++] = line0;
   }
   }
   gfree(lineArray);
@@ -1770,6 +2163,27 @@ GBool TextBlock::isBelow(TextBlock *blk) {
   return below;
 }
 
+GBool TextBlock::startsAbove(TextBlock *blk) {
+  GBool above;
+
+  above = gFalse; // make gcc happy
+  switch (page->primaryRot) {
+  case 0:
+    above = yMin <= blk->yMin;
+    break;
+  case 1:
+    above = xMax >= blk->xMax;
+    break;
+  case 2:
+    above = yMin >= blk->yMax;
+    break;
+  case 3:
+    above = xMax <= blk->xMin;
+    break;
+  }
+  return above;
+}
+
 //------------------------------------------------------------------------
 // TextFlow
 //------------------------------------------------------------------------
@@ -1921,6 +2335,368 @@ TextWord *TextWordList::get(int idx) {
   return (TextWord *)words->get(idx);
 }
 
+//------------------------------------------------------------------------
+// TextFormRecord
+//------------------------------------------------------------------------
+
+enum TextFormOpKind {
+  textFormChar,			// TextPage::addDevChar
+  textFormFont,			// TextPage::updateFont
+  textFormCharCount,		// TextPage::incCharCount
+  textFormImage			// TextOutputDev::drawImage
+};
+
+struct TextFormOp {
+  TextFormOpKind kind;
+  int idx;			// index into chars, fonts, or images, or
+				//   the number of chars for
+				//   textFormCharCount
+};
+
+struct TextFormChar {
+  TextDevChar ch;
+  int uIdx, uLen;		// text [TextFormRecord::u]
+  int uStored;			// number of stored Unicode values (may be
+				//   more than uLen, see addChar)
+};
+
+struct TextFormFont {
+  int snapIdx;			// font [TextFormRecord::snaps]
+  double fontSize;
+};
+
+struct TextFormImage {
+  int x, y, w, h;
+  GBool inlineImg;
+};
+
+// What a form XObject added to a TextPage, and the state it was drawn
+// in.
+class TextFormRecord {
+public:
+
+  TextFormRecord(Ref idA, int fontBaseA);
+  ~TextFormRecord();
+
+  void addChar(TextDevChar *ch, Unicode *uA, int uLen);
+  void addFont(TextPage *page, int fontIdx);
+  void addCharCount(int nChars);
+  void addImage(int x, int y, int w, int h, GBool inlineImg);
+
+  // Set the state the form was drawn in.
+  void setKey(GfxState *state, int inheritedParamsA);
+
+  // Is the form drawn in <state> equivalent to this record (up to a
+  // translation)?
+  GBool matches(GfxState *state);
+
+  size_t getBytes();
+
+  TextFormRecord *next;		// enclosing record (while recording)
+
+private:
+
+  Ref id;
+  int fontBase;			// fonts added to the page after this
+				//   index belong to the record
+  int curSnap;			// current font [snaps], or -1 if it
+				//   belongs to the enclosing content
+  GBool failed;			// set if the record can't be replayed
+
+  std::vector<TextFormOp> ops;
+  std::vector<TextFormChar> chars;
+  std::vector<Unicode> u;
+  std::vector<TextFormFont> fonts;
+  std::vector<TextFormImage> images;
+  std::vector<TextFontInfo *> snaps;	// detached copies of the fonts
+
+  double ctm[6];
+  int inheritedParams;		// [GfxTextParam]
+  double charSpace, wordSpace,	// values of the inherited params
+         horizScaling, leading,
+         rise;
+  int render;
+  GfxRGB fillRGB, strokeRGB;
+
+  friend class TextOutputDev;
+};
+
+TextFormRecord::TextFormRecord(Ref idA, int fontBaseA) {
+  next = NULL;
+  id = idA;
+  fontBase = fontBaseA;
+  curSnap = -1;
+  failed = gFalse;
+  inheritedParams = 0;
+}
+
+TextFormRecord::~TextFormRecord() {
+  size_t i;
+
+  for (i = 0; i < snaps.size(); ++i) {
+    delete snaps[i];
+  }
+}
+
+void TextFormRecord::addChar(TextDevChar *ch, Unicode *uA, int uLen) {
+  TextFormChar fc;
+  TextFormOp op;
+  int i;
+
+  if (failed) {
+    return;
+  }
+  // a font of the enclosing content (e.g., the form has no Tf) can't
+  // be replayed
+  if (curSnap < 0) {
+    failed = gTrue;
+    return;
+  }
+  fc.ch = *ch;
+  fc.uIdx = (int)u.size();
+  fc.uLen = uLen;
+  // TextPage::addDevChar looks at u[0] even if there is no text, and
+  // at u[0..2] for unmapped chars
+  fc.uStored = uLen;
+  if (accented::word::is_invalid_unicode(uA)) {
+    if (fc.uStored < 3) {
+      fc.uStored = 3;
+    }
+  } else if (fc.uStored < 1) {
+    fc.uStored = 1;
+  }
+  for (i = 0; i < fc.uStored; ++i) {
+    u.push_back(uA ? uA[i] : 0);
+  }
+  op.kind = textFormChar;
+  op.idx = (int)chars.size();
+  chars.push_back(fc);
+  ops.push_back(op);
+}
+
+void TextFormRecord::addFont(TextPage *page, int fontIdx) {
+  TextFormFont ff;
+  TextFormOp op;
+
+  if (failed) {
+    return;
+  }
+  if (fontIdx < fontBase) {
+    curSnap = -1;
+    return;
+  }
+  // the page's fonts are appended one at a time, each one is seen here
+  // before the next one
+  ff.snapIdx = fontIdx - fontBase;
+  if (ff.snapIdx == (int)snaps.size()) {
+    snaps.push_back(new TextFontInfo((TextFontInfo *)page->fonts->get(fontIdx)));
+  } else if (ff.snapIdx > (int)snaps.size()) {
+    failed = gTrue;
+    return;
+  }
+  ff.fontSize = page->curFontSize;
+  curSnap = ff.snapIdx;
+  op.kind = textFormFont;
+  op.idx = (int)fonts.size();
+  fonts.push_back(ff);
+  ops.push_back(op);
+}
+
+void TextFormRecord::addCharCount(int nChars) {
+  TextFormOp op;
+
+  if (failed) {
+    return;
+  }
+  op.kind = textFormCharCount;
+  op.idx = nChars;
+  ops.push_back(op);
+}
+
+void TextFormRecord::addImage(int x, int y, int w, int h, GBool inlineImg) {
+  TextFormImage img;
+  TextFormOp op;
+
+  if (failed) {
+    return;
+  }
+  img.x = x;
+  img.y = y;
+  img.w = w;
+  img.h = h;
+  img.inlineImg = inlineImg;
+  op.kind = textFormImage;
+  op.idx = (int)images.size();
+  images.push_back(img);
+  ops.push_back(op);
+}
+
+void TextFormRecord::setKey(GfxState *state, int inheritedParamsA) {
+  int i;
+
+  for (i = 0; i < 6; ++i) {
+    ctm[i] = state->getCTM()[i];
+  }
+  inheritedParams = inheritedParamsA;
+  charSpace = state->getCharSpace();
+  wordSpace = state->getWordSpace();
+  horizScaling = state->getHorizScaling();
+  leading = state->getLeading();
+  rise = state->getRise();
+  render = state->getRender();
+  if (inheritedParams & gfxTextFillColor) {
+    state->getFillRGB(&fillRGB);
+  }
+  if (inheritedParams & gfxTextStrokeColor) {
+    state->getStrokeRGB(&strokeRGB);
+  }
+}
+
+GBool TextFormRecord::matches(GfxState *state) {
+  double *m;
+  GfxRGB rgb;
+
+  // the text is moved on replay, but not scaled or rotated
+  m = state->getCTM();
+  if (m[0] != ctm[0] || m[1] != ctm[1] || m[2] != ctm[2] || m[3] != ctm[3]) {
+    return gFalse;
+  }
+  if (((inheritedParams & gfxTextCharSpace) &&
+       state->getCharSpace() != charSpace) ||
+      ((inheritedParams & gfxTextWordSpace) &&
+       state->getWordSpace() != wordSpace) ||
+      ((inheritedParams & gfxTextHorizScaling) &&
+       state->getHorizScaling() != horizScaling) ||
+      ((inheritedParams & gfxTextLeading) &&
+       state->getLeading() != leading) ||
+      ((inheritedParams & gfxTextRise) &&
+       state->getRise() != rise) ||
+      ((inheritedParams & gfxTextRender) &&
+       state->getRender() != render)) {
+    return gFalse;
+  }
+  if (inheritedParams & gfxTextFillColor) {
+    state->getFillRGB(&rgb);
+    if (rgb.r != fillRGB.r || rgb.g != fillRGB.g || rgb.b != fillRGB.b) {
+      return gFalse;
+    }
+  }
+  if (inheritedParams & gfxTextStrokeColor) {
+    state->getStrokeRGB(&rgb);
+    if (rgb.r != strokeRGB.r || rgb.g != strokeRGB.g ||
+	rgb.b != strokeRGB.b) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+size_t TextFormRecord::getBytes() {
+  size_t n, i;
+
+  n = sizeof(TextFormRecord) +
+      ops.size() * sizeof(TextFormOp) +
+      chars.size() * sizeof(TextFormChar) +
+      u.size() * sizeof(Unicode) +
+      fonts.size() * sizeof(TextFormFont) +
+      images.size() * sizeof(TextFormImage);
+  for (i = 0; i < snaps.size(); ++i) {
+    n += sizeof(TextFontInfo);
+    if (snaps[i]->getFontName()) {
+      n += snaps[i]->getFontName()->getLength();
+    }
+  }
+  return n;
+}
+
+//------------------------------------------------------------------------
+// TextFormCache
+//------------------------------------------------------------------------
+
+struct TextFormEntry {
+  int nDraws;			// number of times the form was interpreted
+  int nFailures;		// number of records which were dropped
+  std::vector<TextFormRecord *> records;
+};
+
+// The records of the form XObjects of one document, by object number.
+class TextFormCache {
+public:
+
+  TextFormCache();
+  ~TextFormCache();
+
+  // Get the entry of form <id>, or NULL if there is none and <create>
+  // is false.
+  TextFormEntry *getEntry(Ref id, GBool create);
+
+  // Drop the records if they are of another document than <xrefA>.
+  void setDoc(XRef *xrefA);
+
+  // Drop all records.
+  void clear();
+
+  size_t bytes;			// size of all records
+  int nRecords;			// number of records
+  int nReplays;			// number of replayed records
+
+private:
+
+  XRef *xref;			// the document of the records
+
+  std::unordered_map<long long, TextFormEntry> entries;
+};
+
+TextFormCache::TextFormCache() {
+  xref = NULL;
+  bytes = 0;
+  nRecords = 0;
+  nReplays = 0;
+}
+
+TextFormCache::~TextFormCache() {
+  clear();
+}
+
+void TextFormCache::setDoc(XRef *xrefA) {
+  if (xrefA != xref) {
+    clear();
+    xref = xrefA;
+  }
+}
+
+void TextFormCache::clear() {
+  std::unordered_map<long long, TextFormEntry>::iterator it;
+  size_t i;
+
+  for (it = entries.begin(); it != entries.end(); ++it) {
+    for (i = 0; i < it->second.records.size(); ++i) {
+      delete it->second.records[i];
+    }
+  }
+  entries.clear();
+  bytes = 0;
+}
+
+TextFormEntry *TextFormCache::getEntry(Ref id, GBool create) {
+  std::unordered_map<long long, TextFormEntry>::iterator it;
+  TextFormEntry *entry;
+  long long key;
+
+  key = ((long long)id.num << 32) | (unsigned int)id.gen;
+  it = entries.find(key);
+  if (it != entries.end()) {
+    return &it->second;
+  }
+  if (!create) {
+    return NULL;
+  }
+  entry = &entries[key];
+  entry->nDraws = 0;
+  entry->nFailures = 0;
+  return entry;
+}
+
 //------------------------------------------------------------------------
 // TextPage
 //------------------------------------------------------------------------
@@ -1948,11 +2724,14 @@ TextPage::TextPage(GBool rawOrderA) {
   blocks = NULL;
   rawWords = NULL;
   rawLastWord = NULL;
+  stream = NULL;
   fonts = new GList();
   lastFindXMin = lastFindYMin = 0;
   haveLastFind = gFalse;
   underlines = new GList();
   links = new GList();
+  arena = new TextArena();
+  records = NULL;
 }
 
 TextPage::~TextPage() {
@@ -1967,6 +2746,7 @@ TextPage::~TextPage() {
   delete fonts;
   deleteGList(underlines, TextUnderline);
   deleteGList(links, TextLink);
+  delete arena;
 }
 
 void TextPage::startPage(GfxState *state) {
@@ -1985,23 +2765,79 @@ void TextPage::endPage() {
   }
 }
 
+void TextPage::startStream(void *outputStream, TextOutputFunc outputFunc,
+			   frag_listener *listener) {
+  UnicodeMap *uMap;
+
+  if (!rawOrder || !(uMap = globalParams->getTextEncoding())) {
+    return;
+  }
+  endStream();
+  stream = new TextRawStream;
+  initRawStream(stream, outputStream, outputFunc, listener, uMap);
+
+  // coalesce sets these for raw order pages, but the words are
+  // written before it is called
+  primaryRot = 0;
+  primaryLR = gTrue;
+}
+
+void TextPage::endStream() {
+  if (stream) {
+    stream->uMap->decRefCnt();
+    delete stream->s;
+    delete stream;
+    stream = NULL;
+  }
+}
+
+// Write the text of <word> in raw order output.
+void TextPage::writeRawWord(TextRawStream *st, TextWord *word) {
+  st->s->clear();
+  dumpFragment(word->text, word->len, st->uMap, st->s, primaryLR);
+  (*st->outputFunc)(st->outputStream, st->s->getCString(), st->s->getLength());
+  // jm
+  if (st->listener) {
+    st->listener->line(word, st->s->getCString(), st->s->getLength());
+  }
+}
+
+// Write the separator between <word> and <next> (NULL if <word> is
+// the last word on the page) in raw order output: a space if they
+// are on the same line but far enough apart, nothing if they are on
+// the same line and close together, and an end-of-line otherwise.
+void TextPage::writeRawSep(TextRawStream *st, TextWord *word,
+			   TextWord *next) {
+  if (next &&
+      fabs(next->base - word->base) < maxIntraLineDelta * word->fontSize &&
+      next->xMin > word->xMax - minDupBreakOverlap * word->fontSize) {
+    if (next->xMin > word->xMax + minWordSpacing * word->fontSize) {
+      (*st->outputFunc)(st->outputStream, st->space, st->spaceLen);
+      // jm
+      if (st->listener) {
+	st->listener->space(st->spaceLen);
+      }
+    }
+  } else {
+    (*st->outputFunc)(st->outputStream, st->eol, st->eolLen);
+    // jm
+    if (st->listener) {
+      st->listener->end_line(st->eolLen);
+    }
+  }
+}
+
 void TextPage::clear() {
   int rot;
   TextFlow *flow;
-  TextWord *word;
 
-  if (curWord) {
-    delete curWord;
-    curWord = NULL;
-  }
+  // the words, lines, blocks, and flows are freed all at once, when
+  // the arena is reset (below) -- the blocks still need to be
+  // deleted, to free their pools
+  endStream();
+  curWord = NULL;
   gfree(actualText);
-  if (rawOrder) {
-    while (rawWords) {
-      word = rawWords;
-      rawWords = rawWords->next;
-      delete word;
-    }
-  } else {
+  if (!rawOrder) {
     for (rot = 0; rot < 4; ++rot) {
       delete pools[rot];
     }
@@ -2015,8 +2851,8 @@ void TextPage::clear() {
   deleteGList(fonts, TextFontInfo);
   deleteGList(underlines, TextUnderline);
   deleteGList(links, TextLink);
+  arena->reset();
 
-  curWord = NULL;
   charPos = 0;
   curFont = NULL;
   curFontSize = 0;
@@ -2045,7 +2881,7 @@ void TextPage::updateFont(GfxState *state) {
   char *name;
   int code, mCode, letterCode, anyCode;
   double w;
-  int i;
+  int fontIdx, i;
 
   // get the font info object
   curFont = NULL;
@@ -2060,6 +2896,7 @@ void TextPage::updateFont(GfxState *state) {
     curFont = new TextFontInfo(state);
     fonts->append(curFont);
   }
+  fontIdx = i;
 
   // adjust the font size
   gfxFont = state->getFont();
@@ -2105,13 +2942,13 @@ void TextPage::updateFont(GfxState *state) {
       curFontSize *= fabs(fm[3] / fm[0]);
     }
   }
-}
 
-void TextPage::beginWord(GfxState *state, double x0, double y0) {
-  double *fontm;
-  double m[4], m2[4];
-  int rot;
+  if (records) {
+    fontChanged(fontIdx);
+  }
+}
 
+void TextPage::beginWord(TextDevChar *ch, GBool backward) {
   // This check is needed because Type 3 characters can contain
   // text-drawing operations (when TextPage is being used via
   // {X,Win}SplashOutputDev rather than TextOutputDev).
@@ -2120,6 +2957,27 @@ void TextPage::beginWord(GfxState *state, double x0, double y0) {
     return;
   }
 
+  resolveDevChar(ch);
+  curWord = new(arena) TextWord(ch->rot,
+				backward ? ch->xr : ch->x,
+				backward ? ch->yr : ch->y,
+				curFont, curFontSize,
+				ch->colorR, ch->colorG, ch->colorB);
+}
+
+// Compute the parts of <ch> which are only needed to start a word.
+void TextPage::resolveDevChar(TextDevChar *ch) {
+  GfxState *state;
+  double *fontm;
+  double m[4], m2[4];
+  GfxRGB rgb;
+  int rot;
+
+  if (!(state = ch->state)) {
+    return;
+  }
+  ch->state = NULL;
+
   // compute the rotation
   state->getFontTransMat(&m[0], &m[1], &m[2], &m[3]);
   if (state->getFont()->getType() == fontType3) {
@@ -2144,24 +3002,27 @@ void TextPage::beginWord(GfxState *state, double x0, double y0) {
   if (state->getFont()->getWMode()) {
     rot = (rot + 1) & 3;
   }
+  ch->rot = rot;
 
-  curWord = new TextWord(state, rot, x0, y0, curFont, curFontSize);
+  state->transform(ch->tx, ch->ty, &ch->xr, &ch->yr);
+
+  if ((state->getRender() & 3) == 1) {
+    state->getStrokeRGB(&rgb);
+  } else {
+    state->getFillRGB(&rgb);
+  }
+  ch->colorR = colToDbl(rgb.r);
+  ch->colorG = colToDbl(rgb.g);
+  ch->colorB = colToDbl(rgb.b);
 }
 
 void TextPage::addChar(GfxState *state, double x, double y,
 		       double dx, double dy,
 		       CharCode c, int nBytes, Unicode *u, int uLen) {
-  double x1 = 0.0, 
-    y1 = 0.0, 
-    w1 = 0.0, 
-    h1 = 0.0, 
-    dx2 = 0.0, 
+  TextDevChar ch;
+  double dx2 = 0.0, 
     dy2 = 0.0, 
-    base = 0.0, 
-    sp = 0.0, 
-    delta = 0.0;
-  GBool overlap;
-  int i;
+    sp = 0.0;
 
   // if we're in an ActualText span, save the position info (the
   // ActualText chars will be added by TextPage::endActualText()).
@@ -2184,11 +3045,37 @@ void TextPage::addChar(GfxState *state, double x, double y,
   state->textTransformDelta(sp * state->getHorizScaling(), 0, &dx2, &dy2);
   dx -= dx2;
   dy -= dy2;
-  state->transformDelta(dx, dy, &w1, &h1);
+  state->transformDelta(dx, dy, &ch.w, &ch.h);
+  state->transform(x, y, &ch.x, &ch.y);
+  ch.nBytes = nBytes;
+
+  // the rest is only needed if the char starts a word
+  ch.state = state;
+  ch.tx = x + dx;
+  ch.ty = y + dy;
+
+  addDevChar(&ch, u, uLen);
+}
+
+void TextPage::addDevChar(TextDevChar *ch, Unicode *u, int uLen) {
+  TextFormRecord *rec;
+  double x1, y1, w1, h1;
+  int nBytes, i;
+
+  // the records keep the char as it is given (<u> is modified below)
+  for (rec = records; rec; rec = rec->next) {
+    resolveDevChar(ch);
+    rec->addChar(ch, u, uLen);
+  }
+
+  x1 = ch->x;
+  y1 = ch->y;
+  w1 = ch->w;
+  h1 = ch->h;
+  nBytes = ch->nBytes;
 
   // throw away chars that aren't inside the page bounds
   // (and also do a sanity check on the character size)
-  state->transform(x, y, &x1, &y1);
   if (x1 + w1 < 0 || x1 > pageWidth ||
       y1 + h1 < 0 || y1 > pageHeight ||
       w1 > pageWidth || h1 > pageHeight) {
@@ -2224,7 +3111,7 @@ void TextPage::addChar(GfxState *state, double x, double y,
 
 
   // accented wrapper
-  accented::word accented_word( curWord, u, x1, y1, w1, h1, curFontSize );
+  accented::word accented_word( accentCtx, curWord, u, x1, y1, w1, h1, curFontSize );
 
   // start a new word if:
   // (1) this character doesn't fall in the right place relative to
@@ -2253,7 +3140,7 @@ void TextPage::addChar(GfxState *state, double x, double y,
 		    if ( accented_word.last_is_accent() ) {
 			    --curWord->len;
 			    (const_cast<Unicode*>(u))[0] = translated_char;
-                accented::word::last_was_translated( true );
+                accented_word.last_was_translated( true );
             // `A
 		    }else {
 			    curWord->text[curWord->len-1] = translated_char;
@@ -2269,7 +3156,7 @@ void TextPage::addChar(GfxState *state, double x, double y,
         }else {
 			    --curWord->len;
 			    (const_cast<Unicode*>(u))[0] = translated_char;
-                accented::word::last_was_translated( true );
+                accented_word.last_was_translated( true );
         }
 	
 	// if there is a new word starting with accent, it is on the same line and not too far away
@@ -2299,7 +3186,9 @@ void TextPage::addChar(GfxState *state, double x, double y,
     // - must be here because if a char starts a new word we end up here
     //
     if ( accented_word.is_invalid_unicode( u ) ) {
-        Unicode mapped_char = accented_word.translate_invalid_unicode( u, state );
+        Ref font_id = curFont ? curFont->getEmbFontID() : Ref{0, 0};
+        Unicode mapped_char = accented_word.translate_invalid_unicode(
+            u, font_id.num, font_id.gen );
         uLen = 1;
         ((Unicode *)(u))[0] = mapped_char;
         ((Unicode *)(u))[1] = ((Unicode *)(u))[2] = 0;
@@ -2309,7 +3198,7 @@ void TextPage::addChar(GfxState *state, double x, double y,
   if (uLen != 0 && should_add_char) {
     // start a new word if needed
     if (!curWord) {
-      beginWord(state, x, y);
+      beginWord(ch, gFalse);
 	  accented_word.beganWord( curWord );
     }
 
@@ -2322,7 +3211,7 @@ void TextPage::addChar(GfxState *state, double x, double y,
 	(curWord->rot == 3 && h1 > 0)) {
 	  accented_word.endingWord( curWord );
       endWord();
-      beginWord(state, x + dx, y + dy);
+      beginWord(ch, gTrue);
 	  accented_word.beganWord( curWord );
       x1 += w1;
       y1 += h1;
@@ -2334,14 +3223,38 @@ void TextPage::addChar(GfxState *state, double x, double y,
     w1 /= uLen;
     h1 /= uLen;
     for (i = 0; i < uLen; ++i) {
-      curWord->addChar(state, x1 + i*w1, y1 + i*h1, w1, h1,
+      curWord->addChar(arena, x1 + i*w1, y1 + i*h1, w1, h1,
 		       charPos, nBytes, u[i]);
     }
   }
   charPos += nBytes;
 }
 
+void TextPage::startRecord(TextFormRecord *rec) {
+  rec->next = records;
+  records = rec;
+}
+
+void TextPage::stopRecord(TextFormRecord *rec) {
+  records = rec->next;
+  rec->next = NULL;
+}
+
+// The current font was set to fonts[<fontIdx>].
+void TextPage::fontChanged(int fontIdx) {
+  TextFormRecord *rec;
+
+  for (rec = records; rec; rec = rec->next) {
+    rec->addFont(this, fontIdx);
+  }
+}
+
 void TextPage::incCharCount(int nChars) {
+  TextFormRecord *rec;
+
+  for (rec = records; rec; rec = rec->next) {
+    rec->addCharCount(nChars);
+  }
   charPos += nChars;
 }
 
@@ -2398,6 +3311,12 @@ void TextPage::addWord(TextWord *word) {
   }
 
   if (rawOrder) {
+    if (stream) {
+      if (rawLastWord) {
+	writeRawSep(stream, rawLastWord, word);
+      }
+      writeRawWord(stream, word);
+    }
     if (rawLastWord) {
       rawLastWord->next = word;
     } else {
@@ -2423,19 +3342,26 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
   TextWord *word0, *word1, *word2;
   TextLine *line;
   TextBlock *blkList, *blkStack, *blk, *lastBlk, *blk0, *blk1;
-  TextBlock **blkArray;
+  TextBlock **blkArray, **activeBlks;
   TextFlow *flow, *lastFlow;
   TextUnderline *underline;
   TextLink *link;
   int rot, poolMinBaseIdx, baseIdx, startBaseIdx, endBaseIdx;
+  int skipMinBaseIdx, skipMaxBaseIdx;
   double minBase, maxBase, newMinBase, newMaxBase;
+  double scanMinBase, scanMaxBase, scanPriMin, scanPriMax;
   double fontSize, colSpace1, colSpace2, lineSpace, intraLineSpace, blkSpace;
-  GBool found;
+  GBool found, rescan;
   int count[4];
   int lrCount;
   int firstBlkIdx, nBlocksLeft;
-  int col1, col2;
-  int i, j, n;
+  int nActiveBlks, leftCol, col1, col2;
+  GBool left, blkBoxesOk;
+  TextIntervalGrid *grid;
+  double *blkLo, *blkHi;
+  int *visited, *cellBlks;
+  int cell, cell0, cell1, lo, hi, mid;
+  int i, j, k, n;
 
   if (rawOrder) {
     primaryRot = 0;
@@ -2653,7 +3579,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
       word0 = pool->getPool(startBaseIdx);
       pool->setPool(startBaseIdx, word0->next);
       word0->next = NULL;
-      blk = new TextBlock(this, rot);
+      blk = new(arena) TextBlock(this, rot);
       blk->addWord(word0);
 
       fontSize = word0->fontSize;
@@ -2662,6 +3588,9 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
       colSpace2 = minColSpacing2 * fontSize;
       lineSpace = maxLineSpacingDelta * fontSize;
       intraLineSpace = maxIntraLineDelta * fontSize;
+      scanMinBase = scanMaxBase = 0;
+      scanPriMin = scanPriMax = 0;
+      rescan = gTrue;
 
       // add words to the block
       do {
@@ -2675,7 +3604,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	     --baseIdx) {
 	  word0 = NULL;
 	  word1 = pool->getPool(baseIdx);
-	  while (word1) {
+	  while (word1 && !blk->isPast(word1, 0)) {
 	    if (word1->base < minBase &&
 		word1->base >= minBase - lineSpace &&
 		((rot == 0 || rot == 2)
@@ -2710,7 +3639,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	     ++baseIdx) {
 	  word0 = NULL;
 	  word1 = pool->getPool(baseIdx);
-	  while (word1) {
+	  while (word1 && !blk->isPast(word1, 0)) {
 	    if (word1->base > maxBase &&
 		word1->base <= maxBase + lineSpace &&
 		((rot == 0 || rot == 2)
@@ -2738,13 +3667,36 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	maxBase = newMaxBase;
 
 	// look for words that are on lines already in the block, and
-	// that overlap the block horizontally
+	// that overlap the block horizontally -- words rejected by the
+	// previous pass can only match now if the block has grown
+	// along the primary axis, so if it hasn't, skip the buckets
+	// that were entirely inside the previous pass's baseline range
+	if (!rescan &&
+	    ((rot == 0 || rot == 2) ? (blk->xMin == scanPriMin &&
+				       blk->xMax == scanPriMax)
+	                            : (blk->yMin == scanPriMin &&
+				       blk->yMax == scanPriMax))) {
+	  skipMinBaseIdx = pool->getBaseIdx(scanMinBase) + 1;
+	  skipMaxBaseIdx = pool->getBaseIdx(scanMaxBase) - 1;
+	} else {
+	  skipMinBaseIdx = 1;
+	  skipMaxBaseIdx = 0;
+	}
+	scanMinBase = minBase - intraLineSpace;
+	scanMaxBase = maxBase + intraLineSpace;
+	scanPriMin = (rot == 0 || rot == 2) ? blk->xMin : blk->yMin;
+	scanPriMax = (rot == 0 || rot == 2) ? blk->xMax : blk->yMax;
+	rescan = gFalse;
 	for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace);
 	     baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace);
 	     ++baseIdx) {
+	  if (baseIdx == skipMinBaseIdx && skipMinBaseIdx <= skipMaxBaseIdx) {
+	    baseIdx = skipMaxBaseIdx;
+	    continue;
+	  }
 	  word0 = NULL;
 	  word1 = pool->getPool(baseIdx);
-	  while (word1) {
+	  while (word1 && !blk->isPast(word1, colSpace1)) {
 	    if (word1->base >= minBase - intraLineSpace &&
 		word1->base <= maxBase + intraLineSpace &&
 		((rot == 0 || rot == 2)
@@ -2849,7 +3801,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	     baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace);
 	     ++baseIdx) {
 	  word1 = pool->getPool(baseIdx);
-	  while (word1) {
+	  while (word1 && !blk->isPast(word1, colSpace2)) {
 	    if (word1->base >= minBase - intraLineSpace &&
 		word1->base <= maxBase + intraLineSpace &&
 		((rot == 0 || rot == 2)
@@ -2871,7 +3823,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	       ++baseIdx) {
 	    word0 = NULL;
 	    word1 = pool->getPool(baseIdx);
-	    while (word1) {
+	    while (word1 && !blk->isPast(word1, colSpace2)) {
 	      if (word1->base >= minBase - intraLineSpace &&
 		  word1->base <= maxBase + intraLineSpace &&
 		  ((rot == 0 || rot == 2)
@@ -3020,17 +3972,25 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
   }
   qsort(blocks, nBlocks, sizeof(TextBlock *), &TextBlock::cmpXYPrimaryRot);
 
-  // column assignment
+  // column assignment -- the blocks are sorted by their left edge
+  // (relative to the primary rotation), so a block which is entirely
+  // to the left of blk0 is also entirely to the left of every later
+  // block; such blocks are dropped from the active list, and only the
+  // max column to their right is kept
+  activeBlks = (TextBlock **)gmallocn(nBlocks, sizeof(TextBlock *));
+  nActiveBlks = 0;
+  leftCol = 0;
   for (i = 0; i < nBlocks; ++i) {
     blk0 = blocks[i];
-    col1 = 0;
-    for (j = 0; j < i; ++j) {
-      blk1 = blocks[j];
+    col1 = leftCol;
+    for (j = 0; j < nActiveBlks; ++j) {
+      blk1 = activeBlks[j];
       col2 = 0; // make gcc happy
+      left = gFalse;
       switch (primaryRot) {
       case 0:
 	if (blk0->xMin > blk1->xMax) {
-	  col2 = blk1->col + blk1->nColumns + 3;
+	  left = gTrue;
 	} else if (blk1->xMax == blk1->xMin) {
 	  col2 = blk1->col;
 	} else {
@@ -3041,7 +4001,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	break;
       case 1:
 	if (blk0->yMin > blk1->yMax) {
-	  col2 = blk1->col + blk1->nColumns + 3;
+	  left = gTrue;
 	} else if (blk1->yMax == blk1->yMin) {
 	  col2 = blk1->col;
 	} else {
@@ -3052,7 +4012,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	break;
       case 2:
 	if (blk0->xMax < blk1->xMin) {
-	  col2 = blk1->col + blk1->nColumns + 3;
+	  left = gTrue;
 	} else if (blk1->xMin == blk1->xMax) {
 	  col2 = blk1->col;
 	} else {
@@ -3063,7 +4023,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	break;
       case 3:
 	if (blk0->yMax < blk1->yMin) {
-	  col2 = blk1->col + blk1->nColumns + 3;
+	  left = gTrue;
 	} else if (blk1->yMin == blk1->yMax) {
 	  col2 = blk1->col;
 	} else {
@@ -3073,6 +4033,13 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	}
 	break;
       }
+      if (left) {
+	col2 = blk1->col + blk1->nColumns + 3;
+	if (col2 > leftCol) {
+	  leftCol = col2;
+	}
+	activeBlks[j--] = activeBlks[--nActiveBlks];
+      }
       if (col2 > col1) {
 	col1 = col2;
       }
@@ -3083,7 +4050,9 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
 	line->col[j] += col1;
       }
     }
+    activeBlks[nActiveBlks++] = blk0;
   }
+  gfree(activeBlks);
 
   }
 
@@ -3114,16 +4083,56 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
   // sort blocks into yx order (in preparation for reading order sort)
   qsort(blocks, nBlocks, sizeof(TextBlock *), &TextBlock::cmpYXPrimaryRot);
 
-  // compute space on left and right sides of each block
+  // compute space on left and right sides of each block -- only
+  // blocks which overlap along the secondary axis can affect each
+  // other, so look those up in a grid
+  blkLo = (double *)gmallocn(nBlocks, sizeof(double));
+  blkHi = (double *)gmallocn(nBlocks, sizeof(double));
+  for (i = 0; i < nBlocks; ++i) {
+    blk = blocks[i];
+    if (primaryRot == 0 || primaryRot == 2) {
+      blkLo[i] = blk->yMin;
+      blkHi[i] = blk->yMax;
+    } else {
+      blkLo[i] = blk->xMin;
+      blkHi[i] = blk->xMax;
+    }
+  }
+  grid = new TextIntervalGrid(blkLo, blkHi, nBlocks);
+  visited = (int *)gmallocn(nBlocks, sizeof(int));
+  for (i = 0; i < nBlocks; ++i) {
+    visited[i] = -1;
+  }
   for (i = 0; i < nBlocks; ++i) {
     blk0 = blocks[i];
-    for (j = 0; j < nBlocks; ++j) {
-      blk1 = blocks[j];
-      if (blk1 != blk0) {
-	blk0->updatePriMinMax(blk1);
+    grid->getCells(blkLo[i], blkHi[i], &cell0, &cell1);
+    for (cell = cell0; cell <= cell1; ++cell) {
+      cellBlks = grid->getCell(cell, &n);
+      for (k = 0; k < n; ++k) {
+	j = cellBlks[k];
+	if (j != i && visited[j] != i) {
+	  visited[j] = i;
+	  blk0->updatePriMinMax(blocks[j]);
+	}
       }
     }
   }
+  gfree(visited);
+  delete grid;
+
+  // blocks which are entirely above blkStack are skipped when looking
+  // for the next block in a flow (see TextBlock::startsAbove) -- that
+  // relies on each block's bbox being well-formed
+  blkBoxesOk = gTrue;
+  for (i = 0; i < nBlocks; ++i) {
+    blk = blocks[i];
+    if (!(blk->xMin <= blk->xMax && blk->yMin <= blk->yMax)) {
+      blkBoxesOk = gFalse;
+      break;
+    }
+  }
+  gfree(blkLo);
+  gfree(blkHi);
 
 #if 0 // for debugging
   printf("*** blocks, after yx sort ***\n");
@@ -3179,7 +4188,7 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
     blk->next = NULL;
 
     // create a new flow, starting with the upper-left-most block
-    flow = new TextFlow(this, blk);
+    flow = new(arena) TextFlow(this, blk);
     if (lastFlow) {
       lastFlow->next = flow;
     } else {
@@ -3200,7 +4209,25 @@ void TextPage::coalesce(GBool physLayout, double fixedPitch, GBool doHTML) {
       blkSpace = maxBlockSpacing * blkStack->lines->words->fontSize;
       blk = NULL;
       i = -1;
-      for (j = firstBlkIdx; j < nBlocks; ++j) {
+      j = firstBlkIdx;
+      if (blkBoxesOk && blkStack->rot == primaryRot && blkSpace >= 0) {
+	// binary search for the first block which doesn't start above
+	// blkStack (blocks are in yx order)
+	lo = 0;
+	hi = nBlocks;
+	while (lo < hi) {
+	  mid = (lo + hi) / 2;
+	  if (blocks[mid]->startsAbove(blkStack)) {
+	    lo = mid + 1;
+	  } else {
+	    hi = mid;
+	  }
+	}
+	if (lo > j) {
+	  j = lo;
+	}
+      }
+      for (; j < nBlocks; ++j) {
 	blk1 = blkArray[j];
 	if (blk1) {
 	  if (blkStack->secondaryDelta(blk1) > blkSpace) {
@@ -3526,19 +4553,7 @@ GString *TextPage::getText(double xMin, double yMin,
   }
   isUnicode = uMap->isUnicode();
   spaceLen = uMap->mapUnicode(0x20, space, sizeof(space));
-  eolLen = 0; // make gcc happy
-  switch (globalParams->getTextEOL()) {
-  case eolUnix:
-    eolLen = uMap->mapUnicode(0x0a, eol, sizeof(eol));
-    break;
-  case eolDOS:
-    eolLen = uMap->mapUnicode(0x0d, eol, sizeof(eol));
-    eolLen += uMap->mapUnicode(0x0a, eol + eolLen, sizeof(eol) - eolLen);
-    break;
-  case eolMac:
-    eolLen = uMap->mapUnicode(0x0d, eol, sizeof(eol));
-    break;
-  }
+  eolLen = mapEOL(uMap, eol, sizeof(eol));
 
   //~ writing mode (horiz/vert)
 
@@ -3819,6 +4834,10 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
   TextWord *word;
   int nFrags, fragsSize;
   TextLineFrag *frag;
+  TextPageLine *pageLines;
+  frag_listener *fragListener;
+  GBool usePageWords;
+  TextRawStream rawStream;
   char space[8], eol[16], eop[8];
   int spaceLen, eolLen, eopLen;
   GBool pageBreaks;
@@ -3831,19 +4850,7 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
     return;
   }
   spaceLen = uMap->mapUnicode(0x20, space, sizeof(space));
-  eolLen = 0; // make gcc happy
-  switch (globalParams->getTextEOL()) {
-  case eolUnix:
-    eolLen = uMap->mapUnicode(0x0a, eol, sizeof(eol));
-    break;
-  case eolDOS:
-    eolLen = uMap->mapUnicode(0x0d, eol, sizeof(eol));
-    eolLen += uMap->mapUnicode(0x0a, eol + eolLen, sizeof(eol) - eolLen);
-    break;
-  case eolMac:
-    eolLen = uMap->mapUnicode(0x0d, eol, sizeof(eol));
-    break;
-  }
+  eolLen = mapEOL(uMap, eol, sizeof(eol));
   eopLen = uMap->mapUnicode(0x0c, eop, sizeof(eop));
   pageBreaks = globalParams->getTextPageBreaks();
 
@@ -3852,31 +4859,20 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
   // output the page in raw (content stream) order
   if (rawOrder) {
 
-    for (word = rawWords; word; word = word->next) {
-      s = new GString();
-      dumpFragment(word->text, word->len, uMap, s, primaryLR);
-      (*outputFunc)(outputStream, s->getCString(), s->getLength());
-      // jm
-      if (listener)
-        listener->line(word, s->getCString(), s->getLength());
-      delete s;
-      if (word->next &&
-	  fabs(word->next->base - word->base) <
-	    maxIntraLineDelta * word->fontSize &&
-	  word->next->xMin >
-	    word->xMax - minDupBreakOverlap * word->fontSize) {
-	if (word->next->xMin > word->xMax + minWordSpacing * word->fontSize) {
-	  (*outputFunc)(outputStream, space, spaceLen);
-    // jm
-    if (listener)
-      listener->space( spaceLen );
-	}
-      } else {
-	(*outputFunc)(outputStream, eol, eolLen);
-    // jm
-    if (listener)
-      listener->end_line( eolLen );
+    // if the page was streamed, all but the end-of-line after the
+    // last word has already been written
+    if (stream) {
+      if (rawLastWord) {
+	writeRawSep(stream, rawLastWord, NULL);
+      }
+      endStream();
+    } else {
+      initRawStream(&rawStream, outputStream, outputFunc, listener, uMap);
+      for (word = rawWords; word; word = word->next) {
+	writeRawWord(&rawStream, word);
+	writeRawSep(&rawStream, word, word->next);
       }
+      delete rawStream.s;
     }
 
   // output the page, maintaining the original physical layout
@@ -3911,6 +4907,17 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
       i = j;
     }
 
+    // a listener which takes the whole page at once gets the
+    // fragments' words after they have all been written
+    usePageWords = listener && listener->use_page_words();
+    if (usePageWords) {
+      pageLines = (TextPageLine *)arena->allocn(nFrags, sizeof(TextPageLine));
+      fragListener = NULL;
+    } else {
+      pageLines = NULL;
+      fragListener = listener;
+    }
+
 #if 0 // for debugging
     printf("*** line fragments ***\n");
     for (i = 0; i < nFrags; ++i) {
@@ -3929,13 +4936,17 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
     col = 0;
     for (i = 0; i < nFrags; ++i) {
       frag = &frags[i];
+      if (usePageWords) {
+	pageLines[i].nSpaces = frag->col > col ? frag->col - col : 0;
+	pageLines[i].nEols = 0;
+      }
 
       // column alignment
       for (; col < frag->col; ++col) {
 	(*outputFunc)(outputStream, space, spaceLen);
       // jm
-      if (listener)
-        listener->space(spaceLen);
+      if (fragListener)
+        fragListener->space(spaceLen);
 
       }
 
@@ -3944,8 +4955,11 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
       col += dumpFragment(frag->line->text + frag->start, frag->len, uMap, s, primaryLR);
       (*outputFunc)(outputStream, s->getCString(), s->getLength());
       // jm
-      if (listener)
-        listener->line(frag, s->getCString(), s->getLength());
+      if (fragListener)
+        fragListener->line(frag, s->getCString(), s->getLength());
+      if (usePageWords) {
+	pageLines[i].textLen = s->getLength();
+      }
 
       delete s;
 
@@ -3965,17 +4979,24 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
 	} else {
 	  d = 1;
 	}
+	if (usePageWords) {
+	  pageLines[i].nEols = d;
+	}
 	for (; d > 0; --d) {
 	  (*outputFunc)(outputStream, eol, eolLen);
       // jm
-      if (listener)
-        listener->end_line(eolLen);
+      if (fragListener)
+        fragListener->end_line(eolLen);
 
 	}
 	col = 0;
       }
     }
 
+    if (usePageWords) {
+      listener->page_words(makePageWords(frags, pageLines, nFrags, uMap));
+    }
+
     gfree(frags);
 
   // output the page, "undoing" the layout
@@ -4045,6 +5066,116 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
   uMap->decRefCnt();
 }
 
+// Fill in the rest of <lines> (one per fragment -- the spaces, text
+// length, and end-of-lines are set by dump), and build the page's
+// word arrays.
+TextPageWords *TextPage::makePageWords(TextLineFrag *frags,
+				       TextPageLine *lines, int nFrags,
+				       UnicodeMap *uMap) {
+  TextPageWords *words;
+  TextPageLine *pageLine;
+  TextLine *line;
+  TextWord *word;
+  TextFontInfo *font, *lastFont;
+  char buf[8];
+  int nWords, textLen, lastFontIdx, i, j, k, n;
+
+  // count the words and the text bytes
+  nWords = 0;
+  textLen = 0;
+  for (i = 0; i < nFrags; ++i) {
+    line = frags[i].line;
+    pageLine = &lines[i];
+    pageLine->firstWord = nWords;
+    for (word = line->words; word; word = word->next) {
+      for (j = 0; j < word->len; ++j) {
+	textLen += uMap->mapUnicode(word->text[j], buf, sizeof(buf));
+      }
+      ++textLen;
+      ++nWords;
+    }
+    pageLine->nWords = nWords - pageLine->firstWord;
+    pageLine->xMin = line->xMin;
+    pageLine->yMin = line->yMin;
+    pageLine->xMax = line->xMax;
+    pageLine->yMax = line->yMax;
+    pageLine->fragXMin = frags[i].xMin;
+    pageLine->fragYMin = frags[i].yMin;
+    pageLine->fragXMax = frags[i].xMax;
+    pageLine->fragYMax = frags[i].yMax;
+  }
+
+  words = (TextPageWords *)arena->alloc(sizeof(TextPageWords));
+  words->nWords = nWords;
+  words->text = (char *)arena->allocn(textLen, 1);
+  words->textStart = (int *)arena->allocn(nWords + 1, sizeof(int));
+  words->xMin = (double *)arena->allocn(nWords, sizeof(double));
+  words->yMin = (double *)arena->allocn(nWords, sizeof(double));
+  words->xMax = (double *)arena->allocn(nWords, sizeof(double));
+  words->yMax = (double *)arena->allocn(nWords, sizeof(double));
+  words->base = (double *)arena->allocn(nWords, sizeof(double));
+  words->fontSize = (double *)arena->allocn(nWords, sizeof(double));
+  words->font = (int *)arena->allocn(nWords, sizeof(int));
+  words->flags = (int *)arena->allocn(nWords, sizeof(int));
+  words->nLines = nFrags;
+  words->lines = lines;
+
+  // the font table is the page's font list
+  words->nFonts = fonts->getLength();
+  words->fontName = (GString **)arena->allocn(words->nFonts,
+					      sizeof(GString *));
+  words->fontType = (GfxFontType *)arena->allocn(words->nFonts,
+						 sizeof(GfxFontType));
+  for (i = 0; i < words->nFonts; ++i) {
+    font = (TextFontInfo *)fonts->get(i);
+    words->fontName[i] = font->fontName;
+    words->fontType[i] = font->type();
+  }
+
+  // fill in the words
+  lastFont = NULL;
+  lastFontIdx = -1;
+  k = 0;
+  textLen = 0;
+  for (i = 0; i < nFrags; ++i) {
+    for (word = frags[i].line->words; word; word = word->next) {
+      words->textStart[k] = textLen;
+      for (j = 0; j < word->len; ++j) {
+	n = uMap->mapUnicode(word->text[j], buf, sizeof(buf));
+	memcpy(words->text + textLen, buf, n);
+	textLen += n;
+      }
+      words->text[textLen++] = '\0';
+      words->xMin[k] = word->xMin;
+      words->yMin[k] = word->yMin;
+      words->xMax[k] = word->xMax;
+      words->yMax[k] = word->yMax;
+      words->base[k] = word->base;
+      words->fontSize[k] = word->fontSize;
+      if (word->font != lastFont) {
+	lastFont = word->font;
+	for (lastFontIdx = words->nFonts - 1;
+	     lastFontIdx >= 0 && fonts->get(lastFontIdx) != lastFont;
+	     --lastFontIdx) ;
+      }
+      words->font[k] = lastFontIdx;
+      words->flags[k] = (word->underlined ? textWordUnderlined : 0) |
+			(word->spaceAfter ? textWordSpaceAfter : 0);
+      if ((font = word->font)) {
+	words->flags[k] |= (font->isFixedWidth() ? textWordFixedWidth : 0) |
+			   (font->isSerif() ? textWordSerif : 0) |
+			   (font->isSymbolic() ? textWordSymbolic : 0) |
+			   (font->isItalic() ? textWordItalic : 0) |
+			   (font->isBold() ? textWordBold : 0);
+      }
+      ++k;
+    }
+  }
+  words->textStart[nWords] = textLen;
+
+  return words;
+}
+
 void TextPage::assignColumns(TextLineFrag *frags, int nFrags, GBool oneRot) {
   TextLineFrag *frag0, *frag1;
   int rot, col1, col2, i, j, k;
@@ -4156,12 +5287,12 @@ static void outputToFile(void *stream, const char *text, int len) {
 TextOutputDev::TextOutputDev(char *fileName, GBool physLayoutA,
 			     double fixedPitchA, GBool rawOrderA,
 			     GBool append) : listener_(NULL) {
-  UnicodeMapAccent::initialise();
   text = NULL;
   physLayout = physLayoutA;
   fixedPitch = physLayout ? fixedPitchA : 0;
   rawOrder = rawOrderA;
   doHTML = gFalse;
+  formCache = NULL;
   ok = gTrue;
 
   // open file
@@ -4192,7 +5323,6 @@ TextOutputDev::TextOutputDev(char *fileName, GBool physLayoutA,
 TextOutputDev::TextOutputDev(TextOutputFunc func, void *stream,
 			     GBool physLayoutA, double fixedPitchA,
 			     GBool rawOrderA) : listener_(NULL) {
-  UnicodeMapAccent::initialise();
   outputFunc = func;
   outputStream = stream;
   needClose = gFalse;
@@ -4200,6 +5330,7 @@ TextOutputDev::TextOutputDev(TextOutputFunc func, void *stream,
   fixedPitch = physLayout ? fixedPitchA : 0;
   rawOrder = rawOrderA;
   doHTML = gFalse;
+  formCache = NULL;
   text = new TextPage(rawOrderA);
   ok = gTrue;
 }
@@ -4214,10 +5345,17 @@ TextOutputDev::~TextOutputDev() {
   if (text) {
     delete text;
   }
+  if (formCache) {
+    delete formCache;
+  }
 }
 
 void TextOutputDev::startPage(int pageNum, GfxState *state) {
   text->startPage(state);
+  if (rawOrder && outputStream &&
+      this->listener_ && this->listener_->stream_raw_words()) {
+    text->startStream(outputStream, outputFunc, this->listener_);
+  }
   if (this->listener_)
     this->listener_->start_page( pageNum, state );
 }
@@ -4410,6 +5548,151 @@ void TextOutputDev::processLink(Link *link) {
   text->addLink(xMin, yMin, xMax, yMax, link);
 }
 
+GBool TextOutputDev::replayForm(GfxState *state, XRef *xref, Ref id,
+				int *inheritedParams) {
+  TextFormEntry *entry;
+  TextFormRecord *rec;
+  TextFormChar *fc;
+  TextFormFont *ff;
+  TextFormImage *img;
+  TextDevChar ch;
+  std::vector<int> fontMap;
+  std::vector<Unicode> u;
+  double dx, dy;
+  size_t i;
+
+  // the chars of an "ActualText" span are not added one by one
+  if (!formCache || text->actualText) {
+    return gFalse;
+  }
+  formCache->setDoc(xref);
+  if (!(entry = formCache->getEntry(id, gFalse))) {
+    return gFalse;
+  }
+  rec = NULL;
+  for (i = 0; i < entry->records.size(); ++i) {
+    if (entry->records[i]->matches(state)) {
+      rec = entry->records[i];
+      break;
+    }
+  }
+  if (!rec) {
+    return gFalse;
+  }
+
+  dx = state->getCTM()[4] - rec->ctm[4];
+  dy = state->getCTM()[5] - rec->ctm[5];
+  fontMap.resize(rec->snaps.size(), -1);
+  for (i = 0; i < rec->ops.size(); ++i) {
+    switch (rec->ops[i].kind) {
+    case textFormChar:
+      fc = &rec->chars[rec->ops[i].idx];
+      ch = fc->ch;
+      ch.x += dx;
+      ch.y += dy;
+      ch.xr += dx;
+      ch.yr += dy;
+      // addDevChar may modify the text
+      u.assign(rec->u.begin() + fc->uIdx,
+	       rec->u.begin() + fc->uIdx + fc->uStored);
+      if (u.size() < 3) {
+	u.resize(3, 0);
+      }
+      text->addDevChar(&ch, &u[0], fc->uLen);
+      break;
+    case textFormFont:
+      // the form's fonts are added to the page the first time they
+      // are used, as if the form was interpreted
+      ff = &rec->fonts[rec->ops[i].idx];
+      if (fontMap[ff->snapIdx] < 0) {
+	fontMap[ff->snapIdx] = text->fonts->getLength();
+	text->fonts->append(new TextFontInfo(rec->snaps[ff->snapIdx]));
+      }
+      text->curFont = (TextFontInfo *)text->fonts->get(fontMap[ff->snapIdx]);
+      text->curFontSize = ff->fontSize;
+      if (text->records) {
+	text->fontChanged(fontMap[ff->snapIdx]);
+      }
+      break;
+    case textFormCharCount:
+      text->incCharCount(rec->ops[i].idx);
+      break;
+    case textFormImage:
+      img = &rec->images[rec->ops[i].idx];
+      addImage(img->x, img->y, img->w, img->h, img->inlineImg);
+      break;
+    }
+  }
+
+  // same as restoring the state after the form
+  text->updateFont(state);
+
+  *inheritedParams = rec->inheritedParams;
+  ++formCache->nReplays;
+  return gTrue;
+}
+
+GBool TextOutputDev::beginFormRecord(GfxState *state, XRef *xref,
+				     Ref id) {
+  TextFormEntry *entry;
+
+  if (!formCache || text->actualText) {
+    return gFalse;
+  }
+  formCache->setDoc(xref);
+  entry = formCache->getEntry(id, gTrue);
+  if (++entry->nDraws < formCacheMinDraws ||
+      entry->nFailures >= formCacheMaxFailures ||
+      (int)entry->records.size() >= formCacheMaxVariants ||
+      formCache->bytes >= formCacheMaxBytes) {
+    return gFalse;
+  }
+  text->startRecord(new TextFormRecord(id, text->fonts->getLength()));
+  return gTrue;
+}
+
+void TextOutputDev::endFormRecord(GfxState *state, GBool replayable,
+				  int inheritedParams) {
+  TextFormRecord *rec;
+  TextFormEntry *entry;
+
+  rec = text->records;
+  text->stopRecord(rec);
+  entry = formCache->getEntry(rec->id, gTrue);
+
+  // the form's own font and text matrix are in the record, inherited
+  // ones would have to be compared char by char
+  if (!replayable || rec->failed || text->actualText ||
+      (inheritedParams & (gfxTextFont | gfxTextMatrix))) {
+    delete rec;
+    ++entry->nFailures;
+    return;
+  }
+  rec->setKey(state, inheritedParams);
+  entry->records.push_back(rec);
+  formCache->bytes += rec->getBytes();
+  ++formCache->nRecords;
+}
+
+void TextOutputDev::enableFormCache(GBool on) {
+  if (formCache) {
+    delete formCache;
+  }
+  formCache = on ? new TextFormCache() : (TextFormCache *)NULL;
+}
+
+void TextOutputDev::startDoc(XRef *xrefA) {
+  if (formCache) {
+    formCache->clear();
+    formCache->setDoc(xrefA);
+  }
+}
+
+void TextOutputDev::getFormCacheStats(int *nRecords, int *nReplays) {
+  *nRecords = formCache ? formCache->nRecords : 0;
+  *nReplays = formCache ? formCache->nReplays : 0;
+}
+
 GBool TextOutputDev::findText(Unicode *s, int len,
 			      GBool startAtTop, GBool stopAtBottom,
 			      GBool startAtLast, GBool stopAtLast,
@@ -4451,12 +5734,23 @@ void TextOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
                           int width, int height, GfxImageColorMap *colorMap,
                           int *maskColors, GBool inlineImg, GBool interpolate)
 {
+    addImage(
+        static_cast<int>(state->getCurX()), 
+        static_cast<int>(state->getCurY()), 
+        width, height, inlineImg);
+    OutputDev::drawImage(state, ref, str, width, height, colorMap, maskColors, inlineImg, interpolate);
+}
+
+void TextOutputDev::addImage(int x, int y, int w, int h, GBool inlineImg)
+{
+    TextFormRecord* rec;
+
+    for (rec = text->records; rec; rec = rec->next)
+    {
+        rec->addImage(x, y, w, h, inlineImg);
+    }
     if (this->listener_)
     {
-        this->listener_->image(
-            static_cast<int>(state->getCurX()), 
-            static_cast<int>(state->getCurY()), 
-            width, height, (gTrue == inlineImg));
+        this->listener_->image(x, y, w, h, (gTrue == inlineImg));
     }
-    OutputDev::drawImage(state, ref, str, width, height, colorMap, maskColors, inlineImg, interpolate);
 }
\ No newline at end of file
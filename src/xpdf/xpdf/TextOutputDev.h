@@ -30,6 +30,7 @@ class GfxState;
 class UnicodeMap;
 class Link;
 
+class TextArena;
 class TextWord;
 class TextPool;
 class TextLine;
@@ -37,12 +38,60 @@ class TextLineFrag;
 class TextBlock;
 class TextFlow;
 class TextWordList;
+struct TextPageWords;
+struct TextRawStream;
 class TextPage;
 
 //------------------------------------------------------------------------
 
 typedef void (*TextOutputFunc)(void *stream, const char *text, int len);
 
+//------------------------------------------------------------------------
+// TextArena
+//------------------------------------------------------------------------
+
+// Memory for a page's text layout objects (TextWord, TextLine,
+// TextBlock, TextFlow) and their per-char arrays.  Allocation is a
+// pointer bump; nothing is freed until reset() is called, when the
+// page is cleared.
+class TextArena {
+public:
+
+  TextArena();
+  ~TextArena();
+
+  // Allocate <size> bytes, aligned for any of the text layout types.
+  void *alloc(int size);
+
+  // Allocate an array of <nObjs> objects of <objSize> bytes each.
+  void *allocn(int nObjs, int objSize);
+
+  // Free everything.  The first chunk allocated after this is sized
+  // to hold everything that was allocated before it, so a page
+  // similar to the previous one needs a single chunk.
+  void reset();
+
+  // Stats since the last reset.
+  int getNumAllocs() { return nAllocs; }
+  int getUsedBytes() { return usedBytes; }
+  int getNumChunkAllocs() { return nChunkAllocs; }
+  int getChunkBytes() { return chunkBytes; }
+
+private:
+
+  void newChunk(int minSize);
+
+  struct TextArenaChunk *chunks; // list of chunks, newest first
+  char *cur;			// free space in the newest chunk
+  char *end;
+  int nextChunkSize;		// size of the next chunk to allocate
+  int nAllocs;			// number of alloc calls
+  int usedBytes;		// number of bytes allocated (including
+				//   alignment padding)
+  int nChunkAllocs;		// number of chunks allocated
+  int chunkBytes;		// total size of the current chunks
+};
+
 //------------------------------------------------------------------------
 // TextFontInfo
 //------------------------------------------------------------------------
@@ -51,6 +100,12 @@ class TextFontInfo {
 public:
 
   TextFontInfo(GfxState *state);
+
+  // Make a copy of <info> which is not tied to a GfxFont (and never
+  // matches a state), for text which is replayed after the font is
+  // gone (see TextOutputDev::replayForm).
+  TextFontInfo(TextFontInfo *info);
+
   ~TextFontInfo();
 
   GBool matches(GfxState *state);
@@ -64,12 +119,22 @@ public:
   GBool isSymbolic() { return flags & fontSymbolic; }
   GBool isItalic() { return flags & fontItalic; }
   GBool isBold() { return flags & fontBold; }
-  GfxFontType type() { return (gfxFont) ? gfxFont->getType() : GfxFontType::fontUnknownType; }
+  GfxFontType type() { return gfxFont ? gfxFont->getType() : fontType; }
 private:
 
-  GfxFont *gfxFont;
+  int getWMode() { return gfxFont ? gfxFont->getWMode() : wMode; }
+  double getAscent() { return gfxFont ? gfxFont->getAscent() : ascent; }
+  double getDescent() { return gfxFont ? gfxFont->getDescent() : descent; }
+  Ref getEmbFontID();
+
+  GfxFont *gfxFont;		// NULL for detached copies
+  GBool detached;
   GString *fontName;
   int flags;
+  GfxFontType fontType;		// type, writing mode, metrics, and
+  int wMode;			//   embedded font ID -- used if gfxFont
+  double ascent, descent;	//   is NULL
+  Ref embFontID;
 
   friend class TextWord;
   friend class TextPage;
@@ -82,20 +147,26 @@ private:
 class TextWord {
 public:
 
-  // Constructor.
-  TextWord(GfxState *state, int rotA, double x0, double y0,
-	   TextFontInfo *fontA, double fontSize);
+  // Allocated from the page's arena.  Delete runs the destructor;
+  // the memory is reused when the arena is reset.
+  void *operator new(size_t size, TextArena *arena)
+    { return arena->alloc((int)size); }
+  void operator delete(void *p, TextArena *arena) {}
+  void operator delete(void *p) {}
 
-  // Destructor.
-  ~TextWord();
+  // Constructor.
+  TextWord(int rotA, double x, double y,
+	   TextFontInfo *fontA, double fontSize,
+	   double colorRA, double colorGA, double colorBA);
 
-  // Add a character to the word.
-  void addChar(GfxState *state, double x, double y,
+  // Add a character to the word.  The char arrays are allocated from
+  // <arena>.
+  void addChar(TextArena *arena, double x, double y,
 	       double dx, double dy, int charPosA, int charLen,
 	       Unicode u);
 
   // Merge <word> onto the end of <this>.
-  void merge(TextWord *word);
+  void merge(TextArena *arena, TextWord *word);
 
   // Compares <this> to <word>, returning -1 (<), 0 (=), or +1 (>),
   // based on a primary-axis comparison, e.g., x ordering if rot=0.
@@ -135,6 +206,8 @@ public:
 
 private:
 
+  void setSize(TextArena *arena, int sizeA);
+
   int rot;			// rotation, multiple of 90 degrees
 				//   (0, 1, 2, or 3)
   double xMin, xMax;		// bounding box x coordinates
@@ -208,6 +281,12 @@ private:
 class TextLine {
 public:
 
+  // Allocated from the page's arena (see TextWord).
+  void *operator new(size_t size, TextArena *arena)
+    { return arena->alloc((int)size); }
+  void operator delete(void *p, TextArena *arena) {}
+  void operator delete(void *p) {}
+
   TextLine(TextBlock *blkA, int rotA, double baseA);
   ~TextLine();
 
@@ -284,6 +363,12 @@ private:
 class TextBlock {
 public:
 
+  // Allocated from the page's arena (see TextWord).
+  void *operator new(size_t size, TextArena *arena)
+    { return arena->alloc((int)size); }
+  void operator delete(void *p, TextArena *arena) {}
+  void operator delete(void *p) {}
+
   TextBlock(TextPage *pageA, int rotA);
   ~TextBlock();
 
@@ -306,6 +391,13 @@ public:
   // primary rotation.
   GBool isBelow(TextBlock *blk);
 
+  // Returns true if <this> starts far enough above <blk> that it is
+  // not below <blk> (see isBelow), and <blk>->secondaryDelta(this) is
+  // not positive.  This is true for a prefix of any list of blocks
+  // in yx order.  Both blocks must have well-formed bboxes, and <blk>
+  // must have the page's primary rotation.
+  GBool startsAbove(TextBlock *blk);
+
   // Get the head of the linked list of TextLines.
   TextLine *getLines() { return lines; }
 
@@ -314,6 +406,12 @@ public:
 
 private:
 
+  // Returns true if <word> starts beyond the far edge of this block,
+  // plus <slack>, along the primary axis.  Pool buckets are sorted
+  // along the primary axis, so this is also true for every word after
+  // <word> in its bucket.
+  GBool isPast(TextWord *word, double slack);
+
   TextPage *page;		// the parent page
   int rot;			// text rotation
   double xMin, xMax;		// bounding box x coordinates
@@ -372,6 +470,12 @@ public:
 class TextFlow {
 public:
 
+  // Allocated from the page's arena (see TextWord).
+  void *operator new(size_t size, TextArena *arena)
+    { return arena->alloc((int)size); }
+  void operator delete(void *p, TextArena *arena) {}
+  void operator delete(void *p) {}
+
   TextFlow(TextPage *pageA, TextBlock *blk);
   ~TextFlow();
 
@@ -432,6 +536,57 @@ private:
 };
 
 
+//------------------------------------------------------------------------
+// TextPageWords
+//------------------------------------------------------------------------
+
+// TextPageWords::flags bits.
+#define textWordUnderlined 0x01
+#define textWordSpaceAfter 0x02
+#define textWordFixedWidth 0x04
+#define textWordSerif      0x08
+#define textWordSymbolic   0x10
+#define textWordItalic     0x20
+#define textWordBold       0x40
+
+// A line fragment of a TextPageWords page: the words [firstWord,
+// firstWord + nWords), and what TextPage::dump wrote around the
+// fragment's text.
+struct TextPageLine {
+  int firstWord;
+  int nWords;
+  double xMin, yMin, xMax, yMax;	// bounding box of the line
+  double fragXMin, fragYMin,	// bounding box of the fragment
+         fragXMax, fragYMax;
+  int nSpaces;			// spaces written before the fragment
+  int textLen;			// length of the fragment's text
+  int nEols;			// end-of-lines written after the fragment
+};
+
+// All the words on a page, in output order, as parallel arrays (see
+// frag_listener::page_words).  The arrays are allocated from the
+// page's arena, and are valid until the page is cleared.
+struct TextPageWords {
+  int nWords;
+  char *text;			// text of each word, in the output
+				//   encoding, NUL-terminated
+  int *textStart;		// offset of each word's text in <text>
+				//   [nWords + 1]
+  double *xMin, *yMin,		// bounding boxes
+         *xMax, *yMax;
+  double *base;			// baselines
+  double *fontSize;		// font sizes
+  int *font;			// index into the font table, or -1
+  int *flags;			// textWord* flags
+
+  int nFonts;			// font table:
+  GString **fontName;		//   names (entries may be NULL)
+  GfxFontType *fontType;	//   types
+
+  int nLines;
+  TextPageLine *lines;		// line fragments [nLines]
+};
+
 // jm
 //
 //
@@ -449,10 +604,49 @@ struct frag_listener {
   virtual void line( TextLine*, const char *, size_t ) {};
   virtual void line(TextLineFrag*, const char *, size_t) {};
 
+  // If this returns true, the physical layout dump delivers all of a
+  // page's words in one page_words() call (just before end_page)
+  // instead of calling line(), space(), and end_line() for each
+  // fragment.  The raw order and reading order dumps always use the
+  // per-line calls.
+  virtual bool use_page_words() { return false; }
+  virtual void page_words(TextPageWords *words) {};
+
+  // If this returns true, the raw order dump is streamed (see
+  // TextPage::startStream): line(TextWord*), space(), and end_line()
+  // are called for each word as soon as it is finished, while the
+  // page is still being drawn, rather than at the end of the page.
+  virtual bool stream_raw_words() { return false; }
+
   virtual void image(int x, int y, int w, int h, bool inlineImg) {};
 };
 
 
+//------------------------------------------------------------------------
+// TextDevChar
+//------------------------------------------------------------------------
+
+// A char in device space, as added to a TextPage.
+struct TextDevChar {
+  double x, y;			// start
+  double w, h;			// advance, without char and word spacing
+  double xr, yr;		// start of the word if the char is drawn
+				//   backwards (i.e., its end)
+  int rot;			// rotation of a word started by the char
+  double colorR,		// color of a word started by the char
+         colorG,
+         colorB;
+  int nBytes;			// length of the char code
+  GfxState *state;		// if non-NULL, xr/yr, rot and the color
+				//   are not computed yet -- they are taken
+				//   from this state, and from tx/ty (the
+				//   char end in text space), when needed
+  double tx, ty;
+};
+
+class TextFormRecord;
+class TextFormCache;
+
 //------------------------------------------------------------------------
 // TextPage
 //------------------------------------------------------------------------
@@ -475,14 +669,19 @@ public:
   // Update the current font.
   void updateFont(GfxState *state);
 
-  // Begin a new word.
-  void beginWord(GfxState *state, double x0, double y0);
+  // Begin a new word, starting with char <ch> (at its end if
+  // <backward> is set).
+  void beginWord(TextDevChar *ch, GBool backward);
 
   // Add a character to the current word.
   void addChar(GfxState *state, double x, double y,
 	       double dx, double dy,
 	       CharCode c, int nBytes, Unicode *u, int uLen);
 
+  // Add a character which is already in device space.  <u> may be
+  // modified.
+  void addDevChar(TextDevChar *ch, Unicode *u, int uLen);
+
   // Add <nChars> invisible characters.
   void incCharCount(int nChars);
 
@@ -537,6 +736,15 @@ public:
   void dump(void *outputStream, TextOutputFunc outputFunc,
     GBool physLayout, frag_listener*);
 
+  // Write the page's words as they are added, instead of in dump:
+  // each word's text goes to <outputFunc> and <listener> as soon as
+  // the word is finished, and dump only ends the page.  The output is
+  // the same as dump's.  Only works if this->rawOrder is true -- in
+  // that case there is no layout analysis to wait for.  Must be
+  // called after startPage.
+  void startStream(void *outputStream, TextOutputFunc outputFunc,
+		   frag_listener *listener);
+
   // Get the head of the linked list of TextFlows.
   TextFlow *getFlows() { return flows; }
 
@@ -546,10 +754,27 @@ public:
   // flags are false).
   TextWordList *makeWordList(GBool physLayout);
 
+  // Get the arena holding this page's text layout objects (e.g., for
+  // allocation stats).
+  TextArena *getArena() { return arena; }
+
+  // Get the number of untranslatable chars mapped to private use
+  // unicodes so far, on this and the previous pages.
+  size_t getNumInvalidUnicodes() { return accentCtx.invalid_lookups(); }
+
 private:
 
   void clear();
+  void resolveDevChar(TextDevChar *ch);
+  void startRecord(TextFormRecord *rec);
+  void stopRecord(TextFormRecord *rec);
+  void fontChanged(int fontIdx);
+  void endStream();
+  void writeRawWord(TextRawStream *st, TextWord *word);
+  void writeRawSep(TextRawStream *st, TextWord *word, TextWord *next);
   void assignColumns(TextLineFrag *frags, int nFrags, int rot);
+  TextPageWords *makePageWords(TextLineFrag *frags, TextPageLine *lines,
+			       int nFrags, UnicodeMap *uMap);
 
   GBool rawOrder;		// keep text in content stream order
 
@@ -581,6 +806,8 @@ private:
   TextWord *rawWords;		// list of words, in raw order (only if
 				//   rawOrder is set)
   TextWord *rawLastWord;	// last word on rawWords list
+  TextRawStream *stream;	// where words are written as they are
+				//   added (if rawOrder is set), or NULL
 
   GList *fonts;			// all font info objects used on this
 				//   page [TextFontInfo]
@@ -592,6 +819,15 @@ private:
   GList *underlines;		// [TextUnderline]
   GList *links;			// [TextLink]
 
+  TextArena *arena;		// memory for words, lines, blocks, and
+				//   flows
+
+  accented::context accentCtx;	// accent merging state, carried from
+				//   one char (and page) to the next
+
+  TextFormRecord *records;	// form records being made, innermost
+				//   first (see TextOutputDev::beginFormRecord)
+
   std::list<std::string> dbg_;
 
   friend class TextLine;
@@ -599,6 +835,8 @@ private:
   friend class TextBlock;
   friend class TextFlow;
   friend class TextWordList;
+  friend class TextFormRecord;
+  friend class TextOutputDev;
 };
 
 //------------------------------------------------------------------------
@@ -671,6 +909,9 @@ public:
   // non-shown layers?
   virtual GBool needCharCount() { return gTrue; }
 
+  // Does this device replay the text of repeated form XObjects?
+  virtual GBool useFormCache() { return formCache && !doHTML; }
+
   //----- initialization and control
 
   // Start a page.
@@ -704,6 +945,13 @@ public:
   //----- link borders
   virtual void processLink(Link *link);
 
+  //----- form XObjects
+  virtual GBool replayForm(GfxState *state, XRef *xref, Ref id,
+			   int *inheritedParams);
+  virtual GBool beginFormRecord(GfxState *state, XRef *xref, Ref id);
+  virtual void endFormRecord(GfxState *state, GBool replayable,
+			     int inheritedParams);
+
   //----- special access
 
   // Find a string.  If <startAtTop> is true, starts looking at the
@@ -742,9 +990,31 @@ public:
   // transferring ownership to the caller.
   TextPage *takeText();
 
+  // Get the arena for the current page's text layout objects.
+  TextArena *getTextArena() { return text->getArena(); }
+
+  // Get the number of untranslatable chars mapped so far (see
+  // TextPage::getNumInvalidUnicodes).
+  size_t getNumInvalidUnicodes() { return text->getNumInvalidUnicodes(); }
+
   // Turn extra processing for HTML conversion on or off.
   void enableHTMLExtras(GBool doHTMLA) { doHTML = doHTMLA; }
 
+  // Turn the form XObject cache on or off (it is off by default).
+  // Form XObjects drawn more than once have their text recorded, and
+  // it is replayed when the form is drawn again in the same position
+  // (up to a translation) and text state.  The records are dropped
+  // when a form of another document is drawn.
+  void enableFormCache(GBool on);
+
+  // Start a document: drops the form records of the previous one,
+  // also if the new document got the address of the old XRef.
+  void startDoc(XRef *xrefA);
+
+  // Get the form cache stats: number of form records kept and number
+  // of times a form was replayed.
+  void getFormCacheStats(int *nRecords, int *nReplays);
+
   virtual void drawImage(GfxState *state, Object *ref, Stream *str,
                          int width, int height, GfxImageColorMap *colorMap,
                          int *maskColors, GBool inlineImg, GBool interpolate) override;
@@ -763,7 +1033,10 @@ private:
 				//   width
   GBool rawOrder;		// keep text in content stream order
   GBool doHTML;			// extra processing for HTML conversion
+  TextFormCache *formCache;	// form XObject cache, or NULL if off
   GBool ok;			// set up ok?
+
+  void addImage(int x, int y, int w, int h, GBool inlineImg);
 };
 
 #endif
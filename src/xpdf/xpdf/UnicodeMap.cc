@@ -42,7 +42,7 @@ UnicodeMap *UnicodeMap::parse(GString *encodingNameA) {
   int size, eMapsSize;
   char buf[256];
   int line, nBytes, i, x;
-  char *tok1, *tok2, *tok3;
+  char *tok1, *tok2, *tok3, *tokPtr;
 
   if (!(f = globalParams->getUnicodeMapFile(encodingNameA))) {
     error(errSyntaxError, -1,
@@ -59,9 +59,9 @@ UnicodeMap *UnicodeMap::parse(GString *encodingNameA) {
 
   line = 1;
   while (getLine(buf, sizeof(buf), f)) {
-    if ((tok1 = strtok(buf, " \t\r\n")) &&
-	(tok2 = strtok(NULL, " \t\r\n"))) {
-      if (!(tok3 = strtok(NULL, " \t\r\n"))) {
+    if ((tok1 = strtok_r(buf, " \t\r\n", &tokPtr)) &&
+	(tok2 = strtok_r(NULL, " \t\r\n", &tokPtr))) {
+      if (!(tok3 = strtok_r(NULL, " \t\r\n", &tokPtr))) {
 	tok3 = tok2;
 	tok2 = tok1;
       }
@@ -119,9 +119,6 @@ UnicodeMap::UnicodeMap(GString *encodingNameA) {
   eMaps = NULL;
   eMapsLen = 0;
   refCnt = 1;
-#if MULTITHREADED
-  gInitMutex(&mutex);
-#endif
 }
 
 UnicodeMap::UnicodeMap(const char *encodingNameA, GBool unicodeOutA,
@@ -134,9 +131,6 @@ UnicodeMap::UnicodeMap(const char *encodingNameA, GBool unicodeOutA,
   eMaps = NULL;
   eMapsLen = 0;
   refCnt = 1;
-#if MULTITHREADED
-  gInitMutex(&mutex);
-#endif
 }
 
 UnicodeMap::UnicodeMap(const char *encodingNameA, GBool unicodeOutA,
@@ -148,9 +142,6 @@ UnicodeMap::UnicodeMap(const char *encodingNameA, GBool unicodeOutA,
   eMaps = NULL;
   eMapsLen = 0;
   refCnt = 1;
-#if MULTITHREADED
-  gInitMutex(&mutex);
-#endif
 }
 
 UnicodeMap::~UnicodeMap() {
@@ -161,18 +152,13 @@ UnicodeMap::~UnicodeMap() {
   if (eMaps) {
     gfree(eMaps);
   }
-#if MULTITHREADED
-  gDestroyMutex(&mutex);
-#endif
 }
 
 void UnicodeMap::incRefCnt() {
 #if MULTITHREADED
-  gLockMutex(&mutex);
-#endif
+  gAtomicIncrement(&refCnt);
+#else
   ++refCnt;
-#if MULTITHREADED
-  gUnlockMutex(&mutex);
 #endif
 }
 
@@ -180,11 +166,9 @@ void UnicodeMap::decRefCnt() {
   GBool done;
 
 #if MULTITHREADED
-  gLockMutex(&mutex);
-#endif
+  done = gAtomicDecrement(&refCnt) == 0;
+#else
   done = --refCnt == 0;
-#if MULTITHREADED
-  gUnlockMutex(&mutex);
 #endif
   if (done) {
     delete this;
@@ -294,3 +278,15 @@ UnicodeMap *UnicodeMapCache::getUnicodeMap(GString *encodingName) {
   }
   return NULL;
 }
+
+UnicodeMap *UnicodeMapCache::findUnicodeMap(GString *encodingName) {
+  int i;
+
+  for (i = 0; i < unicodeMapCacheSize; ++i) {
+    if (cache[i] && cache[i]->match(encodingName)) {
+      cache[i]->incRefCnt();
+      return cache[i];
+    }
+  }
+  return NULL;
+}
@@ -94,9 +94,10 @@ private:
   int len;			// (user, resident)
   UnicodeMapExt *eMaps;		// (user)
   int eMapsLen;			// (user)
-  int refCnt;
 #if MULTITHREADED
-  GMutex mutex;
+  GAtomicCounter refCnt;
+#else
+  int refCnt;
 #endif
 };
 
@@ -115,6 +116,12 @@ public:
   // caller of this function.  Returns NULL on failure.
   UnicodeMap *getUnicodeMap(GString *encodingName);
 
+  // Look up an already cached UnicodeMap for <encodingName> without
+  // parsing or reordering the cache, so it is safe to call with only
+  // a read lock held.  Increments the reference count of the
+  // returned map.  Returns NULL if it is not in the cache.
+  UnicodeMap *findUnicodeMap(GString *encodingName);
+
 private:
 
   UnicodeMap *cache[unicodeMapCacheSize];
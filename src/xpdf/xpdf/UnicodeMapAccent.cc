@@ -1,146 +1,171 @@
 #include "UnicodeMapAccent.h"
 
-const Unicode UnicodeMapAccent::acute_repr = (Unicode)180; 
-const Unicode UnicodeMapAccent::caron_repr = (Unicode)711; 
-const Unicode UnicodeMapAccent::ring_repr  = (Unicode)730; 
-const Unicode UnicodeMapAccent::diaeresis_repr = (Unicode)168; 
-const Unicode UnicodeMapAccent::circumflex_repr = (Unicode)94; 
-const Unicode UnicodeMapAccent::dotlesi_repr = (Unicode)0x131; 
-const Unicode UnicodeMapAccent::grave_repr = (Unicode)0x300; 
-const Unicode UnicodeMapAccent::cedilla_repr = (Unicode)0x327; 
+const Unicode UnicodeMapAccent::acute_repr = (Unicode)180;
+const Unicode UnicodeMapAccent::caron_repr = (Unicode)711;
+const Unicode UnicodeMapAccent::ring_repr  = (Unicode)730;
+const Unicode UnicodeMapAccent::diaeresis_repr = (Unicode)168;
+const Unicode UnicodeMapAccent::circumflex_repr = (Unicode)94;
+const Unicode UnicodeMapAccent::dotlesi_repr = (Unicode)0x131;
+const Unicode UnicodeMapAccent::grave_repr = (Unicode)0x300;
+const Unicode UnicodeMapAccent::cedilla_repr = (Unicode)0x327;
 
 namespace {
 
-	UnicodeMapAccent::unicode_map init_set() {
-		UnicodeMapAccent::unicode_map map;
+	// accent classes -- each one is normalized to its representative
+	// (the *_repr constants)
+	enum {
+		NO_ACCENT = 0,
+		ACUTE,
+		GRAVE,
+		CARON,
+		CIRCUMFLEX,
+		RING,
+		DIAERESIS,
+		CEDILLA,
+		ACCENT_CLASSES
+	};
+
+	// representative of each accent class (the constants above can not
+	// be used in constant expressions)
+	const Unicode class_repr[ACCENT_CLASSES] =
+	{ 0x20, 180, 0x300, 711, 94, 730, 168, 0x327 };
+
+	// all accents are below this, except for the right single
+	// quotation mark which is checked separately
+	const Unicode ACCENT_TABLE_SIZE = 0x340;
+	const Unicode RIGHT_QUOTE = 0x2019;
+
+	// letters are ascii or the dotless i, which is stored after them
+	const int LETTER_TABLE_SIZE = 0x81;
+	const Unicode DOTLESS_I = 0x131;
+
+	struct accent_def {
+		Unicode u;
+		unsigned char cls;
+	};
+
+	struct accented_def {
+		unsigned char cls;
+		Unicode letter;
+		Unicode mapping;
+	};
+
+	constexpr accent_def accents[] = {
 	// ´
-		map[(Unicode)180] = UnicodeMapAccent::acute_repr;
-		map[(Unicode)714] = UnicodeMapAccent::acute_repr;
-		map[(Unicode)769] = UnicodeMapAccent::acute_repr;
-		map[(Unicode)0x2019] = UnicodeMapAccent::acute_repr;
+		{ 180, ACUTE }, { 714, ACUTE }, { 769, ACUTE },
 	// `
-		map[(Unicode)0x300] = UnicodeMapAccent::grave_repr;
-		map[(Unicode)0x60] = UnicodeMapAccent::grave_repr;
+		{ 0x300, GRAVE }, { 0x60, GRAVE },
 	// ˇ
-		map[(Unicode)711] = UnicodeMapAccent::caron_repr;
-		map[(Unicode)780] = UnicodeMapAccent::caron_repr;
+		{ 711, CARON }, { 780, CARON },
 	// ^
-		map[(Unicode)136] = UnicodeMapAccent::circumflex_repr;
-		map[(Unicode)94] = UnicodeMapAccent::circumflex_repr;
-		map[(Unicode)708] = UnicodeMapAccent::circumflex_repr;
-		map[(Unicode)710] = UnicodeMapAccent::circumflex_repr;
-		map[(Unicode)770] = UnicodeMapAccent::circumflex_repr;
+		{ 136, CIRCUMFLEX }, { 94, CIRCUMFLEX }, { 708, CIRCUMFLEX },
+		{ 710, CIRCUMFLEX }, { 770, CIRCUMFLEX },
 	// ˚
-		map[(Unicode)730] = UnicodeMapAccent::ring_repr;
-		map[(Unicode)778] = UnicodeMapAccent::ring_repr;
+		{ 730, RING }, { 778, RING },
 	// ä
-		map[(Unicode)168] = UnicodeMapAccent::diaeresis_repr;
-		map[(Unicode)776] = UnicodeMapAccent::diaeresis_repr;
+		{ 168, DIAERESIS }, { 776, DIAERESIS },
     // cedilla (french c)
-		map[(Unicode)0x327] = UnicodeMapAccent::cedilla_repr;
-		map[(Unicode)0xB8] = UnicodeMapAccent::cedilla_repr;
-
-		return map;
-   }
-
-  	UnicodeMapAccent::unicode_map init_map_not_translated_accents() 
-    {
-		UnicodeMapAccent::unicode_map arr;
-	    // ´
-		arr[ UnicodeMapAccent::acute_repr ];
-        return arr;
-    }
-
-
-	  template<typename T, typename K>
-	  inline
-	  void _insert_u( T& map, K letter, K mapping ) {
-		  map.insert( std::make_pair( (Unicode)letter, (Unicode)mapping ) );
-	  }
-
-	  UnicodeMapAccent::unicode_tri_map init_map() 
-    {
-		  UnicodeMapAccent::unicode_tri_map map;
+		{ 0x327, CEDILLA }, { 0xB8, CEDILLA },
+	};
+
+	// if a letter appears twice for one accent, the first one wins
+	constexpr accented_def accented[] = {
 	  // ´ (a,e,i,o,u,y,l, dotless i, n, t )
-	  {
-		  Unicode accutes []		= 
-		  { 0x41, 0x61, 0x45, 0x65, 0x49, 0x69, 0x4F, 0x6F, 0x55, 0x75, 0x59, 0x79, 0x4C, 0x6C, 0x131,  0x4E,0x6E,   
-              0x74,0x54, };
-		  Unicode accutes_map []	= 
-		  { 0xC1, 0xE1, 0xC9, 0xE9, 0xCD, 0xED, 0xD3, 0xF3, 0xDA, 0xFA, 0xDD, 0xFD, 0x139, 0x13A, 0xED, 0x143,0x144, 
-              0x165,0x164,  };
-		  for ( size_t i = 0; i < sizeof(accutes)/sizeof(Unicode); ++i )
-			  _insert_u( map[UnicodeMapAccent::acute_repr], accutes[i], accutes_map[i] );
-	  }
+		{ ACUTE, 0x41, 0xC1 }, { ACUTE, 0x61, 0xE1 }, { ACUTE, 0x45, 0xC9 },
+		{ ACUTE, 0x65, 0xE9 }, { ACUTE, 0x49, 0xCD }, { ACUTE, 0x69, 0xED },
+		{ ACUTE, 0x4F, 0xD3 }, { ACUTE, 0x6F, 0xF3 }, { ACUTE, 0x55, 0xDA },
+		{ ACUTE, 0x75, 0xFA }, { ACUTE, 0x59, 0xDD }, { ACUTE, 0x79, 0xFD },
+		{ ACUTE, 0x4C, 0x139 }, { ACUTE, 0x6C, 0x13A }, { ACUTE, 0x131, 0xED },
+		{ ACUTE, 0x4E, 0x143 }, { ACUTE, 0x6E, 0x144 },
+		{ ACUTE, 0x74, 0x165 }, { ACUTE, 0x54, 0x164 },
 	  // ` (a,e,i,o,u,n)
-	  {
-		  Unicode accutes []		= 
-		  { 0x41, 0x61, 0x45, 0x65, 0x49, 0x69, 0x4F, 0x6F, 0x55, 0x75, };
-		  Unicode accutes_map []	= 
-		  { 0xC0, 0xE0, 0xC8, 0xE8, 0xCC, 0xEC, 0xD2, 0xF2, 0xD9, 0xF9, };
-		  for ( size_t i = 0; i < sizeof(accutes)/sizeof(Unicode); ++i )
-			  _insert_u( map[UnicodeMapAccent::grave_repr], accutes[i], accutes_map[i] );
-	  }
+		{ GRAVE, 0x41, 0xC0 }, { GRAVE, 0x61, 0xE0 }, { GRAVE, 0x45, 0xC8 },
+		{ GRAVE, 0x65, 0xE8 }, { GRAVE, 0x49, 0xCC }, { GRAVE, 0x69, 0xEC },
+		{ GRAVE, 0x4F, 0xD2 }, { GRAVE, 0x6F, 0xF2 }, { GRAVE, 0x55, 0xD9 },
+		{ GRAVE, 0x75, 0xF9 },
 	  // ˇ (c,d,n,r,s,t,z,e)
-	  {
-		  Unicode accutes []		= 
-		  { 0x43,  0x63,  0x44,  0x64,  0x4E,  0x6E,  0x52,  0x72,  0x53,  0x73,  0x54,  0x74,  0x5A,  0x7A,  0x45,  0x65,  };
-		  Unicode accutes_map []	= 
-		  { 0x10C, 0x10D, 0x10E, 0x10F, 0x147, 0x148, 0x158, 0x159, 0x160, 0x161, 0x164, 0x165, 0x17D, 0x17E, 0x11A, 0x11B, };
-		  for ( size_t i = 0; i < sizeof(accutes)/sizeof(Unicode); ++i )
-			  _insert_u( map[UnicodeMapAccent::caron_repr], accutes[i], accutes_map[i] );
-	  }
+		{ CARON, 0x43, 0x10C }, { CARON, 0x63, 0x10D }, { CARON, 0x44, 0x10E },
+		{ CARON, 0x64, 0x10F }, { CARON, 0x4E, 0x147 }, { CARON, 0x6E, 0x148 },
+		{ CARON, 0x52, 0x158 }, { CARON, 0x72, 0x159 }, { CARON, 0x53, 0x160 },
+		{ CARON, 0x73, 0x161 }, { CARON, 0x54, 0x164 }, { CARON, 0x74, 0x165 },
+		{ CARON, 0x5A, 0x17D }, { CARON, 0x7A, 0x17E }, { CARON, 0x45, 0x11A },
+		{ CARON, 0x65, 0x11B },
 	  // ^ (all ascii - but take only few - others will be left like H^)
       // e,E, a,A, u,U,  i,I, dotless i,dotless I
-	  {
-		  Unicode accutes []		= 
-		  { 0x65,0x45, 0x61,0x41, 0x75,0x55, 0x6F,0x4F, 0x69,0x49, 0x131,0x49 };
-		  Unicode accutes_map []	= 
-		  { 0xEA,0xCA, 0xE2,0xC2, 0xFB,0xDB, 0xF4,0xD4, 0xEE,0xCE, 0xEE,0xCE };
-		  for ( size_t i = 0; i < sizeof(accutes)/sizeof(Unicode); ++i )
-			  _insert_u( map[UnicodeMapAccent::circumflex_repr], accutes[i], accutes_map[i] );
-	  }
+		{ CIRCUMFLEX, 0x65, 0xEA }, { CIRCUMFLEX, 0x45, 0xCA },
+		{ CIRCUMFLEX, 0x61, 0xE2 }, { CIRCUMFLEX, 0x41, 0xC2 },
+		{ CIRCUMFLEX, 0x75, 0xFB }, { CIRCUMFLEX, 0x55, 0xDB },
+		{ CIRCUMFLEX, 0x6F, 0xF4 }, { CIRCUMFLEX, 0x4F, 0xD4 },
+		{ CIRCUMFLEX, 0x69, 0xEE }, { CIRCUMFLEX, 0x49, 0xCE },
+		{ CIRCUMFLEX, 0x131, 0xEE }, { CIRCUMFLEX, 0x49, 0xCE },
 	  // ˚ (u)
-	  {
-		  Unicode accutes []		= { 0x55,  0x75, };
-		  Unicode accutes_map []	= { 0x16E, 0x16F, };
-		  for ( size_t i = 0; i < sizeof(accutes)/sizeof(Unicode); ++i )
-			  _insert_u( map[UnicodeMapAccent::ring_repr], accutes[i], accutes_map[i] );
-	  }
+		{ RING, 0x55, 0x16E }, { RING, 0x75, 0x16F },
 	  // ä, u, o
-	  {
-		  Unicode accutes []		= { 0x41, 0x61, 0x55, 0x75, 0x4f, 0x6F, };
-		  Unicode accutes_map []	= { 0xC4, 0xE5, 0xDC, 0xFC, 0xD6, 0xF6, };
-		  for ( size_t i = 0; i < sizeof(accutes)/sizeof(Unicode); ++i )
-			  _insert_u( map[UnicodeMapAccent::diaeresis_repr], accutes[i], accutes_map[i] );
-	  }
+		{ DIAERESIS, 0x41, 0xC4 }, { DIAERESIS, 0x61, 0xE4 },
+		{ DIAERESIS, 0x55, 0xDC }, { DIAERESIS, 0x75, 0xFC },
+		{ DIAERESIS, 0x4f, 0xD6 }, { DIAERESIS, 0x6F, 0xF6 },
 	  // french c
-	  {
-		  Unicode accutes []		= { 0x43, 0x63, };
-		  Unicode accutes_map []	= { 0xC7, 0xE7, };
-		  for ( size_t i = 0; i < sizeof(accutes)/sizeof(Unicode); ++i )
-			  _insert_u( map[UnicodeMapAccent::cedilla_repr], accutes[i], accutes_map[i] );
-	  }
+		{ CEDILLA, 0x43, 0xC7 }, { CEDILLA, 0x63, 0xE7 },
+	};
 
-		  return map;
-	  }
+	constexpr int letter_index( Unicode letter ) {
+		return letter < 0x80 ? (int)letter
+		     : letter == DOTLESS_I ? 0x80 : -1;
+	}
+
+	// accent -> accent class, and accent class x letter -> accented
+	// letter (0 if there is none)
+	struct accent_tables {
+		unsigned char cls[ACCENT_TABLE_SIZE];
+		unsigned short letters[ACCENT_CLASSES][LETTER_TABLE_SIZE];
+
+		constexpr accent_tables() : cls(), letters() {
+			for ( size_t i = 0; i < sizeof(accents)/sizeof(accents[0]); ++i )
+				cls[accents[i].u] = accents[i].cls;
+			for ( size_t i = 0; i < sizeof(accented)/sizeof(accented[0]); ++i ) {
+				unsigned short& mapping =
+					letters[accented[i].cls][letter_index(accented[i].letter)];
+				if ( 0 == mapping )
+					mapping = (unsigned short)accented[i].mapping;
+			}
+		}
+	};
+
+	constexpr accent_tables tables;
 
   }
 
-void 
-UnicodeMapAccent::initialise()
+int
+UnicodeMapAccent::accent_class( Unicode u )
 {
-  static bool initialised_ = false;
-  if ( initialised_ )
-    return;
-  
-  initialised_ = true;
-  set = init_set();
-  map_not_translated_accents = init_map_not_translated_accents();
-  map = init_map();
+	if ( u < ACCENT_TABLE_SIZE )
+		return tables.cls[u];
+	return RIGHT_QUOTE == u ? ACUTE : NO_ACCENT;
 }
 
+Unicode
+UnicodeMapAccent::normalize( Unicode accent )
+{
+	return class_repr[accent_class( accent )];
+}
 
-UnicodeMapAccent::unicode_map UnicodeMapAccent::set;
-UnicodeMapAccent::unicode_map UnicodeMapAccent::map_not_translated_accents;
-UnicodeMapAccent::unicode_tri_map UnicodeMapAccent::map;
+Unicode
+UnicodeMapAccent::translate( Unicode accent, Unicode letter, int& found )
+{
+	int cls = accent_class( accent );
+	int idx = letter_index( letter );
+	if ( 0 > idx || 0 == tables.letters[cls][idx] )
+	{
+		// accents which should not be translated if not found
+		if ( ACUTE == cls )
+		{
+			found = DO_NOT_TRANSLATE;
+		}else
+		{
+			found = NOT_FOUND;
+		}
+		return letter;
+	}
+	found = FOUND;
+	return tables.letters[cls][idx];
+}
@@ -3,65 +3,53 @@
 
 #include <stdio.h>
 #include <ctype.h>
-#include <set>
-#include <map>
+#include <algorithm>
 #include "CharTypes.h"
 
+// Lookups go through two tables which are built at compile time (see
+// UnicodeMapAccent.cc) -- an accent -> accent class table, and an
+// accent class x letter -> accented letter table.  There is no state
+// to initialise, and nothing is allocated.
 class UnicodeMapAccent {
 
-	// typedefs
-public:
-	typedef std::map<Unicode, Unicode> unicode_map;
-	typedef std::map<Unicode,unicode_map > unicode_tri_map;
-
 	// constants
 public:
-	static const Unicode acute_repr; 
-	static const Unicode caron_repr; 
-	static const Unicode ring_repr; 
-	static const Unicode diaeresis_repr; 
-	static const Unicode circumflex_repr; 
-	static const Unicode dotlesi_repr; 
-	static const Unicode grave_repr; 
-	static const Unicode cedilla_repr; 
+	static const Unicode acute_repr;
+	static const Unicode caron_repr;
+	static const Unicode ring_repr;
+	static const Unicode diaeresis_repr;
+	static const Unicode circumflex_repr;
+	static const Unicode dotlesi_repr;
+	static const Unicode grave_repr;
+	static const Unicode cedilla_repr;
 
 
   static const int FOUND = 0;
   static const int NOT_FOUND = 10;
   static const int DO_NOT_TRANSLATE = 11;
 
-	// variables
 private:
 	static const Unicode empty_fill = (Unicode)0x20;
-	// normalized set
-	static unicode_map set;
-	// first the accent, than the character
-	static unicode_tri_map map;
-  // accents which should not be translated if not fond
-  // - use map we are lazy
-	static unicode_map map_not_translated_accents;
 
-public:
-	template<typename T>
-	static bool exists( const T& map, typename T::key_type key ) {
-		return 1 == map.count( key );
-	}
+	// index of the accent class of <u> (see UnicodeMapAccent.cc), or
+	// 0 if <u> is not an accent
+	static int accent_class( Unicode u );
 
-  static void initialise();
+public:
 
 	static bool accent( Unicode u ) {
-		return exists( set, u );
+		return 0 != accent_class( u );
 	}
 	static bool accented_letter( const Unicode u ) {
-		// too lazy to do all unicode 
+		// too lazy to do all unicode
 		if (u > 255)
 			return true;
 		else
 			return isalnum( (int)u ) > 0;
 	}
 
-	/** 
-	 * One must be a normal letter, the other must be an accent. 
+	/**
+	 * One must be a normal letter, the other must be an accent.
 	 * If positive than u1 will be the accent, and u2 the letter;
 	 */
 	static bool accented_pair( Unicode& u1, Unicode& u2 ) {
@@ -75,30 +63,11 @@ public:
 	}
 
 	/** Normalize. */
-	static Unicode normalize( Unicode accent ) {
-		if ( !exists( set, accent) )
-			return empty_fill;
-		return set.find(accent)->second;
-	}
+	static Unicode normalize( Unicode accent );
 
 
 	/** Translate. */
-	static Unicode translate( Unicode accent, Unicode letter, int& found ) {
-		accent = normalize(accent);
-		if ( !exists( map, accent) || !exists( map.find(accent)->second,letter ) )
-        {
-            if ( exists( map_not_translated_accents, accent) )
-            {
-                found = DO_NOT_TRANSLATE;
-            }else 
-            {
-                found = NOT_FOUND;
-            }
-	    	return letter;
-        }
-        found = FOUND;
-		return map.find(accent)->second.find(letter)->second;
-	}
+	static Unicode translate( Unicode accent, Unicode letter, int& found );
 
 };
 